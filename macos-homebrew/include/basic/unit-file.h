@@ -2,6 +2,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <sys/stat.h>
 
 #include "hashmap.h"
 #include "path-lookup.h"
@@ -45,12 +46,73 @@ int unit_file_resolve_symlink(
                 bool resolve_destination_target,
                 char **ret_destination);
 
-int unit_file_build_name_map(
+typedef enum UnitFileDirEntryType {
+        UNIT_FILE_DIR_ENTRY_UNIT,       /* A regular file with a valid unit name */
+        UNIT_FILE_DIR_ENTRY_SYMLINK,    /* A symlink with a valid unit name */
+        UNIT_FILE_DIR_ENTRY_DIRECTORY,  /* A .wants/, .requires/ or .d/ directory, or a symlink to one */
+        _UNIT_FILE_DIR_ENTRY_TYPE_MAX,
+        _UNIT_FILE_DIR_ENTRY_TYPE_INVALID = -EINVAL,
+} UnitFileDirEntryType;
+
+typedef struct UnitFileDirEntry {
+        UnitFileDirEntryType type;
+        char *name;
+        /* For symlinks: the result of unit_file_resolve_symlink(), once it has been called */
+        char *destination;
+        int resolve_error;
+} UnitFileDirEntry;
+
+typedef struct UnitFileDir {
+        char *path;
+        bool exists;
+        dev_t dev;
+        ino_t ino;
+        nsec_t mtime;
+        UnitFileDirEntry *entries;
+        size_t n_entries;
+} UnitFileDir;
+
+/* A snapshot of the relevant entries of each directory in the unit search path. unit_file_build_name_map_full()
+ * takes the entries of directories whose inode and mtime did not change from here, instead of reading them
+ * and resolving their symlinks again, and stores a new snapshot when done. */
+typedef struct UnitFileDirCache {
+        char *root_dir;
+        char **expanded_search_path;
+        UnitFileDir *dirs;
+        size_t n_dirs;
+        size_t n_reused;
+} UnitFileDirCache;
+
+void unit_file_dir_done(UnitFileDir *d);
+int unit_file_dir_add_entry(
+                UnitFileDir *d,
+                UnitFileDirEntryType type,
+                const char *name,
+                const char *destination,
+                int resolve_error);
+
+UnitFileDirCache* unit_file_dir_cache_free(UnitFileDirCache *c);
+DEFINE_TRIVIAL_CLEANUP_FUNC(UnitFileDirCache*, unit_file_dir_cache_free);
+int unit_file_dir_cache_take(UnitFileDirCache *c, UnitFileDir *d);
+
+const char* unit_file_dir_entry_type_to_string(UnitFileDirEntryType t) _const_;
+UnitFileDirEntryType unit_file_dir_entry_type_from_string(const char *s) _pure_;
+
+int unit_file_build_name_map_full(
+                const LookupPaths *lp,
+                uint64_t *cache_timestamp_hash,
+                Hashmap **unit_ids_map,
+                Hashmap **unit_names_map,
+                Set **path_cache,
+                UnitFileDirCache **dir_cache);
+static inline int unit_file_build_name_map(
                 const LookupPaths *lp,
                 uint64_t *cache_timestamp_hash,
                 Hashmap **unit_ids_map,
                 Hashmap **unit_names_map,
-                Set **path_cache);
+                Set **path_cache) {
+        return unit_file_build_name_map_full(lp, cache_timestamp_hash, unit_ids_map, unit_names_map, path_cache, NULL);
+}
 
 int unit_file_find_fragment(
                 Hashmap *unit_ids_map,
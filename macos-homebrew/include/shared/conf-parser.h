@@ -93,6 +93,35 @@ int config_parse(
                 void *userdata,
                 struct stat *ret_stat);     /* possibly NULL */
 
+/* A configuration file split into its logical lines by config_file_read(), to be applied later by
+ * config_parse_file() */
+typedef struct ConfigFileLine {
+        unsigned line;
+        char *text;
+} ConfigFileLine;
+
+typedef struct ConfigFile {
+        char *filename;
+        struct stat st;
+        ConfigFileLine *lines;
+        size_t n_lines;
+} ConfigFile;
+
+ConfigFile* config_file_free(ConfigFile *c);
+DEFINE_TRIVIAL_CLEANUP_FUNC(ConfigFile*, config_file_free);
+
+int config_file_read(const char *filename, ConfigFile **ret);
+
+int config_parse_file(
+                const char *unit,
+                const ConfigFile *c,
+                const char *sections,       /* nulstr */
+                ConfigItemLookup lookup,
+                const void *table,
+                ConfigParseFlags flags,
+                void *userdata,
+                struct stat *ret_stat);     /* possibly NULL */
+
 int config_parse_many_nulstr(
                 const char *conf_file,      /* possibly NULL */
                 const char *conf_file_dirs, /* nulstr */
@@ -229,6 +229,72 @@ static inline int json_parse_file(FILE *f, const char *path, JsonParseFlags flag
         return json_parse_file_at(f, AT_FDCWD, path, flags, ret, ret_line, ret_column);
 }
 
+/* An arena allows allocating all variants of a document parsed once and then thrown away again in bulk,
+ * instead of individually. Variants allocated from it are not reference counted and must not be used
+ * after the arena is freed. */
+typedef struct JsonArena JsonArena;
+
+JsonArena *json_arena_new(void);
+JsonArena *json_arena_free(JsonArena *a);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JsonArena*, json_arena_free);
+size_t json_arena_size(JsonArena *a);
+
+int json_parse_with_arena(const char *string, JsonParseFlags flags, JsonArena *arena, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column);
+
+/* A pull parser, that returns the document token by token, without building JsonVariant objects. */
+typedef struct JsonReader JsonReader;
+
+typedef enum JsonReaderToken {
+        JSON_READER_END,
+        JSON_READER_OBJECT_BEGIN,
+        JSON_READER_OBJECT_END,
+        JSON_READER_ARRAY_BEGIN,
+        JSON_READER_ARRAY_END,
+        JSON_READER_KEY,
+        JSON_READER_STRING,
+        JSON_READER_INTEGER,
+        JSON_READER_UNSIGNED,
+        JSON_READER_REAL,
+        JSON_READER_BOOLEAN,
+        JSON_READER_NULL,
+        _JSON_READER_TOKEN_MAX,
+        _JSON_READER_TOKEN_INVALID = -EINVAL,
+} JsonReaderToken;
+
+int json_reader_new(JsonReader **ret, const char *input);
+JsonReader *json_reader_free(JsonReader *r);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JsonReader*, json_reader_free);
+
+int json_reader_next(JsonReader *r);
+unsigned json_reader_depth(JsonReader *r);
+const char *json_reader_string(JsonReader *r);
+int json_reader_integer(JsonReader *r, int64_t *ret);
+int json_reader_unsigned(JsonReader *r, uint64_t *ret);
+int json_reader_real(JsonReader *r, double *ret);
+int json_reader_boolean(JsonReader *r, bool *ret);
+int json_reader_variant(JsonReader *r, JsonArena *arena, JsonVariant **ret);
+int json_reader_skip(JsonReader *r);
+
+/* A streaming formatter, that writes JSON directly to a stream, without building JsonVariant objects. */
+typedef struct JsonWriter JsonWriter;
+
+int json_writer_new(JsonWriter **ret, FILE *f, JsonFormatFlags flags);
+JsonWriter *json_writer_free(JsonWriter *w);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JsonWriter*, json_writer_free);
+
+int json_writer_begin_object(JsonWriter *w);
+int json_writer_end_object(JsonWriter *w);
+int json_writer_begin_array(JsonWriter *w);
+int json_writer_end_array(JsonWriter *w);
+int json_writer_key(JsonWriter *w, const char *key);
+int json_writer_string(JsonWriter *w, const char *s);
+int json_writer_integer(JsonWriter *w, int64_t i);
+int json_writer_unsigned(JsonWriter *w, uint64_t u);
+int json_writer_real(JsonWriter *w, double d);
+int json_writer_boolean(JsonWriter *w, bool b);
+int json_writer_null(JsonWriter *w);
+int json_writer_variant(JsonWriter *w, JsonVariant *v);
+
 enum {
         _JSON_BUILD_STRING,
         _JSON_BUILD_INTEGER,
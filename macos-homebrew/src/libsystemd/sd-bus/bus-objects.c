@@ -422,7 +422,7 @@ static int method_callbacks_run(
 static int invoke_property_get(
                 sd_bus *bus,
                 sd_bus_slot *slot,
-                const sd_bus_vtable *v,
+                const struct vtable_property *p,
                 const char *path,
                 const char *interface,
                 const char *property,
@@ -430,19 +430,23 @@ static int invoke_property_get(
                 void *userdata,
                 sd_bus_error *error) {
 
-        const void *p;
+        const sd_bus_vtable *v;
+        const void *q;
         int r;
 
         assert(bus);
         assert(slot);
-        assert(v);
+        assert(p);
         assert(path);
         assert(interface);
         assert(property);
         assert(reply);
 
-        if (v->x.property.get) {
+        v = p->vtable;
+
+        switch (p->marshal) {
 
+        case BUS_PROPERTY_MARSHAL_CALLBACK:
                 bus->current_slot = sd_bus_slot_ref(slot);
                 bus->current_userdata = userdata;
                 r = v->x.property.get(bus, path, interface, property, reply, userdata, error);
@@ -454,34 +458,30 @@ static int invoke_property_get(
                 if (sd_bus_error_is_set(error))
                         return -sd_bus_error_get_errno(error);
                 return r;
-        }
 
         /* Automatic handling if no callback is defined. */
 
-        if (streq(v->x.property.signature, "as"))
+        case BUS_PROPERTY_MARSHAL_STRV:
                 return sd_bus_message_append_strv(reply, *(char***) userdata);
 
-        assert(signature_is_single(v->x.property.signature, false));
-        assert(bus_type_is_basic(v->x.property.signature[0]));
-
-        switch (v->x.property.signature[0]) {
+        case BUS_PROPERTY_MARSHAL_STRING:
+                q = strempty(*(char**) userdata);
+                break;
 
-        case SD_BUS_TYPE_STRING:
-        case SD_BUS_TYPE_SIGNATURE:
-                p = strempty(*(char**) userdata);
+        case BUS_PROPERTY_MARSHAL_OBJECT_PATH:
+                q = *(char**) userdata;
+                assert(q);
                 break;
 
-        case SD_BUS_TYPE_OBJECT_PATH:
-                p = *(char**) userdata;
-                assert(p);
+        case BUS_PROPERTY_MARSHAL_TRIVIAL:
+                q = userdata;
                 break;
 
         default:
-                p = userdata;
-                break;
+                assert_not_reached();
         }
 
-        return sd_bus_message_append_basic(reply, v->x.property.signature[0], p);
+        return sd_bus_message_append_basic(reply, p->type, q);
 }
 
 static int invoke_property_set(
@@ -623,7 +623,7 @@ static int property_get_set_callbacks_run(
                  * PropertiesChanged signals broadcast contents
                  * anyway. */
 
-                r = invoke_property_get(bus, slot, c->vtable, m->path, c->interface, c->member, reply, u, &error);
+                r = invoke_property_get(bus, slot, c->property, m->path, c->interface, c->member, reply, u, &error);
                 if (r < 0)
                         return bus_maybe_reply_error(m, r, &error);
 
@@ -694,10 +694,11 @@ static int vtable_append_one_property(
                 sd_bus_message *reply,
                 const char *path,
                 struct node_vtable *c,
-                const sd_bus_vtable *v,
+                const struct vtable_property *p,
                 void *userdata,
                 sd_bus_error *error) {
 
+        const sd_bus_vtable *v;
         sd_bus_slot *slot;
         int r;
 
@@ -705,7 +706,9 @@ static int vtable_append_one_property(
         assert(reply);
         assert(path);
         assert(c);
-        assert(v);
+        assert(p);
+
+        v = p->vtable;
 
         if (FLAGS_SET(c->vtable->flags, SD_BUS_VTABLE_SENSITIVE)) {
                 r = sd_bus_message_sensitive(reply);
@@ -717,7 +720,7 @@ static int vtable_append_one_property(
         if (r < 0)
                 return r;
 
-        r = sd_bus_message_append(reply, "s", v->x.property.member);
+        r = sd_bus_message_append_basic(reply, 's', v->x.property.member);
         if (r < 0)
                 return r;
 
@@ -727,7 +730,7 @@ static int vtable_append_one_property(
 
         slot = container_of(c, sd_bus_slot, node_vtable);
 
-        r = invoke_property_get(bus, slot, v, path, c->interface, v->x.property.member, reply, vtable_property_convert_userdata(v, userdata), error);
+        r = invoke_property_get(bus, slot, p, path, c->interface, v->x.property.member, reply, vtable_property_convert_userdata(v, userdata), error);
         if (r < 0)
                 return r;
         if (bus->nodes_modified)
@@ -752,7 +755,6 @@ static int vtable_append_all_properties(
                 void *userdata,
                 sd_bus_error *error) {
 
-        const sd_bus_vtable *v;
         int r;
 
         assert(bus);
@@ -763,10 +765,9 @@ static int vtable_append_all_properties(
         if (c->vtable[0].flags & SD_BUS_VTABLE_HIDDEN)
                 return 1;
 
-        v = c->vtable;
-        for (v = bus_vtable_next(c->vtable, v); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(c->vtable, v)) {
-                if (!IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY))
-                        continue;
+        for (size_t i = 0; i < c->n_properties; i++) {
+                const struct vtable_property *p = c->properties + i;
+                const sd_bus_vtable *v = p->vtable;
 
                 if (v->flags & SD_BUS_VTABLE_HIDDEN)
                         continue;
@@ -783,7 +784,7 @@ static int vtable_append_all_properties(
                     FLAGS_SET(v->flags, SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION))
                         continue;
 
-                r = vtable_append_one_property(bus, reply, path, c, v, userdata, error);
+                r = vtable_append_one_property(bus, reply, path, c, p, userdata, error);
                 if (r < 0)
                         return r;
                 if (bus->nodes_modified)
@@ -1779,6 +1780,34 @@ const sd_bus_vtable* bus_vtable_next(const sd_bus_vtable *vtable, const sd_bus_v
         return (const sd_bus_vtable*) ((char*) v + vtable[0].x.start.element_size);
 }
 
+static BusPropertyMarshal vtable_property_marshal(const sd_bus_vtable *v) {
+        assert(v);
+        assert(IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY));
+
+        if (v->x.property.get)
+                return BUS_PROPERTY_MARSHAL_CALLBACK;
+
+        if (streq(v->x.property.signature, "as"))
+                return BUS_PROPERTY_MARSHAL_STRV;
+
+        if (!signature_is_single(v->x.property.signature, false) ||
+            !bus_type_is_basic(v->x.property.signature[0]))
+                return _BUS_PROPERTY_MARSHAL_INVALID;
+
+        switch (v->x.property.signature[0]) {
+
+        case SD_BUS_TYPE_STRING:
+        case SD_BUS_TYPE_SIGNATURE:
+                return BUS_PROPERTY_MARSHAL_STRING;
+
+        case SD_BUS_TYPE_OBJECT_PATH:
+                return BUS_PROPERTY_MARSHAL_OBJECT_PATH;
+
+        default:
+                return BUS_PROPERTY_MARSHAL_TRIVIAL;
+        }
+}
+
 static int add_object_vtable_internal(
                 sd_bus *bus,
                 sd_bus_slot **slot,
@@ -1792,6 +1821,7 @@ static int add_object_vtable_internal(
         sd_bus_slot *s = NULL;
         struct node_vtable *existing = NULL;
         const sd_bus_vtable *v;
+        size_t n_properties;
         struct node *n;
         int r;
         const char *names = "";
@@ -1857,6 +1887,19 @@ static int add_object_vtable_internal(
                 goto fail;
         }
 
+        n_properties = 0;
+        for (v = bus_vtable_next(vtable, vtable); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(vtable, v))
+                if (IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY))
+                        n_properties++;
+
+        if (n_properties > 0) {
+                s->node_vtable.properties = new(struct vtable_property, n_properties);
+                if (!s->node_vtable.properties) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+        }
+
         v = s->node_vtable.vtable;
         for (v = bus_vtable_next(vtable, v); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(vtable, v)) {
 
@@ -1915,6 +1958,7 @@ static int add_object_vtable_internal(
 
                         _fallthrough_;
                 case _SD_BUS_VTABLE_PROPERTY: {
+                        struct vtable_property *p;
                         struct vtable_member *m;
 
                         if (!member_name_is_valid(v->x.property.member) ||
@@ -1928,6 +1972,16 @@ static int add_object_vtable_internal(
                                 goto fail;
                         }
 
+                        assert(s->node_vtable.n_properties < n_properties);
+                        p = s->node_vtable.properties + s->node_vtable.n_properties;
+                        *p = (struct vtable_property) {
+                                .vtable = v,
+                                .marshal = vtable_property_marshal(v),
+                                .type = v->x.property.signature[0],
+                        };
+                        assert(p->marshal >= 0);
+                        s->node_vtable.n_properties++;
+
                         m = new0(struct vtable_member, 1);
                         if (!m) {
                                 r = -ENOMEM;
@@ -1939,6 +1993,7 @@ static int add_object_vtable_internal(
                         m->interface = s->node_vtable.interface;
                         m->member = v->x.property.member;
                         m->vtable = v;
+                        m->property = p;
 
                         r = hashmap_put(bus->vtable_properties, m, m);
                         if (r < 0) {
@@ -2150,23 +2205,20 @@ static int emit_properties_changed_on_interface(
 
                                 has_changing = true;
 
-                                r = vtable_append_one_property(bus, m, m->path, c, v->vtable, u, &error);
+                                r = vtable_append_one_property(bus, m, m->path, c, v->property, u, &error);
                                 if (r < 0)
                                         return r;
                                 if (bus->nodes_modified)
                                         return 0;
                         }
                 } else {
-                        const sd_bus_vtable *v;
-
                         /* If the caller specified no properties list
                          * we include all properties that are marked
                          * as changing in the message. */
 
-                        v = c->vtable;
-                        for (v = bus_vtable_next(c->vtable, v); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(c->vtable, v)) {
-                                if (!IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY))
-                                        continue;
+                        for (size_t i = 0; i < c->n_properties; i++) {
+                                const struct vtable_property *p = c->properties + i;
+                                const sd_bus_vtable *v = p->vtable;
 
                                 if (v->flags & SD_BUS_VTABLE_HIDDEN)
                                         continue;
@@ -2181,7 +2233,7 @@ static int emit_properties_changed_on_interface(
 
                                 has_changing = true;
 
-                                r = vtable_append_one_property(bus, m, m->path, c, v, u, &error);
+                                r = vtable_append_one_property(bus, m, m->path, c, p, u, &error);
                                 if (r < 0)
                                         return r;
                                 if (bus->nodes_modified)
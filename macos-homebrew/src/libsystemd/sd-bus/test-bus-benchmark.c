@@ -12,6 +12,7 @@
 #include "fd-util.h"
 #include "missing_resource.h"
 #include "string-util.h"
+#include "strv.h"
 #include "time-util.h"
 #include "util.h"
 
@@ -24,9 +25,117 @@ typedef enum Type {
         TYPE_DIRECT,
 } Type;
 
+/* Loosely modelled after the property mix of org.freedesktop.systemd1.Unit, to measure GetAll() */
+typedef struct BenchmarkUnit {
+        char *id;
+        char **names;
+        char *description;
+        char *load_state;
+        char *active_state;
+        char *sub_state;
+        char *fragment_path;
+        char **documentation;
+        char *following;
+        char *job_path;
+        uint64_t inactive_exit_timestamp;
+        uint64_t active_enter_timestamp;
+        uint64_t active_exit_timestamp;
+        uint64_t inactive_enter_timestamp;
+        uint64_t state_change_timestamp;
+        int can_start;
+        int can_stop;
+        int can_reload;
+        int stop_when_unneeded;
+        int refuse_manual_start;
+        int default_dependencies;
+        uint32_t n_restarts;
+        uint64_t memory_current;
+        uint64_t cpu_usage_nsec;
+        uint64_t tasks_current;
+} BenchmarkUnit;
+
+static int property_get_tasks_max(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        return sd_bus_message_append(reply, "t", UINT64_C(4915));
+}
+
+static int property_get_conditions(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        return sd_bus_message_append(reply, "a(sbbsi)", 1, "ConditionPathExists", false, false, "/etc/benchmark", 1);
+}
+
+static const sd_bus_vtable benchmark_unit_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_PROPERTY("Id", "s", NULL, offsetof(BenchmarkUnit, id), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Names", "as", NULL, offsetof(BenchmarkUnit, names), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Description", "s", NULL, offsetof(BenchmarkUnit, description), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("LoadState", "s", NULL, offsetof(BenchmarkUnit, load_state), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("ActiveState", "s", NULL, offsetof(BenchmarkUnit, active_state), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("SubState", "s", NULL, offsetof(BenchmarkUnit, sub_state), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("FragmentPath", "s", NULL, offsetof(BenchmarkUnit, fragment_path), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Documentation", "as", NULL, offsetof(BenchmarkUnit, documentation), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Following", "s", NULL, offsetof(BenchmarkUnit, following), 0),
+        SD_BUS_PROPERTY("Job", "o", NULL, offsetof(BenchmarkUnit, job_path), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("InactiveExitTimestamp", "t", NULL, offsetof(BenchmarkUnit, inactive_exit_timestamp), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("ActiveEnterTimestamp", "t", NULL, offsetof(BenchmarkUnit, active_enter_timestamp), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("ActiveExitTimestamp", "t", NULL, offsetof(BenchmarkUnit, active_exit_timestamp), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("InactiveEnterTimestamp", "t", NULL, offsetof(BenchmarkUnit, inactive_enter_timestamp), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("StateChangeTimestamp", "t", NULL, offsetof(BenchmarkUnit, state_change_timestamp), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("CanStart", "b", NULL, offsetof(BenchmarkUnit, can_start), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("CanStop", "b", NULL, offsetof(BenchmarkUnit, can_stop), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("CanReload", "b", NULL, offsetof(BenchmarkUnit, can_reload), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("StopWhenUnneeded", "b", NULL, offsetof(BenchmarkUnit, stop_when_unneeded), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("RefuseManualStart", "b", NULL, offsetof(BenchmarkUnit, refuse_manual_start), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("DefaultDependencies", "b", NULL, offsetof(BenchmarkUnit, default_dependencies), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("NRestarts", "u", NULL, offsetof(BenchmarkUnit, n_restarts), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("MemoryCurrent", "t", NULL, offsetof(BenchmarkUnit, memory_current), 0),
+        SD_BUS_PROPERTY("CPUUsageNSec", "t", NULL, offsetof(BenchmarkUnit, cpu_usage_nsec), 0),
+        SD_BUS_PROPERTY("TasksCurrent", "t", NULL, offsetof(BenchmarkUnit, tasks_current), 0),
+        SD_BUS_PROPERTY("TasksMax", "t", property_get_tasks_max, 0, 0),
+        SD_BUS_PROPERTY("Conditions", "a(sbbsi)", property_get_conditions, 0, SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION),
+        SD_BUS_VTABLE_END
+};
+
 static void server(sd_bus *b, size_t *result) {
+        BenchmarkUnit u = {
+                .id = (char*) "benchmark.service",
+                .names = STRV_MAKE("benchmark.service", "alias.service"),
+                .description = (char*) "Benchmark Service",
+                .load_state = (char*) "loaded",
+                .active_state = (char*) "active",
+                .sub_state = (char*) "running",
+                .fragment_path = (char*) "/usr/lib/systemd/system/benchmark.service",
+                .documentation = STRV_MAKE("man:benchmark(8)"),
+                .job_path = (char*) "/",
+                .inactive_exit_timestamp = 1,
+                .active_enter_timestamp = 2,
+                .state_change_timestamp = 2,
+                .can_start = true,
+                .can_stop = true,
+                .default_dependencies = true,
+                .memory_current = UINT64_MAX,
+                .cpu_usage_nsec = UINT64_MAX,
+                .tasks_current = 1,
+        };
         int r;
 
+        r = sd_bus_add_object_vtable(b, NULL, "/benchmark", "benchmark.Unit", benchmark_unit_vtable, &u);
+        assert_se(r >= 0);
+
         for (;;) {
                 _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
 
@@ -206,10 +315,59 @@ static void client_chart(Type type, const char *address, const char *server_name
         sd_bus_unref(b);
 }
 
+static void client_getall(Type type, const char *address, const char *server_name, int fd) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *x = NULL;
+        unsigned n;
+        usec_t t;
+        sd_bus *b;
+        int r;
+
+        r = sd_bus_new(&b);
+        assert_se(r >= 0);
+
+        if (type == TYPE_DIRECT) {
+                r = sd_bus_set_fd(b, fd, fd);
+                assert_se(r >= 0);
+        } else {
+                r = sd_bus_set_address(b, address);
+                assert_se(r >= 0);
+
+                r = sd_bus_set_bus_client(b, true);
+                assert_se(r >= 0);
+        }
+
+        r = sd_bus_start(b);
+        assert_se(r >= 0);
+
+        r = sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL);
+        assert_se(r >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        for (n = 0;; n++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+
+                r = sd_bus_call_method(b, server_name, "/benchmark", "org.freedesktop.DBus.Properties", "GetAll",
+                                       NULL, &reply, "s", "benchmark.Unit");
+                assert_se(r >= 0);
+
+                if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                        break;
+        }
+
+        printf("GetAll()\t%u/s\n", (unsigned) ((n * USEC_PER_SEC) / arg_loop_usec));
+
+        assert_se(sd_bus_message_new_method_call(b, &x, server_name, "/", "benchmark.server", "Exit") >= 0);
+        assert_se(sd_bus_message_append(x, "t", (uint64_t) n) >= 0);
+        assert_se(sd_bus_send(b, x, NULL) >= 0);
+
+        sd_bus_unref(b);
+}
+
 int main(int argc, char *argv[]) {
         enum {
                 MODE_BISECT,
                 MODE_CHART,
+                MODE_GETALL,
         } mode = MODE_BISECT;
         Type type = TYPE_LEGACY;
         int i, pair[2] = { -1, -1 };
@@ -226,6 +384,9 @@ int main(int argc, char *argv[]) {
                 if (streq(argv[i], "chart")) {
                         mode = MODE_CHART;
                         continue;
+                } else if (streq(argv[i], "getall")) {
+                        mode = MODE_GETALL;
+                        continue;
                 } else if (streq(argv[i], "legacy")) {
                         type = TYPE_LEGACY;
                         continue;
@@ -301,6 +462,10 @@ int main(int argc, char *argv[]) {
                 case MODE_CHART:
                         client_chart(type, address, server_name, pair[1]);
                         break;
+
+                case MODE_GETALL:
+                        client_getall(type, address, server_name, pair[1]);
+                        break;
                 }
 
                 _exit(EXIT_SUCCESS);
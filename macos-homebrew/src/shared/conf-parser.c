@@ -273,111 +273,99 @@ static int parse_line(
                                userdata);
 }
 
-/* Go through the file and parse each line */
-int config_parse(
-                const char *unit,
-                const char *filename,
-                FILE *f,
-                const char *sections,
-                ConfigItemLookup lookup,
-                const void *table,
-                ConfigParseFlags flags,
-                void *userdata,
-                struct stat *ret_stat) {
-
-        _cleanup_free_ char *section = NULL, *continuation = NULL;
-        _cleanup_fclose_ FILE *ours = NULL;
-        unsigned line = 0, section_line = 0;
-        bool section_ignored = false, bom_seen = false;
-        struct stat st;
-        int r, fd;
-
-        assert(filename);
-        assert(lookup);
-
-        if (!f) {
-                f = ours = fopen(filename, "re");
-                if (!f) {
-                        /* Only log on request, except for ENOENT,
-                         * since we return 0 to the caller. */
-                        if ((flags & CONFIG_PARSE_WARN) || errno == ENOENT)
-                                log_full_errno(errno == ENOENT ? LOG_DEBUG : LOG_ERR, errno,
-                                               "Failed to open configuration file '%s': %m", filename);
-
-                        if (errno == ENOENT) {
-                                if (ret_stat)
-                                        *ret_stat = (struct stat) {};
+typedef struct ConfigLineReader {
+        const char *filename;
+        FILE *f;
+        ConfigParseFlags flags;
+        unsigned line;
+        bool bom_seen;
+        bool eof;
+        char *buf;
+        char *continuation;
+} ConfigLineReader;
+
+static void config_line_reader_done(ConfigLineReader *reader) {
+        assert(reader);
+
+        reader->buf = mfree(reader->buf);
+        reader->continuation = mfree(reader->continuation);
+}
 
-                                return 0;
-                        }
+/* Returns the next logical line of the file, i.e. skips comments and joins continuation lines. The returned
+ * string is owned by the reader, and may be modified by the caller until the next call. Returns 0 on EOF. */
+static int config_line_reader_next(ConfigLineReader *reader, char **ret, unsigned *ret_line) {
+        int r;
 
-                        return -errno;
-                }
-        }
+        assert(reader);
+        assert(ret);
+        assert(ret_line);
 
-        fd = fileno(f);
-        if (fd >= 0) { /* stream might not have an fd, let's be careful hence */
+        if (reader->eof)
+                return 0;
 
-                if (fstat(fd, &st) < 0)
-                        return log_full_errno(FLAGS_SET(flags, CONFIG_PARSE_WARN) ? LOG_ERR : LOG_DEBUG, errno,
-                                              "Failed to fstat(%s): %m", filename);
-
-                (void) stat_warn_permissions(filename, &st);
-        } else
-                st = (struct stat) {};
+        reader->continuation = mfree(reader->continuation);
 
         for (;;) {
-                _cleanup_free_ char *buf = NULL;
                 bool escaped = false;
                 char *l, *p, *e;
 
-                r = read_line(f, LONG_LINE_MAX, &buf);
-                if (r == 0)
-                        break;
+                reader->buf = mfree(reader->buf);
+
+                r = read_line(reader->f, LONG_LINE_MAX, &reader->buf);
+                if (r == 0) {
+                        reader->eof = true;
+
+                        if (!reader->continuation)
+                                return 0;
+
+                        *ret = reader->continuation;
+                        *ret_line = ++reader->line;
+                        return 1;
+                }
                 if (r == -ENOBUFS) {
-                        if (flags & CONFIG_PARSE_WARN)
-                                log_error_errno(r, "%s:%u: Line too long", filename, line);
+                        if (reader->flags & CONFIG_PARSE_WARN)
+                                log_error_errno(r, "%s:%u: Line too long", reader->filename, reader->line);
 
                         return r;
                 }
                 if (r < 0) {
-                        if (FLAGS_SET(flags, CONFIG_PARSE_WARN))
-                                log_error_errno(r, "%s:%u: Error while reading configuration file: %m", filename, line);
+                        if (FLAGS_SET(reader->flags, CONFIG_PARSE_WARN))
+                                log_error_errno(r, "%s:%u: Error while reading configuration file: %m", reader->filename, reader->line);
 
                         return r;
                 }
 
-                line++;
+                reader->line++;
 
-                l = skip_leading_chars(buf, WHITESPACE);
+                l = skip_leading_chars(reader->buf, WHITESPACE);
                 if (*l != '\0' && strchr(COMMENTS, *l))
                         continue;
 
-                l = buf;
-                if (!bom_seen) {
+                l = reader->buf;
+                if (!reader->bom_seen) {
                         char *q;
 
-                        q = startswith(buf, UTF8_BYTE_ORDER_MARK);
+                        q = startswith(reader->buf, UTF8_BYTE_ORDER_MARK);
                         if (q) {
                                 l = q;
-                                bom_seen = true;
+                                reader->bom_seen = true;
                         }
                 }
 
-                if (continuation) {
-                        if (strlen(continuation) + strlen(l) > LONG_LINE_MAX) {
-                                if (flags & CONFIG_PARSE_WARN)
-                                        log_error("%s:%u: Continuation line too long", filename, line);
+                if (reader->continuation) {
+                        if (strlen(reader->continuation) + strlen(l) > LONG_LINE_MAX) {
+                                if (reader->flags & CONFIG_PARSE_WARN)
+                                        log_error("%s:%u: Continuation line too long", reader->filename, reader->line);
                                 return -ENOBUFS;
                         }
 
-                        if (!strextend(&continuation, l)) {
-                                if (flags & CONFIG_PARSE_WARN)
+                        if (!strextend(&reader->continuation, l)) {
+                                if (reader->flags & CONFIG_PARSE_WARN)
                                         log_oom();
                                 return -ENOMEM;
                         }
 
-                        p = continuation;
+                        p = reader->continuation;
                 } else
                         p = l;
 
@@ -391,10 +379,10 @@ int config_parse(
                 if (escaped) {
                         *(e-1) = ' ';
 
-                        if (!continuation) {
-                                continuation = strdup(l);
-                                if (!continuation) {
-                                        if (flags & CONFIG_PARSE_WARN)
+                        if (!reader->continuation) {
+                                reader->continuation = strdup(l);
+                                if (!reader->continuation) {
+                                        if (reader->flags & CONFIG_PARSE_WARN)
                                                 log_oom();
                                         return -ENOMEM;
                                 }
@@ -403,6 +391,82 @@ int config_parse(
                         continue;
                 }
 
+                *ret = p;
+                *ret_line = reader->line;
+                return 1;
+        }
+}
+
+/* Go through the file and parse each line */
+int config_parse(
+                const char *unit,
+                const char *filename,
+                FILE *f,
+                const char *sections,
+                ConfigItemLookup lookup,
+                const void *table,
+                ConfigParseFlags flags,
+                void *userdata,
+                struct stat *ret_stat) {
+
+        _cleanup_(config_line_reader_done) ConfigLineReader reader = {};
+        _cleanup_free_ char *section = NULL;
+        _cleanup_fclose_ FILE *ours = NULL;
+        unsigned section_line = 0;
+        bool section_ignored = false;
+        struct stat st;
+        int r, fd;
+
+        assert(filename);
+        assert(lookup);
+
+        if (!f) {
+                f = ours = fopen(filename, "re");
+                if (!f) {
+                        /* Only log on request, except for ENOENT,
+                         * since we return 0 to the caller. */
+                        if ((flags & CONFIG_PARSE_WARN) || errno == ENOENT)
+                                log_full_errno(errno == ENOENT ? LOG_DEBUG : LOG_ERR, errno,
+                                               "Failed to open configuration file '%s': %m", filename);
+
+                        if (errno == ENOENT) {
+                                if (ret_stat)
+                                        *ret_stat = (struct stat) {};
+
+                                return 0;
+                        }
+
+                        return -errno;
+                }
+        }
+
+        fd = fileno(f);
+        if (fd >= 0) { /* stream might not have an fd, let's be careful hence */
+
+                if (fstat(fd, &st) < 0)
+                        return log_full_errno(FLAGS_SET(flags, CONFIG_PARSE_WARN) ? LOG_ERR : LOG_DEBUG, errno,
+                                              "Failed to fstat(%s): %m", filename);
+
+                (void) stat_warn_permissions(filename, &st);
+        } else
+                st = (struct stat) {};
+
+        reader = (ConfigLineReader) {
+                .filename = filename,
+                .f = f,
+                .flags = flags,
+        };
+
+        for (;;) {
+                unsigned line;
+                char *p;
+
+                r = config_line_reader_next(&reader, &p, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
                 r = parse_line(unit,
                                filename,
                                line,
@@ -420,14 +484,129 @@ int config_parse(
                                 log_warning_errno(r, "%s:%u: Failed to parse file: %m", filename, line);
                         return r;
                 }
+        }
+
+        if (ret_stat)
+                *ret_stat = st;
+
+        return 1;
+}
+
+ConfigFile* config_file_free(ConfigFile *c) {
+        if (!c)
+                return NULL;
+
+        for (size_t i = 0; i < c->n_lines; i++)
+                free(c->lines[i].text);
+
+        free(c->lines);
+        free(c->filename);
+        return mfree(c);
+}
+
+int config_file_read(const char *filename, ConfigFile **ret) {
+        _cleanup_(config_line_reader_done) ConfigLineReader reader = {};
+        _cleanup_(config_file_freep) ConfigFile *c = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        int r;
+
+        assert(filename);
+        assert(ret);
+
+        /* Reads the file and splits it into its logical lines, the way config_parse() would, with comments
+         * and empty lines dropped and continuation lines joined, so that it can later be applied with
+         * config_parse_file() without touching the file again. This does not log and does not touch any
+         * global state, and hence may be called from any thread. */
 
-                continuation = mfree(continuation);
+        f = fopen(filename, "re");
+        if (!f)
+                return -errno;
+
+        c = new(ConfigFile, 1);
+        if (!c)
+                return -ENOMEM;
+
+        *c = (ConfigFile) {
+                .filename = strdup(filename),
+        };
+        if (!c->filename)
+                return -ENOMEM;
+
+        if (fstat(fileno(f), &c->st) < 0)
+                return -errno;
+
+        reader = (ConfigLineReader) {
+                .filename = filename,
+                .f = f,
+        };
+
+        for (;;) {
+                unsigned line;
+                char *p;
+
+                r = config_line_reader_next(&reader, &p, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                p = strstrip(p);
+                if (isempty(p))
+                        continue;
+
+                if (!GREEDY_REALLOC(c->lines, c->n_lines + 1))
+                        return -ENOMEM;
+
+                c->lines[c->n_lines] = (ConfigFileLine) {
+                        .line = line,
+                        .text = strdup(p),
+                };
+                if (!c->lines[c->n_lines].text)
+                        return -ENOMEM;
+
+                c->n_lines++;
         }
 
-        if (continuation) {
+        *ret = TAKE_PTR(c);
+        return 0;
+}
+
+int config_parse_file(
+                const char *unit,
+                const ConfigFile *c,
+                const char *sections,
+                ConfigItemLookup lookup,
+                const void *table,
+                ConfigParseFlags flags,
+                void *userdata,
+                struct stat *ret_stat) {
+
+        _cleanup_free_ char *section = NULL;
+        unsigned section_line = 0;
+        bool section_ignored = false;
+        int r;
+
+        assert(c);
+        assert(lookup);
+
+        /* Like config_parse(), but applies a file previously read with config_file_read(). The file may be
+         * applied any number of times. */
+
+        (void) stat_warn_permissions(c->filename, &c->st);
+
+        for (size_t i = 0; i < c->n_lines; i++) {
+                _cleanup_free_ char *l = NULL;
+
+                l = strdup(c->lines[i].text);
+                if (!l) {
+                        if (flags & CONFIG_PARSE_WARN)
+                                log_oom();
+                        return -ENOMEM;
+                }
+
                 r = parse_line(unit,
-                               filename,
-                               ++line,
+                               c->filename,
+                               c->lines[i].line,
                                sections,
                                lookup,
                                table,
@@ -435,17 +614,17 @@ int config_parse(
                                &section,
                                &section_line,
                                &section_ignored,
-                               continuation,
+                               l,
                                userdata);
                 if (r < 0) {
                         if (flags & CONFIG_PARSE_WARN)
-                                log_warning_errno(r, "%s:%u: Failed to parse file: %m", filename, line);
+                                log_warning_errno(r, "%s:%u: Failed to parse file: %m", c->filename, c->lines[i].line);
                         return r;
                 }
         }
 
         if (ret_stat)
-                *ret_stat = st;
+                *ret_stat = c->st;
 
         return 1;
 }
@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "analyze.h"
+#include "analyze-boot-profile.h"
+#include "boot-profile.h"
+#include "format-table.h"
+#include "path-util.h"
+#include "sort-util.h"
+#include "strv.h"
+#include "terminal-util.h"
+
+static const char* format_delta(char *buf, size_t l, usec_t before, usec_t after) {
+        char *p = buf;
+
+        assert(buf);
+        assert(l > 1);
+
+        if (after == before)
+                return strcpy(buf, "±0");
+
+        *(p++) = after > before ? '+' : '-';
+        return format_timespan(p, l - 1, after > before ? after - before : before - after, USEC_PER_MSEC) ? buf : NULL;
+}
+
+static usec_t boot_profile_unit_active(const BootProfileUnit *u) {
+        return u ? usec_add(u->activating, u->time) : USEC_INFINITY;
+}
+
+static int compare_units(char * const *a, char * const *b, BootProfile *profiles[2]) {
+        int r;
+
+        /* Order by when the units became active, in the newer boot first */
+        for (size_t i = 2; i > 0; i--) {
+                r = CMP(boot_profile_unit_active(boot_profile_get_unit(profiles[i-1], *a)),
+                        boot_profile_unit_active(boot_profile_get_unit(profiles[i-1], *b)));
+                if (r != 0)
+                        return r;
+        }
+
+        return strcmp(*a, *b);
+}
+
+static int table_add_unit_times(Table *table, const BootProfileUnit *u) {
+        _cleanup_free_ char *s = NULL;
+
+        if (!u)
+                return table_add_cell(table, NULL, TABLE_EMPTY, NULL);
+
+        if (asprintf(&s, "@%s +%s",
+                     FORMAT_TIMESPAN(u->activating, USEC_PER_MSEC),
+                     FORMAT_TIMESPAN(u->time, USEC_PER_MSEC)) < 0)
+                return -ENOMEM;
+
+        return table_add_cell(table, NULL, TABLE_STRING, s);
+}
+
+int verb_boot_profile(int argc, char *argv[], void *userdata) {
+        _cleanup_(boot_profile_freep) BootProfile *before = NULL, *after = NULL;
+        _cleanup_(table_unrefp) Table *table = NULL;
+        _cleanup_strv_free_ char **units = NULL;
+        const char *paths[2] = { BOOT_PROFILE_OLD_PATH, BOOT_PROFILE_PATH };
+        BootProfile *profiles[2] = {};
+        char buf[1 + FORMAT_TIMESPAN_MAX];
+        BootProfileUnit *u;
+        int r;
+
+        if (argc > 1)
+                paths[0] = argv[1];
+        if (argc > 2)
+                paths[1] = argv[2];
+
+        for (size_t i = 0; i < 2; i++) {
+                _cleanup_free_ char *p = NULL;
+
+                if (argc <= (int) i + 1 && arg_root) {
+                        p = path_join(arg_root, paths[i]);
+                        if (!p)
+                                return log_oom();
+                }
+
+                r = boot_profile_load(p ?: paths[i], i == 0 ? &before : &after);
+                if (r == -ENOENT && argc <= (int) i + 1)
+                        return log_error_errno(r, "No boot profile %s found, the system needs to boot %s.",
+                                               p ?: paths[i], i == 0 ? "twice" : "once");
+                if (r < 0)
+                        return log_error_errno(r, "Failed to load boot profile %s: %m", p ?: paths[i]);
+        }
+
+        profiles[0] = before;
+        profiles[1] = after;
+
+        /* Show the units that were on the critical chain in either boot */
+        for (size_t i = 0; i < 2; i++)
+                HASHMAP_FOREACH(u, profiles[i]->units) {
+                        if (!u->critical || strv_contains(units, u->name))
+                                continue;
+
+                        r = strv_extend(&units, u->name);
+                        if (r < 0)
+                                return log_oom();
+                }
+
+        typesafe_qsort_r(units, strv_length(units), compare_units, profiles);
+
+        table = table_new("unit", "before", "after", "change");
+        if (!table)
+                return log_oom();
+
+        STRV_FOREACH(n, units) {
+                const BootProfileUnit *a, *b;
+
+                a = boot_profile_get_unit(before, *n);
+                b = boot_profile_get_unit(after, *n);
+
+                r = table_add_cell(table, NULL, TABLE_STRING, *n);
+                if (r < 0)
+                        return table_log_add_error(r);
+
+                r = table_add_unit_times(table, a);
+                if (r < 0)
+                        return table_log_add_error(r);
+
+                r = table_add_unit_times(table, b);
+                if (r < 0)
+                        return table_log_add_error(r);
+
+                if (a && b)
+                        r = table_add_cell(table, NULL, TABLE_STRING,
+                                           format_delta(buf, sizeof(buf), boot_profile_unit_active(a), boot_profile_unit_active(b)));
+                else
+                        r = table_add_cell(table, NULL, TABLE_EMPTY, NULL);
+                if (r < 0)
+                        return table_log_add_error(r);
+        }
+
+        pager_open(arg_pager_flags);
+
+        for (size_t i = 0; i < 2; i++)
+                printf("%-7s %s in userspace, critical path scheduling %s%s%s\n",
+                       i == 0 ? "Before:" : "After:",
+                       FORMAT_TIMESPAN(profiles[i]->userspace_time, USEC_PER_MSEC),
+                       ansi_highlight(),
+                       profiles[i]->scheduling ? "enabled" : "disabled",
+                       ansi_normal());
+
+        printf("Change: %s\n\n", format_delta(buf, sizeof(buf), before->userspace_time, after->userspace_time));
+
+        r = table_print(table, NULL);
+        if (r < 0)
+                return r;
+
+        return EXIT_SUCCESS;
+}
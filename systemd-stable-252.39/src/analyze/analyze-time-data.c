@@ -37,6 +37,10 @@ int acquire_boot_times(sd_bus *bus, BootTimes **ret) {
                 { "InitRDGeneratorsFinishTimestampMonotonic", "t", NULL, offsetof(BootTimes, initrd_generators_finish_time) },
                 { "InitRDUnitsLoadStartTimestampMonotonic",   "t", NULL, offsetof(BootTimes, initrd_unitsload_start_time)   },
                 { "InitRDUnitsLoadFinishTimestampMonotonic",  "t", NULL, offsetof(BootTimes, initrd_unitsload_finish_time)  },
+                { "UnitsLoadParseUSec",                       "t", NULL, offsetof(BootTimes, unitsload_parse_time)          },
+                { "UnitsLoadApplyUSec",                       "t", NULL, offsetof(BootTimes, unitsload_apply_time)          },
+                { "UnitsLoadParsedFiles",                     "u", NULL, offsetof(BootTimes, unitsload_parsed_files)        },
+                { "UnitsLoadParseThreads",                    "u", NULL, offsetof(BootTimes, unitsload_parse_threads)       },
                 {},
         };
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
@@ -25,6 +25,10 @@ typedef struct BootTimes {
         usec_t initrd_generators_finish_time;
         usec_t initrd_unitsload_start_time;
         usec_t initrd_unitsload_finish_time;
+        usec_t unitsload_parse_time;
+        usec_t unitsload_apply_time;
+        uint32_t unitsload_parsed_files;
+        uint32_t unitsload_parse_threads;
 
         /*
          * If we're analyzing the user instance, all timestamps will be offset by its own start-up timestamp,
@@ -7,6 +7,7 @@
 int verb_time(int argc, char *argv[], void *userdata) {
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         _cleanup_free_ char *buf = NULL;
+        BootTimes *t;
         int r;
 
         r = acquire_bus(&bus, NULL);
@@ -18,5 +19,20 @@ int verb_time(int argc, char *argv[], void *userdata) {
                 return r;
 
         puts(buf);
+
+        r = acquire_boot_times(bus, &t);
+        if (r < 0)
+                return r;
+
+        /* Older managers don't know these */
+        if (t->unitsload_parse_time > 0 || t->unitsload_apply_time > 0) {
+                printf("Loading units took %s (", FORMAT_TIMESPAN(t->unitsload_parse_time + t->unitsload_apply_time, USEC_PER_MSEC));
+                if (t->unitsload_parsed_files > 0)
+                        printf("reading %" PRIu32 " files on %" PRIu32 " threads %s + ",
+                               t->unitsload_parsed_files, t->unitsload_parse_threads,
+                               FORMAT_TIMESPAN(t->unitsload_parse_time, USEC_PER_MSEC));
+                printf("applying %s).\n", FORMAT_TIMESPAN(t->unitsload_apply_time, USEC_PER_MSEC));
+        }
+
         return EXIT_SUCCESS;
 }
@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "sd-bus.h"
+
+#include "analyze.h"
+#include "analyze-trace.h"
+#include "bus-error.h"
+#include "bus-locator.h"
+#include "hashmap.h"
+#include "json.h"
+
+/* Converts the phases recorded by the service manager into the Chrome trace event format, which is
+ * understood by chrome://tracing and Perfetto: one complete ("X") event per phase, with one track per
+ * unit, named with a "thread_name" metadata event. */
+
+static int trace_event_add(JsonVariant ***events, size_t *n_events, JsonVariant *v) {
+        assert(events);
+        assert(n_events);
+
+        if (!GREEDY_REALLOC(*events, *n_events + 1))
+                return -ENOMEM;
+
+        (*events)[(*n_events)++] = json_variant_ref(v);
+        return 0;
+}
+
+static int trace_build_json(sd_bus_message *reply, JsonVariant **ret) {
+        _cleanup_hashmap_free_ Hashmap *tracks = NULL;
+        JsonVariant **events = NULL;
+        size_t n_events = 0;
+        const char *unit, *phase;
+        uint64_t begin, end;
+        uint32_t pid;
+        int r;
+
+        assert(reply);
+        assert(ret);
+
+        r = sd_bus_message_enter_container(reply, 'a', "(ssutt)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_read(reply, "(ssutt)", &unit, &phase, &pid, &begin, &end)) > 0) {
+                _cleanup_(json_variant_unrefp) JsonVariant *e = NULL;
+                unsigned track;
+
+                track = PTR_TO_UINT(hashmap_get(tracks, unit));
+                if (track == 0) {
+                        _cleanup_(json_variant_unrefp) JsonVariant *m = NULL;
+
+                        track = hashmap_size(tracks) + 1;
+                        r = hashmap_ensure_put(&tracks, &string_hash_ops, unit, UINT_TO_PTR(track));
+                        if (r < 0) {
+                                r = log_oom();
+                                goto finalize;
+                        }
+
+                        r = json_build(&m, JSON_BUILD_OBJECT(
+                                                       JSON_BUILD_PAIR_STRING("name", "thread_name"),
+                                                       JSON_BUILD_PAIR_STRING("ph", "M"),
+                                                       JSON_BUILD_PAIR_UNSIGNED("pid", 1),
+                                                       JSON_BUILD_PAIR_UNSIGNED("tid", track),
+                                                       JSON_BUILD_PAIR_OBJECT("args",
+                                                                              JSON_BUILD_PAIR_STRING("name", unit))));
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to build JSON data: %m");
+                                goto finalize;
+                        }
+
+                        r = trace_event_add(&events, &n_events, m);
+                        if (r < 0) {
+                                r = log_oom();
+                                goto finalize;
+                        }
+                }
+
+                r = json_build(&e, JSON_BUILD_OBJECT(
+                                               JSON_BUILD_PAIR_STRING("name", phase),
+                                               JSON_BUILD_PAIR_STRING("cat", pid > 0 ? "process" : "manager"),
+                                               JSON_BUILD_PAIR_STRING("ph", "X"),
+                                               JSON_BUILD_PAIR_UNSIGNED("ts", begin),
+                                               JSON_BUILD_PAIR_UNSIGNED("dur", end - begin),
+                                               JSON_BUILD_PAIR_UNSIGNED("pid", 1),
+                                               JSON_BUILD_PAIR_UNSIGNED("tid", track),
+                                               JSON_BUILD_PAIR_OBJECT("args",
+                                                                      JSON_BUILD_PAIR_STRING("unit", unit),
+                                                                      JSON_BUILD_PAIR_UNSIGNED_NON_ZERO("pid", pid))));
+                if (r < 0) {
+                        log_error_errno(r, "Failed to build JSON data: %m");
+                        goto finalize;
+                }
+
+                r = trace_event_add(&events, &n_events, e);
+                if (r < 0) {
+                        r = log_oom();
+                        goto finalize;
+                }
+        }
+        if (r < 0) {
+                bus_log_parse_error(r);
+                goto finalize;
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0) {
+                bus_log_parse_error(r);
+                goto finalize;
+        }
+
+        r = json_build(ret, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("traceEvents", JSON_BUILD_VARIANT_ARRAY(events, n_events)),
+                                       JSON_BUILD_PAIR_STRING("displayTimeUnit", "ms")));
+        if (r < 0)
+                log_error_errno(r, "Failed to build JSON data: %m");
+
+finalize:
+        json_variant_unref_many(events, n_events);
+        free(events);
+        return r;
+}
+
+int verb_trace(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        int r;
+
+        r = acquire_bus(&bus, NULL);
+        if (r < 0)
+                return bus_log_connect_error(r, arg_transport);
+
+        r = bus_call_method(bus, bus_systemd_mgr, "DumpTrace", &error, &reply, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to call DumpTrace: %s", bus_error_message(&error, r));
+
+        r = trace_build_json(reply, &v);
+        if (r < 0)
+                return r;
+
+        json_variant_dump(v, arg_json_format_flags == JSON_FORMAT_OFF ? JSON_FORMAT_NEWLINE : arg_json_format_flags, stdout, NULL);
+        return EXIT_SUCCESS;
+}
@@ -14,6 +14,7 @@
 #include "alloc-util.h"
 #include "analyze.h"
 #include "analyze-blame.h"
+#include "analyze-boot-profile.h"
 #include "analyze-calendar.h"
 #include "analyze-capability.h"
 #include "analyze-cat-config.h"
@@ -33,6 +34,7 @@
 #include "analyze-time-data.h"
 #include "analyze-timespan.h"
 #include "analyze-timestamp.h"
+#include "analyze-trace.h"
 #include "analyze-unit-files.h"
 #include "analyze-unit-paths.h"
 #include "analyze-compare-versions.h"
@@ -187,8 +189,12 @@ static int help(int argc, char *argv[], void *userdata) {
                "                             time to init\n"
                "  critical-chain [UNIT...]   Print a tree of the time critical chain\n"
                "                             of units\n"
+               "  boot-profile [BEFORE [AFTER]]\n"
+               "                             Compare the critical chains of two boots\n"
                "  plot                       Output SVG graphic showing service\n"
                "                             initialization\n"
+               "  trace                      Output phases of jobs and process\n"
+               "                             executions as Chrome trace JSON\n"
                "  dot [UNIT...]              Output dependency graph in %s format\n"
                "  dump [PATTERN...]          Output state serialization of service\n"
                "                             manager\n"
@@ -497,9 +503,9 @@ static int parse_argv(int argc, char *argv[]) {
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Option --offline= is only supported for security right now.");
 
-        if (arg_json_format_flags != JSON_FORMAT_OFF && !STRPTR_IN_SET(argv[optind], "security", "inspect-elf"))
+        if (arg_json_format_flags != JSON_FORMAT_OFF && !STRPTR_IN_SET(argv[optind], "security", "inspect-elf", "trace"))
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
-                                       "Option --json= is only supported for security and inspect-elf right now.");
+                                       "Option --json= is only supported for security, inspect-elf and trace right now.");
 
         if (arg_threshold != 100 && !streq_ptr(argv[optind], "security"))
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
@@ -548,7 +554,9 @@ static int run(int argc, char *argv[]) {
                 { "time",              VERB_ANY, 1,        VERB_DEFAULT, verb_time              },
                 { "blame",             VERB_ANY, 1,        0,            verb_blame             },
                 { "critical-chain",    VERB_ANY, VERB_ANY, 0,            verb_critical_chain    },
+                { "boot-profile",      VERB_ANY, 3,        0,            verb_boot_profile      },
                 { "plot",              VERB_ANY, 1,        0,            verb_plot              },
+                { "trace",             VERB_ANY, 1,        0,            verb_trace             },
                 { "dot",               VERB_ANY, VERB_ANY, 0,            verb_dot               },
                 /* ↓ The following seven verbs are deprecated, from here … ↓ */
                 { "log-level",         VERB_ANY, 2,        0,            verb_log_control       },
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <linux/oom.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -1474,6 +1475,88 @@ int namespace_fork(
         return 1;
 }
 
+#define VFORK_STACK_SIZE (64U * 1024U)
+
+typedef struct VforkChild {
+        int (*func)(void *userdata);
+        void *userdata;
+} VforkChild;
+
+static int vfork_trampoline(void *p) {
+        VforkChild *c = ASSERT_PTR(p);
+
+        /* We share the address space with our parent, hence any signal handler it installed would run on
+         * our borrowed stack and poke at its data. Demote them all to SIG_DFL before unblocking anything,
+         * ignored signals are left as they are, like execve() would. */
+        for (int sig = 1; sig < _NSIG; sig++) {
+                struct sigaction sa;
+
+                if (IN_SET(sig, SIGKILL, SIGSTOP))
+                        continue;
+
+                if (sigaction(sig, NULL, &sa) < 0)
+                        continue;
+
+                if (sa.sa_handler == SIG_DFL || sa.sa_handler == SIG_IGN)
+                        continue;
+
+                (void) sigaction(sig, &(const struct sigaction) { .sa_handler = SIG_DFL }, NULL);
+        }
+
+        _exit(c->func(c->userdata));
+}
+
+int safe_vfork(int (*func)(void *userdata), void *userdata, pid_t *ret_pid) {
+        VforkChild c = {
+                .func = func,
+                .userdata = userdata,
+        };
+        sigset_t ss, saved_ss;
+        uint8_t *stack, *top;
+        pid_t pid;
+        int r;
+
+        assert(func);
+        assert(ret_pid);
+
+        /* Spawns a child with clone(CLONE_VM|CLONE_VFORK), i.e. without copying our page tables, which makes
+         * the cost of spawning independent of how large our address space is. The child runs func() on a
+         * small private stack while we are suspended, and must end in execve() or return an exit status.
+         * Since all memory is shared, func() must stick to plain system calls: no memory allocation, no
+         * logging, no getpid_cached() (use raw_getpid()), and no changes to global state. All signals are
+         * blocked when func() is entered, it needs to reset the mask itself. */
+
+        stack = mmap(NULL, VFORK_STACK_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED)
+                return -errno;
+
+#ifdef __hppa__
+        top = stack; /* The stack grows upwards here */
+#else
+        top = stack + VFORK_STACK_SIZE;
+#endif
+
+        assert_se(sigfillset(&ss) >= 0);
+        if (sigprocmask(SIG_SETMASK, &ss, &saved_ss) < 0) {
+                (void) munmap(stack, VFORK_STACK_SIZE);
+                return -errno;
+        }
+
+        pid = clone(vfork_trampoline, top, CLONE_VM|CLONE_VFORK|SIGCHLD, &c);
+
+        /* By the time we get here the child either called execve() or exited. */
+        r = pid < 0 ? -errno : 0;
+
+        assert_se(sigprocmask(SIG_SETMASK, &saved_ss, NULL) >= 0);
+        (void) munmap(stack, VFORK_STACK_SIZE);
+
+        if (r < 0)
+                return r;
+
+        *ret_pid = pid;
+        return 0;
+}
+
 int set_oom_score_adjust(int value) {
         char t[DECIMAL_STR_MAX(int)];
 
@@ -161,6 +161,8 @@ static inline int safe_fork(const char *name, ForkFlags flags, pid_t *ret_pid) {
 
 int namespace_fork(const char *outer_name, const char *inner_name, const int except_fds[], size_t n_except_fds, ForkFlags flags, int pidns_fd, int mntns_fd, int netns_fd, int userns_fd, int root_fd, pid_t *ret_pid);
 
+int safe_vfork(int (*func)(void *userdata), void *userdata, pid_t *ret_pid);
+
 int set_oom_score_adjust(int value);
 int get_oom_score_adjust(int *ret);
 
@@ -11,6 +11,7 @@
 #include "set.h"
 #include "special.h"
 #include "stat-util.h"
+#include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
 #include "unit-file.h"
@@ -369,12 +370,198 @@ int unit_file_resolve_symlink(
         return !tail;  /* true if linked unit file */
 }
 
-int unit_file_build_name_map(
+void unit_file_dir_done(UnitFileDir *d) {
+        assert(d);
+
+        for (size_t i = 0; i < d->n_entries; i++) {
+                free(d->entries[i].name);
+                free(d->entries[i].destination);
+        }
+
+        d->entries = mfree(d->entries);
+        d->n_entries = 0;
+        d->path = mfree(d->path);
+}
+
+int unit_file_dir_add_entry(
+                UnitFileDir *d,
+                UnitFileDirEntryType type,
+                const char *name,
+                const char *destination,
+                int resolve_error) {
+
+        _cleanup_free_ char *n = NULL, *dst = NULL;
+
+        assert(d);
+        assert(type >= 0 && type < _UNIT_FILE_DIR_ENTRY_TYPE_MAX);
+        assert(name);
+        assert(resolve_error <= 0);
+
+        n = strdup(name);
+        if (!n)
+                return -ENOMEM;
+
+        if (destination) {
+                dst = strdup(destination);
+                if (!dst)
+                        return -ENOMEM;
+        }
+
+        if (!GREEDY_REALLOC(d->entries, d->n_entries + 1))
+                return -ENOMEM;
+
+        d->entries[d->n_entries++] = (UnitFileDirEntry) {
+                .type = type,
+                .name = TAKE_PTR(n),
+                .destination = TAKE_PTR(dst),
+                .resolve_error = resolve_error,
+        };
+
+        return 0;
+}
+
+UnitFileDirCache* unit_file_dir_cache_free(UnitFileDirCache *c) {
+        if (!c)
+                return NULL;
+
+        for (size_t i = 0; i < c->n_dirs; i++)
+                unit_file_dir_done(c->dirs + i);
+
+        free(c->dirs);
+        free(c->root_dir);
+        strv_free(c->expanded_search_path);
+        return mfree(c);
+}
+
+int unit_file_dir_cache_take(UnitFileDirCache *c, UnitFileDir *d) {
+        assert(c);
+        assert(d);
+        assert(d->path);
+
+        /* Moves the directory into the cache, leaving an empty object behind. */
+
+        if (!GREEDY_REALLOC(c->dirs, c->n_dirs + 1))
+                return -ENOMEM;
+
+        c->dirs[c->n_dirs++] = *d;
+        *d = (UnitFileDir) {};
+        return 0;
+}
+
+static UnitFileDir* unit_file_dir_cache_find(UnitFileDirCache *c, const char *path) {
+        assert(path);
+
+        if (!c)
+                return NULL;
+
+        for (size_t i = 0; i < c->n_dirs; i++)
+                if (path_equal(c->dirs[i].path, path))
+                        return c->dirs + i;
+
+        return NULL;
+}
+
+static bool unit_file_dir_matches(const UnitFileDir *d, const struct stat *st) {
+        assert(d);
+
+        /* A NULL stat means that the directory does not exist (anymore). */
+
+        if (!st)
+                return !d->exists;
+
+        return d->exists &&
+                d->dev == st->st_dev &&
+                d->ino == st->st_ino &&
+                d->mtime == timespec_load_nsec(&st->st_mtim);
+}
+
+static int unit_file_dir_scan(DIR *d, bool want_dirs, UnitFileDir *ret) {
+        int r;
+
+        assert(d);
+        assert(ret);
+        assert(ret->path);
+
+        /* Collects the entries of a unit directory we care about. Symlinks to units are not resolved here,
+         * since that is only necessary for names that no directory of higher priority provides. */
+
+        FOREACH_DIRENT_ALL(de, d, log_warning_errno(errno, "Failed to read \"%s\", ignoring: %m", ret->path)) {
+                UnitFileDirEntryType type;
+
+                /* We only care about valid units and dirs with certain suffixes, let's ignore the
+                 * rest. */
+
+                if (de->d_type == DT_REG) {
+
+                        /* Accept a regular file whose name is a valid unit file name. */
+                        if (!unit_name_is_valid(de->d_name, UNIT_NAME_ANY))
+                                continue;
+
+                        type = UNIT_FILE_DIR_ENTRY_UNIT;
+
+                } else if (de->d_type == DT_DIR) {
+
+                        if (!want_dirs) /* Skip directories early unless path_cache is requested */
+                                continue;
+
+                        r = directory_name_is_valid(de->d_name);
+                        if (r < 0)
+                                return r;
+                        if (r == 0)
+                                continue;
+
+                        type = UNIT_FILE_DIR_ENTRY_DIRECTORY;
+
+                } else if (de->d_type == DT_LNK) {
+
+                        /* Accept a symlink file whose name is a valid unit file name or
+                         * ending in .wants/, .requires/ or .d/. */
+
+                        if (!unit_name_is_valid(de->d_name, UNIT_NAME_ANY)) {
+                                _cleanup_free_ char *target = NULL;
+
+                                if (!want_dirs) /* Skip symlink to a directory early unless path_cache is requested */
+                                        continue;
+
+                                r = directory_name_is_valid(de->d_name);
+                                if (r < 0)
+                                        return r;
+                                if (r == 0)
+                                        continue;
+
+                                r = readlinkat_malloc(dirfd(d), de->d_name, &target);
+                                if (r < 0) {
+                                        log_warning_errno(r, "Failed to read symlink %s/%s, ignoring: %m",
+                                                          ret->path, de->d_name);
+                                        continue;
+                                }
+
+                                r = is_dir(target, /* follow = */ true);
+                                if (r <= 0)
+                                        continue;
+
+                                type = UNIT_FILE_DIR_ENTRY_DIRECTORY;
+                        } else
+                                type = UNIT_FILE_DIR_ENTRY_SYMLINK;
+
+                } else
+                        continue;
+
+                r = unit_file_dir_add_entry(ret, type, de->d_name, NULL, 0);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        return 0;
+}
+
+int unit_file_build_name_map_full(
                 const LookupPaths *lp,
                 uint64_t *cache_timestamp_hash,
                 Hashmap **unit_ids_map,
                 Hashmap **unit_names_map,
-                Set **path_cache) {
+                Set **path_cache,
+                UnitFileDirCache **dir_cache) {
 
         /* Build two mappings: any name → main unit (i.e. the end result of symlink resolution), unit name →
          * all aliases (i.e. the entry for a given key is a list of all names which point to this key). The
@@ -384,14 +571,23 @@ int unit_file_build_name_map(
          *
          * At the same, build a cache of paths where to find units. The non-const parameters are for input
          * and output. Existing contents will be freed before the new contents are stored.
+         *
+         * If dir_cache is specified, directories that did not change since the snapshot in it was taken are
+         * not read again, and a snapshot of the current state is stored in it afterwards.
          */
 
         _cleanup_hashmap_free_ Hashmap *ids = NULL, *names = NULL;
         _cleanup_set_free_free_ Set *paths = NULL;
         _cleanup_strv_free_ char **expanded_search_path = NULL;
+        _cleanup_(unit_file_dir_cache_freep) UnitFileDirCache *new_cache = NULL;
+        UnitFileDirCache *old_cache = NULL;
         uint64_t timestamp_hash;
+        nsec_t start = 0;
         int r;
 
+        /* The snapshot is only complete if directories are looked at too */
+        assert(!dir_cache || path_cache);
+
         /* Before doing anything, check if the timestamp hash that was passed is still valid.
          * If yes, do nothing. */
         if (cache_timestamp_hash &&
@@ -407,6 +603,16 @@ int unit_file_build_name_map(
                         return log_oom();
         }
 
+        if (dir_cache) {
+                new_cache = new0(UnitFileDirCache, 1);
+                if (!new_cache)
+                        return log_oom();
+
+                /* Directories modified less than a second before we look at them might be modified again
+                 * without their mtime changing, hence we do not keep snapshots of those. */
+                start = now_nsec(CLOCK_REALTIME);
+        }
+
         /* Go over all our search paths, chase their symlinks and store the result in the
          * expanded_search_path list.
          *
@@ -445,77 +651,69 @@ int unit_file_build_name_map(
                         return log_oom();
         }
 
+        /* Symlinks are resolved relative to the expanded search path, hence entries from a snapshot taken
+         * with a different one cannot be used. */
+        if (dir_cache && *dir_cache &&
+            streq_ptr((*dir_cache)->root_dir, lp->root_dir) &&
+            strv_equal((*dir_cache)->expanded_search_path, expanded_search_path))
+                old_cache = *dir_cache;
+
         STRV_FOREACH(dir, lp->search_path) {
+                _cleanup_(unit_file_dir_done) UnitFileDir scanned = {};
                 _cleanup_closedir_ DIR *d = NULL;
+                _cleanup_close_ int dfd = -1;
+                UnitFileDir *ud;
+                struct stat st;
+                int stat_error = 0;
 
-                d = opendir(*dir);
-                if (!d) {
-                        if (errno != ENOENT)
-                                log_warning_errno(errno, "Failed to open \"%s\", ignoring: %m", *dir);
-                        continue;
-                }
-
-                FOREACH_DIRENT_ALL(de, d, log_warning_errno(errno, "Failed to read \"%s\", ignoring: %m", *dir)) {
-                        _unused_ _cleanup_free_ char *_filename_free = NULL;
-                        char *filename;
-                        _cleanup_free_ char *dst = NULL;
-                        bool symlink_to_dir = false;
-
-                        /* We only care about valid units and dirs with certain suffixes, let's ignore the
-                         * rest. */
-
-                        if (de->d_type == DT_REG) {
-
-                                /* Accept a regular file whose name is a valid unit file name. */
-                                if (!unit_name_is_valid(de->d_name, UNIT_NAME_ANY))
-                                        continue;
-
-                        } else if (de->d_type == DT_DIR) {
-
-                                if (!paths) /* Skip directories early unless path_cache is requested */
-                                        continue;
-
-                                r = directory_name_is_valid(de->d_name);
-                                if (r < 0)
-                                        return r;
-                                if (r == 0)
-                                        continue;
-
-                        } else if (de->d_type == DT_LNK) {
-
-                                /* Accept a symlink file whose name is a valid unit file name or
-                                 * ending in .wants/, .requires/ or .d/. */
+                /* The stat data is taken before the directory is read, so that the snapshot is considered
+                 * outdated if anything is modified concurrently. */
+                if (stat(*dir, &st) < 0)
+                        stat_error = -errno;
 
-                                if (!unit_name_is_valid(de->d_name, UNIT_NAME_ANY)) {
-                                        _cleanup_free_ char *target = NULL;
+                ud = unit_file_dir_cache_find(old_cache, *dir);
+                if (ud && IN_SET(stat_error, 0, -ENOENT) &&
+                    unit_file_dir_matches(ud, stat_error == 0 ? &st : NULL))
+                        new_cache->n_reused++;
+                else {
+                        ud = &scanned;
 
-                                        if (!paths) /* Skip symlink to a directory early unless path_cache is requested */
-                                                continue;
+                        ud->path = strdup(*dir);
+                        if (!ud->path)
+                                return log_oom();
 
-                                        r = directory_name_is_valid(de->d_name);
+                        d = opendir(*dir);
+                        if (!d) {
+                                if (errno != ENOENT)
+                                        log_warning_errno(errno, "Failed to open \"%s\", ignoring: %m", *dir);
+                                else if (new_cache && stat_error == -ENOENT) {
+                                        /* Remember that the directory does not exist */
+                                        r = unit_file_dir_cache_take(new_cache, ud);
                                         if (r < 0)
-                                                return r;
-                                        if (r == 0)
-                                                continue;
-
-                                        r = readlinkat_malloc(dirfd(d), de->d_name, &target);
-                                        if (r < 0) {
-                                                log_warning_errno(r, "Failed to read symlink %s/%s, ignoring: %m",
-                                                                  *dir, de->d_name);
-                                                continue;
-                                        }
+                                                return log_oom();
+                                }
+                                continue;
+                        }
 
-                                        r = is_dir(target, /* follow = */ true);
-                                        if (r <= 0)
-                                                continue;
+                        if (stat_error == 0) {
+                                ud->exists = true;
+                                ud->dev = st.st_dev;
+                                ud->ino = st.st_ino;
+                                ud->mtime = timespec_load_nsec(&st.st_mtim);
+                        }
 
-                                        symlink_to_dir = true;
-                                }
+                        r = unit_file_dir_scan(d, /* want_dirs= */ !!paths, ud);
+                        if (r < 0)
+                                return r;
+                }
 
-                        } else
-                                continue;
+                for (size_t i = 0; i < ud->n_entries; i++) {
+                        UnitFileDirEntry *e = ud->entries + i;
+                        _unused_ _cleanup_free_ char *_filename_free = NULL;
+                        char *filename;
+                        _cleanup_free_ char *dst = NULL;
 
-                        filename = path_join(*dir, de->d_name);
+                        filename = path_join(*dir, e->name);
                         if (!filename)
                                 return log_oom();
 
@@ -528,30 +726,44 @@ int unit_file_build_name_map(
                         } else
                                 _filename_free = filename; /* Make sure we free the filename. */
 
-                        if (de->d_type == DT_DIR || (de->d_type == DT_LNK && symlink_to_dir))
+                        if (e->type == UNIT_FILE_DIR_ENTRY_DIRECTORY)
                                 continue;
 
-                        assert(IN_SET(de->d_type, DT_REG, DT_LNK));
-
                         /* search_path is ordered by priority (highest first). If the name is already mapped
                          * to something (incl. itself), it means that we have already seen it, and we should
                          * ignore it here. */
-                        if (hashmap_contains(ids, de->d_name))
+                        if (hashmap_contains(ids, e->name))
                                 continue;
 
-                        if (de->d_type == DT_LNK) {
+                        if (e->type == UNIT_FILE_DIR_ENTRY_SYMLINK) {
                                 /* We don't explicitly check for alias loops here. unit_ids_map_get() which
                                  * limits the number of hops should be used to access the map. */
 
-                                r = unit_file_resolve_symlink(lp->root_dir, expanded_search_path,
-                                                              *dir, dirfd(d), de->d_name,
-                                                              /* resolve_destination_target= */ false,
-                                                              &dst);
-                                if (r == -ENOMEM)
-                                        return r;
-                                if (r < 0)  /* we ignore other errors here */
+                                if (!e->destination && e->resolve_error == 0) {
+                                        if (!d && dfd < 0) {
+                                                dfd = open(*dir, O_DIRECTORY|O_PATH|O_CLOEXEC);
+                                                if (dfd < 0) {
+                                                        log_warning_errno(errno, "Failed to open \"%s\", ignoring: %m", *dir);
+                                                        continue;
+                                                }
+                                        }
+
+                                        r = unit_file_resolve_symlink(lp->root_dir, expanded_search_path,
+                                                                      *dir, d ? dirfd(d) : dfd, e->name,
+                                                                      /* resolve_destination_target= */ false,
+                                                                      &e->destination);
+                                        if (r == -ENOMEM)
+                                                return r;
+                                        if (r < 0)
+                                                e->resolve_error = r;
+                                }
+                                if (e->resolve_error < 0)  /* we ignore other errors here */
                                         continue;
 
+                                dst = strdup(e->destination);
+                                if (!dst)
+                                        return log_oom();
+
                         } else {
                                 dst = TAKE_PTR(_filename_free); /* Grab the copy we made previously, if available. */
                                 if (!dst) {
@@ -563,16 +775,22 @@ int unit_file_build_name_map(
                                 log_debug("%s: normal unit file: %s", __func__, dst);
                         }
 
-                        _cleanup_free_ char *key = strdup(de->d_name);
+                        _cleanup_free_ char *key = strdup(e->name);
                         if (!key)
                                 return log_oom();
 
                         r = hashmap_ensure_put(&ids, &string_hash_ops_free_free, key, dst);
                         if (r < 0)
                                 return log_warning_errno(r, "Failed to add entry to hashmap (%s%s%s): %m",
-                                                         de->d_name, special_glyph(SPECIAL_GLYPH_ARROW_RIGHT), dst);
+                                                         e->name, special_glyph(SPECIAL_GLYPH_ARROW_RIGHT), dst);
                         key = dst = NULL;
                 }
+
+                if (new_cache && (ud != &scanned || (ud->exists && ud->mtime + NSEC_PER_SEC <= start))) {
+                        r = unit_file_dir_cache_take(new_cache, ud);
+                        if (r < 0)
+                                return log_oom();
+                }
         }
 
         /* Let's also put the names in the reverse db. */
@@ -619,6 +837,17 @@ int unit_file_build_name_map(
         if (cache_timestamp_hash)
                 *cache_timestamp_hash = timestamp_hash;
 
+        if (dir_cache) {
+                r = free_and_strdup(&new_cache->root_dir, lp->root_dir);
+                if (r < 0)
+                        return log_oom();
+
+                new_cache->expanded_search_path = TAKE_PTR(expanded_search_path);
+
+                unit_file_dir_cache_free(*dir_cache);
+                *dir_cache = TAKE_PTR(new_cache);
+        }
+
         hashmap_free_and_replace(*unit_ids_map, ids);
         hashmap_free_and_replace(*unit_names_map, names);
         if (path_cache)
@@ -627,6 +856,14 @@ int unit_file_build_name_map(
         return 1;
 }
 
+static const char* const unit_file_dir_entry_type_table[_UNIT_FILE_DIR_ENTRY_TYPE_MAX] = {
+        [UNIT_FILE_DIR_ENTRY_UNIT]      = "unit",
+        [UNIT_FILE_DIR_ENTRY_SYMLINK]   = "symlink",
+        [UNIT_FILE_DIR_ENTRY_DIRECTORY] = "directory",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(unit_file_dir_entry_type, UnitFileDirEntryType);
+
 static int add_name(
                 const char *unit_name,
                 Set **names,
@@ -0,0 +1,462 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "boot-profile.h"
+#include "extract-word.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "manager.h"
+#include "mkdir.h"
+#include "parse-util.h"
+#include "set.h"
+#include "special.h"
+#include "string-util.h"
+#include "tmpfile-util.h"
+#include "unit-name.h"
+#include "unit.h"
+#include "util.h"
+
+/* The profile is a text file. The first line is
+ *
+ *     userspace <usec> <scheduling>
+ *
+ * followed by one line per unit that was activated during the boot:
+ *
+ *     <unit> <activating usec> <activation time usec> <critical>
+ */
+
+static BootProfileUnit* boot_profile_unit_free(BootProfileUnit *u) {
+        if (!u)
+                return NULL;
+
+        free(u->name);
+        return mfree(u);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(BootProfileUnit*, boot_profile_unit_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(boot_profile_unit_hash_ops, char, string_hash_func, string_compare_func,
+                                              BootProfileUnit, boot_profile_unit_free);
+
+BootProfile* boot_profile_free(BootProfile *p) {
+        if (!p)
+                return NULL;
+
+        hashmap_free(p->units);
+        return mfree(p);
+}
+
+int boot_profile_new(BootProfile **ret) {
+        BootProfile *p;
+
+        assert(ret);
+
+        p = new0(BootProfile, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *ret = p;
+        return 0;
+}
+
+int boot_profile_add_unit(BootProfile *p, const char *name, usec_t activating, usec_t time, bool critical) {
+        _cleanup_(boot_profile_unit_freep) BootProfileUnit *u = NULL;
+        int r;
+
+        assert(p);
+        assert(name);
+
+        u = new(BootProfileUnit, 1);
+        if (!u)
+                return -ENOMEM;
+
+        *u = (BootProfileUnit) {
+                .name = strdup(name),
+                .activating = activating,
+                .time = time,
+                .critical = critical,
+        };
+        if (!u->name)
+                return -ENOMEM;
+
+        r = hashmap_ensure_put(&p->units, &boot_profile_unit_hash_ops, u->name, u);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(u);
+        return 0;
+}
+
+const BootProfileUnit* boot_profile_get_unit(const BootProfile *p, const char *name) {
+        assert(name);
+
+        if (!p)
+                return NULL;
+
+        return hashmap_get(p->units, name);
+}
+
+int boot_profile_load(const char *path, BootProfile **ret) {
+        _cleanup_(boot_profile_freep) BootProfile *p = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        bool header = true;
+        int r;
+
+        assert(path);
+        assert(ret);
+
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        r = boot_profile_new(&p);
+        if (r < 0)
+                return r;
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL, *name = NULL, *a = NULL, *b = NULL, *c = NULL;
+                usec_t activating, time;
+                const char *q;
+                int k;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                q = line;
+                r = extract_many_words(&q, NULL, 0, &name, &a, &b, &c, NULL);
+                if (r < 0)
+                        return r;
+
+                if (header) {
+                        if (r != 3 || !streq(name, "userspace"))
+                                return -EBADMSG;
+
+                        if (safe_atou64(a, &p->userspace_time) < 0)
+                                return -EBADMSG;
+
+                        k = parse_boolean(b);
+                        if (k < 0)
+                                return -EBADMSG;
+                        p->scheduling = k;
+
+                        header = false;
+                        continue;
+                }
+
+                if (r != 4 || !unit_name_is_valid(name, UNIT_NAME_PLAIN|UNIT_NAME_INSTANCE))
+                        return -EBADMSG;
+
+                if (safe_atou64(a, &activating) < 0 || safe_atou64(b, &time) < 0)
+                        return -EBADMSG;
+
+                k = parse_boolean(c);
+                if (k < 0)
+                        return -EBADMSG;
+
+                r = boot_profile_add_unit(p, name, activating, time, k);
+                if (r == -EEXIST)
+                        return -EBADMSG;
+                if (r < 0)
+                        return r;
+        }
+
+        if (header)
+                return -EBADMSG;
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+int boot_profile_save(const BootProfile *p, const char *path) {
+        _cleanup_(unlink_and_freep) char *temp = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        BootProfileUnit *u;
+        int r;
+
+        assert(p);
+        assert(path);
+
+        r = mkdir_parents(path, 0755);
+        if (r < 0)
+                return r;
+
+        r = fopen_temporary(path, &f, &temp);
+        if (r < 0)
+                return r;
+
+        (void) fchmod(fileno(f), 0644);
+
+        fprintf(f, "userspace " USEC_FMT " %s\n", p->userspace_time, yes_no(p->scheduling));
+
+        HASHMAP_FOREACH(u, p->units)
+                fprintf(f, "%s " USEC_FMT " " USEC_FMT " %s\n", u->name, u->activating, u->time, yes_no(u->critical));
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        if (rename(temp, path) < 0)
+                return -errno;
+
+        temp = mfree(temp);
+        return 0;
+}
+
+static bool manager_boot_profile_supported(Manager *m) {
+        assert(m);
+
+        /* Only the boot of the host system is profiled. The initrd's units are a different set of units,
+         * and it doesn't get to write to /var anyway. */
+        return MANAGER_IS_SYSTEM(m) &&
+                !MANAGER_IS_TEST_RUN(m) &&
+                !in_initrd();
+}
+
+void manager_load_boot_profile(Manager *m) {
+        int r;
+
+        assert(m);
+
+        /* Called when starting up, before the units are loaded. Note that this only has an effect if
+         * /var/lib/systemd/ is available at this point, i.e. if /var is not a separate file system. */
+
+        if (!m->critical_path_scheduling || !manager_boot_profile_supported(m))
+                return;
+
+        m->boot_profile = boot_profile_free(m->boot_profile);
+
+        r = boot_profile_load(BOOT_PROFILE_PATH, &m->boot_profile);
+        if (r < 0) {
+                log_full_errno(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, r,
+                               "Failed to load boot profile %s, not using critical path scheduling: %m",
+                               BOOT_PROFILE_PATH);
+                return;
+        }
+
+        /* Invalidate all weights calculated so far */
+        m->critical_path_generation++;
+
+        log_debug("Loaded boot profile with %u units, previous boot took %s in userspace.",
+                  hashmap_size(m->boot_profile->units),
+                  FORMAT_TIMESPAN(m->boot_profile->userspace_time, USEC_PER_MSEC));
+}
+
+static bool unit_activated_during_boot(Unit *u, usec_t userspace, usec_t finish) {
+        assert(u);
+
+        return u->inactive_exit_timestamp.monotonic >= userspace &&
+                u->active_enter_timestamp.monotonic >= u->inactive_exit_timestamp.monotonic &&
+                u->active_enter_timestamp.monotonic <= finish;
+}
+
+static int manager_find_critical_chain(Manager *m, usec_t userspace, usec_t finish, Set **ret) {
+        _cleanup_set_free_ Set *chain = NULL;
+        Unit *u;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        /* Follows the same logic as "systemd-analyze critical-chain": starting from the default target,
+         * always go to the unit we are ordered after that became active last. */
+
+        u = manager_get_unit(m, SPECIAL_DEFAULT_TARGET);
+        while (u) {
+                Unit *other, *next = NULL;
+
+                r = set_ensure_put(&chain, NULL, u);
+                if (r < 0)
+                        return r;
+                if (r == 0) /* ordering cycle */
+                        break;
+
+                UNIT_FOREACH_DEPENDENCY(other, u, UNIT_ATOM_AFTER) {
+                        if (!unit_activated_during_boot(other, userspace, finish))
+                                continue;
+
+                        if (!next || other->active_enter_timestamp.monotonic > next->active_enter_timestamp.monotonic)
+                                next = other;
+                }
+
+                u = next;
+        }
+
+        *ret = TAKE_PTR(chain);
+        return 0;
+}
+
+void manager_save_boot_profile(Manager *m) {
+        _cleanup_(boot_profile_freep) BootProfile *p = NULL;
+        _cleanup_set_free_ Set *chain = NULL;
+        usec_t userspace, finish;
+        const char *k;
+        Unit *u;
+        int r;
+
+        assert(m);
+
+        /* Called when the boot finished. Records the activation times of all units activated during the
+         * boot, if critical path scheduling is enabled. The profile of the previous boot is kept, so that the
+         * two can be compared. */
+
+        if (!m->critical_path_scheduling || !manager_boot_profile_supported(m))
+                return;
+
+        userspace = m->timestamps[MANAGER_TIMESTAMP_USERSPACE].monotonic;
+        finish = m->timestamps[MANAGER_TIMESTAMP_FINISH].monotonic;
+        if (finish < userspace)
+                return;
+
+        r = boot_profile_new(&p);
+        if (r < 0)
+                goto fail;
+
+        p->userspace_time = finish - userspace;
+        /* Whether this boot was scheduled according to the profile of the previous one */
+        p->scheduling = !!m->boot_profile;
+
+        r = manager_find_critical_chain(m, userspace, finish, &chain);
+        if (r < 0)
+                goto fail;
+
+        HASHMAP_FOREACH_KEY(u, k, m->units) {
+                if (!streq(k, u->id)) /* skip aliases */
+                        continue;
+
+                if (!unit_activated_during_boot(u, userspace, finish))
+                        continue;
+
+                r = boot_profile_add_unit(p, u->id,
+                                          u->inactive_exit_timestamp.monotonic - userspace,
+                                          u->active_enter_timestamp.monotonic - u->inactive_exit_timestamp.monotonic,
+                                          set_contains(chain, u));
+                if (r < 0)
+                        goto fail;
+        }
+
+        if (rename(BOOT_PROFILE_PATH, BOOT_PROFILE_OLD_PATH) < 0 && errno != ENOENT)
+                log_debug_errno(errno, "Failed to rename %s, ignoring: %m", BOOT_PROFILE_PATH);
+
+        r = boot_profile_save(p, BOOT_PROFILE_PATH);
+        if (r < 0)
+                goto fail;
+
+        log_debug("Saved boot profile with %u units.", hashmap_size(p->units));
+        return;
+
+fail:
+        log_debug_errno(r, "Failed to save boot profile, ignoring: %m");
+}
+
+typedef struct CriticalPathFrame {
+        Unit *unit;
+        uint64_t before_types;
+        size_t next_edge;
+        usec_t longest;
+} CriticalPathFrame;
+
+static bool critical_path_push(CriticalPathFrame **frames, size_t *n_frames, Unit *u) {
+        assert(frames);
+        assert(n_frames);
+        assert(u);
+
+        if (!GREEDY_REALLOC(*frames, *n_frames + 1))
+                return false;
+
+        /* USEC_INFINITY means we are still calculating it */
+        u->critical_path_generation = u->manager->critical_path_generation;
+        u->critical_path_weight = USEC_INFINITY;
+
+        (*frames)[(*n_frames)++] = (CriticalPathFrame) {
+                .unit = u,
+                .before_types = unit_dependency_types_from_atom(UNIT_ATOM_BEFORE) & u->dependencies.types,
+        };
+
+        return true;
+}
+
+usec_t unit_critical_path_weight(Unit *u) {
+        _cleanup_free_ CriticalPathFrame *frames = NULL;
+        size_t n_frames = 0;
+        Manager *m;
+
+        assert(u);
+
+        /* Returns the sum of the activation times of the previous boot along the longest chain of units
+         * ordered after this unit, including the unit itself. The earlier such a unit is started, the
+         * earlier the end of the chain can be reached. The units along the way are visited depth-first
+         * without recursion, so that long ordering chains cannot overflow our stack, and the weights of all
+         * of them are remembered until the boot profile changes. */
+
+        m = u->manager;
+
+        if (!m->boot_profile)
+                return 0;
+
+        if (u->critical_path_generation == m->critical_path_generation)
+                /* We ran into an ordering cycle if we are still calculating it */
+                return u->critical_path_weight == USEC_INFINITY ? 0 : u->critical_path_weight;
+
+        if (!critical_path_push(&frames, &n_frames, u))
+                goto oom;
+
+        while (n_frames > 0) {
+                CriticalPathFrame *f = frames + n_frames - 1;
+                const BootProfileUnit *p;
+                Unit *other = NULL;
+
+                while (f->before_types != 0 && f->next_edge < f->unit->dependencies.n_edges) {
+                        const UnitDependencyEdge *e = f->unit->dependencies.edges + f->next_edge++;
+
+                        if (f->before_types & UNIT_DEPENDENCY_TYPE_BIT(e->type)) {
+                                other = e->other;
+                                break;
+                        }
+                }
+
+                if (other) {
+                        if (other->critical_path_generation != m->critical_path_generation) {
+                                /* Descend */
+                                if (!critical_path_push(&frames, &n_frames, other))
+                                        goto oom;
+                        } else if (other->critical_path_weight != USEC_INFINITY)
+                                f->longest = MAX(f->longest, other->critical_path_weight);
+
+                        continue;
+                }
+
+                /* All units ordered after this one are done, return to the caller */
+                p = boot_profile_get_unit(m->boot_profile, f->unit->id);
+                f->unit->critical_path_weight = usec_add(p ? p->time : 0, f->longest);
+
+                n_frames--;
+                if (n_frames > 0)
+                        frames[n_frames - 1].longest = MAX(frames[n_frames - 1].longest, f->unit->critical_path_weight);
+        }
+
+        return u->critical_path_weight;
+
+oom:
+        /* Calculate the weights of the units we didn't finish again next time */
+        for (size_t i = 0; i < n_frames; i++)
+                frames[i].unit->critical_path_generation = m->critical_path_generation - 1;
+
+        log_oom_debug();
+        return 0;
+}
+
+bool unit_on_critical_path(Unit *u) {
+        const BootProfileUnit *p;
+
+        assert(u);
+
+        if (!u->manager->critical_path_scheduling)
+                return false;
+
+        p = boot_profile_get_unit(u->manager->boot_profile, u->id);
+        return p && p->critical;
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdbool.h>
+
+#include "hashmap.h"
+#include "time-util.h"
+
+typedef struct Manager Manager;
+typedef struct Unit Unit;
+
+/* The unit activation times of the previous boot, recorded when the boot finished. If critical path
+ * scheduling is enabled they are used to prefer jobs of units that many other units are ordered after
+ * (transitively), and to give the units on the critical chain of the previous boot a larger CPU and IO
+ * weight while booting. */
+
+#define BOOT_PROFILE_PATH "/var/lib/systemd/boot-profile"
+#define BOOT_PROFILE_OLD_PATH "/var/lib/systemd/boot-profile.old"
+
+typedef struct BootProfileUnit {
+        char *name;
+        usec_t activating; /* relative to the start of userspace */
+        usec_t time;       /* how long the unit took to activate */
+        bool critical;     /* whether the unit was on the critical chain to the default target */
+} BootProfileUnit;
+
+typedef struct BootProfile {
+        usec_t userspace_time;
+        bool scheduling;   /* whether the boot was scheduled according to the profile of the boot before */
+        Hashmap *units;
+} BootProfile;
+
+BootProfile* boot_profile_free(BootProfile *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(BootProfile*, boot_profile_free);
+
+int boot_profile_new(BootProfile **ret);
+int boot_profile_add_unit(BootProfile *p, const char *name, usec_t activating, usec_t time, bool critical);
+const BootProfileUnit* boot_profile_get_unit(const BootProfile *p, const char *name);
+
+int boot_profile_load(const char *path, BootProfile **ret);
+int boot_profile_save(const BootProfile *p, const char *path);
+
+void manager_load_boot_profile(Manager *m);
+void manager_save_boot_profile(Manager *m);
+
+usec_t unit_critical_path_weight(Unit *u);
+bool unit_on_critical_path(Unit *u);
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/mman.h>
+
+#include "alloc-util.h"
+#include "boot-trace.h"
+#include "manager.h"
+#include "string-util.h"
+
+int boot_trace_new(BootTrace **ret) {
+        void *p;
+
+        assert(ret);
+
+        /* Pages are only populated once we get to them, hence the size of the ring costs nothing as long as
+         * only a few units are started. */
+        p = mmap(NULL, sizeof(BootTrace), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        *ret = p;
+        return 0;
+}
+
+BootTrace* boot_trace_free(BootTrace *t) {
+        if (!t)
+                return NULL;
+
+        (void) munmap(t, sizeof(BootTrace));
+        return NULL;
+}
+
+void boot_trace_record(BootTrace *t, const char *unit, const char *phase, pid_t pid, usec_t begin, usec_t end) {
+        BootTraceEntry *e;
+        uint64_t idx;
+
+        if (!t)
+                return;
+
+        assert(phase);
+
+        if (!timestamp_is_set(begin)) /* e.g. a process we didn't fork off ourselves */
+                return;
+
+        /* This might be called concurrently from the manager and any number of its children, hence claim a
+         * slot atomically, and mark it as invalid while we are writing to it. If the ring wrapped around so
+         * far that somebody else is writing to the same slot at the same time, readers will skip it. */
+
+        idx = __atomic_fetch_add(&t->head, 1, __ATOMIC_RELAXED);
+        e = t->entries + idx % BOOT_TRACE_ENTRIES_MAX;
+
+        __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        e->begin = begin;
+        e->end = MAX(begin, end);
+        e->pid = pid;
+        strncpy(e->phase, phase, sizeof(e->phase) - 1);
+        e->phase[sizeof(e->phase) - 1] = 0;
+        strncpy(e->unit, strempty(unit), sizeof(e->unit) - 1);
+        e->unit[sizeof(e->unit) - 1] = 0;
+
+        __atomic_store_n(&e->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+int boot_trace_get(const BootTrace *t, BootTraceEntry **ret, size_t *ret_n) {
+        _cleanup_free_ BootTraceEntry *entries = NULL;
+        uint64_t head, first;
+        size_t n = 0;
+
+        assert(ret);
+        assert(ret_n);
+
+        /* Returns a copy of the records currently in the ring, oldest first */
+
+        if (!t) {
+                *ret = NULL;
+                *ret_n = 0;
+                return 0;
+        }
+
+        head = __atomic_load_n(&t->head, __ATOMIC_ACQUIRE);
+        first = head > BOOT_TRACE_ENTRIES_MAX ? head - BOOT_TRACE_ENTRIES_MAX : 0;
+
+        entries = new(BootTraceEntry, head - first);
+        if (!entries && head > first)
+                return -ENOMEM;
+
+        for (uint64_t i = first; i < head; i++) {
+                const BootTraceEntry *e = t->entries + i % BOOT_TRACE_ENTRIES_MAX;
+                BootTraceEntry copy;
+
+                if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != i + 1)
+                        continue; /* Still being written, or already overwritten */
+
+                copy = *e;
+
+                /* Make sure it wasn't rewritten while we copied it */
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != i + 1)
+                        continue;
+
+                copy.seq = i + 1;
+                entries[n++] = copy;
+        }
+
+        *ret = TAKE_PTR(entries);
+        *ret_n = n;
+        return 0;
+}
+
+void manager_set_boot_trace(Manager *m, bool b) {
+        int r;
+
+        assert(m);
+
+        if (!b) {
+                m->boot_trace = boot_trace_free(m->boot_trace);
+                return;
+        }
+
+        if (m->boot_trace)
+                return;
+
+        r = boot_trace_new(&m->boot_trace);
+        if (r < 0)
+                log_warning_errno(r, "Failed to allocate boot trace buffer, not recording phases of jobs: %m");
+}
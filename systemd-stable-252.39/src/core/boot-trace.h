@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "macro.h"
+#include "time-util.h"
+
+typedef struct Manager Manager;
+
+/* A ring buffer of timestamped phases of jobs and process executions, i.e. where the time went while
+ * starting units. It's a shared anonymous mapping, so that the children we fork off can record the phases
+ * of setting up the execution environment in it too, until they execve(). Only allocated if BootTrace= is
+ * enabled, all recording functions are NOPs otherwise. */
+
+#define BOOT_TRACE_ENTRIES_MAX 8192U
+
+typedef struct BootTraceEntry {
+        uint64_t seq;        /* index + 1 of the record in the ring, 0 while being written */
+        usec_t begin;        /* CLOCK_MONOTONIC */
+        usec_t end;
+        pid_t pid;           /* the process the phase happened in, 0 for the manager itself */
+        char phase[28];
+        char unit[200];      /* possibly truncated */
+} BootTraceEntry;
+
+assert_cc(sizeof(BootTraceEntry) == 256);
+
+typedef struct BootTrace {
+        uint64_t head;       /* number of records ever made */
+        uint8_t _pad[56];
+        BootTraceEntry entries[BOOT_TRACE_ENTRIES_MAX];
+} BootTrace;
+
+int boot_trace_new(BootTrace **ret);
+BootTrace* boot_trace_free(BootTrace *t);
+DEFINE_TRIVIAL_CLEANUP_FUNC(BootTrace*, boot_trace_free);
+
+void boot_trace_record(BootTrace *t, const char *unit, const char *phase, pid_t pid, usec_t begin, usec_t end);
+int boot_trace_get(const BootTrace *t, BootTraceEntry **ret, size_t *ret_n);
+
+void manager_set_boot_trace(Manager *m, bool b);
+
+static inline usec_t boot_trace_now(const BootTrace *t) {
+        /* Don't even query the clock if tracing is disabled */
+        return t ? now(CLOCK_MONOTONIC) : 0;
+}
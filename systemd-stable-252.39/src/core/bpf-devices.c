@@ -212,12 +212,14 @@ int bpf_devices_apply_policy(
                 CGroupDevicePolicy policy,
                 bool allow_list,
                 const char *cgroup_path,
-                BPFProgram **prog_installed) {
+                BPFProgram **prog_installed,
+                Set **cache) {
 
         _cleanup_free_ char *controller_path = NULL;
         int r;
 
-        /* This will assign *prog_installed if everything goes well. */
+        /* This will assign *prog_installed if everything goes well. If a cache is specified, identical
+         * programs are loaded into the kernel only once, see bpf_program_load_kernel_cached(). */
 
         assert(prog);
         if (!*prog)
@@ -259,6 +261,20 @@ int bpf_devices_apply_policy(
         if (r < 0)
                 return log_error_errno(r, "Failed to determine cgroup path: %m");
 
+        /* If the very same program is attached already there's nothing to do. Note that we couldn't attach
+         * it a second time anyway if it came from the cache, the kernel refuses to attach the same program
+         * to the same cgroup twice. */
+        if (prog_installed && *prog_installed &&
+            path_equal_ptr((*prog_installed)->attached_path, controller_path) &&
+            bpf_program_code_equal(*prog, *prog_installed)) {
+                *prog = bpf_program_free(*prog);
+                return 0;
+        }
+
+        r = bpf_program_load_kernel_cached(*prog, cache);
+        if (r < 0)
+                return log_error_errno(r, "Loading device control BPF program failed: %m");
+
         r = bpf_program_cgroup_attach(*prog, BPF_CGROUP_DEVICE, controller_path, BPF_F_ALLOW_MULTI);
         if (r < 0)
                 return log_error_errno(r, "Attaching device control BPF program to cgroup %s failed: %m",
@@ -13,7 +13,8 @@ int bpf_devices_apply_policy(
                 CGroupDevicePolicy policy,
                 bool allow_list,
                 const char *cgroup_path,
-                BPFProgram **prog_installed);
+                BPFProgram **prog_installed,
+                Set **cache);
 
 int bpf_devices_supported(void);
 int bpf_devices_allow_list_device(BPFProgram *prog, const char *path, const char *node, const char *acc);
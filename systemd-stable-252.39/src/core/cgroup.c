@@ -7,6 +7,8 @@
 #include "af-list.h"
 #include "alloc-util.h"
 #include "blockdev-util.h"
+#include "boot-profile.h"
+#include "boot-trace.h"
 #include "bpf-devices.h"
 #include "bpf-firewall.h"
 #include "bpf-foreign.h"
@@ -32,6 +34,7 @@
 #include "process-util.h"
 #include "procfs-util.h"
 #include "restrict-ifaces.h"
+#include "siphash24.h"
 #include "special.h"
 #include "stdio-util.h"
 #include "string-table.h"
@@ -108,10 +111,133 @@ bool unit_has_host_root_cgroup(Unit *u) {
         return unit_has_name(u, SPECIAL_ROOT_SLICE);
 }
 
-static int set_attribute_and_warn(Unit *u, const char *controller, const char *attribute, const char *value) {
+static void unit_forget_cgroup_attribute(Unit *u, const char *key) {
+        _cleanup_free_ char *k = NULL;
+
+        assert(u);
+        assert(key);
+
+        free(hashmap_remove2(u->cgroup_attributes, key, (void**) &k));
+}
+
+static void unit_forget_cgroup_attributes(Unit *u, CGroupMask keep_mask) {
+        const char *key;
+        char *value;
+
+        assert(u);
+
+        /* Forgets the attribute values we remember for all controllers not in keep_mask, so that they are
+         * written again the next time the cgroup is realized. */
+
+        if (keep_mask == 0) {
+                u->cgroup_attributes = hashmap_free(u->cgroup_attributes);
+                return;
+        }
+
+        HASHMAP_FOREACH_KEY(value, key, u->cgroup_attributes) {
+                CGroupController c;
+
+                for (c = 0; c < _CGROUP_CONTROLLER_MAX; c++) {
+                        const char *e;
+
+                        e = startswith(key, cgroup_controller_to_string(c));
+                        if (e && *e == '/')
+                                break;
+                }
+
+                if (c < _CGROUP_CONTROLLER_MAX && FLAGS_SET(keep_mask, CGROUP_CONTROLLER_TO_MASK(c)))
+                        continue;
+
+                unit_forget_cgroup_attribute(u, key);
+        }
+}
+
+static int cgroup_write_attribute_at(int dir_fd, const char *attribute, const char *value) {
+        _cleanup_close_ int fd = -1;
+        ssize_t n;
+        size_t l;
+
+        assert(dir_fd >= 0);
+        assert(attribute);
+        assert(value);
+
+        /* Like cg_set_attribute(), but relative to the cgroup directory, which saves the path lookup for
+         * each attribute. The value is written in a single write(), with a trailing newline. */
+
+        if (!endswith(value, "\n"))
+                value = strjoina(value, "\n");
+        l = strlen(value);
+
+        fd = openat(dir_fd, attribute, O_WRONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        n = write(fd, value, l);
+        if (n < 0)
+                return -errno;
+        if ((size_t) n != l)
+                return -EIO;
+
+        return 0;
+}
+
+int unit_set_cgroup_attribute(
+                Unit *u,
+                const char *controller,
+                const char *attribute,
+                dev_t dev,
+                const char *value) {
+
+        _cleanup_free_ char *key = NULL, *v = NULL;
         int r;
 
-        r = cg_set_attribute(controller, u->cgroup_path, attribute, value);
+        assert(u);
+        assert(controller);
+        assert(attribute);
+        assert(value);
+
+        /* Writes a cgroup attribute, unless we already wrote the very same value before. Attributes that
+         * take one line per device are tracked per device. */
+
+        if (major(dev) > 0)
+                r = asprintf(&key, "%s/%s " DEVNUM_FORMAT_STR, controller, attribute, DEVNUM_FORMAT_VAL(dev));
+        else
+                r = asprintf(&key, "%s/%s", controller, attribute);
+        if (r < 0)
+                return -ENOMEM;
+
+        if (streq_ptr(hashmap_get(u->cgroup_attributes, key), value)) {
+                u->manager->n_cgroup_attribute_writes_skipped++;
+                return 0;
+        }
+
+        /* Whatever was written before, it's outdated now, or we don't know whether it still applies if the
+         * write fails. */
+        unit_forget_cgroup_attribute(u, key);
+
+        u->manager->n_cgroup_attribute_writes++;
+
+        if (u->cgroup_dir_fd >= 0)
+                r = cgroup_write_attribute_at(u->cgroup_dir_fd, attribute, value);
+        else
+                r = cg_set_attribute(controller, u->cgroup_path, attribute, value);
+        if (r < 0)
+                return r;
+
+        v = strdup(value);
+        if (!v)
+                return 0; /* Remembering the value is just an optimization */
+
+        if (hashmap_ensure_put(&u->cgroup_attributes, &string_hash_ops_free_free, key, v) >= 0)
+                TAKE_PTR(key), TAKE_PTR(v);
+
+        return 0;
+}
+
+static int set_attribute_and_warn_full(Unit *u, const char *controller, const char *attribute, dev_t dev, const char *value) {
+        int r;
+
+        r = unit_set_cgroup_attribute(u, controller, attribute, dev, value);
         if (r < 0)
                 log_unit_full_errno(u, LOG_LEVEL_CGROUP_WRITE(r), r, "Failed to set '%s' attribute on '%s' to '%.*s': %m",
                                     strna(attribute), empty_to_root(u->cgroup_path), (int) strcspn(value, NEWLINE), value);
@@ -119,6 +245,10 @@ static int set_attribute_and_warn(Unit *u, const char *controller, const char *a
         return r;
 }
 
+static int set_attribute_and_warn(Unit *u, const char *controller, const char *attribute, const char *value) {
+        return set_attribute_and_warn_full(u, controller, attribute, makedev(0, 0), value);
+}
+
 static void cgroup_compat_warn(void) {
         static bool cgroup_compat_warned = false;
 
@@ -972,7 +1102,7 @@ static void cgroup_apply_unified_cpu_idle(Unit *u, uint64_t weight) {
 
         is_idle = weight == CGROUP_WEIGHT_IDLE;
         idle_val = one_zero(is_idle);
-        r = cg_set_attribute("cpu", u->cgroup_path, "cpu.idle", idle_val);
+        r = unit_set_cgroup_attribute(u, "cpu", "cpu.idle", makedev(0, 0), idle_val);
         if (r < 0 && (r != -ENOENT || is_idle))
                 log_unit_full_errno(u, LOG_LEVEL_CGROUP_WRITE(r), r, "Failed to set '%s' attribute on '%s' to '%s': %m",
                                     "cpu.idle", empty_to_root(u->cgroup_path), idle_val);
@@ -1073,6 +1203,34 @@ static uint64_t cgroup_context_blkio_weight(CGroupContext *c, ManagerState state
         return CGROUP_BLKIO_WEIGHT_DEFAULT;
 }
 
+/* The weight units on the critical chain of the previous boot get while booting, unless configured otherwise */
+#define CGROUP_WEIGHT_CRITICAL_PATH (CGROUP_WEIGHT_DEFAULT * 10)
+
+static uint64_t unit_critical_path_startup_weight(Unit *u, ManagerState state, bool startup_weight_set, uint64_t weight) {
+        assert(u);
+
+        if (startup_weight_set || weight == CGROUP_WEIGHT_IDLE)
+                return weight;
+
+        if (!IN_SET(state, MANAGER_STARTING, MANAGER_INITIALIZING) || !unit_on_critical_path(u))
+                return weight;
+
+        return MAX(weight, CGROUP_WEIGHT_CRITICAL_PATH);
+}
+
+static CGroupMask unit_get_critical_path_mask(Unit *u) {
+        assert(u);
+
+        /* Critical path boosting only uses the weights of the unified hierarchy, and only while booting, see
+         * unit_critical_path_startup_weight() */
+        if (!IN_SET(manager_state(u->manager), MANAGER_STARTING, MANAGER_INITIALIZING) ||
+            !unit_on_critical_path(u) ||
+            cg_all_unified() <= 0)
+                return 0;
+
+        return CGROUP_MASK_CPU | CGROUP_MASK_IO;
+}
+
 static uint64_t cgroup_weight_blkio_to_io(uint64_t blkio_weight) {
         return CLAMP(blkio_weight * CGROUP_WEIGHT_DEFAULT / CGROUP_BLKIO_WEIGHT_DEFAULT,
                      CGROUP_WEIGHT_MIN, CGROUP_WEIGHT_MAX);
@@ -1108,7 +1266,7 @@ static int set_bfq_weight(Unit *u, const char *controller, dev_t dev, uint64_t i
         else
                 xsprintf(buf, "%" PRIu64 "\n", bfq_weight);
 
-        r = cg_set_attribute(controller, u->cgroup_path, p, buf);
+        r = unit_set_cgroup_attribute(u, controller, p, dev, buf);
 
         /* FIXME: drop this when kernels prior
          * 795fe54c2a82 ("bfq: Add per-device weight") v5.4
@@ -1138,7 +1296,7 @@ static void cgroup_apply_io_device_weight(Unit *u, const char *dev_path, uint64_
         r1 = set_bfq_weight(u, "io", dev, io_weight);
 
         xsprintf(buf, DEVNUM_FORMAT_STR " %" PRIu64 "\n", DEVNUM_FORMAT_VAL(dev), io_weight);
-        r2 = cg_set_attribute("io", u->cgroup_path, "io.weight", buf);
+        r2 = unit_set_cgroup_attribute(u, "io", "io.weight", dev, buf);
 
         /* Look at the configured device, when both fail, prefer io.weight errno. */
         r = r2 == -EOPNOTSUPP ? r1 : r2;
@@ -1159,7 +1317,7 @@ static void cgroup_apply_blkio_device_weight(Unit *u, const char *dev_path, uint
                 return;
 
         xsprintf(buf, DEVNUM_FORMAT_STR " %" PRIu64 "\n", DEVNUM_FORMAT_VAL(dev), blkio_weight);
-        (void) set_attribute_and_warn(u, "blkio", "blkio.weight_device", buf);
+        (void) set_attribute_and_warn_full(u, "blkio", "blkio.weight_device", dev, buf);
 }
 
 static void cgroup_apply_io_device_latency(Unit *u, const char *dev_path, usec_t target) {
@@ -1176,7 +1334,7 @@ static void cgroup_apply_io_device_latency(Unit *u, const char *dev_path, usec_t
         else
                 xsprintf(buf, DEVNUM_FORMAT_STR " target=max\n", DEVNUM_FORMAT_VAL(dev));
 
-        (void) set_attribute_and_warn(u, "io", "io.latency", buf);
+        (void) set_attribute_and_warn_full(u, "io", "io.latency", dev, buf);
 }
 
 static void cgroup_apply_io_device_limit(Unit *u, const char *dev_path, uint64_t *limits) {
@@ -1196,7 +1354,7 @@ static void cgroup_apply_io_device_limit(Unit *u, const char *dev_path, uint64_t
         xsprintf(buf, DEVNUM_FORMAT_STR " rbps=%s wbps=%s riops=%s wiops=%s\n", DEVNUM_FORMAT_VAL(dev),
                  limit_bufs[CGROUP_IO_RBPS_MAX], limit_bufs[CGROUP_IO_WBPS_MAX],
                  limit_bufs[CGROUP_IO_RIOPS_MAX], limit_bufs[CGROUP_IO_WIOPS_MAX]);
-        (void) set_attribute_and_warn(u, "io", "io.max", buf);
+        (void) set_attribute_and_warn_full(u, "io", "io.max", dev, buf);
 }
 
 static void cgroup_apply_blkio_device_limit(Unit *u, const char *dev_path, uint64_t rbps, uint64_t wbps) {
@@ -1207,10 +1365,10 @@ static void cgroup_apply_blkio_device_limit(Unit *u, const char *dev_path, uint6
                 return;
 
         sprintf(buf, DEVNUM_FORMAT_STR " %" PRIu64 "\n", DEVNUM_FORMAT_VAL(dev), rbps);
-        (void) set_attribute_and_warn(u, "blkio", "blkio.throttle.read_bps_device", buf);
+        (void) set_attribute_and_warn_full(u, "blkio", "blkio.throttle.read_bps_device", dev, buf);
 
         sprintf(buf, DEVNUM_FORMAT_STR " %" PRIu64 "\n", DEVNUM_FORMAT_VAL(dev), wbps);
-        (void) set_attribute_and_warn(u, "blkio", "blkio.throttle.write_bps_device", buf);
+        (void) set_attribute_and_warn_full(u, "blkio", "blkio.throttle.write_bps_device", dev, buf);
 }
 
 static bool unit_has_unified_memory_config(Unit *u) {
@@ -1332,7 +1490,8 @@ static int cgroup_apply_devices(Unit *u) {
                 policy = CGROUP_DEVICE_POLICY_STRICT;
         }
 
-        r = bpf_devices_apply_policy(&prog, policy, any, path, &u->bpf_device_control_installed);
+        r = bpf_devices_apply_policy(&prog, policy, any, path, &u->bpf_device_control_installed,
+                                     &u->manager->bpf_program_cache);
         if (r < 0) {
                 static bool warned = false;
 
@@ -1374,11 +1533,48 @@ static void cgroup_apply_bpf_foreign_program(Unit *u) {
         (void) bpf_foreign_install(u);
 }
 
+static Unit* unit_open_cgroup_dir(Unit *u) {
+        _cleanup_free_ char *p = NULL;
+        int r;
+
+        assert(u);
+
+        /* Opens the cgroup directory on the unified hierarchy, so that attributes can be written relative to
+         * it, which saves the path lookup for each of them. Returns the unit if the directory was opened, so
+         * that it can be closed again via unit_close_cgroup_dirp(). It's not kept open beyond that, as we'd
+         * need one fd per cgroup otherwise. */
+
+        if (u->cgroup_dir_fd >= 0 || cg_all_unified() <= 0)
+                return NULL;
+
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, NULL, &p);
+        if (r < 0) {
+                log_unit_debug_errno(u, r, "Failed to get path of cgroup %s, ignoring: %m", empty_to_root(u->cgroup_path));
+                return NULL;
+        }
+
+        u->cgroup_dir_fd = open(p, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if (u->cgroup_dir_fd < 0) {
+                log_unit_debug_errno(u, errno, "Failed to open cgroup %s, ignoring: %m", p);
+                return NULL;
+        }
+
+        return u;
+}
+
+static void unit_close_cgroup_dirp(Unit **u) {
+        assert(u);
+
+        if (*u)
+                (*u)->cgroup_dir_fd = safe_close((*u)->cgroup_dir_fd);
+}
+
 static void cgroup_context_apply(
                 Unit *u,
                 CGroupMask apply_mask,
                 ManagerState state) {
 
+        _unused_ _cleanup_(unit_close_cgroup_dirp) Unit *opened = NULL;
         const char *path;
         CGroupContext *c;
         bool is_host_root, is_local_root;
@@ -1390,6 +1586,8 @@ static void cgroup_context_apply(
         if (apply_mask == 0)
                 return;
 
+        opened = unit_open_cgroup_dir(u);
+
         /* Some cgroup attributes are not supported on the host root cgroup, hence silently ignore them here. And other
          * attributes should only be managed for cgroups further down the tree. */
         is_local_root = unit_has_name(u, SPECIAL_ROOT_SLICE);
@@ -1427,6 +1625,12 @@ static void cgroup_context_apply(
                         } else
                                 weight = CGROUP_WEIGHT_DEFAULT;
 
+                        weight = unit_critical_path_startup_weight(
+                                        u, state,
+                                        c->startup_cpu_weight != CGROUP_WEIGHT_INVALID ||
+                                        c->startup_cpu_shares != CGROUP_CPU_SHARES_INVALID,
+                                        weight);
+
                         cgroup_apply_unified_cpu_idle(u, weight);
                         cgroup_apply_unified_cpu_weight(u, weight);
                         cgroup_apply_unified_cpu_quota(u, c->cpu_quota_per_sec_usec, c->cpu_quota_period_usec);
@@ -1480,6 +1684,12 @@ static void cgroup_context_apply(
                 } else
                         weight = CGROUP_WEIGHT_DEFAULT;
 
+                weight = unit_critical_path_startup_weight(
+                                u, state,
+                                c->startup_io_weight != CGROUP_WEIGHT_INVALID ||
+                                c->startup_blockio_weight != CGROUP_BLKIO_WEIGHT_INVALID,
+                                weight);
+
                 set_io_weight(u, weight);
 
                 if (has_io) {
@@ -1817,7 +2027,7 @@ CGroupMask unit_get_own_mask(Unit *u) {
         if (!c)
                 return 0;
 
-        return unit_get_cgroup_mask(u) | unit_get_bpf_mask(u) | unit_get_delegate_mask(u);
+        return unit_get_cgroup_mask(u) | unit_get_bpf_mask(u) | unit_get_delegate_mask(u) | unit_get_critical_path_mask(u);
 }
 
 CGroupMask unit_get_delegate_mask(Unit *u) {
@@ -2034,6 +2244,7 @@ int unit_set_cgroup_path(Unit *u, const char *path) {
 
         unit_release_cgroup(u);
         u->cgroup_path = TAKE_PTR(p);
+        u->accounting_idle = false;
 
         return 1;
 }
@@ -2204,6 +2415,10 @@ static int unit_update_cgroup(
                 return log_unit_error_errno(u, r, "Failed to create cgroup %s: %m", empty_to_root(u->cgroup_path));
         created = r;
 
+        /* A freshly created cgroup starts out with the kernel's defaults, and the attributes of controllers
+         * that are turned off are gone. Also, anything explicitly invalidated shall be written again. */
+        unit_forget_cgroup_attributes(u, created ? 0 : u->cgroup_realized_mask & target_mask & ~u->cgroup_invalidated_mask);
+
         if (cg_unified_controller(SYSTEMD_CGROUP_CONTROLLER) > 0) {
                 uint64_t cgroup_id = 0;
 
@@ -2665,32 +2880,58 @@ static int unit_realize_cgroup_now(Unit *u, ManagerState state) {
         return 0;
 }
 
+static bool unit_dispatch_cgroup_realize(Unit *u, ManagerState state) {
+        int r;
+
+        assert(u);
+        assert(u->in_cgroup_realize_queue);
+
+        if (UNIT_IS_INACTIVE_OR_FAILED(unit_active_state(u))) {
+                /* Maybe things changed, and the unit is not actually active anymore? */
+                unit_remove_from_cgroup_realize_queue(u);
+                return false;
+        }
+
+        r = unit_realize_cgroup_now(u, state);
+        if (r < 0)
+                log_warning_errno(r, "Failed to realize cgroups for queued unit %s, ignoring: %m", u->id);
+
+        return true;
+}
+
 unsigned manager_dispatch_cgroup_realize_queue(Manager *m) {
+        uint64_t writes, skipped;
         ManagerState state;
         unsigned n = 0;
         Unit *i;
-        int r;
 
         assert(m);
 
         state = manager_state(m);
+        writes = m->n_cgroup_attribute_writes;
+        skipped = m->n_cgroup_attribute_writes_skipped;
 
         while ((i = m->cgroup_realize_queue)) {
-                assert(i->in_cgroup_realize_queue);
+                Unit *slice, *sibling;
 
-                if (UNIT_IS_INACTIVE_OR_FAILED(unit_active_state(i))) {
-                        /* Maybe things changed, and the unit is not actually active anymore? */
-                        unit_remove_from_cgroup_realize_queue(i);
-                        continue;
-                }
+                n += unit_dispatch_cgroup_realize(i, state);
 
-                r = unit_realize_cgroup_now(i, state);
-                if (r < 0)
-                        log_warning_errno(r, "Failed to realize cgroups for queued unit %s, ignoring: %m", i->id);
+                /* Realize all queued siblings right away, so that the leaves of a slice are dealt with in
+                 * one batch, and only the first of them has to walk up and realize the ancestors. Slices
+                 * stay where they are in the queue, since they need to come after their own children. */
+                slice = UNIT_GET_SLICE(i);
+                if (!slice)
+                        continue;
 
-                n++;
+                UNIT_FOREACH_DEPENDENCY(sibling, slice, UNIT_ATOM_SLICE_OF)
+                        if (sibling->in_cgroup_realize_queue && sibling->type != UNIT_SLICE)
+                                n += unit_dispatch_cgroup_realize(sibling, state);
         }
 
+        if (n > 0)
+                log_debug("Realized %u cgroups, wrote %" PRIu64 " cgroup attributes, skipped %" PRIu64 " unchanged.",
+                          n, m->n_cgroup_attribute_writes - writes, m->n_cgroup_attribute_writes_skipped - skipped);
+
         return n;
 }
 
@@ -2747,6 +2988,8 @@ void unit_add_family_to_cgroup_realize_queue(Unit *u) {
 
 int unit_realize_cgroup(Unit *u) {
         Unit *slice;
+        usec_t ts;
+        int r;
 
         assert(u);
 
@@ -2767,7 +3010,11 @@ int unit_realize_cgroup(Unit *u) {
                 unit_add_family_to_cgroup_realize_queue(slice);
 
         /* And realize this one now (and apply the values) */
-        return unit_realize_cgroup_now(u, manager_state(u->manager));
+        ts = boot_trace_now(u->manager->boot_trace);
+        r = unit_realize_cgroup_now(u, manager_state(u->manager));
+        boot_trace_record(u->manager->boot_trace, u->id, "cgroup-realize", 0, ts, boot_trace_now(u->manager->boot_trace));
+
+        return r;
 }
 
 void unit_release_cgroup(Unit *u) {
@@ -2781,6 +3028,9 @@ void unit_release_cgroup(Unit *u) {
                 u->cgroup_path = mfree(u->cgroup_path);
         }
 
+        u->cgroup_dir_fd = safe_close(u->cgroup_dir_fd);
+        unit_forget_cgroup_attributes(u, 0);
+
         if (u->cgroup_control_inotify_wd >= 0) {
                 if (inotify_rm_watch(u->manager->cgroup_inotify_fd, u->cgroup_control_inotify_wd) < 0)
                         log_unit_debug_errno(u, errno, "Failed to remove cgroup control inotify watch %i for %s, ignoring: %m", u->cgroup_control_inotify_wd, u->id);
@@ -3260,6 +3510,9 @@ static int unit_check_cgroup_events(Unit *u) {
          * first time. The functions we call to handle given state are idempotent, which makes them
          * effectively remember the previous state. */
         if (values[0]) {
+                /* Even if the cgroup is empty now, processes might have come and gone in between */
+                u->accounting_idle = false;
+
                 if (streq(values[0], "1"))
                         unit_remove_from_cgroup_empty_queue(u);
                 else
@@ -3705,6 +3958,49 @@ int unit_get_memory_available(Unit *u, uint64_t *ret) {
         return 0;
 }
 
+static int unit_cgroup_read_attribute(Unit *u, const char *controller, const char *attribute, char **ret) {
+        _cleanup_free_ char *p = NULL;
+        int r;
+
+        assert(u);
+        assert(attribute);
+        assert(ret);
+
+        /* Reads a whole cgroup attribute, relative to the cgroup directory if we have it open */
+
+        if (u->cgroup_dir_fd >= 0)
+                r = read_virtual_file_at(u->cgroup_dir_fd, attribute, SIZE_MAX, ret, NULL);
+        else {
+                r = cg_get_path(controller, u->cgroup_path, attribute, &p);
+                if (r < 0)
+                        return r;
+
+                r = read_virtual_file(p, SIZE_MAX, ret, NULL);
+        }
+
+        return r < 0 ? r : 0;
+}
+
+static int unit_cgroup_read_uint64(Unit *u, const char *controller, const char *attribute, uint64_t *ret) {
+        _cleanup_free_ char *value = NULL;
+        int r;
+
+        assert(ret);
+
+        r = unit_cgroup_read_attribute(u, controller, attribute, &value);
+        if (r < 0)
+                return r;
+
+        delete_trailing_chars(value, NEWLINE);
+
+        if (streq(value, "max")) {
+                *ret = CGROUP_LIMIT_MAX;
+                return 0;
+        }
+
+        return safe_atou64(value, ret);
+}
+
 int unit_get_memory_current(Unit *u, uint64_t *ret) {
         int r;
 
@@ -3728,7 +4024,7 @@ int unit_get_memory_current(Unit *u, uint64_t *ret) {
         if (r < 0)
                 return r;
 
-        return cg_get_attribute_as_uint64("memory", u->cgroup_path, r > 0 ? "memory.current" : "memory.usage_in_bytes", ret);
+        return unit_cgroup_read_uint64(u, "memory", r > 0 ? "memory.current" : "memory.usage_in_bytes", ret);
 }
 
 int unit_get_tasks_current(Unit *u, uint64_t *ret) {
@@ -3748,7 +4044,7 @@ int unit_get_tasks_current(Unit *u, uint64_t *ret) {
         if ((u->cgroup_realized_mask & CGROUP_MASK_PIDS) == 0)
                 return -ENODATA;
 
-        return cg_get_attribute_as_uint64("pids", u->cgroup_path, "pids.current", ret);
+        return unit_cgroup_read_uint64(u, "pids", "pids.current", ret);
 }
 
 static int unit_get_cpu_usage_raw(Unit *u, nsec_t *ret) {
@@ -3773,22 +4069,38 @@ static int unit_get_cpu_usage_raw(Unit *u, nsec_t *ret) {
         if (r < 0)
                 return r;
         if (r > 0) {
-                _cleanup_free_ char *val = NULL;
+                _cleanup_free_ char *contents = NULL;
+                const char *val = NULL;
                 uint64_t us;
 
-                r = cg_get_keyed_attribute("cpu", u->cgroup_path, "cpu.stat", STRV_MAKE("usage_usec"), &val);
-                if (IN_SET(r, -ENOENT, -ENXIO))
+                r = unit_cgroup_read_attribute(u, "cpu", "cpu.stat", &contents);
+                if (r == -ENOENT)
                         return -ENODATA;
                 if (r < 0)
                         return r;
 
+                for (char *p = contents; *p; p += strspn(p, NEWLINE)) {
+                        char *w;
+
+                        w = (char*) first_word(p, "usage_usec");
+                        if (w) {
+                                w[strcspn(w, NEWLINE)] = 0;
+                                val = w;
+                                break;
+                        }
+
+                        p += strcspn(p, NEWLINE);
+                }
+                if (!val)
+                        return -ENODATA;
+
                 r = safe_atou64(val, &us);
                 if (r < 0)
                         return r;
 
                 ns = us * NSEC_PER_USEC;
         } else
-                return cg_get_attribute_as_uint64("cpuacct", u->cgroup_path, "cpuacct.usage", ret);
+                return unit_cgroup_read_uint64(u, "cpuacct", "cpuacct.usage", ret);
 
         *ret = ns;
         return 0;
@@ -3877,7 +4189,7 @@ static int unit_get_io_accounting_raw(Unit *u, uint64_t ret[static _CGROUP_IO_AC
                 [CGROUP_IO_WRITE_OPERATIONS] = "wios=",
         };
         uint64_t acc[_CGROUP_IO_ACCOUNTING_METRIC_MAX] = {};
-        _cleanup_free_ char *path = NULL;
+        _cleanup_free_ char *contents = NULL;
         _cleanup_fclose_ FILE *f = NULL;
         int r;
 
@@ -3898,11 +4210,11 @@ static int unit_get_io_accounting_raw(Unit *u, uint64_t ret[static _CGROUP_IO_AC
         if (!FLAGS_SET(u->cgroup_realized_mask, CGROUP_MASK_IO))
                 return -ENODATA;
 
-        r = cg_get_path("io", u->cgroup_path, "io.stat", &path);
+        r = unit_cgroup_read_attribute(u, "io", "io.stat", &contents);
         if (r < 0)
                 return r;
 
-        f = fopen(path, "re");
+        f = fmemopen_unlocked(contents, strlen(contents), "r");
         if (!f)
                 return -errno;
 
@@ -3990,6 +4302,69 @@ done:
         return 0;
 }
 
+int unit_get_accounting_snapshot(Unit *u, uint64_t generation, CGroupAccountingSnapshot *ret) {
+        static const uint8_t hash_key[16] = {};
+        CGroupAccountingSnapshot s = {
+                .cpu_usage_nsec = NSEC_INFINITY,
+                .memory_current = UINT64_MAX,
+                .tasks_current = UINT64_MAX,
+        };
+        uint64_t hash;
+        bool changed;
+
+        assert(u);
+        assert(generation > 0);
+        assert(ret);
+
+        /* Collects all accounting counters of the unit in one go, reading each cgroup attribute and BPF map
+         * only once. Counters that are not available are set to UINT64_MAX. If any counter changed since the
+         * last snapshot of this unit, the unit's accounting generation is set to the specified one, and true
+         * is returned. */
+
+        (void) unit_get_cpu_usage(u, &s.cpu_usage_nsec);
+        (void) unit_get_memory_current(u, &s.memory_current);
+        (void) unit_get_tasks_current(u, &s.tasks_current);
+
+        for (CGroupIOAccountingMetric i = 0; i < _CGROUP_IO_ACCOUNTING_METRIC_MAX; i++)
+                /* The first call reads io.stat, the others take the values from the cache it filled in */
+                if (unit_get_io_accounting(u, i, i > 0, &s.io[i]) < 0)
+                        s.io[i] = UINT64_MAX;
+
+        for (CGroupIPAccountingMetric i = 0; i < _CGROUP_IP_ACCOUNTING_METRIC_MAX; i++)
+                s.ip[i] = UINT64_MAX;
+
+        if (UNIT_CGROUP_BOOL(u, ip_accounting)) {
+                uint64_t bytes, packets;
+
+                if (u->ip_accounting_ingress_map_fd >= 0 &&
+                    bpf_firewall_read_accounting(u->ip_accounting_ingress_map_fd, &bytes, &packets) >= 0) {
+                        s.ip[CGROUP_IP_INGRESS_BYTES] = bytes + u->ip_accounting_extra[CGROUP_IP_INGRESS_BYTES];
+                        s.ip[CGROUP_IP_INGRESS_PACKETS] = packets + u->ip_accounting_extra[CGROUP_IP_INGRESS_PACKETS];
+                }
+
+                if (u->ip_accounting_egress_map_fd >= 0 &&
+                    bpf_firewall_read_accounting(u->ip_accounting_egress_map_fd, &bytes, &packets) >= 0) {
+                        s.ip[CGROUP_IP_EGRESS_BYTES] = bytes + u->ip_accounting_extra[CGROUP_IP_EGRESS_BYTES];
+                        s.ip[CGROUP_IP_EGRESS_PACKETS] = packets + u->ip_accounting_extra[CGROUP_IP_EGRESS_PACKETS];
+                }
+        }
+
+        /* Only a hash of the previous snapshot is kept, to detect changes cheaply */
+        hash = siphash24(&s, sizeof(s), hash_key);
+        changed = u->accounting_generation == 0 || hash != u->accounting_hash;
+        if (changed) {
+                u->accounting_hash = hash;
+                u->accounting_generation = generation;
+        }
+
+        /* An empty cgroup accrues nothing, until processes show up in it again, which the cgroup.events
+         * watch tells us about, see unit_check_cgroup_events(). Without the watch we cannot know. */
+        u->accounting_idle = s.tasks_current == 0 && u->cgroup_control_inotify_wd >= 0;
+
+        *ret = s;
+        return changed;
+}
+
 int unit_reset_cpu_accounting(Unit *u) {
         int r;
 
@@ -4044,6 +4419,8 @@ int unit_reset_accounting(Unit *u) {
 
         assert(u);
 
+        u->accounting_idle = false;
+
         r = unit_reset_cpu_accounting(u);
         q = unit_reset_io_accounting(u);
         v = unit_reset_ip_accounting(u);
@@ -4067,6 +4444,10 @@ void unit_invalidate_cgroup(Unit *u, CGroupMask m) {
         if (m & (CGROUP_MASK_CPU | CGROUP_MASK_CPUACCT))
                 m |= CGROUP_MASK_CPU | CGROUP_MASK_CPUACCT;
 
+        /* The attributes might have been changed behind our back, hence write all of them again, even if the
+         * values we'd write are the ones we wrote before. */
+        unit_forget_cgroup_attributes(u, ~m);
+
         if (FLAGS_SET(u->cgroup_invalidated_mask, m)) /* NOP? */
                 return;
 
@@ -4131,8 +4512,13 @@ void manager_invalidate_startup_units(Manager *m) {
 
         assert(m);
 
-        SET_FOREACH(u, m->startup_units)
+        SET_FOREACH(u, m->startup_units) {
+                /* The controllers enabled for the critical path boost aren't needed anymore either */
+                if (unit_on_critical_path(u))
+                        unit_invalidate_cgroup_members_masks(u);
+
                 unit_invalidate_cgroup(u, CGROUP_MASK_CPU|CGROUP_MASK_IO|CGROUP_MASK_BLKIO|CGROUP_MASK_CPUSET);
+        }
 }
 
 static int unit_get_nice(Unit *u) {
@@ -4159,6 +4545,9 @@ int compare_job_priority(const void *a, const void *b) {
         if ((ret = CMP(x->unit->type, y->unit->type)) != 0)
                 return -ret;
 
+        if ((ret = CMP(x->critical_path_weight, y->critical_path_weight)) != 0)
+                return -ret;
+
         weight_x = unit_get_cpu_weight(x->unit);
         weight_y = unit_get_cpu_weight(y->unit);
 
@@ -300,6 +300,16 @@ int unit_get_cpu_usage(Unit *u, nsec_t *ret);
 int unit_get_io_accounting(Unit *u, CGroupIOAccountingMetric metric, bool allow_cache, uint64_t *ret);
 int unit_get_ip_accounting(Unit *u, CGroupIPAccountingMetric metric, uint64_t *ret);
 
+typedef struct CGroupAccountingSnapshot {
+        nsec_t cpu_usage_nsec;
+        uint64_t memory_current;
+        uint64_t tasks_current;
+        uint64_t io[_CGROUP_IO_ACCOUNTING_METRIC_MAX];
+        uint64_t ip[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
+} CGroupAccountingSnapshot;
+
+int unit_get_accounting_snapshot(Unit *u, uint64_t generation, CGroupAccountingSnapshot *ret);
+
 int unit_reset_cpu_accounting(Unit *u);
 int unit_reset_ip_accounting(Unit *u);
 int unit_reset_io_accounting(Unit *u);
@@ -337,3 +347,6 @@ int unit_cgroup_freezer_action(Unit *u, FreezerAction action);
 
 const char* freezer_action_to_string(FreezerAction a) _const_;
 FreezerAction freezer_action_from_string(const char *s) _pure_;
+
+/* Only exported for unit tests */
+int unit_set_cgroup_attribute(Unit *u, const char *controller, const char *attribute, dev_t dev, const char *value);
@@ -1209,6 +1209,99 @@ static int method_list_units(sd_bus_message *message, void *userdata, sd_bus_err
         return list_units_filtered(message, userdata, error, NULL, NULL);
 }
 
+static int method_get_accounting_snapshot(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        Manager *m = ASSERT_PTR(userdata);
+        const char *name, *root = NULL, *k;
+        Hashmap *units = m->units;
+        uint64_t since, generation;
+        Unit *u;
+        int r;
+
+        assert(message);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read(message, "st", &name, &since);
+        if (r < 0)
+                return r;
+
+        if (!isempty(name)) {
+                u = manager_get_unit(m, name);
+                if (!u)
+                        return sd_bus_error_setf(error, BUS_ERROR_NO_SUCH_UNIT, "Unit %s not loaded.", name);
+
+                /* A unit without a cgroup has no subtree to report on */
+                if (!u->cgroup_path)
+                        units = NULL;
+
+                root = u->cgroup_path;
+        }
+
+        /* All counters are collected in this one go, hence they are consistent with each other */
+        generation = ++m->accounting_generation;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append(reply, "t", generation);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sttttttttttt)");
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(u, k, units) {
+                CGroupAccountingSnapshot snapshot;
+
+                if (k != u->id)
+                        continue;
+
+                if (!UNIT_HAS_CGROUP_CONTEXT(u) || !u->cgroup_path)
+                        continue;
+
+                if (!isempty(root) && !path_startswith(u->cgroup_path, root))
+                        continue;
+
+                /* Don't even look at the cgroup files of units that stayed idle since the last call */
+                if (since > 0 && u->accounting_idle && u->accounting_generation <= since)
+                        continue;
+
+                (void) unit_get_accounting_snapshot(u, generation, &snapshot);
+                if (u->accounting_generation <= since)
+                        continue;
+
+                r = sd_bus_message_append(
+                                reply, "(sttttttttttt)",
+                                u->id,
+                                snapshot.cpu_usage_nsec,
+                                snapshot.memory_current,
+                                snapshot.tasks_current,
+                                snapshot.io[CGROUP_IO_READ_BYTES],
+                                snapshot.io[CGROUP_IO_WRITE_BYTES],
+                                snapshot.io[CGROUP_IO_READ_OPERATIONS],
+                                snapshot.io[CGROUP_IO_WRITE_OPERATIONS],
+                                snapshot.ip[CGROUP_IP_INGRESS_BYTES],
+                                snapshot.ip[CGROUP_IP_INGRESS_PACKETS],
+                                snapshot.ip[CGROUP_IP_EGRESS_BYTES],
+                                snapshot.ip[CGROUP_IP_EGRESS_PACKETS]);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
 static int method_list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         _cleanup_strv_free_ char **states = NULL;
         int r;
@@ -1445,6 +1538,55 @@ static int method_dump_units_matching_patterns_by_fd(sd_bus_message *message, vo
         return dump_units_matching_patterns(message, userdata, error, reply_dump_by_fd);
 }
 
+static int method_dump_trace(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_free_ BootTraceEntry *entries = NULL;
+        Manager *m = ASSERT_PTR(userdata);
+        size_t n;
+        int r;
+
+        assert(message);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        if (!m->boot_trace)
+                return sd_bus_error_set(error, SD_BUS_ERROR_NOT_SUPPORTED, "Boot tracing is not enabled, see BootTrace=.");
+
+        r = boot_trace_get(m->boot_trace, &entries, &n);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(ssutt)");
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; i < n; i++) {
+                r = sd_bus_message_append(
+                                reply, "(ssutt)",
+                                entries[i].unit,
+                                entries[i].phase,
+                                (uint32_t) entries[i].pid,
+                                entries[i].begin,
+                                entries[i].end);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
 static int method_refuse_snapshot(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         return sd_bus_error_set(error, SD_BUS_ERROR_NOT_SUPPORTED, "Support for snapshots has been removed.");
 }
@@ -1516,6 +1658,36 @@ static int method_reload(sd_bus_message *message, void *userdata, sd_bus_error *
         return 1;
 }
 
+static int method_reload_incremental(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        Manager *m = ASSERT_PTR(userdata);
+        unsigned n_checked, n_reloaded;
+        usec_t start;
+        int r;
+
+        assert(message);
+
+        r = mac_selinux_access_check(message, "reload", error);
+        if (r < 0)
+                return r;
+
+        r = bus_verify_reload_daemon_async(m, message, error);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return 1; /* No authorization for now, but the async polkit stuff will call us again when it has it */
+
+        /* Unlike Reload() this is done synchronously, as only the changed units are touched. If that's not
+         * possible, NotSupported is returned and the client is expected to fall back to Reload(). */
+
+        start = now(CLOCK_MONOTONIC);
+
+        r = manager_reload_incremental(m, &n_checked, &n_reloaded, error);
+        if (r < 0)
+                return r;
+
+        return sd_bus_reply_method_return(message, "uut", n_checked, n_reloaded, now(CLOCK_MONOTONIC) - start);
+}
+
 static int method_reexecute(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         Manager *m = ASSERT_PTR(userdata);
         int r;
@@ -2802,6 +2974,10 @@ const sd_bus_vtable bus_manager_vtable[] = {
         BUS_PROPERTY_DUAL_TIMESTAMP("InitRDGeneratorsFinishTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_INITRD_GENERATORS_FINISH]), SD_BUS_VTABLE_PROPERTY_CONST),
         BUS_PROPERTY_DUAL_TIMESTAMP("InitRDUnitsLoadStartTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_INITRD_UNITS_LOAD_START]), SD_BUS_VTABLE_PROPERTY_CONST),
         BUS_PROPERTY_DUAL_TIMESTAMP("InitRDUnitsLoadFinishTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_INITRD_UNITS_LOAD_FINISH]), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("UnitsLoadParseUSec", "t", bus_property_get_usec, offsetof(Manager, units_load_parse_usec), 0),
+        SD_BUS_PROPERTY("UnitsLoadApplyUSec", "t", bus_property_get_usec, offsetof(Manager, units_load_apply_usec), 0),
+        SD_BUS_PROPERTY("UnitsLoadParsedFiles", "u", bus_property_get_unsigned, offsetof(Manager, units_load_parsed_files), 0),
+        SD_BUS_PROPERTY("UnitsLoadParseThreads", "u", bus_property_get_unsigned, offsetof(Manager, units_load_parse_threads), 0),
         SD_BUS_WRITABLE_PROPERTY("LogLevel", "s", bus_property_get_log_level, property_set_log_level, 0, 0),
         SD_BUS_WRITABLE_PROPERTY("LogTarget", "s", bus_property_get_log_target, property_set_log_target, 0, 0),
         SD_BUS_PROPERTY("NNames", "u", property_get_hashmap_size, offsetof(Manager, units), 0),
@@ -2882,6 +3058,7 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_PROPERTY("DefaultOOMPolicy", "s", bus_property_get_oom_policy, offsetof(Manager, default_oom_policy), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultOOMScoreAdjust", "i", property_get_oom_score_adjust, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("CtrlAltDelBurstAction", "s", bus_property_get_emergency_action, offsetof(Manager, cad_burst_action), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("DBusSignalCoalesceUSec", "t", bus_property_get_usec, offsetof(Manager, dbus_signal_coalesce_usec), SD_BUS_VTABLE_PROPERTY_CONST),
 
         SD_BUS_METHOD_WITH_ARGS("GetUnit",
                                 SD_BUS_ARGS("s", name),
@@ -3083,6 +3260,11 @@ const sd_bus_vtable bus_manager_vtable[] = {
                                 SD_BUS_RESULT("a(ssssssouso)", units),
                                 method_list_units_by_names,
                                 SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_ARGS("GetAccountingSnapshot",
+                                SD_BUS_ARGS("s", name, "t", since_generation),
+                                SD_BUS_RESULT("t", generation, "a(sttttttttttt)", units),
+                                method_get_accounting_snapshot,
+                                SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD_WITH_ARGS("ListJobs",
                                 SD_BUS_NO_ARGS,
                                 SD_BUS_RESULT("a(usssoo)", jobs),
@@ -3118,6 +3300,11 @@ const sd_bus_vtable bus_manager_vtable[] = {
                                 SD_BUS_RESULT("h", fd),
                                 method_dump_units_matching_patterns_by_fd,
                                 SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_ARGS("DumpTrace",
+                                SD_BUS_NO_ARGS,
+                                SD_BUS_RESULT("a(ssutt)", phases),
+                                method_dump_trace,
+                                SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD_WITH_ARGS("CreateSnapshot",
                                 SD_BUS_ARGS("s", name, "b", cleanup),
                                 SD_BUS_RESULT("o", unit),
@@ -3133,6 +3320,11 @@ const sd_bus_vtable bus_manager_vtable[] = {
                       NULL,
                       method_reload,
                       SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_ARGS("ReloadIncremental",
+                                SD_BUS_NO_ARGS,
+                                SD_BUS_RESULT("u", n_units, "u", n_reloaded, "t", usec),
+                                method_reload_incremental,
+                                SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Reexecute",
                       NULL,
                       NULL,
@@ -3323,6 +3515,9 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_SIGNAL_WITH_ARGS("Reloading",
                                 SD_BUS_ARGS("b", active),
                                 0),
+        SD_BUS_SIGNAL_WITH_ARGS("UnitsChanged",
+                                SD_BUS_ARGS("a(sssso)", units),
+                                0),
 
         SD_BUS_VTABLE_END
 };
@@ -3420,6 +3615,71 @@ void bus_manager_send_reloading(Manager *m, bool active) {
                 log_debug_errno(r, "Failed to send reloading signal: %m");
 }
 
+typedef struct UnitsChanged {
+        Unit **units;
+        size_t n_units;
+} UnitsChanged;
+
+static int send_units_changed(sd_bus *bus, void *userdata) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *message = NULL;
+        UnitsChanged *c = ASSERT_PTR(userdata);
+        int r;
+
+        assert(bus);
+
+        r = sd_bus_message_new_signal(bus, &message, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager", "UnitsChanged");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(message, 'a', "(sssso)");
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; i < c->n_units; i++) {
+                _cleanup_free_ char *p = NULL;
+                Unit *u = c->units[i];
+
+                p = unit_dbus_path(u);
+                if (!p)
+                        return -ENOMEM;
+
+                r = sd_bus_message_append(
+                                message, "(sssso)",
+                                u->id,
+                                unit_load_state_to_string(u->load_state),
+                                unit_active_state_to_string(unit_active_state(u)),
+                                unit_sub_state_to_string(u),
+                                p);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(message);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(bus, message, NULL);
+}
+
+void bus_manager_send_units_changed(Manager *m, Unit **units, size_t n_units) {
+        UnitsChanged c = {
+                .units = units,
+                .n_units = n_units,
+        };
+        int r;
+
+        assert(m);
+        assert(units || n_units == 0);
+
+        /* Sends a single signal summarizing the current state of all units whose change signals were just
+         * generated. This is only done if change signal coalescing is enabled, so that clients may watch
+         * this signal instead of individual PropertiesChanged signals of each unit. */
+
+        r = bus_foreach_bus(m, NULL, send_units_changed, &c);
+        if (r < 0)
+                log_debug_errno(r, "Failed to send units changed signal: %m");
+}
+
 static int send_changed_signal(sd_bus *bus, void *userdata) {
         assert(bus);
 
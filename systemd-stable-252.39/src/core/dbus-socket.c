@@ -113,6 +113,7 @@ const sd_bus_vtable bus_socket_vtable[] = {
         SD_BUS_PROPERTY("Mark", "i", bus_property_get_int, offsetof(Socket, mark), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("MaxConnections", "u", bus_property_get_unsigned, offsetof(Socket, max_connections), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("MaxConnectionsPerSource", "u", bus_property_get_unsigned, offsetof(Socket, max_connections_per_source), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("AcceptPool", "u", bus_property_get_unsigned, offsetof(Socket, accept_pool), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("MessageQueueMaxMessages", "x", bus_property_get_long, offsetof(Socket, mq_maxmsg), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("MessageQueueMessageSize", "x", bus_property_get_long, offsetof(Socket, mq_msgsize), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("TCPCongestion", "s", NULL, offsetof(Socket, tcp_congestion), SD_BUS_VTABLE_PROPERTY_CONST),
@@ -242,6 +243,9 @@ static int bus_socket_set_transient_property(
         if (streq(name, "MaxConnectionsPerSource"))
                 return bus_set_transient_unsigned(u, name, &s->max_connections_per_source, message, flags, error);
 
+        if (streq(name, "AcceptPool"))
+                return bus_set_transient_unsigned(u, name, &s->accept_pool, message, flags, error);
+
         if (streq(name, "KeepAliveProbes"))
                 return bus_set_transient_unsigned(u, name, &s->keep_alive_cnt, message, flags, error);
 
@@ -26,6 +26,7 @@
 #include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
+#include "unit-compact.h"
 #include "user-util.h"
 #include "web-util.h"
 
@@ -154,10 +155,9 @@ static int property_get_dependencies(
                 void *userdata,
                 sd_bus_error *error) {
 
-        Unit *u = userdata, *other;
+        const UnitDependencyEdge *e;
+        Unit *u = userdata;
         UnitDependency d;
-        Hashmap *deps;
-        void *v;
         int r;
 
         assert(bus);
@@ -167,14 +167,15 @@ static int property_get_dependencies(
         d = unit_dependency_from_string(property);
         assert_se(d >= 0);
 
-        deps = unit_get_dependencies(u, d);
-
         r = sd_bus_message_open_container(reply, 'a', "s");
         if (r < 0)
                 return r;
 
-        HASHMAP_FOREACH_KEY(v, other, deps) {
-                r = sd_bus_message_append(reply, "s", other->id);
+        UNIT_FOREACH_DEPENDENCY_EDGE(e, u) {
+                if (e->type != d)
+                        continue;
+
+                r = sd_bus_message_append(reply, "s", e->other->id);
                 if (r < 0)
                         return r;
         }
@@ -614,6 +615,11 @@ int bus_unit_method_set_properties(sd_bus_message *message, void *userdata, sd_b
         if (r == 0)
                 return 1; /* No authorization for now, but the async polkit stuff will call us again when it has it */
 
+        /* The new settings are applied on top of the ones from the unit files, make sure we have them */
+        r = bus_unit_expand(u, error);
+        if (r < 0)
+                return r;
+
         r = bus_unit_set_properties(u, message, runtime ? UNIT_RUNTIME : UNIT_PERSISTENT, true, error);
         if (r < 0)
                 return r;
@@ -720,6 +726,10 @@ int bus_unit_method_clean(sd_bus_message *message, void *userdata, sd_bus_error
         if (r == 0)
                 return 1; /* No authorization for now, but the async polkit stuff will call us again when it has it */
 
+        r = bus_unit_expand(u, error);
+        if (r < 0)
+                return r;
+
         r = unit_clean(u, mask);
         if (r == -EOPNOTSUPP)
                 return sd_bus_error_setf(error, SD_BUS_ERROR_NOT_SUPPORTED, "Unit '%s' does not support cleaning.", u->id);
@@ -938,6 +948,8 @@ const sd_bus_vtable bus_unit_vtable[] = {
         SD_BUS_PROPERTY("CollectMode", "s", property_get_collect_mode, offsetof(Unit, collect_mode), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("Refs", "as", property_get_refs, 0, 0),
         SD_BUS_PROPERTY("ActivationDetails", "a(ss)", bus_property_get_activation_details, offsetof(Unit, activation_details), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("NNotifyMessages", "t", NULL, offsetof(Unit, n_notify_messages), 0),
+        SD_BUS_PROPERTY("NNotifyMessagesCoalesced", "t", NULL, offsetof(Unit, n_notify_messages_coalesced), 0),
 
         SD_BUS_METHOD_WITH_ARGS("Start",
                                 SD_BUS_ARGS("s", mode),
@@ -1659,6 +1671,12 @@ void bus_unit_send_pending_change_signal(Unit *u, bool including_new) {
                                                * when we are reloading. */
                 return;
 
+        if (u->manager->dbus_signal_coalesce_usec > 0 && !including_new) /* If change signals shall be coalesced,
+                                                                          * intermediary states are deliberately not
+                                                                          * announced individually (except if the
+                                                                          * caller explicitly asked for it) */
+                return;
+
         bus_unit_send_change_signal(u);
 }
 
@@ -1858,6 +1876,13 @@ int bus_unit_queue_job(
             (type == JOB_RELOAD_OR_START && job_type_collapse(type, u) == JOB_START && u->refuse_manual_start))
                 return sd_bus_error_setf(error, BUS_ERROR_ONLY_BY_DEPENDENCY, "Operation refused, unit %s may be requested by dependency only (it is configured to refuse manual start/stop).", u->id);
 
+        /* Read the settings of compacted units back in now, so that the client learns if that's not possible */
+        if (type != JOB_STOP) {
+                r = bus_unit_expand(u, error);
+                if (r < 0)
+                        return r;
+        }
+
         r = sd_bus_message_new_method_return(message, &reply);
         if (r < 0)
                 return r;
@@ -2505,6 +2530,20 @@ int bus_unit_validate_load_state(Unit *u, sd_bus_error *error) {
         }
 }
 
+int bus_unit_expand(Unit *u, sd_bus_error *error) {
+        int r;
+
+        assert(u);
+
+        /* Reads the settings of a compacted unit back in, and generates a pretty error if that fails. */
+
+        r = unit_expand(u);
+        if (r < 0)
+                return sd_bus_error_set_errnof(error, r, "Failed to read back settings of unit %s: %m", u->id);
+
+        return r;
+}
+
 static int bus_unit_track_handler(sd_bus_track *t, void *userdata) {
         Unit *u = ASSERT_PTR(userdata);
 
@@ -49,6 +49,7 @@ int bus_unit_queue_job(
                 BusUnitQueueFlags flags,
                 sd_bus_error *error);
 int bus_unit_validate_load_state(Unit *u, sd_bus_error *error);
+int bus_unit_expand(Unit *u, sd_bus_error *error);
 
 int bus_unit_track_add_name(Unit *u, const char *name);
 int bus_unit_track_add_sender(Unit *u, sd_bus_message *m);
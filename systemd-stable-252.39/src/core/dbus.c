@@ -312,6 +312,15 @@ static int find_unit(Manager *m, sd_bus *bus, const char *path, Unit **unit, sd_
                 assert(u);
         }
 
+        /* Read the settings of compacted units back in before clients look at them. But only if there's a
+         * client asking, we are called for sending out PropertiesChanged signals too, which don't include
+         * any of them. */
+        if (u->compacted && sd_bus_get_current_message(bus)) {
+                r = bus_unit_expand(u, error);
+                if (r < 0)
+                        return r;
+        }
+
         *unit = u;
         return 1;
 }
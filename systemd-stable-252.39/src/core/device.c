@@ -635,17 +635,17 @@ static bool device_is_bound_by_mounts(Device *d, sd_device *dev) {
 }
 
 static void device_upgrade_mount_deps(Unit *u) {
-        Unit *other;
-        void *v;
+        const UnitDependencyEdge *e;
         int r;
 
         /* Let's upgrade Requires= to BindsTo= on us. (Used when SYSTEMD_MOUNT_DEVICE_BOUND is set) */
 
-        HASHMAP_FOREACH_KEY(v, other, unit_get_dependencies(u, UNIT_REQUIRED_BY)) {
-                if (other->type != UNIT_MOUNT)
+        UNIT_FOREACH_DEPENDENCY_EDGE(e, u) {
+                if (e->type != UNIT_REQUIRED_BY || e->other->type != UNIT_MOUNT)
                         continue;
 
-                r = unit_add_dependency(other, UNIT_BINDS_TO, u, true, UNIT_DEPENDENCY_UDEV);
+                /* Note that this adds edges to 'u' too, which is OK while iterating */
+                r = unit_add_dependency(e->other, UNIT_BINDS_TO, u, true, UNIT_DEPENDENCY_UDEV);
                 if (r < 0)
                         log_unit_warning_errno(u, r, "Failed to add BindsTo= dependency between device and mount unit, ignoring: %m");
         }
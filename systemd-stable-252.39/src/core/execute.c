@@ -43,6 +43,7 @@
 #endif
 #include "async.h"
 #include "barrier.h"
+#include "boot-trace.h"
 #include "bpf-lsm.h"
 #include "cap-list.h"
 #include "capability-util.h"
@@ -322,6 +323,42 @@ static int connect_journal_socket(
         return r;
 }
 
+static int build_logger_header(
+                const Unit *unit,
+                const ExecContext *context,
+                const ExecParameters *params,
+                ExecOutput output,
+                const char *ident,
+                char **ret) {
+
+        assert(unit);
+        assert(context);
+        assert(params);
+        assert(ident);
+        assert(ret);
+
+        /* The header journald expects at the beginning of a stdout stream connection */
+
+        if (asprintf(ret,
+                     "%s\n"
+                     "%s\n"
+                     "%i\n"
+                     "%i\n"
+                     "%i\n"
+                     "%i\n"
+                     "%i\n",
+                     context->syslog_identifier ?: ident,
+                     params->flags & EXEC_PASS_LOG_UNIT ? unit->id : "",
+                     context->syslog_priority,
+                     !!context->syslog_level_prefix,
+                     false,
+                     is_kmsg_output(output),
+                     is_terminal_output(output)) < 0)
+                return -ENOMEM;
+
+        return 0;
+}
+
 static int connect_logger_as(
                 const Unit *unit,
                 const ExecContext *context,
@@ -333,6 +370,7 @@ static int connect_logger_as(
                 gid_t gid) {
 
         _cleanup_close_ int fd = -1;
+        _cleanup_free_ char *header = NULL;
         int r;
 
         assert(context);
@@ -354,22 +392,13 @@ static int connect_logger_as(
 
         (void) fd_inc_sndbuf(fd, SNDBUF_SIZE);
 
-        if (dprintf(fd,
-                "%s\n"
-                "%s\n"
-                "%i\n"
-                "%i\n"
-                "%i\n"
-                "%i\n"
-                "%i\n",
-                context->syslog_identifier ?: ident,
-                params->flags & EXEC_PASS_LOG_UNIT ? unit->id : "",
-                context->syslog_priority,
-                !!context->syslog_level_prefix,
-                false,
-                is_kmsg_output(output),
-                is_terminal_output(output)) < 0)
-                return -errno;
+        r = build_logger_header(unit, context, params, output, ident, &header);
+        if (r < 0)
+                return r;
+
+        r = loop_write(fd, header, strlen(header), false);
+        if (r < 0)
+                return r;
 
         return move_fd(TAKE_FD(fd), nfd, false);
 }
@@ -1457,7 +1486,7 @@ static bool context_has_no_new_privileges(const ExecContext *c) {
                 context_has_syscall_logs(c);
 }
 
-static bool exec_context_has_credentials(const ExecContext *context) {
+bool exec_context_has_credentials(const ExecContext *context) {
 
         assert(context);
 
@@ -1476,8 +1505,74 @@ static bool skip_seccomp_unavailable(const Unit* u, const char* msg) {
         return true;
 }
 
-static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_ambient_hack) {
-        uint32_t negative_action, default_action, action;
+static void context_syscall_filter_actions(const ExecContext *c, uint32_t *ret_default_action, uint32_t *ret_action) {
+        uint32_t negative_action;
+
+        assert(c);
+        assert(ret_default_action);
+        assert(ret_action);
+
+        negative_action = c->syscall_errno == SECCOMP_ERROR_NUMBER_KILL ? scmp_act_kill_process() : SCMP_ACT_ERRNO(c->syscall_errno);
+
+        if (c->syscall_allow_list) {
+                *ret_default_action = negative_action;
+                *ret_action = SCMP_ACT_ALLOW;
+        } else {
+                *ret_default_action = SCMP_ACT_ALLOW;
+                *ret_action = negative_action;
+        }
+}
+
+static const SeccompProgram* exec_syscall_filter_program(
+                Unit *u,
+                const ExecCommand *command,
+                const ExecContext *c,
+                const ExecParameters *p) {
+
+        uint32_t default_action, action;
+        const SeccompProgram *program;
+        int r;
+
+        assert(u);
+        assert(command);
+        assert(c);
+        assert(p);
+
+        /* Compiling the system call filter is the expensive part of applying SystemCallFilter=, and many
+         * units use the very same filter. Hence compile it here in the manager, where the result is cached
+         * across spawns, and let the child only load it. Returns NULL if the child shall compile the filter
+         * itself, as it always did. */
+
+        if (!FLAGS_SET(p->flags, EXEC_APPLY_SANDBOXING) || FLAGS_SET(command->flags, EXEC_COMMAND_FULLY_PRIVILEGED))
+                return NULL;
+
+        if (!context_has_syscall_filters(c) || !is_seccomp_available())
+                return NULL;
+
+        /* The ambient capabilities hack extends the filter, let's not bother caching that */
+        if (FLAGS_SET(command->flags, EXEC_COMMAND_AMBIENT_MAGIC) && !ambient_capabilities_supported())
+                return NULL;
+
+        context_syscall_filter_actions(c, &default_action, &action);
+
+        r = seccomp_syscall_filter_cache_get(&u->manager->seccomp_programs, default_action, c->syscall_filter, action, &program);
+        if (r < 0) {
+                log_unit_debug_errno(u, r, "Failed to compile system call filter, leaving it to the child: %m");
+                return NULL;
+        }
+        if (r > 0)
+                log_unit_debug(u, "Compiled system call filter, %zu filters cached.", hashmap_size(u->manager->seccomp_programs));
+
+        return program;
+}
+
+static int apply_syscall_filter(
+                const Unit* u,
+                const ExecContext *c,
+                bool needs_ambient_hack,
+                const SeccompProgram *program) {
+
+        uint32_t default_action, action;
         int r;
 
         assert(u);
@@ -1489,15 +1584,11 @@ static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_
         if (skip_seccomp_unavailable(u, "SystemCallFilter="))
                 return 0;
 
-        negative_action = c->syscall_errno == SECCOMP_ERROR_NUMBER_KILL ? scmp_act_kill_process() : SCMP_ACT_ERRNO(c->syscall_errno);
+        /* Already compiled by the manager for us? */
+        if (program)
+                return seccomp_program_load(program);
 
-        if (c->syscall_allow_list) {
-                default_action = negative_action;
-                action = SCMP_ACT_ALLOW;
-        } else {
-                default_action = SCMP_ACT_ALLOW;
-                action = negative_action;
-        }
+        context_syscall_filter_actions(c, &default_action, &action);
 
         if (needs_ambient_hack) {
                 r = seccomp_filter_set_add(c->syscall_filter, c->syscall_allow_list, syscall_filter_sets + SYSCALL_FILTER_SET_SETUID);
@@ -3531,6 +3622,222 @@ static bool insist_on_sandboxing(
         return false;
 }
 
+static void mount_namespace_key_put(FILE *f, const char *field, const char *value) {
+        /* Fields are separated by NUL bytes, so that no value can be mistaken for another field */
+        fputs(field, f);
+        fputc('=', f);
+        fputs(strempty(value), f);
+        fputc(0, f);
+}
+
+static void mount_namespace_key_put_strv(FILE *f, const char *field, char **l) {
+        STRV_FOREACH(i, l)
+                mount_namespace_key_put(f, field, *i);
+}
+
+static bool mount_namespace_paths_optional(char **l) {
+        STRV_FOREACH(i, l)
+                if (startswith(*i, "-"))
+                        return true;
+
+        return false;
+}
+
+static int mount_namespace_key(
+                const ExecContext *context,
+                const NamespaceInfo *ns_info,
+                bool needs_sandboxing,
+                char **empty_directories,
+                char **symlinks,
+                const BindMount *bind_mounts,
+                size_t n_bind_mounts,
+                const char *tmp_dir,
+                const char *var_tmp_dir,
+                const char *creds_path,
+                const char *incoming_dir,
+                char **ret,
+                size_t *ret_size) {
+
+        _cleanup_free_ char *key = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t key_size = 0;
+        int r;
+
+        assert(context);
+        assert(ns_info);
+        assert(ret);
+        assert(ret_size);
+
+        /* Serializes everything that goes into setup_namespace() into a key for mount namespace templates,
+         * except for the unit's propagation directory, which mount_namespace_template_join() takes care of.
+         * Returns 0 if the namespace cannot be reused: because it pulls in images (which we don't want to
+         * keep busy) or a different root directory, because it's owned by the service's own user or IPC namespace, or because it contains
+         * file systems that are instantiated for it (e.g. the tmpfs of PrivateDevices=), which copies of the
+         * namespace would share with each other. Also returns 0 if any of the paths is optional: whether
+         * it exists is not part of the key, and a template built without it would hide it once it
+         * appears. */
+
+        if (context->root_image ||
+            context->root_directory ||
+            context->n_mount_images > 0 ||
+            context->n_extension_images > 0 ||
+            !strv_isempty(context->extension_directories) ||
+            context->private_users ||
+            context->n_temporary_filesystems > 0 ||
+            ns_info->private_dev ||
+            ns_info->private_ipc ||
+            ns_info->protect_home == PROTECT_HOME_TMPFS ||
+            mount_namespace_paths_optional(context->read_write_paths) ||
+            (needs_sandboxing &&
+             (mount_namespace_paths_optional(context->read_only_paths) ||
+              mount_namespace_paths_optional(context->inaccessible_paths) ||
+              mount_namespace_paths_optional(context->exec_paths) ||
+              mount_namespace_paths_optional(context->no_exec_paths)))) {
+                *ret = NULL;
+                *ret_size = 0;
+                return 0;
+        }
+
+        for (size_t i = 0; i < n_bind_mounts; i++)
+                if (bind_mounts[i].ignore_enoent) {
+                        *ret = NULL;
+                        *ret_size = 0;
+                        return 0;
+                }
+
+        f = open_memstream_unlocked(&key, &key_size);
+        if (!f)
+                return -ENOMEM;
+
+        fprintf(f, "ns-info=%i%i%i%i%i%i%i%i%i%i%i/%i/%i/%i/%i",
+                ns_info->ignore_protect_paths, ns_info->private_dev, ns_info->private_mounts,
+                ns_info->protect_control_groups, ns_info->protect_kernel_tunables,
+                ns_info->protect_kernel_modules, ns_info->protect_kernel_logs, ns_info->mount_apivfs,
+                ns_info->protect_hostname, ns_info->private_ipc, ns_info->mount_nosuid,
+                ns_info->protect_home, ns_info->protect_system, ns_info->protect_proc, ns_info->proc_subset);
+        fputc(0, f);
+        fprintf(f, "mount-flags=%lu", context->mount_flags);
+        fputc(0, f);
+
+        mount_namespace_key_put_strv(f, "read-write", context->read_write_paths);
+        if (needs_sandboxing) {
+                mount_namespace_key_put_strv(f, "read-only", context->read_only_paths);
+                mount_namespace_key_put_strv(f, "inaccessible", context->inaccessible_paths);
+                mount_namespace_key_put_strv(f, "exec", context->exec_paths);
+                mount_namespace_key_put_strv(f, "no-exec", context->no_exec_paths);
+        }
+        mount_namespace_key_put_strv(f, "empty-directory", empty_directories);
+        mount_namespace_key_put_strv(f, "symlink", symlinks);
+
+        for (size_t i = 0; i < n_bind_mounts; i++) {
+                fprintf(f, "bind=%i%i%i%i", bind_mounts[i].read_only, bind_mounts[i].nosuid,
+                        bind_mounts[i].recursive, bind_mounts[i].ignore_enoent);
+                fputc(0, f);
+                mount_namespace_key_put(f, "bind-source", bind_mounts[i].source);
+                mount_namespace_key_put(f, "bind-destination", bind_mounts[i].destination);
+        }
+
+        mount_namespace_key_put(f, "tmp", tmp_dir);
+        mount_namespace_key_put(f, "var-tmp", var_tmp_dir);
+        mount_namespace_key_put(f, "credentials", creds_path);
+        mount_namespace_key_put(f, "log-namespace", context->log_namespace);
+        mount_namespace_key_put(f, "incoming", incoming_dir);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        f = safe_fclose(f);
+
+        if (key_size > MOUNT_NAMESPACE_TEMPLATE_KEY_MAX) {
+                *ret = NULL;
+                *ret_size = 0;
+                return 0;
+        }
+
+        *ret = TAKE_PTR(key);
+        *ret_size = key_size;
+        return 1;
+}
+
+static int mount_namespace_identity_put(FILE *f, const char *path) {
+        struct stat st;
+
+        /* Skip the "+" prefix, there's no root directory if we get here */
+        path += startswith(path, "+") ? 1 : 0;
+
+        if (stat(path, &st) < 0)
+                return -errno;
+
+        fprintf(f, "%" PRIu64 ":%" PRIu64, (uint64_t) st.st_dev, (uint64_t) st.st_ino);
+        fputc(0, f);
+        return 0;
+}
+
+static int mount_namespace_identity(
+                const ExecContext *context,
+                bool needs_sandboxing,
+                const BindMount *bind_mounts,
+                size_t n_bind_mounts,
+                char **ret,
+                size_t *ret_size) {
+
+        _cleanup_free_ char *identity = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t identity_size = 0;
+        int r;
+
+        assert(context);
+        assert(ret);
+        assert(ret_size);
+
+        /* Records which inodes the paths of the mount namespace currently refer to, so that a template built
+         * from a bind mount source or an inaccessible path which got replaced since is not joined. Returns
+         * 0 if some path cannot be looked up, in which case setup_namespace() will fail or at least not
+         * produce the same result for it either, and the namespace should not be reused. */
+
+        f = open_memstream_unlocked(&identity, &identity_size);
+        if (!f)
+                return -ENOMEM;
+
+        char **lists[] = {
+                context->read_write_paths,
+                needs_sandboxing ? context->read_only_paths : NULL,
+                needs_sandboxing ? context->inaccessible_paths : NULL,
+                needs_sandboxing ? context->exec_paths : NULL,
+                needs_sandboxing ? context->no_exec_paths : NULL,
+        };
+
+        for (size_t i = 0; i < ELEMENTSOF(lists); i++)
+                STRV_FOREACH(p, lists[i]) {
+                        r = mount_namespace_identity_put(f, *p);
+                        if (r < 0)
+                                goto not_reusable;
+                }
+
+        for (size_t i = 0; i < n_bind_mounts; i++) {
+                r = mount_namespace_identity_put(f, bind_mounts[i].source);
+                if (r < 0)
+                        goto not_reusable;
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        f = safe_fclose(f);
+
+        *ret = TAKE_PTR(identity);
+        *ret_size = identity_size;
+        return 1;
+
+not_reusable:
+        log_debug_errno(r, "Failed to look up path of mount namespace, not using mount namespace templates: %m");
+        *ret = NULL;
+        *ret_size = 0;
+        return 0;
+}
+
 static int apply_mount_namespace(
                 const Unit *u,
                 ExecCommandFlags command_flags,
@@ -3543,11 +3850,11 @@ static int apply_mount_namespace(
         const char *tmp_dir = NULL, *var_tmp_dir = NULL;
         const char *root_dir = NULL, *root_image = NULL;
         _cleanup_free_ char *creds_path = NULL, *incoming_dir = NULL, *propagate_dir = NULL,
-                        *extension_dir = NULL;
+                        *extension_dir = NULL, *key = NULL, *identity = NULL;
         NamespaceInfo ns_info;
         bool needs_sandboxing;
         BindMount *bind_mounts = NULL;
-        size_t n_bind_mounts = 0;
+        size_t n_bind_mounts = 0, key_size = 0, identity_size = 0;
         int r;
 
         assert(context);
@@ -3654,6 +3961,38 @@ static int apply_mount_namespace(
                         goto finalize;
                 }
 
+        if (params->mount_ns_storage_socket) {
+                r = mount_namespace_key(context, &ns_info, needs_sandboxing,
+                                        empty_directories, symlinks, bind_mounts, n_bind_mounts,
+                                        tmp_dir, var_tmp_dir, creds_path, incoming_dir,
+                                        &key, &key_size);
+                if (r < 0)
+                        goto finalize;
+        }
+
+        if (key) {
+                r = mount_namespace_identity(context, needs_sandboxing, bind_mounts, n_bind_mounts,
+                                             &identity, &identity_size);
+                if (r < 0)
+                        goto finalize;
+                if (r == 0)
+                        key = mfree(key);
+        }
+
+        if (key) {
+                r = mount_namespace_template_join(params->mount_ns_storage_socket, key, key_size,
+                                                  identity, identity_size,
+                                                  context->mount_flags,
+                                                  propagate_dir, propagate_dir ? incoming_dir : NULL);
+                if (r < 0)
+                        goto finalize;
+                if (r > 0) {
+                        log_unit_debug(u, "Reusing cached mount namespace.");
+                        r = 0;
+                        goto finalize;
+                }
+        }
+
         r = setup_namespace(root_dir, root_image, context->root_image_options,
                             &ns_info, context->read_write_paths,
                             needs_sandboxing ? context->read_only_paths : NULL,
@@ -3685,6 +4024,15 @@ static int apply_mount_namespace(
                             root_dir || root_image ? params->notify_socket : NULL,
                             error_path);
 
+        /* Keep the namespace we just built around for the next process with the same settings */
+        if (r >= 0 && key) {
+                r = mount_namespace_template_store(params->mount_ns_storage_socket, key, key_size,
+                                                   identity, identity_size,
+                                                   context->mount_flags, propagate_dir ? incoming_dir : NULL);
+                if (r > 0)
+                        r = 0;
+        }
+
         /* If we couldn't set up the namespace this is probably due to a missing capability. setup_namespace() reports
          * that with a special, recognizable error ENOANO. In this case, silently proceed, but only if exclusively
          * sandboxing options were used, i.e. nothing such as RootDirectory= or BindMount= that would result in a
@@ -3896,7 +4244,7 @@ static int close_remaining_fds(
                 const int *fds, size_t n_fds) {
 
         size_t n_dont_close = 0;
-        int dont_close[n_fds + 12];
+        int dont_close[n_fds + 14];
 
         assert(params);
 
@@ -3926,6 +4274,9 @@ static int close_remaining_fds(
                         append_socket_pair(dont_close, &n_dont_close, dcreds->group->storage_socket);
         }
 
+        if (params->mount_ns_storage_socket)
+                append_socket_pair(dont_close, &n_dont_close, params->mount_ns_storage_socket);
+
         if (user_lookup_fd >= 0)
                 dont_close[n_dont_close++] = user_lookup_fd;
 
@@ -4126,6 +4477,7 @@ static int exec_child(
                 size_t n_storage_fds,
                 char **files_env,
                 int user_lookup_fd,
+                const SeccompProgram *syscall_filter_program,
                 int *exit_status) {
 
         _cleanup_strv_free_ char **our_env = NULL, **pass_env = NULL, **joined_exec_search_path = NULL, **accum_env = NULL, **replaced_argv = NULL;
@@ -4138,6 +4490,7 @@ static int exec_child(
         dev_t journal_stream_dev = 0;
         ino_t journal_stream_ino = 0;
         bool userns_set_up = false;
+        usec_t trace_start, ts;
         bool needs_sandboxing,          /* Do we need to set up full sandboxing? (i.e. all namespacing, all MAC stuff, caps, yadda yadda */
                 needs_setuid,           /* Do we need to do the actual setresuid()/setresgid() calls? */
                 needs_mount_namespace,  /* Do we need to set up a mount namespace for this kernel? */
@@ -4172,6 +4525,8 @@ static int exec_child(
         assert(command->path);
         assert(!strv_isempty(command->argv));
 
+        trace_start = boot_trace_now(params->boot_trace);
+
         rename_process_from_path(command->path);
 
         /* We reset exactly these signals, since they are the only ones we set to SIG_IGN in the main
@@ -4556,18 +4911,22 @@ static int exec_child(
 
         needs_mount_namespace = exec_needs_mount_namespace(context, params, runtime);
 
+        ts = boot_trace_now(params->boot_trace);
         for (ExecDirectoryType dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++) {
                 r = setup_exec_directory(context, params, uid, gid, dt, needs_mount_namespace, exit_status);
                 if (r < 0)
                         return log_unit_error_errno(unit, r, "Failed to set up special execution directory in %s: %m", params->prefix[dt]);
         }
+        boot_trace_record(params->boot_trace, unit->id, "exec-directories", getpid_cached(), ts, boot_trace_now(params->boot_trace));
 
         if (FLAGS_SET(params->flags, EXEC_WRITE_CREDENTIALS)) {
+                ts = boot_trace_now(params->boot_trace);
                 r = setup_credentials(context, params, unit->id, uid);
                 if (r < 0) {
                         *exit_status = EXIT_CREDENTIALS;
                         return log_unit_error_errno(unit, r, "Failed to set up credentials: %m");
                 }
+                boot_trace_record(params->boot_trace, unit->id, "credentials", getpid_cached(), ts, boot_trace_now(params->boot_trace));
         }
 
         r = build_environment(
@@ -4752,12 +5111,14 @@ static int exec_child(
         if (needs_mount_namespace) {
                 _cleanup_free_ char *error_path = NULL;
 
+                ts = boot_trace_now(params->boot_trace);
                 r = apply_mount_namespace(unit, command->flags, context, params, runtime, &error_path);
                 if (r < 0) {
                         *exit_status = EXIT_NAMESPACE;
                         return log_unit_error_errno(unit, r, "Failed to set up mount namespacing%s%s: %m",
                                                     error_path ? ": " : "", strempty(error_path));
                 }
+                boot_trace_record(params->boot_trace, unit->id, "mount-namespace", getpid_cached(), ts, boot_trace_now(params->boot_trace));
         }
 
         if (needs_sandboxing) {
@@ -5120,7 +5481,7 @@ static int exec_child(
 
                 /* This really should remain the last step before the execve(), to make sure our own code is unaffected
                  * by the filter as little as possible. */
-                r = apply_syscall_filter(unit, context, needs_ambient_hack);
+                r = apply_syscall_filter(unit, context, needs_ambient_hack, syscall_filter_program);
                 if (r < 0) {
                         *exit_status = EXIT_SECCOMP;
                         return log_unit_error_errno(unit, r, "Failed to apply system call filters: %m");
@@ -5185,6 +5546,9 @@ static int exec_child(
                 }
         }
 
+        /* Everything between fork() and execve() */
+        boot_trace_record(params->boot_trace, unit->id, "exec-setup", getpid_cached(), trace_start, boot_trace_now(params->boot_trace));
+
         r = fexecve_or_execve(executable_fd, executable, final_argv, accum_env);
 
         if (exec_fd >= 0) {
@@ -5206,6 +5570,683 @@ static int exec_child(
 static int exec_context_load_environment(const Unit *unit, const ExecContext *c, char ***l);
 static int exec_context_named_iofds(const ExecContext *c, const ExecParameters *p, int named_iofds[static 3]);
 
+/* fork()ing off PID 1 costs a copy of all its page tables, which adds up when many units are loaded. Services
+ * that need none of the credential, terminal, namespace or sandboxing logic of exec_child() are hence spawned
+ * via safe_vfork() instead: everything that needs memory allocation or logging is prepared here, and the
+ * child only issues the handful of system calls exec_child() would do for it, reporting any failure back
+ * through the shared ExecLightSpawn structure. Anything else takes the regular fork() path.
+ *
+ * Note that PID 1 is suspended until the child called execve(). Hence anything that might block for an
+ * unbounded time, i.e. accessing file systems other than the one the executable is on (WorkingDirectory=),
+ * takes the fork() path too. The child connects to journald without blocking, and if journald doesn't accept
+ * the connection right away, it backs out before changing anything and the command is forked off instead.
+ * The connection has to be made by the child, since journald attributes the stream to the process that
+ * connected it. */
+
+typedef enum ExecLightOutput {
+        EXEC_LIGHT_OUTPUT_KEEP,
+        EXEC_LIGHT_OUTPUT_NULL,
+        EXEC_LIGHT_OUTPUT_STDOUT,
+        EXEC_LIGHT_OUTPUT_JOURNAL,
+} ExecLightOutput;
+
+typedef struct ExecLightSpawn {
+        /* Prepared by the parent */
+        const ExecContext *context;
+        const char *executable;
+        char **argv;
+        char **envp;
+        const char *cgroup_procs;
+        ExecLightOutput output[3];
+        const char *journal_header[3];
+        union sockaddr_union journal_address;
+        socklen_t journal_address_len;
+        sd_id128_t invocation_id;
+        bool apply_sandboxing;
+        bool ignore_failure;
+        bool ambient_capabilities;
+        bool oom_score_adjust_set;
+        char oom_score_adjust[DECIMAL_STR_MAX(int)];
+
+        /* Patched in by the child */
+        char **journal_stream_slot;
+        char journal_stream[STRLEN("JOURNAL_STREAM=") + DECIMAL_STR_MAX(dev_t) + 1 + DECIMAL_STR_MAX(ino_t)];
+        char exec_pid[STRLEN("SYSTEMD_EXEC_PID=") + DECIMAL_STR_MAX(pid_t)];
+
+        /* Used by the child only */
+        int journal_fd[3];
+
+        /* Reported back by the child */
+        int exit_status;
+        int error;
+        const char *error_message;
+        bool executable_missing;
+        bool journal_busy;
+        int rlimit_failed;
+        int journal_error[3];
+} ExecLightSpawn;
+
+static bool exec_light_output_supported(ExecOutput o) {
+        /* Console outputs are left out, since they need $TERM, which is determined with the help of the
+         * terminal logic. */
+        return IN_SET(o, EXEC_OUTPUT_INHERIT, EXEC_OUTPUT_NULL, EXEC_OUTPUT_KMSG, EXEC_OUTPUT_JOURNAL);
+}
+
+static bool exec_light_spawn_possible(
+                Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                const ExecRuntime *runtime) {
+
+        static int enabled = -1, have_close_range = -1;
+
+        assert(unit);
+        assert(command);
+        assert(context);
+        assert(params);
+
+        if (enabled < 0) {
+                int r;
+
+                r = getenv_bool_secure("SYSTEMD_EXEC_VFORK");
+                if (r < 0 && r != -ENXIO)
+                        log_debug_errno(r, "Failed to parse $SYSTEMD_EXEC_VFORK, ignoring: %m");
+                enabled = r != 0;
+        }
+        if (!enabled)
+                return false;
+
+        /* The child cannot fall back to iterating through /proc/self/fd/, as that allocates memory */
+        if (have_close_range < 0)
+                have_close_range = close_range(INT_MAX, INT_MAX, 0) >= 0;
+        if (!have_close_range)
+                return false;
+
+        /* Credentials, PAM, NSS and terminals */
+        if (context->user || context->group || !strv_isempty(context->supplementary_groups) ||
+            context->pam_name || context->dynamic_user || context->working_directory_home || context->utmp_id)
+                return false;
+        if (context->working_directory)
+                return false;
+        if (context->tty_path || context->tty_reset || context->tty_vhangup || context->tty_vt_disallocate)
+                return false;
+        if (context->std_input != EXEC_INPUT_NULL ||
+            !exec_light_output_supported(context->std_output) ||
+            !exec_light_output_supported(context->std_error))
+                return false;
+        if (unit_shall_confirm_spawn(unit))
+                return false;
+
+        /* Passed file descriptors, and anything that derives environment variables from our child's PID */
+        if (params->n_socket_fds + params->n_storage_fds > 0 ||
+            params->stdin_fd >= 0 || params->stdout_fd >= 0 || params->stderr_fd >= 0 ||
+            params->exec_fd >= 0 || params->idle_pipe)
+                return false;
+        if (FLAGS_SET(params->flags, EXEC_SET_WATCHDOG) && params->watchdog_usec > 0)
+                return false;
+
+        /* Namespaces, file system setup and credentials */
+        if (context->root_directory || context->root_image ||
+            exec_needs_mount_namespace(context, params, runtime))
+                return false;
+        if (context->private_users || context->private_network || context->network_namespace_path ||
+            context->private_ipc || context->ipc_namespace_path || context->protect_hostname)
+                return false;
+        for (ExecDirectoryType t = 0; t < _EXEC_DIRECTORY_TYPE_MAX; t++)
+                if (context->directories[t].n_items > 0)
+                        return false;
+        if (exec_context_has_credentials(context))
+                return false;
+
+        /* Scheduling and other process properties */
+        if (context->coredump_filter_set || context->cpu_sched_set || context->nice_set || context->ioprio_set ||
+            context->cpu_affinity_from_numa || context->cpu_set.set ||
+            mpol_is_valid(numa_policy_get_type(&context->numa_policy)) ||
+            context->timer_slack_nsec != NSEC_INFINITY || context->personality != PERSONALITY_INVALID)
+                return false;
+
+        /* Capabilities, MACs and seccomp */
+        if (!cap_test_all(context->capability_bounding_set) || context->capability_ambient_set != 0 ||
+            FLAGS_SET(command->flags, EXEC_COMMAND_AMBIENT_MAGIC))
+                return false;
+        if (prctl(PR_GET_SECUREBITS) != context->secure_bits)
+                return false;
+        if (context_has_no_new_privileges(context) ||
+            context_has_address_families(context) ||
+            context_has_syscall_filters(context) ||
+            context_has_syscall_logs(context) ||
+            !set_isempty(context->syscall_archs) ||
+            exec_context_restrict_namespaces_set(context) ||
+            exec_context_restrict_filesystems_set(context) ||
+            context->memory_deny_write_execute ||
+            context->restrict_realtime ||
+            context->restrict_suid_sgid ||
+            context->lock_personality ||
+            context->protect_clock ||
+            context->protect_kernel_tunables ||
+            context->protect_kernel_modules ||
+            context->protect_kernel_logs ||
+            context->private_devices)
+                return false;
+        if (context->selinux_context || context->apparmor_profile || context->smack_process_label ||
+            params->selinux_context_net || mac_smack_use())
+                return false;
+
+        /* Environment and command line handling */
+        if (!strv_isempty(context->unset_environment) || !strv_isempty(context->exec_search_path))
+                return false;
+        if (!path_is_absolute(command->path))
+                return false;
+        if (!FLAGS_SET(command->flags, EXEC_COMMAND_NO_ENV_EXPAND))
+                STRV_FOREACH(a, command->argv)
+                        if (strchr(*a, '$'))
+                                return false;
+
+        /* Joining the cgroup must be a single write */
+        if (params->cgroup_path && cg_all_unified() <= 0)
+                return false;
+
+        return true;
+}
+
+static bool exec_light_env_overridden(const ExecContext *context, char **pass_env, char **files_env, const char *name) {
+        /* Returns true if the variable is set by one of the sources that take precedence over the variables
+         * we define ourselves, see exec_child(). */
+        return strv_env_get(pass_env, name) ||
+                strv_env_get(context->environment, name) ||
+                strv_env_get(files_env, name);
+}
+
+static int exec_light_fail(ExecLightSpawn *s, int exit_status, int error, const char *message) {
+        s->exit_status = exit_status;
+        s->error = -abs(error);
+        s->error_message = message;
+
+        return exit_status;
+}
+
+static int exec_light_connect_journal(ExecLightSpawn *s) {
+        /* Connects the journal streams before the child changed anything, so that it can still back out
+         * and leave the command to the fork() path if journald's backlog is full. Returns -EAGAIN then.
+         * Other errors are reported back, the output goes to /dev/null then, like in setup_output(). */
+
+        for (int fileno = STDOUT_FILENO; fileno <= STDERR_FILENO; fileno++) {
+                _cleanup_close_ int fd = -1;
+
+                if (s->output[fileno] != EXEC_LIGHT_OUTPUT_JOURNAL)
+                        continue;
+
+                fd = socket(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+                if (fd < 0) {
+                        s->journal_error[fileno] = -errno;
+                        continue;
+                }
+
+                if (connect(fd, &s->journal_address.sa, s->journal_address_len) < 0) {
+                        if (errno == EAGAIN)
+                                return -EAGAIN;
+
+                        s->journal_error[fileno] = -errno;
+                        continue;
+                }
+
+                s->journal_fd[fileno] = TAKE_FD(fd);
+        }
+
+        return 0;
+}
+
+static int exec_light_setup_journal(ExecLightSpawn *s, int fileno) {
+        _cleanup_close_ int fd = TAKE_FD(s->journal_fd[fileno]);
+        const char *header = s->journal_header[fileno];
+        struct stat st;
+        ssize_t n;
+        int r;
+
+        if (fd < 0)
+                return s->journal_error[fileno];
+
+        if (shutdown(fd, SHUT_RD) < 0)
+                return -errno;
+
+        (void) fd_inc_sndbuf(fd, SNDBUF_SIZE);
+
+        /* Still non-blocking, the header fits into the send buffer of a fresh connection */
+        n = send(fd, header, strlen(header), MSG_NOSIGNAL);
+        if (n < 0)
+                return -errno;
+        if ((size_t) n != strlen(header))
+                return -EIO;
+
+        r = fd_nonblock(fd, false);
+        if (r < 0)
+                return r;
+
+        r = move_fd(TAKE_FD(fd), fileno, false);
+        if (r < 0)
+                return r;
+
+        /* Like in setup_output(), stderr wins if both are connected to a stream */
+        if (s->journal_stream_slot && fstat(fileno, &st) >= 0) {
+                (void) snprintf(s->journal_stream, sizeof(s->journal_stream),
+                                "JOURNAL_STREAM=" DEV_FMT ":" INO_FMT, st.st_dev, st.st_ino);
+                *s->journal_stream_slot = s->journal_stream;
+        }
+
+        return 0;
+}
+
+static int exec_light_setup_output(ExecLightSpawn *s, int fileno) {
+        int r;
+
+        switch (s->output[fileno]) {
+
+        case EXEC_LIGHT_OUTPUT_KEEP:
+                return 0;
+
+        case EXEC_LIGHT_OUTPUT_NULL:
+                return open_null_as(O_WRONLY, fileno);
+
+        case EXEC_LIGHT_OUTPUT_STDOUT:
+                return RET_NERRNO(dup2(STDOUT_FILENO, fileno));
+
+        case EXEC_LIGHT_OUTPUT_JOURNAL:
+                r = exec_light_setup_journal(s, fileno);
+                if (r < 0) {
+                        s->journal_error[fileno] = r;
+                        return open_null_as(O_WRONLY, fileno);
+                }
+                return 0;
+
+        default:
+                assert_not_reached();
+        }
+}
+
+static int exec_light_setrlimits(const ExecContext *context, int *which_failed) {
+        /* Same as setrlimit_closest_all(), but without logging */
+        for (int i = 0; i < _RLIMIT_MAX; i++) {
+                struct rlimit highest, fixed;
+
+                if (!context->rlimit[i])
+                        continue;
+
+                *which_failed = i;
+
+                if (setrlimit(i, context->rlimit[i]) >= 0)
+                        continue;
+                if (errno != EPERM)
+                        return -errno;
+
+                if (getrlimit(i, &highest) < 0)
+                        return -errno;
+                if (highest.rlim_max == RLIM_INFINITY)
+                        return -EPERM;
+
+                fixed = (struct rlimit) {
+                        .rlim_cur = MIN(context->rlimit[i]->rlim_cur, highest.rlim_max),
+                        .rlim_max = MIN(context->rlimit[i]->rlim_max, highest.rlim_max),
+                };
+                if (fixed.rlim_cur == highest.rlim_cur && fixed.rlim_max == highest.rlim_max)
+                        continue;
+
+                if (setrlimit(i, &fixed) < 0)
+                        return -errno;
+        }
+
+        return 0;
+}
+
+static int exec_light_drop_inherited_capabilities(void) {
+        struct __user_cap_header_struct header = {
+                .version = _LINUX_CAPABILITY_VERSION_3,
+        };
+        struct __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3] = {};
+        bool changed = false;
+
+        /* Equivalent to capability_ambient_set_apply(0, true), which would need libcap's allocations */
+
+        if (prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_CLEAR_ALL, 0, 0, 0) < 0)
+                return -errno;
+
+        if (capget(&header, data) < 0)
+                return -errno;
+
+        for (size_t i = 0; i < ELEMENTSOF(data); i++)
+                if (data[i].inheritable != 0) {
+                        data[i].inheritable = 0;
+                        changed = true;
+                }
+
+        if (changed && capset(&header, data) < 0)
+                return -errno;
+
+        return 0;
+}
+
+static int exec_light_child(void *userdata) {
+        ExecLightSpawn *s = ASSERT_PTR(userdata);
+        const ExecContext *context = s->context;
+        _cleanup_close_ int executable_fd = -1;
+        int r;
+
+        /* Runs in the address space of PID 1, see safe_vfork(). No allocations, no logging. */
+
+        (void) default_signals(SIGNALS_CRASH_HANDLER, SIGNALS_IGNORE);
+
+        if (context->ignore_sigpipe)
+                (void) ignore_signals(SIGPIPE);
+
+        r = reset_signal_mask();
+        if (r < 0)
+                return exec_light_fail(s, EXIT_SIGNAL_MASK, r, "Failed to set process signal mask");
+
+        if (close_range(3, INT_MAX, 0) < 0)
+                return exec_light_fail(s, EXIT_FDS, errno, "Failed to close unwanted file descriptors");
+
+        if (exec_light_connect_journal(s) == -EAGAIN) {
+                s->journal_busy = true;
+                return EXIT_STDOUT;
+        }
+
+        if (!context->same_pgrp && setsid() < 0)
+                return exec_light_fail(s, EXIT_SETSID, errno, "Failed to create new process session");
+
+        /* Join the cgroup before talking to journald, so that it can look up our unit */
+        if (s->cgroup_procs) {
+                _cleanup_close_ int fd = -1;
+
+                fd = open(s->cgroup_procs, O_WRONLY|O_CLOEXEC|O_NOCTTY);
+                r = fd < 0 ? -errno : loop_write(fd, "0", 1, false);
+                if (r < 0)
+                        return exec_light_fail(s, EXIT_CGROUP, r, NULL);
+        }
+
+        r = open_null_as(O_RDONLY, STDIN_FILENO);
+        if (r < 0)
+                return exec_light_fail(s, EXIT_STDIN, r, "Failed to set up standard input");
+
+        r = exec_light_setup_output(s, STDOUT_FILENO);
+        if (r < 0)
+                return exec_light_fail(s, EXIT_STDOUT, r, "Failed to set up standard output");
+
+        r = exec_light_setup_output(s, STDERR_FILENO);
+        if (r < 0)
+                return exec_light_fail(s, EXIT_STDERR, r, "Failed to set up standard error output");
+
+        if (s->oom_score_adjust_set) {
+                _cleanup_close_ int fd = -1;
+
+                /* Silently skipped on EPERM, like in exec_child() */
+                fd = open("/proc/self/oom_score_adj", O_WRONLY|O_CLOEXEC|O_NOCTTY);
+                r = fd < 0 ? -errno : loop_write(fd, s->oom_score_adjust, strlen(s->oom_score_adjust), false);
+                if (r < 0 && !ERRNO_IS_PRIVILEGE(r))
+                        return exec_light_fail(s, EXIT_OOM_ADJUST, r, "Failed to adjust OOM setting");
+        }
+
+        (void) snprintf(s->exec_pid, sizeof(s->exec_pid), "SYSTEMD_EXEC_PID=" PID_FMT, raw_getpid());
+
+        (void) umask(context->umask);
+
+        if (context->keyring_mode != EXEC_KEYRING_INHERIT) {
+                /* See setup_keyring(), we never change UID here */
+                if (keyctl(KEYCTL_JOIN_SESSION_KEYRING, 0, 0, 0, 0) == -1) {
+                        if (errno != ENOSYS && !ERRNO_IS_PRIVILEGE(errno) && errno != EDQUOT)
+                                return exec_light_fail(s, EXIT_KEYRING, errno, "Setting up kernel keyring failed");
+                } else {
+                        if (context->keyring_mode == EXEC_KEYRING_SHARED &&
+                            keyctl(KEYCTL_LINK, KEY_SPEC_USER_KEYRING, KEY_SPEC_SESSION_KEYRING, 0, 0) < 0)
+                                return exec_light_fail(s, EXIT_KEYRING, errno, "Failed to link user keyring into session keyring");
+
+                        if (!sd_id128_is_null(s->invocation_id)) {
+                                key_serial_t key;
+
+                                key = add_key("user", "invocation_id", &s->invocation_id, sizeof(s->invocation_id), KEY_SPEC_SESSION_KEYRING);
+                                if (key != -1 &&
+                                    keyctl(KEYCTL_SETPERM, key,
+                                           KEY_POS_VIEW|KEY_POS_READ|KEY_POS_SEARCH|
+                                           KEY_USR_VIEW|KEY_USR_READ|KEY_USR_SEARCH, 0, 0) < 0)
+                                        return exec_light_fail(s, EXIT_KEYRING, errno, "Failed to restrict invocation ID permission");
+                        }
+                }
+        }
+
+        if (s->apply_sandboxing) {
+                r = exec_light_setrlimits(context, &s->rlimit_failed);
+                if (r < 0)
+                        return exec_light_fail(s, EXIT_LIMITS, r, NULL);
+
+                if (s->ambient_capabilities) {
+                        r = exec_light_drop_inherited_capabilities();
+                        if (r < 0)
+                                return exec_light_fail(s, EXIT_CAPABILITIES, r, "Failed to apply ambient capabilities (before UID change)");
+                }
+        }
+
+        if (chdir("/") < 0)
+                return exec_light_fail(s, EXIT_CHDIR, errno, "Changing to the requested working directory failed");
+
+        /* Mirror the checks find_executable_full() does for absolute paths, so that a "-" prefix on the
+         * command skips missing executables the same way. */
+        executable_fd = open(s->executable, O_PATH|O_CLOEXEC);
+        if (executable_fd < 0)
+                r = -errno;
+        else {
+                r = fd_verify_regular(executable_fd);
+                if (r >= 0 && access(s->executable, X_OK) < 0)
+                        r = -errno;
+        }
+        if (r < 0) {
+                s->executable_missing = true;
+                return exec_light_fail(s, s->ignore_failure ? EXIT_SUCCESS : EXIT_EXEC, r, NULL);
+        }
+
+        execve(s->executable, s->argv, s->envp);
+        return exec_light_fail(s, EXIT_EXEC, errno, "Failed to execute");
+}
+
+static int exec_spawn_light(
+                Unit *unit,
+                ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                ExecRuntime *runtime,
+                char **files_env,
+                pid_t *ret) {
+
+        _cleanup_strv_free_ char **our_env = NULL, **pass_env = NULL, **accum_env = NULL;
+        _cleanup_free_ char *cgroup_path = NULL, *cgroup_procs = NULL, *stdout_header = NULL, *stderr_header = NULL;
+        _cleanup_free_ char **envp = NULL;
+        ExecOutput o, e;
+        const char *socket_path;
+        char *journal_stream_fallback = NULL;
+        bool own_exec_pid, own_journal_stream;
+        size_t n = 0;
+        pid_t pid;
+        int r;
+
+        assert(unit);
+        assert(command);
+        assert(context);
+        assert(params);
+        assert(ret);
+
+        /* Returns 0 if the command needs the full exec_child() treatment, 1 if it was spawned */
+
+        if (!exec_light_spawn_possible(unit, command, context, params, runtime))
+                return 0;
+
+        ExecLightSpawn s = {
+                .context = context,
+                .executable = command->path,
+                .argv = command->argv,
+                .invocation_id = unit->invocation_id,
+                .apply_sandboxing = FLAGS_SET(params->flags, EXEC_APPLY_SANDBOXING) &&
+                                    !FLAGS_SET(command->flags, EXEC_COMMAND_FULLY_PRIVILEGED),
+                .ignore_failure = FLAGS_SET(command->flags, EXEC_COMMAND_IGNORE_FAILURE),
+                .ambient_capabilities = ambient_capabilities_supported(),
+                .oom_score_adjust_set = context->oom_score_adjust_set,
+                .journal_fd = { -1, -1, -1 },
+                .exit_status = EXIT_SUCCESS,
+        };
+
+        if (context->oom_score_adjust_set)
+                xsprintf(s.oom_score_adjust, "%i", context->oom_score_adjust);
+
+        /* The same decisions setup_output() takes, with standard input connected to /dev/null. Note that
+         * we are the parent of the child here. */
+        o = context->std_output;
+        e = context->std_error;
+
+        if (o == EXEC_OUTPUT_INHERIT)
+                s.output[STDOUT_FILENO] = getpid_cached() == 1 ? EXEC_LIGHT_OUTPUT_NULL : EXEC_LIGHT_OUTPUT_KEEP;
+        else
+                s.output[STDOUT_FILENO] = o == EXEC_OUTPUT_NULL ? EXEC_LIGHT_OUTPUT_NULL : EXEC_LIGHT_OUTPUT_JOURNAL;
+
+        if (e == EXEC_OUTPUT_INHERIT && o == EXEC_OUTPUT_INHERIT && getpid_cached() != 1)
+                s.output[STDERR_FILENO] = EXEC_LIGHT_OUTPUT_KEEP;
+        else if (can_inherit_stderr_from_stdout(context, o, e))
+                s.output[STDERR_FILENO] = EXEC_LIGHT_OUTPUT_STDOUT;
+        else
+                s.output[STDERR_FILENO] = e == EXEC_OUTPUT_NULL ? EXEC_LIGHT_OUTPUT_NULL : EXEC_LIGHT_OUTPUT_JOURNAL;
+
+        if (s.output[STDOUT_FILENO] == EXEC_LIGHT_OUTPUT_JOURNAL) {
+                r = build_logger_header(unit, context, params, o, basename(command->path), &stdout_header);
+                if (r < 0)
+                        return log_oom();
+                s.journal_header[STDOUT_FILENO] = stdout_header;
+        }
+
+        if (s.output[STDERR_FILENO] == EXEC_LIGHT_OUTPUT_JOURNAL) {
+                r = build_logger_header(unit, context, params, e, basename(command->path), &stderr_header);
+                if (r < 0)
+                        return log_oom();
+                s.journal_header[STDERR_FILENO] = stderr_header;
+        }
+
+        if (stdout_header || stderr_header) {
+                socket_path = context->log_namespace ?
+                        strjoina("/run/systemd/journal.", context->log_namespace, "/stdout") :
+                        "/run/systemd/journal/stdout";
+
+                r = sockaddr_un_set_path(&s.journal_address.un, socket_path);
+                if (r < 0) /* Too long, exec_child() knows how to deal with that */
+                        return 0;
+                s.journal_address_len = r;
+        }
+
+        if (params->cgroup_path) {
+                r = exec_parameters_get_cgroup_path(params, &cgroup_path);
+                if (r < 0)
+                        return log_unit_error_errno(unit, r, "Failed to acquire cgroup path: %m");
+
+                r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, cgroup_path, "cgroup.procs", &cgroup_procs);
+                if (r < 0)
+                        return log_unit_error_errno(unit, r, "Failed to determine cgroup.procs path of %s: %m", cgroup_path);
+                s.cgroup_procs = cgroup_procs;
+        }
+
+        /* Build the environment exactly like exec_child() does, but with placeholders for the variables
+         * only the child knows the values of. */
+        r = build_environment(unit, context, params, 0, NULL, NULL, NULL, 0, 0, &our_env);
+        if (r < 0)
+                return log_oom();
+
+        r = build_pass_environment(context, &pass_env);
+        if (r < 0)
+                return log_oom();
+
+        accum_env = strv_env_merge(params->environment, our_env, pass_env, context->environment, files_env);
+        if (!accum_env)
+                return log_oom();
+        accum_env = strv_env_clean(accum_env);
+
+        own_exec_pid = !exec_light_env_overridden(context, pass_env, files_env, "SYSTEMD_EXEC_PID");
+        own_journal_stream = (stdout_header || stderr_header) &&
+                !exec_light_env_overridden(context, pass_env, files_env, "JOURNAL_STREAM");
+
+        envp = new(char*, strv_length(accum_env) + 2);
+        if (!envp)
+                return log_oom();
+
+        STRV_FOREACH(i, accum_env) {
+                if (own_exec_pid && startswith(*i, "SYSTEMD_EXEC_PID="))
+                        envp[n++] = s.exec_pid;
+                else if (own_journal_stream && startswith(*i, "JOURNAL_STREAM="))
+                        /* Inherited from our own environment, only used if we fail to connect */
+                        journal_stream_fallback = *i;
+                else
+                        envp[n++] = *i;
+        }
+        if (own_journal_stream) {
+                s.journal_stream_slot = envp + n;
+                envp[n++] = journal_stream_fallback;
+        }
+        envp[n] = NULL;
+        s.envp = envp;
+
+        r = safe_vfork(exec_light_child, &s, &pid);
+        if (r < 0)
+                return log_unit_error_errno(unit, r, "Failed to fork: %m");
+
+        /* The child is either running the command or already dead by now, report what it found */
+
+        if (s.journal_busy) {
+                /* The child backed out before it changed anything, reap it and let exec_child() wait for
+                 * journald instead */
+                (void) wait_for_terminate(pid, NULL);
+
+                log_unit_debug(unit, "Journal socket busy, forking off %s instead.", command->path);
+                return 0;
+        }
+
+        for (int fileno = STDOUT_FILENO; fileno <= STDERR_FILENO; fileno++)
+                if (s.journal_error[fileno] < 0)
+                        log_unit_warning_errno(unit, s.journal_error[fileno],
+                                               "Failed to connect %s to the journal socket, ignoring: %m",
+                                               fileno == STDOUT_FILENO ? "stdout" : "stderr");
+
+        if (s.error < 0) {
+                if (s.executable_missing && s.exit_status == EXIT_SUCCESS)
+                        log_unit_struct_errno(unit, LOG_INFO, s.error,
+                                              "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
+                                              LOG_UNIT_INVOCATION_ID(unit),
+                                              LOG_UNIT_MESSAGE(unit, "Executable %s missing, skipping: %m",
+                                                               command->path),
+                                              "EXECUTABLE=%s", command->path);
+                else if (s.executable_missing)
+                        log_unit_struct_errno(unit, LOG_INFO, s.error,
+                                              "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
+                                              LOG_UNIT_INVOCATION_ID(unit),
+                                              LOG_UNIT_MESSAGE(unit, "Failed to locate executable %s: %m",
+                                                               command->path),
+                                              "EXECUTABLE=%s", command->path);
+                else if (s.exit_status == EXIT_CGROUP)
+                        log_unit_error_errno(unit, s.error, "Failed to attach to cgroup %s: %m", cgroup_path);
+                else if (s.exit_status == EXIT_LIMITS)
+                        log_unit_error_errno(unit, s.error, "Failed to adjust resource limit RLIMIT_%s: %m",
+                                             rlimit_to_string(s.rlimit_failed));
+                else
+                        log_unit_error_errno(unit, s.error, "%s: %m", s.error_message);
+
+                if (s.exit_status != EXIT_SUCCESS) {
+                        const char *status = ASSERT_PTR(
+                                        exit_status_to_string(s.exit_status, EXIT_STATUS_LIBC | EXIT_STATUS_SYSTEMD));
+
+                        log_unit_struct_errno(unit, LOG_ERR, s.error,
+                                              "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
+                                              LOG_UNIT_INVOCATION_ID(unit),
+                                              LOG_UNIT_MESSAGE(unit, "Failed at step %s spawning %s: %m",
+                                                               status, command->path),
+                                              "EXECUTABLE=%s", command->path);
+                }
+        }
+
+        *ret = pid;
+        return 1;
+}
+
 int exec_spawn(Unit *unit,
                ExecCommand *command,
                const ExecContext *context,
@@ -5219,6 +6260,7 @@ int exec_spawn(Unit *unit,
         _cleanup_strv_free_ char **files_env = NULL;
         size_t n_storage_fds = 0, n_socket_fds = 0;
         _cleanup_free_ char *line = NULL;
+        usec_t trace_start;
         pid_t pid;
 
         assert(unit);
@@ -5228,6 +6270,8 @@ int exec_spawn(Unit *unit,
         assert(params);
         assert(params->fds || (params->n_socket_fds + params->n_storage_fds <= 0));
 
+        trace_start = boot_trace_now(params->boot_trace);
+
         if (context->std_input == EXEC_INPUT_SOCKET ||
             context->std_output == EXEC_OUTPUT_SOCKET ||
             context->std_error == EXEC_OUTPUT_SOCKET) {
@@ -5285,46 +6329,60 @@ int exec_spawn(Unit *unit,
                 }
         }
 
-        pid = fork();
-        if (pid < 0)
-                return log_unit_error_errno(unit, errno, "Failed to fork: %m");
+        r = exec_spawn_light(unit, command, context, params, runtime, files_env, &pid);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                const SeccompProgram *syscall_filter_program = NULL;
 
-        if (pid == 0) {
-                int exit_status;
+#if HAVE_SECCOMP
+                syscall_filter_program = exec_syscall_filter_program(unit, command, context, params);
+#endif
 
-                r = exec_child(unit,
-                               command,
-                               context,
-                               params,
-                               runtime,
-                               dcreds,
-                               socket_fd,
-                               named_iofds,
-                               fds,
-                               n_socket_fds,
-                               n_storage_fds,
-                               files_env,
-                               unit->manager->user_lookup_fds[1],
-                               &exit_status);
+                pid = fork();
+                if (pid < 0)
+                        return log_unit_error_errno(unit, errno, "Failed to fork: %m");
+
+                if (pid == 0) {
+                        int exit_status;
+
+                        r = exec_child(unit,
+                                       command,
+                                       context,
+                                       params,
+                                       runtime,
+                                       dcreds,
+                                       socket_fd,
+                                       named_iofds,
+                                       fds,
+                                       n_socket_fds,
+                                       n_storage_fds,
+                                       files_env,
+                                       unit->manager->user_lookup_fds[1],
+                                       syscall_filter_program,
+                                       &exit_status);
 
-                if (r < 0) {
-                        const char *status = ASSERT_PTR(
-                                        exit_status_to_string(exit_status, EXIT_STATUS_LIBC | EXIT_STATUS_SYSTEMD));
+                        if (r < 0) {
+                                const char *status = ASSERT_PTR(
+                                                exit_status_to_string(exit_status, EXIT_STATUS_LIBC | EXIT_STATUS_SYSTEMD));
 
-                        log_unit_struct_errno(unit, LOG_ERR, r,
-                                              "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
-                                              LOG_UNIT_INVOCATION_ID(unit),
-                                              LOG_UNIT_MESSAGE(unit, "Failed at step %s spawning %s: %m",
-                                                               status, command->path),
-                                              "EXECUTABLE=%s", command->path);
-                } else
-                        assert(exit_status == EXIT_SUCCESS);
+                                log_unit_struct_errno(unit, LOG_ERR, r,
+                                                      "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
+                                                      LOG_UNIT_INVOCATION_ID(unit),
+                                                      LOG_UNIT_MESSAGE(unit, "Failed at step %s spawning %s: %m",
+                                                                       status, command->path),
+                                                      "EXECUTABLE=%s", command->path);
+                        } else
+                                assert(exit_status == EXIT_SUCCESS);
 
-                _exit(exit_status);
+                        _exit(exit_status);
+                }
         }
 
         log_unit_debug(unit, "Forked %s as "PID_FMT, command->path, pid);
 
+        boot_trace_record(params->boot_trace, unit->id, "spawn", 0, trace_start, boot_trace_now(params->boot_trace));
+
         /* We add the new process to the cgroup both in the child (so that we can be sure that no user code is ever
          * executed outside of the cgroup) and in the parent (so that we can be sure that when we kill the cgroup the
          * process will be killed too). */
@@ -1,12 +1,14 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 #pragma once
 
+typedef struct BootTrace BootTrace;
 typedef struct ExecStatus ExecStatus;
 typedef struct ExecCommand ExecCommand;
 typedef struct ExecContext ExecContext;
 typedef struct ExecRuntime ExecRuntime;
 typedef struct ExecParameters ExecParameters;
 typedef struct Manager Manager;
+typedef struct SeccompProgram SeccompProgram;
 
 #include <sched.h>
 #include <stdbool.h>
@@ -424,6 +426,12 @@ struct ExecParameters {
         int exec_fd;
 
         const char *notify_socket;
+
+        /* The manager's storage socket pair for mount namespace templates, NULL if they are not used */
+        const int *mount_ns_storage_socket;
+
+        /* Where to record the phases of setting up the process, NULL if BootTrace= is off */
+        BootTrace *boot_trace;
 };
 
 #include "unit.h"
@@ -462,6 +470,7 @@ bool exec_context_maintains_privileges(const ExecContext *c);
 
 int exec_context_get_effective_ioprio(const ExecContext *c);
 bool exec_context_get_effective_mount_apivfs(const ExecContext *c);
+bool exec_context_has_credentials(const ExecContext *c);
 
 void exec_context_free_log_extra_fields(ExecContext *c);
 
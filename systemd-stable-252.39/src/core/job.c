@@ -7,6 +7,8 @@
 
 #include "alloc-util.h"
 #include "async.h"
+#include "boot-profile.h"
+#include "boot-trace.h"
 #include "cgroup.h"
 #include "dbus-job.h"
 #include "dbus.h"
@@ -874,6 +876,12 @@ int job_run_and_invalidate(Job *j) {
 
         job_start_timer(j, true);
         job_set_state(j, JOB_RUNNING);
+
+        /* The time the job spent waiting for the jobs it is ordered after */
+        if (j->manager->boot_trace)
+                boot_trace_record(j->manager->boot_trace, j->unit->id,
+                                  strjoina(job_type_to_string(j->type), "-job-wait"),
+                                  0, j->begin_usec, j->begin_running_usec);
         job_add_to_dbus_queue(j);
 
         switch (j->type) {
@@ -962,6 +970,10 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool alr
 
         j->result = result;
 
+        if (j->manager->boot_trace)
+                boot_trace_record(j->manager->boot_trace, u->id, strjoina(job_type_to_string(t), "-job"),
+                                  0, j->begin_running_usec, now(CLOCK_MONOTONIC));
+
         log_unit_debug(u, "Job %" PRIu32 " %s/%s finished, result=%s",
                        j->id, u->id, job_type_to_string(t), job_result_to_string(result));
 
@@ -1125,6 +1137,23 @@ int job_start_timer(Job *j, bool job_running) {
         return 0;
 }
 
+static usec_t job_critical_path_weight(Job *j) {
+        assert(j);
+
+        /* While booting, prefer start jobs of units which long chains of other units wait for */
+
+        if (!j->manager->critical_path_scheduling)
+                return 0;
+
+        if (!IN_SET(j->type, JOB_START, JOB_VERIFY_ACTIVE, JOB_RESTART))
+                return 0;
+
+        if (!IN_SET(manager_state(j->manager), MANAGER_INITIALIZING, MANAGER_STARTING))
+                return 0;
+
+        return unit_critical_path_weight(j->unit);
+}
+
 void job_add_to_run_queue(Job *j) {
         int r;
 
@@ -1134,6 +1163,9 @@ void job_add_to_run_queue(Job *j) {
         if (j->in_run_queue)
                 return;
 
+        /* The priority must not change while the job is queued */
+        j->critical_path_weight = job_critical_path_weight(j);
+
         r = prioq_put(j->manager->run_queue, j, &j->run_queue_idx);
         if (r < 0)
                 log_warning_errno(r, "Failed put job in run queue, ignoring: %m");
@@ -1194,6 +1226,83 @@ int job_serialize(Job *j, FILE *f) {
         return 0;
 }
 
+int job_deserialize_item(Job *j, const char *l, const char *v) {
+        assert(j);
+        assert(l);
+        assert(v);
+
+        if (streq(l, "job-id")) {
+
+                if (safe_atou32(v, &j->id) < 0)
+                        log_debug("Failed to parse job id value: %s", v);
+
+        } else if (streq(l, "job-type")) {
+                JobType t;
+
+                t = job_type_from_string(v);
+                if (t < 0)
+                        log_debug("Failed to parse job type: %s", v);
+                else if (t >= _JOB_TYPE_MAX_IN_TRANSACTION)
+                        log_debug("Cannot deserialize job of type: %s", v);
+                else
+                        j->type = t;
+
+        } else if (streq(l, "job-state")) {
+                JobState s;
+
+                s = job_state_from_string(v);
+                if (s < 0)
+                        log_debug("Failed to parse job state: %s", v);
+                else
+                        job_set_state(j, s);
+
+        } else if (streq(l, "job-irreversible")) {
+                int b;
+
+                b = parse_boolean(v);
+                if (b < 0)
+                        log_debug("Failed to parse job irreversible flag: %s", v);
+                else
+                        j->irreversible = j->irreversible || b;
+
+        } else if (streq(l, "job-sent-dbus-new-signal")) {
+                int b;
+
+                b = parse_boolean(v);
+                if (b < 0)
+                        log_debug("Failed to parse job sent_dbus_new_signal flag: %s", v);
+                else
+                        j->sent_dbus_new_signal = j->sent_dbus_new_signal || b;
+
+        } else if (streq(l, "job-ignore-order")) {
+                int b;
+
+                b = parse_boolean(v);
+                if (b < 0)
+                        log_debug("Failed to parse job ignore_order flag: %s", v);
+                else
+                        j->ignore_order = j->ignore_order || b;
+
+        } else if (streq(l, "job-begin"))
+                (void) deserialize_usec(v, &j->begin_usec);
+
+        else if (streq(l, "job-begin-running"))
+                (void) deserialize_usec(v, &j->begin_running_usec);
+
+        else if (streq(l, "subscribed")) {
+                if (strv_extend(&j->deserialized_clients, v) < 0)
+                        return log_oom();
+
+        } else if (startswith(l, "activation-details")) {
+                if (activation_details_deserialize(l, v, &j->activation_details) < 0)
+                        log_debug("Failed to parse job ActivationDetails element: %s", v);
+
+        } else
+                log_debug("Unknown job serialization key: %s", l);
+
+        return 0;
+}
+
 int job_deserialize(Job *j, FILE *f) {
         int r;
 
@@ -1225,74 +1334,9 @@ int job_deserialize(Job *j, FILE *f) {
                 } else
                         v = l+k;
 
-                if (streq(l, "job-id")) {
-
-                        if (safe_atou32(v, &j->id) < 0)
-                                log_debug("Failed to parse job id value: %s", v);
-
-                } else if (streq(l, "job-type")) {
-                        JobType t;
-
-                        t = job_type_from_string(v);
-                        if (t < 0)
-                                log_debug("Failed to parse job type: %s", v);
-                        else if (t >= _JOB_TYPE_MAX_IN_TRANSACTION)
-                                log_debug("Cannot deserialize job of type: %s", v);
-                        else
-                                j->type = t;
-
-                } else if (streq(l, "job-state")) {
-                        JobState s;
-
-                        s = job_state_from_string(v);
-                        if (s < 0)
-                                log_debug("Failed to parse job state: %s", v);
-                        else
-                                job_set_state(j, s);
-
-                } else if (streq(l, "job-irreversible")) {
-                        int b;
-
-                        b = parse_boolean(v);
-                        if (b < 0)
-                                log_debug("Failed to parse job irreversible flag: %s", v);
-                        else
-                                j->irreversible = j->irreversible || b;
-
-                } else if (streq(l, "job-sent-dbus-new-signal")) {
-                        int b;
-
-                        b = parse_boolean(v);
-                        if (b < 0)
-                                log_debug("Failed to parse job sent_dbus_new_signal flag: %s", v);
-                        else
-                                j->sent_dbus_new_signal = j->sent_dbus_new_signal || b;
-
-                } else if (streq(l, "job-ignore-order")) {
-                        int b;
-
-                        b = parse_boolean(v);
-                        if (b < 0)
-                                log_debug("Failed to parse job ignore_order flag: %s", v);
-                        else
-                                j->ignore_order = j->ignore_order || b;
-
-                } else if (streq(l, "job-begin"))
-                        (void) deserialize_usec(v, &j->begin_usec);
-
-                else if (streq(l, "job-begin-running"))
-                        (void) deserialize_usec(v, &j->begin_running_usec);
-
-                else if (streq(l, "subscribed")) {
-                        if (strv_extend(&j->deserialized_clients, v) < 0)
-                                return log_oom();
-
-                } else if (startswith(l, "activation-details")) {
-                        if (activation_details_deserialize(l, v, &j->activation_details) < 0)
-                                log_debug("Failed to parse job ActivationDetails element: %s", v);
-
-                } else
-                        log_debug("Unknown job serialization key: %s", l);
+                r = job_deserialize_item(j, l, v);
+                if (r < 0)
+                        return r;
         }
 }
 
@@ -126,8 +126,10 @@ struct Job {
         LIST_HEAD(JobDependency, object_list);
 
         /* Used for graph algs as a "I have been here" marker */
-        Job* marker;
         unsigned generation;
+        /* Node of this job in the ordering graph built by transaction_verify_order(), valid while the
+         * generation matches */
+        unsigned order_node;
 
         uint32_t id;
 
@@ -152,6 +154,9 @@ struct Job {
 
         unsigned run_queue_idx;
 
+        /* The priority in the run queue when critical path scheduling is enabled, fixed while queued */
+        usec_t critical_path_weight;
+
         /* If the job had a specific trigger that needs to be advertised (eg: a path unit), store it. */
         ActivationDetails *activation_details;
 
@@ -176,6 +181,7 @@ void job_uninstall(Job *j);
 void job_dump(Job *j, FILE *f, const char *prefix);
 int job_serialize(Job *j, FILE *f);
 int job_deserialize(Job *j, FILE *f);
+int job_deserialize_item(Job *j, const char *key, const char *value);
 int job_coldplug(Job *j);
 
 JobDependency* job_dependency_new(Job *subject, Job *object, bool matters, bool conflicts);
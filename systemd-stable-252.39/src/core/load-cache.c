@@ -0,0 +1,753 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/stat.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "load-cache.h"
+#include "manager.h"
+#include "mkdir.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "serialize.h"
+#include "set.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tmpfile-util.h"
+#include "util.h"
+
+/* Layout of the cache, in the binary serialization format of serialize.c:
+ *
+ *   "cache":       version=, root=, and one expanded-search-path= item per directory
+ *   "dir:<path>":  dev=, ino=, mtime= (missing if the directory does not exist), followed by one unit=,
+ *                  symlink= or directory= item per entry. symlink= is followed by destination= or error=, if
+ *                  the symlink was resolved.
+ *   "file:<path>": dev=, ino=, size=, mtime=, ctime=, followed by one item per line, with the line number as
+ *                  key and the text as value.
+ */
+#define UNIT_CACHE_VERSION "1"
+
+typedef enum UnitCacheMode {
+        UNIT_CACHE_OFF,
+        UNIT_CACHE_ON,
+        UNIT_CACHE_VERIFY,
+} UnitCacheMode;
+
+typedef struct UnitCacheFile {
+        const char *path; /* points into the mapping */
+        BinaryRecord record;
+} UnitCacheFile;
+
+struct UnitCache {
+        BinaryDeserializer deserializer;
+        UnitCacheFile *files;
+        size_t n_files;
+        Hashmap *index;
+
+        unsigned n_hits;
+        unsigned n_misses;
+};
+
+static UnitCacheMode unit_cache_mode(void) {
+        static int cached = -1;
+
+        if (cached < 0) {
+                const char *e;
+                int r;
+
+                e = secure_getenv("SYSTEMD_UNIT_CACHE");
+                if (!e)
+                        cached = UNIT_CACHE_ON;
+                else if (streq(e, "verify"))
+                        cached = UNIT_CACHE_VERIFY;
+                else {
+                        r = parse_boolean(e);
+                        if (r < 0)
+                                log_debug_errno(r, "Failed to parse $SYSTEMD_UNIT_CACHE, ignoring: %m");
+                        cached = r != 0 ? UNIT_CACHE_ON : UNIT_CACHE_OFF;
+                }
+        }
+
+        return cached;
+}
+
+UnitCache* unit_cache_free(UnitCache *c) {
+        if (!c)
+                return NULL;
+
+        hashmap_free(c->index);
+        free(c->files);
+        binary_deserializer_done(&c->deserializer);
+
+        return mfree(c);
+}
+
+static int unit_cache_parse_header(BinaryRecord *record, UnitFileDirCache *dirs) {
+        const char *k, *v;
+        bool good = false;
+        int r;
+
+        assert(record);
+        assert(dirs);
+
+        while ((r = binary_record_next(record, &k, &v)) > 0) {
+                if (streq(k, "version"))
+                        good = streq(v, UNIT_CACHE_VERSION);
+                else if (streq(k, "root")) {
+                        if (!path_is_absolute(v))
+                                return -EBADMSG;
+
+                        r = free_and_strdup(&dirs->root_dir, v);
+                } else if (streq(k, "expanded-search-path")) {
+                        if (!path_is_absolute(v))
+                                return -EBADMSG;
+
+                        r = strv_extend(&dirs->expanded_search_path, v);
+                }
+                if (r < 0)
+                        return r;
+        }
+        if (r < 0)
+                return r;
+
+        /* Returns 0 if the cache was written by an incompatible version */
+        return good;
+}
+
+static int unit_cache_parse_dir(const char *path, BinaryRecord *record, UnitFileDirCache *dirs) {
+        _cleanup_(unit_file_dir_done) UnitFileDir d = {};
+        const char *k, *v;
+        int r;
+
+        assert(path);
+        assert(record);
+        assert(dirs);
+
+        if (!path_is_absolute(path))
+                return -EBADMSG;
+
+        d.path = strdup(path);
+        if (!d.path)
+                return -ENOMEM;
+
+        while ((r = binary_record_next(record, &k, &v)) > 0) {
+                UnitFileDirEntry *last = d.n_entries > 0 ? d.entries + d.n_entries - 1 : NULL;
+                UnitFileDirEntryType t;
+                uint64_t u;
+
+                if (streq(k, "dev")) {
+                        r = safe_atou64(v, &u);
+                        if (r < 0)
+                                return r;
+                        d.dev = u;
+                        d.exists = true;
+                } else if (streq(k, "ino")) {
+                        r = safe_atou64(v, &u);
+                        if (r < 0)
+                                return r;
+                        d.ino = u;
+                } else if (streq(k, "mtime"))
+                        r = safe_atou64(v, &d.mtime);
+                else if (streq(k, "destination")) {
+                        if (!last || last->type != UNIT_FILE_DIR_ENTRY_SYMLINK)
+                                return -EBADMSG;
+
+                        r = free_and_strdup(&last->destination, v);
+                } else if (streq(k, "error")) {
+                        int e;
+
+                        if (!last || last->type != UNIT_FILE_DIR_ENTRY_SYMLINK)
+                                return -EBADMSG;
+
+                        r = safe_atoi(v, &e);
+                        if (r < 0)
+                                return r;
+                        if (e <= 0)
+                                return -EBADMSG;
+                        last->resolve_error = -e;
+                } else {
+                        t = unit_file_dir_entry_type_from_string(k);
+                        if (t < 0 || !filename_is_valid(v))
+                                return -EBADMSG;
+
+                        r = unit_file_dir_add_entry(&d, t, v, NULL, 0);
+                }
+                if (r < 0)
+                        return r;
+        }
+        if (r < 0)
+                return r;
+
+        return unit_file_dir_cache_take(dirs, &d);
+}
+
+int unit_cache_load(const char *path, UnitCache **ret, UnitFileDirCache **ret_dirs) {
+        _cleanup_(unit_file_dir_cache_freep) UnitFileDirCache *dirs = NULL;
+        _cleanup_(unit_cache_freep) UnitCache *c = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        bool have_header = false;
+        int r;
+
+        assert(path);
+        assert(ret);
+        assert(ret_dirs);
+
+        /* Returns 0 if there is no usable cache at the path, 1 if it was loaded. */
+
+        f = fopen(path, "re");
+        if (!f)
+                return errno == ENOENT ? 0 : -errno;
+
+        c = new0(UnitCache, 1);
+        if (!c)
+                return -ENOMEM;
+
+        r = binary_deserializer_open(&c->deserializer, f);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EBADMSG;
+
+        c->files = new(UnitCacheFile, MAX(c->deserializer.n_records, 1u));
+        if (!c->files)
+                return -ENOMEM;
+
+        dirs = new0(UnitFileDirCache, 1);
+        if (!dirs)
+                return -ENOMEM;
+
+        for (;;) {
+                BinaryRecord record;
+                const char *name, *e;
+
+                r = binary_deserializer_next(&c->deserializer, &name, &record);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if (!have_header) {
+                        /* The header comes first, so that we don't bother with caches of other versions */
+                        if (!streq(name, "cache"))
+                                return -EBADMSG;
+
+                        r = unit_cache_parse_header(&record, dirs);
+                        if (r <= 0)
+                                return r;
+
+                        have_header = true;
+
+                } else if ((e = startswith(name, "dir:"))) {
+                        r = unit_cache_parse_dir(e, &record, dirs);
+                        if (r < 0)
+                                return r;
+
+                } else if ((e = startswith(name, "file:"))) {
+                        if (!path_is_absolute(e) || c->n_files >= c->deserializer.n_records)
+                                return -EBADMSG;
+
+                        c->files[c->n_files] = (UnitCacheFile) {
+                                .path = e,
+                                .record = record,
+                        };
+
+                        r = hashmap_ensure_put(&c->index, &path_hash_ops, e, c->files + c->n_files);
+                        if (r < 0)
+                                return r;
+
+                        c->n_files++;
+                } else
+                        return -EBADMSG;
+        }
+
+        if (!have_header)
+                return -EBADMSG;
+
+        *ret = TAKE_PTR(c);
+        *ret_dirs = TAKE_PTR(dirs);
+        return 1;
+}
+
+static void serialize_u64_item(BinarySerializer *s, const char *key, uint64_t u) {
+        char buf[DECIMAL_STR_MAX(uint64_t)];
+
+        xsprintf(buf, "%" PRIu64, u);
+        binary_serializer_add_item(s, key, buf);
+}
+
+static int unit_cache_write_dir(BinarySerializer *s, const UnitFileDir *d) {
+        int r;
+
+        assert(s);
+        assert(d);
+
+        r = binary_serializer_begin_record(s);
+        if (r < 0)
+                return r;
+
+        if (d->exists) {
+                serialize_u64_item(s, "dev", d->dev);
+                serialize_u64_item(s, "ino", d->ino);
+                serialize_u64_item(s, "mtime", d->mtime);
+        }
+
+        for (size_t i = 0; i < d->n_entries; i++) {
+                const UnitFileDirEntry *e = d->entries + i;
+
+                binary_serializer_add_item(s, unit_file_dir_entry_type_to_string(e->type), e->name);
+
+                if (e->type != UNIT_FILE_DIR_ENTRY_SYMLINK)
+                        continue;
+
+                if (e->destination)
+                        binary_serializer_add_item(s, "destination", e->destination);
+                else if (e->resolve_error < 0)
+                        serialize_u64_item(s, "error", -e->resolve_error);
+        }
+
+        return binary_serializer_end_record(s, strjoina("dir:", d->path));
+}
+
+static int unit_cache_write_file(BinarySerializer *s, const ConfigFile *c, nsec_t now_ns) {
+        int r;
+
+        assert(s);
+        assert(c);
+
+        /* Masks are not worth it, and the ctime of a file that was changed less than a second ago might not
+         * change again if it is modified once more. */
+        if (!S_ISREG(c->st.st_mode) || timespec_load_nsec(&c->st.st_ctim) + NSEC_PER_SEC > now_ns)
+                return 0;
+
+        r = binary_serializer_begin_record(s);
+        if (r < 0)
+                return r;
+
+        serialize_u64_item(s, "dev", c->st.st_dev);
+        serialize_u64_item(s, "ino", c->st.st_ino);
+        serialize_u64_item(s, "size", c->st.st_size);
+        serialize_u64_item(s, "mtime", timespec_load_nsec(&c->st.st_mtim));
+        serialize_u64_item(s, "ctime", timespec_load_nsec(&c->st.st_ctim));
+
+        for (size_t i = 0; i < c->n_lines; i++) {
+                char buf[DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(buf, "%u", c->lines[i].line);
+                binary_serializer_add_item(s, buf, c->lines[i].text);
+        }
+
+        r = binary_serializer_end_record(s, strjoina("file:", c->filename));
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+int unit_cache_write(const char *path, const UnitFileDirCache *dirs, Hashmap *files) {
+        _cleanup_(binary_serializer_done) BinarySerializer s = {};
+        _cleanup_(unlink_and_freep) char *temp = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        ConfigFile *c;
+        nsec_t now_ns;
+        int r;
+
+        assert(path);
+
+        r = mkdir_parents(path, 0755);
+        if (r < 0)
+                return r;
+
+        r = fopen_temporary(path, &f, &temp);
+        if (r < 0)
+                return r;
+
+        r = binary_serializer_begin(&s, f);
+        if (r < 0)
+                return r;
+
+        r = binary_serializer_begin_record(&s);
+        if (r < 0)
+                return r;
+
+        binary_serializer_add_item(&s, "version", UNIT_CACHE_VERSION);
+        if (dirs) {
+                if (dirs->root_dir)
+                        binary_serializer_add_item(&s, "root", dirs->root_dir);
+                STRV_FOREACH(d, dirs->expanded_search_path)
+                        binary_serializer_add_item(&s, "expanded-search-path", *d);
+        }
+
+        r = binary_serializer_end_record(&s, "cache");
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; dirs && i < dirs->n_dirs; i++) {
+                r = unit_cache_write_dir(&s, dirs->dirs + i);
+                if (r < 0)
+                        return r;
+        }
+
+        now_ns = now_nsec(CLOCK_REALTIME);
+        HASHMAP_FOREACH(c, files) {
+                r = unit_cache_write_file(&s, c, now_ns);
+                if (r < 0)
+                        return r;
+        }
+
+        r = binary_serializer_finish(&s);
+        if (r < 0)
+                return r;
+
+        if (rename(temp, path) < 0)
+                return -errno;
+
+        temp = mfree(temp);
+        return 0;
+}
+
+typedef struct UnitCacheStat {
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t size;
+        uint64_t mtime;
+        uint64_t ctime;
+} UnitCacheStat;
+
+static bool unit_cache_stat_matches(const UnitCacheStat *cached, const struct stat *st) {
+        assert(cached);
+        assert(st);
+
+        return S_ISREG(st->st_mode) &&
+                cached->dev == (uint64_t) st->st_dev &&
+                cached->ino == (uint64_t) st->st_ino &&
+                cached->size == (uint64_t) st->st_size &&
+                cached->mtime == timespec_load_nsec(&st->st_mtim) &&
+                cached->ctime == timespec_load_nsec(&st->st_ctim);
+}
+
+static int unit_cache_get_file(UnitCache *c, const char *path, ConfigFile **ret) {
+        _cleanup_(config_file_freep) ConfigFile *cf = NULL;
+        UnitCacheStat cached = {};
+        bool checked = false;
+        BinaryRecord record;
+        UnitCacheFile *e;
+        struct stat st;
+        int r;
+
+        assert(c);
+        assert(path);
+        assert(ret);
+
+        /* This only reads from the mapping, and hence may be called from any thread. Returns 0 if the file is
+         * not in the cache or was changed since. */
+
+        e = hashmap_get(c->index, path);
+        if (!e)
+                return 0;
+
+        /* Let the caller try to open the file and complain if this fails */
+        if (stat(path, &st) < 0)
+                return 0;
+
+        cf = new(ConfigFile, 1);
+        if (!cf)
+                return -ENOMEM;
+
+        *cf = (ConfigFile) {
+                .filename = strdup(path),
+                .st = st,
+        };
+        if (!cf->filename)
+                return -ENOMEM;
+
+        record = e->record;
+        for (;;) {
+                const char *k, *v;
+                unsigned line;
+
+                r = binary_record_next(&record, &k, &v);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if (streq(k, "dev"))
+                        r = safe_atou64(v, &cached.dev);
+                else if (streq(k, "ino"))
+                        r = safe_atou64(v, &cached.ino);
+                else if (streq(k, "size"))
+                        r = safe_atou64(v, &cached.size);
+                else if (streq(k, "mtime"))
+                        r = safe_atou64(v, &cached.mtime);
+                else if (streq(k, "ctime"))
+                        r = safe_atou64(v, &cached.ctime);
+                else {
+                        /* The stat data comes first, check it before copying any lines */
+                        if (!checked) {
+                                if (!unit_cache_stat_matches(&cached, &st))
+                                        return 0;
+
+                                checked = true;
+                        }
+
+                        r = safe_atou(k, &line);
+                        if (r < 0)
+                                return -EBADMSG;
+
+                        if (!GREEDY_REALLOC(cf->lines, cf->n_lines + 1))
+                                return -ENOMEM;
+
+                        cf->lines[cf->n_lines] = (ConfigFileLine) {
+                                .line = line,
+                                .text = strdup(v),
+                        };
+                        if (!cf->lines[cf->n_lines].text)
+                                return -ENOMEM;
+
+                        cf->n_lines++;
+                }
+                if (r < 0)
+                        return -EBADMSG;
+        }
+
+        if (!checked && !unit_cache_stat_matches(&cached, &st))
+                return 0;
+
+        *ret = TAKE_PTR(cf);
+        return 1;
+}
+
+int unit_cache_read_file(UnitCache *c, const char *path, ConfigFile **ret) {
+        int r;
+
+        assert(path);
+        assert(ret);
+
+        /* Returns the file from the cache if it is up-to-date, and reads it otherwise. Like config_file_read()
+         * this does not log and may be called from any thread. Returns 1 if the cache was used, 0 if the file
+         * was read. */
+
+        if (c) {
+                r = unit_cache_get_file(c, path, ret);
+                if (r > 0) {
+                        __atomic_fetch_add(&c->n_hits, 1, __ATOMIC_RELAXED);
+                        return 1;
+                }
+
+                /* On errors, including a corrupted entry, just read the file */
+                __atomic_fetch_add(&c->n_misses, 1, __ATOMIC_RELAXED);
+        }
+
+        r = config_file_read(path, ret);
+        if (r < 0)
+                return r;
+
+        return 0;
+}
+
+static bool config_files_equal(const ConfigFile *a, const ConfigFile *b) {
+        assert(a);
+        assert(b);
+
+        if (a->n_lines != b->n_lines)
+                return false;
+
+        for (size_t i = 0; i < a->n_lines; i++)
+                if (a->lines[i].line != b->lines[i].line ||
+                    !streq(a->lines[i].text, b->lines[i].text))
+                        return false;
+
+        return true;
+}
+
+int unit_cache_verify_file(ConfigFile **c) {
+        _cleanup_(config_file_freep) ConfigFile *fresh = NULL;
+        int r;
+
+        assert(c);
+        assert(*c);
+
+        /* Compares a file taken from the cache with the file itself. Replaces it with the latter and returns
+         * 1 if they differ. */
+
+        r = config_file_read((*c)->filename, &fresh);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to read %s to compare it with the unit file cache: %m", (*c)->filename);
+                *c = config_file_free(*c);
+                return r;
+        }
+
+        if (config_files_equal(*c, fresh))
+                return 0;
+
+        log_warning("Unit file cache entry for %s does not match the file, ignoring cache entry.", (*c)->filename);
+
+        config_file_free(*c);
+        *c = TAKE_PTR(fresh);
+        return 1;
+}
+
+void unit_cache_get_stats(const UnitCache *c, unsigned *ret_hits, unsigned *ret_misses) {
+        if (ret_hits)
+                *ret_hits = c ? c->n_hits : 0;
+        if (ret_misses)
+                *ret_misses = c ? c->n_misses : 0;
+}
+
+static const char* unit_name_maps_diff(
+                Hashmap *ids_a, Hashmap *names_a, Set *paths_a,
+                Hashmap *ids_b, Hashmap *names_b, Set *paths_b) {
+
+        const char *k, *v;
+        char **l;
+
+        /* Returns a key whose entry differs, if any */
+
+        HASHMAP_FOREACH_KEY(v, k, ids_a)
+                if (!streq_ptr(hashmap_get(ids_b, k), v))
+                        return k;
+        HASHMAP_FOREACH_KEY(v, k, ids_b)
+                if (!hashmap_contains(ids_a, k))
+                        return k;
+
+        HASHMAP_FOREACH_KEY(l, k, names_a) {
+                char **other = hashmap_get(names_b, k);
+
+                if (strv_length(l) != strv_length(other))
+                        return k;
+                STRV_FOREACH(i, l)
+                        if (!strv_contains(other, *i))
+                                return k;
+        }
+        HASHMAP_FOREACH_KEY(l, k, names_b)
+                if (!hashmap_contains(names_a, k))
+                        return k;
+
+        SET_FOREACH(k, paths_a)
+                if (!set_contains(paths_b, k))
+                        return k;
+        SET_FOREACH(k, paths_b)
+                if (!set_contains(paths_a, k))
+                        return k;
+
+        return NULL;
+}
+
+int manager_build_unit_name_map(Manager *m) {
+        _cleanup_hashmap_free_ Hashmap *ids = NULL, *names = NULL;
+        _cleanup_set_free_free_ Set *paths = NULL;
+        const char *diff;
+        int r;
+
+        assert(m);
+
+        if (unit_cache_mode() == UNIT_CACHE_OFF)
+                return unit_file_build_name_map(&m->lookup_paths,
+                                                &m->unit_cache_timestamp_hash,
+                                                &m->unit_id_map,
+                                                &m->unit_name_map,
+                                                &m->unit_path_cache);
+
+        r = unit_file_build_name_map_full(&m->lookup_paths,
+                                          &m->unit_cache_timestamp_hash,
+                                          &m->unit_id_map,
+                                          &m->unit_name_map,
+                                          &m->unit_path_cache,
+                                          &m->unit_file_dir_cache);
+        if (r <= 0)
+                return r;
+
+        log_debug("Built unit name map, %zu of %zu directories unchanged.",
+                  m->unit_file_dir_cache->n_reused, strv_length(m->lookup_paths.search_path));
+
+        if (unit_cache_mode() != UNIT_CACHE_VERIFY || m->unit_file_dir_cache->n_reused == 0)
+                return r;
+
+        r = unit_file_build_name_map(&m->lookup_paths, NULL, &ids, &names, &paths);
+        if (r < 0)
+                return r;
+
+        diff = unit_name_maps_diff(m->unit_id_map, m->unit_name_map, m->unit_path_cache, ids, names, paths);
+        if (!diff)
+                return 1;
+
+        log_warning("Unit name map built from cached directories does not match the file system (%s), ignoring cache.", diff);
+
+        hashmap_free_and_replace(m->unit_id_map, ids);
+        hashmap_free_and_replace(m->unit_name_map, names);
+        set_free_and_replace(m->unit_path_cache, paths);
+        m->unit_file_dir_cache = unit_file_dir_cache_free(m->unit_file_dir_cache);
+
+        return 1;
+}
+
+static bool manager_unit_cache_persistent(Manager *m) {
+        assert(m);
+
+        /* In the initrd the files in /run would be picked up by the host's manager, which doesn't need them */
+        return unit_cache_mode() != UNIT_CACHE_OFF &&
+                MANAGER_IS_SYSTEM(m) &&
+                !MANAGER_IS_TEST_RUN(m) &&
+                !in_initrd();
+}
+
+bool manager_unit_cache_verify(Manager *m) {
+        assert(m);
+
+        return m->unit_cache && unit_cache_mode() == UNIT_CACHE_VERIFY;
+}
+
+void manager_load_unit_cache(Manager *m) {
+        _cleanup_(unit_file_dir_cache_freep) UnitFileDirCache *dirs = NULL;
+        int r;
+
+        assert(m);
+
+        /* Called whenever we are about to load all units, i.e. when starting up and reloading */
+
+        if (!manager_unit_cache_persistent(m))
+                return;
+
+        m->unit_cache = unit_cache_free(m->unit_cache);
+        m->unit_cache_collect = true;
+
+        FOREACH_STRING(p, UNIT_CACHE_RUNTIME_PATH, UNIT_CACHE_PERSISTENT_PATH) {
+                r = unit_cache_load(p, &m->unit_cache, &dirs);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to load unit file cache %s, ignoring: %m", p);
+                if (r > 0) {
+                        log_debug("Loaded unit file cache %s.", p);
+                        break;
+                }
+        }
+
+        /* The snapshot we took ourselves, if any, is at least as recent */
+        if (!m->unit_file_dir_cache)
+                m->unit_file_dir_cache = TAKE_PTR(dirs);
+}
+
+void manager_save_unit_cache(Manager *m) {
+        unsigned hits, misses;
+        int r;
+
+        assert(m);
+
+        if (!m->unit_cache_collect)
+                return;
+
+        unit_cache_get_stats(m->unit_cache, &hits, &misses);
+        log_debug("Unit file cache: %u files taken from cache, %u files read.", hits, misses);
+
+        FOREACH_STRING(p, UNIT_CACHE_RUNTIME_PATH, UNIT_CACHE_PERSISTENT_PATH) {
+                r = unit_cache_write(p, m->unit_file_dir_cache, m->unit_cache_files);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to write unit file cache %s, ignoring: %m", p);
+        }
+
+        m->unit_cache = unit_cache_free(m->unit_cache);
+        m->unit_cache_files = hashmap_free(m->unit_cache_files);
+        m->unit_cache_collect = false;
+}
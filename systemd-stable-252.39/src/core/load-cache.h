@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "conf-parser.h"
+#include "hashmap.h"
+#include "unit-file.h"
+
+typedef struct Manager Manager;
+
+/* An on-disk cache of the unit search path and of the unit files and drop-ins read while booting, so that the
+ * next boot (or reexecution, or reload) does not have to read all directories and files again. Directories are
+ * validated against their inode and mtime, files against their inode, size, mtime and ctime. The cache is
+ * mapped into memory, and files are only copied out of it when a unit needs them. */
+
+#define UNIT_CACHE_RUNTIME_PATH "/run/systemd/unit-cache"
+#define UNIT_CACHE_PERSISTENT_PATH "/var/cache/systemd/unit-cache"
+
+typedef struct UnitCache UnitCache;
+
+UnitCache* unit_cache_free(UnitCache *c);
+DEFINE_TRIVIAL_CLEANUP_FUNC(UnitCache*, unit_cache_free);
+
+int unit_cache_load(const char *path, UnitCache **ret, UnitFileDirCache **ret_dirs);
+int unit_cache_write(const char *path, const UnitFileDirCache *dirs, Hashmap *files);
+
+int unit_cache_read_file(UnitCache *c, const char *path, ConfigFile **ret);
+int unit_cache_verify_file(ConfigFile **c);
+
+void unit_cache_get_stats(const UnitCache *c, unsigned *ret_hits, unsigned *ret_misses);
+
+int manager_build_unit_name_map(Manager *m);
+void manager_load_unit_cache(Manager *m);
+void manager_save_unit_cache(Manager *m);
+bool manager_unit_cache_verify(Manager *m);
@@ -4,6 +4,7 @@
 #include "fs-util.h"
 #include "load-dropin.h"
 #include "load-fragment.h"
+#include "load-preparse.h"
 #include "log.h"
 #include "stat-util.h"
 #include "string-util.h"
@@ -11,19 +12,33 @@
 #include "unit-name.h"
 #include "unit.h"
 
+static int find_dependency_dropin_paths(Unit *u, const char *dir_suffix, char ***ret) {
+        assert(u);
+        assert(dir_suffix);
+        assert(ret);
+
+        return unit_file_find_dropin_paths(NULL,
+                                           u->manager->lookup_paths.search_path,
+                                           u->manager->unit_path_cache,
+                                           dir_suffix, NULL,
+                                           u->id, u->aliases,
+                                           ret);
+}
+
 static int process_deps(Unit *u, UnitDependency dependency, const char *dir_suffix) {
         _cleanup_strv_free_ char **paths = NULL;
         int r;
 
-        r = unit_file_find_dropin_paths(NULL,
-                                        u->manager->lookup_paths.search_path,
-                                        u->manager->unit_path_cache,
-                                        dir_suffix, NULL,
-                                        u->id, u->aliases,
-                                        &paths);
+        r = find_dependency_dropin_paths(u, dir_suffix, &paths);
         if (r < 0)
                 return r;
 
+        /* Remember what we found, so that unit_dependency_dropins_changed() can tell if anything was added
+         * or removed since */
+        r = strv_extend_strv(&u->dependency_dropin_paths, paths, /* filter_duplicates= */ true);
+        if (r < 0)
+                return log_oom();
+
         STRV_FOREACH(p, paths) {
                 _cleanup_free_ char *target = NULL;
                 const char *entry;
@@ -82,6 +97,31 @@ static int process_deps(Unit *u, UnitDependency dependency, const char *dir_suff
         return 0;
 }
 
+int unit_dependency_dropins_changed(Unit *u) {
+        _cleanup_strv_free_ char **paths = NULL, **requires = NULL;
+        int r;
+
+        assert(u);
+
+        /* Returns > 0 if the set of .wants/ and .requires/ symlinks of the unit changed since it was
+         * loaded. unit_need_daemon_reload() does not cover these, as they don't change the unit's
+         * fragment or any of its drop-ins. */
+
+        r = find_dependency_dropin_paths(u, ".wants", &paths);
+        if (r < 0)
+                return r;
+
+        r = find_dependency_dropin_paths(u, ".requires", &requires);
+        if (r < 0)
+                return r;
+
+        r = strv_extend_strv(&paths, requires, /* filter_duplicates= */ true);
+        if (r < 0)
+                return r;
+
+        return !strv_equal(u->dependency_dropin_paths, paths);
+}
+
 int unit_load_dropin(Unit *u) {
         _cleanup_strv_free_ char **l = NULL;
         int r;
@@ -112,12 +152,20 @@ int unit_load_dropin(Unit *u) {
 
         u->dropin_mtime = 0;
         STRV_FOREACH(f, u->dropin_paths) {
+                const ConfigFile *preparsed;
                 struct stat st;
 
-                r = config_parse(u->id, *f, NULL,
-                                 UNIT_VTABLE(u)->sections,
-                                 config_item_perf_lookup, load_fragment_gperf_lookup,
-                                 0, u, &st);
+                preparsed = manager_get_preparsed_file(u->manager, *f);
+                if (preparsed)
+                        r = config_parse_file(u->id, preparsed,
+                                              UNIT_VTABLE(u)->sections,
+                                              config_item_perf_lookup, load_fragment_gperf_lookup,
+                                              0, u, &st);
+                else
+                        r = config_parse(u->id, *f, NULL,
+                                         UNIT_VTABLE(u)->sections,
+                                         config_item_perf_lookup, load_fragment_gperf_lookup,
+                                         0, u, &st);
                 if (r > 0)
                         u->dropin_mtime = MAX(u->dropin_mtime, timespec_load(&st.st_mtim));
         }
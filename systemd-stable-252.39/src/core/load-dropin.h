@@ -18,3 +18,4 @@ static inline int unit_find_dropin_paths(Unit *u, char ***paths) {
 }
 
 int unit_load_dropin(Unit *u);
+int unit_dependency_dropins_changed(Unit *u);
@@ -45,6 +45,7 @@
 #include "journal-file.h"
 #include "limits-util.h"
 #include "load-fragment.h"
+#include "load-preparse.h"
 #include "log.h"
 #include "missing_ioprio.h"
 #include "mountpoint-util.h"
@@ -144,6 +145,7 @@ DEFINE_CONFIG_PARSE_ENUM(config_parse_service_restart, service_restart, ServiceR
 DEFINE_CONFIG_PARSE_ENUM(config_parse_service_timeout_failure_mode, service_timeout_failure_mode, ServiceTimeoutFailureMode, "Failed to parse timeout failure mode");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_socket_bind, socket_address_bind_ipv6_only_or_bool, SocketAddressBindIPv6Only, "Failed to parse bind IPv6 only value");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_oom_policy, oom_policy, OOMPolicy, "Failed to parse OOM policy");
+DEFINE_CONFIG_PARSE_ENUM(config_parse_path_watch_backend, path_watch_backend, PathWatchBackend, "Failed to parse path watch backend");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_managed_oom_preference, managed_oom_preference, ManagedOOMPreference, "Failed to parse ManagedOOMPreference=");
 DEFINE_CONFIG_PARSE_ENUM_WITH_DEFAULT(config_parse_ip_tos, ip_tos, int, -1, "Failed to parse IP TOS value");
 DEFINE_CONFIG_PARSE_PTR(config_parse_blockio_weight, cg_blkio_weight_parse, uint64_t, "Invalid block IO weight");
@@ -6072,11 +6074,7 @@ int unit_load_fragment(Unit *u) {
         }
 
         /* Possibly rebuild the fragment map to catch new units */
-        r = unit_file_build_name_map(&u->manager->lookup_paths,
-                                     &u->manager->unit_cache_timestamp_hash,
-                                     &u->manager->unit_id_map,
-                                     &u->manager->unit_name_map,
-                                     &u->manager->unit_path_cache);
+        r = manager_build_unit_name_map(u->manager);
         if (r < 0)
                 return log_error_errno(r, "Failed to rebuild name map: %m");
 
@@ -6091,17 +6089,28 @@ int unit_load_fragment(Unit *u) {
         if (fragment) {
                 /* Open the file, check if this is a mask, otherwise read. */
                 _cleanup_fclose_ FILE *f = NULL;
+                const ConfigFile *preparsed;
                 struct stat st;
 
-                /* Try to open the file name. A symlink is OK, for example for linked files or masks. We
-                 * expect that all symlinks within the lookup paths have been already resolved, but we don't
-                 * verify this here. */
-                f = fopen(fragment, "re");
-                if (!f)
-                        return log_unit_notice_errno(u, errno, "Failed to open %s: %m", fragment);
-
-                if (fstat(fileno(f), &st) < 0)
-                        return -errno;
+                /* If the file was already read ahead, use that. With SELinux we need the label of the very
+                 * file we parse, hence open it anyway then, and only use what was read ahead if it is still
+                 * the same file. */
+                preparsed = manager_get_preparsed_file(u->manager, fragment);
+                if (!preparsed || mac_selinux_use()) {
+                        /* Try to open the file name. A symlink is OK, for example for linked files or
+                         * masks. We expect that all symlinks within the lookup paths have been already
+                         * resolved, but we don't verify this here. */
+                        f = fopen(fragment, "re");
+                        if (!f)
+                                return log_unit_notice_errno(u, errno, "Failed to open %s: %m", fragment);
+
+                        if (fstat(fileno(f), &st) < 0)
+                                return -errno;
+
+                        if (preparsed && !stat_inode_unmodified(&preparsed->st, &st))
+                                preparsed = NULL;
+                } else
+                        st = preparsed->st;
 
                 r = free_and_strdup(&u->fragment_path, fragment);
                 if (r < 0)
@@ -6134,12 +6143,20 @@ int unit_load_fragment(Unit *u) {
                         u->fragment_mtime = timespec_load(&st.st_mtim);
 
                         /* Now, parse the file contents */
-                        r = config_parse(u->id, fragment, f,
-                                         UNIT_VTABLE(u)->sections,
-                                         config_item_perf_lookup, load_fragment_gperf_lookup,
-                                         0,
-                                         u,
-                                         NULL);
+                        if (preparsed)
+                                r = config_parse_file(u->id, preparsed,
+                                                      UNIT_VTABLE(u)->sections,
+                                                      config_item_perf_lookup, load_fragment_gperf_lookup,
+                                                      0,
+                                                      u,
+                                                      NULL);
+                        else
+                                r = config_parse(u->id, fragment, f,
+                                                 UNIT_VTABLE(u)->sections,
+                                                 config_item_perf_lookup, load_fragment_gperf_lookup,
+                                                 0,
+                                                 u,
+                                                 NULL);
                         if (r == -ENOEXEC)
                                 log_unit_notice_errno(u, r, "Unit configuration has fatal error, unit will not be started.");
                         if (r < 0)
@@ -6179,6 +6196,47 @@ int unit_load_fragment(Unit *u) {
         return 0;
 }
 
+int unit_load_fragment_private_section(Unit *u, char **files) {
+        const char *private_section;
+        char *sections;
+        int r;
+
+        assert(u);
+        assert(u->load_state == UNIT_LOADED);
+
+        /* Parses the type-specific section of the fragment and the drop-ins the unit was loaded from once
+         * more, for units whose settings from it were dropped again. The unit files are passed in as pairs
+         * of path and contents, as they were when the unit was loaded, so that the result matches the rest
+         * of the unit even if they changed on disk in the meantime. Everything else that is derived from
+         * the unit files (names, dependencies, …) is left as it is. Warnings about unknown settings and
+         * sections were logged when the unit was loaded already, hence parse relaxed. */
+
+        private_section = UNIT_VTABLE(u)->private_section;
+        assert(private_section);
+
+        sections = newa0(char, strlen(private_section) + 2); /* nulstr, i.e. doubly NUL terminated */
+        strcpy(sections, private_section);
+
+        STRV_FOREACH_PAIR(path, contents, files) {
+                _cleanup_fclose_ FILE *f = NULL;
+
+                f = fmemopen_unlocked(*contents, strlen(*contents), "r");
+                if (!f)
+                        return -ENOMEM;
+
+                r = config_parse(u->id, *path, f,
+                                 sections,
+                                 config_item_perf_lookup, load_fragment_gperf_lookup,
+                                 CONFIG_PARSE_RELAXED,
+                                 u,
+                                 NULL);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 void unit_dump_config_items(FILE *f) {
         static const struct {
                 const ConfigParserCallback callback;
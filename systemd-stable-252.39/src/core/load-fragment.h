@@ -15,6 +15,7 @@ int parse_confirm_spawn(const char *value, char **console);
 /* Read service data from .desktop file style configuration fragments */
 
 int unit_load_fragment(Unit *u);
+int unit_load_fragment_private_section(Unit *u, char **files);
 
 void unit_dump_config_items(FILE *f);
 
@@ -133,6 +134,7 @@ CONFIG_PARSER_PROTOTYPE(config_parse_pid_file);
 CONFIG_PARSER_PROTOTYPE(config_parse_exit_status);
 CONFIG_PARSER_PROTOTYPE(config_parse_disable_controllers);
 CONFIG_PARSER_PROTOTYPE(config_parse_oom_policy);
+CONFIG_PARSER_PROTOTYPE(config_parse_path_watch_backend);
 CONFIG_PARSER_PROTOTYPE(config_parse_numa_policy);
 CONFIG_PARSER_PROTOTYPE(config_parse_numa_mask);
 CONFIG_PARSER_PROTOTYPE(config_parse_ip_filter_bpf_progs);
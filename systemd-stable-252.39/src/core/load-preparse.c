@@ -0,0 +1,345 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <pthread.h>
+#include <signal.h>
+
+#include "cpu-set-util.h"
+#include "env-util.h"
+#include "load-cache.h"
+#include "load-dropin.h"
+#include "load-preparse.h"
+#include "path-util.h"
+#include "set.h"
+#include "strv.h"
+#include "unit-file.h"
+
+/* Don't bother with threads for fewer units than this… */
+#define PREPARSE_UNITS_MIN 16U
+/* …and give each thread at least this many files to work on */
+#define PREPARSE_FILES_PER_THREAD 8U
+#define PREPARSE_THREADS_MAX 16U
+
+typedef struct PreparseUnit {
+        const char *id;
+        Set *names;
+        char **dropin_paths;
+} PreparseUnit;
+
+typedef struct PreparseContext {
+        Manager *manager;
+        PreparseUnit *units;
+        size_t n_units;
+        char **paths;
+        ConfigFile **files;
+        bool *from_cache;
+        size_t n_paths;
+
+        size_t n_items;
+        size_t next;
+        void (*func)(struct PreparseContext *c, size_t i);
+} PreparseContext;
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(preparsed_file_hash_ops,
+                                              char, path_hash_func, path_compare,
+                                              ConfigFile, config_file_free);
+
+static bool parallel_unit_load_enabled(void) {
+        static int cached = -1;
+
+        if (cached < 0) {
+                int r;
+
+                r = getenv_bool_secure("SYSTEMD_PARALLEL_UNIT_LOAD");
+                if (r < 0 && r != -ENXIO)
+                        log_debug_errno(r, "Failed to parse $SYSTEMD_PARALLEL_UNIT_LOAD, ignoring: %m");
+                cached = r != 0;
+        }
+
+        return cached;
+}
+
+static void* preparse_thread(void *userdata) {
+        PreparseContext *c = ASSERT_PTR(userdata);
+
+        for (;;) {
+                size_t i;
+
+                i = __atomic_fetch_add(&c->next, 1, __ATOMIC_RELAXED);
+                if (i >= c->n_items)
+                        break;
+
+                c->func(c, i);
+        }
+
+        return NULL;
+}
+
+static void preparse_run(PreparseContext *c, size_t n_items, void (*func)(PreparseContext *c, size_t i), unsigned *ret_n_threads) {
+        pthread_t threads[PREPARSE_THREADS_MAX];
+        unsigned n_threads = 0, n_wanted;
+        sigset_t ss, saved_ss;
+        int n_cpus;
+
+        assert(c);
+        assert(func);
+
+        c->n_items = n_items;
+        c->next = 0;
+        c->func = func;
+
+        n_cpus = cpus_in_affinity_mask();
+        n_wanted = MIN3(n_items / PREPARSE_FILES_PER_THREAD, (size_t) MAX(n_cpus, 1), (size_t) PREPARSE_THREADS_MAX);
+
+        /* The main thread works too, hence one thread less is needed. None of the workers should ever get a
+         * signal, they are all handled on the main thread. */
+        assert_se(sigfillset(&ss) >= 0);
+        assert_se(sigdelset(&ss, SIGBUS) >= 0);
+        if (n_wanted > 1 && pthread_sigmask(SIG_BLOCK, &ss, &saved_ss) == 0) {
+                for (; n_threads < n_wanted - 1; n_threads++) {
+                        int r;
+
+                        r = pthread_create(threads + n_threads, NULL, preparse_thread, c);
+                        if (r > 0) {
+                                log_debug_errno(r, "Failed to start unit file reader thread, proceeding with %u threads: %m",
+                                                n_threads + 1);
+                                break;
+                        }
+                }
+
+                assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+        }
+
+        (void) preparse_thread(c);
+
+        for (unsigned i = 0; i < n_threads; i++)
+                (void) pthread_join(threads[i], NULL);
+
+        if (ret_n_threads)
+                *ret_n_threads = n_threads + 1;
+}
+
+static void preparse_read_file(PreparseContext *c, size_t i) {
+        /* This runs on the worker threads, hence must not log. unit_load() will read the file itself and
+         * complain if this fails. */
+        c->from_cache[i] = unit_cache_read_file(c->manager->unit_cache, c->paths[i], c->files + i) > 0;
+}
+
+static int preparse_add_path(Manager *m, Set **paths, const char *path) {
+        assert(m);
+        assert(paths);
+
+        if (!path || hashmap_contains(m->preparsed_files, path))
+                return 0;
+
+        return set_put_strdup_full(paths, &path_hash_ops_free, path);
+}
+
+usec_t manager_preparse_load_queue(Manager *m) {
+        _cleanup_(set_freep) Set *paths = NULL;
+        PreparseContext c = {
+                .manager = m,
+        };
+        unsigned n_threads = 0;
+        usec_t start;
+        size_t n = 0;
+        int r;
+
+        assert(m);
+
+        /* Runs the I/O-heavy part of loading units on a number of threads: looks for the drop-ins of all
+         * units in the load queue that haven't been looked at yet, and then reads and splits all their unit
+         * files and drop-ins into lines on the worker threads. The results are kept in m->preparsed_files,
+         * which unit_load() picks up, until the load queue has been dispatched. Everything that touches the
+         * units themselves, and everything that might log, happens on the main thread. Returns the time this
+         * took. */
+
+        LIST_FOREACH(load_queue, u, m->load_queue)
+                if (!u->load_preparsed)
+                        n++;
+
+        if (n == 0)
+                return 0;
+
+        if (n < PREPARSE_UNITS_MIN || !parallel_unit_load_enabled()) {
+                LIST_FOREACH(load_queue, u, m->load_queue)
+                        u->load_preparsed = true;
+                return 0;
+        }
+
+        start = now(CLOCK_MONOTONIC);
+
+        /* Make sure new unit files are known, like unit_load_fragment() would */
+        r = manager_build_unit_name_map(m);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to rebuild name map, not reading unit files ahead: %m");
+                goto finish;
+        }
+
+        c.units = new0(PreparseUnit, n);
+        if (!c.units) {
+                log_oom_debug();
+                goto finish;
+        }
+
+        LIST_FOREACH(load_queue, u, m->load_queue) {
+                PreparseUnit *p;
+                const char *fragment = NULL;
+
+                if (u->load_preparsed)
+                        continue;
+
+                u->load_preparsed = true;
+
+                if (u->transient)
+                        continue;
+
+                p = c.units + c.n_units;
+
+                r = unit_file_find_fragment(m->unit_id_map, m->unit_name_map, u->id, &fragment, &p->names);
+                if (r < 0)
+                        continue;
+
+                p->id = u->id;
+                c.n_units++;
+
+                r = preparse_add_path(m, &paths, fragment);
+                if (r < 0) {
+                        log_oom_debug();
+                        goto finish;
+                }
+        }
+
+        /* The drop-in lookup logs, which isn't safe from other threads, hence do it here. Errors are
+         * ignored, unit_load() will look again anyway. */
+        for (size_t i = 0; i < c.n_units; i++)
+                (void) unit_file_find_dropin_paths(NULL,
+                                                   m->lookup_paths.search_path,
+                                                   m->unit_path_cache,
+                                                   ".d", ".conf",
+                                                   c.units[i].id, c.units[i].names,
+                                                   &c.units[i].dropin_paths);
+
+        for (size_t i = 0; i < c.n_units; i++)
+                STRV_FOREACH(d, c.units[i].dropin_paths) {
+                        r = preparse_add_path(m, &paths, *d);
+                        if (r < 0) {
+                                log_oom_debug();
+                                goto finish;
+                        }
+                }
+
+        if (set_isempty(paths))
+                goto finish;
+
+        c.paths = set_get_strv(paths);
+        if (!c.paths) {
+                log_oom_debug();
+                goto finish;
+        }
+        c.n_paths = set_size(paths);
+
+        c.files = new0(ConfigFile*, c.n_paths);
+        c.from_cache = new0(bool, c.n_paths);
+        if (!c.files || !c.from_cache) {
+                log_oom_debug();
+                goto finish;
+        }
+
+        preparse_run(&c, c.n_paths, preparse_read_file, &n_threads);
+
+        for (size_t i = 0; i < c.n_paths; i++) {
+                if (c.from_cache[i] && manager_unit_cache_verify(m))
+                        (void) unit_cache_verify_file(c.files + i);
+
+                if (!c.files[i])
+                        continue;
+
+                r = hashmap_ensure_put(&m->preparsed_files, &preparsed_file_hash_ops, c.files[i]->filename, c.files[i]);
+                if (r < 0) {
+                        log_oom_debug();
+                        break;
+                }
+
+                TAKE_PTR(c.files[i]);
+        }
+
+        log_debug("Read %zu unit files and drop-ins of %zu units on %u threads in %s.",
+                  c.n_paths, c.n_units, n_threads,
+                  FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - start, USEC_PER_MSEC));
+
+        if (!MANAGER_IS_FINISHED(m)) {
+                m->units_load_parsed_files += c.n_paths;
+                m->units_load_parse_threads = MAX(m->units_load_parse_threads, n_threads);
+        }
+
+finish:
+        for (size_t i = 0; i < c.n_units; i++) {
+                set_free_free(c.units[i].names);
+                strv_free(c.units[i].dropin_paths);
+        }
+        free(c.units);
+
+        for (size_t i = 0; i < c.n_paths; i++)
+                config_file_free(c.files ? c.files[i] : NULL);
+        free(c.files);
+        free(c.from_cache);
+
+        /* The strings are owned by the set */
+        free(c.paths);
+
+        return now(CLOCK_MONOTONIC) - start;
+}
+
+const ConfigFile* manager_get_preparsed_file(Manager *m, const char *path) {
+        ConfigFile *c;
+        int r;
+
+        assert(m);
+        assert(path);
+
+        c = hashmap_get(m->preparsed_files, path);
+        if (c || !m->unit_cache_collect)
+                return c;
+
+        /* While the unit file cache is being built, read the files that were not read ahead here, so that
+         * they end up in the cache too */
+        r = unit_cache_read_file(m->unit_cache, path, &c);
+        if (r < 0)
+                return NULL;
+        if (r > 0 && manager_unit_cache_verify(m) && unit_cache_verify_file(&c) < 0)
+                return NULL;
+
+        r = hashmap_ensure_put(&m->preparsed_files, &preparsed_file_hash_ops, c->filename, c);
+        if (r < 0) {
+                config_file_free(c);
+                return NULL;
+        }
+
+        return c;
+}
+
+void manager_flush_preparsed_files(Manager *m) {
+        ConfigFile *c;
+        int r;
+
+        assert(m);
+
+        if (!m->unit_cache_collect) {
+                m->preparsed_files = hashmap_free(m->preparsed_files);
+                return;
+        }
+
+        /* Keep the files for the unit file cache. The files are not looked at again, as they might change
+         * until the next time the load queue is dispatched. */
+        while ((c = hashmap_steal_first(m->preparsed_files))) {
+                config_file_free(hashmap_remove(m->unit_cache_files, c->filename));
+
+                r = hashmap_ensure_put(&m->unit_cache_files, &preparsed_file_hash_ops, c->filename, c);
+                if (r < 0) {
+                        log_oom_debug();
+                        config_file_free(c);
+                }
+        }
+
+        m->preparsed_files = hashmap_free(m->preparsed_files);
+}
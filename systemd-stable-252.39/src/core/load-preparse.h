@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "conf-parser.h"
+#include "manager.h"
+
+/* Reads the unit files and drop-ins of the units in the load queue on worker threads, so that
+ * unit_load() only has to apply them. Only the reading happens on the worker threads, which hence
+ * must not log. */
+
+usec_t manager_preparse_load_queue(Manager *m);
+const ConfigFile* manager_get_preparsed_file(Manager *m, const char *path);
+void manager_flush_preparsed_files(Manager *m);
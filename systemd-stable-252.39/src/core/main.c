@@ -91,6 +91,7 @@
 #include "terminal-util.h"
 #include "time-util.h"
 #include "umask-util.h"
+#include "unit-compact.h"
 #include "user-util.h"
 #include "util.h"
 #include "virt.h"
@@ -152,6 +153,11 @@ static uint64_t arg_capability_bounding_set;
 static bool arg_no_new_privs;
 static nsec_t arg_timer_slack_nsec;
 static usec_t arg_default_timer_accuracy_usec;
+static usec_t arg_dbus_signal_coalesce_usec;
+static bool arg_critical_path_scheduling;
+static bool arg_boot_trace;
+static bool arg_compact_inactive_units;
+static PathWatchBackend arg_path_watch_backend;
 static Set* arg_syscall_archs;
 static FILE* arg_serialization;
 static int arg_default_cpu_accounting;
@@ -662,6 +668,11 @@ static int parse_config_file(void) {
                 { "Manager", "DefaultTasksAccounting",       config_parse_bool,                  0,                        &arg_default_tasks_accounting     },
                 { "Manager", "DefaultTasksMax",              config_parse_tasks_max,             0,                        &arg_default_tasks_max            },
                 { "Manager", "CtrlAltDelBurstAction",        config_parse_emergency_action,      0,                        &arg_cad_burst_action             },
+                { "Manager", "DBusSignalCoalesceSec",        config_parse_sec,                   0,                        &arg_dbus_signal_coalesce_usec    },
+                { "Manager", "CriticalPathScheduling",       config_parse_bool,                  0,                        &arg_critical_path_scheduling     },
+                { "Manager", "BootTrace",                    config_parse_bool,                  0,                        &arg_boot_trace                   },
+                { "Manager", "CompactInactiveUnits",         config_parse_bool,                  0,                        &arg_compact_inactive_units       },
+                { "Manager", "PathWatchBackend",             config_parse_path_watch_backend,    0,                        &arg_path_watch_backend           },
                 { "Manager", "DefaultOOMPolicy",             config_parse_oom_policy,            0,                        &arg_default_oom_policy           },
                 { "Manager", "DefaultOOMScoreAdjust",        config_parse_oom_score_adjust,      0,                        NULL                              },
 #if ENABLE_SMACK
@@ -764,6 +775,11 @@ static void set_manager_settings(Manager *m) {
         m->confirm_spawn = arg_confirm_spawn;
         m->service_watchdogs = arg_service_watchdogs;
         m->cad_burst_action = arg_cad_burst_action;
+        m->dbus_signal_coalesce_usec = arg_dbus_signal_coalesce_usec;
+        m->critical_path_scheduling = arg_critical_path_scheduling;
+        manager_set_boot_trace(m, arg_boot_trace);
+        manager_set_compact_inactive_units(m, arg_compact_inactive_units);
+        m->path_watch_backend = arg_path_watch_backend;
 
         manager_set_watchdog(m, WATCHDOG_RUNTIME, arg_runtime_watchdog);
         manager_set_watchdog(m, WATCHDOG_REBOOT, arg_reboot_watchdog);
@@ -1150,7 +1166,9 @@ static int prepare_reexecute(
         if (!fds)
                 return log_oom();
 
-        r = manager_serialize(m, f, fds, switching_root);
+        /* The binary format is only used for reloading, as the binary we are about to execute might not
+         * understand it */
+        r = manager_serialize(m, f, fds, switching_root, /* binary= */ false);
         if (r < 0)
                 return r;
 
@@ -2450,6 +2468,11 @@ static void reset_arguments(void) {
         arg_default_tasks_max = DEFAULT_TASKS_MAX;
         arg_machine_id = (sd_id128_t) {};
         arg_cad_burst_action = EMERGENCY_ACTION_REBOOT_FORCE;
+        arg_dbus_signal_coalesce_usec = 0;
+        arg_critical_path_scheduling = false;
+        arg_boot_trace = false;
+        arg_compact_inactive_units = false;
+        arg_path_watch_backend = PATH_WATCH_INOTIFY;
         arg_default_oom_policy = OOM_STOP;
 
         cpu_set_reset(&arg_cpu_affinity);
@@ -3,6 +3,7 @@
 #include "build.h"
 #include "fd-util.h"
 #include "fileio.h"
+#include "format-util.h"
 #include "hashmap.h"
 #include "manager-dump.h"
 #include "unit-serialize.h"
@@ -40,6 +41,42 @@ void manager_dump_units(Manager *s, FILE *f, char **patterns, const char *prefix
         }
 }
 
+static void manager_dump_dependency_memory(Manager *m, FILE *f, const char *prefix) {
+        size_t n_units = 0, n_edges = 0, n_indexed = 0, size = 0;
+        Unit *u;
+        const char *t;
+
+        HASHMAP_FOREACH_KEY(u, t, m->units) {
+                if (u->id != t)
+                        continue;
+
+                n_units++;
+                n_edges += u->dependencies.n_edges;
+                n_indexed += !!u->dependencies.index;
+                size += unit_get_dependency_memory(u);
+        }
+
+        fprintf(f, "%sDependency Edges: %zu on %zu units, %zu indexed (%s)\n",
+                strempty(prefix), n_edges, n_units, n_indexed, FORMAT_BYTES(size));
+}
+
+static void manager_dump_compacted_units(Manager *m, FILE *f, const char *prefix) {
+        size_t n_units = 0, size = 0;
+        Unit *u;
+        const char *t;
+
+        HASHMAP_FOREACH_KEY(u, t, m->units) {
+                if (u->id != t || !u->compacted)
+                        continue;
+
+                n_units++;
+                size += u->compacted_size;
+        }
+
+        fprintf(f, "%sCompacted Units: %zu (%s freed)\n",
+                strempty(prefix), n_units, FORMAT_BYTES(size));
+}
+
 static void manager_dump_header(Manager *m, FILE *f, const char *prefix) {
 
         /* NB: this is a debug interface for developers. It's not supposed to be machine readable or be
@@ -62,6 +99,12 @@ static void manager_dump_header(Manager *m, FILE *f, const char *prefix) {
 
         for (const char *n = sd_bus_track_first(m->subscribed); n; n = sd_bus_track_next(m->subscribed))
                 fprintf(f, "%sSubscribed: %s\n", strempty(prefix), n);
+
+        manager_dump_dependency_memory(m, f, prefix);
+        manager_dump_compacted_units(m, f, prefix);
+
+        fprintf(f, "%sCGroup Attribute Writes: %" PRIu64 " (%" PRIu64 " skipped as unchanged)\n",
+                strempty(prefix), m->n_cgroup_attribute_writes, m->n_cgroup_attribute_writes_skipped);
 }
 
 void manager_dump(Manager *m, FILE *f, char **patterns, const char *prefix) {
@@ -73,6 +73,55 @@ static void manager_serialize_uid_refs_internal(
         }
 }
 
+static int manager_serialize_units_binary(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
+        _cleanup_(binary_serializer_done) BinarySerializer s = {};
+        const char *t;
+        Unit *u;
+        int r;
+
+        assert(m);
+        assert(f);
+        assert(fds);
+
+        /* Every unit is serialized in the text format first, and then transcoded into a binary record, so that
+         * the unit types' serializers don't need to know about the binary format. */
+
+        r = binary_serializer_begin(&s, f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to start binary serialization: %m");
+
+        HASHMAP_FOREACH_KEY(u, t, m->units) {
+                _cleanup_free_ char *buf = NULL;
+                _cleanup_fclose_ FILE *mf = NULL;
+                size_t sz = 0;
+
+                if (u->id != t)
+                        continue;
+
+                mf = open_memstream_unlocked(&buf, &sz);
+                if (!mf)
+                        return log_oom();
+
+                r = unit_serialize(u, mf, fds, switching_root);
+                if (r < 0)
+                        return r;
+
+                r = fflush_and_check(mf);
+                if (r < 0)
+                        return log_unit_error_errno(u, r, "Failed to flush unit serialization: %m");
+
+                r = binary_serializer_add_text(&s, buf, sz);
+                if (r < 0)
+                        return log_unit_error_errno(u, r, "Failed to serialize unit: %m");
+        }
+
+        r = binary_serializer_finish(&s);
+        if (r < 0)
+                return log_error_errno(r, "Failed to finish binary serialization: %m");
+
+        return 0;
+}
+
 static void manager_serialize_uid_refs(Manager *m, FILE *f) {
         manager_serialize_uid_refs_internal(f, m->uid_refs, "destroy-ipc-uid");
 }
@@ -85,7 +134,8 @@ int manager_serialize(
                 Manager *m,
                 FILE *f,
                 FDSet *fds,
-                bool switching_root) {
+                bool switching_root,
+                bool binary) {
 
         const char *t;
         Unit *u;
@@ -191,14 +241,19 @@ int manager_serialize(
 
         (void) fputc('\n', f);
 
-        HASHMAP_FOREACH_KEY(u, t, m->units) {
-                if (u->id != t)
-                        continue;
-
-                r = unit_serialize(u, f, fds, switching_root);
+        if (binary) {
+                r = manager_serialize_units_binary(m, f, fds, switching_root);
                 if (r < 0)
                         return r;
-        }
+        } else
+                HASHMAP_FOREACH_KEY(u, t, m->units) {
+                        if (u->id != t)
+                                continue;
+
+                        r = unit_serialize(u, f, fds, switching_root);
+                        if (r < 0)
+                                return r;
+                }
 
         r = fflush_and_check(f);
         if (r < 0)
@@ -232,10 +287,55 @@ static int manager_deserialize_one_unit(Manager *m, const char *name, FILE *f, F
         return 0;
 }
 
+static int manager_deserialize_units_binary(Manager *m, BinaryDeserializer *d, FDSet *fds) {
+        int r;
+
+        assert(m);
+        assert(d);
+
+        log_debug("Deserializing %" PRIu32 " units from binary serialization.", d->n_records);
+
+        for (;;) {
+                BinaryRecord record;
+                const char *name;
+                Unit *u;
+
+                r = binary_deserializer_next(d, &name, &record);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to read serialization index: %m");
+                if (r == 0)
+                        break;
+
+                /* Units that fail to load are simply skipped, the index tells us where the next one starts */
+                r = manager_load_unit(m, name, NULL, NULL, &u);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0) {
+                        log_notice_errno(r, "Failed to load unit \"%s\", skipping deserialization: %m", name);
+                        continue;
+                }
+
+                r = unit_deserialize_record(u, &record, fds);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0)
+                        log_notice_errno(r, "Failed to deserialize unit \"%s\", skipping: %m", name);
+        }
+
+        return 0;
+}
+
 static int manager_deserialize_units(Manager *m, FILE *f, FDSet *fds) {
+        _cleanup_(binary_deserializer_done) BinaryDeserializer d = {};
         const char *unit_name;
         int r;
 
+        r = binary_deserializer_open(&d, f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to open binary serialization: %m");
+        if (r > 0)
+                return manager_deserialize_units_binary(m, &d, fds);
+
         for (;;) {
                 _cleanup_free_ char *line = NULL;
                 /* Start marker */
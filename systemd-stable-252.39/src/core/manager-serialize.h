@@ -9,5 +9,5 @@
 #define DESTROY_IPC_FLAG (UINT32_C(1) << 31)
 
 int manager_open_serialization(Manager *m, FILE **ret_f);
-int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root);
+int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root, bool binary);
 int manager_deserialize(Manager *m, FILE *f, FDSet *fds);
@@ -52,7 +52,9 @@
 #include "install.h"
 #include "io-util.h"
 #include "label.h"
+#include "load-dropin.h"
 #include "load-fragment.h"
+#include "load-preparse.h"
 #include "locale-setup.h"
 #include "log.h"
 #include "macro.h"
@@ -60,6 +62,8 @@
 #include "manager-dump.h"
 #include "manager-serialize.h"
 #include "memory-util.h"
+#include "missing_syscall.h"
+#include "missing_wait.h"
 #include "mkdir-label.h"
 #include "os-util.h"
 #include "parse-util.h"
@@ -86,12 +90,16 @@
 #include "transaction.h"
 #include "uid-range.h"
 #include "umask-util.h"
+#include "unit-file.h"
 #include "unit-name.h"
+#include "unit-serialize.h"
 #include "user-util.h"
 #include "virt.h"
 #include "watchdog.h"
 
 #define NOTIFY_RCVBUF_SIZE (8*1024*1024)
+/* How many notification messages to pick up with a single recvmmsg() call */
+#define NOTIFY_BATCH_MAX 16
 #define CGROUPS_AGENT_RCVBUF_SIZE (8*1024*1024)
 
 /* Initial delay and the interval for printing status messages about running jobs */
@@ -814,11 +822,13 @@ int manager_new(LookupScope scope, ManagerTestRunFlags test_run_flags, Manager *
                 .cgroups_agent_fd = -1,
                 .signal_fd = -1,
                 .user_lookup_fds = { -1, -1 },
+                .mount_ns_storage_socket = { -1, -1 },
                 .private_listen_fd = -1,
                 .dev_autofs_fd = -1,
                 .cgroup_inotify_fd = -1,
                 .pin_cgroupfs_fd = -1,
                 .ask_password_inotify_fd = -1,
+                .path_fanotify_fd = -1,
                 .idle_pipe = { -1, -1, -1, -1},
 
                  /* start as id #1, so that we can leave #0 around as "null-like" value */
@@ -1534,6 +1544,7 @@ Manager* manager_free(Manager *m) {
         hashmap_free(m->units_by_invocation_id);
         hashmap_free(m->jobs);
         hashmap_free(m->watch_pids);
+        hashmap_free(m->watch_pidfds);
         hashmap_free(m->watch_bus);
 
         prioq_free(m->run_queue);
@@ -1549,15 +1560,21 @@ Manager* manager_free(Manager *m) {
         sd_event_source_unref(m->timezone_change_event_source);
         sd_event_source_unref(m->jobs_in_progress_event_source);
         sd_event_source_unref(m->run_queue_event_source);
+        sd_event_source_unref(m->dbus_queue_event_source);
         sd_event_source_unref(m->user_lookup_event_source);
+        sd_event_source_unref(m->compact_units_event_source);
 
         safe_close(m->signal_fd);
         safe_close(m->notify_fd);
+        free(m->notify_buffer);
         safe_close(m->cgroups_agent_fd);
         safe_close_pair(m->user_lookup_fds);
+        safe_close_pair(m->mount_ns_storage_socket);
 
         manager_close_ask_password(m);
 
+        manager_free_path_fanotify(m);
+
         manager_close_idle_pipe(m);
 
         sd_event_unref(m->event);
@@ -1570,6 +1587,11 @@ Manager* manager_free(Manager *m) {
 
         hashmap_free(m->cgroup_unit);
         manager_free_unit_name_maps(m);
+        unit_file_dir_cache_free(m->unit_file_dir_cache);
+        unit_cache_free(m->unit_cache);
+        hashmap_free(m->unit_cache_files);
+        boot_profile_free(m->boot_profile);
+        boot_trace_free(m->boot_trace);
 
         free(m->switch_root);
         free(m->switch_root_init);
@@ -1584,6 +1606,9 @@ Manager* manager_free(Manager *m) {
         hashmap_free(m->uid_refs);
         hashmap_free(m->gid_refs);
 
+        hashmap_free(m->seccomp_programs);
+        set_free(m->bpf_program_cache);
+
         for (ExecDirectoryType dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++)
                 m->prefix[dt] = mfree(m->prefix[dt]);
         free(m->received_credentials_directory);
@@ -1849,6 +1874,9 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds, const char *roo
 
         lookup_paths_log(&m->lookup_paths);
 
+        manager_load_unit_cache(m);
+        manager_load_boot_profile(m);
+
         {
                 /* This block is (optionally) done with the reloading counter bumped */
                 _unused_ _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
@@ -2113,6 +2141,7 @@ static int manager_dispatch_target_deps_queue(Manager *m) {
 }
 
 unsigned manager_dispatch_load_queue(Manager *m) {
+        usec_t start, parse_usec = 0;
         Unit *u;
         unsigned n = 0;
 
@@ -2127,13 +2156,27 @@ unsigned manager_dispatch_load_queue(Manager *m) {
         /* Dispatches the load queue. Takes a unit from the queue and
          * tries to load its data until the queue is empty */
 
+        start = now(CLOCK_MONOTONIC);
+
         while ((u = m->load_queue)) {
                 assert(u->in_load_queue);
 
+                /* Whenever we get to a unit that was queued since, read the files of everything queued
+                 * so far in one go */
+                if (!u->load_preparsed)
+                        parse_usec += manager_preparse_load_queue(m);
+
                 unit_load(u);
                 n++;
         }
 
+        manager_flush_preparsed_files(m);
+
+        if (n > 0 && !MANAGER_IS_FINISHED(m)) {
+                m->units_load_parse_usec += parse_usec;
+                m->units_load_apply_usec += usec_sub_unsigned(now(CLOCK_MONOTONIC) - start, parse_usec);
+        }
+
         m->dispatching_load_queue = false;
 
         /* Dispatch the units waiting for their target dependencies to be added now, as all targets that we know about
@@ -2306,6 +2349,8 @@ void manager_unwatch_pid(Manager *m, pid_t pid) {
 
         /* Then, let's also drop the array keyed by -pid. */
         free(hashmap_remove(m->watch_pids, PID_TO_PTR(-pid)));
+
+        manager_unwatch_pidfd(m, pid);
 }
 
 static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
@@ -2342,7 +2387,56 @@ void manager_trigger_run_queue(Manager *m) {
                 log_warning_errno(r, "Failed to enable job run queue event source, ignoring: %m");
 }
 
+static int manager_dispatch_dbus_queue_timer(sd_event_source *source, usec_t usec, void *userdata) {
+        /* Nothing to do here, the event loop iteration this causes will dispatch the queue */
+        return 0;
+}
+
+static bool manager_dbus_queue_coalescing(Manager *m) {
+        usec_t n, until;
+        int r;
+
+        assert(m);
+
+        /* Returns true if the D-Bus queues shall not be dispatched yet, in order to give further changes to
+         * the queued units and jobs a chance to be merged into the same signal. */
+
+        if (m->dbus_signal_coalesce_usec <= 0)
+                return false;
+
+        n = now(CLOCK_MONOTONIC);
+        if (m->dbus_queue_since <= 0)
+                m->dbus_queue_since = n;
+
+        until = usec_add(m->dbus_queue_since, m->dbus_signal_coalesce_usec);
+        if (n >= until)
+                return false;
+
+        if (m->dbus_queue_event_source) {
+                r = sd_event_source_set_time(m->dbus_queue_event_source, until);
+                if (r >= 0)
+                        r = sd_event_source_set_enabled(m->dbus_queue_event_source, SD_EVENT_ONESHOT);
+        } else {
+                r = sd_event_add_time(
+                                m->event,
+                                &m->dbus_queue_event_source,
+                                CLOCK_MONOTONIC,
+                                until, 0,
+                                manager_dispatch_dbus_queue_timer, m);
+                if (r >= 0)
+                        (void) sd_event_source_set_description(m->dbus_queue_event_source, "manager-dbus-queue");
+        }
+        if (r < 0) {
+                log_warning_errno(r, "Failed to arm D-Bus queue timer, not coalescing change signals: %m");
+                return false;
+        }
+
+        return true;
+}
+
 static unsigned manager_dispatch_dbus_queue(Manager *m) {
+        _cleanup_free_ Unit **changed = NULL;
+        size_t n_changed = 0;
         unsigned n = 0, budget;
         Unit *u;
         Job *j;
@@ -2363,6 +2457,10 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
                 if (manager_bus_n_queued_write(m) > MANAGER_BUS_BUSY_THRESHOLD)
                         return 0;
 
+                /* Shall we wait a bit for more changes to accumulate? */
+                if (manager_dbus_queue_coalescing(m))
+                        return 0;
+
                 /* Only process a certain number of units/jobs per event loop iteration. Even if the bus queue wasn't
                  * overly full before this call we shouldn't increase it in size too wildly in one step, and we
                  * shouldn't monopolize CPU time with generating these messages. Note the difference in counting of
@@ -2378,16 +2476,44 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
         }
 
         while (budget != 0 && (u = m->dbus_unit_queue)) {
+                bool summarize_alone = false;
 
                 assert(u->in_dbus_queue);
 
+                /* When coalescing, additionally collect the units we announce, so that we can send a
+                 * single UnitsChanged() signal summarizing them below. */
+                if (m->dbus_signal_coalesce_usec > 0 && u->id) {
+                        if (!GREEDY_REALLOC(changed, n_changed + 1)) {
+                                /* Clients may watch UnitsChanged() only, hence don't leave any unit out if
+                                 * we can't grow the array: send what we have so far and start over, or
+                                 * summarize this unit on its own. */
+                                log_oom_debug();
+
+                                if (n_changed > 0) {
+                                        bus_manager_send_units_changed(m, changed, n_changed);
+                                        n_changed = 0;
+                                }
+                        }
+
+                        if (changed)
+                                changed[n_changed++] = u;
+                        else
+                                summarize_alone = true;
+                }
+
                 bus_unit_send_change_signal(u);
                 n++;
 
+                if (summarize_alone)
+                        bus_manager_send_units_changed(m, &u, 1);
+
                 if (budget != UINT_MAX)
                         budget--;
         }
 
+        if (n_changed > 0)
+                bus_manager_send_units_changed(m, changed, n_changed);
+
         while (budget != 0 && (j = m->dbus_job_queue)) {
                 assert(j->in_dbus_queue);
 
@@ -2398,6 +2524,9 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
                         budget--;
         }
 
+        if (!m->dbus_unit_queue && !m->dbus_job_queue)
+                m->dbus_queue_since = 0;
+
         if (m->send_reloading_done) {
                 m->send_reloading_done = false;
                 bus_manager_send_reloading(m, false);
@@ -2463,7 +2592,8 @@ static void manager_invoke_notify_message(
                 Unit *u,
                 const struct ucred *ucred,
                 char * const *tags,
-                FDSet *fds) {
+                FDSet *fds,
+                unsigned n_coalesced) {
 
         assert(m);
         assert(u);
@@ -2474,6 +2604,10 @@ static void manager_invoke_notify_message(
                 return;
         u->notifygen = m->notifygen;
 
+        /* Count the messages that were superseded by this one too, they were meant for this unit after all */
+        u->n_notify_messages += 1 + n_coalesced;
+        u->n_notify_messages_coalesced += n_coalesced;
+
         if (UNIT_VTABLE(u)->notify_message)
                 UNIT_VTABLE(u)->notify_message(u, ucred, tags, fds);
 
@@ -2490,57 +2624,39 @@ static void manager_invoke_notify_message(
         }
 }
 
-static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
-
-        _cleanup_fdset_free_ FDSet *fds = NULL;
-        Manager *m = ASSERT_PTR(userdata);
-        char buf[NOTIFY_BUFFER_MAX+1];
-        struct iovec iovec = {
-                .iov_base = buf,
-                .iov_len = sizeof(buf)-1,
-        };
+/* The buffers to receive a batch of notification messages in with a single recvmmsg() call. This is
+ * allocated once and kept around, since it's a bit large for the stack. */
+struct NotifyBuffer {
+        struct mmsghdr headers[NOTIFY_BATCH_MAX];
+        struct iovec iovecs[NOTIFY_BATCH_MAX];
+        char data[NOTIFY_BATCH_MAX][NOTIFY_BUFFER_MAX+1];
         CMSG_BUFFER_TYPE(CMSG_SPACE(sizeof(struct ucred)) +
-                         CMSG_SPACE(sizeof(int) * NOTIFY_FD_MAX)) control;
-        struct msghdr msghdr = {
-                .msg_iov = &iovec,
-                .msg_iovlen = 1,
-                .msg_control = &control,
-                .msg_controllen = sizeof(control),
-        };
+                         CMSG_SPACE(sizeof(int) * NOTIFY_FD_MAX)) control[NOTIFY_BATCH_MAX];
+};
 
-        struct cmsghdr *cmsg;
-        struct ucred *ucred = NULL;
-        _cleanup_free_ Unit **array_copy = NULL;
+static void notify_message_done(NotifyMessage *msg) {
+        assert(msg);
+
+        msg->tags = strv_free(msg->tags);
+        msg->fds = fdset_free(msg->fds);
+}
+
+static int notify_message_parse(struct msghdr *msghdr, size_t n, NotifyMessage *ret) {
+        _cleanup_fdset_free_ FDSet *fds = NULL;
         _cleanup_strv_free_ char **tags = NULL;
-        Unit *u1, *u2, **array;
+        struct ucred *ucred = NULL;
+        struct cmsghdr *cmsg;
         int r, *fd_array = NULL;
         size_t n_fds = 0;
-        bool found = false;
-        ssize_t n;
+        char *buf;
 
-        assert(m->notify_fd == fd);
-
-        if (revents != EPOLLIN) {
-                log_warning("Got unexpected poll event for notify fd.");
-                return 0;
-        }
+        assert(msghdr);
+        assert(ret);
 
-        n = recvmsg_safe(m->notify_fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC);
-        if (n < 0) {
-                if (ERRNO_IS_TRANSIENT(n))
-                        return 0; /* Spurious wakeup, try again */
-                if (n == -EXFULL) {
-                        log_warning("Got message with truncated control data (too many fds sent?), ignoring.");
-                        return 0;
-                }
-                /* If this is any other, real error, then let's stop processing this socket. This of course
-                 * means we won't take notification messages anymore, but that's still better than busy
-                 * looping around this: being woken up over and over again but being unable to actually read
-                 * the message off the socket. */
-                return log_error_errno(n, "Failed to receive notification message: %m");
-        }
+        /* Returns 0 if the message shall be ignored, 1 if it shall be dispatched, in which case ret is
+         * initialized. */
 
-        CMSG_FOREACH(cmsg, &msghdr) {
+        CMSG_FOREACH(cmsg, msghdr) {
                 if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
 
                         assert(!fd_array);
@@ -2567,24 +2683,31 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
                 }
         }
 
+        if (msghdr->msg_flags & MSG_CTRUNC) {
+                log_warning("Got message with truncated control data (too many fds sent?), ignoring.");
+                return 0;
+        }
+
         if (!ucred || !pid_is_valid(ucred->pid)) {
                 log_warning("Received notify message without valid credentials. Ignoring.");
                 return 0;
         }
 
-        if ((size_t) n >= sizeof(buf) || (msghdr.msg_flags & MSG_TRUNC)) {
+        if (n > msghdr->msg_iov->iov_len || (msghdr->msg_flags & MSG_TRUNC)) {
                 log_warning("Received notify message exceeded maximum size. Ignoring.");
                 return 0;
         }
 
         /* As extra safety check, let's make sure the string we get doesn't contain embedded NUL bytes.
          * We permit one trailing NUL byte in the message, but don't expect it. */
+        buf = msghdr->msg_iov->iov_base;
         if (n > 1 && memchr(buf, 0, n-1)) {
                 log_warning("Received notify message with embedded NUL bytes. Ignoring.");
                 return 0;
         }
 
-        /* Make sure it's NUL-terminated, then parse it to obtain the tags list. */
+        /* Make sure it's NUL-terminated, then parse it to obtain the tags list. Note that the iovec leaves
+         * room for the terminating NUL byte. */
         buf[n] = 0;
         tags = strv_split_newlines(buf);
         if (!tags) {
@@ -2592,17 +2715,62 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
                 return 0;
         }
 
-        /* Possibly a barrier fd, let's see. */
-        if (manager_process_barrier_fd(tags, fds))
-                return 0;
+        *ret = (NotifyMessage) {
+                .ucred = *ucred,
+                .fds = TAKE_PTR(fds),
+                /* Possibly a barrier fd. That's processed in order with the other messages of the batch,
+                 * since the sender expects all its earlier messages to be processed once the fd is closed. */
+                .barrier = strv_contains(tags, "BARRIER=1"),
+        };
+
+        STRV_FOREACH(t, tags)
+                if (startswith(*t, "STATUS="))
+                        ret->status = true;
+                else if (streq(*t, "WATCHDOG=1"))
+                        ret->watchdog = true;
+                else
+                        ret->other = true;
+
+        ret->tags = TAKE_PTR(tags);
+        return 1;
+}
+
+bool notify_message_supersedes(const NotifyMessage *msg, const NotifyMessage *earlier) {
+        assert(msg);
+        assert(earlier);
+
+        /* A message that only updates the status text and/or pings the watchdog is redundant if the same
+         * process sends a later message that does the same: the later status text replaces the earlier one
+         * anyway, and the later watchdog ping is at least as recent. Anything else, or fds, is never
+         * dropped. Barriers drop everything else they carry, hence never supersede anything either. */
+
+        if (earlier->other || fdset_size(earlier->fds) > 0 || msg->barrier)
+                return false;
+
+        if (msg->ucred.pid != earlier->ucred.pid ||
+            msg->ucred.uid != earlier->ucred.uid ||
+            msg->ucred.gid != earlier->ucred.gid)
+                return false;
+
+        return (!earlier->status || msg->status) &&
+                (!earlier->watchdog || msg->watchdog);
+}
+
+static void manager_dispatch_notify_message(Manager *m, const NotifyMessage *msg) {
+        _cleanup_free_ Unit **array_copy = NULL;
+        Unit *u1, *u2, **array;
+        bool found = false;
+
+        assert(m);
+        assert(msg);
 
         /* Increase the generation counter used for filtering out duplicate unit invocations. */
         m->notifygen++;
 
         /* Notify every unit that might be interested, which might be multiple. */
-        u1 = manager_get_unit_by_pid_cgroup(m, ucred->pid);
-        u2 = hashmap_get(m->watch_pids, PID_TO_PTR(ucred->pid));
-        array = hashmap_get(m->watch_pids, PID_TO_PTR(-ucred->pid));
+        u1 = manager_get_unit_by_pid_cgroup(m, msg->ucred.pid);
+        u2 = hashmap_get(m->watch_pids, PID_TO_PTR(msg->ucred.pid));
+        array = hashmap_get(m->watch_pids, PID_TO_PTR(-msg->ucred.pid));
         if (array) {
                 size_t k = 0;
 
@@ -2616,24 +2784,98 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         /* And now invoke the per-unit callbacks. Note that manager_invoke_notify_message() will handle
          * duplicate units make sure we only invoke each unit's handler once. */
         if (u1) {
-                manager_invoke_notify_message(m, u1, ucred, tags, fds);
+                manager_invoke_notify_message(m, u1, &msg->ucred, msg->tags, msg->fds, msg->n_coalesced);
                 found = true;
         }
         if (u2) {
-                manager_invoke_notify_message(m, u2, ucred, tags, fds);
+                manager_invoke_notify_message(m, u2, &msg->ucred, msg->tags, msg->fds, msg->n_coalesced);
                 found = true;
         }
         if (array_copy)
                 for (size_t i = 0; array_copy[i]; i++) {
-                        manager_invoke_notify_message(m, array_copy[i], ucred, tags, fds);
+                        manager_invoke_notify_message(m, array_copy[i], &msg->ucred, msg->tags, msg->fds, msg->n_coalesced);
                         found = true;
                 }
 
         if (!found)
-                log_warning("Cannot find unit for notify message of PID "PID_FMT", ignoring.", ucred->pid);
+                log_warning("Cannot find unit for notify message of PID "PID_FMT", ignoring.", msg->ucred.pid);
 
-        if (fdset_size(fds) > 0)
+        if (fdset_size(msg->fds) > 0)
                 log_warning("Got extra auxiliary fds with notification message, closing them.");
+}
+
+static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+        NotifyMessage msgs[NOTIFY_BATCH_MAX] = {};
+        NotifyBuffer *b;
+        int n;
+
+        assert(m->notify_fd == fd);
+
+        if (revents != EPOLLIN) {
+                log_warning("Got unexpected poll event for notify fd.");
+                return 0;
+        }
+
+        if (!m->notify_buffer) {
+                m->notify_buffer = new(NotifyBuffer, 1);
+                if (!m->notify_buffer) {
+                        log_oom();
+                        return 0;
+                }
+        }
+
+        b = m->notify_buffer;
+        for (size_t i = 0; i < NOTIFY_BATCH_MAX; i++) {
+                b->iovecs[i] = IOVEC_MAKE(b->data[i], sizeof(b->data[i]) - 1);
+                b->headers[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_iov = &b->iovecs[i],
+                                .msg_iovlen = 1,
+                                .msg_control = &b->control[i],
+                                .msg_controllen = sizeof(b->control[i]),
+                        },
+                };
+        }
+
+        /* Services that update their status or ping the watchdog frequently can keep us busy, hence pick
+         * up as many messages as we can in one go, so that we can skip redundant ones. */
+        n = recvmmsg(m->notify_fd, b->headers, NOTIFY_BATCH_MAX, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC, NULL);
+        if (n < 0) {
+                if (ERRNO_IS_TRANSIENT(errno))
+                        return 0; /* Spurious wakeup, try again */
+                /* If this is any other, real error, then let's stop processing this socket. This of course
+                 * means we won't take notification messages anymore, but that's still better than busy
+                 * looping around this: being woken up over and over again but being unable to actually read
+                 * the message off the socket. */
+                return log_error_errno(errno, "Failed to receive notification message: %m");
+        }
+
+        for (int i = 0; i < n; i++)
+                (void) notify_message_parse(&b->headers[i].msg_hdr, b->headers[i].msg_len, msgs + i);
+
+        /* Drop messages that a later message of the same process in this batch supersedes */
+        for (int i = 0; i < n; i++) {
+                if (!msgs[i].tags)
+                        continue;
+
+                for (int j = i + 1; j < n; j++)
+                        if (msgs[j].tags && notify_message_supersedes(msgs + j, msgs + i)) {
+                                msgs[j].n_coalesced += msgs[i].n_coalesced + 1;
+                                notify_message_done(msgs + i);
+                                break;
+                        }
+        }
+
+        for (int i = 0; i < n; i++) {
+                /* Closes the fd of barriers only now, i.e. after all earlier messages were processed */
+                if (msgs[i].barrier)
+                        (void) manager_process_barrier_fd(msgs[i].tags, msgs[i].fds);
+                else if (msgs[i].tags)
+                        manager_dispatch_notify_message(m, msgs + i);
+
+                notify_message_done(msgs + i);
+        }
 
         return 0;
 }
@@ -2659,49 +2901,32 @@ static void manager_invoke_sigchld_event(
                 UNIT_VTABLE(u)->sigchld_event(u, si->si_pid, si->si_code, si->si_status);
 }
 
-static int manager_dispatch_sigchld(sd_event_source *source, void *userdata) {
-        Manager *m = ASSERT_PTR(userdata);
-        siginfo_t si = {};
-        int r;
-
-        assert(source);
-
-        /* First we call waitid() for a PID and do not reap the zombie. That way we can still access
-         * /proc/$PID for it while it is a zombie. */
-
-        if (waitid(P_ALL, 0, &si, WEXITED|WNOHANG|WNOWAIT) < 0) {
-
-                if (errno != ECHILD)
-                        log_error_errno(errno, "Failed to peek for child with waitid(), ignoring: %m");
-
-                goto turn_off;
-        }
-
-        if (si.si_pid <= 0)
-                goto turn_off;
+static void manager_dispatch_child(Manager *m, siginfo_t *si) {
+        assert(m);
+        assert(si);
 
-        if (IN_SET(si.si_code, CLD_EXITED, CLD_KILLED, CLD_DUMPED)) {
+        if (IN_SET(si->si_code, CLD_EXITED, CLD_KILLED, CLD_DUMPED)) {
                 _cleanup_free_ Unit **array_copy = NULL;
                 _cleanup_free_ char *name = NULL;
                 Unit *u1, *u2, **array;
 
-                (void) get_process_comm(si.si_pid, &name);
+                (void) get_process_comm(si->si_pid, &name);
 
                 log_debug("Child "PID_FMT" (%s) died (code=%s, status=%i/%s)",
-                          si.si_pid, strna(name),
-                          sigchld_code_to_string(si.si_code),
-                          si.si_status,
-                          strna(si.si_code == CLD_EXITED
-                                ? exit_status_to_string(si.si_status, EXIT_STATUS_FULL)
-                                : signal_to_string(si.si_status)));
+                          si->si_pid, strna(name),
+                          sigchld_code_to_string(si->si_code),
+                          si->si_status,
+                          strna(si->si_code == CLD_EXITED
+                                ? exit_status_to_string(si->si_status, EXIT_STATUS_FULL)
+                                : signal_to_string(si->si_status)));
 
                 /* Increase the generation counter used for filtering out duplicate unit invocations */
                 m->sigchldgen++;
 
                 /* And now figure out the unit this belongs to, it might be multiple... */
-                u1 = manager_get_unit_by_pid_cgroup(m, si.si_pid);
-                u2 = hashmap_get(m->watch_pids, PID_TO_PTR(si.si_pid));
-                array = hashmap_get(m->watch_pids, PID_TO_PTR(-si.si_pid));
+                u1 = manager_get_unit_by_pid_cgroup(m, si->si_pid);
+                u2 = hashmap_get(m->watch_pids, PID_TO_PTR(si->si_pid));
+                array = hashmap_get(m->watch_pids, PID_TO_PTR(-si->si_pid));
                 if (array) {
                         size_t n = 0;
 
@@ -2726,21 +2951,48 @@ static int manager_dispatch_sigchld(sd_event_source *source, void *userdata) {
                         /* We check if systemd-oomd performed a kill so that we log and notify appropriately */
                         (void) unit_check_oomd_kill(u1);
 
-                        manager_invoke_sigchld_event(m, u1, &si);
+                        manager_invoke_sigchld_event(m, u1, si);
                 }
                 if (u2)
-                        manager_invoke_sigchld_event(m, u2, &si);
+                        manager_invoke_sigchld_event(m, u2, si);
                 if (array_copy)
                         for (size_t i = 0; array_copy[i]; i++)
-                                manager_invoke_sigchld_event(m, array_copy[i], &si);
+                                manager_invoke_sigchld_event(m, array_copy[i], si);
         }
 
+        /* The units normally stopped watching the PID above already, but make sure we don't keep the pidfd
+         * of a process that is about to go away around in any case. */
+        manager_unwatch_pidfd(m, si->si_pid);
+
         /* And now, we actually reap the zombie. */
-        if (waitid(P_PID, si.si_pid, &si, WEXITED) < 0) {
+        if (waitid(P_PID, si->si_pid, si, WEXITED) < 0)
                 log_error_errno(errno, "Failed to dequeue child, ignoring: %m");
-                return 0;
+}
+
+static int manager_dispatch_sigchld(sd_event_source *source, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+        siginfo_t si = {};
+        int r;
+
+        assert(source);
+
+        /* First we call waitid() for a PID and do not reap the zombie. That way we can still access
+         * /proc/$PID for it while it is a zombie. Note that most of our own processes are already handled by
+         * manager_dispatch_pidfd() before we get here, what's left are processes we don't track via a pidfd,
+         * e.g. orphans that got reparented to us. */
+
+        if (waitid(P_ALL, 0, &si, WEXITED|WNOHANG|WNOWAIT) < 0) {
+
+                if (errno != ECHILD)
+                        log_error_errno(errno, "Failed to peek for child with waitid(), ignoring: %m");
+
+                goto turn_off;
         }
 
+        if (si.si_pid <= 0)
+                goto turn_off;
+
+        manager_dispatch_child(m, &si);
         return 0;
 
 turn_off:
@@ -2753,6 +3005,134 @@ turn_off:
         return 0;
 }
 
+static int manager_dispatch_pidfd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+        siginfo_t si = {};
+
+        assert(source);
+
+        /* A pidfd becomes readable when the process exits. Unlike with waitid(P_ALL) we know exactly which
+         * process to look at, and since we hold a reference to it the PID cannot be recycled under us. */
+
+        if (waitid(P_PIDFD, fd, &si, WEXITED|WNOHANG|WNOWAIT) < 0) {
+                if (errno == EINVAL) {
+                        /* P_PIDFD is not supported by the kernel (< 5.4), stop using pidfds altogether and
+                         * leave everything to the SIGCHLD handler. */
+                        log_debug_errno(errno, "waitid(P_PIDFD) is not supported, not tracking processes via pidfds.");
+                        m->pidfd_unsupported = true;
+                } else if (errno != ECHILD)
+                        log_error_errno(errno, "Failed to peek for child with waitid(), ignoring: %m");
+
+                /* For processes that are not our children (ECHILD), there's nothing we can reap, leave it
+                 * to the cgroup logic to notice. The event source is released once the unit stops watching
+                 * the PID. */
+                return sd_event_source_set_enabled(source, SD_EVENT_OFF);
+        }
+
+        if (si.si_pid <= 0) /* Not dead yet? Shouldn't happen, but let's not busy loop on the pidfd */
+                return sd_event_source_set_enabled(source, SD_EVENT_OFF);
+
+        /* Note that this might release the event source and close the pidfd, hence don't touch them
+         * afterwards. */
+        manager_dispatch_child(m, &si);
+        return 0;
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(pidfd_hash_ops, void, trivial_hash_func, trivial_compare_func,
+                                              sd_event_source, sd_event_source_disable_unref);
+
+int manager_watch_pidfd(Manager *m, pid_t pid) {
+        _cleanup_(sd_event_source_disable_unrefp) sd_event_source *s = NULL;
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(m);
+        assert(pid_is_valid(pid));
+
+        /* Tracks the PID with an event source on its pidfd, so that we can pick up and reap exactly this
+         * process when it exits rather than scanning all our children. This is purely an optimization: if
+         * it fails, SIGCHLD handling will still pick up the process. */
+
+        if (m->pidfd_unsupported || !m->event)
+                return 0;
+
+        if (hashmap_contains(m->watch_pidfds, PID_TO_PTR(pid)))
+                return 0;
+
+        fd = pidfd_open(pid, 0);
+        if (fd < 0) {
+                if (ERRNO_IS_NOT_SUPPORTED(errno) || ERRNO_IS_PRIVILEGE(errno)) {
+                        log_debug_errno(errno, "pidfd_open() is not available, not tracking processes via pidfds.");
+                        m->pidfd_unsupported = true;
+                        return 0;
+                }
+
+                return -errno;
+        }
+
+        r = sd_event_add_io(m->event, &s, fd, EPOLLIN, manager_dispatch_pidfd, m);
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_set_io_fd_own(s, true);
+        if (r < 0)
+                return r;
+        TAKE_FD(fd);
+
+        /* Process exits after notification messages, but at the same time as SIGCHLD so that we handle the
+         * processes in the order they died. */
+        r = sd_event_source_set_priority(s, SD_EVENT_PRIORITY_NORMAL-7);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(s, "manager-pidfd");
+
+        r = hashmap_ensure_put(&m->watch_pidfds, &pidfd_hash_ops, PID_TO_PTR(pid), s);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(s);
+        return 1;
+}
+
+void manager_unwatch_pidfd(Manager *m, pid_t pid) {
+        assert(m);
+
+        sd_event_source_disable_unref(hashmap_remove(m->watch_pidfds, PID_TO_PTR(pid)));
+}
+
+const int *manager_get_mount_namespace_templates(Manager *m) {
+        assert(m);
+
+        /* Returns the storage socket pair that children keep mount namespace templates in, see
+         * mount_namespace_template_join(). Templates are only used by the system manager, since only it
+         * builds mount namespaces for lots of services. Returns NULL if they are not to be used. */
+
+        if (!MANAGER_IS_SYSTEM(m) || MANAGER_IS_TEST_RUN(m))
+                return NULL;
+
+        if (m->mount_ns_storage_socket[0] < 0 &&
+            socketpair(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0, m->mount_ns_storage_socket) < 0) {
+                log_debug_errno(errno, "Failed to allocate mount namespace template storage, not using templates: %m");
+                return NULL;
+        }
+
+        return m->mount_ns_storage_socket;
+}
+
+void manager_flush_mount_namespace_templates(Manager *m) {
+        assert(m);
+
+        /* Closing the storage socket releases all templates in it at once, without having to take the lock
+         * children might hold. A new one is allocated the next time a child needs one. */
+
+        if (m->mount_ns_storage_socket[0] < 0)
+                return;
+
+        log_debug("Flushing mount namespace templates.");
+        safe_close_pair(m->mount_ns_storage_socket);
+}
+
 static void manager_start_special(Manager *m, const char *name, JobMode mode) {
         Job *job;
 
@@ -3372,14 +3752,32 @@ int manager_override_watchdog_pretimeout_governor(Manager *m, const char *govern
         return free_and_replace(m->watchdog_pretimeout_governor_overridden, p);
 }
 
+static bool manager_binary_serialization_enabled(void) {
+        static int cached = -1;
+
+        if (cached < 0) {
+                int r;
+
+                r = getenv_bool_secure("SYSTEMD_BINARY_SERIALIZATION");
+                if (r < 0 && r != -ENXIO)
+                        log_debug_errno(r, "Failed to parse $SYSTEMD_BINARY_SERIALIZATION, ignoring: %m");
+                cached = r != 0;
+        }
+
+        return cached;
+}
+
 int manager_reload(Manager *m) {
         _unused_ _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
         _cleanup_fdset_free_ FDSet *fds = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        usec_t start, serialize_usec, deserialize_usec;
         int r;
 
         assert(m);
 
+        start = now(CLOCK_MONOTONIC);
+
         r = manager_open_serialization(m, &f);
         if (r < 0)
                 return log_error_errno(r, "Failed to create serialization file: %m");
@@ -3391,13 +3789,16 @@ int manager_reload(Manager *m) {
         /* We are officially in reload mode from here on. */
         reloading = manager_reloading_start(m);
 
-        r = manager_serialize(m, f, fds, false);
+        /* We deserialize with the very same binary, hence we can use the binary format here */
+        r = manager_serialize(m, f, fds, false, manager_binary_serialization_enabled());
         if (r < 0)
                 return r;
 
         if (fseeko(f, 0, SEEK_SET) < 0)
                 return log_error_errno(errno, "Failed to seek to beginning of serialization: %m");
 
+        serialize_usec = now(CLOCK_MONOTONIC) - start;
+
         /* 💀 This is the point of no return, from here on there is no way back. 💀 */
         reloading = NULL;
 
@@ -3412,6 +3813,7 @@ int manager_reload(Manager *m) {
         lookup_paths_free(&m->lookup_paths);
         exec_runtime_vacuum(m);
         dynamic_user_vacuum(m, false);
+        manager_flush_mount_namespace_templates(m);
         m->uid_refs = hashmap_free(m->uid_refs);
         m->gid_refs = hashmap_free(m->gid_refs);
 
@@ -3426,15 +3828,18 @@ int manager_reload(Manager *m) {
 
         /* We flushed out generated files, for which we don't watch mtime, so we should flush the old map. */
         manager_free_unit_name_maps(m);
+        manager_load_unit_cache(m);
 
         /* First, enumerate what we can from kernel and suchlike */
         manager_enumerate_perpetual(m);
         manager_enumerate(m);
 
         /* Second, deserialize our stored data */
+        deserialize_usec = now(CLOCK_MONOTONIC);
         r = manager_deserialize(m, f, fds);
         if (r < 0)
                 log_warning_errno(r, "Deserialization failed, proceeding anyway: %m");
+        deserialize_usec = now(CLOCK_MONOTONIC) - deserialize_usec;
 
         /* We don't need the serialization anymore */
         f = safe_fclose(f);
@@ -3459,10 +3864,430 @@ int manager_reload(Manager *m) {
 
         manager_ready(m);
 
+        /* Units are loaded again, update the unit file cache. During boot this is done once it is complete. */
+        if (MANAGER_IS_FINISHED(m))
+                manager_save_unit_cache(m);
+
+        log_debug("Reloaded in %s (serialization took %s, deserialization %s).",
+                  FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - start, USEC_PER_MSEC),
+                  FORMAT_TIMESPAN(serialize_usec, USEC_PER_MSEC),
+                  FORMAT_TIMESPAN(deserialize_usec, USEC_PER_MSEC));
+
         m->send_reloading_done = true;
         return 0;
 }
 
+typedef struct IncomingDependency {
+        char *source;
+        UnitDependency dependency;
+        UnitDependencyMask mask;
+} IncomingDependency;
+
+typedef struct IncomingRef {
+        UnitRef *ref;
+        Unit *source;
+} IncomingRef;
+
+static void incoming_dependencies_free(IncomingDependency *d, size_t n) {
+        for (size_t i = 0; i < n; i++)
+                free(d[i].source);
+        free(d);
+}
+
+static bool incoming_dependencies_contain(const IncomingDependency *d, size_t n, const char *source, UnitDependency dependency) {
+        for (size_t i = 0; i < n; i++)
+                if (d[i].dependency == dependency && streq(d[i].source, source))
+                        return true;
+
+        return false;
+}
+
+static bool unit_names_match(Unit *u, Set *names) {
+        const char *t;
+
+        assert(u);
+
+        /* Checks whether the set of names found in the unit file map still matches the names the unit was
+         * loaded with. If a unit file was not found, the map doesn't know any names for it. */
+
+        if (set_isempty(names))
+                return set_isempty(u->aliases);
+
+        if (set_size(names) != set_size(u->aliases) + 1)
+                return false;
+
+        SET_FOREACH(t, names)
+                if (!streq(t, u->id) && !set_contains(u->aliases, t))
+                        return false;
+
+        return true;
+}
+
+static int unit_reload_incremental_supported(Unit *u, const char **ret_reason) {
+        ExecContext *ec;
+
+        assert(u);
+        assert(ret_reason);
+
+        /* Checks whether the unit may be torn down and recreated from its serialization while the manager is
+         * running. Everything whose state is shared with other units or kept outside of the unit's
+         * serialization is refused, and we leave those cases to a full reload. */
+
+        if (u->perpetual)
+                *ret_reason = "perpetual unit";
+        else if (u->transient)
+                *ret_reason = "transient unit";
+        else if (!set_isempty(u->aliases))
+                *ret_reason = "unit has aliases";
+        else if (!IN_SET(u->type, UNIT_SERVICE, UNIT_SOCKET, UNIT_TARGET, UNIT_TIMER, UNIT_PATH))
+                *ret_reason = "unit type not supported";
+        else if (u->job || u->nop_job)
+                *ret_reason = "unit has a pending job";
+        else if (unit_get_exec_runtime(u))
+                *ret_reason = "unit has a shared runtime";
+        else if ((ec = unit_get_exec_context(u)) && ec->dynamic_user)
+                *ret_reason = "unit uses a dynamic user";
+        else if (u->type == UNIT_SERVICE && UNIT_ISSET(SERVICE(u)->accept_socket))
+                *ret_reason = "unit is a per-connection service";
+        else if (u->type == UNIT_SOCKET && SOCKET(u)->n_connections > 0)
+                *ret_reason = "socket has active connections";
+        else {
+                *ret_reason = NULL;
+                return true;
+        }
+
+        return false;
+}
+
+static int manager_find_changed_units(Manager *m, Set **ret, sd_bus_error *error) {
+        _cleanup_set_free_ Set *changed = NULL;
+        Unit *u;
+        char *k;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        /* Catch new and removed unit files and aliases */
+        r = manager_build_unit_name_map(m);
+        if (r < 0)
+                return sd_bus_error_set_errnof(error, r, "Failed to rebuild unit name map: %m");
+
+        HASHMAP_FOREACH_KEY(u, k, m->units) {
+                _cleanup_set_free_free_ Set *names = NULL;
+                const char *fragment = NULL, *reason;
+
+                /* ignore aliases */
+                if (u->id != k)
+                        continue;
+
+                if (IN_SET(u->load_state, UNIT_STUB, UNIT_MERGED) || u->transient || u->perpetual)
+                        continue;
+
+                r = unit_file_find_fragment(m->unit_id_map, m->unit_name_map, u->id, &fragment, &names);
+                if (r < 0 && r != -ENOENT)
+                        return sd_bus_error_set_errnof(error, r, "Failed to look up unit file of %s: %m", u->id);
+
+                if (!unit_names_match(u, names))
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_NOT_SUPPORTED,
+                                                 "Names of %s changed, a full reload is necessary.", u->id);
+
+                if (!path_equal_ptr(fragment, u->fragment_path) || unit_need_daemon_reload(u))
+                        r = true;
+                else if (u->load_state == UNIT_LOADED) {
+                        r = unit_dependency_dropins_changed(u);
+                        if (r < 0)
+                                return sd_bus_error_set_errnof(error, r, "Failed to check dependency drop-ins of %s: %m", u->id);
+                } else
+                        r = false;
+                if (r == 0)
+                        continue;
+
+                if (!unit_reload_incremental_supported(u, &reason))
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_NOT_SUPPORTED,
+                                                 "%s changed, but cannot be reloaded incrementally (%s).", u->id, reason);
+
+                r = set_put_strdup(&changed, u->id);
+                if (r < 0)
+                        return sd_bus_error_set_errno(error, r);
+        }
+
+        *ret = TAKE_PTR(changed);
+        return 0;
+}
+
+static void unit_unregister_names(Unit *u) {
+        const char *t;
+
+        SET_FOREACH(t, u->aliases)
+                hashmap_remove_value(u->manager->units, t, u);
+        hashmap_remove_value(u->manager->units, u->id, u);
+}
+
+static int unit_register_names(Unit *u) {
+        const char *t;
+        int r;
+
+        r = hashmap_put(u->manager->units, u->id, u);
+        if (r < 0)
+                return r;
+
+        SET_FOREACH(t, u->aliases) {
+                r = hashmap_put(u->manager->units, t, u);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int unit_reload_in_place(Unit *u, FDSet *fds, Unit **ret) {
+        IncomingDependency *incoming = NULL;
+        _cleanup_free_ IncomingRef *refs = NULL;
+        _cleanup_free_ char *name = NULL, *buf = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t n_incoming = 0, n_refs = 0, sz = 0;
+        const UnitDependencyEdge *e;
+        Manager *m;
+        Unit *other, *n;
+        int r, q;
+
+        assert(u);
+        assert(fds);
+        assert(ret);
+
+        m = u->manager;
+
+        name = strdup(u->id);
+        if (!name)
+                return -ENOMEM;
+
+        f = open_memstream_unlocked(&buf, &sz);
+        if (!f)
+                return -ENOMEM;
+
+        r = unit_serialize(u, f, fds, /* switching_root= */ false);
+        if (r < 0)
+                return r;
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        f = safe_fclose(f);
+
+        /* Dependencies the unit declared itself are recreated when it is loaded again, but the ones other
+         * units declared on it would be lost with it. Remember those, so that we can put them back without
+         * having to reparse the other side. */
+        UNIT_FOREACH_DEPENDENCY_EDGE(e, u) {
+                other = e->other;
+
+                if (other == u)
+                        continue;
+
+                for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                        const UnitDependencyEdge *back;
+
+                        back = unit_find_dependency(other, d, u);
+                        if (!back || back->origin_mask == 0)
+                                continue;
+
+                        /* The same neighbour may be found through several of our dependency types */
+                        if (incoming_dependencies_contain(incoming, n_incoming, other->id, d))
+                                continue;
+
+                        if (!GREEDY_REALLOC(incoming, n_incoming + 1)) {
+                                r = -ENOMEM;
+                                goto finish;
+                        }
+
+                        incoming[n_incoming] = (IncomingDependency) {
+                                .source = strdup(other->id),
+                                .dependency = d,
+                                .mask = back->origin_mask,
+                        };
+                        if (!incoming[n_incoming].source) {
+                                r = -ENOMEM;
+                                goto finish;
+                        }
+                        n_incoming++;
+                }
+        }
+
+        LIST_FOREACH(refs_by_target, ref, u->refs_by_target) {
+                if (ref->source == u)
+                        continue;
+
+                if (!GREEDY_REALLOC(refs, n_refs + 1)) {
+                        r = -ENOMEM;
+                        goto finish;
+                }
+
+                refs[n_refs++] = (IncomingRef) {
+                        .ref = ref,
+                        .source = ref->source,
+                };
+        }
+
+        f = fmemopen_unlocked(buf, sz, "r");
+        if (!f) {
+                r = -errno;
+                goto finish;
+        }
+
+        /* Skip the start marker carrying the unit name, unit_deserialize() expects to be called after it */
+        r = read_line(f, LONG_LINE_MAX, NULL);
+        if (r < 0)
+                goto finish;
+
+        /* Load the new configuration into a new unit object before letting go of the old one, so that the
+         * latter is left untouched if that fails. The old one is hidden from name lookups meanwhile, but
+         * keeps its cgroup, PIDs and invocation ID registered until it is freed, and the new one takes
+         * them over from the deserialization afterwards. */
+        unit_unregister_names(u);
+
+        r = manager_load_unit(m, name, NULL, NULL, &n);
+        if (r < 0) {
+                /* The hashmap doesn't shrink on removal, so there's room for the names we just removed */
+                q = unit_register_names(u);
+                if (q < 0)
+                        log_unit_error_errno(u, q, "Failed to register names of unit again: %m");
+
+                goto finish;
+        }
+
+        unit_free(u);
+        u = n;
+
+        r = unit_deserialize(u, f, fds);
+        if (r < 0)
+                log_unit_warning_errno(u, r, "Failed to deserialize unit state, proceeding anyway: %m");
+
+        for (size_t i = 0; i < n_incoming; i++) {
+                other = manager_get_unit(m, incoming[i].source);
+                if (!other)
+                        continue;
+
+                r = unit_add_dependency(other, incoming[i].dependency, u, /* add_reference= */ false, incoming[i].mask);
+                if (r < 0)
+                        log_unit_warning_errno(other, r, "Failed to restore dependency on %s, ignoring: %m", u->id);
+        }
+
+        for (size_t i = 0; i < n_refs; i++)
+                unit_ref_set(refs[i].ref, refs[i].source, u);
+
+        *ret = u;
+        r = 0;
+
+finish:
+        incoming_dependencies_free(incoming, n_incoming);
+        return r;
+}
+
+int manager_reload_incremental(Manager *m, unsigned *ret_n_checked, unsigned *ret_n_reloaded, sd_bus_error *error) {
+        _unused_ _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
+        _cleanup_free_ Unit **reloaded = NULL;
+        _cleanup_set_free_ Set *changed = NULL;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        size_t n_reloaded = 0;
+        unsigned n_checked;
+        const char *name;
+        usec_t start;
+        Unit *u;
+        char *k;
+        int r;
+
+        assert(m);
+
+        /* Reloads only the units whose unit files, drop-ins or .wants/ and .requires/ symlinks changed since
+         * they were loaded, and keeps all other units, their jobs and runtime state untouched. Each changed unit
+         * is serialized, freed, loaded again from disk and deserialized, and the dependencies other units
+         * declared on it are restored. Generators are not rerun. If any changed unit cannot be reloaded this
+         * way, -EOPNOTSUPP is returned with an explanation in 'error', and the caller should fall back to a
+         * full reload. If that is found out only while reloading the units, the ones that were reloaded
+         * already are kept, and the failed one is left as it was. */
+
+        start = now(CLOCK_MONOTONIC);
+
+        if (m->objective != MANAGER_OK)
+                return sd_bus_error_set(error, SD_BUS_ERROR_NOT_SUPPORTED, "A full reload or reexecution is already pending.");
+
+        r = manager_find_changed_units(m, &changed, error);
+        if (r < 0)
+                return r;
+
+        n_checked = 0;
+        HASHMAP_FOREACH_KEY(u, k, m->units)
+                if (u->id == k)
+                        n_checked++;
+
+        if (!set_isempty(changed)) {
+                fds = fdset_new();
+                if (!fds)
+                        return -ENOMEM;
+
+                reloaded = new(Unit*, set_size(changed));
+                if (!reloaded)
+                        return -ENOMEM;
+
+                /* We are officially in reload mode from here on. */
+                reloading = manager_reloading_start(m);
+                bus_manager_send_reloading(m, true);
+
+                SET_FOREACH(name, changed) {
+                        u = manager_get_unit(m, name);
+                        if (!u)
+                                continue;
+
+                        log_unit_debug(u, "Unit configuration changed, reloading.");
+
+                        r = unit_reload_in_place(u, fds, &u);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to reload %s in place: %m", name);
+                                (void) sd_bus_error_setf(error, SD_BUS_ERROR_NOT_SUPPORTED,
+                                                         "Failed to reload %s in place, a full reload is necessary: %s",
+                                                         name, STRERROR(r));
+                                break;
+                        }
+
+                        reloaded[n_reloaded++] = u;
+                }
+
+                /* The other units are live, they were either coldplugged already or created at runtime (see
+                 * unit_new()), hence jobs enqueued from here won't coldplug them. */
+                for (size_t i = 0; i < n_reloaded; i++) {
+                        r = unit_coldplug(reloaded[i]);
+                        if (r < 0)
+                                log_unit_warning_errno(reloaded[i], r, "Failed to coldplug unit, proceeding anyway: %m");
+                }
+
+                for (size_t i = 0; i < n_reloaded; i++)
+                        unit_catchup(reloaded[i]);
+
+                m->send_reloading_done = true;
+
+                if (sd_bus_error_is_set(error))
+                        return -EOPNOTSUPP;
+        }
+
+        /* A full reload writes the cgroup attributes of all units again (see unit_deserialize_finish()),
+         * restoring any that were changed behind our back. Do the same for the units we kept. */
+        HASHMAP_FOREACH_KEY(u, k, m->units)
+                if (u->id == k && u->cgroup_realized)
+                        unit_invalidate_cgroup(u, _CGROUP_MASK_ALL);
+
+        log_info("Reloaded %zu of %u units in %s.",
+                 n_reloaded, n_checked,
+                 FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - start, USEC_PER_MSEC));
+
+        if (ret_n_checked)
+                *ret_n_checked = n_checked;
+        if (ret_n_reloaded)
+                *ret_n_reloaded = n_reloaded;
+
+        return 0;
+}
+
 void manager_reset_failed(Manager *m) {
         Unit *u;
 
@@ -3686,6 +4511,9 @@ void manager_check_finished(Manager *m) {
 
         manager_notify_finished(m);
 
+        manager_save_unit_cache(m);
+        manager_save_boot_profile(m);
+
         manager_invalidate_startup_units(m);
 }
 
@@ -19,6 +19,8 @@
 
 struct libmnt_monitor;
 typedef struct Unit Unit;
+typedef struct MountTable MountTable;
+typedef struct NotifyBuffer NotifyBuffer;
 
 /* Enforce upper limit how many names we allow */
 #define MANAGER_MAX_NAMES 131072 /* 128K */
@@ -122,8 +124,12 @@ typedef enum WatchdogType {
         _WATCHDOG_TYPE_MAX,
 } WatchdogType;
 
+#include "boot-profile.h"
+#include "boot-trace.h"
 #include "execute.h"
 #include "job.h"
+#include "load-cache.h"
+#include "path-fanotify.h"
 #include "path-lookup.h"
 #include "show-status.h"
 #include "unit-name.h"
@@ -167,6 +173,13 @@ struct Manager {
         LIST_HEAD(Unit, dbus_unit_queue);
         LIST_HEAD(Job, dbus_job_queue);
 
+        /* If non-zero, units and jobs are kept in the queues above for this long before their change
+         * signals are generated, so that many changes to the same object result in a single signal. The
+         * timestamp is when the queues were first found non-empty. */
+        usec_t dbus_signal_coalesce_usec;
+        usec_t dbus_queue_since;
+        sd_event_source *dbus_queue_event_source;
+
         /* Units to remove */
         LIST_HEAD(Unit, cleanup_queue);
 
@@ -206,6 +219,11 @@ struct Manager {
          * context, but this allows us to use the negative range for our own purposes. */
         Hashmap *watch_pids;  /* pid => unit as well as -pid => array of units */
 
+        /* For each PID in watch_pids we also keep an event source on its pidfd, so that we can dispatch
+         * the exit of a specific process without a waitid(P_ALL) scan and without PID reuse races. */
+        Hashmap *watch_pidfds; /* pid => sd_event_source */
+        bool pidfd_unsupported;
+
         /* A set contains all units which cgroup should be refreshed after startup */
         Set *startup_units;
 
@@ -216,6 +234,7 @@ struct Manager {
 
         char *notify_socket;
         int notify_fd;
+        NotifyBuffer *notify_buffer;
         sd_event_source *notify_event_source;
 
         int cgroups_agent_fd;
@@ -235,6 +254,9 @@ struct Manager {
         int user_lookup_fds[2];
         sd_event_source *user_lookup_event_source;
 
+        /* Mount namespace templates, see mount_namespace_template_join() */
+        int mount_ns_storage_socket[2];
+
         LookupScope unit_file_scope;
         LookupPaths lookup_paths;
         Hashmap *unit_id_map;
@@ -242,6 +264,17 @@ struct Manager {
         Set *unit_path_cache;
         uint64_t unit_cache_timestamp_hash;
 
+        /* Unit files and drop-ins read ahead on worker threads while dispatching the load queue */
+        Hashmap *preparsed_files;
+
+        /* The snapshot of the unit search path the name maps are built from, and the on-disk cache of it and
+         * of unit files. While unit_cache_collect is set, the unit files read are kept in unit_cache_files, to
+         * be written out once booting or reloading is complete. */
+        UnitFileDirCache *unit_file_dir_cache;
+        UnitCache *unit_cache;
+        Hashmap *unit_cache_files;
+        bool unit_cache_collect;
+
         char **transient_environment;  /* The environment, as determined from config files, kernel cmdline and environment generators */
         char **client_environment;     /* Environment variables created by clients through the bus API */
 
@@ -252,6 +285,23 @@ struct Manager {
 
         dual_timestamp timestamps[_MANAGER_TIMESTAMP_MAX];
 
+        /* How long loading units took during boot, split into reading the files and applying them */
+        usec_t units_load_parse_usec;
+        usec_t units_load_apply_usec;
+        unsigned units_load_parsed_files;
+        unsigned units_load_parse_threads;
+
+        /* The unit activation times of the previous boot, if critical path scheduling is enabled. Cached
+         * critical path weights of units are valid as long as they carry the current generation. */
+        BootProfile *boot_profile;
+        unsigned critical_path_generation;
+
+        /* Phases of jobs and process executions, if BootTrace= is enabled */
+        BootTrace *boot_trace;
+
+        /* Periodically compacts inactive units, if CompactInactiveUnits= is enabled */
+        sd_event_source *compact_units_event_source;
+
         /* Data specific to the device subsystem */
         sd_device_monitor *device_monitor;
         Hashmap *devices_by_sysfs;
@@ -259,12 +309,20 @@ struct Manager {
         /* Data specific to the mount subsystem */
         struct libmnt_monitor *mount_monitor;
         sd_event_source *mount_event_source;
+        MountTable *mount_table;
 
         /* Data specific to the swap filesystem */
         FILE *proc_swaps;
         sd_event_source *swap_event_source;
         Hashmap *swaps_by_devnode;
 
+        /* Data specific to the path subsystem, if PathWatchBackend=fanotify */
+        PathWatchBackend path_watch_backend;
+        int path_fanotify_fd;
+        sd_event_source *path_fanotify_event_source;
+        Hashmap *path_watch_filesystems;    /* fsid => PathWatchFilesystem */
+        Hashmap *path_watch_directories;    /* fsid + file handle => PathWatchDirectory */
+
         /* Data specific to the D-Bus subsystem */
         sd_bus *api_bus, *system_bus;
         Set *private_buses;
@@ -297,6 +355,14 @@ struct Manager {
         CGroupMask cgroup_supported;
         char *cgroup_root;
 
+        /* How many cgroup attributes we wrote, and how many writes we skipped since the value was
+         * unchanged */
+        uint64_t n_cgroup_attribute_writes;
+        uint64_t n_cgroup_attribute_writes_skipped;
+
+        /* Bumped on each accounting snapshot taken via the bus, see unit_get_accounting_snapshot() */
+        uint64_t accounting_generation;
+
         /* Notifications from cgroups, when the unified hierarchy is used is done via inotify. */
         int cgroup_inotify_fd;
         sd_event_source *cgroup_inotify_event_source;
@@ -352,6 +418,7 @@ struct Manager {
         char *confirm_spawn;
         bool no_console_output;
         bool service_watchdogs;
+        bool critical_path_scheduling;
 
         ExecOutput default_std_output, default_std_error;
 
@@ -428,6 +495,13 @@ struct Manager {
         /* ExecRuntime, indexed by their owner unit id */
         Hashmap *exec_runtime_by_id;
 
+        /* Compiled system call filters, indexed by their policy, so that they don't have to be compiled
+         * again for every process we spawn */
+        Hashmap *seccomp_programs;
+
+        /* Loaded BPF programs, indexed by their code, so that units with identical policies share them */
+        Set *bpf_program_cache;
+
         /* When the user hits C-A-D more than 7 times per 2s, do something immediately... */
         RateLimit ctrl_alt_del_ratelimit;
         EmergencyAction cad_burst_action;
@@ -511,6 +585,12 @@ void manager_clear_jobs(Manager *m);
 
 void manager_unwatch_pid(Manager *m, pid_t pid);
 
+int manager_watch_pidfd(Manager *m, pid_t pid);
+void manager_unwatch_pidfd(Manager *m, pid_t pid);
+
+const int *manager_get_mount_namespace_templates(Manager *m);
+void manager_flush_mount_namespace_templates(Manager *m);
+
 unsigned manager_dispatch_load_queue(Manager *m);
 
 int manager_default_environment(Manager *m);
@@ -527,6 +607,7 @@ void manager_trigger_run_queue(Manager *m);
 int manager_loop(Manager *m);
 
 int manager_reload(Manager *m);
+int manager_reload_incremental(Manager *m, unsigned *ret_n_checked, unsigned *ret_n_reloaded, sd_bus_error *error);
 Manager* manager_reloading_start(Manager *m);
 void manager_reloading_stopp(Manager **m);
 
@@ -594,3 +675,22 @@ int manager_override_watchdog_pretimeout_governor(Manager *m, const char *govern
 
 const char* oom_policy_to_string(OOMPolicy i) _const_;
 OOMPolicy oom_policy_from_string(const char *s) _pure_;
+
+typedef struct NotifyMessage {
+        struct ucred ucred;
+        char **tags;
+        FDSet *fds;
+
+        /* Messages of the same sender in the same batch that only carried information this one overrides */
+        unsigned n_coalesced;
+
+        /* Tags that can be coalesced if a later message carries them too */
+        bool status:1;
+        bool watchdog:1;
+        bool other:1;
+
+        bool barrier:1;
+} NotifyMessage;
+
+/* Only exported for unit tests */
+bool notify_message_supersedes(const NotifyMessage *msg, const NotifyMessage *earlier);
@@ -0,0 +1,316 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "mount-table.h"
+#include "path-util.h"
+#include "string-util.h"
+
+static MountTableEntry* mount_table_entry_free(MountTableEntry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->what);
+        free(e->where);
+        free(e->options);
+        free(e->fstype);
+
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(MountTableEntry*, mount_table_entry_free);
+
+MountTable* mount_table_new(void) {
+        return new0(MountTable, 1);
+}
+
+MountTable* mount_table_free(MountTable *t) {
+        MountTableEntry *e;
+
+        if (!t)
+                return NULL;
+
+        while ((e = hashmap_steal_first(t->by_id)))
+                mount_table_entry_free(e);
+
+        hashmap_free(t->by_id);
+        hashmap_free(t->by_where);
+        hashmap_free(t->what_refs);
+
+        return mfree(t);
+}
+
+static int mount_table_ref_what(MountTable *t, const char *what) {
+        _cleanup_free_ char *w = NULL;
+        unsigned n;
+        int r;
+
+        n = PTR_TO_UINT(hashmap_get(t->what_refs, what));
+        if (n > 0)
+                return hashmap_update(t->what_refs, what, UINT_TO_PTR(n + 1));
+
+        w = strdup(what);
+        if (!w)
+                return -ENOMEM;
+
+        r = hashmap_ensure_put(&t->what_refs, &path_hash_ops_free, w, UINT_TO_PTR(1));
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(w);
+        return 0;
+}
+
+static void mount_table_unref_what(MountTable *t, const char *what) {
+        unsigned n;
+
+        n = PTR_TO_UINT(hashmap_get(t->what_refs, what));
+        assert(n > 0);
+
+        if (n > 1)
+                assert_se(hashmap_update(t->what_refs, what, UINT_TO_PTR(n - 1)) >= 0);
+        else {
+                _cleanup_free_ char *w = NULL;
+
+                (void) hashmap_remove2(t->what_refs, what, (void**) &w);
+        }
+}
+
+static void mount_table_remove(MountTable *t, MountTableEntry *e) {
+        MountTableEntry *head;
+
+        assert(t);
+        assert(e);
+
+        head = hashmap_get(t->by_where, e->where);
+        LIST_REMOVE(by_where, head, e);
+        if (head)
+                assert_se(hashmap_replace(t->by_where, head->where, head) >= 0);
+        else
+                (void) hashmap_remove(t->by_where, e->where);
+
+        mount_table_unref_what(t, e->what);
+        (void) hashmap_remove(t->by_id, INT_TO_PTR(e->id));
+
+        mount_table_entry_free(e);
+}
+
+static int mount_table_add(
+                MountTable *t,
+                int id,
+                unsigned index,
+                const char *what,
+                const char *where,
+                const char *options,
+                const char *fstype) {
+
+        _cleanup_(mount_table_entry_freep) MountTableEntry *e = NULL;
+        MountTableEntry *head, *prev = NULL;
+        int r;
+
+        assert(t);
+        assert(what);
+        assert(where);
+
+        e = new(MountTableEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        *e = (MountTableEntry) {
+                .id = id,
+                .index = index,
+                .generation = t->generation,
+                .what = strdup(what),
+                .where = strdup(where),
+        };
+        if (!e->what || !e->where)
+                return -ENOMEM;
+
+        r = free_and_strdup(&e->options, options);
+        if (r < 0)
+                return r;
+
+        r = free_and_strdup(&e->fstype, fstype);
+        if (r < 0)
+                return r;
+
+        r = hashmap_ensure_allocated(&t->by_where, &path_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_ensure_put(&t->by_id, NULL, INT_TO_PTR(id), e);
+        if (r < 0)
+                return r;
+
+        r = mount_table_ref_what(t, what);
+        if (r < 0) {
+                (void) hashmap_remove(t->by_id, INT_TO_PTR(id));
+                return r;
+        }
+
+        /* Keep the mounts on the same mount point in the order they were mounted in */
+        head = hashmap_get(t->by_where, where);
+        LIST_FOREACH(by_where, i, head)
+                if (i->index < index)
+                        prev = i;
+        if (prev)
+                LIST_INSERT_AFTER(by_where, head, prev, e);
+        else
+                LIST_PREPEND(by_where, head, e);
+
+        r = hashmap_replace(t->by_where, head->where, head);
+        if (r < 0) {
+                LIST_REMOVE(by_where, head, e);
+                mount_table_unref_what(t, what);
+                (void) hashmap_remove(t->by_id, INT_TO_PTR(id));
+                return r;
+        }
+
+        TAKE_PTR(e);
+        return 0;
+}
+
+static bool mount_table_entry_equal(
+                const MountTableEntry *e,
+                const char *what,
+                const char *where,
+                const char *options,
+                const char *fstype) {
+
+        assert(e);
+
+        return streq(e->where, where) &&
+                streq(e->what, what) &&
+                streq_ptr(e->options, options) &&
+                streq_ptr(e->fstype, fstype);
+}
+
+int mount_table_update(
+                MountTable *t,
+                struct libmnt_table *table,
+                struct libmnt_iter *iter,
+                Set **ret_changed_where,
+                Set **ret_new_what,
+                Set **ret_gone_what) {
+
+        _cleanup_set_free_ Set *changed_where = NULL, *new_what = NULL, *gone_what = NULL;
+        MountTableEntry *e;
+        unsigned index = 0;
+        char *what;
+        int r;
+
+        assert(t);
+        assert(table);
+        assert(iter);
+
+        /* Brings the table up to date with the specified parsed mount table. Returns the mount points that
+         * had mounts added, removed or changed, the sources of all added or changed mounts, and the sources
+         * that are not mounted anywhere anymore. If this fails, the table is left in an undefined state and
+         * should not be used anymore. */
+
+        t->generation++;
+
+        for (;;) {
+                const char *device, *path, *options, *fstype;
+                struct libmnt_fs *fs;
+                int id;
+
+                r = mnt_table_next_fs(table, iter, &fs);
+                if (r == 1)
+                        break;
+                if (r < 0)
+                        return r;
+
+                device = mnt_fs_get_source(fs);
+                path = mnt_fs_get_target(fs);
+                options = mnt_fs_get_options(fs);
+                fstype = mnt_fs_get_fstype(fs);
+
+                if (!device || !path)
+                        continue;
+
+                id = mnt_fs_get_id(fs);
+
+                e = hashmap_get(t->by_id, INT_TO_PTR(id));
+                if (e && mount_table_entry_equal(e, device, path, options, fstype)) {
+                        e->index = index++;
+                        e->generation = t->generation;
+
+                        if (e->retry) {
+                                r = set_put_strdup_full(&changed_where, &path_hash_ops_free, path);
+                                if (r < 0)
+                                        return r;
+
+                                e->retry = false;
+                        }
+
+                        continue;
+                }
+
+                if (e) {
+                        /* The mount was remounted or moved (or, rarely, the ID was reused). Let's treat that
+                         * as if the old mount went away and a new one showed up. */
+                        r = set_put_strdup_full(&changed_where, &path_hash_ops_free, e->where);
+                        if (r < 0)
+                                return r;
+
+                        r = set_put_strdup_full(&gone_what, &path_hash_ops_free, e->what);
+                        if (r < 0)
+                                return r;
+
+                        mount_table_remove(t, e);
+                }
+
+                r = mount_table_add(t, id, index++, device, path, options, fstype);
+                if (r < 0)
+                        return r;
+
+                r = set_put_strdup_full(&changed_where, &path_hash_ops_free, path);
+                if (r < 0)
+                        return r;
+
+                r = set_put_strdup_full(&new_what, &path_hash_ops_free, device);
+                if (r < 0)
+                        return r;
+        }
+
+        /* Everything we didn't see this time is gone */
+        HASHMAP_FOREACH(e, t->by_id) {
+                if (e->generation == t->generation)
+                        continue;
+
+                r = set_put_strdup_full(&changed_where, &path_hash_ops_free, e->where);
+                if (r < 0)
+                        return r;
+
+                r = set_put_strdup_full(&gone_what, &path_hash_ops_free, e->what);
+                if (r < 0)
+                        return r;
+
+                mount_table_remove(t, e);
+        }
+
+        /* Sources that are still mounted elsewhere, or got mounted again, are not gone */
+        SET_FOREACH(what, gone_what)
+                if (hashmap_contains(t->what_refs, what))
+                        free(set_remove(gone_what, what));
+
+        if (ret_changed_where)
+                *ret_changed_where = TAKE_PTR(changed_where);
+        if (ret_new_what)
+                *ret_new_what = TAKE_PTR(new_what);
+        if (ret_gone_what)
+                *ret_gone_what = TAKE_PTR(gone_what);
+
+        return 0;
+}
+
+void mount_table_retry_where(MountTable *t, const char *where) {
+        assert(t);
+        assert(where);
+
+        /* Processing the mounts on this mount point failed, hence make sure it is reported as changed again
+         * the next time the table is updated, even if nothing happened to it in the meantime. */
+
+        LIST_FOREACH(by_where, e, mount_table_get_where(t, where))
+                e->retry = true;
+}
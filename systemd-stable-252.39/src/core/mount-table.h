@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "hashmap.h"
+#include "libmount-util.h"
+#include "list.h"
+#include "set.h"
+
+/* The contents of /proc/self/mountinfo as of the last time we looked at it, keyed by mount ID. When the mount
+ * table changes, comparing against it tells us which mount points were actually affected, so that only the
+ * units for those need to be looked at. */
+
+typedef struct MountTableEntry MountTableEntry;
+
+struct MountTableEntry {
+        int id;
+        unsigned index;         /* Position in the mount table, mounts stacked on the same path are sorted by it */
+        unsigned generation;    /* The update of the table this entry was last seen in */
+        bool retry;             /* Report the mount point as changed again on the next update */
+
+        char *what;
+        char *where;
+        char *options;
+        char *fstype;
+
+        LIST_FIELDS(MountTableEntry, by_where);
+};
+
+typedef struct MountTable {
+        Hashmap *by_id;         /* mount ID → MountTableEntry */
+        Hashmap *by_where;      /* mount point → list of MountTableEntry, bottom-most first */
+        Hashmap *what_refs;     /* source → number of entries mounting it */
+        unsigned generation;
+} MountTable;
+
+MountTable* mount_table_new(void);
+MountTable* mount_table_free(MountTable *t);
+DEFINE_TRIVIAL_CLEANUP_FUNC(MountTable*, mount_table_free);
+
+int mount_table_update(
+                MountTable *t,
+                struct libmnt_table *table,
+                struct libmnt_iter *iter,
+                Set **ret_changed_where,
+                Set **ret_new_what,
+                Set **ret_gone_what);
+
+void mount_table_retry_where(MountTable *t, const char *where);
+
+static inline MountTableEntry* mount_table_get_where(MountTable *t, const char *where) {
+        return hashmap_get(t->by_where, where);
+}
+
+static inline unsigned mount_table_size(MountTable *t) {
+        return hashmap_size(t->by_id);
+}
@@ -20,6 +20,7 @@
 #include "manager.h"
 #include "mkdir-label.h"
 #include "mount-setup.h"
+#include "mount-table.h"
 #include "mount.h"
 #include "mountpoint-util.h"
 #include "parse-util.h"
@@ -1809,44 +1810,56 @@ static int mount_setup_unit(
         return 0;
 }
 
-static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags) {
+static int mount_load_proc_self_mountinfo(
+                Manager *m,
+                bool set_flags,
+                Set **ret_changed_where,
+                Set **ret_gone_what) {
+
         _cleanup_(mnt_free_tablep) struct libmnt_table *table = NULL;
         _cleanup_(mnt_free_iterp) struct libmnt_iter *iter = NULL;
-        _cleanup_set_free_ Set *devices = NULL;
+        _cleanup_set_free_ Set *changed_where = NULL, *new_what = NULL, *gone_what = NULL;
+        const char *what, *where;
         int r;
 
         assert(m);
 
+        /* Loads /proc/self/mountinfo and compares it with what we saw last time. Only the units of mount
+         * points that had something mounted, unmounted or changed are set up. If we have no previous
+         * table, everything counts as newly mounted. */
+
         r = libmount_parse(NULL, NULL, &table, &iter);
         if (r < 0)
                 return log_error_errno(r, "Failed to parse /proc/self/mountinfo: %m");
 
-        for (;;) {
-                struct libmnt_fs *fs;
-                const char *device, *path, *options, *fstype;
-
-                r = mnt_table_next_fs(table, iter, &fs);
-                if (r == 1)
-                        break;
-                if (r < 0)
-                        return log_error_errno(r, "Failed to get next entry from /proc/self/mountinfo: %m");
+        if (!m->mount_table) {
+                m->mount_table = mount_table_new();
+                if (!m->mount_table)
+                        return log_oom();
+        }
 
-                device = mnt_fs_get_source(fs);
-                path = mnt_fs_get_target(fs);
-                options = mnt_fs_get_options(fs);
-                fstype = mnt_fs_get_fstype(fs);
+        r = mount_table_update(m->mount_table, table, iter, &changed_where, &new_what, &gone_what);
+        if (r < 0) {
+                /* Start from scratch next time */
+                m->mount_table = mount_table_free(m->mount_table);
+                return log_error_errno(r, "Failed to process /proc/self/mountinfo: %m");
+        }
 
-                if (!device || !path)
-                        continue;
+        SET_FOREACH(what, new_what)
+                device_found_node(m, what, DEVICE_FOUND_MOUNT, DEVICE_FOUND_MOUNT);
 
-                /* Just to achieve device name uniqueness. Note that the suppresion of the duplicate
-                 * processing is merely an optimization, hence in case of OOM (unlikely) we'll just process
-                 * it twice. */
-                if (set_put_strdup_full(&devices, &path_hash_ops_free, device) != 0)
-                        device_found_node(m, device, DEVICE_FOUND_MOUNT, DEVICE_FOUND_MOUNT);
+        SET_FOREACH(where, changed_where)
+                LIST_FOREACH(by_where, e, mount_table_get_where(m->mount_table, where)) {
+                        r = mount_setup_unit(m, e->what, e->where, e->options, e->fstype, set_flags);
+                        if (r < 0)
+                                /* Try again with the next change of the mount table */
+                                mount_table_retry_where(m->mount_table, where);
+                }
 
-                (void) mount_setup_unit(m, device, path, options, fstype, set_flags);
-        }
+        if (ret_changed_where)
+                *ret_changed_where = TAKE_PTR(changed_where);
+        if (ret_gone_what)
+                *ret_gone_what = TAKE_PTR(gone_what);
 
         return 0;
 }
@@ -1858,6 +1871,8 @@ static void mount_shutdown(Manager *m) {
 
         mnt_unref_monitor(m->mount_monitor);
         m->mount_monitor = NULL;
+
+        m->mount_table = mount_table_free(m->mount_table);
 }
 
 static int mount_get_timeout(Unit *u, usec_t *timeout) {
@@ -2002,7 +2017,10 @@ static void mount_enumerate(Manager *m) {
                 (void) sd_event_source_set_description(m->mount_event_source, "mount-monitor-dispatch");
         }
 
-        r = mount_load_proc_self_mountinfo(m, false);
+        /* Always start from scratch here, as on reload all units were just recreated */
+        m->mount_table = mount_table_free(m->mount_table);
+
+        r = mount_load_proc_self_mountinfo(m, false, NULL, NULL);
         if (r < 0)
                 goto fail;
 
@@ -2035,9 +2053,79 @@ static int drain_libmount(Manager *m) {
         return rescan;
 }
 
+static void mount_follow_proc_self_mountinfo(Mount *mount) {
+        Unit *u = UNIT(mount);
+
+        assert(mount);
+
+        if (!mount_is_mounted(mount)) {
+
+                /* A mount point is not around right now. It
+                 * might be gone, or might never have
+                 * existed. */
+
+                mount->from_proc_self_mountinfo = false;
+                assert_se(update_parameters_proc_self_mountinfo(mount, NULL, NULL, NULL) >= 0);
+
+                switch (mount->state) {
+
+                case MOUNT_MOUNTED:
+                        /* This has just been unmounted by somebody else, follow the state change. */
+                        mount_enter_dead(mount, MOUNT_SUCCESS);
+                        break;
+
+                case MOUNT_MOUNTING_DONE:
+                        /* The mount command may add the corresponding proc mountinfo entry and
+                         * then remove it because of an internal error. E.g., fuse.sshfs seems
+                         * to do that when the connection fails. See #17617. To handle such the
+                         * case, let's once set the state back to mounting. Then, the unit can
+                         * correctly enter the failed state later in mount_sigchld_event(). */
+                        mount_set_state(mount, MOUNT_MOUNTING);
+                        break;
+
+                default:
+                        break;
+                }
+
+        } else if (mount->proc_flags & (MOUNT_PROC_JUST_MOUNTED|MOUNT_PROC_JUST_CHANGED)) {
+
+                /* A mount point was added or changed */
+
+                switch (mount->state) {
+
+                case MOUNT_DEAD:
+                case MOUNT_FAILED:
+
+                        /* This has just been mounted by somebody else, follow the state change, but let's
+                         * generate a new invocation ID for this implicitly and automatically. */
+                        (void) unit_acquire_invocation_id(u);
+                        mount_cycle_clear(mount);
+                        mount_enter_mounted(mount, MOUNT_SUCCESS);
+                        break;
+
+                case MOUNT_MOUNTING:
+                        mount_set_state(mount, MOUNT_MOUNTING_DONE);
+                        break;
+
+                default:
+                        /* Nothing really changed, but let's
+                         * issue an notification call
+                         * nonetheless, in case somebody is
+                         * waiting for this. (e.g. file system
+                         * ro/rw remounts.) */
+                        mount_set_state(mount, mount->state);
+                        break;
+                }
+        }
+
+        /* Reset the flags for later calls */
+        mount->proc_flags = 0;
+}
+
 static int mount_process_proc_self_mountinfo(Manager *m) {
-        _cleanup_set_free_ Set *around = NULL, *gone = NULL;
-        const char *what;
+        _cleanup_set_free_ Set *changed = NULL, *gone = NULL;
+        const char *what, *where;
+        bool full;
         int r;
 
         assert(m);
@@ -2046,7 +2134,11 @@ static int mount_process_proc_self_mountinfo(Manager *m) {
         if (r <= 0)
                 return r;
 
-        r = mount_load_proc_self_mountinfo(m, true);
+        /* If we have no table from last time to compare with, all mount units need to be looked at, since
+         * we cannot tell which ones were unmounted. */
+        full = !m->mount_table;
+
+        r = mount_load_proc_self_mountinfo(m, true, &changed, &gone);
         if (r < 0) {
                 /* Reset flags, just in case, for later calls */
                 LIST_FOREACH(units_by_type, u, m->units_by_type[UNIT_MOUNT])
@@ -2055,95 +2147,44 @@ static int mount_process_proc_self_mountinfo(Manager *m) {
                 return 0;
         }
 
-        manager_dispatch_load_queue(m);
+        log_debug("/proc/self/mountinfo changed, %u of %u mount points affected.",
+                  full ? mount_table_size(m->mount_table) : set_size(changed), mount_table_size(m->mount_table));
 
-        LIST_FOREACH(units_by_type, u, m->units_by_type[UNIT_MOUNT]) {
-                Mount *mount = MOUNT(u);
+        /* The mount namespace templates were built from the previous mount table */
+        manager_flush_mount_namespace_templates(m);
 
-                if (!mount_is_mounted(mount)) {
+        manager_dispatch_load_queue(m);
 
-                        /* A mount point is not around right now. It
-                         * might be gone, or might never have
-                         * existed. */
+        if (full)
+                LIST_FOREACH(units_by_type, u, m->units_by_type[UNIT_MOUNT]) {
+                        Mount *mount = MOUNT(u);
 
-                        if (mount->from_proc_self_mountinfo &&
-                            mount->parameters_proc_self_mountinfo.what)
+                        if (!mount_is_mounted(mount) &&
+                            mount->from_proc_self_mountinfo &&
+                            mount->parameters_proc_self_mountinfo.what &&
+                            !hashmap_contains(m->mount_table->what_refs, mount->parameters_proc_self_mountinfo.what))
                                 /* Remember that this device might just have disappeared */
                                 if (set_put_strdup_full(&gone, &path_hash_ops_free, mount->parameters_proc_self_mountinfo.what) < 0)
                                         log_oom(); /* we don't care too much about OOM here... */
 
-                        mount->from_proc_self_mountinfo = false;
-                        assert_se(update_parameters_proc_self_mountinfo(mount, NULL, NULL, NULL) >= 0);
-
-                        switch (mount->state) {
-
-                        case MOUNT_MOUNTED:
-                                /* This has just been unmounted by somebody else, follow the state change. */
-                                mount_enter_dead(mount, MOUNT_SUCCESS);
-                                break;
-
-                        case MOUNT_MOUNTING_DONE:
-                                /* The mount command may add the corresponding proc mountinfo entry and
-                                 * then remove it because of an internal error. E.g., fuse.sshfs seems
-                                 * to do that when the connection fails. See #17617. To handle such the
-                                 * case, let's once set the state back to mounting. Then, the unit can
-                                 * correctly enter the failed state later in mount_sigchld_event(). */
-                                mount_set_state(mount, MOUNT_MOUNTING);
-                                break;
-
-                        default:
-                                break;
-                        }
-
-                } else if (mount->proc_flags & (MOUNT_PROC_JUST_MOUNTED|MOUNT_PROC_JUST_CHANGED)) {
-
-                        /* A mount point was added or changed */
-
-                        switch (mount->state) {
-
-                        case MOUNT_DEAD:
-                        case MOUNT_FAILED:
-
-                                /* This has just been mounted by somebody else, follow the state change, but let's
-                                 * generate a new invocation ID for this implicitly and automatically. */
-                                (void) unit_acquire_invocation_id(u);
-                                mount_cycle_clear(mount);
-                                mount_enter_mounted(mount, MOUNT_SUCCESS);
-                                break;
-
-                        case MOUNT_MOUNTING:
-                                mount_set_state(mount, MOUNT_MOUNTING_DONE);
-                                break;
-
-                        default:
-                                /* Nothing really changed, but let's
-                                 * issue an notification call
-                                 * nonetheless, in case somebody is
-                                 * waiting for this. (e.g. file system
-                                 * ro/rw remounts.) */
-                                mount_set_state(mount, mount->state);
-                                break;
-                        }
+                        mount_follow_proc_self_mountinfo(mount);
                 }
+        else
+                SET_FOREACH(where, changed) {
+                        _cleanup_free_ char *name = NULL;
+                        Unit *u;
 
-                if (mount_is_mounted(mount) &&
-                    mount->from_proc_self_mountinfo &&
-                    mount->parameters_proc_self_mountinfo.what)
-                        /* Track devices currently used */
-                        if (set_put_strdup_full(&around, &path_hash_ops_free, mount->parameters_proc_self_mountinfo.what) < 0)
-                                log_oom();
+                        if (unit_name_from_path(where, ".mount", &name) < 0)
+                                continue;
 
-                /* Reset the flags for later calls */
-                mount->proc_flags = 0;
-        }
-
-        SET_FOREACH(what, gone) {
-                if (set_contains(around, what))
-                        continue;
+                        u = manager_get_unit(m, name);
+                        if (u)
+                                mount_follow_proc_self_mountinfo(MOUNT(u));
+                }
 
+        SET_FOREACH(what, gone)
                 /* Let the device units know that the device is no longer mounted */
                 device_found_node(m, what, DEVICE_NOT_FOUND, DEVICE_FOUND_MOUNT);
-        }
 
         return 0;
 }
@@ -22,6 +22,7 @@
 #include "fd-util.h"
 #include "format-util.h"
 #include "glyph-util.h"
+#include "io-util.h"
 #include "label.h"
 #include "list.h"
 #include "loop-util.h"
@@ -2970,6 +2971,312 @@ bool ns_type_supported(NamespaceType type) {
         return access(ns_proc, F_OK) == 0;
 }
 
+/* Mount namespace templates: once a child built the mount namespace for a certain set of settings, we keep
+ * a reference to that namespace in a storage socket pair owned by the manager. Further processes with the
+ * same settings then join the template and make themselves a copy of it, which is a lot cheaper than
+ * building the namespace from scratch, in particular if lots of mounts need to be made read-only
+ * recursively. Each stored template is a datagram consisting of the size of the key, the key, i.e. a
+ * serialization of all the settings that went into the namespace, and the identity of the file system
+ * objects the namespace was built from (the bind mount sources and the paths made inaccessible, read-only
+ * and so on), with the namespace fd attached to it. The identity is not part of the key: if one of those
+ * paths got replaced since the template was built, the template would still carry the old object, hence
+ * it is dropped when a process with the same settings finds a different identity. The templates are
+ * ordered from least to most recently used. */
+
+typedef struct MountNamespaceTemplate {
+        void *data;
+        size_t size;
+        int fd;
+} MountNamespaceTemplate;
+
+static void mount_namespace_template_done(MountNamespaceTemplate *t) {
+        assert(t);
+
+        t->data = mfree(t->data);
+        t->fd = safe_close(t->fd);
+}
+
+static bool mount_namespace_template_has_key(const MountNamespaceTemplate *t, const void *key, size_t key_size) {
+        size_t k;
+
+        assert(t);
+        assert(key);
+
+        if (t->size < sizeof(size_t))
+                return false;
+
+        memcpy(&k, t->data, sizeof(size_t));
+
+        return k == key_size &&
+                t->size - sizeof(size_t) >= key_size &&
+                memcmp((const uint8_t*) t->data + sizeof(size_t), key, key_size) == 0;
+}
+
+static bool mount_namespace_template_has_identity(const MountNamespaceTemplate *t, size_t key_size, const void *identity, size_t identity_size) {
+        assert(t);
+        assert(identity || identity_size == 0);
+
+        /* Only valid after mount_namespace_template_has_key() returned true for key_size */
+
+        return t->size - sizeof(size_t) - key_size == identity_size &&
+                memcmp_safe((const uint8_t*) t->data + sizeof(size_t) + key_size, identity, identity_size) == 0;
+}
+
+static size_t mount_namespace_templates_take(int storage_fd, MountNamespaceTemplate templates[static MOUNT_NAMESPACE_TEMPLATES_MAX]) {
+        size_t n = 0;
+
+        /* Takes all templates out of the storage socket. The caller must hold the lock on it. */
+
+        while (n < MOUNT_NAMESPACE_TEMPLATES_MAX) {
+                _cleanup_free_ void *buf = NULL;
+                _cleanup_close_ int fd = -1;
+                ssize_t k;
+
+                buf = malloc(sizeof(size_t) + MOUNT_NAMESPACE_TEMPLATE_KEY_MAX);
+                if (!buf)
+                        break;
+
+                k = receive_one_fd_iov(storage_fd, &IOVEC_MAKE(buf, sizeof(size_t) + MOUNT_NAMESPACE_TEMPLATE_KEY_MAX), 1, MSG_DONTWAIT, &fd);
+                if (k < 0) /* Usually -EAGAIN, i.e. we got everything */
+                        break;
+                if (fd < 0)
+                        continue;
+
+                templates[n++] = (MountNamespaceTemplate) {
+                        .data = TAKE_PTR(buf),
+                        .size = k,
+                        .fd = TAKE_FD(fd),
+                };
+        }
+
+        return n;
+}
+
+static void mount_namespace_templates_put(int storage_fd, MountNamespaceTemplate *templates, size_t n) {
+        assert(templates || n == 0);
+
+        /* Puts the templates back into the storage socket, and releases them. */
+
+        for (size_t i = 0; i < n; i++) {
+                (void) send_one_fd_iov(storage_fd, templates[i].fd,
+                                       &IOVEC_MAKE(templates[i].data, templates[i].size), 1,
+                                       MSG_DONTWAIT);
+                mount_namespace_template_done(templates + i);
+        }
+}
+
+static int mount_namespace_copy(unsigned long mount_flags) {
+
+        /* Moves us from the template into our own copy of it. Note that the mounts of the copy are peers of
+         * the template's mounts, so turn them into slaves first: we want to receive what the host mounts
+         * (which gets propagated to the template), but what we mount shall not propagate back. */
+
+        if (unshare(CLONE_NEWNS) < 0)
+                return log_debug_errno(errno, "Failed to unshare the mount namespace: %m");
+
+        if (mount(NULL, "/", NULL, MS_SLAVE|MS_REC, NULL) < 0)
+                return log_debug_errno(errno, "Failed to remount '/' as SLAVE: %m");
+
+        if (mount_flags == 0)
+                mount_flags = MS_SHARED;
+
+        if (mount(NULL, "/", NULL, mount_flags | MS_REC, NULL) < 0)
+                return log_debug_errno(errno, "Failed to remount '/' with desired mount flags: %m");
+
+        return 0;
+}
+
+int mount_namespace_template_join(
+                const int storage_socket[static 2],
+                const void *key,
+                size_t key_size,
+                const void *identity,
+                size_t identity_size,
+                unsigned long mount_flags,
+                const char *propagate_dir,
+                const char *incoming_dir) {
+
+        MountNamespaceTemplate templates[MOUNT_NAMESPACE_TEMPLATES_MAX];
+        _cleanup_close_ int ns = -1, tree = -1;
+        size_t n;
+        int r;
+
+        assert(storage_socket);
+        assert(storage_socket[0] >= 0);
+        assert(storage_socket[1] >= 0);
+        assert(key);
+        assert(identity || identity_size == 0);
+
+        /* Joins a copy of the template with the specified key. If the template was built from different
+         * file system objects than the ones passed in as identity, it is dropped. Returns 0 if there's no
+         * such template or we cannot use it, in which case nothing changed and the namespace needs to be
+         * set up the normal way.
+         * Returns > 0 if we are in a copy of the template now. Returns < 0 if we failed half-way, in which
+         * case we cannot continue. */
+
+        if (propagate_dir) {
+                /* The propagation directory is specific to each unit, hence it is not part of the key. Get
+                 * a read-only clone of ours now, so that we can replace the one of the unit that built the
+                 * template with it after joining. */
+                (void) mkdir_p(propagate_dir, 0600);
+
+                tree = open_tree(AT_FDCWD, propagate_dir, OPEN_TREE_CLONE|OPEN_TREE_CLOEXEC);
+                if (tree < 0)
+                        return log_debug_errno(errno, "Failed to clone %s, not using mount namespace templates: %m", propagate_dir), 0;
+
+                if (mount_setattr(tree, "", AT_EMPTY_PATH,
+                                  &(struct mount_attr) {
+                                          .attr_set = MOUNT_ATTR_RDONLY,
+                                  }, MOUNT_ATTR_SIZE_VER0) < 0)
+                        return log_debug_errno(errno, "Failed to make clone of %s read-only, not using mount namespace templates: %m", propagate_dir), 0;
+        }
+
+        if (lockf(storage_socket[0], F_LOCK, 0) < 0)
+                return log_debug_errno(errno, "Failed to lock mount namespace template storage, ignoring: %m"), 0;
+
+        n = mount_namespace_templates_take(storage_socket[0], templates);
+
+        for (size_t i = 0; i < n; i++) {
+                MountNamespaceTemplate t;
+
+                if (!mount_namespace_template_has_key(templates + i, key, key_size))
+                        continue;
+
+                if (!mount_namespace_template_has_identity(templates + i, key_size, identity, identity_size)) {
+                        log_debug("Sources of mount namespace template changed, dropping it.");
+
+                        mount_namespace_template_done(templates + i);
+                        memmove(templates + i, templates + i + 1, (n - i - 1) * sizeof(MountNamespaceTemplate));
+                        n--;
+                        break;
+                }
+
+                ns = fcntl(templates[i].fd, F_DUPFD_CLOEXEC, 3);
+
+                /* Move it to the end, it's the most recently used one now */
+                t = templates[i];
+                memmove(templates + i, templates + i + 1, (n - i - 1) * sizeof(MountNamespaceTemplate));
+                templates[n - 1] = t;
+                break;
+        }
+
+        mount_namespace_templates_put(storage_socket[1], templates, n);
+        (void) lockf(storage_socket[0], F_ULOCK, 0);
+
+        if (ns < 0)
+                return 0;
+
+        if (setns(ns, CLONE_NEWNS) < 0)
+                return log_debug_errno(errno, "Failed to join mount namespace template, ignoring: %m"), 0;
+
+        /* From here on there's no way back */
+
+        r = mount_namespace_copy(mount_flags);
+        if (r < 0)
+                return r;
+
+        if (propagate_dir) {
+                assert(incoming_dir);
+
+                if (umount2(incoming_dir, MNT_DETACH) < 0) {
+                        if (errno != EINVAL)
+                                return log_debug_errno(errno, "Failed to unmount %s: %m", incoming_dir);
+
+                        /* Not a mount point, i.e. the template doesn't have it (e.g. because it is
+                         * inaccessible), hence don't set it up either. */
+                } else {
+                        if (move_mount(tree, "", AT_FDCWD, incoming_dir, MOVE_MOUNT_F_EMPTY_PATH) < 0)
+                                return log_debug_errno(errno, "Failed to mount %s to %s: %m", propagate_dir, incoming_dir);
+
+                        /* bind_mount_in_namespace() will MS_MOVE into that directory, and that's only
+                         * supported for non-shared mounts. */
+                        if (mount(NULL, incoming_dir, NULL, MS_SLAVE, NULL) < 0)
+                                return log_debug_errno(errno, "Failed to remount %s with MS_SLAVE: %m", incoming_dir);
+                }
+        }
+
+        return 1;
+}
+
+int mount_namespace_template_store(
+                const int storage_socket[static 2],
+                const void *key,
+                size_t key_size,
+                const void *identity,
+                size_t identity_size,
+                unsigned long mount_flags,
+                const char *incoming_dir) {
+
+        MountNamespaceTemplate templates[MOUNT_NAMESPACE_TEMPLATES_MAX];
+        _cleanup_free_ uint8_t *data = NULL;
+        _cleanup_close_ int ns = -1;
+        size_t n, size, j = 0;
+        int r;
+
+        assert(storage_socket);
+        assert(storage_socket[0] >= 0);
+        assert(storage_socket[1] >= 0);
+        assert(key);
+        assert(identity || identity_size == 0);
+
+        /* Called right after setup_namespace() built a new mount namespace with the settings described by
+         * key, from the file system objects described by identity. Keeps that namespace as template, and
+         * moves us into a copy of it, so that nothing we do later on ends up in the template. Returns < 0
+         * only if we failed half-way and cannot continue. */
+
+        if (key_size > MOUNT_NAMESPACE_TEMPLATE_KEY_MAX ||
+            identity_size > MOUNT_NAMESPACE_TEMPLATE_KEY_MAX - key_size)
+                return 0;
+
+        size = sizeof(size_t) + key_size + identity_size;
+        data = malloc(size);
+        if (!data)
+                return 0;
+
+        memcpy(data, &key_size, sizeof(size_t));
+        memcpy_safe(mempcpy(data + sizeof(size_t), key, key_size), identity, identity_size);
+
+        ns = open("/proc/self/ns/mnt", O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (ns < 0)
+                return log_debug_errno(errno, "Failed to open mount namespace, not storing it as template: %m"), 0;
+
+        r = mount_namespace_copy(mount_flags);
+        if (r < 0)
+                return r;
+
+        if (incoming_dir && mount(NULL, incoming_dir, NULL, MS_SLAVE, NULL) < 0)
+                return log_debug_errno(errno, "Failed to remount %s with MS_SLAVE: %m", incoming_dir);
+
+        if (lockf(storage_socket[0], F_LOCK, 0) < 0)
+                return log_debug_errno(errno, "Failed to lock mount namespace template storage, ignoring: %m"), 0;
+
+        n = mount_namespace_templates_take(storage_socket[0], templates);
+
+        /* Drop a template with the same key, somebody else was faster. And if we have too many, drop the
+         * least recently used one. */
+        for (size_t i = 0; i < n; i++) {
+                if (mount_namespace_template_has_key(templates + i, key, key_size) ||
+                    (i == 0 && n >= MOUNT_NAMESPACE_TEMPLATES_MAX)) {
+                        mount_namespace_template_done(templates + i);
+                        continue;
+                }
+
+                templates[j++] = templates[i];
+        }
+
+        if (j < MOUNT_NAMESPACE_TEMPLATES_MAX)
+                templates[j++] = (MountNamespaceTemplate) {
+                        .data = TAKE_PTR(data),
+                        .size = size,
+                        .fd = TAKE_FD(ns),
+                };
+
+        mount_namespace_templates_put(storage_socket[1], templates, j);
+        (void) lockf(storage_socket[0], F_ULOCK, 0);
+
+        return 1;
+}
+
 static const char *const protect_home_table[_PROTECT_HOME_MAX] = {
         [PROTECT_HOME_NO]        = "no",
         [PROTECT_HOME_YES]       = "yes",
@@ -156,6 +156,29 @@ int setup_tmp_dirs(
 int setup_shareable_ns(const int ns_storage_socket[static 2], unsigned long nsflag);
 int open_shareable_ns_path(const int netns_storage_socket[static 2], const char *path, unsigned long nsflag);
 
+/* How many mount namespace templates to keep at most, and how large the key and identity describing one may
+ * be together */
+#define MOUNT_NAMESPACE_TEMPLATES_MAX 8U
+#define MOUNT_NAMESPACE_TEMPLATE_KEY_MAX (8U*1024U)
+
+int mount_namespace_template_join(
+                const int storage_socket[static 2],
+                const void *key,
+                size_t key_size,
+                const void *identity,
+                size_t identity_size,
+                unsigned long mount_flags,
+                const char *propagate_dir,
+                const char *incoming_dir);
+int mount_namespace_template_store(
+                const int storage_socket[static 2],
+                const void *key,
+                size_t key_size,
+                const void *identity,
+                size_t identity_size,
+                unsigned long mount_flags,
+                const char *incoming_dir);
+
 const char* protect_home_to_string(ProtectHome p) _const_;
 ProtectHome protect_home_from_string(const char *s) _pure_;
 
@@ -0,0 +1,795 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/epoll.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "chase-symlinks.h"
+#include "errno-util.h"
+#include "fd-util.h"
+#include "glob-util.h"
+#include "hash-funcs.h"
+#include "list.h"
+#include "log.h"
+#include "manager.h"
+#include "missing_fanotify.h"
+#include "mountpoint-util.h"
+#include "path-fanotify.h"
+#include "path-util.h"
+#include "path.h"
+#include "siphash24.h"
+#include "stat-util.h"
+#include "string-table.h"
+#include "string-util.h"
+
+/* Directory entries of watched directories coming and going. That covers watched paths appearing and
+ * disappearing, as well as the directories on the way there. */
+#define PATH_WATCH_EVENTS_BASE (FAN_CREATE|FAN_DELETE|FAN_MOVED_FROM|FAN_MOVED_TO|FAN_DELETE_SELF|FAN_MOVE_SELF)
+
+typedef struct PathWatchFilesystem {
+        Manager *manager;
+        uint64_t fsid;
+        char *path;             /* a directory on the file system, to update the mark with */
+        uint64_t mask;          /* the events currently marked */
+        unsigned n_directories;
+        unsigned n_changed;     /* primary watches of PathChanged= and PathModified= */
+        unsigned n_modified;    /* primary watches of PathModified= */
+} PathWatchFilesystem;
+
+typedef struct PathWatchDirectoryKey {
+        uint64_t fsid;
+        struct file_handle *handle;
+} PathWatchDirectoryKey;
+
+typedef struct PathWatchDirectory {
+        PathWatchDirectoryKey key;
+        PathWatchFilesystem *filesystem;
+        Hashmap *watches_by_name;                 /* entry name → list of PathWatch */
+        LIST_HEAD(PathWatch, watches_other);      /* glob patterns, and watches on all entries */
+} PathWatchDirectory;
+
+struct PathWatch {
+        PathSpec *spec;
+        PathWatchDirectory *directory;
+        char *name;             /* NULL for all entries of the directory, and the directory itself */
+        bool glob;              /* name is a glob pattern */
+        bool primary;           /* refers to the watched path itself, not a directory on the way there */
+        LIST_FIELDS(PathWatch, by_spec);
+        LIST_FIELDS(PathWatch, by_directory);
+};
+
+assert_cc(sizeof(fsid_t) == sizeof(uint64_t));
+
+static uint64_t fsid_to_uint64(const void *fsid) {
+        uint64_t u;
+
+        /* Both the fsid_t of struct statfs and the __kernel_fsid_t in fanotify events are two ints */
+        memcpy(&u, fsid, sizeof(u));
+        return u;
+}
+
+static void path_watch_directory_key_hash_func(const PathWatchDirectoryKey *k, struct siphash *state) {
+        siphash24_compress(&k->fsid, sizeof(k->fsid), state);
+        siphash24_compress(&k->handle->handle_type, sizeof(k->handle->handle_type), state);
+        siphash24_compress(k->handle->f_handle, k->handle->handle_bytes, state);
+}
+
+static int path_watch_directory_key_compare_func(const PathWatchDirectoryKey *x, const PathWatchDirectoryKey *y) {
+        int r;
+
+        r = CMP(x->fsid, y->fsid);
+        if (r != 0)
+                return r;
+
+        r = CMP(x->handle->handle_type, y->handle->handle_type);
+        if (r != 0)
+                return r;
+
+        r = CMP(x->handle->handle_bytes, y->handle->handle_bytes);
+        if (r != 0)
+                return r;
+
+        return memcmp(x->handle->f_handle, y->handle->f_handle, x->handle->handle_bytes);
+}
+
+DEFINE_PRIVATE_HASH_OPS(path_watch_directory_hash_ops, PathWatchDirectoryKey,
+                        path_watch_directory_key_hash_func, path_watch_directory_key_compare_func);
+
+static int path_watch_filesystem_mark(PathWatchFilesystem *fs, unsigned flags, uint64_t mask) {
+        struct statfs sfs;
+
+        assert(fs);
+
+        /* The directory we remembered might have been replaced by a mount point in the meantime */
+        if (statfs(fs->path, &sfs) < 0)
+                return -errno;
+        if (fsid_to_uint64(&sfs.f_fsid) != fs->fsid)
+                return -ESTALE;
+
+        if (fanotify_mark(fs->manager->path_fanotify_fd, flags|FAN_MARK_FILESYSTEM, mask, AT_FDCWD, fs->path) < 0)
+                return -errno;
+
+        return 0;
+}
+
+static int path_watch_filesystem_update(PathWatchFilesystem *fs) {
+        uint64_t mask = 0;
+        int r;
+
+        assert(fs);
+
+        /* CLOSE_WRITE and MODIFY are generated for every write to the file system, hence only ask for them
+         * while somebody is interested. */
+        if (fs->n_directories > 0) {
+                mask = PATH_WATCH_EVENTS_BASE|FAN_ONDIR;
+
+                if (fs->n_changed > 0)
+                        mask |= FAN_ATTRIB|FAN_CLOSE_WRITE;
+                if (fs->n_modified > 0)
+                        mask |= FAN_MODIFY;
+        }
+
+        if (mask & ~fs->mask) {
+                r = path_watch_filesystem_mark(fs, FAN_MARK_ADD, mask & ~fs->mask);
+                if (r < 0)
+                        return r;
+
+                fs->mask |= mask;
+        }
+
+        if (fs->mask & ~mask) {
+                /* Not fatal, we'll just get a few more events than necessary */
+                r = path_watch_filesystem_mark(fs, FAN_MARK_REMOVE, fs->mask & ~mask);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to update fanotify mark of file system of %s, ignoring: %m", fs->path);
+
+                fs->mask = mask;
+        }
+
+        return 0;
+}
+
+static PathWatchFilesystem* path_watch_filesystem_free(PathWatchFilesystem *fs) {
+        if (!fs)
+                return NULL;
+
+        hashmap_remove_value(fs->manager->path_watch_filesystems, &fs->fsid, fs);
+
+        free(fs->path);
+        return mfree(fs);
+}
+
+static int path_watch_filesystem_acquire(Manager *m, uint64_t fsid, const char *path, PathWatchFilesystem **ret) {
+        PathWatchFilesystem *fs;
+        int r;
+
+        assert(m);
+        assert(path);
+        assert(ret);
+
+        fs = hashmap_get(m->path_watch_filesystems, &fsid);
+        if (fs) {
+                /* Keep the most recently seen directory, it's the most likely one to still be around when
+                 * we need to update the mark. */
+                r = free_and_strdup(&fs->path, path);
+                if (r < 0)
+                        return r;
+        } else {
+                _cleanup_free_ char *p = NULL;
+
+                p = strdup(path);
+                if (!p)
+                        return -ENOMEM;
+
+                fs = new(PathWatchFilesystem, 1);
+                if (!fs)
+                        return -ENOMEM;
+
+                *fs = (PathWatchFilesystem) {
+                        .manager = m,
+                        .fsid = fsid,
+                        .path = TAKE_PTR(p),
+                };
+
+                r = hashmap_ensure_put(&m->path_watch_filesystems, &uint64_hash_ops, &fs->fsid, fs);
+                if (r < 0) {
+                        path_watch_filesystem_free(fs);
+                        return r;
+                }
+        }
+
+        fs->n_directories++;
+
+        *ret = fs;
+        return 0;
+}
+
+static void path_watch_filesystem_release(PathWatchFilesystem *fs) {
+        assert(fs);
+        assert(fs->n_directories > 0);
+
+        fs->n_directories--;
+
+        (void) path_watch_filesystem_update(fs);
+
+        if (fs->n_directories == 0)
+                path_watch_filesystem_free(fs);
+}
+
+static PathWatchDirectory* path_watch_directory_free(PathWatchDirectory *d) {
+        if (!d)
+                return NULL;
+
+        assert(hashmap_isempty(d->watches_by_name));
+        assert(!d->watches_other);
+
+        if (d->filesystem) {
+                hashmap_remove_value(d->filesystem->manager->path_watch_directories, &d->key, d);
+                path_watch_filesystem_release(d->filesystem);
+        }
+
+        hashmap_free(d->watches_by_name);
+        free(d->key.handle);
+        return mfree(d);
+}
+
+static void path_watch_directory_release(PathWatchDirectory *d) {
+        assert(d);
+
+        if (hashmap_isempty(d->watches_by_name) && !d->watches_other)
+                path_watch_directory_free(d);
+}
+
+static int path_watch_directory_acquire(Manager *m, const char *path, PathWatchDirectory **ret) {
+        _cleanup_free_ struct file_handle *handle = NULL;
+        PathWatchDirectory *d;
+        struct statfs sfs;
+        int r;
+
+        assert(m);
+        assert(path);
+        assert(ret);
+
+        /* These are the same handles the kernel reports in the events */
+        r = name_to_handle_at_loop(AT_FDCWD, path, &handle, NULL, AT_SYMLINK_FOLLOW);
+        if (r < 0)
+                return r;
+
+        if (statfs(path, &sfs) < 0)
+                return -errno;
+
+        d = hashmap_get(m->path_watch_directories, &(PathWatchDirectoryKey) {
+                                .fsid = fsid_to_uint64(&sfs.f_fsid),
+                                .handle = handle,
+                        });
+        if (d) {
+                *ret = d;
+                return 0;
+        }
+
+        d = new(PathWatchDirectory, 1);
+        if (!d)
+                return -ENOMEM;
+
+        *d = (PathWatchDirectory) {
+                .key.fsid = fsid_to_uint64(&sfs.f_fsid),
+                .key.handle = TAKE_PTR(handle),
+        };
+
+        r = hashmap_ensure_put(&m->path_watch_directories, &path_watch_directory_hash_ops, &d->key, d);
+        if (r < 0) {
+                path_watch_directory_free(d);
+                return r;
+        }
+
+        r = path_watch_filesystem_acquire(m, d->key.fsid, path, &d->filesystem);
+        if (r < 0) {
+                hashmap_remove(m->path_watch_directories, &d->key);
+                path_watch_directory_free(d);
+                return r;
+        }
+
+        *ret = d;
+        return 0;
+}
+
+static PathWatch* path_watch_free(PathWatch *w) {
+        PathWatchDirectory *d;
+        PathWatchFilesystem *fs;
+
+        if (!w)
+                return NULL;
+
+        d = w->directory;
+        fs = d->filesystem;
+
+        LIST_REMOVE(by_spec, w->spec->watches, w);
+
+        if (w->name && !w->glob) {
+                PathWatch *first;
+
+                first = hashmap_get(d->watches_by_name, w->name);
+                LIST_REMOVE(by_directory, first, w);
+
+                /* The key is owned by the first watch of the list, hence replace it too */
+                if (first)
+                        assert_se(hashmap_replace(d->watches_by_name, first->name, first) >= 0);
+                else
+                        hashmap_remove(d->watches_by_name, w->name);
+        } else
+                LIST_REMOVE(by_directory, d->watches_other, w);
+
+        if (w->primary && IN_SET(w->spec->type, PATH_CHANGED, PATH_MODIFIED)) {
+                fs->n_changed--;
+                if (w->spec->type == PATH_MODIFIED)
+                        fs->n_modified--;
+        }
+
+        free(w->name);
+        free(w);
+
+        if (hashmap_isempty(d->watches_by_name) && !d->watches_other)
+                path_watch_directory_free(d);
+        else
+                (void) path_watch_filesystem_update(fs);
+
+        return NULL;
+}
+
+static int path_spec_add_watch(PathSpec *s, const char *directory, const char *name, bool glob, bool primary) {
+        _cleanup_free_ char *n = NULL;
+        PathWatchDirectory *d;
+        PathWatch *w;
+        Manager *m;
+        int r;
+
+        assert(s);
+        assert(s->unit);
+        assert(directory);
+
+        m = s->unit->manager;
+
+        if (name) {
+                n = strdup(name);
+                if (!n)
+                        return -ENOMEM;
+        }
+
+        r = path_watch_directory_acquire(m, directory, &d);
+        if (r < 0)
+                return r;
+
+        w = new(PathWatch, 1);
+        if (!w) {
+                path_watch_directory_release(d);
+                return -ENOMEM;
+        }
+
+        *w = (PathWatch) {
+                .spec = s,
+                .directory = d,
+                .name = TAKE_PTR(n),
+                .glob = glob,
+                .primary = primary,
+        };
+
+        if (w->name && !w->glob) {
+                PathWatch *first;
+
+                r = hashmap_ensure_allocated(&d->watches_by_name, &string_hash_ops);
+                if (r < 0)
+                        goto fail;
+
+                first = hashmap_get(d->watches_by_name, w->name);
+                LIST_PREPEND(by_directory, first, w);
+
+                r = hashmap_replace(d->watches_by_name, first->name, first);
+                if (r < 0) {
+                        LIST_REMOVE(by_directory, first, w);
+                        goto fail;
+                }
+        } else
+                LIST_PREPEND(by_directory, d->watches_other, w);
+
+        LIST_PREPEND(by_spec, s->watches, w);
+
+        if (primary && IN_SET(s->type, PATH_CHANGED, PATH_MODIFIED)) {
+                d->filesystem->n_changed++;
+                if (s->type == PATH_MODIFIED)
+                        d->filesystem->n_modified++;
+        }
+
+        r = path_watch_filesystem_update(d->filesystem);
+        if (r < 0) {
+                path_watch_free(w);
+                return r;
+        }
+
+        return 0;
+
+fail:
+        free(w->name);
+        free(w);
+        path_watch_directory_release(d);
+        return r;
+}
+
+static int manager_dispatch_path_fanotify(sd_event_source *source, int fd, uint32_t revents, void *userdata);
+
+static int manager_setup_path_fanotify(Manager *m) {
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(m);
+
+        if (m->path_fanotify_fd >= 0)
+                return 0;
+
+        /* Reporting directory handles and names requires 5.9, and marking file systems CAP_SYS_ADMIN */
+        fd = fanotify_init(FAN_CLASS_NOTIF|FAN_CLOEXEC|FAN_NONBLOCK|FAN_REPORT_DFID_NAME, O_RDONLY|O_CLOEXEC);
+        if (fd < 0) {
+                r = log_warning_errno(errno, "Failed to allocate fanotify fd, watching paths via inotify instead: %m");
+
+                /* Don't try again for every single path */
+                m->path_watch_backend = PATH_WATCH_INOTIFY;
+                return r;
+        }
+
+        r = sd_event_add_io(m->event, &m->path_fanotify_event_source, fd, EPOLLIN, manager_dispatch_path_fanotify, m);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add fanotify fd to event loop: %m");
+
+        (void) sd_event_source_set_description(m->path_fanotify_event_source, "manager-path-fanotify");
+
+        m->path_fanotify_fd = TAKE_FD(fd);
+        return 0;
+}
+
+void manager_free_path_fanotify(Manager *m) {
+        assert(m);
+
+        /* All path units are gone by now, and so are their watches */
+        assert(hashmap_isempty(m->path_watch_directories));
+        assert(hashmap_isempty(m->path_watch_filesystems));
+
+        m->path_fanotify_event_source = sd_event_source_disable_unref(m->path_fanotify_event_source);
+        m->path_fanotify_fd = safe_close(m->path_fanotify_fd);
+
+        m->path_watch_directories = hashmap_free(m->path_watch_directories);
+        m->path_watch_filesystems = hashmap_free(m->path_watch_filesystems);
+}
+
+static int path_spec_add_target_watch(PathSpec *s, const char *path) {
+        _cleanup_free_ char *target = NULL, *directory = NULL, *name = NULL;
+        struct stat st;
+        int r;
+
+        assert(s);
+        assert(path);
+
+        /* inotify follows a symlink in the last component of the path and watches its target. Events on the
+         * target are reported with the directory and name of the target here, hence watch those too. The
+         * symlink itself is watched already, if it changes we'll set up the watches again. */
+
+        if (lstat(path, &st) < 0)
+                return errno == ENOENT ? 0 : -errno;
+        if (!S_ISLNK(st.st_mode))
+                return 0;
+
+        r = chase_symlinks(path, NULL, CHASE_NONEXISTENT, &target, NULL);
+        if (r < 0)
+                return r;
+
+        r = path_extract_directory(target, &directory);
+        if (r == -EADDRNOTAVAIL) /* Points to the root directory, which is watched via its own handle */
+                return 0;
+        if (r < 0)
+                return r;
+
+        r = path_extract_filename(target, &name);
+        if (r < 0)
+                return r;
+
+        return path_spec_add_watch(s, directory, name, /* glob= */ false, /* primary= */ true);
+}
+
+int path_spec_watch_fanotify(PathSpec *s) {
+        _cleanup_free_ char *directory = NULL;
+        bool complete = false;
+        const char *p;
+        int r;
+
+        assert(s);
+        assert(s->unit);
+
+        r = manager_setup_path_fanotify(s->unit->manager);
+        if (r < 0)
+                return r;
+
+        path_spec_unwatch(s);
+
+        /* Like path_spec_watch() this assumes the path was passed through path_simplify(). Each directory on
+         * the way to the path is watched for the next component only, so that an event is only looked at by
+         * the path units it is relevant for, no matter how many units watch paths in the same directory. */
+        assert(path_is_absolute(s->path));
+
+        directory = strdup("/");
+        if (!directory)
+                return -ENOMEM;
+
+        for (p = s->path;;) {
+                _cleanup_free_ char *name = NULL, *child = NULL;
+                const char *e;
+                bool last, glob;
+
+                r = path_find_first_component(&p, /* accept_dot_dot= */ false, &e);
+                if (r < 0)
+                        goto fail;
+                if (r == 0) {
+                        complete = true;
+                        break;
+                }
+
+                name = strndup(e, r);
+                if (!name) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                last = isempty(p);
+                glob = s->type == PATH_EXISTS_GLOB && string_is_glob(name);
+
+                r = path_spec_add_watch(s, directory, name, glob, /* primary= */ last);
+                if (IN_SET(r, -ENOENT, -ENOTDIR, -EACCES))
+                        break; /* Vanished in the meantime, we have an incomplete watch for now */
+                if (r < 0)
+                        goto fail;
+
+                /* Like with inotify, we cannot follow patterns further down, we'll see them appear only */
+                if (glob)
+                        break;
+
+                child = path_join(directory, name);
+                if (!child) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                free_and_replace(directory, child);
+
+                if (last) {
+                        r = path_spec_add_target_watch(s, directory);
+                        if (r < 0 && !IN_SET(r, -ENOENT, -ENOTDIR, -EACCES))
+                                goto fail;
+                }
+
+                /* Path doesn't exist (yet), we'll get an event when it appears */
+                if (!last && is_dir(directory, /* follow= */ true) <= 0)
+                        break;
+        }
+
+        /* Events on the entries of the watched directory itself are reported with the directory's own
+         * handle, as are attribute changes, deletion and moving of the directory. */
+        if (complete &&
+            IN_SET(s->type, PATH_DIRECTORY_NOT_EMPTY, PATH_CHANGED, PATH_MODIFIED) &&
+            is_dir(directory, /* follow= */ true) > 0) {
+                r = path_spec_add_watch(s, directory, NULL, /* glob= */ false, /* primary= */ true);
+                if (r < 0 && !IN_SET(r, -ENOENT, -ENOTDIR, -EACCES))
+                        goto fail;
+        }
+
+        return 0;
+
+fail:
+        path_spec_unwatch_fanotify(s);
+        return r;
+}
+
+void path_spec_unwatch_fanotify(PathSpec *s) {
+        assert(s);
+
+        while (s->watches)
+                path_watch_free(s->watches);
+}
+
+static int path_watch_queue(PathWatch *w, uint64_t mask, Hashmap **pending) {
+        static const uint64_t events_table[_PATH_TYPE_MAX] = {
+                [PATH_EXISTS]              = PATH_WATCH_EVENTS_BASE,
+                [PATH_EXISTS_GLOB]         = PATH_WATCH_EVENTS_BASE,
+                [PATH_DIRECTORY_NOT_EMPTY] = PATH_WATCH_EVENTS_BASE,
+                [PATH_CHANGED]             = PATH_WATCH_EVENTS_BASE|FAN_ATTRIB|FAN_CLOSE_WRITE,
+                [PATH_MODIFIED]            = PATH_WATCH_EVENTS_BASE|FAN_ATTRIB|FAN_CLOSE_WRITE|FAN_MODIFY,
+        };
+
+        PathSpec *s;
+        Path *p;
+        bool changed;
+        int r;
+
+        assert(w);
+        assert(pending);
+
+        s = w->spec;
+        p = PATH(s->unit);
+
+        if (!(mask & (w->primary ? events_table[s->type] : PATH_WATCH_EVENTS_BASE)))
+                return 0;
+
+        /* Remember per unit whether a path changed, or whether it just needs to check its paths again */
+        changed = w->primary && IN_SET(s->type, PATH_CHANGED, PATH_MODIFIED);
+        if (hashmap_get(*pending, p) || (!changed && hashmap_contains(*pending, p)))
+                return 0;
+
+        r = hashmap_ensure_allocated(pending, NULL);
+        if (r < 0)
+                return r;
+
+        return hashmap_replace(*pending, p, changed ? s : NULL);
+}
+
+static int path_watch_directory_dispatch(PathWatchDirectory *d, const char *name, uint64_t mask, Hashmap **pending) {
+        int r;
+
+        assert(d);
+        assert(name);
+        assert(pending);
+
+        /* Events on the directory itself are reported with the name "." */
+        if (!streq(name, "."))
+                LIST_FOREACH(by_directory, w, (PathWatch*) hashmap_get(d->watches_by_name, name)) {
+                        r = path_watch_queue(w, mask, pending);
+                        if (r < 0)
+                                return r;
+                }
+
+        LIST_FOREACH(by_directory, w, d->watches_other) {
+                if (w->glob && (streq(name, ".") || fnmatch(w->name, name, 0) != 0))
+                        continue;
+
+                r = path_watch_queue(w, mask, pending);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int manager_queue_all_path_watches(Manager *m, Hashmap **pending) {
+        PathWatchDirectory *d;
+        PathWatch *first;
+        int r;
+
+        assert(m);
+        assert(pending);
+
+        HASHMAP_FOREACH(d, m->path_watch_directories) {
+                HASHMAP_FOREACH(first, d->watches_by_name)
+                        LIST_FOREACH(by_directory, w, first) {
+                                r = path_watch_queue(w, PATH_WATCH_EVENTS_BASE, pending);
+                                if (r < 0)
+                                        return r;
+                        }
+
+                LIST_FOREACH(by_directory, w, d->watches_other) {
+                        r = path_watch_queue(w, PATH_WATCH_EVENTS_BASE, pending);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+static const struct fanotify_event_info_fid* fanotify_event_find_dfid_name(const struct fanotify_event_metadata *e) {
+        assert(e);
+
+        for (size_t i = e->metadata_len; i + sizeof(struct fanotify_event_info_header) <= e->event_len;) {
+                const struct fanotify_event_info_header *h = (const void*) ((const uint8_t*) e + i);
+                const struct fanotify_event_info_fid *fid = (const void*) h;
+                const struct file_handle *handle;
+
+                if (h->len < sizeof(*h) || h->len > e->event_len - i)
+                        break;
+
+                i += h->len;
+
+                if (h->info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+                        continue;
+
+                if (h->len < sizeof(*fid) + sizeof(struct file_handle))
+                        break;
+
+                handle = (const struct file_handle*) fid->handle;
+                if (h->len <= sizeof(*fid) + sizeof(struct file_handle) + handle->handle_bytes)
+                        break;
+
+                return fid;
+        }
+
+        return NULL;
+}
+
+static int manager_dispatch_path_fanotify(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        _cleanup_hashmap_free_ Hashmap *pending = NULL;
+        Manager *m = ASSERT_PTR(userdata);
+        union {
+                struct fanotify_event_metadata metadata;
+                uint8_t raw[4096];
+        } buffer;
+        bool overflow = false;
+        PathSpec *changed;
+        Path *p;
+        ssize_t l;
+        int r;
+
+        assert(fd == m->path_fanotify_fd);
+
+        l = read(fd, &buffer, sizeof(buffer));
+        if (l < 0) {
+                if (ERRNO_IS_TRANSIENT(errno))
+                        return 0;
+
+                return log_error_errno(errno, "Failed to read fanotify event: %m");
+        }
+
+        for (struct fanotify_event_metadata *e = &buffer.metadata; FAN_EVENT_OK(e, l); e = FAN_EVENT_NEXT(e, l)) {
+                const struct fanotify_event_info_fid *fid;
+                const struct file_handle *handle;
+                PathWatchDirectory *d;
+
+                if (e->vers != FANOTIFY_METADATA_VERSION) {
+                        log_warning("Got fanotify event of unexpected version %u, ignoring.", e->vers);
+                        continue;
+                }
+
+                /* We only ever get file handles, but let's be extra careful */
+                if (e->fd >= 0)
+                        safe_close(e->fd);
+
+                if (FLAGS_SET(e->mask, FAN_Q_OVERFLOW)) {
+                        overflow = true;
+                        continue;
+                }
+
+                fid = fanotify_event_find_dfid_name(e);
+                if (!fid)
+                        continue;
+
+                handle = (const struct file_handle*) fid->handle;
+
+                d = hashmap_get(m->path_watch_directories, &(PathWatchDirectoryKey) {
+                                        .fsid = fsid_to_uint64(&fid->fsid),
+                                        .handle = (struct file_handle*) handle,
+                                });
+                if (!d)
+                        continue;
+
+                r = path_watch_directory_dispatch(d, (const char*) handle->f_handle + handle->handle_bytes, e->mask, &pending);
+                if (r < 0)
+                        log_oom();
+        }
+
+        /* We lost events, hence all units have to check their paths again */
+        if (overflow) {
+                log_debug("fanotify event queue overflowed, checking all watched paths.");
+
+                r = manager_queue_all_path_watches(m, &pending);
+                if (r < 0)
+                        log_oom();
+        }
+
+        HASHMAP_FOREACH_KEY(changed, p, pending)
+                path_dispatch_watch_event(p, changed);
+
+        return 0;
+}
+
+static const char* const path_watch_backend_table[_PATH_WATCH_BACKEND_MAX] = {
+        [PATH_WATCH_INOTIFY]  = "inotify",
+        [PATH_WATCH_FANOTIFY] = "fanotify",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(path_watch_backend, PathWatchBackend);
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <errno.h>
+
+#include "macro.h"
+
+typedef struct Manager Manager;
+typedef struct PathSpec PathSpec;
+typedef struct PathWatch PathWatch;
+
+/* With PathWatchBackend=fanotify path units don't allocate an inotify instance each, with a watch on each
+ * component of their paths. Instead, the manager marks each file system the watched paths are on once, on a
+ * single fanotify instance reporting the directory and name of each event (FAN_REPORT_DFID_NAME), and looks
+ * up the path units an event is relevant for in an index of the watched directory entries. Paths on file
+ * systems that don't support this are still watched via inotify. */
+
+typedef enum PathWatchBackend {
+        PATH_WATCH_INOTIFY,
+        PATH_WATCH_FANOTIFY,
+        _PATH_WATCH_BACKEND_MAX,
+        _PATH_WATCH_BACKEND_INVALID = -EINVAL,
+} PathWatchBackend;
+
+int path_spec_watch_fanotify(PathSpec *s);
+void path_spec_unwatch_fanotify(PathSpec *s);
+
+void manager_free_path_fanotify(Manager *m);
+
+const char* path_watch_backend_to_string(PathWatchBackend b) _const_;
+PathWatchBackend path_watch_backend_from_string(const char *s) _pure_;
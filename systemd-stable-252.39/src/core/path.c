@@ -16,6 +16,7 @@
 #include "inotify-util.h"
 #include "macro.h"
 #include "mkdir-label.h"
+#include "path-fanotify.h"
 #include "path.h"
 #include "path-util.h"
 #include "serialize.h"
@@ -170,6 +171,8 @@ void path_spec_unwatch(PathSpec *s) {
 
         s->event_source = sd_event_source_disable_unref(s->event_source);
         s->inotify_fd = safe_close(s->inotify_fd);
+
+        path_spec_unwatch_fanotify(s);
 }
 
 int path_spec_fd_event(PathSpec *s, uint32_t revents) {
@@ -267,6 +270,7 @@ static void path_spec_dump(PathSpec *s, FILE *f, const char *prefix) {
 void path_spec_done(PathSpec *s) {
         assert(s);
         assert(s->inotify_fd == -1);
+        assert(!s->watches);
 
         free(s->path);
 }
@@ -453,6 +457,14 @@ static int path_watch(Path *p) {
         assert(p);
 
         LIST_FOREACH(spec, s, p->specs) {
+                if (UNIT(p)->manager->path_watch_backend == PATH_WATCH_FANOTIFY) {
+                        r = path_spec_watch_fanotify(s);
+                        if (r >= 0)
+                                continue;
+
+                        log_unit_debug_errno(UNIT(p), r, "Failed to watch %s via fanotify, falling back to inotify: %m", s->path);
+                }
+
                 r = path_spec_watch(s, path_dispatch_io);
                 if (r < 0)
                         return r;
@@ -792,11 +804,7 @@ static int path_dispatch_io(sd_event_source *source, int fd, uint32_t revents, v
         if (changed < 0)
                 goto fail;
 
-        if (changed)
-                path_enter_running(p, found->path);
-        else
-                path_enter_waiting(p, false, false);
-
+        path_dispatch_watch_event(p, changed ? found : NULL);
         return 0;
 
 fail:
@@ -804,6 +812,20 @@ fail:
         return 0;
 }
 
+void path_dispatch_watch_event(Path *p, PathSpec *changed) {
+        assert(p);
+
+        /* Called with the spec whose path changed, or NULL if the paths merely need to be checked again */
+
+        if (!IN_SET(p->state, PATH_WAITING, PATH_RUNNING))
+                return;
+
+        if (changed)
+                path_enter_running(p, changed->path);
+        else
+                path_enter_waiting(p, false, false);
+}
+
 static void path_trigger_notify_impl(Unit *u, Unit *other, bool on_defer);
 
 static int path_trigger_notify_on_defer(sd_event_source *s, void *userdata) {
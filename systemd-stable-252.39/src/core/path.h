@@ -30,6 +30,9 @@ typedef struct PathSpec {
         int inotify_fd;
         int primary_wd;
 
+        /* The entries watched via the manager's fanotify instance instead, see path-fanotify.c */
+        LIST_HEAD(PathWatch, watches);
+
         bool previous_exists;
 } PathSpec;
 
@@ -75,6 +78,7 @@ struct ActivationDetailsPath {
 };
 
 void path_free_specs(Path *p);
+void path_dispatch_watch_event(Path *p, PathSpec *changed);
 
 extern const UnitVTable path_vtable;
 extern const ActivationDetailsVTable activation_details_path_vtable;
@@ -9,6 +9,7 @@
 
 #include "alloc-util.h"
 #include "async.h"
+#include "boot-trace.h"
 #include "bus-error.h"
 #include "bus-kernel.h"
 #include "bus-util.h"
@@ -113,6 +114,7 @@ static void service_init(Unit *u) {
         s->runtime_max_usec = USEC_INFINITY;
         s->type = _SERVICE_TYPE_INVALID;
         s->socket_fd = -1;
+        s->socket_pool_fd = -1;
         s->stdin_fd = s->stdout_fd = s->stderr_fd = -1;
         s->guess_main_pid = true;
 
@@ -189,10 +191,17 @@ void service_close_socket_fd(Service *s) {
         s->socket_fd = asynchronous_close(s->socket_fd);
 
         if (UNIT_ISSET(s->accept_socket)) {
-                socket_connection_unref(SOCKET(UNIT_DEREF(s->accept_socket)));
+                /* Idle pooled instances are not counted as connections */
+                if (s->socket_pool_fd >= 0)
+                        socket_pool_remove(SOCKET(UNIT_DEREF(s->accept_socket)), s);
+                else
+                        socket_connection_unref(SOCKET(UNIT_DEREF(s->accept_socket)));
+
                 unit_ref_unset(&s->accept_socket);
         }
 
+        s->socket_pool_fd = safe_close(s->socket_pool_fd);
+
         s->socket_peer = socket_peer_unref(s->socket_peer);
 }
 
@@ -806,6 +815,71 @@ static int service_load(Unit *u) {
         return service_verify(s);
 }
 
+static int service_compact(Unit *u) {
+        Service *s = SERVICE(u);
+
+        assert(s);
+
+        /* Not while we are about to restart, or are still holding on to anything from the last run */
+        if (!IN_SET(s->state, SERVICE_DEAD, SERVICE_FAILED))
+                return 0;
+
+        if (s->exec_runtime ||
+            s->main_pid > 0 ||
+            s->control_pid > 0 ||
+            s->n_fd_store > 0 ||
+            s->socket_fd >= 0 ||
+            UNIT_ISSET(s->accept_socket) ||
+            s->dynamic_creds.user ||
+            s->dynamic_creds.group)
+                return 0;
+
+        /* The exit statuses of the commands are shown until the next run, and would be lost with them */
+        for (ServiceExecCommand c = 0; c < _SERVICE_EXEC_COMMAND_MAX; c++)
+                LIST_FOREACH(command, command, s->exec_command[c])
+                        if (dual_timestamp_is_set(&command->exec_status.start_timestamp))
+                                return 0;
+
+        exec_command_free_array(s->exec_command, _SERVICE_EXEC_COMMAND_MAX);
+        s->control_command = NULL;
+        s->main_command = NULL;
+
+        s->pid_file = mfree(s->pid_file);
+        s->usb_function_descriptors = mfree(s->usb_function_descriptors);
+        s->usb_function_strings = mfree(s->usb_function_strings);
+
+        return 1;
+}
+
+static int service_expand(Unit *u) {
+        Service *s = SERVICE(u);
+        char *bus_name;
+        int r;
+
+        assert(s);
+
+        s->exec_context.keyring_mode = MANAGER_IS_SYSTEM(u->manager) ?
+                EXEC_KEYRING_PRIVATE : EXEC_KEYRING_INHERIT;
+
+        /* The bus name is watched under the string we were loaded with, hence stick to that one */
+        bus_name = TAKE_PTR(s->bus_name);
+        r = unit_load_fragment_private_section(u, u->compacted_files);
+        free_and_replace(s->bus_name, bus_name);
+        if (r < 0)
+                return r;
+
+        /* Redo what service_add_extras() derived from the settings we just read */
+        service_fix_stdio(s);
+
+        r = unit_patch_contexts(u);
+        if (r < 0)
+                return r;
+
+        s->cgroup_context.memory_oom_group = s->oom_policy == OOM_KILL;
+
+        return service_verify(s);
+}
+
 static void service_dump(Unit *u, FILE *f, const char *prefix) {
         ServiceExecCommand c;
         Service *s = SERVICE(u);
@@ -901,17 +975,21 @@ static void service_dump(Unit *u, FILE *f, const char *prefix) {
                 prefix, FORMAT_TIMESPAN(s->watchdog_usec, USEC_PER_SEC));
 
         kill_context_dump(&s->kill_context, f, prefix);
-        exec_context_dump(&s->exec_context, f, prefix);
 
-        for (c = 0; c < _SERVICE_EXEC_COMMAND_MAX; c++) {
+        /* The settings of compacted units are gone, don't read them back in just for showing them */
+        if (!u->compacted) {
+                exec_context_dump(&s->exec_context, f, prefix);
 
-                if (!s->exec_command[c])
-                        continue;
+                for (c = 0; c < _SERVICE_EXEC_COMMAND_MAX; c++) {
 
-                fprintf(f, "%s-> %s:\n",
-                        prefix, service_exec_command_to_string(c));
+                        if (!s->exec_command[c])
+                                continue;
+
+                        fprintf(f, "%s-> %s:\n",
+                                prefix, service_exec_command_to_string(c));
 
-                exec_command_dump_list(s->exec_command[c], f, prefix2);
+                        exec_command_dump_list(s->exec_command[c], f, prefix2);
+                }
         }
 
         if (s->status_text)
@@ -925,7 +1003,8 @@ static void service_dump(Unit *u, FILE *f, const char *prefix) {
                         prefix, s->n_fd_store_max,
                         prefix, s->n_fd_store);
 
-        cgroup_context_dump(UNIT(s), f, prefix);
+        if (!u->compacted)
+                cgroup_context_dump(UNIT(s), f, prefix);
 }
 
 static int service_is_suitable_main_pid(Service *s, pid_t pid, int prio) {
@@ -3531,6 +3610,9 @@ static void service_sigchld_event(Unit *u, pid_t pid, int code, int status) {
 
                 s->main_pid = 0;
                 exec_status_exit(&s->main_exec_status, &s->exec_context, pid, code, status);
+                boot_trace_record(u->manager->boot_trace, u->id, service_exec_command_to_string(SERVICE_EXEC_START), pid,
+                                  s->main_exec_status.start_timestamp.monotonic,
+                                  s->main_exec_status.exit_timestamp.monotonic);
 
                 if (s->main_command) {
                         /* If this is not a forking service than the
@@ -3668,6 +3750,10 @@ static void service_sigchld_event(Unit *u, pid_t pid, int code, int status) {
 
                 if (s->control_command) {
                         exec_status_exit(&s->control_command->exec_status, &s->exec_context, pid, code, status);
+                        boot_trace_record(u->manager->boot_trace, u->id,
+                                          service_exec_command_to_string(s->control_command_id), pid,
+                                          s->control_command->exec_status.start_timestamp.monotonic,
+                                          s->control_command->exec_status.exit_timestamp.monotonic);
 
                         if (s->control_command->flags & EXEC_COMMAND_IGNORE_FAILURE)
                                 f = SERVICE_SUCCESS;
@@ -4432,22 +4518,41 @@ static void service_bus_name_owner_change(Unit *u, const char *new_owner) {
         }
 }
 
-int service_set_socket_fd(
+static int service_set_description_from_peer(Service *s, int fd) {
+        _cleanup_free_ char *peer_text = NULL;
+
+        assert(s);
+        assert(fd >= 0);
+
+        if (getpeername_pretty(fd, true, &peer_text) < 0)
+                return 0;
+
+        if (UNIT(s)->description) {
+                _cleanup_free_ char *a = NULL;
+
+                a = strjoin(UNIT(s)->description, " (", peer_text, ")");
+                if (!a)
+                        return -ENOMEM;
+
+                return unit_set_description(UNIT(s), a);
+        }
+
+        return unit_set_description(UNIT(s), peer_text);
+}
+
+static int service_attach_socket_fd(
                 Service *s,
                 int fd,
                 Socket *sock,
                 SocketPeer *peer,
-                bool selinux_context_net) {
+                bool selinux_context_net,
+                bool describe) {
 
-        _cleanup_free_ char *peer_text = NULL;
         int r;
 
         assert(s);
         assert(fd >= 0);
 
-        /* This is called by the socket code when instantiating a new service for a stream socket and the socket needs
-         * to be configured. We take ownership of the passed fd on success. */
-
         if (UNIT(s)->load_state != UNIT_LOADED)
                 return -EINVAL;
 
@@ -4459,18 +4564,8 @@ int service_set_socket_fd(
         if (s->state != SERVICE_DEAD)
                 return -EAGAIN;
 
-        if (getpeername_pretty(fd, true, &peer_text) >= 0) {
-
-                if (UNIT(s)->description) {
-                        _cleanup_free_ char *a = NULL;
-
-                        a = strjoin(UNIT(s)->description, " (", peer_text, ")");
-                        if (!a)
-                                return -ENOMEM;
-
-                        r = unit_set_description(UNIT(s), a);
-                }  else
-                        r = unit_set_description(UNIT(s), peer_text);
+        if (describe) {
+                r = service_set_description_from_peer(s, fd);
                 if (r < 0)
                         return r;
         }
@@ -4487,6 +4582,66 @@ int service_set_socket_fd(
         return 0;
 }
 
+int service_set_socket_fd(
+                Service *s,
+                int fd,
+                Socket *sock,
+                SocketPeer *peer,
+                bool selinux_context_net) {
+
+        /* This is called by the socket code when instantiating a new service for a stream socket and the socket needs
+         * to be configured. We take ownership of the passed fd on success. */
+
+        return service_attach_socket_fd(s, fd, sock, peer, selinux_context_net, /* describe= */ true);
+}
+
+int service_set_socket_pool_fd(Service *s, int fd, int pool_fd, Socket *sock) {
+        int r;
+
+        assert(s);
+        assert(pool_fd >= 0);
+        assert(sock);
+
+        /* This is called by the socket code when spawning an idle instance for AcceptPool=. The instance
+         * gets one end of a socket pair instead of the connection socket, and is passed the connection
+         * socket over it once there is one. We take ownership of both fds on success. */
+
+        r = service_attach_socket_fd(s, fd, sock, NULL, false, /* describe= */ false);
+        if (r < 0)
+                return r;
+
+        s->socket_pool_fd = pool_fd;
+        socket_pool_add(sock, s);
+
+        return 0;
+}
+
+int service_hand_over_connection(Service *s, int cfd, SocketPeer *peer) {
+        int r;
+
+        assert(s);
+        assert(s->socket_pool_fd >= 0);
+        assert(cfd >= 0);
+
+        /* Passes the connection socket to an idle pooled instance. From now on the instance is a regular
+         * per-connection instance, which is counted as a connection. The caller keeps ownership of cfd,
+         * the instance got its own copy of it. */
+
+        r = send_one_fd(s->socket_pool_fd, cfd, MSG_DONTWAIT|MSG_NOSIGNAL);
+        if (r < 0)
+                return r;
+
+        socket_pool_remove(SOCKET(UNIT_DEREF(s->accept_socket)), s);
+
+        /* Closing our end makes sure the instance sees EOF once it received the connection */
+        s->socket_pool_fd = safe_close(s->socket_pool_fd);
+        s->socket_peer = socket_peer_ref(peer);
+
+        (void) service_set_description_from_peer(s, cfd);
+
+        return 0;
+}
+
 static void service_reset_failed(Unit *u) {
         Service *s = SERVICE(u);
 
@@ -4763,6 +4918,8 @@ const UnitVTable service_vtable = {
         .init = service_init,
         .done = service_done,
         .load = service_load,
+        .compact = service_compact,
+        .expand = service_expand,
         .release_resources = service_release_resources,
 
         .coldplug = service_coldplug,
@@ -164,6 +164,11 @@ struct Service {
         UnitRef accept_socket;
         bool socket_fd_selinux_context_net;
 
+        /* If we are an idle instance in the AcceptPool= of the socket, our end of the socket pair the
+         * connection will be passed over */
+        int socket_pool_fd;
+        LIST_FIELDS(Service, socket_pool);
+
         bool permissions_start_only;
         bool root_directory_start_only;
         bool remain_after_exit;
@@ -230,6 +235,8 @@ static inline usec_t service_get_watchdog_usec(Service *s) {
 extern const UnitVTable service_vtable;
 
 int service_set_socket_fd(Service *s, int fd, struct Socket *socket, struct SocketPeer *peer, bool selinux_context_net);
+int service_set_socket_pool_fd(Service *s, int fd, int pool_fd, struct Socket *socket);
+int service_hand_over_connection(Service *s, int cfd, struct SocketPeer *peer);
 void service_close_socket_fd(Service *s);
 
 const char* service_restart_to_string(ServiceRestart i) _const_;
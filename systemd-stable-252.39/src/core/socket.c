@@ -152,6 +152,10 @@ static void socket_done(Unit *u) {
 
         socket_free_ports(s);
 
+        /* Let the idle pooled instances forget about us */
+        while (s->pool)
+                service_close_socket_fd(s->pool);
+
         while ((p = set_steal_first(s->peers_by_address)))
                 p->socket = NULL;
 
@@ -417,6 +421,9 @@ static int socket_verify(Socket *s) {
         if (s->accept && UNIT_DEREF(s->service))
                 return log_unit_error_errno(UNIT(s), SYNTHETIC_ERRNO(ENOEXEC), "Explicit service configuration for accepting socket units not supported. Refusing.");
 
+        if (s->accept && s->accept_pool > 0 && s->selinux_context_from_net)
+                return log_unit_error_errno(UNIT(s), SYNTHETIC_ERRNO(ENOEXEC), "AcceptPool= cannot be used together with SELinuxContextFromNet=. Refusing.");
+
         if (s->exec_context.pam_name && s->kill_context.kill_mode != KILL_CONTROL_GROUP)
                 return log_unit_error_errno(UNIT(s), SYNTHETIC_ERRNO(ENOEXEC), "Unit has PAM enabled. Kill mode must be set to 'control-group'. Refusing.");
 
@@ -638,11 +645,15 @@ static void socket_dump(Unit *u, FILE *f, const char *prefix) {
                         "%sAccepted: %u\n"
                         "%sNConnections: %u\n"
                         "%sMaxConnections: %u\n"
-                        "%sMaxConnectionsPerSource: %u\n",
+                        "%sMaxConnectionsPerSource: %u\n"
+                        "%sAcceptPool: %u\n"
+                        "%sNPooled: %u\n",
                         prefix, s->n_accepted,
                         prefix, s->n_connections,
                         prefix, s->max_connections,
-                        prefix, s->max_connections_per_source);
+                        prefix, s->max_connections_per_source,
+                        prefix, s->accept_pool,
+                        prefix, s->n_pool);
         else
                 fprintf(f,
                         "%sFlushPending: %s\n",
@@ -1801,6 +1812,144 @@ static int socket_check_open(Socket *s) {
         return SOCKET_OPEN_NONE;
 }
 
+void socket_pool_add(Socket *s, Service *service) {
+        assert(s);
+        assert(service);
+
+        /* Keep the oldest instances first, they are the most likely ones to be ready */
+        LIST_APPEND(socket_pool, s->pool, service);
+        s->n_pool++;
+}
+
+void socket_pool_remove(Socket *s, Service *service) {
+        assert(s);
+        assert(service);
+        assert(s->n_pool > 0);
+
+        LIST_REMOVE(socket_pool, s->pool, service);
+        s->n_pool--;
+}
+
+static int socket_pool_spawn_one(Socket *s) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ char *prefix = NULL;
+        int r;
+
+        assert(s);
+
+        r = unit_name_to_prefix(UNIT(s)->id, &prefix);
+        if (r < 0)
+                return r;
+
+        /* The counter is not serialized, hence after a daemon reexec we might run into instances that are
+         * still around from earlier. Skip over them. */
+        for (unsigned attempt = 0;; attempt++) {
+                _cleanup_close_pair_ int pair[2] = { -1, -1 };
+                _cleanup_free_ char *instance = NULL, *name = NULL;
+                Unit *service;
+
+                if (asprintf(&instance, "pool-%u", s->n_pool_spawned++) < 0)
+                        return -ENOMEM;
+
+                r = unit_name_build(prefix, instance, ".service", &name);
+                if (r < 0)
+                        return r;
+
+                r = manager_load_unit(UNIT(s)->manager, name, NULL, NULL, &service);
+                if (r < 0)
+                        return r;
+
+                r = unit_add_two_dependencies(UNIT(s), UNIT_BEFORE, UNIT_TRIGGERS, service,
+                                              false, UNIT_DEPENDENCY_IMPLICIT);
+                if (r < 0)
+                        return r;
+
+                if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, pair) < 0)
+                        return -errno;
+
+                r = service_set_socket_pool_fd(SERVICE(service), pair[1], pair[0], s);
+                if (IN_SET(r, -EBUSY, -EAGAIN) && attempt < 16)
+                        continue;
+                if (r < 0)
+                        return r;
+
+                TAKE_FD(pair[0]);
+                TAKE_FD(pair[1]);
+
+                r = manager_add_job(UNIT(s)->manager, JOB_START, service, JOB_REPLACE, NULL, &error, NULL);
+                if (r < 0) {
+                        service_close_socket_fd(SERVICE(service));
+                        return log_unit_debug_errno(UNIT(s), r, "Failed to queue start job for %s: %s",
+                                                    service->id, bus_error_message(&error, r));
+                }
+
+                return 0;
+        }
+}
+
+static void socket_pool_fill(Socket *s) {
+        int r;
+
+        assert(s);
+
+        /* Spawns idle instances until AcceptPool= is reached. The pool is merely an optimization: if it is
+         * empty when a connection comes in, we spawn an instance for it as usual. */
+
+        if (!s->accept || s->accept_pool <= 0)
+                return;
+
+        if (!IN_SET(s->state, SOCKET_LISTENING, SOCKET_RUNNING) || unit_stop_pending(UNIT(s)))
+                return;
+
+        while (s->n_pool < s->accept_pool) {
+                r = socket_pool_spawn_one(s);
+                if (r < 0) {
+                        log_unit_warning_errno(UNIT(s), r, "Failed to spawn pooled service instance, not filling pool: %m");
+                        return;
+                }
+        }
+}
+
+static void socket_pool_flush(Socket *s) {
+        assert(s);
+
+        /* The idle instances see EOF on their end of the socket pair now, and are expected to exit, but
+         * let's stop them explicitly too. */
+
+        while (s->pool) {
+                Service *service = s->pool;
+
+                service_close_socket_fd(service);
+                (void) manager_add_job(UNIT(s)->manager, JOB_STOP, UNIT(service), JOB_REPLACE, NULL, NULL, NULL);
+        }
+}
+
+static int socket_pool_hand_over(Socket *s, int cfd, SocketPeer *p) {
+        int r;
+
+        assert(s);
+        assert(cfd >= 0);
+
+        /* Returns > 0 if the connection was passed to an idle instance, 0 if there was none ready */
+
+        LIST_FOREACH(socket_pool, service, s->pool) {
+                /* Only instances that finished starting up, i.e. sent READY=1 if Type=notify */
+                if (service->state != SERVICE_RUNNING)
+                        continue;
+
+                r = service_hand_over_connection(service, cfd, p);
+                if (r < 0) {
+                        log_unit_debug_errno(UNIT(service), r, "Failed to hand over connection, trying next instance: %m");
+                        continue;
+                }
+
+                log_unit_debug(UNIT(s), "Handed over connection to %s, %u idle instances left.", UNIT(service)->id, s->n_pool);
+                return 1;
+        }
+
+        return 0;
+}
+
 static void socket_set_state(Socket *s, SocketState state) {
         SocketState old_state;
         assert(s);
@@ -1832,6 +1981,9 @@ static void socket_set_state(Socket *s, SocketState state) {
         if (state != SOCKET_LISTENING)
                 socket_unwatch_fds(s);
 
+        if (!IN_SET(state, SOCKET_LISTENING, SOCKET_RUNNING))
+                socket_pool_flush(s);
+
         if (!IN_SET(state,
                     SOCKET_START_CHOWN,
                     SOCKET_START_POST,
@@ -1921,6 +2073,16 @@ static int socket_coldplug(Unit *u) {
         return 0;
 }
 
+static void socket_catchup(Unit *u) {
+        Socket *s = SOCKET(u);
+
+        assert(s);
+
+        /* The pool is not serialized, the idle instances from before the reload saw EOF and are on their way
+         * out. Jobs cannot be enqueued from coldplug(), hence refill the pool only now. */
+        socket_pool_fill(s);
+}
+
 static int socket_spawn(Socket *s, ExecCommand *c, pid_t *_pid) {
 
         _cleanup_(exec_params_clear) ExecParameters exec_params = {
@@ -2190,6 +2352,7 @@ static void socket_enter_listening(Socket *s) {
         }
 
         socket_set_state(s, SOCKET_LISTENING);
+        socket_pool_fill(s);
         return;
 
 fail:
@@ -2383,6 +2546,16 @@ static void socket_enter_running(Socket *s, int cfd_in) {
                         }
                 }
 
+                r = socket_pool_hand_over(s, cfd, p);
+                if (r > 0) {
+                        s->n_accepted++;
+                        s->n_connections++;
+
+                        socket_pool_fill(s);
+                        unit_add_to_dbus_queue(UNIT(s));
+                        return;
+                }
+
                 r = socket_load_service_unit(s, cfd, &service);
                 if (ERRNO_IS_DISCONNECT(r))
                         return;
@@ -2413,6 +2586,10 @@ static void socket_enter_running(Socket *s, int cfd_in) {
                         goto fail;
                 }
 
+                /* The pool might have been empty because instances are still starting up, or because some
+                 * of them went away, make sure it's refilled in either case. */
+                socket_pool_fill(s);
+
                 /* Notify clients about changed counters */
                 unit_add_to_dbus_queue(UNIT(s));
         }
@@ -3497,6 +3674,7 @@ const UnitVTable socket_vtable = {
         .load = socket_load,
 
         .coldplug = socket_coldplug,
+        .catchup = socket_catchup,
 
         .dump = socket_dump,
 
@@ -3,6 +3,7 @@
 
 typedef struct Socket Socket;
 typedef struct SocketPeer SocketPeer;
+typedef struct Service Service;
 
 #include "mount.h"
 #include "socket-util.h"
@@ -78,6 +79,12 @@ struct Socket {
         unsigned max_connections;
         unsigned max_connections_per_source;
 
+        /* Idle service instances kept around for Accept=yes sockets, to which we hand over connections */
+        unsigned accept_pool;
+        unsigned n_pool;
+        unsigned n_pool_spawned;
+        LIST_HEAD(Service, pool);
+
         unsigned backlog;
         unsigned keep_alive_cnt;
         usec_t timeout_usec;
@@ -173,6 +180,10 @@ int socket_collect_fds(Socket *s, int **fds);
 /* Called from the service code when a per-connection service ended */
 void socket_connection_unref(Socket *s);
 
+/* Called from the service code when an instance joins or leaves the pool of idle instances */
+void socket_pool_add(Socket *s, Service *service);
+void socket_pool_remove(Socket *s, Service *service);
+
 SocketPort *socket_port_free(SocketPort *p);
 DEFINE_TRIVIAL_CLEANUP_FUNC(SocketPort*, socket_port_free);
 
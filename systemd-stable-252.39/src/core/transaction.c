@@ -347,158 +347,462 @@ static char* merge_unit_ids(const char* unit_log_field, char * const* pairs) {
         return TAKE_PTR(ans);
 }
 
-static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsigned generation, sd_bus_error *e) {
+typedef struct OrderGraph {
+        /* The ordering graph of the transaction's jobs, and of the installed jobs they are ordered against,
+         * with the edges stored CSR style: the successors of node 'i' are edges[offsets[i]] up to
+         * edges[offsets[i+1]]. */
+        Job **jobs;
+        Unit **units;
+        bool *in_transaction;
+        size_t n_nodes;
+
+        size_t *offsets;
+        unsigned *edges;
+        size_t n_edges;
+} OrderGraph;
+
+static void order_graph_done(OrderGraph *g) {
+        assert(g);
+
+        free(g->jobs);
+        free(g->units);
+        free(g->in_transaction);
+        free(g->offsets);
+        free(g->edges);
+}
+
+static int order_graph_add_node(OrderGraph *g, Job *j, bool in_transaction, unsigned generation, unsigned *ret) {
+        assert(g);
+        assert(j);
+
+        if (j->generation == generation) {
+                if (ret)
+                        *ret = j->order_node;
+                return 0;
+        }
+
+        if (g->n_nodes >= UINT_MAX)
+                return -E2BIG;
+
+        if (!GREEDY_REALLOC(g->jobs, g->n_nodes + 1) ||
+            !GREEDY_REALLOC(g->units, g->n_nodes + 1) ||
+            !GREEDY_REALLOC(g->in_transaction, g->n_nodes + 1))
+                return -ENOMEM;
+
+        g->jobs[g->n_nodes] = j;
+        g->units[g->n_nodes] = j->unit;
+        g->in_transaction[g->n_nodes] = in_transaction;
 
+        j->generation = generation;
+        j->order_node = g->n_nodes;
+
+        if (ret)
+                *ret = g->n_nodes;
+
+        g->n_nodes++;
+        return 0;
+}
+
+static int order_graph_build(OrderGraph *g, Transaction *tr, unsigned generation) {
         static const UnitDependencyAtom directions[] = {
                 UNIT_ATOM_BEFORE,
                 UNIT_ATOM_AFTER,
         };
 
+        Job *j;
         int r;
 
+        assert(g);
         assert(tr);
-        assert(j);
-        assert(!j->transaction_prev);
 
-        /* Does a recursive sweep through the ordering graph, looking for a cycle. If we find a cycle we try
-         * to break it. */
+        /* Actual ordering of jobs depends on the unit ordering dependency and job types. We need to traverse
+         * the graph over 'before' edges in the actual job execution order. We traverse over both unit
+         * ordering dependencies and we test with job_compare() whether it is the 'before' edge in the job
+         * execution ordering. Installed jobs are part of the graph too, as far as they are reachable from
+         * the transaction's jobs. */
+
+        HASHMAP_FOREACH(j, tr->jobs) {
+                assert(!j->transaction_prev);
 
-        /* Have we seen this before? */
-        if (j->generation == generation) {
-                Job *k, *delete = NULL;
-                _cleanup_free_ char **array = NULL, *unit_ids = NULL;
+                r = order_graph_add_node(g, j, /* in_transaction= */ true, generation, NULL);
+                if (r < 0)
+                        return r;
+        }
 
-                /* If the marker is NULL we have been here already and decided the job was loop-free from
-                 * here. Hence shortcut things and return right-away. */
-                if (!j->marker)
-                        return 0;
+        /* Note that this adds nodes while going through them */
+        for (size_t i = 0; i < g->n_nodes; i++) {
+                if (!GREEDY_REALLOC(g->offsets, i + 2))
+                        return -ENOMEM;
 
-                /* So, the marker is not NULL and we already have been here. We have a cycle. Let's try to
-                 * break it. We go backwards in our path and try to find a suitable job to remove. We use the
-                 * marker to find our way back, since smart how we are we stored our way back in there. */
-                for (k = from; k; k = ((k->generation == generation && k->marker != k) ? k->marker : NULL)) {
+                g->offsets[i] = g->n_edges;
+                j = g->jobs[i];
 
-                        /* For logging below */
-                        if (strv_push_pair(&array, k->unit->id, (char*) job_type_to_string(k->type)) < 0)
-                                log_oom();
+                for (size_t d = 0; d < ELEMENTSOF(directions); d++) {
+                        Unit *u;
 
-                        if (!delete && hashmap_get(tr->jobs, k->unit) && !unit_matters_to_anchor(k->unit, k))
-                                /* Ok, we can drop this one, so let's do so. */
-                                delete = k;
+                        UNIT_FOREACH_DEPENDENCY(u, j->unit, directions[d]) {
+                                bool in_transaction = true;
+                                unsigned node;
+                                Job *o;
 
-                        /* Check if this in fact was the beginning of the cycle */
-                        if (k == j)
-                                break;
-                }
+                                /* Is there a job for this unit? */
+                                o = hashmap_get(tr->jobs, u);
+                                if (!o) {
+                                        /* Ok, there is no job for this in the transaction, but maybe there
+                                         * is already one running? */
+                                        o = u->job;
+                                        if (!o)
+                                                continue;
 
-                unit_ids = merge_unit_ids(j->manager->unit_log_field, array); /* ignore error */
-
-                STRV_FOREACH_PAIR(unit_id, job_type, array)
-                        /* logging for j not k here to provide a consistent narrative */
-                        log_struct(LOG_WARNING,
-                                   LOG_UNIT_MESSAGE(j->unit,
-                                                    "Found %s on %s/%s",
-                                                    unit_id == array ? "ordering cycle" : "dependency",
-                                                    *unit_id, *job_type),
-                                   "%s", strna(unit_ids));
-
-                if (delete) {
-                        const char *status;
-                        /* logging for j not k here to provide a consistent narrative */
-                        log_struct(LOG_ERR,
-                                   LOG_UNIT_MESSAGE(j->unit,
-                                                    "Job %s/%s deleted to break ordering cycle starting with %s/%s",
-                                                    delete->unit->id, job_type_to_string(delete->type),
-                                                    j->unit->id, job_type_to_string(j->type)),
-                                   "%s", strna(unit_ids));
-
-                        if (log_get_show_color())
-                                status = ANSI_HIGHLIGHT_RED " SKIP " ANSI_NORMAL;
-                        else
-                                status = " SKIP ";
-
-                        unit_status_printf(delete->unit,
-                                           STATUS_TYPE_NOTICE,
-                                           status,
-                                           "Ordering cycle found, skipping %s",
-                                           unit_status_string(delete->unit, NULL));
-                        transaction_delete_unit(tr, delete->unit);
-                        return -EAGAIN;
+                                        in_transaction = false;
+                                }
+
+                                /* Skip the edge if the job j is not really *before* o. */
+                                if (job_compare(j, o, directions[d]) >= 0)
+                                        continue;
+
+                                r = order_graph_add_node(g, o, in_transaction, generation, &node);
+                                if (r < 0)
+                                        return r;
+
+                                if (!GREEDY_REALLOC(g->edges, g->n_edges + 1))
+                                        return -ENOMEM;
+
+                                g->edges[g->n_edges++] = node;
+                        }
                 }
+        }
 
-                log_struct(LOG_ERR,
-                           LOG_UNIT_MESSAGE(j->unit, "Unable to break cycle starting with %s/%s",
-                                            j->unit->id, job_type_to_string(j->type)),
-                           "%s", strna(unit_ids));
+        if (!GREEDY_REALLOC(g->offsets, g->n_nodes + 1))
+                return -ENOMEM;
+
+        g->offsets[g->n_nodes] = g->n_edges;
+        return 0;
+}
 
-                return sd_bus_error_setf(e, BUS_ERROR_TRANSACTION_ORDER_IS_CYCLIC,
-                                         "Transaction order is cyclic. See system logs for details.");
+typedef struct OrderGraphFrame {
+        unsigned node;
+        size_t next_edge;
+} OrderGraphFrame;
+
+typedef struct OrderGraphComponents {
+        /* The strongly connected component of each node */
+        unsigned *component;
+        /* The nodes of component 'c' are members[offsets[c]] up to members[offsets[c+1]], the last one
+         * being the first one visited, i.e. the root. */
+        unsigned *members;
+        unsigned *offsets;
+        size_t n_components;
+        /* The components with more than one node, i.e. with at least one ordering cycle */
+        unsigned *cyclic;
+        size_t n_cyclic;
+} OrderGraphComponents;
+
+static void order_graph_components_done(OrderGraphComponents *c) {
+        assert(c);
+
+        free(c->component);
+        free(c->members);
+        free(c->offsets);
+        free(c->cyclic);
+}
+
+static int order_graph_find_components(const OrderGraph *g, OrderGraphComponents *ret) {
+        _cleanup_(order_graph_components_done) OrderGraphComponents c = {};
+        _cleanup_free_ unsigned *index = NULL, *lowlink = NULL, *stack = NULL;
+        _cleanup_free_ OrderGraphFrame *frames = NULL;
+        _cleanup_free_ bool *on_stack = NULL;
+        size_t n_stack = 0, n_frames = 0, n_members = 0;
+        unsigned next_index = 1;
+
+        assert(g);
+        assert(ret);
+
+        /* Tarjan's algorithm for strongly connected components, without recursion so that long ordering
+         * chains cannot overflow our stack. Each component with more than one node contains at least one
+         * ordering cycle. Self-loops do not exist, as units cannot be ordered against themselves. */
+
+        if (g->n_nodes > 0) {
+                index = new0(unsigned, g->n_nodes);
+                lowlink = new(unsigned, g->n_nodes);
+                stack = new(unsigned, g->n_nodes);
+                on_stack = new0(bool, g->n_nodes);
+                frames = new(OrderGraphFrame, g->n_nodes);
+                c.component = new(unsigned, g->n_nodes);
+                c.members = new(unsigned, g->n_nodes);
+                c.offsets = new(unsigned, g->n_nodes + 1);
+                if (!index || !lowlink || !stack || !on_stack || !frames || !c.component || !c.members || !c.offsets)
+                        return -ENOMEM;
         }
 
-        /* Make the marker point to where we come from, so that we can
-         * find our way backwards if we want to break a cycle. We use
-         * a special marker for the beginning: we point to
-         * ourselves. */
-        j->marker = from ? from : j;
-        j->generation = generation;
+        for (unsigned root = 0; root < g->n_nodes; root++) {
+                if (index[root] != 0)
+                        continue;
 
-        /* Actual ordering of jobs depends on the unit ordering dependency and job types. We need to traverse
-         * the graph over 'before' edges in the actual job execution order. We traverse over both unit
-         * ordering dependencies and we test with job_compare() whether it is the 'before' edge in the job
-         * execution ordering. */
-        for (size_t d = 0; d < ELEMENTSOF(directions); d++) {
-                Unit *u;
-
-                UNIT_FOREACH_DEPENDENCY(u, j->unit, directions[d]) {
-                        Job *o;
-
-                        /* Is there a job for this unit? */
-                        o = hashmap_get(tr->jobs, u);
-                        if (!o) {
-                                /* Ok, there is no job for this in the transaction, but maybe there is
-                                 * already one running? */
-                                o = u->job;
-                                if (!o)
-                                        continue;
+                frames[n_frames++] = (OrderGraphFrame) { .node = root, .next_edge = g->offsets[root] };
+                index[root] = lowlink[root] = next_index++;
+                stack[n_stack++] = root;
+                on_stack[root] = true;
+
+                while (n_frames > 0) {
+                        OrderGraphFrame *f = frames + n_frames - 1;
+                        unsigned v = f->node;
+
+                        if (f->next_edge < g->offsets[v + 1]) {
+                                unsigned w = g->edges[f->next_edge++];
+
+                                if (index[w] == 0) {
+                                        /* Descend */
+                                        frames[n_frames++] = (OrderGraphFrame) { .node = w, .next_edge = g->offsets[w] };
+                                        index[w] = lowlink[w] = next_index++;
+                                        stack[n_stack++] = w;
+                                        on_stack[w] = true;
+                                } else if (on_stack[w])
+                                        lowlink[v] = MIN(lowlink[v], index[w]);
+
+                                continue;
                         }
 
-                        /* Cut traversing if the job j is not really *before* o. */
-                        if (job_compare(j, o, directions[d]) >= 0)
+                        /* All successors are done, return to the caller */
+                        n_frames--;
+                        if (n_frames > 0) {
+                                unsigned caller = frames[n_frames - 1].node;
+
+                                lowlink[caller] = MIN(lowlink[caller], lowlink[v]);
+                        }
+
+                        if (lowlink[v] != index[v])
                                 continue;
 
-                        r = transaction_verify_order_one(tr, o, j, generation, e);
-                        if (r < 0)
-                                return r;
+                        /* v is the root of a component, which consists of everything from it to the top of
+                         * the stack */
+                        if (stack[n_stack - 1] != v) {
+                                if (!GREEDY_REALLOC(c.cyclic, c.n_cyclic + 1))
+                                        return -ENOMEM;
+
+                                c.cyclic[c.n_cyclic++] = c.n_components;
+                        }
+
+                        c.offsets[c.n_components] = n_members;
+
+                        for (;;) {
+                                unsigned w = stack[--n_stack];
+
+                                on_stack[w] = false;
+                                c.component[w] = c.n_components;
+                                c.members[n_members++] = w;
+                                if (w == v)
+                                        break;
+                        }
+
+                        c.n_components++;
                 }
         }
 
-        /* Ok, let's backtrack, and remember that this entry is not on
-         * our path anymore. */
-        j->marker = NULL;
+        if (c.offsets)
+                c.offsets[c.n_components] = n_members;
 
+        *ret = c;
+        c = (OrderGraphComponents) {};
         return 0;
 }
 
+static unsigned order_graph_find_cycle(
+                const OrderGraph *g,
+                const OrderGraphComponents *c,
+                unsigned root,
+                unsigned *parent,
+                unsigned *queue) {
+
+        size_t head = 0, tail = 0;
+
+        assert(g);
+        assert(c);
+        assert(parent);
+        assert(queue);
+
+        /* Finds a shortest cycle through 'root' within its component, by a breadth first search from 'root'
+         * that stops once it finds a node with an edge back to 'root'. Returns that node. The path from
+         * 'root' to it can be followed backwards via 'parent', which needs to be initialized to UINT_MAX
+         * for all nodes of the component. */
+
+        parent[root] = root;
+        queue[tail++] = root;
+
+        while (head < tail) {
+                unsigned v = queue[head++];
+
+                for (size_t k = g->offsets[v]; k < g->offsets[v + 1]; k++) {
+                        unsigned w = g->edges[k];
+
+                        if (c->component[w] != c->component[root])
+                                continue;
+
+                        if (w == root)
+                                return v;
+
+                        if (parent[w] != UINT_MAX)
+                                continue;
+
+                        parent[w] = v;
+                        queue[tail++] = w;
+                }
+        }
+
+        /* A strongly connected component with more than one node has a cycle through each of its nodes */
+        assert_not_reached();
+}
+
+static int transaction_break_cycle(
+                Transaction *tr,
+                const OrderGraph *g,
+                const unsigned *parent,
+                unsigned root,
+                unsigned last,
+                sd_bus_error *e) {
+
+        _cleanup_free_ char **array = NULL, *unit_ids = NULL;
+        Job *j, *delete = NULL;
+
+        assert(tr);
+        assert(g);
+        assert(parent);
+
+        /* We found a cycle: root → … → last → root. Let's try to break it. We go backwards in the cycle
+         * starting with the job pointing to the root, and try to find a suitable job to remove. */
+
+        j = g->jobs[root];
+
+        for (unsigned v = last;; v = parent[v]) {
+                Job *k = g->jobs[v];
+
+                /* For logging below */
+                if (strv_push_pair(&array, k->unit->id, (char*) job_type_to_string(k->type)) < 0)
+                        log_oom();
+
+                if (!delete && g->in_transaction[v] && !unit_matters_to_anchor(k->unit, k))
+                        /* Ok, we can drop this one, so let's do so. */
+                        delete = k;
+
+                /* Check if this in fact was the beginning of the cycle */
+                if (v == root)
+                        break;
+        }
+
+        unit_ids = merge_unit_ids(j->manager->unit_log_field, array); /* ignore error */
+
+        STRV_FOREACH_PAIR(unit_id, job_type, array)
+                /* logging for j not k here to provide a consistent narrative */
+                log_struct(LOG_WARNING,
+                           LOG_UNIT_MESSAGE(j->unit,
+                                            "Found %s on %s/%s",
+                                            unit_id == array ? "ordering cycle" : "dependency",
+                                            *unit_id, *job_type),
+                           "%s", strna(unit_ids));
+
+        if (delete) {
+                const char *status;
+                /* logging for j not k here to provide a consistent narrative */
+                log_struct(LOG_ERR,
+                           LOG_UNIT_MESSAGE(j->unit,
+                                            "Job %s/%s deleted to break ordering cycle starting with %s/%s",
+                                            delete->unit->id, job_type_to_string(delete->type),
+                                            j->unit->id, job_type_to_string(j->type)),
+                           "%s", strna(unit_ids));
+
+                if (log_get_show_color())
+                        status = ANSI_HIGHLIGHT_RED " SKIP " ANSI_NORMAL;
+                else
+                        status = " SKIP ";
+
+                unit_status_printf(delete->unit,
+                                   STATUS_TYPE_NOTICE,
+                                   status,
+                                   "Ordering cycle found, skipping %s",
+                                   unit_status_string(delete->unit, NULL));
+                transaction_delete_unit(tr, delete->unit);
+                return -EAGAIN;
+        }
+
+        log_struct(LOG_ERR,
+                   LOG_UNIT_MESSAGE(j->unit, "Unable to break cycle starting with %s/%s",
+                                    j->unit->id, job_type_to_string(j->type)),
+                   "%s", strna(unit_ids));
+
+        return sd_bus_error_setf(e, BUS_ERROR_TRANSACTION_ORDER_IS_CYCLIC,
+                                 "Transaction order is cyclic. See system logs for details.");
+}
+
+static bool order_graph_component_alive(Transaction *tr, const OrderGraph *g, const OrderGraphComponents *c, unsigned component) {
+        assert(tr);
+        assert(g);
+        assert(c);
+
+        /* Breaking a cycle deletes jobs from the transaction, possibly including jobs of other components.
+         * Check that all transaction jobs of this component are still around, by comparing pointers only,
+         * as the jobs might have been freed already. */
+
+        for (unsigned k = c->offsets[component]; k < c->offsets[component + 1]; k++) {
+                unsigned v = c->members[k];
+
+                if (g->in_transaction[v] && hashmap_get(tr->jobs, g->units[v]) != g->jobs[v])
+                        return false;
+        }
+
+        return true;
+}
+
 static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bus_error *e) {
-        Job *j;
+        _cleanup_(order_graph_components_done) OrderGraphComponents c = {};
+        _cleanup_(order_graph_done) OrderGraph g = {};
+        _cleanup_free_ unsigned *parent = NULL, *queue = NULL;
+        bool deleted = false;
         int r;
-        unsigned g;
 
         assert(tr);
         assert(generation);
 
-        /* Check if the ordering graph is cyclic. If it is, try to fix
-         * that up by dropping one of the jobs. */
+        /* Check if the ordering graph is cyclic. If it is, try to fix that up by dropping one of the jobs of
+         * each cycle. The graph is built and split into strongly connected components only once, so that
+         * all independent cycles are broken in one go. Returns -EAGAIN if jobs were dropped, as that might
+         * have made more jobs unnecessary, and the caller should check again. */
 
-        g = (*generation)++;
+        r = order_graph_build(&g, tr, (*generation)++);
+        if (r < 0)
+                return r;
 
-        HASHMAP_FOREACH(j, tr->jobs) {
-                r = transaction_verify_order_one(tr, j, NULL, g, e);
-                if (r < 0)
+        r = order_graph_find_components(&g, &c);
+        if (r < 0)
+                return r;
+
+        if (c.n_cyclic == 0)
+                return 0;
+
+        parent = new(unsigned, g.n_nodes);
+        queue = new(unsigned, g.n_nodes);
+        if (!parent || !queue)
+                return -ENOMEM;
+
+        for (size_t i = 0; i < c.n_cyclic; i++) {
+                unsigned component = c.cyclic[i], root, last;
+
+                if (deleted && !order_graph_component_alive(tr, &g, &c, component))
+                        continue;
+
+                for (unsigned k = c.offsets[component]; k < c.offsets[component + 1]; k++)
+                        parent[c.members[k]] = UINT_MAX;
+
+                root = c.members[c.offsets[component + 1] - 1];
+                last = order_graph_find_cycle(&g, &c, root, parent, queue);
+
+                r = transaction_break_cycle(tr, &g, parent, root, last, e);
+                if (r == -EAGAIN)
+                        deleted = true;
+                else if (r < 0)
                         return r;
         }
 
-        return 0;
+        return deleted ? -EAGAIN : 0;
 }
 
 static void transaction_collect_garbage(Transaction *tr) {
@@ -820,7 +1124,6 @@ static Job* transaction_add_one_job(Transaction *tr, JobType type, Unit *unit, b
                 return NULL;
 
         j->generation = 0;
-        j->marker = NULL;
         j->matters_to_anchor = false;
         j->irreversible = tr->irreversible;
 
@@ -984,6 +1287,13 @@ int transaction_add_job_and_dependencies(
         if (is_new && !ignore_requirements && type != JOB_NOP) {
                 Set *following;
 
+                /* Make sure the list of units this one pulls in is up-to-date, so that we can iterate
+                 * through it below without having to go through all of the unit's dependencies for every
+                 * way of pulling in other units. */
+                r = unit_update_pull_in(ret->unit);
+                if (r < 0)
+                        return r;
+
                 /* If we are following some other unit, make sure we
                  * add all dependencies of everybody following. */
                 if (unit_following_set(ret->unit, &following) > 0) {
@@ -1002,7 +1312,7 @@ int transaction_add_job_and_dependencies(
 
                 /* Finally, recursively add in all dependencies. */
                 if (IN_SET(type, JOB_START, JOB_RESTART)) {
-                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_ATOM_PULL_IN_START) {
+                        UNIT_FOREACH_PULL_IN(dep, ret->unit, UNIT_PULL_IN_START, r) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1011,8 +1321,10 @@ int transaction_add_job_and_dependencies(
                                         sd_bus_error_free(e);
                                 }
                         }
+                        if (r < 0)
+                                goto fail;
 
-                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_ATOM_PULL_IN_START_IGNORED) {
+                        UNIT_FOREACH_PULL_IN(dep, ret->unit, UNIT_PULL_IN_START_IGNORED, r) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, false, false, false, ignore_order, e);
                                 if (r < 0) {
                                         /* unit masked, job type not applicable and unit not found are not considered as errors. */
@@ -1023,8 +1335,10 @@ int transaction_add_job_and_dependencies(
                                         sd_bus_error_free(e);
                                 }
                         }
+                        if (r < 0)
+                                goto fail;
 
-                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_ATOM_PULL_IN_VERIFY) {
+                        UNIT_FOREACH_PULL_IN(dep, ret->unit, UNIT_PULL_IN_VERIFY, r) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_VERIFY_ACTIVE, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1033,8 +1347,10 @@ int transaction_add_job_and_dependencies(
                                         sd_bus_error_free(e);
                                 }
                         }
+                        if (r < 0)
+                                goto fail;
 
-                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_ATOM_PULL_IN_STOP) {
+                        UNIT_FOREACH_PULL_IN(dep, ret->unit, UNIT_PULL_IN_STOP, r) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, true, true, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1043,8 +1359,10 @@ int transaction_add_job_and_dependencies(
                                         sd_bus_error_free(e);
                                 }
                         }
+                        if (r < 0)
+                                goto fail;
 
-                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_ATOM_PULL_IN_STOP_IGNORED) {
+                        UNIT_FOREACH_PULL_IN(dep, ret->unit, UNIT_PULL_IN_STOP_IGNORED, r) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, false, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_unit_warning(dep,
@@ -1053,23 +1371,25 @@ int transaction_add_job_and_dependencies(
                                         sd_bus_error_free(e);
                                 }
                         }
+                        if (r < 0)
+                                goto fail;
                 }
 
                 if (IN_SET(type, JOB_STOP, JOB_RESTART)) {
-                        UnitDependencyAtom atom;
+                        UnitPullIn pull_in;
                         JobType ptype;
 
                         /* We propagate STOP as STOP, but RESTART only as TRY_RESTART, in order not to start
                          * dependencies that are not around. */
                         if (type == JOB_RESTART) {
-                                atom = UNIT_ATOM_PROPAGATE_RESTART;
+                                pull_in = UNIT_PULL_IN_PROPAGATE_RESTART;
                                 ptype = JOB_TRY_RESTART;
                         } else {
                                 ptype = JOB_STOP;
-                                atom = UNIT_ATOM_PROPAGATE_STOP;
+                                pull_in = UNIT_PULL_IN_PROPAGATE_STOP;
                         }
 
-                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, atom) {
+                        UNIT_FOREACH_PULL_IN(dep, ret->unit, pull_in, r) {
                                 JobType nt;
 
                                 nt = job_type_collapse(ptype, dep);
@@ -1084,6 +1404,8 @@ int transaction_add_job_and_dependencies(
                                         sd_bus_error_free(e);
                                 }
                         }
+                        if (r < 0)
+                                goto fail;
                 }
 
                 if (type == JOB_RELOAD)
@@ -0,0 +1,234 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "sd-event.h"
+
+#include "cgroup.h"
+#include "fileio.h"
+#include "format-util.h"
+#include "log.h"
+#include "mallinfo-util.h"
+#include "manager.h"
+#include "strv.h"
+#include "unit-compact.h"
+#include "unit.h"
+
+static int read_unit_file(char ***l, const char *path) {
+        _cleanup_free_ char *contents = NULL;
+        int r;
+
+        assert(l);
+        assert(path);
+
+        r = read_full_file(path, &contents, NULL);
+        if (r < 0)
+                return r;
+
+        return strv_consume_pair(l, strdup(path), TAKE_PTR(contents));
+}
+
+static int unit_read_files(Unit *u, char ***ret) {
+        _cleanup_strv_free_ char **l = NULL;
+        int r;
+
+        assert(u);
+        assert(u->fragment_path);
+        assert(ret);
+
+        /* Reads the fragment and the drop-ins of the unit, as pairs of path and contents, in the order
+         * they are parsed in */
+
+        r = read_unit_file(&l, u->fragment_path);
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(d, u->dropin_paths) {
+                r = read_unit_file(&l, *d);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(l);
+        return 0;
+}
+
+int unit_compact(Unit *u) {
+#if HAVE_GENERIC_MALLINFO
+        generic_mallinfo before, after;
+#endif
+        _cleanup_strv_free_ char **files = NULL;
+        int r;
+
+        assert(u);
+
+        /* Returns > 0 if the unit was compacted, 0 if it is not eligible (anymore) */
+
+        if (u->compacted)
+                return 0;
+
+        if (!UNIT_VTABLE(u)->compact)
+                return 0;
+
+        /* Transient units have no unit files we could read their settings back from, and perpetual units
+         * are never inactive anyway. */
+        if (u->load_state != UNIT_LOADED || !u->fragment_path || u->transient || u->perpetual)
+                return 0;
+
+        if (u->job || u->nop_job)
+                return 0;
+
+        if (!UNIT_IS_INACTIVE_OR_FAILED(unit_active_state(u)))
+                return 0;
+
+        /* A realized cgroup means there are still processes around we might have to deal with */
+        if (u->cgroup_realized || u->in_load_queue || u->in_cgroup_realize_queue)
+                return 0;
+
+        /* The unit files are kept around to expand the unit from again, as text is a lot smaller than the
+         * settings parsed from it. They better be the ones we loaded, though, hence check if they changed
+         * only after reading them. */
+#if HAVE_GENERIC_MALLINFO
+        before = generic_mallinfo_get();
+#endif
+
+        r = unit_read_files(u, &files);
+        if (r < 0)
+                return log_unit_debug_errno(u, r, "Failed to read unit files, not compacting unit: %m");
+
+        if (unit_need_daemon_reload(u))
+                return 0;
+
+        r = UNIT_VTABLE(u)->compact(u);
+        if (r <= 0)
+                return r;
+
+        unit_reset_contexts(u);
+        u->compacted = true;
+        u->compacted_files = TAKE_PTR(files);
+
+#if HAVE_GENERIC_MALLINFO
+        after = generic_mallinfo_get();
+        u->compacted_size = LESS_BY((size_t) before.uordblks, (size_t) after.uordblks);
+#endif
+
+        /* Our slice might have enabled controllers only because of the settings we just dropped */
+        unit_invalidate_cgroup_members_masks(u);
+
+        log_unit_debug(u, "Compacted inactive unit.");
+        return 1;
+}
+
+int unit_expand(Unit *u) {
+        int r;
+
+        assert(u);
+
+        /* Reads the settings dropped by unit_compact() back in from the copy of the unit files taken then,
+         * and thus needs to be called before anything looks at them. The private section is parsed on top
+         * of what's left of the unit, i.e. the other sections and the settings that are not reset by
+         * compacting it, which all came from the same unit files, even if they changed on disk since.
+         * Returns > 0 if the unit was compacted before. */
+
+        if (!u->compacted)
+                return 0;
+
+        assert(UNIT_VTABLE(u)->expand);
+
+        r = UNIT_VTABLE(u)->expand(u);
+        if (r < 0) {
+                /* Don't leave a partially parsed configuration around, the next attempt starts from scratch
+                 * again. */
+                unit_reset_contexts(u);
+                (void) UNIT_VTABLE(u)->compact(u);
+
+                return log_unit_error_errno(u, r, "Failed to read back settings of compacted unit: %m");
+        }
+
+        u->compacted = false;
+        u->compacted_size = 0;
+        u->compacted_files = strv_free(u->compacted_files);
+
+        unit_invalidate_cgroup_members_masks(u);
+
+        log_unit_debug(u, "Expanded compacted unit.");
+        return 1;
+}
+
+void manager_compact_units(Manager *m) {
+        unsigned n_compacted = 0;
+        size_t size = 0;
+        usec_t n;
+
+        assert(m);
+
+        /* Let's not waste time on this while booting up, and our state is in flux while reloading */
+        if (!MANAGER_IS_FINISHED(m) || MANAGER_IS_RELOADING(m))
+                return;
+
+        n = now(CLOCK_MONOTONIC);
+
+        for (UnitType t = 0; t < _UNIT_TYPE_MAX; t++) {
+                if (!unit_vtable[t]->compact)
+                        continue;
+
+                LIST_FOREACH(units_by_type, u, m->units_by_type[t]) {
+                        /* Only units that weren't needed for a while, many units are started periodically */
+                        if (usec_add(u->state_change_timestamp.monotonic, COMPACT_INACTIVE_UNITS_INTERVAL_USEC) > n)
+                                continue;
+
+                        if (unit_compact(u) <= 0)
+                                continue;
+
+                        n_compacted++;
+                        size += u->compacted_size;
+                }
+        }
+
+        if (n_compacted > 0)
+                log_debug("Compacted %u inactive units, freeing %s.", n_compacted, FORMAT_BYTES(size));
+}
+
+static int manager_dispatch_compact_units(sd_event_source *source, usec_t usec, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+        int r;
+
+        assert(source);
+
+        manager_compact_units(m);
+
+        r = sd_event_source_set_time_relative(source, COMPACT_INACTIVE_UNITS_INTERVAL_USEC);
+        if (r < 0)
+                return log_error_errno(r, "Failed to reset unit compaction timer: %m");
+
+        return sd_event_source_set_enabled(source, SD_EVENT_ONESHOT);
+}
+
+void manager_set_compact_inactive_units(Manager *m, bool b) {
+        int r;
+
+        assert(m);
+
+        /* Units compacted already are expanded again when needed, even if this is turned off */
+        if (!b) {
+                m->compact_units_event_source = sd_event_source_disable_unref(m->compact_units_event_source);
+                return;
+        }
+
+        if (m->compact_units_event_source || MANAGER_IS_TEST_RUN(m))
+                return;
+
+        r = sd_event_add_time_relative(
+                        m->event,
+                        &m->compact_units_event_source,
+                        CLOCK_MONOTONIC,
+                        COMPACT_INACTIVE_UNITS_INTERVAL_USEC,
+                        USEC_PER_MINUTE,
+                        manager_dispatch_compact_units,
+                        m);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to install unit compaction timer, not compacting inactive units: %m");
+                return;
+        }
+
+        (void) sd_event_source_set_priority(m->compact_units_event_source, SD_EVENT_PRIORITY_IDLE);
+        (void) sd_event_source_set_description(m->compact_units_event_source, "manager-compact-units");
+}
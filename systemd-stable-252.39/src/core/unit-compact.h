@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdbool.h>
+
+#include "time-util.h"
+
+typedef struct Manager Manager;
+typedef struct Unit Unit;
+
+/* With CompactInactiveUnits= enabled, units that have been inactive for this long, and have no jobs queued,
+ * are reduced to what is needed to reference them: names, load state, dependencies and the state of their
+ * last run. Their exec and cgroup contexts, and everything else parsed from the type-specific section of
+ * their unit files is freed, and read in again from a copy of the unit files once needed. */
+#define COMPACT_INACTIVE_UNITS_INTERVAL_USEC (5 * USEC_PER_MINUTE)
+
+int unit_compact(Unit *u);
+int unit_expand(Unit *u);
+
+void manager_compact_units(Manager *m);
+void manager_set_compact_inactive_units(Manager *m, bool b);
@@ -114,6 +114,22 @@ UnitDependencyAtom unit_dependency_to_atom(UnitDependency d) {
         return atom_map[d];
 }
 
+uint64_t unit_dependency_types_from_atom(UnitDependencyAtom atom) {
+        uint64_t types = 0;
+
+        /* Returns a bit mask of all dependency types (bit 'd' for UnitDependency 'd') that have any of the
+         * specified atom bits set. This is what the dependency iterators match each dependency edge
+         * against. */
+
+        assert_cc(_UNIT_DEPENDENCY_MAX <= 64);
+
+        for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
+                if (atom_map[d] & atom)
+                        types |= UINT64_C(1) << d;
+
+        return types;
+}
+
 UnitDependency unit_dependency_from_unique_atom(UnitDependencyAtom atom) {
 
         /* This is a "best-effort" function that maps the specified 'atom' mask to a dependency type that is
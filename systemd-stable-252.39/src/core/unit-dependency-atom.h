@@ -2,6 +2,7 @@
 #pragma once
 
 #include <errno.h>
+#include <stdint.h>
 
 #include "unit-def.h"
 
@@ -87,3 +88,4 @@ typedef enum UnitDependencyAtom {
 
 UnitDependencyAtom unit_dependency_to_atom(UnitDependency d);
 UnitDependency unit_dependency_from_unique_atom(UnitDependencyAtom atom);
+uint64_t unit_dependency_types_from_atom(UnitDependencyAtom atom);
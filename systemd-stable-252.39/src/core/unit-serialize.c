@@ -154,6 +154,11 @@ int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool switching_root) {
         if (u->oom_kill_last > 0)
                 (void) serialize_item_format(f, "oom-kill-last", "%" PRIu64, u->oom_kill_last);
 
+        if (u->n_notify_messages > 0) {
+                (void) serialize_item_format(f, "notify-messages", "%" PRIu64, u->n_notify_messages);
+                (void) serialize_item_format(f, "notify-messages-coalesced", "%" PRIu64, u->n_notify_messages_coalesced);
+        }
+
         for (CGroupIOAccountingMetric im = 0; im < _CGROUP_IO_ACCOUNTING_METRIC_MAX; im++) {
                 (void) serialize_item_format(f, io_accounting_metric_field_base[im], "%" PRIu64, u->io_accounting_base[im]);
 
@@ -240,6 +245,39 @@ static int unit_deserialize_job(Unit *u, FILE *f) {
         return 0;
 }
 
+static int unit_deserialize_job_record(Unit *u, BinaryRecord *record) {
+        _cleanup_(job_freep) Job *j = NULL;
+        const char *l, *v;
+        int r;
+
+        assert(u);
+        assert(record);
+
+        j = job_new_raw(u);
+        if (!j)
+                return log_oom();
+
+        /* The job's items are terminated by one with an empty key, like by an empty line in the text format */
+        for (;;) {
+                r = binary_record_next(record, &l, &v);
+                if (r < 0)
+                        return log_unit_error_errno(u, r, "Failed to read serialization item: %m");
+                if (r == 0 || isempty(l))
+                        break;
+
+                r = job_deserialize_item(j, l, v);
+                if (r < 0)
+                        return r;
+        }
+
+        r = job_install_deserialized(j);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(j);
+        return 0;
+}
+
 #define MATCH_DESERIALIZE(key, l, v, parse_func, target)                \
         ({                                                              \
                 bool _deserialize_matched = streq(l, key);              \
@@ -266,278 +304,257 @@ static int unit_deserialize_job(Unit *u, FILE *f) {
                 _deserialize_matched;                                   \
         })
 
-int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
+static int unit_deserialize_item(Unit *u, const char *l, const char *v, FDSet *fds) {
+        ssize_t m;
         int r;
 
         assert(u);
-        assert(f);
-        assert(fds);
-
-        for (;;) {
-                _cleanup_free_ char *line = NULL;
-                char *l, *v;
-                ssize_t m;
-                size_t k;
+        assert(l);
+        assert(v);
 
-                r = read_line(f, LONG_LINE_MAX, &line);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to read serialization line: %m");
-                if (r == 0) /* eof */
-                        break;
+        if (streq(l, "state-change-timestamp")) {
+                (void) deserialize_dual_timestamp(v, &u->state_change_timestamp);
+                return 0;
+        } else if (streq(l, "inactive-exit-timestamp")) {
+                (void) deserialize_dual_timestamp(v, &u->inactive_exit_timestamp);
+                return 0;
+        } else if (streq(l, "active-enter-timestamp")) {
+                (void) deserialize_dual_timestamp(v, &u->active_enter_timestamp);
+                return 0;
+        } else if (streq(l, "active-exit-timestamp")) {
+                (void) deserialize_dual_timestamp(v, &u->active_exit_timestamp);
+                return 0;
+        } else if (streq(l, "inactive-enter-timestamp")) {
+                (void) deserialize_dual_timestamp(v, &u->inactive_enter_timestamp);
+                return 0;
+        } else if (streq(l, "condition-timestamp")) {
+                (void) deserialize_dual_timestamp(v, &u->condition_timestamp);
+                return 0;
+        } else if (streq(l, "assert-timestamp")) {
+                (void) deserialize_dual_timestamp(v, &u->assert_timestamp);
+                return 0;
 
-                l = strstrip(line);
-                if (isempty(l)) /* End marker */
-                        break;
+        } else if (MATCH_DESERIALIZE("condition-result", l, v, parse_boolean, u->condition_result))
+                return 0;
 
-                k = strcspn(l, "=");
+        else if (MATCH_DESERIALIZE("assert-result", l, v, parse_boolean, u->assert_result))
+                return 0;
 
-                if (l[k] == '=') {
-                        l[k] = 0;
-                        v = l+k+1;
-                } else
-                        v = l+k;
+        else if (MATCH_DESERIALIZE("transient", l, v, parse_boolean, u->transient))
+                return 0;
 
-                if (streq(l, "job")) {
-                        if (v[0] == '\0') {
-                                /* New-style serialized job */
-                                r = unit_deserialize_job(u, f);
-                                if (r < 0)
-                                        return r;
-                        } else  /* Legacy for pre-44 */
-                                log_unit_warning(u, "Update from too old systemd versions are unsupported, cannot deserialize job: %s", v);
-                        continue;
-                } else if (streq(l, "state-change-timestamp")) {
-                        (void) deserialize_dual_timestamp(v, &u->state_change_timestamp);
-                        continue;
-                } else if (streq(l, "inactive-exit-timestamp")) {
-                        (void) deserialize_dual_timestamp(v, &u->inactive_exit_timestamp);
-                        continue;
-                } else if (streq(l, "active-enter-timestamp")) {
-                        (void) deserialize_dual_timestamp(v, &u->active_enter_timestamp);
-                        continue;
-                } else if (streq(l, "active-exit-timestamp")) {
-                        (void) deserialize_dual_timestamp(v, &u->active_exit_timestamp);
-                        continue;
-                } else if (streq(l, "inactive-enter-timestamp")) {
-                        (void) deserialize_dual_timestamp(v, &u->inactive_enter_timestamp);
-                        continue;
-                } else if (streq(l, "condition-timestamp")) {
-                        (void) deserialize_dual_timestamp(v, &u->condition_timestamp);
-                        continue;
-                } else if (streq(l, "assert-timestamp")) {
-                        (void) deserialize_dual_timestamp(v, &u->assert_timestamp);
-                        continue;
+        else if (MATCH_DESERIALIZE("in-audit", l, v, parse_boolean, u->in_audit))
+                return 0;
 
-                } else if (MATCH_DESERIALIZE("condition-result", l, v, parse_boolean, u->condition_result))
-                        continue;
+        else if (MATCH_DESERIALIZE("exported-invocation-id", l, v, parse_boolean, u->exported_invocation_id))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("assert-result", l, v, parse_boolean, u->assert_result))
-                        continue;
+        else if (MATCH_DESERIALIZE("exported-log-level-max", l, v, parse_boolean, u->exported_log_level_max))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("transient", l, v, parse_boolean, u->transient))
-                        continue;
+        else if (MATCH_DESERIALIZE("exported-log-extra-fields", l, v, parse_boolean, u->exported_log_extra_fields))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("in-audit", l, v, parse_boolean, u->in_audit))
-                        continue;
+        else if (MATCH_DESERIALIZE("exported-log-rate-limit-interval", l, v, parse_boolean, u->exported_log_ratelimit_interval))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("exported-invocation-id", l, v, parse_boolean, u->exported_invocation_id))
-                        continue;
+        else if (MATCH_DESERIALIZE("exported-log-rate-limit-burst", l, v, parse_boolean, u->exported_log_ratelimit_burst))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("exported-log-level-max", l, v, parse_boolean, u->exported_log_level_max))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("cpu-usage-base", l, v, safe_atou64, u->cpu_usage_base) ||
+                 MATCH_DESERIALIZE_IMMEDIATE("cpuacct-usage-base", l, v, safe_atou64, u->cpu_usage_base))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("exported-log-extra-fields", l, v, parse_boolean, u->exported_log_extra_fields))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("cpu-usage-last", l, v, safe_atou64, u->cpu_usage_last))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("exported-log-rate-limit-interval", l, v, parse_boolean, u->exported_log_ratelimit_interval))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("managed-oom-kill-last", l, v, safe_atou64, u->managed_oom_kill_last))
+                return 0;
 
-                else if (MATCH_DESERIALIZE("exported-log-rate-limit-burst", l, v, parse_boolean, u->exported_log_ratelimit_burst))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("oom-kill-last", l, v, safe_atou64, u->oom_kill_last))
+                return 0;
 
-                else if (MATCH_DESERIALIZE_IMMEDIATE("cpu-usage-base", l, v, safe_atou64, u->cpu_usage_base) ||
-                         MATCH_DESERIALIZE_IMMEDIATE("cpuacct-usage-base", l, v, safe_atou64, u->cpu_usage_base))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("notify-messages", l, v, safe_atou64, u->n_notify_messages))
+                return 0;
 
-                else if (MATCH_DESERIALIZE_IMMEDIATE("cpu-usage-last", l, v, safe_atou64, u->cpu_usage_last))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("notify-messages-coalesced", l, v, safe_atou64, u->n_notify_messages_coalesced))
+                return 0;
 
-                else if (MATCH_DESERIALIZE_IMMEDIATE("managed-oom-kill-last", l, v, safe_atou64, u->managed_oom_kill_last))
-                        continue;
+        else if (streq(l, "cgroup")) {
+                r = unit_set_cgroup_path(u, v);
+                if (r < 0)
+                        log_unit_debug_errno(u, r, "Failed to set cgroup path %s, ignoring: %m", v);
 
-                else if (MATCH_DESERIALIZE_IMMEDIATE("oom-kill-last", l, v, safe_atou64, u->oom_kill_last))
-                        continue;
+                (void) unit_watch_cgroup(u);
+                (void) unit_watch_cgroup_memory(u);
 
-                else if (streq(l, "cgroup")) {
-                        r = unit_set_cgroup_path(u, v);
-                        if (r < 0)
-                                log_unit_debug_errno(u, r, "Failed to set cgroup path %s, ignoring: %m", v);
+                return 0;
 
-                        (void) unit_watch_cgroup(u);
-                        (void) unit_watch_cgroup_memory(u);
+        } else if (MATCH_DESERIALIZE("cgroup-realized", l, v, parse_boolean, u->cgroup_realized))
+                return 0;
 
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("cgroup-realized-mask", l, v, cg_mask_from_string, u->cgroup_realized_mask))
+                return 0;
 
-                } else if (MATCH_DESERIALIZE("cgroup-realized", l, v, parse_boolean, u->cgroup_realized))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("cgroup-enabled-mask", l, v, cg_mask_from_string, u->cgroup_enabled_mask))
+                return 0;
 
-                else if (MATCH_DESERIALIZE_IMMEDIATE("cgroup-realized-mask", l, v, cg_mask_from_string, u->cgroup_realized_mask))
-                        continue;
+        else if (MATCH_DESERIALIZE_IMMEDIATE("cgroup-invalidated-mask", l, v, cg_mask_from_string, u->cgroup_invalidated_mask))
+                return 0;
 
-                else if (MATCH_DESERIALIZE_IMMEDIATE("cgroup-enabled-mask", l, v, cg_mask_from_string, u->cgroup_enabled_mask))
-                        continue;
+        else if (STR_IN_SET(l, "ipv4-socket-bind-bpf-link-fd", "ipv6-socket-bind-bpf-link-fd")) {
+                int fd;
 
-                else if (MATCH_DESERIALIZE_IMMEDIATE("cgroup-invalidated-mask", l, v, cg_mask_from_string, u->cgroup_invalidated_mask))
-                        continue;
+                if (safe_atoi(v, &fd) < 0 || fd < 0 || !fdset_contains(fds, fd))
+                        log_unit_debug(u, "Failed to parse %s value: %s, ignoring.", l, v);
+                else {
+                        if (fdset_remove(fds, fd) < 0) {
+                                log_unit_debug(u, "Failed to remove %s value=%d from fdset", l, fd);
+                                return 0;
+                        }
 
-                else if (STR_IN_SET(l, "ipv4-socket-bind-bpf-link-fd", "ipv6-socket-bind-bpf-link-fd")) {
-                        int fd;
+                        (void) bpf_socket_bind_add_initial_link_fd(u, fd);
+                }
+                return 0;
 
-                        if (safe_atoi(v, &fd) < 0 || fd < 0 || !fdset_contains(fds, fd))
-                                log_unit_debug(u, "Failed to parse %s value: %s, ignoring.", l, v);
-                        else {
-                                if (fdset_remove(fds, fd) < 0) {
-                                        log_unit_debug(u, "Failed to remove %s value=%d from fdset", l, fd);
-                                        continue;
-                                }
+        } else if (streq(l, "ip-bpf-ingress-installed")) {
+                 (void) bpf_program_deserialize_attachment(v, fds, &u->ip_bpf_ingress_installed);
+                 return 0;
+        } else if (streq(l, "ip-bpf-egress-installed")) {
+                 (void) bpf_program_deserialize_attachment(v, fds, &u->ip_bpf_egress_installed);
+                 return 0;
+        } else if (streq(l, "bpf-device-control-installed")) {
+                 (void) bpf_program_deserialize_attachment(v, fds, &u->bpf_device_control_installed);
+                 return 0;
+
+        } else if (streq(l, "ip-bpf-custom-ingress-installed")) {
+                 (void) bpf_program_deserialize_attachment_set(v, fds, &u->ip_bpf_custom_ingress_installed);
+                 return 0;
+        } else if (streq(l, "ip-bpf-custom-egress-installed")) {
+                 (void) bpf_program_deserialize_attachment_set(v, fds, &u->ip_bpf_custom_egress_installed);
+                 return 0;
+
+        } else if (streq(l, "restrict-ifaces-bpf-fd")) {
+                int fd;
+
+                if (safe_atoi(v, &fd) < 0 || fd < 0 || !fdset_contains(fds, fd)) {
+                        log_unit_debug(u, "Failed to parse restrict-ifaces-bpf-fd value: %s", v);
+                        return 0;
+                }
+                if (fdset_remove(fds, fd) < 0) {
+                        log_unit_debug(u, "Failed to remove restrict-ifaces-bpf-fd %d from fdset", fd);
+                        return 0;
+                }
 
-                                (void) bpf_socket_bind_add_initial_link_fd(u, fd);
-                        }
-                        continue;
+                (void) restrict_network_interfaces_add_initial_link_fd(u, fd);
+                return 0;
 
-                } else if (streq(l, "ip-bpf-ingress-installed")) {
-                         (void) bpf_program_deserialize_attachment(v, fds, &u->ip_bpf_ingress_installed);
-                         continue;
-                } else if (streq(l, "ip-bpf-egress-installed")) {
-                         (void) bpf_program_deserialize_attachment(v, fds, &u->ip_bpf_egress_installed);
-                         continue;
-                } else if (streq(l, "bpf-device-control-installed")) {
-                         (void) bpf_program_deserialize_attachment(v, fds, &u->bpf_device_control_installed);
-                         continue;
-
-                } else if (streq(l, "ip-bpf-custom-ingress-installed")) {
-                         (void) bpf_program_deserialize_attachment_set(v, fds, &u->ip_bpf_custom_ingress_installed);
-                         continue;
-                } else if (streq(l, "ip-bpf-custom-egress-installed")) {
-                         (void) bpf_program_deserialize_attachment_set(v, fds, &u->ip_bpf_custom_egress_installed);
-                         continue;
-
-                } else if (streq(l, "restrict-ifaces-bpf-fd")) {
-                        int fd;
-
-                        if (safe_atoi(v, &fd) < 0 || fd < 0 || !fdset_contains(fds, fd)) {
-                                log_unit_debug(u, "Failed to parse restrict-ifaces-bpf-fd value: %s", v);
-                                continue;
-                        }
-                        if (fdset_remove(fds, fd) < 0) {
-                                log_unit_debug(u, "Failed to remove restrict-ifaces-bpf-fd %d from fdset", fd);
-                                continue;
-                        }
+        } else if (streq(l, "ref-uid")) {
+                uid_t uid;
 
-                        (void) restrict_network_interfaces_add_initial_link_fd(u, fd);
-                        continue;
+                r = parse_uid(v, &uid);
+                if (r < 0)
+                        log_unit_debug(u, "Failed to parse \"%s=%s\", ignoring.", l, v);
+                else
+                        unit_ref_uid_gid(u, uid, GID_INVALID);
+                return 0;
 
-                } else if (streq(l, "ref-uid")) {
-                        uid_t uid;
+        } else if (streq(l, "ref-gid")) {
+                gid_t gid;
 
-                        r = parse_uid(v, &uid);
-                        if (r < 0)
-                                log_unit_debug(u, "Failed to parse \"%s=%s\", ignoring.", l, v);
-                        else
-                                unit_ref_uid_gid(u, uid, GID_INVALID);
-                        continue;
+                r = parse_gid(v, &gid);
+                if (r < 0)
+                        log_unit_debug(u, "Failed to parse \"%s=%s\", ignoring.", l, v);
+                else
+                        unit_ref_uid_gid(u, UID_INVALID, gid);
+                return 0;
 
-                } else if (streq(l, "ref-gid")) {
-                        gid_t gid;
+        } else if (streq(l, "ref")) {
+                r = strv_extend(&u->deserialized_refs, v);
+                if (r < 0)
+                        return log_oom();
+                return 0;
 
-                        r = parse_gid(v, &gid);
-                        if (r < 0)
-                                log_unit_debug(u, "Failed to parse \"%s=%s\", ignoring.", l, v);
-                        else
-                                unit_ref_uid_gid(u, UID_INVALID, gid);
-                        continue;
+        } else if (streq(l, "invocation-id")) {
+                sd_id128_t id;
 
-                } else if (streq(l, "ref")) {
-                        r = strv_extend(&u->deserialized_refs, v);
+                r = sd_id128_from_string(v, &id);
+                if (r < 0)
+                        log_unit_debug(u, "Failed to parse \"%s=%s\", ignoring.", l, v);
+                else {
+                        r = unit_set_invocation_id(u, id);
                         if (r < 0)
-                                return log_oom();
-                        continue;
+                                log_unit_warning_errno(u, r, "Failed to set invocation ID for unit: %m");
+                }
 
-                } else if (streq(l, "invocation-id")) {
-                        sd_id128_t id;
+                return 0;
 
-                        r = sd_id128_from_string(v, &id);
-                        if (r < 0)
-                                log_unit_debug(u, "Failed to parse \"%s=%s\", ignoring.", l, v);
-                        else {
-                                r = unit_set_invocation_id(u, id);
-                                if (r < 0)
-                                        log_unit_warning_errno(u, r, "Failed to set invocation ID for unit: %m");
-                        }
+        } else if (MATCH_DESERIALIZE("freezer-state", l, v, freezer_state_from_string, u->freezer_state))
+                return 0;
 
-                        continue;
+        else if (streq(l, "markers")) {
+                r = deserialize_markers(u, v);
+                if (r < 0)
+                        log_unit_debug_errno(u, r, "Failed to deserialize \"%s=%s\", ignoring: %m", l, v);
+                return 0;
+        }
 
-                } else if (MATCH_DESERIALIZE("freezer-state", l, v, freezer_state_from_string, u->freezer_state))
-                        continue;
+        /* Check if this is an IP accounting metric serialization field */
+        m = string_table_lookup(ip_accounting_metric_field, ELEMENTSOF(ip_accounting_metric_field), l);
+        if (m >= 0) {
+                uint64_t c;
 
-                else if (streq(l, "markers")) {
-                        r = deserialize_markers(u, v);
-                        if (r < 0)
-                                log_unit_debug_errno(u, r, "Failed to deserialize \"%s=%s\", ignoring: %m", l, v);
-                        continue;
-                }
+                r = safe_atou64(v, &c);
+                if (r < 0)
+                        log_unit_debug(u, "Failed to parse IP accounting value %s, ignoring.", v);
+                else
+                        u->ip_accounting_extra[m] = c;
+                return 0;
+        }
 
-                /* Check if this is an IP accounting metric serialization field */
-                m = string_table_lookup(ip_accounting_metric_field, ELEMENTSOF(ip_accounting_metric_field), l);
-                if (m >= 0) {
-                        uint64_t c;
+        m = string_table_lookup(io_accounting_metric_field_base, ELEMENTSOF(io_accounting_metric_field_base), l);
+        if (m >= 0) {
+                uint64_t c;
 
-                        r = safe_atou64(v, &c);
-                        if (r < 0)
-                                log_unit_debug(u, "Failed to parse IP accounting value %s, ignoring.", v);
-                        else
-                                u->ip_accounting_extra[m] = c;
-                        continue;
-                }
+                r = safe_atou64(v, &c);
+                if (r < 0)
+                        log_unit_debug(u, "Failed to parse IO accounting base value %s, ignoring.", v);
+                else
+                        u->io_accounting_base[m] = c;
+                return 0;
+        }
 
-                m = string_table_lookup(io_accounting_metric_field_base, ELEMENTSOF(io_accounting_metric_field_base), l);
-                if (m >= 0) {
-                        uint64_t c;
+        m = string_table_lookup(io_accounting_metric_field_last, ELEMENTSOF(io_accounting_metric_field_last), l);
+        if (m >= 0) {
+                uint64_t c;
 
-                        r = safe_atou64(v, &c);
-                        if (r < 0)
-                                log_unit_debug(u, "Failed to parse IO accounting base value %s, ignoring.", v);
-                        else
-                                u->io_accounting_base[m] = c;
-                        continue;
-                }
+                r = safe_atou64(v, &c);
+                if (r < 0)
+                        log_unit_debug(u, "Failed to parse IO accounting last value %s, ignoring.", v);
+                else
+                        u->io_accounting_last[m] = c;
+                return 0;
+        }
 
-                m = string_table_lookup(io_accounting_metric_field_last, ELEMENTSOF(io_accounting_metric_field_last), l);
-                if (m >= 0) {
-                        uint64_t c;
+        r = exec_runtime_deserialize_compat(u, l, v, fds);
+        if (r < 0) {
+                log_unit_warning(u, "Failed to deserialize runtime parameter '%s', ignoring.", l);
+                return 0;
+        } else if (r > 0)
+                /* Returns positive if key was handled by the call */
+                return 0;
 
-                        r = safe_atou64(v, &c);
-                        if (r < 0)
-                                log_unit_debug(u, "Failed to parse IO accounting last value %s, ignoring.", v);
-                        else
-                                u->io_accounting_last[m] = c;
-                        continue;
-                }
+        if (UNIT_VTABLE(u)->deserialize_item) {
+                r = UNIT_VTABLE(u)->deserialize_item(u, l, v, fds);
+                if (r < 0)
+                        log_unit_warning(u, "Failed to deserialize unit parameter '%s', ignoring.", l);
+        }
 
-                r = exec_runtime_deserialize_compat(u, l, v, fds);
-                if (r < 0) {
-                        log_unit_warning(u, "Failed to deserialize runtime parameter '%s', ignoring.", l);
-                        continue;
-                } else if (r > 0)
-                        /* Returns positive if key was handled by the call */
-                        continue;
+        return 0;
+}
 
-                if (UNIT_VTABLE(u)->deserialize_item) {
-                        r = UNIT_VTABLE(u)->deserialize_item(u, l, v, fds);
-                        if (r < 0)
-                                log_unit_warning(u, "Failed to deserialize unit parameter '%s', ignoring.", l);
-                }
-        }
+static void unit_deserialize_finish(Unit *u) {
+        assert(u);
 
         /* Versions before 228 did not carry a state change timestamp. In this case, take the current
          * time. This is useful, so that timeouts based on this timestamp don't trigger too early, and is
@@ -554,7 +571,88 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                 unit_invalidate_cgroup(u, _CGROUP_MASK_ALL);
                 unit_invalidate_cgroup_bpf(u);
         }
+}
+
+int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
+        int r;
+
+        assert(u);
+        assert(f);
+        assert(fds);
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+                char *l, *v;
+                size_t k;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to read serialization line: %m");
+                if (r == 0) /* eof */
+                        break;
+
+                l = strstrip(line);
+                if (isempty(l)) /* End marker */
+                        break;
+
+                k = strcspn(l, "=");
+
+                if (l[k] == '=') {
+                        l[k] = 0;
+                        v = l+k+1;
+                } else
+                        v = l+k;
+
+                if (streq(l, "job")) {
+                        if (v[0] == '\0') {
+                                /* New-style serialized job */
+                                r = unit_deserialize_job(u, f);
+                                if (r < 0)
+                                        return r;
+                        } else  /* Legacy for pre-44 */
+                                log_unit_warning(u, "Update from too old systemd versions are unsupported, cannot deserialize job: %s", v);
+                        continue;
+                }
+
+                r = unit_deserialize_item(u, l, v, fds);
+                if (r < 0)
+                        return r;
+        }
 
+        unit_deserialize_finish(u);
+        return 0;
+}
+
+int unit_deserialize_record(Unit *u, BinaryRecord *record, FDSet *fds) {
+        const char *l, *v;
+        int r;
+
+        assert(u);
+        assert(record);
+        assert(fds);
+
+        /* Same as unit_deserialize(), but for a record of the binary serialization format, see serialize.h. */
+
+        for (;;) {
+                r = binary_record_next(record, &l, &v);
+                if (r < 0)
+                        return log_unit_error_errno(u, r, "Failed to read serialization item: %m");
+                if (r == 0)
+                        break;
+
+                if (streq(l, "job")) {
+                        r = unit_deserialize_job_record(u, record);
+                        if (r < 0)
+                                return r;
+                        continue;
+                }
+
+                r = unit_deserialize_item(u, l, v, fds);
+                if (r < 0)
+                        return r;
+        }
+
+        unit_deserialize_finish(u);
         return 0;
 }
 
@@ -675,6 +773,9 @@ void unit_dump(Unit *u, FILE *f, const char *prefix) {
                 prefix, yes_no(u->perpetual),
                 prefix, collect_mode_to_string(u->collect_mode));
 
+        if (u->compacted)
+                fprintf(f, "%s\tCompacted: yes (%s freed)\n", prefix, FORMAT_BYTES(u->compacted_size));
+
         if (u->markers != 0) {
                 fprintf(f, "%s\tMarkers:", prefix);
 
@@ -794,21 +895,32 @@ void unit_dump(Unit *u, FILE *f, const char *prefix) {
                         prefix, yes_no(u->assert_result));
 
         for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
-                UnitDependencyInfo di;
-                Unit *other;
+                const UnitDependencyEdge *e;
+
+                if (!FLAGS_SET(u->dependencies.types, UNIT_DEPENDENCY_TYPE_BIT(d)))
+                        continue;
 
-                HASHMAP_FOREACH_KEY(di.data, other, unit_get_dependencies(u, d)) {
+                UNIT_FOREACH_DEPENDENCY_EDGE(e, u) {
                         bool space = false;
 
-                        fprintf(f, "%s\t%s: %s (", prefix, unit_dependency_to_string(d), other->id);
+                        if (e->type != d)
+                                continue;
+
+                        fprintf(f, "%s\t%s: %s (", prefix, unit_dependency_to_string(d), e->other->id);
 
-                        print_unit_dependency_mask(f, "origin", di.origin_mask, &space);
-                        print_unit_dependency_mask(f, "destination", di.destination_mask, &space);
+                        print_unit_dependency_mask(f, "origin", e->origin_mask, &space);
+                        print_unit_dependency_mask(f, "destination", e->destination_mask, &space);
 
                         fputs(")\n", f);
                 }
         }
 
+        if (u->dependencies.n_edges > 0)
+                fprintf(f, "%s\tDependency Edges: %zu (%s%s)\n",
+                        prefix, u->dependencies.n_edges,
+                        FORMAT_BYTES(unit_get_dependency_memory(u)),
+                        u->dependencies.index ? ", indexed" : "");
+
         if (!hashmap_isempty(u->requires_mounts_for)) {
                 UnitDependencyInfo di;
                 const char *path;
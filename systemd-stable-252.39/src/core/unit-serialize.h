@@ -5,9 +5,11 @@
 
 #include "unit.h"
 #include "fdset.h"
+#include "serialize.h"
 
 int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs);
 int unit_deserialize(Unit *u, FILE *f, FDSet *fds);
+int unit_deserialize_record(Unit *u, BinaryRecord *record, FDSet *fds);
 int unit_deserialize_skip(FILE *f);
 
 void unit_dump(Unit *u, FILE *f, const char *prefix);
@@ -55,6 +55,7 @@
 #include "terminal-util.h"
 #include "tmpfile-util.h"
 #include "umask-util.h"
+#include "unit-compact.h"
 #include "unit-name.h"
 #include "unit.h"
 #include "user-util.h"
@@ -106,6 +107,7 @@ Unit* unit_new(Manager *m, size_t size) {
         u->on_success_job_mode = JOB_FAIL;
         u->cgroup_control_inotify_wd = -1;
         u->cgroup_memory_inotify_wd = -1;
+        u->cgroup_dir_fd = -1;
         u->job_timeout = USEC_INFINITY;
         u->job_running_timeout = USEC_INFINITY;
         u->ref_uid = UID_INVALID;
@@ -126,6 +128,10 @@ Unit* unit_new(Manager *m, size_t size) {
 
         u->last_section_private = -1;
 
+        /* Units created while the manager is up and not reloading have no deserialized state to return to,
+         * don't let jobs enqueued during a later incremental reload coldplug them. */
+        u->coldplugged = m->objective != _MANAGER_OBJECTIVE_INVALID && !MANAGER_IS_RELOADING(m);
+
         u->start_ratelimit = (RateLimit) { m->default_start_limit_interval, m->default_start_limit_burst };
         u->auto_start_stop_ratelimit = (RateLimit) { 10 * USEC_PER_SEC, 16 };
 
@@ -157,10 +163,9 @@ bool unit_has_name(const Unit *u, const char *name) {
                set_contains(u->aliases, name);
 }
 
-static void unit_init(Unit *u) {
+static void unit_init_contexts(Unit *u) {
         CGroupContext *cc;
         ExecContext *ec;
-        KillContext *kc;
 
         assert(u);
         assert(u->manager);
@@ -205,6 +210,14 @@ static void unit_init(Unit *u) {
                         (void) get_process_umask(getpid_cached(), &ec->umask);
                 }
         }
+}
+
+static void unit_init(Unit *u) {
+        KillContext *kc;
+
+        assert(u);
+
+        unit_init_contexts(u);
 
         kc = unit_get_kill_context(u);
         if (kc)
@@ -561,26 +574,407 @@ void unit_submit_to_stop_when_bound_queue(Unit *u) {
         u->in_stop_when_bound_queue = true;
 }
 
-static void unit_clear_dependencies(Unit *u) {
-        assert(u);
+/* Units with more edges than this get a hash index on their dependency edges */
+#define UNIT_DEPENDENCY_INDEX_MIN 16U
 
-        /* Removes all dependencies configured on u and their reverse dependencies. */
+static size_t unit_dependency_index_bucket(const UnitDependencies *deps, UnitDependency d, const Unit *other) {
+        uint64_t h;
+
+        assert(deps);
+        assert(deps->n_index > 0);
+
+        /* Pointers are aligned, hence fold the dependency type into the low bits, and let a multiplicative
+         * hash spread the result. */
+        h = ((uint64_t) (uintptr_t) other ^ (uint64_t) d) * UINT64_C(0x9E3779B97F4A7C15);
+
+        return (size_t) (h >> 32) & (deps->n_index - 1);
+}
+
+static unsigned* unit_dependency_index_slot(const UnitDependencies *deps, UnitDependency d, const Unit *other) {
+        assert(deps);
+        assert(deps->index);
+
+        /* Returns the bucket referencing the edge for (d, other), or the empty bucket it would go to. There's
+         * always at least one empty bucket, since the index is never more than half full. */
+
+        for (size_t b = unit_dependency_index_bucket(deps, d, other);; b = (b + 1) & (deps->n_index - 1)) {
+                unsigned k = deps->index[b];
+                const UnitDependencyEdge *e;
+
+                if (k == 0)
+                        return deps->index + b;
+
+                e = deps->edges + k - 1;
+                if (e->type == d && e->other == other)
+                        return deps->index + b;
+        }
+}
+
+static int unit_dependency_index_rebuild(UnitDependencies *deps, size_t n_index) {
+        _cleanup_free_ unsigned *index = NULL;
+
+        assert(deps);
+        assert(ISPOWEROF2(n_index));
+        assert(n_index > deps->n_edges * 2);
+        assert(n_index <= UINT_MAX);
+
+        index = new0(unsigned, n_index);
+        if (!index)
+                return -ENOMEM;
+
+        free_and_replace(deps->index, index);
+        deps->n_index = n_index;
+
+        for (size_t k = 0; k < deps->n_edges; k++)
+                *unit_dependency_index_slot(deps, deps->edges[k].type, deps->edges[k].other) = k + 1;
+
+        return 0;
+}
+
+static void unit_dependency_index_delete(UnitDependencies *deps, size_t k) {
+        const UnitDependencyEdge *e;
+        size_t mask, b;
+
+        assert(deps);
+        assert(deps->index);
+        assert(k < deps->n_edges);
+
+        e = deps->edges + k;
+        mask = deps->n_index - 1;
+        b = unit_dependency_index_slot(deps, e->type, e->other) - deps->index;
+        assert(deps->index[b] == k + 1);
+
+        /* Linear probing without tombstones: close the hole by shifting back later entries of the same probe
+         * run, unless that would move them in front of their home bucket. */
+        for (size_t j = (b + 1) & mask; deps->index[j] != 0; j = (j + 1) & mask) {
+                const UnitDependencyEdge *f = deps->edges + deps->index[j] - 1;
+                size_t h = unit_dependency_index_bucket(deps, f->type, f->other);
+
+                if (((j - h) & mask) >= ((j - b) & mask)) {
+                        deps->index[b] = deps->index[j];
+                        b = j;
+                }
+        }
+
+        deps->index[b] = 0;
+}
+
+static UnitDependencyEdge* unit_dependencies_find(const UnitDependencies *deps, UnitDependency d, const Unit *other) {
+        assert(deps);
+
+        if (!FLAGS_SET(deps->types, UNIT_DEPENDENCY_TYPE_BIT(d)))
+                return NULL;
+
+        if (deps->index) {
+                unsigned k = *unit_dependency_index_slot(deps, d, other);
+
+                return k > 0 ? deps->edges + k - 1 : NULL;
+        }
+
+        for (size_t k = 0; k < deps->n_edges; k++)
+                if (deps->edges[k].type == d && deps->edges[k].other == other)
+                        return deps->edges + k;
+
+        return NULL;
+}
+
+static void unit_dependencies_done(UnitDependencies *deps) {
+        assert(deps);
+
+        deps->edges = mfree(deps->edges);
+        deps->n_edges = 0;
+        deps->index = mfree(deps->index);
+        deps->n_index = 0;
+        deps->types = 0;
+        deps->generation++;
+}
+
+static int unit_dependencies_reserve(UnitDependencies *deps, size_t n_extra) {
+        size_t n, n_index;
+
+        assert(deps);
+
+        /* Makes sure that n_extra edges can be added later on without any allocation */
+
+        n = deps->n_edges + n_extra;
+        if (n == deps->n_edges)
+                return 0;
+
+        if (!GREEDY_REALLOC(deps->edges, n))
+                return -ENOMEM;
+
+        if (n <= UNIT_DEPENDENCY_INDEX_MIN || n * 2 < deps->n_index)
+                return 0;
+
+        n_index = MAX(deps->n_index, (size_t) UNIT_DEPENDENCY_INDEX_MIN * 4);
+        while (n_index <= n * 2)
+                n_index *= 2;
+
+        return unit_dependency_index_rebuild(deps, n_index);
+}
+
+static int unit_dependencies_update(
+                UnitDependencies *deps,
+                UnitDependency d,
+                Unit *other,
+                UnitDependencyMask origin_mask,
+                UnitDependencyMask destination_mask) {
+
+        UnitDependencyEdge *e;
+        int r;
+
+        assert(deps);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+        assert(other);
+        assert(origin_mask < _UNIT_DEPENDENCY_MASK_FULL);
+        assert(destination_mask < _UNIT_DEPENDENCY_MASK_FULL);
+        assert(origin_mask > 0 || destination_mask > 0);
+
+        /* Acquire the edge for the dependency type and Unit* we are interested in, and update its masks if
+         * it exists, or append it anew if not. */
+
+        e = unit_dependencies_find(deps, d, other);
+        if (e) {
+                /* Entry already exists. Add in our mask. */
+
+                if (FLAGS_SET(e->origin_mask, origin_mask) &&
+                    FLAGS_SET(e->destination_mask, destination_mask))
+                        return 0; /* NOP */
+
+                e->origin_mask |= origin_mask;
+                e->destination_mask |= destination_mask;
+                return 1;
+        }
+
+        r = unit_dependencies_reserve(deps, 1);
+        if (r < 0)
+                return r;
+
+        deps->edges[deps->n_edges] = (UnitDependencyEdge) {
+                .other = other,
+                .type = d,
+                .origin_mask = origin_mask,
+                .destination_mask = destination_mask,
+        };
+
+        if (deps->index)
+                *unit_dependency_index_slot(deps, d, other) = deps->n_edges + 1;
+
+        deps->n_edges++;
+        deps->types |= UNIT_DEPENDENCY_TYPE_BIT(d);
+        deps->generation++;
+
+        return 1;
+}
+
+static void unit_dependencies_remove(UnitDependencies *deps, UnitDependencyEdge *e) {
+        size_t k, last;
 
-        for (Hashmap *deps; (deps = hashmap_steal_first(u->dependencies));) {
+        assert(deps);
+        assert(e);
+
+        /* Drops the edge by moving the last one into its place. Note that this means that iterating through
+         * the edges needs to go backwards if edges are removed on the way. The arrays are kept even if the
+         * last edge is removed, so that space reserved with unit_dependencies_reserve() stays available. */
+
+        k = e - deps->edges;
+        assert(k < deps->n_edges);
+        last = deps->n_edges - 1;
+
+        if (deps->index) {
+                unit_dependency_index_delete(deps, k);
+
+                if (k != last)
+                        *unit_dependency_index_slot(deps, deps->edges[last].type, deps->edges[last].other) = k + 1;
+        }
+
+        if (k != last)
+                deps->edges[k] = deps->edges[last];
+
+        deps->n_edges--;
+        if (deps->n_edges == 0)
+                deps->types = 0;
+        deps->generation++;
+}
+
+static void unit_dependencies_retarget(UnitDependencies *deps, Unit *from, Unit *to) {
+        assert(deps);
+        assert(from);
+        assert(to);
 
-                for (Unit *other; (other = hashmap_steal_first_key(deps));) {
-                        Hashmap *other_deps;
+        /* Changes all edges pointing to 'from' to point to 'to' instead. Never needs to allocate. */
 
-                        HASHMAP_FOREACH(other_deps, other->dependencies)
-                                hashmap_remove(other_deps, u);
+        for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                UnitDependencyEdge *e, *f;
+                size_t k;
 
-                        unit_add_to_gc_queue(other);
+                e = unit_dependencies_find(deps, d, from);
+                if (!e)
+                        continue;
+
+                f = unit_dependencies_find(deps, d, to);
+                if (f) {
+                        f->origin_mask |= e->origin_mask;
+                        f->destination_mask |= e->destination_mask;
+                        unit_dependencies_remove(deps, e);
+                        continue;
                 }
 
-                hashmap_free(deps);
+                k = e - deps->edges;
+                if (deps->index)
+                        unit_dependency_index_delete(deps, k);
+
+                e->other = to;
+                deps->generation++;
+
+                if (deps->index)
+                        *unit_dependency_index_slot(deps, d, to) = k + 1;
+        }
+}
+
+static void unit_dependencies_remove_destination_mask(UnitDependencies *deps, Unit *other, UnitDependencyMask mask) {
+        assert(deps);
+        assert(other);
+
+        /* Drops 'mask' from the destination masks of all edges pointing to 'other', and the edges
+         * themselves if no bit is left. */
+
+        for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                UnitDependencyEdge *e;
+
+                e = unit_dependencies_find(deps, d, other);
+                if (!e || FLAGS_SET(~mask, e->destination_mask))
+                        continue;
+
+                e->destination_mask &= ~mask;
+                if (e->origin_mask == 0 && e->destination_mask == 0)
+                        unit_dependencies_remove(deps, e);
+        }
+}
+
+static void unit_dependencies_remove_unit(UnitDependencies *deps, Unit *other) {
+        assert(deps);
+        assert(other);
+
+        for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                UnitDependencyEdge *e;
+
+                e = unit_dependencies_find(deps, d, other);
+                if (e)
+                        unit_dependencies_remove(deps, e);
+        }
+}
+
+const UnitDependencyEdge* unit_find_dependency(const Unit *u, UnitDependency d, const Unit *other) {
+        assert(u);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+        assert(other);
+
+        return unit_dependencies_find(&u->dependencies, d, other);
+}
+
+size_t unit_get_dependency_memory(const Unit *u) {
+        assert(u);
+
+        return MALLOC_SIZEOF_SAFE(u->dependencies.edges) + MALLOC_SIZEOF_SAFE(u->dependencies.index);
+}
+
+static const UnitDependencyAtom pull_in_atom_table[_UNIT_PULL_IN_MAX] = {
+        [UNIT_PULL_IN_START]             = UNIT_ATOM_PULL_IN_START,
+        [UNIT_PULL_IN_START_IGNORED]     = UNIT_ATOM_PULL_IN_START_IGNORED,
+        [UNIT_PULL_IN_VERIFY]            = UNIT_ATOM_PULL_IN_VERIFY,
+        [UNIT_PULL_IN_STOP]              = UNIT_ATOM_PULL_IN_STOP,
+        [UNIT_PULL_IN_STOP_IGNORED]      = UNIT_ATOM_PULL_IN_STOP_IGNORED,
+        [UNIT_PULL_IN_PROPAGATE_STOP]    = UNIT_ATOM_PROPAGATE_STOP,
+        [UNIT_PULL_IN_PROPAGATE_RESTART] = UNIT_ATOM_PROPAGATE_RESTART,
+};
+
+int unit_update_pull_in(Unit *u) {
+        uint64_t types[_UNIT_PULL_IN_MAX];
+        _cleanup_free_ Unit **array = NULL;
+        size_t n = 0;
+
+        assert(u);
+
+        /* (Re-)builds the list of units pulled into transactions by jobs for this unit, unless it is still
+         * up-to-date. The order is the same UNIT_FOREACH_DEPENDENCY() would yield them in, and a unit is
+         * listed once for every dependency type it is pulled in by, so that the transaction looks exactly
+         * the same as when going through the dependencies directly. */
+
+        if (u->pull_in_generation == u->dependencies.generation + 1)
+                return 0;
+
+        for (UnitPullIn p = 0; p < _UNIT_PULL_IN_MAX; p++) {
+                types[p] = unit_dependency_types_from_atom(pull_in_atom_table[p]) & u->dependencies.types;
+
+                for (size_t k = 0; types[p] != 0 && k < u->dependencies.n_edges; k++)
+                        if (FLAGS_SET(types[p], UNIT_DEPENDENCY_TYPE_BIT(u->dependencies.edges[k].type)))
+                                n++;
+        }
+
+        assert(n <= UINT_MAX);
+
+        if (n > 0) {
+                array = new(Unit*, n);
+                if (!array)
+                        return -ENOMEM;
+        }
+
+        n = 0;
+        for (UnitPullIn p = 0; p < _UNIT_PULL_IN_MAX; p++) {
+                u->pull_in_offsets[p] = n;
+
+                for (size_t k = 0; types[p] != 0 && k < u->dependencies.n_edges; k++)
+                        if (FLAGS_SET(types[p], UNIT_DEPENDENCY_TYPE_BIT(u->dependencies.edges[k].type)))
+                                array[n++] = u->dependencies.edges[k].other;
+        }
+        u->pull_in_offsets[_UNIT_PULL_IN_MAX] = n;
+
+        free_and_replace(u->pull_in, array);
+        u->pull_in_generation = u->dependencies.generation + 1;
+
+        return 0;
+}
+
+int unit_pull_in_at(Unit *u, UnitPullIn p, size_t i, Unit **ret) {
+        int r;
+
+        assert(u);
+        assert(p >= 0 && p < _UNIT_PULL_IN_MAX);
+        assert(ret);
+
+        /* Returns > 0 and the i-th unit pulled in the specified way, 0 if there are no more, or a negative
+         * errno if the list needed to be rebuilt (because the dependencies changed while iterating) and that
+         * failed. */
+        r = unit_update_pull_in(u);
+        if (r < 0) {
+                *ret = NULL;
+                return r;
+        }
+
+        if (i >= u->pull_in_offsets[p + 1] - u->pull_in_offsets[p]) {
+                *ret = NULL;
+                return 0;
+        }
+
+        *ret = u->pull_in[u->pull_in_offsets[p] + i];
+        return 1;
+}
+
+static void unit_clear_dependencies(Unit *u) {
+        assert(u);
+
+        /* Removes all dependencies configured on u and their reverse dependencies. */
+
+        for (size_t k = 0; k < u->dependencies.n_edges; k++) {
+                Unit *other = u->dependencies.edges[k].other;
+
+                unit_dependencies_remove_unit(&other->dependencies, u);
+                unit_add_to_gc_queue(other);
         }
 
-        u->dependencies = hashmap_free(u->dependencies);
+        unit_dependencies_done(&u->dependencies);
+        u->pull_in = mfree(u->pull_in);
 }
 
 static void unit_remove_transient(Unit *u) {
@@ -644,6 +1038,28 @@ static void unit_free_requires_mounts_for(Unit *u) {
         u->requires_mounts_for = hashmap_free(u->requires_mounts_for);
 }
 
+void unit_reset_contexts(Unit *u) {
+        ExecContext *ec;
+        CGroupContext *cc;
+
+        assert(u);
+
+        /* Drops all settings from the exec and cgroup contexts of the unit, and puts them back into the
+         * state they are in before the unit files are loaded. */
+
+        ec = unit_get_exec_context(u);
+        if (ec) {
+                exec_context_done(ec);
+                *ec = (ExecContext) {};
+        }
+
+        cc = unit_get_cgroup_context(u);
+        if (cc)
+                cgroup_context_done(cc);
+
+        unit_init_contexts(u);
+}
+
 static void unit_done(Unit *u) {
         ExecContext *ec;
         CGroupContext *cc;
@@ -800,6 +1216,8 @@ Unit* unit_free(Unit *u) {
         free(u->fragment_path);
         free(u->source_path);
         strv_free(u->dropin_paths);
+        strv_free(u->dependency_dropin_paths);
+        strv_free(u->compacted_files);
         free(u->instance);
 
         free(u->job_timeout_reboot_arg);
@@ -893,50 +1311,14 @@ static int unit_merge_names(Unit *u, Unit *other) {
 }
 
 static int unit_reserve_dependencies(Unit *u, Unit *other) {
-        size_t n_reserve;
-        Hashmap* deps;
-        void *d;
-        int r;
-
         assert(u);
         assert(other);
 
-        /* Let's reserve some space in the dependency hashmaps so that later on merging the units cannot
-         * fail.
-         *
-         * First make some room in the per dependency type hashmaps. Using the summed size of both units'
-         * hashmaps is an estimate that is likely too high since they probably use some of the same
-         * types. But it's never too low, and that's all we need. */
-
-        n_reserve = MIN(hashmap_size(other->dependencies), LESS_BY((size_t) _UNIT_DEPENDENCY_MAX, hashmap_size(u->dependencies)));
-        if (n_reserve > 0) {
-                r = hashmap_ensure_allocated(&u->dependencies, NULL);
-                if (r < 0)
-                        return r;
-
-                r = hashmap_reserve(u->dependencies, n_reserve);
-                if (r < 0)
-                        return r;
-        }
-
-        /* Now, enlarge our per dependency type hashmaps by the number of entries in the same hashmap of the
-         * other unit's dependencies.
-         *
-         * NB: If u does not have a dependency set allocated for some dependency type, there is no need to
-         * reserve anything for. In that case other's set will be transferred as a whole to u by
-         * complete_move(). */
-
-        HASHMAP_FOREACH_KEY(deps, d, u->dependencies) {
-                Hashmap *other_deps;
-
-                other_deps = hashmap_get(other->dependencies, d);
-
-                r = hashmap_reserve(deps, hashmap_size(other_deps));
-                if (r < 0)
-                        return r;
-        }
+        /* Let's reserve some space in the dependency array and index so that later on merging the units
+         * cannot fail. Fixing up the edges of third units pointing to 'other' never needs to allocate, and
+         * the edges of 'other' are appended to those of 'u' at most once each. */
 
-        return 0;
+        return unit_dependencies_reserve(&u->dependencies, other->dependencies.n_edges);
 }
 
 static bool unit_should_warn_about_dependency(UnitDependency dependency) {
@@ -952,172 +1334,58 @@ static bool unit_should_warn_about_dependency(UnitDependency dependency) {
                       UNIT_TRIGGERED_BY);
 }
 
-static int unit_per_dependency_type_hashmap_update(
-                Hashmap *per_type,
-                Unit *other,
-                UnitDependencyMask origin_mask,
-                UnitDependencyMask destination_mask) {
-
-        UnitDependencyInfo info;
-        int r;
-
-        assert(other);
-        assert_cc(sizeof(void*) == sizeof(info));
-
-        /* Acquire the UnitDependencyInfo entry for the Unit* we are interested in, and update it if it
-         * exists, or insert it anew if not. */
-
-        info.data = hashmap_get(per_type, other);
-        if (info.data) {
-                /* Entry already exists. Add in our mask. */
-
-                if (FLAGS_SET(origin_mask, info.origin_mask) &&
-                    FLAGS_SET(destination_mask, info.destination_mask))
-                        return 0; /* NOP */
-
-                info.origin_mask |= origin_mask;
-                info.destination_mask |= destination_mask;
-
-                r = hashmap_update(per_type, other, info.data);
-        } else {
-                info = (UnitDependencyInfo) {
-                        .origin_mask = origin_mask,
-                        .destination_mask = destination_mask,
-                };
-
-                r = hashmap_put(per_type, other, info.data);
-        }
-        if (r < 0)
-                return r;
-
-        return 1;
-}
-
-static int unit_add_dependency_hashmap(
-                Hashmap **dependencies,
-                UnitDependency d,
-                Unit *other,
-                UnitDependencyMask origin_mask,
-                UnitDependencyMask destination_mask) {
-
-        Hashmap *per_type;
-        int r;
-
-        assert(dependencies);
-        assert(other);
-        assert(origin_mask < _UNIT_DEPENDENCY_MASK_FULL);
-        assert(destination_mask < _UNIT_DEPENDENCY_MASK_FULL);
-        assert(origin_mask > 0 || destination_mask > 0);
-
-        /* Ensure the top-level dependency hashmap exists that maps UnitDependency → Hashmap(Unit* →
-         * UnitDependencyInfo) */
-        r = hashmap_ensure_allocated(dependencies, NULL);
-        if (r < 0)
-                return r;
-
-        /* Acquire the inner hashmap, that maps Unit* → UnitDependencyInfo, for the specified dependency
-         * type, and if it's missing allocate it and insert it. */
-        per_type = hashmap_get(*dependencies, UNIT_DEPENDENCY_TO_PTR(d));
-        if (!per_type) {
-                per_type = hashmap_new(NULL);
-                if (!per_type)
-                        return -ENOMEM;
-
-                r = hashmap_put(*dependencies, UNIT_DEPENDENCY_TO_PTR(d), per_type);
-                if (r < 0) {
-                        hashmap_free(per_type);
-                        return r;
-                }
-        }
-
-        return unit_per_dependency_type_hashmap_update(per_type, other, origin_mask, destination_mask);
-}
-
 static void unit_merge_dependencies(Unit *u, Unit *other) {
-        Hashmap *deps;
-        void *dt; /* Actually of type UnitDependency, except that we don't bother casting it here,
-                   * since the hashmaps all want it as void pointer. */
-
         assert(u);
         assert(other);
 
         if (u == other)
                 return;
 
-        /* First, remove dependency to other. */
-        HASHMAP_FOREACH_KEY(deps, dt, u->dependencies) {
-                if (hashmap_remove(deps, other) && unit_should_warn_about_dependency(UNIT_DEPENDENCY_FROM_PTR(dt)))
+        /* First, remove dependency to other. Go backwards, as removing an edge moves the last one into its
+         * place. */
+        for (size_t k = u->dependencies.n_edges; k > 0; k--) {
+                UnitDependencyEdge *e = u->dependencies.edges + k - 1;
+
+                if (e->other != other)
+                        continue;
+
+                if (unit_should_warn_about_dependency(e->type))
                         log_unit_warning(u, "Dependency %s=%s is dropped, as %s is merged into %s.",
-                                         unit_dependency_to_string(UNIT_DEPENDENCY_FROM_PTR(dt)),
+                                         unit_dependency_to_string(e->type),
                                          other->id, other->id, u->id);
 
-                if (hashmap_isempty(deps))
-                        hashmap_free(hashmap_remove(u->dependencies, dt));
+                unit_dependencies_remove(&u->dependencies, e);
         }
 
-        for (;;) {
-                _cleanup_(hashmap_freep) Hashmap *other_deps = NULL;
-                UnitDependencyInfo di_back;
-                Unit *back;
-
-                /* Let's focus on one dependency type at a time, that 'other' has defined. */
-                other_deps = hashmap_steal_first_key_and_value(other->dependencies, &dt);
-                if (!other_deps)
-                        break; /* done! */
-
-                deps = hashmap_get(u->dependencies, dt);
-
-                /* Now iterate through all dependencies of this dependency type, of 'other'. We refer to the
-                 * referenced units as 'back'. */
-                HASHMAP_FOREACH_KEY(di_back.data, back, other_deps) {
-                        Hashmap *back_deps;
-                        void *back_dt;
-
-                        if (back == u) {
-                                /* This is a dependency pointing back to the unit we want to merge with?
-                                 * Suppress it (but warn) */
-                                if (unit_should_warn_about_dependency(UNIT_DEPENDENCY_FROM_PTR(dt)))
-                                        log_unit_warning(u, "Dependency %s=%s in %s is dropped, as %s is merged into %s.",
-                                                         unit_dependency_to_string(UNIT_DEPENDENCY_FROM_PTR(dt)),
-                                                         u->id, other->id, other->id, u->id);
-
-                                hashmap_remove(other_deps, back);
-                                continue;
-                        }
-
-                        /* Now iterate through all deps of 'back', and fix the ones pointing to 'other' to
-                         * point to 'u' instead. */
-                        HASHMAP_FOREACH_KEY(back_deps, back_dt, back->dependencies) {
-                                UnitDependencyInfo di_move;
-
-                                di_move.data = hashmap_remove(back_deps, other);
-                                if (!di_move.data)
-                                        continue;
-
-                                assert_se(unit_per_dependency_type_hashmap_update(
-                                                          back_deps,
-                                                          u,
-                                                          di_move.origin_mask,
-                                                          di_move.destination_mask) >= 0);
-                        }
+        /* Now iterate through all dependencies of 'other'. We refer to the referenced units as 'back'. */
+        for (size_t k = 0; k < other->dependencies.n_edges; k++) {
+                const UnitDependencyEdge *e = other->dependencies.edges + k;
+                Unit *back = e->other;
 
-                        /* The target unit already has dependencies of this type, let's then merge this individually. */
-                        if (deps)
-                                assert_se(unit_per_dependency_type_hashmap_update(
-                                                          deps,
-                                                          back,
-                                                          di_back.origin_mask,
-                                                          di_back.destination_mask) >= 0);
+                if (back == u) {
+                        /* This is a dependency pointing back to the unit we want to merge with?
+                         * Suppress it (but warn) */
+                        if (unit_should_warn_about_dependency(e->type))
+                                log_unit_warning(u, "Dependency %s=%s in %s is dropped, as %s is merged into %s.",
+                                                 unit_dependency_to_string(e->type),
+                                                 u->id, other->id, other->id, u->id);
+                        continue;
                 }
 
-                /* Now all references towards 'other' of the current type 'dt' are corrected to point to 'u'.
-                 * Lets's now move the deps of type 'dt' from 'other' to 'u'. If the unit does not have
-                 * dependencies of this type, let's move them per type wholesale. */
-                if (!deps)
-                        assert_se(hashmap_put(u->dependencies, dt, TAKE_PTR(other_deps)) >= 0);
+                /* Fix the deps of 'back' pointing to 'other' to point to 'u' instead. */
+                unit_dependencies_retarget(&back->dependencies, other, u);
+
+                /* And move the edge itself over to 'u'. Space for this has been reserved by
+                 * unit_reserve_dependencies() already. */
+                assert_se(unit_dependencies_update(
+                                          &u->dependencies,
+                                          e->type,
+                                          back,
+                                          e->origin_mask,
+                                          e->destination_mask) >= 0);
         }
 
-        other->dependencies = hashmap_free(other->dependencies);
+        unit_dependencies_done(&other->dependencies);
 }
 
 int unit_merge(Unit *u, Unit *other) {
@@ -1576,7 +1844,8 @@ static int unit_add_oomd_dependencies(Unit *u) {
 }
 
 static int unit_add_startup_units(Unit *u) {
-        if (!unit_has_startup_cgroup_constraints(u))
+        /* Units on the critical path get different weights while booting, too */
+        if (!unit_has_startup_cgroup_constraints(u) && !unit_on_critical_path(u))
                 return 0;
 
         return set_ensure_put(&u->manager->startup_units, NULL, u);
@@ -1922,6 +2191,11 @@ int unit_start(Unit *u, ActivationDetails *details) {
                 return unit_start(following, details);
         }
 
+        /* If the configuration was dropped while the unit was inactive, read it back in first */
+        r = unit_expand(u);
+        if (r < 0)
+                return r;
+
         /* Check our ability to start early so that failure conditions don't cause us to enter a busy loop. */
         if (UNIT_VTABLE(u)->can_start) {
                 r = UNIT_VTABLE(u)->can_start(u);
@@ -2855,6 +3129,15 @@ int unit_watch_pid(Unit *u, pid_t pid, bool exclusive) {
         if (r < 0)
                 return r;
 
+        /* Exclusive watches are used for the processes we just forked off ourselves. Track those via a pidfd
+         * too, so that we can pick up their exit without scanning all our children. Other processes might
+         * not be our children and are left to SIGCHLD and cgroup empty handling. */
+        if (exclusive) {
+                r = manager_watch_pidfd(u->manager, pid);
+                if (r < 0)
+                        log_unit_debug_errno(u, r, "Failed to watch pidfd of process " PID_FMT ", ignoring: %m", pid);
+        }
+
         return 0;
 }
 
@@ -2885,6 +3168,11 @@ void unit_unwatch_pid(Unit *u, pid_t pid) {
                 }
         }
 
+        /* If nobody is interested in the PID anymore, release its pidfd too */
+        if (!hashmap_contains(u->manager->watch_pids, PID_TO_PTR(pid)) &&
+            !hashmap_contains(u->manager->watch_pids, PID_TO_PTR(-pid)))
+                manager_unwatch_pidfd(u->manager, pid);
+
         (void) set_remove(u->pids, PID_TO_PTR(pid));
 }
 
@@ -3124,25 +3412,25 @@ int unit_add_dependency(
                 return log_unit_error_errno(u, SYNTHETIC_ERRNO(EINVAL),
                                             "Requested dependency SliceOf=%s refused (%s is not a cgroup unit).", other->id, other->id);
 
-        r = unit_add_dependency_hashmap(&u->dependencies, d, other, mask, 0);
+        r = unit_dependencies_update(&u->dependencies, d, other, mask, 0);
         if (r < 0)
                 return r;
         notify = r > 0;
 
         if (inverse_table[d] != _UNIT_DEPENDENCY_INVALID && inverse_table[d] != d) {
-                r = unit_add_dependency_hashmap(&other->dependencies, inverse_table[d], u, 0, mask);
+                r = unit_dependencies_update(&other->dependencies, inverse_table[d], u, 0, mask);
                 if (r < 0)
                         return r;
                 notify_other = r > 0;
         }
 
         if (add_reference) {
-                r = unit_add_dependency_hashmap(&u->dependencies, UNIT_REFERENCES, other, mask, 0);
+                r = unit_dependencies_update(&u->dependencies, UNIT_REFERENCES, other, mask, 0);
                 if (r < 0)
                         return r;
                 notify = notify || r > 0;
 
-                r = unit_add_dependency_hashmap(&other->dependencies, UNIT_REFERENCED_BY, u, 0, mask);
+                r = unit_dependencies_update(&other->dependencies, UNIT_REFERENCED_BY, u, 0, mask);
                 if (r < 0)
                         return r;
                 notify_other = notify_other || r > 0;
@@ -5076,6 +5364,9 @@ int unit_set_exec_params(Unit *u, ExecParameters *p) {
         p->cgroup_path = u->cgroup_path;
         SET_FLAG(p->flags, EXEC_CGROUP_DELEGATE, unit_cgroup_delegate(u));
 
+        p->mount_ns_storage_socket = manager_get_mount_namespace_templates(u->manager);
+        p->boot_trace = u->manager->boot_trace;
+
         p->received_credentials_directory = u->manager->received_credentials_directory;
         p->received_encrypted_credentials_directory = u->manager->received_encrypted_credentials_directory;
 
@@ -5145,20 +5436,7 @@ int unit_fork_and_watch_rm_rf(Unit *u, char **paths, pid_t *ret_pid) {
         return 0;
 }
 
-static void unit_update_dependency_mask(Hashmap *deps, Unit *other, UnitDependencyInfo di) {
-        assert(deps);
-        assert(other);
-
-        if (di.origin_mask == 0 && di.destination_mask == 0)
-                /* No bit set anymore, let's drop the whole entry */
-                assert_se(hashmap_remove(deps, other));
-        else
-                /* Mask was reduced, let's update the entry */
-                assert_se(hashmap_update(deps, other, di.data) == 0);
-}
-
 void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
-        Hashmap *deps;
         assert(u);
 
         /* Removes all dependencies u has on other units marked for ownership by 'mask'. */
@@ -5166,50 +5444,29 @@ void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
         if (mask == 0)
                 return;
 
-        HASHMAP_FOREACH(deps, u->dependencies) {
-                bool done;
-
-                do {
-                        UnitDependencyInfo di;
-                        Unit *other;
-
-                        done = true;
-
-                        HASHMAP_FOREACH_KEY(di.data, other, deps) {
-                                Hashmap *other_deps;
-
-                                if (FLAGS_SET(~mask, di.origin_mask))
-                                        continue;
-
-                                di.origin_mask &= ~mask;
-                                unit_update_dependency_mask(deps, other, di);
-
-                                /* We updated the dependency from our unit to the other unit now. But most
-                                 * dependencies imply a reverse dependency. Hence, let's delete that one
-                                 * too. For that we go through all dependency types on the other unit and
-                                 * delete all those which point to us and have the right mask set. */
+        /* Go backwards, as removing an edge moves the last one into its place */
+        for (size_t k = u->dependencies.n_edges; k > 0; k--) {
+                UnitDependencyEdge *e = u->dependencies.edges + k - 1;
+                Unit *other = e->other;
 
-                                HASHMAP_FOREACH(other_deps, other->dependencies) {
-                                        UnitDependencyInfo dj;
-
-                                        dj.data = hashmap_get(other_deps, u);
-                                        if (FLAGS_SET(~mask, dj.destination_mask))
-                                                continue;
-
-                                        dj.destination_mask &= ~mask;
-                                        unit_update_dependency_mask(other_deps, u, dj);
-                                }
+                if (FLAGS_SET(~mask, e->origin_mask))
+                        continue;
 
-                                unit_add_to_gc_queue(other);
+                e->origin_mask &= ~mask;
+                if (e->origin_mask == 0 && e->destination_mask == 0)
+                        /* No bit set anymore, let's drop the whole entry */
+                        unit_dependencies_remove(&u->dependencies, e);
 
-                                /* The unit 'other' may not be wanted by the unit 'u'. */
-                                unit_submit_to_stop_when_unneeded_queue(other);
+                /* We updated the dependency from our unit to the other unit now. But most dependencies
+                 * imply a reverse dependency. Hence, let's delete that one too. For that we go through all
+                 * dependency types on the other unit and delete all those which point to us and have the
+                 * right mask set. */
+                unit_dependencies_remove_destination_mask(&other->dependencies, u, mask);
 
-                                done = false;
-                                break;
-                        }
+                unit_add_to_gc_queue(other);
 
-                } while (!done);
+                /* The unit 'other' may not be wanted by the unit 'u'. */
+                unit_submit_to_stop_when_unneeded_queue(other);
         }
 }
 
@@ -5760,16 +6017,29 @@ void unit_destroy_runtime_data(Unit *u, const ExecContext *context) {
         assert(u);
         assert(context);
 
+        bool flush = false;
+
         if (context->runtime_directory_preserve_mode == EXEC_PRESERVE_NO ||
-            (context->runtime_directory_preserve_mode == EXEC_PRESERVE_RESTART && !unit_will_restart(u)))
+            (context->runtime_directory_preserve_mode == EXEC_PRESERVE_RESTART && !unit_will_restart(u))) {
                 exec_context_destroy_runtime_directory(context, u->manager->prefix[EXEC_DIRECTORY_RUNTIME]);
+                flush = context->directories[EXEC_DIRECTORY_RUNTIME].n_items > 0;
+        }
 
         exec_context_destroy_credentials(context, u->manager->prefix[EXEC_DIRECTORY_RUNTIME], u->id);
+        if (exec_context_has_credentials(context))
+                flush = true;
+
         exec_context_destroy_mount_ns_dir(u);
+
+        /* Mount namespace templates might still reference the directories we just removed, make sure they
+         * are not used for the next start, which will create new ones. */
+        if (flush)
+                manager_flush_mount_namespace_templates(u->manager);
 }
 
 int unit_clean(Unit *u, ExecCleanMask mask) {
         UnitActiveState state;
+        int r;
 
         assert(u);
 
@@ -5797,6 +6067,13 @@ int unit_clean(Unit *u, ExecCleanMask mask) {
         if (!IN_SET(state, UNIT_INACTIVE))
                 return -EBUSY;
 
+        r = unit_expand(u);
+        if (r < 0)
+                return r;
+
+        /* The directories are about to be removed, don't let mount namespace templates keep them around */
+        manager_flush_mount_namespace_templates(u->manager);
+
         return UNIT_VTABLE(u)->clean(u, mask);
 }
 
@@ -5927,6 +6204,20 @@ Unit* unit_has_dependency(const Unit *u, UnitDependencyAtom atom, Unit *other) {
          * NULL checks if the unit has *any* dependency of that atom. Returns 'other' if found (or if 'other'
          * is NULL the first entry found), or NULL if not found. */
 
+        if (other && u->dependencies.index) {
+                uint64_t types;
+
+                /* Look up the edges to 'other' directly, rather than going through all of them */
+                types = unit_dependency_types_from_atom(atom) & u->dependencies.types;
+
+                for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
+                        if (FLAGS_SET(types, UNIT_DEPENDENCY_TYPE_BIT(d)) &&
+                            unit_dependencies_find(&u->dependencies, d, other))
+                                return other;
+
+                return NULL;
+        }
+
         UNIT_FOREACH_DEPENDENCY(i, u, atom)
                 if (!other || other == i)
                         return i;
@@ -107,6 +107,55 @@ typedef union UnitDependencyInfo {
         } _packed_;
 } UnitDependencyInfo;
 
+/* A unit's dependencies are stored as one flat array of edges, one for each pair of dependency type and other
+ * unit, each carrying the masks of why the dependency exists. That's a lot more compact than a hashmap per
+ * dependency type, and cheap to iterate through. Units with many dependencies (think shutdown.target, which
+ * almost every unit conflicts with) additionally get an open addressing hash index on the pair, so that
+ * adding, looking up and removing individual edges stays cheap for them too. */
+typedef struct UnitDependencyEdge {
+        Unit *other;
+        UnitDependencyMask origin_mask:16;
+        UnitDependencyMask destination_mask:16;
+        UnitDependency type:8;
+} UnitDependencyEdge;
+
+typedef struct UnitDependencies {
+        UnitDependencyEdge *edges;
+        size_t n_edges;
+
+        /* Maps (type, other) to the edge's position in the array plus one, 0 marks an empty bucket. Only
+         * allocated once a unit has more edges than a linear search can handle quickly. n_index is always a
+         * power of two, and the index is kept at most half full. */
+        unsigned *index;
+        size_t n_index;
+
+        /* Bit mask of the dependency types used by the edges, bit 'd' for UnitDependency 'd'. Bits are not
+         * cleared when edges are removed (except when no edges are left at all), hence this may be a superset
+         * of the types actually in use. */
+        uint64_t types;
+
+        /* Bumped whenever an edge is added or removed, or points to a different unit (but not when only
+         * its masks change), so that data derived from the edges can be cached. */
+        unsigned generation;
+} UnitDependencies;
+
+#define UNIT_DEPENDENCY_TYPE_BIT(d) (UINT64_C(1) << (d))
+
+/* The ways a job for a unit pulls jobs for other units into a transaction, each corresponding to one
+ * dependency atom. The transaction builder expands the same units over and over again, hence the other units
+ * are cached per unit and way, see unit_pull_in_at(). */
+typedef enum UnitPullIn {
+        UNIT_PULL_IN_START,
+        UNIT_PULL_IN_START_IGNORED,
+        UNIT_PULL_IN_VERIFY,
+        UNIT_PULL_IN_STOP,
+        UNIT_PULL_IN_STOP_IGNORED,
+        UNIT_PULL_IN_PROPAGATE_STOP,
+        UNIT_PULL_IN_PROPAGATE_RESTART,
+        _UNIT_PULL_IN_MAX,
+        _UNIT_PULL_IN_INVALID = -EINVAL,
+} UnitPullIn;
+
 /* Store information about why a unit was activated.
  * We start with trigger units (.path/.timer), eventually it will be expanded to include more metadata. */
 typedef struct ActivationDetails {
@@ -176,16 +225,6 @@ static inline const ActivationDetailsVTable* ACTIVATION_DETAILS_VTABLE(const Act
         return activation_details_vtable[a->trigger_unit_type];
 }
 
-/* Newer LLVM versions don't like implicit casts from large pointer types to smaller enums, hence let's add
- * explicit type-safe helpers for that. */
-static inline UnitDependency UNIT_DEPENDENCY_FROM_PTR(const void *p) {
-        return PTR_TO_INT(p);
-}
-
-static inline void* UNIT_DEPENDENCY_TO_PTR(UnitDependency d) {
-        return INT_TO_PTR(d);
-}
-
 #include "job.h"
 
 struct UnitRef {
@@ -209,10 +248,15 @@ typedef struct Unit {
 
         Set *aliases; /* All the other names. */
 
-        /* For each dependency type we can look up another Hashmap with this, whose key is a Unit* object,
-         * and whose value encodes why the dependency exists, using the UnitDependencyInfo type. i.e. a
-         * Hashmap(UnitDependency → Hashmap(Unit* → UnitDependencyInfo)) */
-        Hashmap *dependencies;
+        /* All dependencies of this unit on other units, and why they exist, see UnitDependencies above */
+        UnitDependencies dependencies;
+
+        /* The units pulled into a transaction by jobs for this unit, for all UnitPullIn values in one array,
+         * the ones for UnitPullIn 'p' starting at pull_in_offsets[p]. Valid if pull_in_generation is the
+         * generation of the dependencies plus one. */
+        Unit **pull_in;
+        unsigned pull_in_offsets[_UNIT_PULL_IN_MAX + 1];
+        unsigned pull_in_generation;
 
         /* Similar, for RequiresMountsFor= path dependencies. The key is the path, the value the
          * UnitDependencyInfo type */
@@ -229,6 +273,7 @@ typedef struct Unit {
         char *fragment_path; /* if loaded from a config file this is the primary path to it */
         char *source_path; /* if converted, the source file */
         char **dropin_paths;
+        char **dependency_dropin_paths; /* the .wants/ and .requires/ symlinks found when loading */
 
         usec_t fragment_not_found_timestamp_hash;
         usec_t fragment_mtime;
@@ -281,6 +326,17 @@ typedef struct Unit {
         dual_timestamp active_exit_timestamp;
         dual_timestamp inactive_enter_timestamp;
 
+        /* See unit_critical_path_weight() */
+        usec_t critical_path_weight;
+        unsigned critical_path_generation;
+
+        /* Heap memory released by unit_compact(), as far as malloc can tell */
+        size_t compacted_size;
+
+        /* The unit files as they were loaded, as pairs of path and contents, to read the settings of a
+         * compacted unit back in from, see unit_compact() */
+        char **compacted_files;
+
         /* Per type list */
         LIST_FIELDS(Unit, units_by_type);
 
@@ -327,6 +383,11 @@ typedef struct Unit {
         unsigned sigchldgen;
         unsigned notifygen;
 
+        /* How many sd_notify() messages we received for this unit, and how many of those were dropped
+         * because a later message from the same process in the same batch superseded them */
+        uint64_t n_notify_messages;
+        uint64_t n_notify_messages_coalesced;
+
         /* Used during GC sweeps */
         unsigned gc_marker;
 
@@ -371,6 +432,13 @@ typedef struct Unit {
         uint64_t io_accounting_base[_CGROUP_IO_ACCOUNTING_METRIC_MAX];
         uint64_t io_accounting_last[_CGROUP_IO_ACCOUNTING_METRIC_MAX]; /* the most recently read value */
 
+        /* Hash of the last accounting snapshot of this unit, and the manager's accounting generation when
+         * it last changed. If the cgroup was empty when the snapshot was taken, and no processes showed up
+         * in it since, its counters cannot have moved, and the snapshot is considered idle. */
+        uint64_t accounting_hash;
+        uint64_t accounting_generation;
+        bool accounting_idle;
+
         /* Counterparts in the cgroup filesystem */
         char *cgroup_path;
         uint64_t cgroup_id;
@@ -383,6 +451,14 @@ typedef struct Unit {
         int cgroup_control_inotify_wd;
         int cgroup_memory_inotify_wd;
 
+        /* Directory of the cgroup on the unified hierarchy while its attributes are written, see
+         * cgroup_context_apply() */
+        int cgroup_dir_fd;
+
+        /* Attribute values last written to the cgroup, keyed by "controller/attribute" (plus the device for
+         * per-device attributes), so that realizing the cgroup again only writes what actually changed */
+        Hashmap *cgroup_attributes;
+
         /* Device Controller BPF program */
         BPFProgram *bpf_device_control_installed;
 
@@ -499,6 +575,9 @@ typedef struct Unit {
         /* Did we already invoke unit_coldplug() for this unit? */
         bool coldplugged:1;
 
+        /* Were the unit files already read ahead by manager_preparse_load_queue()? */
+        bool load_preparsed:1;
+
         /* For transient units: whether to add a bus track reference after creating the unit */
         bool bus_track_add:1;
 
@@ -512,6 +591,9 @@ typedef struct Unit {
         /* Whether we warned about clamping the CPU quota period */
         bool warned_clamping_cpu_quota_period:1;
 
+        /* Were the exec and cgroup contexts dropped while the unit was inactive? See unit_compact() */
+        bool compacted:1;
+
         /* When writing transient unit files, stores which section we stored last. If < 0, we didn't write any yet. If
          * == 0 we are in the [Unit] section, if > 0 we are in the unit type-specific section. */
         signed int last_section_private:2;
@@ -601,6 +683,16 @@ typedef struct UnitVTable {
          * UNIT_STUB if no configuration could be found. */
         int (*load)(Unit *u);
 
+        /* Drop the type-specific settings load() parsed from the private section of the unit files, while
+         * the unit is inactive. The exec and cgroup contexts are dropped by the caller. Should return 0 if
+         * the current state of the unit doesn't allow this. Units of types without this are never
+         * compacted. */
+        int (*compact)(Unit *u);
+
+        /* The reverse of compact(): reparse the private section of the unit files saved in compacted_files,
+         * and redo what load() derived from it. */
+        int (*expand)(Unit *u);
+
         /* During deserialization we only record the intended state to return to. With coldplug() we actually put the
          * deserialized state in effect. This is where unit_notify() should be called to start things up. Note that
          * this callback is invoked *before* we leave the reloading state of the manager, i.e. *before* we consider the
@@ -807,10 +899,34 @@ static inline const UnitVTable* UNIT_VTABLE(const Unit *u) {
 Unit* unit_has_dependency(const Unit *u, UnitDependencyAtom atom, Unit *other);
 int unit_get_dependency_array(const Unit *u, UnitDependencyAtom atom, Unit ***ret_array);
 
-static inline Hashmap* unit_get_dependencies(Unit *u, UnitDependency d) {
-        return hashmap_get(u->dependencies, UNIT_DEPENDENCY_TO_PTR(d));
+const UnitDependencyEdge* unit_find_dependency(const Unit *u, UnitDependency d, const Unit *other);
+size_t unit_get_dependency_memory(const Unit *u);
+
+int unit_update_pull_in(Unit *u);
+int unit_pull_in_at(Unit *u, UnitPullIn p, size_t i, Unit **ret);
+
+/* Iterates through the units pulled into a transaction by a job for the unit in the specified way. If the
+ * unit's dependencies change while iterating, the iteration continues on the updated list. 'r' is set to
+ * zero when the iteration finished, or to a negative errno if it was aborted because the updated list
+ * couldn't be allocated, hence callers need to check it after the loop. */
+#define _UNIT_FOREACH_PULL_IN(other, u, p, r, i)                        \
+        for (size_t i = 0; ((r) = unit_pull_in_at((u), (p), i, &(other))) > 0; i++)
+
+#define UNIT_FOREACH_PULL_IN(other, u, p, r) \
+        _UNIT_FOREACH_PULL_IN(other, u, p, r, UNIQ_T(i, UNIQ))
+
+static inline const UnitDependencyEdge* unit_dependency_edge_at(const Unit *u, size_t i) {
+        return i < u->dependencies.n_edges ? u->dependencies.edges + i : NULL;
 }
 
+/* Iterates through all dependency edges of a unit, of all types. Dependencies may be added while iterating,
+ * but not removed. */
+#define _UNIT_FOREACH_DEPENDENCY_EDGE(e, u, i)                          \
+        for (size_t i = 0; ((e) = unit_dependency_edge_at((u), i)); i++)
+
+#define UNIT_FOREACH_DEPENDENCY_EDGE(e, u) \
+        _UNIT_FOREACH_DEPENDENCY_EDGE(e, u, UNIQ_T(i, UNIQ))
+
 static inline Unit* UNIT_TRIGGER(Unit *u) {
         return unit_has_dependency(u, UNIT_ATOM_TRIGGERS, NULL);
 }
@@ -960,6 +1076,7 @@ void unit_ref_unset(UnitRef *ref);
 #define UNIT_ISSET(ref) (!!(ref).target)
 
 int unit_patch_contexts(Unit *u);
+void unit_reset_contexts(Unit *u);
 
 ExecContext *unit_get_exec_context(const Unit *u) _pure_;
 KillContext *unit_get_kill_context(Unit *u) _pure_;
@@ -1146,48 +1263,49 @@ typedef struct UnitForEachDependencyData {
         /* Stores state for the FOREACH macro below for iterating through all deps that have any of the
          * specified dependency atom bits set */
         UnitDependencyAtom match_atom;
-        Hashmap *by_type, *by_unit;
-        void *current_type;
-        Iterator by_type_iterator, by_unit_iterator;
+        uint64_t match_types;
+        const UnitDependencies *deps;
+        size_t i;
         Unit **current_unit;
 } UnitForEachDependencyData;
 
-/* Iterates through all dependencies that have a specific atom in the dependency type set. This tries to be
- * smart: if the atom is unique, we'll directly go to right entry. Otherwise we'll iterate through the
- * per-dependency type hashmap and match all dep that have the right atom set. */
+static inline bool unit_foreach_dependency_next(UnitForEachDependencyData *data) {
+        assert(data);
+
+        if (data->i == 0) {
+                /* Translate the atom into the set of dependency types carrying it, but only once we know
+                 * there's anything to match against. */
+                if (data->deps->n_edges == 0)
+                        return false;
+
+                data->match_types = unit_dependency_types_from_atom(data->match_atom) & data->deps->types;
+                if (data->match_types == 0)
+                        return false;
+        }
+
+        for (; data->i < data->deps->n_edges; data->i++) {
+                const UnitDependencyEdge *e = data->deps->edges + data->i;
+
+                if (data->match_types & UNIT_DEPENDENCY_TYPE_BIT(e->type)) {
+                        *data->current_unit = e->other;
+                        data->i++;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/* Iterates through all dependencies that have a specific atom in the dependency type set. The atom is
+ * translated into a bit mask of dependency types once, and then each edge of the unit is matched against it
+ * with a single bit test. */
 #define _UNIT_FOREACH_DEPENDENCY(other, u, ma, data)                    \
         for (UnitForEachDependencyData data = {                         \
                         .match_atom = (ma),                             \
-                        .by_type = (u)->dependencies,                   \
-                        .by_type_iterator = ITERATOR_FIRST,             \
+                        .deps = &(u)->dependencies,                     \
                         .current_unit = &(other),                       \
                 };                                                      \
-             ({                                                         \
-                     UnitDependency _dt = _UNIT_DEPENDENCY_INVALID;     \
-                     bool _found;                                       \
-                                                                        \
-                     if (data.by_type && ITERATOR_IS_FIRST(data.by_type_iterator)) { \
-                             _dt = unit_dependency_from_unique_atom(data.match_atom); \
-                             if (_dt >= 0) {                            \
-                                     data.by_unit = hashmap_get(data.by_type, UNIT_DEPENDENCY_TO_PTR(_dt)); \
-                                     data.current_type = UNIT_DEPENDENCY_TO_PTR(_dt); \
-                                     data.by_type = NULL;               \
-                                     _found = !!data.by_unit;           \
-                             }                                          \
-                     }                                                  \
-                     if (_dt < 0)                                       \
-                             _found = hashmap_iterate(data.by_type,     \
-                                                      &data.by_type_iterator, \
-                                                      (void**)&(data.by_unit), \
-                                                      (const void**) &(data.current_type)); \
-                     _found;                                            \
-             }); )                                                      \
-                if ((unit_dependency_to_atom(UNIT_DEPENDENCY_FROM_PTR(data.current_type)) & data.match_atom) != 0) \
-                        for (data.by_unit_iterator = ITERATOR_FIRST;    \
-                                hashmap_iterate(data.by_unit,           \
-                                                &data.by_unit_iterator, \
-                                                NULL,                   \
-                                                (const void**) data.current_unit); )
+             unit_foreach_dependency_next(&data); )
 
 /* Note: this matches deps that have *any* of the atoms specified in match_atom set */
 #define UNIT_FOREACH_DEPENDENCY(other, u, match_atom) \
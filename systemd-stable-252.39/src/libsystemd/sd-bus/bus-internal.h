@@ -92,6 +92,24 @@ struct node_object_manager {
         LIST_FIELDS(struct node_object_manager, object_managers);
 };
 
+/* How the value of a property is put into a message. Determined once when the vtable is registered, so
+ * that Get()/GetAll() and PropertiesChanged don't have to look at the signature string again. */
+typedef enum BusPropertyMarshal {
+        BUS_PROPERTY_MARSHAL_CALLBACK,    /* call the getter specified in the vtable */
+        BUS_PROPERTY_MARSHAL_STRV,        /* "as", userdata points to a char** */
+        BUS_PROPERTY_MARSHAL_STRING,      /* "s" or "g", userdata points to a char*, NULL is turned into "" */
+        BUS_PROPERTY_MARSHAL_OBJECT_PATH, /* "o", userdata points to a non-NULL char* */
+        BUS_PROPERTY_MARSHAL_TRIVIAL,     /* any other basic type, userdata points to the value itself */
+        _BUS_PROPERTY_MARSHAL_MAX,
+        _BUS_PROPERTY_MARSHAL_INVALID = -EINVAL,
+} BusPropertyMarshal;
+
+struct vtable_property {
+        const sd_bus_vtable *vtable;
+        BusPropertyMarshal marshal;
+        char type;
+};
+
 struct node_vtable {
         struct node *node;
 
@@ -102,6 +120,11 @@ struct node_vtable {
         const sd_bus_vtable *vtable;
         sd_bus_object_find_t find;
 
+        /* All properties of the vtable in order, so that we don't have to walk and decode the vtable
+         * every time a GetAll() or PropertiesChanged message is generated. */
+        struct vtable_property *properties;
+        size_t n_properties;
+
         LIST_FIELDS(struct node_vtable, vtables);
 };
 
@@ -112,6 +135,7 @@ struct vtable_member {
         struct node_vtable *parent;
         unsigned last_iteration;
         const sd_bus_vtable *vtable;
+        const struct vtable_property *property; /* only set for properties */
 };
 
 typedef enum BusSlotType {
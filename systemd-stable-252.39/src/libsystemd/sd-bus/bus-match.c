@@ -51,10 +51,19 @@ static bool BUS_MATCH_IS_COMPARE(enum bus_match_node_type t) {
         return t >= BUS_MATCH_SENDER && t <= BUS_MATCH_ARG_HAS_LAST;
 }
 
+static bool BUS_MATCH_IS_PREFIX(enum bus_match_node_type t) {
+        return t == BUS_MATCH_PATH_NAMESPACE ||
+                (t >= BUS_MATCH_ARG_PATH && t <= BUS_MATCH_ARG_PATH_LAST) ||
+                (t >= BUS_MATCH_ARG_NAMESPACE && t <= BUS_MATCH_ARG_NAMESPACE_LAST);
+}
+
 static bool BUS_MATCH_CAN_HASH(enum bus_match_node_type t) {
+        /* Prefix matches are hashed by their value too, see bus_match_run_prefix() for how they are looked
+         * up. Only sender matches are not, since a well-known name may match any unique name. */
         return (t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_PATH) ||
                 (t >= BUS_MATCH_ARG && t <= BUS_MATCH_ARG_LAST) ||
-                (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST);
+                (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST) ||
+                BUS_MATCH_IS_PREFIX(t);
 }
 
 static void bus_match_node_free(struct bus_match_node *node) {
@@ -234,6 +243,101 @@ static bool value_node_same(
         }
 }
 
+static int bus_match_run_prefix(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *test_str,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *buf = NULL;
+        size_t n, last = SIZE_MAX;
+        bool complex;
+        char separator;
+        int r;
+
+        assert(node);
+        assert(BUS_MATCH_IS_PREFIX(node->type));
+        assert(m);
+
+        /* A path_namespace=, argNnamespace= or argNpath= match can only ever match if its value is equal
+         * to one of a few specific prefixes of the tested string: the string itself, and the prefixes
+         * directly before or after a separator (for argNpath= only those ending in a separator). Hence,
+         * rather than comparing the string with every single match installed, we look up these prefixes in
+         * the hash table, which keeps the cost independent of the number of installed matches. */
+
+        if (!test_str)
+                return 0;
+
+        complex = node->type >= BUS_MATCH_ARG_PATH && node->type <= BUS_MATCH_ARG_PATH_LAST;
+        separator = node->type >= BUS_MATCH_ARG_NAMESPACE && node->type <= BUS_MATCH_ARG_NAMESPACE_LAST ? '.' : '/';
+
+        if (complex && endswith(test_str, CHAR_TO_STR(separator))) {
+                struct bus_match_node *c;
+
+                /* If the tested string ends in a separator, any argNpath= match it is a prefix of matches
+                 * too. That's not something we can look up, hence fall back to checking them all. */
+
+                HASHMAP_FOREACH(c, node->compare.children) {
+                        if (!value_node_test(c, node->type, 0, test_str, NULL, m))
+                                continue;
+
+                        r = bus_match_run(bus, c, m);
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+
+                return 0;
+        }
+
+        buf = strdup(test_str);
+        if (!buf)
+                return -ENOMEM;
+
+        n = strlen(buf);
+
+        for (size_t i = 0; i <= n; i++) {
+                struct bus_match_node *found;
+                size_t l;
+
+                /* Consider the prefix before the separator (simple matches only), the one including it,
+                 * and finally the whole string. Candidates are generated in increasing length, hence
+                 * comparing with the previous one is sufficient to never run a node twice. */
+
+                for (unsigned k = 0; k < 2; k++) {
+                        if (i == n)
+                                l = n;
+                        else if (buf[i] != separator || (k == 0 && complex))
+                                continue;
+                        else
+                                l = k == 0 ? i : i + 1;
+
+                        if (l == last)
+                                continue;
+                        last = l;
+
+                        char saved = buf[l];
+                        buf[l] = 0;
+                        found = hashmap_get(node->compare.children, buf);
+                        buf[l] = saved;
+
+                        if (!found)
+                                continue;
+
+                        r = bus_match_run(bus, found, m);
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+        }
+
+        return 0;
+}
+
 int bus_match_run(
                 sd_bus *bus,
                 struct bus_match_node *node,
@@ -374,7 +478,12 @@ int bus_match_run(
                 assert_not_reached();
         }
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (BUS_MATCH_IS_PREFIX(node->type)) {
+                r = bus_match_run_prefix(bus, node, test_str, m);
+                if (r != 0)
+                        return r;
+
+        } else if (BUS_MATCH_CAN_HASH(node->type)) {
                 struct bus_match_node *found;
 
                 /* Lookup via hash table, nice! So let's jump directly. */
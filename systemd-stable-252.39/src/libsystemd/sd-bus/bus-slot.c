@@ -150,6 +150,8 @@ void bus_slot_disconnect(sd_bus_slot *slot, bool unref) {
                 }
 
                 slot->node_vtable.interface = mfree(slot->node_vtable.interface);
+                slot->node_vtable.properties = mfree(slot->node_vtable.properties);
+                slot->node_vtable.n_properties = 0;
 
                 if (slot->node_vtable.node) {
                         LIST_REMOVE(vtables, slot->node_vtable.node->vtables, &slot->node_vtable);
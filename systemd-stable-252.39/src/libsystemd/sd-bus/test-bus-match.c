@@ -6,7 +6,9 @@
 #include "log.h"
 #include "macro.h"
 #include "memory-util.h"
+#include "stdio-util.h"
 #include "tests.h"
+#include "time-util.h"
 
 static bool mask[32];
 
@@ -57,6 +59,123 @@ static int match_add(sd_bus_slot *slots, struct bus_match_node *root, const char
         return r;
 }
 
+static unsigned n_counted = 0;
+
+static int count_filter(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        n_counted++;
+        return 0;
+}
+
+static void match_add_counting(sd_bus_slot *s, struct bus_match_node *root, const char *match) {
+        struct bus_match_component *components;
+        unsigned n_components;
+
+        assert_se(bus_match_parse(match, &components, &n_components) >= 0);
+
+        s->match_callback.callback = count_filter;
+
+        assert_se(bus_match_add(root, components, n_components, &s->match_callback) >= 0);
+        bus_match_parse_free(components, n_components);
+}
+
+static void test_match_prefix(sd_bus *bus) {
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        static const char *const matches[] = {
+                /* matching */
+                "path_namespace='/'",
+                "path_namespace='/foo'",
+                "path_namespace='/foo/bar'",
+                "path_namespace='/foo/bar/baz'",
+                "arg0namespace='org'",
+                "arg0namespace='org.freedesktop'",
+                "arg0namespace='org.freedesktop.systemd1'",
+                "arg1path='/'",
+                "arg1path='/a/'",
+                "arg1path='/a/b'",
+                /* not matching */
+                "path_namespace='/fo'",
+                "path_namespace='/foo/ba'",
+                "path_namespace='/foo/bar/baz/waldo'",
+                "arg0namespace='or'",
+                "arg0namespace='org.free'",
+                "arg0namespace='org.freedesktop.systemd1.Unit'",
+                "arg1path='/a'",
+                "arg1path='/a/b/'",
+                "arg1path='/a/bc'",
+        };
+        sd_bus_slot slots[ELEMENTSOF(matches)] = {};
+
+        for (size_t i = 0; i < ELEMENTSOF(matches); i++)
+                match_add_counting(slots + i, &root, matches[i]);
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/foo/bar/baz", "bar.x", "waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "ss", "org.freedesktop.systemd1", "/a/b") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+        n_counted = 0;
+        assert_se(bus_match_run(NULL, &root, m) == 0);
+        assert_se(n_counted == 10);
+
+        m = sd_bus_message_unref(m);
+
+        /* An argNpath= value ending in a separator matches everything below it too */
+        assert_se(sd_bus_message_new_signal(bus, &m, "/foo/bar/baz", "bar.x", "waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "ss", "org.freedesktop.systemd1", "/a/") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+        n_counted = 0;
+        assert_se(bus_match_run(NULL, &root, m) == 0);
+        assert_se(n_counted == 7 + 5);
+
+        bus_match_free(&root);
+}
+
+static void test_match_many(sd_bus *bus) {
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ sd_bus_slot *slots = NULL;
+        unsigned n_matches = 10000, n_iterations = slow_tests_enabled() ? 100000 : 1000;
+        usec_t t;
+
+        /* Install many path_namespace= and arg0namespace= matches, as a service manager with lots of
+         * subscribed clients would have, and measure how long dispatching a single message takes. */
+
+        assert_se(slots = new0(sd_bus_slot, n_matches * 2));
+
+        for (unsigned i = 0; i < n_matches; i++) {
+                char match[STRLEN("type='signal',path_namespace='/org/freedesktop/systemd1/unit/u'") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(match, "type='signal',path_namespace='/org/freedesktop/systemd1/unit/u%u'", i);
+                match_add_counting(slots + 2 * i, &root, match);
+
+                xsprintf(match, "type='signal',arg0namespace='org.example.n%u'", i);
+                match_add_counting(slots + 2 * i + 1, &root, match);
+        }
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/org/freedesktop/systemd1/unit/u42/sub", "bar.x", "waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "s", "org.example.n42.x") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+        n_counted = 0;
+        assert_se(bus_match_run(NULL, &root, m) == 0);
+        assert_se(n_counted == 2);
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n_iterations; i++)
+                assert_se(bus_match_run(NULL, &root, m) == 0);
+        t = usec_sub_unsigned(now(CLOCK_MONOTONIC), t);
+
+        log_info("Dispatching a message with %u matches installed took %.3f µs on average.",
+                 2 * n_matches, (double) t / n_iterations);
+
+        bus_match_free(&root);
+}
+
 static void test_match_scope(const char *match, enum bus_match_scope scope) {
         struct bus_match_component *components = NULL;
         unsigned n_components = 0;
@@ -134,6 +253,9 @@ int main(int argc, char *argv[]) {
 
         bus_match_free(&root);
 
+        test_match_prefix(bus);
+        test_match_many(bus);
+
         test_match_scope("interface='foobar'", BUS_MATCH_GENERIC);
         test_match_scope("", BUS_MATCH_GENERIC);
         test_match_scope("interface='org.freedesktop.DBus.Local'", BUS_MATCH_LOCAL);
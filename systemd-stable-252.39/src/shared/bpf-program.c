@@ -187,6 +187,95 @@ int bpf_program_load_kernel(BPFProgram *p, char *log_buf, size_t log_size) {
         return 0;
 }
 
+/* Don't let the cache grow without bounds if policies keep changing */
+#define BPF_PROGRAM_CACHE_MAX 256U
+
+static void bpf_program_code_hash_func(const BPFProgram *p, struct siphash *state) {
+        siphash24_compress(&p->prog_type, sizeof(p->prog_type), state);
+        siphash24_compress_string(p->prog_name, state);
+        siphash24_compress(&p->n_instructions, sizeof(p->n_instructions), state);
+        siphash24_compress_safe(p->instructions, sizeof(struct bpf_insn) * p->n_instructions, state);
+}
+
+static int bpf_program_code_compare_func(const BPFProgram *a, const BPFProgram *b) {
+        int r;
+
+        r = CMP(a->prog_type, b->prog_type);
+        if (r != 0)
+                return r;
+
+        r = strcmp_ptr(a->prog_name, b->prog_name);
+        if (r != 0)
+                return r;
+
+        r = CMP(a->n_instructions, b->n_instructions);
+        if (r != 0)
+                return r;
+
+        return memcmp_safe(a->instructions, b->instructions, sizeof(struct bpf_insn) * a->n_instructions);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(bpf_program_code_hash_ops, BPFProgram,
+                                            bpf_program_code_hash_func, bpf_program_code_compare_func,
+                                            bpf_program_free);
+
+int bpf_program_load_kernel_cached(BPFProgram *p, Set **cache) {
+        _cleanup_(bpf_program_freep) BPFProgram *copy = NULL;
+        BPFProgram *cached;
+        int r;
+
+        assert(p);
+
+        /* Like bpf_program_load_kernel(), but takes the loaded program from the specified cache if a program
+         * with the very same code was loaded before. Loading a program means running it through the
+         * verifier, which is not cheap, and many units end up with identical programs. The cache keeps one
+         * loaded, never attached copy of each program around, and every user gets its own fd for it, so
+         * that attaching and detaching works exactly as for programs loaded individually. */
+
+        if (!cache)
+                return bpf_program_load_kernel(p, NULL, 0);
+
+        if (p->kernel_fd >= 0)
+                return 0;
+
+        cached = set_get(*cache, p);
+        if (cached) {
+                p->kernel_fd = fcntl(cached->kernel_fd, F_DUPFD_CLOEXEC, 3);
+                if (p->kernel_fd < 0)
+                        return -errno;
+
+                return 0;
+        }
+
+        r = bpf_program_load_kernel(p, NULL, 0);
+        if (r < 0)
+                return r;
+
+        /* From here on the program is loaded, failing to cache it is not fatal */
+        r = bpf_program_new(p->prog_type, p->prog_name, &copy);
+        if (r < 0)
+                return 0;
+
+        copy->instructions = newdup(struct bpf_insn, p->instructions, p->n_instructions);
+        if (!copy->instructions && p->n_instructions > 0)
+                return 0;
+        copy->n_instructions = p->n_instructions;
+
+        copy->kernel_fd = fcntl(p->kernel_fd, F_DUPFD_CLOEXEC, 3);
+        if (copy->kernel_fd < 0)
+                return 0;
+
+        if (set_size(*cache) >= BPF_PROGRAM_CACHE_MAX)
+                set_clear(*cache);
+
+        (void) set_ensure_consume(cache, &bpf_program_code_hash_ops, TAKE_PTR(copy));
+        return 0;
+}
+
+bool bpf_program_code_equal(const BPFProgram *a, const BPFProgram *b) {
+        return bpf_program_code_compare_func(a, b) == 0;
+}
+
 int bpf_program_load_from_bpf_fs(BPFProgram *p, const char *path) {
         union bpf_attr attr;
 
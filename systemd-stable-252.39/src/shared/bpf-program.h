@@ -9,6 +9,7 @@
 #include "fdset.h"
 #include "list.h"
 #include "macro.h"
+#include "set.h"
 
 typedef struct BPFProgram BPFProgram;
 
@@ -39,8 +40,11 @@ BPFProgram *bpf_program_free(BPFProgram *p);
 
 int bpf_program_add_instructions(BPFProgram *p, const struct bpf_insn *insn, size_t count);
 int bpf_program_load_kernel(BPFProgram *p, char *log_buf, size_t log_size);
+int bpf_program_load_kernel_cached(BPFProgram *p, Set **cache);
 int bpf_program_load_from_bpf_fs(BPFProgram *p, const char *path);
 
+bool bpf_program_code_equal(const BPFProgram *a, const BPFProgram *b);
+
 int bpf_program_cgroup_attach(BPFProgram *p, int type, const char *path, uint32_t flags);
 int bpf_program_cgroup_detach(BPFProgram *p);
 
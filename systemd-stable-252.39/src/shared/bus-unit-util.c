@@ -2322,6 +2322,7 @@ static int bus_append_socket_property(sd_bus_message *m, const char *field, cons
         if (STR_IN_SET(field, "Backlog",
                               "MaxConnections",
                               "MaxConnectionsPerSource",
+                              "AcceptPool",
                               "KeepAliveProbes",
                               "TriggerLimitBurst"))
                 return bus_append_safe_atou(m, field, eq);
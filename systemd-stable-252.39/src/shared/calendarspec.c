@@ -20,6 +20,7 @@
 #include "string-util.h"
 #include "strv.h"
 #include "time-util.h"
+#include "tzfile.h"
 
 #define BITS_WEEKDAYS 127
 #define MIN_YEAR 1970
@@ -1103,13 +1104,38 @@ int calendar_spec_from_string(const char *p, CalendarSpec **spec) {
         return 0;
 }
 
-static int find_end_of_month(const struct tm *tm, bool utc, int day) {
+/* The timezone calculations are done in: UTC, the local timezone, or a timezone loaded from its tzfile */
+typedef struct CalendarZone {
+        bool utc;
+        const TZFile *tz;
+        int offset;             /* State of tzfile_mktime() */
+} CalendarZone;
+
+static time_t zone_mktime(CalendarZone *z, struct tm *tm) {
+        assert(z);
+
+        if (z->tz)
+                return tzfile_mktime(z->tz, tm, &z->offset);
+
+        return mktime_or_timegm(tm, z->utc);
+}
+
+static struct tm* zone_localtime(const CalendarZone *z, time_t t, struct tm *tm) {
+        assert(z);
+
+        if (z->tz)
+                return tzfile_localtime(z->tz, t, tm);
+
+        return localtime_or_gmtime_r(&t, tm, z->utc);
+}
+
+static int find_end_of_month(const struct tm *tm, CalendarZone *z, int day) {
         struct tm t = *tm;
 
         t.tm_mon++;
         t.tm_mday = 1 - day;
 
-        if (mktime_or_timegm(&t, utc) < 0 ||
+        if (zone_mktime(z, &t) < 0 ||
             t.tm_mon != tm->tm_mon)
                 return -1;
 
@@ -1118,6 +1144,7 @@ static int find_end_of_month(const struct tm *tm, bool utc, int day) {
 
 static int find_matching_component(
                 const CalendarSpec *spec,
+                CalendarZone *z,
                 const CalendarComponent *c,
                 const struct tm *tm,           /* tm is only used for end-of-month calculations */
                 int *val) {
@@ -1141,8 +1168,8 @@ static int find_matching_component(
                 int start, stop;
 
                 if (end_of_month) {
-                        start = find_end_of_month(tm, spec->utc, c->start);
-                        stop = find_end_of_month(tm, spec->utc, c->stop);
+                        start = find_end_of_month(tm, z, c->start);
+                        stop = find_end_of_month(tm, z, c->stop);
 
                         if (stop > 0)
                                 SWAP_TWO(start, stop);
@@ -1180,7 +1207,7 @@ static int find_matching_component(
         return r;
 }
 
-static int tm_within_bounds(struct tm *tm, bool utc) {
+static int tm_within_bounds(struct tm *tm, CalendarZone *z) {
         struct tm t;
         int cmp;
         assert(tm);
@@ -1194,7 +1221,7 @@ static int tm_within_bounds(struct tm *tm, bool utc) {
                 return -ERANGE;
 
         t = *tm;
-        if (mktime_or_timegm(&t, utc) < 0)
+        if (zone_mktime(z, &t) < 0)
                 return negative_errno();
 
         /*
@@ -1224,7 +1251,7 @@ static int tm_within_bounds(struct tm *tm, bool utc) {
         return cmp == 0;
 }
 
-static bool matches_weekday(int weekdays_bits, const struct tm *tm, bool utc) {
+static bool matches_weekday(int weekdays_bits, const struct tm *tm, CalendarZone *z) {
         struct tm t;
         int k;
 
@@ -1232,7 +1259,7 @@ static bool matches_weekday(int weekdays_bits, const struct tm *tm, bool utc) {
                 return true;
 
         t = *tm;
-        if (mktime_or_timegm(&t, utc) < 0)
+        if (zone_mktime(z, &t) < 0)
                 return false;
 
         k = t.tm_wday == 0 ? 6 : t.tm_wday - 1;
@@ -1272,7 +1299,7 @@ static int tm_compare(const struct tm *t1, const struct tm *t2) {
  * C.f. https://bugzilla.redhat.com/show_bug.cgi?id=1941335. */
 #define MAX_CALENDAR_ITERATIONS 1000
 
-static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
+static int find_next(const CalendarSpec *spec, CalendarZone *z, struct tm *tm, usec_t *usec) {
         struct tm c;
         int tm_usec, r;
         bool invalidate_dst = false;
@@ -1287,12 +1314,12 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
 
         for (unsigned iteration = 0; iteration < MAX_CALENDAR_ITERATIONS; iteration++) {
                 /* Normalize the current date */
-                (void) mktime_or_timegm(&c, spec->utc);
+                (void) zone_mktime(z, &c);
                 if (!invalidate_dst)
                         c.tm_isdst = spec->dst;
 
                 c.tm_year += 1900;
-                r = find_matching_component(spec, spec->year, &c, &c.tm_year);
+                r = find_matching_component(spec, z, spec->year, &c, &c.tm_year);
                 c.tm_year -= 1900;
 
                 if (r > 0) {
@@ -1302,18 +1329,18 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 }
                 if (r < 0)
                         return r;
-                if (tm_within_bounds(&c, spec->utc) <= 0)
+                if (tm_within_bounds(&c, z) <= 0)
                         return -ENOENT;
 
                 c.tm_mon += 1;
-                r = find_matching_component(spec, spec->month, &c, &c.tm_mon);
+                r = find_matching_component(spec, z, spec->month, &c, &c.tm_mon);
                 c.tm_mon -= 1;
 
                 if (r > 0) {
                         c.tm_mday = 1;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
                 }
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(&c, z)) < 0) {
                         c.tm_year++;
                         c.tm_mon = 0;
                         c.tm_mday = 1;
@@ -1323,10 +1350,10 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 if (r == 0)
                         continue;
 
-                r = find_matching_component(spec, spec->day, &c, &c.tm_mday);
+                r = find_matching_component(spec, z, spec->day, &c, &c.tm_mday);
                 if (r > 0)
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(&c, z)) < 0) {
                         c.tm_mon++;
                         c.tm_mday = 1;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
@@ -1335,16 +1362,16 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 if (r == 0)
                         continue;
 
-                if (!matches_weekday(spec->weekdays_bits, &c, spec->utc)) {
+                if (!matches_weekday(spec->weekdays_bits, &c, z)) {
                         c.tm_mday++;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
                         continue;
                 }
 
-                r = find_matching_component(spec, spec->hour, &c, &c.tm_hour);
+                r = find_matching_component(spec, z, spec->hour, &c, &c.tm_hour);
                 if (r > 0)
                         c.tm_min = c.tm_sec = tm_usec = 0;
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(&c, z)) < 0) {
                         c.tm_mday++;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
                         continue;
@@ -1355,10 +1382,10 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                          * normalized time. */
                         continue;
 
-                r = find_matching_component(spec, spec->minute, &c, &c.tm_min);
+                r = find_matching_component(spec, z, spec->minute, &c, &c.tm_min);
                 if (r > 0)
                         c.tm_sec = tm_usec = 0;
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(&c, z)) < 0) {
                         c.tm_hour++;
                         c.tm_min = c.tm_sec = tm_usec = 0;
                         continue;
@@ -1367,11 +1394,11 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                         continue;
 
                 c.tm_sec = c.tm_sec * USEC_PER_SEC + tm_usec;
-                r = find_matching_component(spec, spec->microsecond, &c, &c.tm_sec);
+                r = find_matching_component(spec, z, spec->microsecond, &c, &c.tm_sec);
                 tm_usec = c.tm_sec % USEC_PER_SEC;
                 c.tm_sec /= USEC_PER_SEC;
 
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(&c, z)) < 0) {
                         c.tm_min++;
                         c.tm_sec = tm_usec = 0;
                         continue;
@@ -1405,7 +1432,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                                  "Infinite loop in calendar calculation: %s", strna(s));
 }
 
-static int calendar_spec_next_usec_impl(const CalendarSpec *spec, usec_t usec, usec_t *ret_next) {
+static int calendar_spec_next_usec_impl(const CalendarSpec *spec, CalendarZone *z, usec_t usec, usec_t *ret_next) {
         struct tm tm;
         time_t t;
         int r;
@@ -1418,14 +1445,14 @@ static int calendar_spec_next_usec_impl(const CalendarSpec *spec, usec_t usec, u
 
         usec++;
         t = (time_t) (usec / USEC_PER_SEC);
-        assert_se(localtime_or_gmtime_r(&t, &tm, spec->utc));
+        assert_se(zone_localtime(z, t, &tm));
         tm_usec = usec % USEC_PER_SEC;
 
-        r = find_next(spec, &tm, &tm_usec);
+        r = find_next(spec, z, &tm, &tm_usec);
         if (r < 0)
                 return r;
 
-        t = mktime_or_timegm(&tm, spec->utc);
+        t = zone_mktime(z, &tm);
         if (t < 0)
                 return -EINVAL;
 
@@ -1440,14 +1467,12 @@ typedef struct SpecNextResult {
         int return_value;
 } SpecNextResult;
 
-int calendar_spec_next_usec(const CalendarSpec *spec, usec_t usec, usec_t *ret_next) {
+int calendar_spec_next_usec_forked(const CalendarSpec *spec, usec_t usec, usec_t *ret_next) {
         SpecNextResult *shared, tmp;
         int r;
 
         assert(spec);
-
-        if (isempty(spec->timezone))
-                return calendar_spec_next_usec_impl(spec, usec, ret_next);
+        assert(spec->timezone);
 
         shared = mmap(NULL, sizeof *shared, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
         if (shared == MAP_FAILED)
@@ -1471,7 +1496,7 @@ int calendar_spec_next_usec(const CalendarSpec *spec, usec_t usec, usec_t *ret_n
 
                 tzset();
 
-                shared->return_value = calendar_spec_next_usec_impl(spec, usec, &shared->next);
+                shared->return_value = calendar_spec_next_usec_impl(spec, &(CalendarZone) { .utc = spec->utc }, usec, &shared->next);
 
                 _exit(EXIT_SUCCESS);
         }
@@ -1485,3 +1510,23 @@ int calendar_spec_next_usec(const CalendarSpec *spec, usec_t usec, usec_t *ret_n
 
         return tmp.return_value;
 }
+
+int calendar_spec_next_usec(const CalendarSpec *spec, usec_t usec, usec_t *ret_next) {
+        TZFile *tz;
+        int r;
+
+        assert(spec);
+
+        if (isempty(spec->timezone))
+                return calendar_spec_next_usec_impl(spec, &(CalendarZone) { .utc = spec->utc }, usec, ret_next);
+
+        /* Calculate in the specified timezone ourselves, so that we don't have to fork off a process with
+         * $TZ set for that. The mktime() emulation starts out like glibc's does in a process that has only
+         * used UTC so far. */
+        r = tzfile_get_cached(spec->timezone, &tz);
+        if (r >= 0)
+                return calendar_spec_next_usec_impl(spec, &(CalendarZone) { .tz = tz }, usec, ret_next);
+
+        log_debug_errno(r, "Failed to load timezone file for '%s', calculating in subprocess: %m", spec->timezone);
+        return calendar_spec_next_usec_forked(spec, usec, ret_next);
+}
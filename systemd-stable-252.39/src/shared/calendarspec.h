@@ -41,5 +41,8 @@ int calendar_spec_to_string(const CalendarSpec *spec, char **p);
 int calendar_spec_from_string(const char *p, CalendarSpec **spec);
 
 int calendar_spec_next_usec(const CalendarSpec *spec, usec_t usec, usec_t *next);
+/* Calculates in a child process with $TZ set to the timezone of the spec, which is what the above falls back
+ * to if the timezone file cannot be parsed. Exported for the tests. */
+int calendar_spec_next_usec_forked(const CalendarSpec *spec, usec_t usec, usec_t *next);
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(CalendarSpec*, calendar_spec_free);
@@ -91,6 +91,10 @@ struct JsonVariant {
         /* If in addition to this object all objects referenced by it are also ordered strictly by name */
         bool normalized:1;
 
+        /* If this was allocated from a JsonArena, in which case it is not reference counted, but released
+         * together with the arena */
+        bool is_arena:1;
+
         union {
                 /* For simple types we store the value in-line. */
                 JsonValue value;
@@ -158,10 +162,113 @@ static bool json_source_equal(JsonSource *a, JsonSource *b) {
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(JsonSource*, json_source_unref);
 
+/* Start with 16K chunks, and double them up to 1M for larger documents */
+#define JSON_ARENA_CHUNK_MIN (16U*1024U)
+#define JSON_ARENA_CHUNK_MAX (1024U*1024U)
+
+typedef struct JsonArenaChunk JsonArenaChunk;
+
+struct JsonArenaChunk {
+        JsonArenaChunk *next;
+        size_t size;
+        size_t used;
+        _alignas_(JsonVariant) uint8_t data[];
+};
+
+struct JsonArena {
+        /* A simple bump allocator for JsonVariant objects. Variants allocated from it are not reference
+         * counted, but all released in one go when the arena is freed. */
+        JsonArenaChunk *chunks;
+        size_t allocated;
+        bool sensitive;
+};
+
+JsonArena *json_arena_new(void) {
+        return new0(JsonArena, 1);
+}
+
+JsonArena *json_arena_free(JsonArena *a) {
+        if (!a)
+                return NULL;
+
+        while (a->chunks) {
+                JsonArenaChunk *c = a->chunks;
+
+                a->chunks = c->next;
+
+                if (a->sensitive)
+                        explicit_bzero_safe(c->data, c->used);
+
+                free(c);
+        }
+
+        return mfree(a);
+}
+
+size_t json_arena_size(JsonArena *a) {
+        return a ? a->allocated : 0;
+}
+
+static void *json_arena_alloc0(JsonArena *a, size_t size) {
+        JsonArenaChunk *c;
+        void *p;
+
+        assert(a);
+
+        size = ALIGN_TO(size, __alignof__(JsonVariant));
+        if (size == SIZE_MAX)
+                return NULL;
+
+        c = a->chunks;
+        if (!c || c->size - c->used < size) {
+                size_t n;
+
+                n = MAX(c ? MIN(c->size * 2, JSON_ARENA_CHUNK_MAX) : JSON_ARENA_CHUNK_MIN, size);
+                if (n > SIZE_MAX - offsetof(JsonArenaChunk, data))
+                        return NULL;
+
+                c = malloc(offsetof(JsonArenaChunk, data) + n);
+                if (!c)
+                        return NULL;
+
+                *c = (JsonArenaChunk) {
+                        .next = a->chunks,
+                        .size = n,
+                };
+
+                a->chunks = c;
+                a->allocated += n;
+        }
+
+        p = c->data + c->used;
+        c->used += size;
+
+        return memset(p, 0, size);
+}
+
+static JsonVariant *json_variant_alloc0(JsonArena *arena, size_t size) {
+        /* Allocates a JsonVariant of the specified size, either from the heap or from the arena, if one is
+         * specified. Note that the caller needs to set the 'is_arena' flag on the returned object. */
+        if (arena)
+                return json_arena_alloc0(arena, size);
+
+        return malloc0(size);
+}
+
+static JsonVariant *json_variant_alloc_array(JsonArena *arena, size_t n) {
+        if (!arena)
+                return new(JsonVariant, n);
+
+        if (size_multiply_overflow(sizeof(JsonVariant), n))
+                return NULL;
+
+        return json_arena_alloc0(arena, sizeof(JsonVariant) * n);
+}
+
 /* There are four kind of JsonVariant* pointers:
  *
  *    1. NULL
- *    2. A 'regular' one, i.e. pointing to malloc() memory
+ *    2. A 'regular' one, i.e. pointing to malloc() memory (or memory from a JsonArena)
  *    3. A 'magic' one, i.e. one of the special JSON_VARIANT_MAGIC_XYZ values, that encode a few very basic values directly in the pointer.
  *    4. A 'const string' one, i.e. a pointer to a const string.
  *
@@ -287,24 +394,26 @@ static JsonVariant *json_variant_conservative_formalize(JsonVariant *v) {
         return json_variant_formalize(v);
 }
 
-static int json_variant_new(JsonVariant **ret, JsonVariantType type, size_t space) {
+static int json_variant_new(JsonArena *arena, JsonVariant **ret, JsonVariantType type, size_t space) {
         JsonVariant *v;
 
         assert_return(ret, -EINVAL);
 
-        v = malloc0(MAX(sizeof(JsonVariant),
-                        offsetof(JsonVariant, value) + space));
+        v = json_variant_alloc0(arena,
+                                MAX(sizeof(JsonVariant),
+                                    offsetof(JsonVariant, value) + space));
         if (!v)
                 return -ENOMEM;
 
         v->n_ref = 1;
         v->type = type;
+        v->is_arena = arena;
 
         *ret = v;
         return 0;
 }
 
-int json_variant_new_integer(JsonVariant **ret, int64_t i) {
+static int json_variant_new_integer_internal(JsonArena *arena, JsonVariant **ret, int64_t i) {
         JsonVariant *v;
         int r;
 
@@ -315,7 +424,7 @@ int json_variant_new_integer(JsonVariant **ret, int64_t i) {
                 return 0;
         }
 
-        r = json_variant_new(&v, JSON_VARIANT_INTEGER, sizeof(i));
+        r = json_variant_new(arena, &v, JSON_VARIANT_INTEGER, sizeof(i));
         if (r < 0)
                 return r;
 
@@ -325,7 +434,11 @@ int json_variant_new_integer(JsonVariant **ret, int64_t i) {
         return 0;
 }
 
-int json_variant_new_unsigned(JsonVariant **ret, uint64_t u) {
+int json_variant_new_integer(JsonVariant **ret, int64_t i) {
+        return json_variant_new_integer_internal(NULL, ret, i);
+}
+
+static int json_variant_new_unsigned_internal(JsonArena *arena, JsonVariant **ret, uint64_t u) {
         JsonVariant *v;
         int r;
 
@@ -335,7 +448,7 @@ int json_variant_new_unsigned(JsonVariant **ret, uint64_t u) {
                 return 0;
         }
 
-        r = json_variant_new(&v, JSON_VARIANT_UNSIGNED, sizeof(u));
+        r = json_variant_new(arena, &v, JSON_VARIANT_UNSIGNED, sizeof(u));
         if (r < 0)
                 return r;
 
@@ -345,7 +458,11 @@ int json_variant_new_unsigned(JsonVariant **ret, uint64_t u) {
         return 0;
 }
 
-int json_variant_new_real(JsonVariant **ret, double d) {
+int json_variant_new_unsigned(JsonVariant **ret, uint64_t u) {
+        return json_variant_new_unsigned_internal(NULL, ret, u);
+}
+
+static int json_variant_new_real_internal(JsonArena *arena, JsonVariant **ret, double d) {
         JsonVariant *v;
         int r;
 
@@ -364,7 +481,7 @@ int json_variant_new_real(JsonVariant **ret, double d) {
                 return 0;
         }
 
-        r = json_variant_new(&v, JSON_VARIANT_REAL, sizeof(d));
+        r = json_variant_new(arena, &v, JSON_VARIANT_REAL, sizeof(d));
         if (r < 0)
                 return r;
 
@@ -374,6 +491,10 @@ int json_variant_new_real(JsonVariant **ret, double d) {
         return 0;
 }
 
+int json_variant_new_real(JsonVariant **ret, double d) {
+        return json_variant_new_real_internal(NULL, ret, d);
+}
+
 int json_variant_new_boolean(JsonVariant **ret, bool b) {
         assert_return(ret, -EINVAL);
 
@@ -392,7 +513,7 @@ int json_variant_new_null(JsonVariant **ret) {
         return 0;
 }
 
-int json_variant_new_stringn(JsonVariant **ret, const char *s, size_t n) {
+static int json_variant_new_stringn_internal(JsonArena *arena, JsonVariant **ret, const char *s, size_t n) {
         JsonVariant *v;
         int r;
 
@@ -413,7 +534,7 @@ int json_variant_new_stringn(JsonVariant **ret, const char *s, size_t n) {
         if (!utf8_is_valid_n(s, n)) /* JSON strings must be valid UTF-8 */
                 return -EUCLEAN;
 
-        r = json_variant_new(&v, JSON_VARIANT_STRING, n + 1);
+        r = json_variant_new(arena, &v, JSON_VARIANT_STRING, n + 1);
         if (r < 0)
                 return r;
 
@@ -424,6 +545,10 @@ int json_variant_new_stringn(JsonVariant **ret, const char *s, size_t n) {
         return 0;
 }
 
+int json_variant_new_stringn(JsonVariant **ret, const char *s, size_t n) {
+        return json_variant_new_stringn_internal(NULL, ret, s, n);
+}
+
 int json_variant_new_base64(JsonVariant **ret, const void *p, size_t n) {
         _cleanup_free_ char *s = NULL;
         ssize_t k;
@@ -549,7 +674,7 @@ static void json_variant_copy_source(JsonVariant *v, JsonVariant *from) {
         v->source = json_source_ref(from->source);
 }
 
-int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
+static int json_variant_new_array_internal(JsonArena *arena, JsonVariant **ret, JsonVariant **array, size_t n) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
         bool normalized = true;
 
@@ -560,13 +685,14 @@ int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
         }
         assert_return(array, -EINVAL);
 
-        v = new(JsonVariant, n + 1);
+        v = json_variant_alloc_array(arena, n + 1);
         if (!v)
                 return -ENOMEM;
 
         *v = (JsonVariant) {
                 .n_ref = 1,
                 .type = JSON_VARIANT_ARRAY,
+                .is_arena = arena,
         };
 
         for (v->n_elements = 0; v->n_elements < n; v->n_elements++) {
@@ -598,6 +724,10 @@ int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
         return 0;
 }
 
+int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
+        return json_variant_new_array_internal(NULL, ret, array, n);
+}
+
 int json_variant_new_array_bytes(JsonVariant **ret, const void *p, size_t n) {
         assert_return(ret, -EINVAL);
         if (n == 0) {
@@ -691,7 +821,7 @@ int json_variant_new_array_strv(JsonVariant **ret, char **l) {
         return 0;
 }
 
-int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
+static int json_variant_new_object_internal(JsonArena *arena, JsonVariant **ret, JsonVariant **array, size_t n) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
         const char *prev = NULL;
         bool sorted = true, normalized = true;
@@ -704,13 +834,14 @@ int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
         assert_return(array, -EINVAL);
         assert_return(n % 2 == 0, -EINVAL);
 
-        v = new(JsonVariant, n + 1);
+        v = json_variant_alloc_array(arena, n + 1);
         if (!v)
                 return -ENOMEM;
 
         *v = (JsonVariant) {
                 .n_ref = 1,
                 .type = JSON_VARIANT_OBJECT,
+                .is_arena = arena,
         };
 
         for (v->n_elements = 0; v->n_elements < n; v->n_elements++) {
@@ -755,6 +886,10 @@ int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
         return 0;
 }
 
+int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
+        return json_variant_new_object_internal(NULL, ret, array, n);
+}
+
 static size_t json_variant_size(JsonVariant* v) {
         if (!json_variant_is_regular(v))
                 return 0;
@@ -827,7 +962,7 @@ JsonVariant *json_variant_ref(JsonVariant *v) {
 
         if (v->is_embedded)
                 json_variant_ref(v->parent); /* ref the compounding variant instead */
-        else {
+        else if (!v->is_arena) { /* Arena variants live as long as the arena, they are not ref counted */
                 assert(v->n_ref > 0);
                 v->n_ref++;
         }
@@ -843,7 +978,7 @@ JsonVariant *json_variant_unref(JsonVariant *v) {
 
         if (v->is_embedded)
                 json_variant_unref(v->parent);
-        else {
+        else if (!v->is_arena) {
                 assert(v->n_ref > 0);
                 v->n_ref--;
 
@@ -1507,8 +1642,18 @@ static void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
         if (flags & JSON_FORMAT_COLOR)
                 fputs(ansi_green(), f);
 
-        for (; *q; q++)
-                switch (*q) {
+        for (;;) {
+                const char *e;
+
+                /* Write out runs of characters that need no escaping in one go */
+                for (e = q; *e && *e != '"' && *e != '\\' && !((signed char) *e >= 0 && *e < ' '); e++)
+                        ;
+
+                fwrite(q, 1, e - q, f);
+                if (*e == 0)
+                        break;
+
+                switch (*e) {
                 case '"':
                         fputs("\\\"", f);
                         break;
@@ -1538,13 +1683,13 @@ static void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
                         break;
 
                 default:
-                        if ((signed char) *q >= 0 && *q < ' ')
-                                fprintf(f, "\\u%04x", (unsigned) *q);
-                        else
-                                fputc(*q, f);
+                        fprintf(f, "\\u%04x", (unsigned) *e);
                         break;
                 }
 
+                q = e + 1;
+        }
+
         if (flags & JSON_FORMAT_COLOR)
                 fputs(ANSI_NORMAL, f);
 
@@ -2158,7 +2303,7 @@ fail:
         return r;
 }
 
-static int json_variant_copy(JsonVariant **nv, JsonVariant *v) {
+static int json_variant_copy(JsonArena *arena, JsonVariant **nv, JsonVariant *v) {
         JsonVariantType t;
         JsonVariant *c;
         JsonValue value;
@@ -2213,13 +2358,15 @@ static int json_variant_copy(JsonVariant **nv, JsonVariant *v) {
         default:
                 /* Everything else copy by reference */
 
-                c = malloc0(MAX(sizeof(JsonVariant),
-                                offsetof(JsonVariant, reference) + sizeof(JsonVariant*)));
+                c = json_variant_alloc0(arena,
+                                        MAX(sizeof(JsonVariant),
+                                            offsetof(JsonVariant, reference) + sizeof(JsonVariant*)));
                 if (!c)
                         return -ENOMEM;
 
                 c->n_ref = 1;
                 c->type = t;
+                c->is_arena = arena;
                 c->is_reference = true;
                 c->reference = json_variant_ref(json_variant_formalize(v));
 
@@ -2227,13 +2374,15 @@ static int json_variant_copy(JsonVariant **nv, JsonVariant *v) {
                 return 0;
         }
 
-        c = malloc0(MAX(sizeof(JsonVariant),
-                        offsetof(JsonVariant, value) + k));
+        c = json_variant_alloc0(arena,
+                                MAX(sizeof(JsonVariant),
+                                    offsetof(JsonVariant, value) + k));
         if (!c)
                 return -ENOMEM;
 
         c->n_ref = 1;
         c->type = t;
+        c->is_arena = arena;
 
         memcpy_safe(&c->value, source, k);
 
@@ -2257,7 +2406,7 @@ static bool json_single_ref(JsonVariant *v) {
         return v->n_ref == 1;
 }
 
-static int json_variant_set_source(JsonVariant **v, JsonSource *source, unsigned line, unsigned column) {
+static int json_variant_set_source(JsonArena *arena, JsonVariant **v, JsonSource *source, unsigned line, unsigned column) {
         JsonVariant *w;
         int r;
 
@@ -2295,7 +2444,7 @@ static int json_variant_set_source(JsonVariant **v, JsonSource *source, unsigned
                 }
         }
 
-        r = json_variant_copy(&w, *v);
+        r = json_variant_copy(arena, &w, *v);
         if (r < 0)
                 return r;
 
@@ -2825,12 +2974,14 @@ static void json_stack_release(JsonStack *s) {
 static int json_parse_internal(
                 const char **input,
                 JsonSource *source,
+                JsonArena *arena,
                 JsonParseFlags flags,
                 JsonVariant **ret,
                 unsigned *line,
                 unsigned *column,
                 bool continue_end) {
 
+        _cleanup_(json_arena_freep) JsonArena *scratch = NULL;
         size_t n_stack = 1;
         unsigned line_buffer = 0, column_buffer = 0;
         void *tokenizer_state = NULL;
@@ -2843,6 +2994,18 @@ static int json_parse_internal(
 
         p = *input;
 
+        if (arena) {
+                /* Numbers and short strings are copied into the arrays and objects containing them, hence
+                 * the standalone variants we create for them while parsing are only needed temporarily.
+                 * Allocate those from a separate arena that is released when we are done, so that they
+                 * don't bloat the arena the result is allocated from. */
+                scratch = json_arena_new();
+                if (!scratch)
+                        return -ENOMEM;
+
+                scratch->sensitive = arena->sensitive;
+        }
+
         if (!GREEDY_REALLOC(stack, n_stack))
                 return -ENOMEM;
 
@@ -2859,12 +3022,14 @@ static int json_parse_internal(
                 _cleanup_(json_variant_unrefp) JsonVariant *add = NULL;
                 _cleanup_free_ char *string = NULL;
                 unsigned line_token, column_token;
+                JsonArena *leaf_arena;
                 JsonStack *current;
                 JsonValue value;
                 int token;
 
                 assert(n_stack > 0);
                 current = stack + n_stack - 1;
+                leaf_arena = scratch && n_stack > 1 ? scratch : arena;
 
                 if (continue_end && current->expect == EXPECT_END)
                         goto done;
@@ -2950,7 +3115,7 @@ static int json_parse_internal(
 
                         assert(n_stack > 1);
 
-                        r = json_variant_new_object(&add, current->elements, current->n_elements);
+                        r = json_variant_new_object_internal(arena, &add, current->elements, current->n_elements);
                         if (r < 0)
                                 goto finish;
 
@@ -3000,7 +3165,7 @@ static int json_parse_internal(
 
                         assert(n_stack > 1);
 
-                        r = json_variant_new_array(&add, current->elements, current->n_elements);
+                        r = json_variant_new_array_internal(arena, &add, current->elements, current->n_elements);
                         if (r < 0)
                                 goto finish;
 
@@ -3017,7 +3182,8 @@ static int json_parse_internal(
                                 goto finish;
                         }
 
-                        r = json_variant_new_string(&add, string);
+                        r = json_variant_new_stringn_internal(strlen(string) > INLINE_STRING_MAX ? arena : leaf_arena,
+                                                              &add, string, SIZE_MAX);
                         if (r < 0)
                                 goto finish;
 
@@ -3040,7 +3206,7 @@ static int json_parse_internal(
                                 goto finish;
                         }
 
-                        r = json_variant_new_real(&add, value.real);
+                        r = json_variant_new_real_internal(leaf_arena, &add, value.real);
                         if (r < 0)
                                 goto finish;
 
@@ -3061,7 +3227,7 @@ static int json_parse_internal(
                                 goto finish;
                         }
 
-                        r = json_variant_new_integer(&add, value.integer);
+                        r = json_variant_new_integer_internal(leaf_arena, &add, value.integer);
                         if (r < 0)
                                 goto finish;
 
@@ -3082,7 +3248,7 @@ static int json_parse_internal(
                                 goto finish;
                         }
 
-                        r = json_variant_new_unsigned(&add, value.unsig);
+                        r = json_variant_new_unsigned_internal(leaf_arena, &add, value.unsig);
                         if (r < 0)
                                 goto finish;
 
@@ -3150,7 +3316,7 @@ static int json_parse_internal(
                         if (FLAGS_SET(flags, JSON_PARSE_SENSITIVE))
                                 json_variant_sensitive(add);
 
-                        (void) json_variant_set_source(&add, source, line_token, column_token);
+                        (void) json_variant_set_source(scratch && n_stack > 1 ? scratch : arena, &add, source, line_token, column_token);
 
                         if (!GREEDY_REALLOC(current->elements, current->n_elements + 1)) {
                                 r = -ENOMEM;
@@ -3179,11 +3345,25 @@ finish:
 }
 
 int json_parse(const char *input, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column) {
-        return json_parse_internal(&input, NULL, flags, ret, ret_line, ret_column, false);
+        return json_parse_internal(&input, NULL, NULL, flags, ret, ret_line, ret_column, false);
 }
 
 int json_parse_continue(const char **p, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column) {
-        return json_parse_internal(p, NULL, flags, ret, ret_line, ret_column, true);
+        return json_parse_internal(p, NULL, NULL, flags, ret, ret_line, ret_column, true);
+}
+
+int json_parse_with_arena(const char *input, JsonParseFlags flags, JsonArena *arena, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column) {
+        assert_return(arena, -EINVAL);
+
+        /* Like json_parse(), but allocates all variants from the specified arena instead of the heap. This
+         * is substantially cheaper for documents that are parsed, inspected once and then thrown away
+         * again. The returned variant (and everything referencing it) is only valid as long as the arena
+         * is, json_variant_ref() does not extend its lifetime. */
+
+        if (FLAGS_SET(flags, JSON_PARSE_SENSITIVE))
+                arena->sensitive = true;
+
+        return json_parse_internal(&input, NULL, arena, flags, ret, ret_line, ret_column, false);
 }
 
 int json_parse_file_at(FILE *f, int dir_fd, const char *path, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column) {
@@ -3210,7 +3390,708 @@ int json_parse_file_at(FILE *f, int dir_fd, const char *path, JsonParseFlags fla
         }
 
         const char *p = text;
-        return json_parse_internal(&p, source, flags, ret, ret_line, ret_column, false);
+        return json_parse_internal(&p, source, NULL, flags, ret, ret_line, ret_column, false);
+}
+
+struct JsonReader {
+        const char *p;
+        void *tokenizer_state;
+        unsigned line, column;
+
+        /* The state of the parser for each nesting level, the first entry is for the toplevel */
+        JsonExpect *stack;
+        size_t n_stack;
+
+        int token;
+        int error;
+        char *string;
+        JsonValue value;
+};
+
+static const JsonReaderToken json_reader_token_table[_JSON_TOKEN_MAX] = {
+        [JSON_TOKEN_STRING]   = JSON_READER_STRING,
+        [JSON_TOKEN_REAL]     = JSON_READER_REAL,
+        [JSON_TOKEN_INTEGER]  = JSON_READER_INTEGER,
+        [JSON_TOKEN_UNSIGNED] = JSON_READER_UNSIGNED,
+        [JSON_TOKEN_BOOLEAN]  = JSON_READER_BOOLEAN,
+        [JSON_TOKEN_NULL]     = JSON_READER_NULL,
+};
+
+int json_reader_new(JsonReader **ret, const char *input) {
+        _cleanup_(json_reader_freep) JsonReader *r = NULL;
+
+        assert_return(ret, -EINVAL);
+        assert_return(input, -EINVAL);
+
+        /* Note that the reader does not copy the input, it needs to stay valid while the reader is used. */
+
+        r = new(JsonReader, 1);
+        if (!r)
+                return -ENOMEM;
+
+        *r = (JsonReader) {
+                .p = input,
+                .token = _JSON_READER_TOKEN_INVALID,
+        };
+
+        r->stack = new(JsonExpect, 1);
+        if (!r->stack)
+                return -ENOMEM;
+
+        r->stack[r->n_stack++] = EXPECT_TOPLEVEL;
+
+        *ret = TAKE_PTR(r);
+        return 0;
+}
+
+JsonReader *json_reader_free(JsonReader *r) {
+        if (!r)
+                return NULL;
+
+        free(r->stack);
+        free(r->string);
+        return mfree(r);
+}
+
+static int json_expect_value(JsonExpect *e) {
+        assert(e);
+
+        /* Moves the parser state on after a value has been read at the current nesting level */
+
+        switch (*e) {
+
+        case EXPECT_TOPLEVEL:
+                *e = EXPECT_END;
+                return 0;
+
+        case EXPECT_OBJECT_VALUE:
+                *e = EXPECT_OBJECT_COMMA;
+                return 0;
+
+        case EXPECT_ARRAY_FIRST_ELEMENT:
+        case EXPECT_ARRAY_NEXT_ELEMENT:
+                *e = EXPECT_ARRAY_COMMA;
+                return 0;
+
+        default:
+                return -EINVAL;
+        }
+}
+
+int json_reader_next(JsonReader *r) {
+        assert_return(r, -EINVAL);
+
+        /* Returns the next token of the document, without building any JsonVariant objects. The grammar is
+         * validated as we go, hence object keys and values are guaranteed to alternate, and containers to
+         * be closed properly. Commas and colons are not reported. Errors are sticky. */
+
+        if (r->error < 0)
+                return r->error;
+
+        for (;;) {
+                JsonExpect *current = r->stack + r->n_stack - 1;
+                unsigned line_token, column_token;
+                int token;
+
+                r->string = mfree(r->string);
+
+                token = json_tokenize(&r->p, &r->string, &r->value, &line_token, &column_token, &r->tokenizer_state, &r->line, &r->column);
+                if (token < 0)
+                        return (r->error = token);
+
+                switch (token) {
+
+                case JSON_TOKEN_END:
+                        if (*current != EXPECT_END)
+                                return (r->error = -EINVAL);
+
+                        return (r->token = JSON_READER_END);
+
+                case JSON_TOKEN_COLON:
+                        if (*current != EXPECT_OBJECT_COLON)
+                                return (r->error = -EINVAL);
+
+                        *current = EXPECT_OBJECT_VALUE;
+                        break;
+
+                case JSON_TOKEN_COMMA:
+                        if (*current == EXPECT_OBJECT_COMMA)
+                                *current = EXPECT_OBJECT_NEXT_KEY;
+                        else if (*current == EXPECT_ARRAY_COMMA)
+                                *current = EXPECT_ARRAY_NEXT_ELEMENT;
+                        else
+                                return (r->error = -EINVAL);
+                        break;
+
+                case JSON_TOKEN_OBJECT_OPEN:
+                case JSON_TOKEN_ARRAY_OPEN:
+                        if (r->n_stack > DEPTH_MAX) /* Refuse too deep nesting */
+                                return (r->error = -ELNRNG);
+
+                        if (json_expect_value(current) < 0)
+                                return (r->error = -EINVAL);
+
+                        if (!GREEDY_REALLOC(r->stack, r->n_stack + 1))
+                                return (r->error = -ENOMEM);
+
+                        if (token == JSON_TOKEN_OBJECT_OPEN) {
+                                r->stack[r->n_stack++] = EXPECT_OBJECT_FIRST_KEY;
+                                return (r->token = JSON_READER_OBJECT_BEGIN);
+                        }
+
+                        r->stack[r->n_stack++] = EXPECT_ARRAY_FIRST_ELEMENT;
+                        return (r->token = JSON_READER_ARRAY_BEGIN);
+
+                case JSON_TOKEN_OBJECT_CLOSE:
+                        if (!IN_SET(*current, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_COMMA))
+                                return (r->error = -EINVAL);
+
+                        assert(r->n_stack > 1);
+                        r->n_stack--;
+                        return (r->token = JSON_READER_OBJECT_END);
+
+                case JSON_TOKEN_ARRAY_CLOSE:
+                        if (!IN_SET(*current, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_COMMA))
+                                return (r->error = -EINVAL);
+
+                        assert(r->n_stack > 1);
+                        r->n_stack--;
+                        return (r->token = JSON_READER_ARRAY_END);
+
+                case JSON_TOKEN_STRING:
+                        if (IN_SET(*current, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_NEXT_KEY)) {
+                                *current = EXPECT_OBJECT_COLON;
+                                return (r->token = JSON_READER_KEY);
+                        }
+
+                        _fallthrough_;
+                case JSON_TOKEN_REAL:
+                case JSON_TOKEN_INTEGER:
+                case JSON_TOKEN_UNSIGNED:
+                case JSON_TOKEN_BOOLEAN:
+                case JSON_TOKEN_NULL:
+                        if (json_expect_value(current) < 0)
+                                return (r->error = -EINVAL);
+
+                        return (r->token = json_reader_token_table[token]);
+
+                default:
+                        assert_not_reached();
+                }
+        }
+}
+
+unsigned json_reader_depth(JsonReader *r) {
+        assert_return(r, 0);
+
+        /* Returns the number of currently open objects and arrays */
+        return r->n_stack - 1;
+}
+
+const char *json_reader_string(JsonReader *r) {
+        assert_return(r, NULL);
+
+        if (!IN_SET(r->token, JSON_READER_KEY, JSON_READER_STRING))
+                return NULL;
+
+        return strempty(r->string);
+}
+
+int json_reader_integer(JsonReader *r, int64_t *ret) {
+        assert_return(r, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        if (r->token == JSON_READER_INTEGER) {
+                *ret = r->value.integer;
+                return 0;
+        }
+
+        if (r->token == JSON_READER_UNSIGNED) {
+                if (r->value.unsig > INT64_MAX)
+                        return -ERANGE;
+
+                *ret = (int64_t) r->value.unsig;
+                return 0;
+        }
+
+        return -EINVAL;
+}
+
+int json_reader_unsigned(JsonReader *r, uint64_t *ret) {
+        assert_return(r, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        if (r->token == JSON_READER_UNSIGNED) {
+                *ret = r->value.unsig;
+                return 0;
+        }
+
+        if (r->token == JSON_READER_INTEGER) {
+                if (r->value.integer < 0)
+                        return -ERANGE;
+
+                *ret = (uint64_t) r->value.integer;
+                return 0;
+        }
+
+        return -EINVAL;
+}
+
+int json_reader_real(JsonReader *r, double *ret) {
+        assert_return(r, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        switch (r->token) {
+
+        case JSON_READER_REAL:
+                *ret = r->value.real;
+                return 0;
+
+        case JSON_READER_INTEGER:
+                *ret = (double) r->value.integer;
+                return 0;
+
+        case JSON_READER_UNSIGNED:
+                *ret = (double) r->value.unsig;
+                return 0;
+
+        default:
+                return -EINVAL;
+        }
+}
+
+int json_reader_boolean(JsonReader *r, bool *ret) {
+        assert_return(r, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        if (r->token != JSON_READER_BOOLEAN)
+                return -EINVAL;
+
+        *ret = r->value.boolean;
+        return 0;
+}
+
+static int json_reader_build(JsonReader *r, JsonArena *arena, JsonVariant **ret) {
+        JsonVariant **elements = NULL;
+        size_t n_elements = 0;
+        bool object;
+        int k;
+
+        assert(r);
+        assert(ret);
+
+        switch (r->token) {
+
+        case JSON_READER_STRING:
+                return json_variant_new_stringn_internal(arena, ret, strempty(r->string), SIZE_MAX);
+
+        case JSON_READER_REAL:
+                return json_variant_new_real_internal(arena, ret, r->value.real);
+
+        case JSON_READER_INTEGER:
+                return json_variant_new_integer_internal(arena, ret, r->value.integer);
+
+        case JSON_READER_UNSIGNED:
+                return json_variant_new_unsigned_internal(arena, ret, r->value.unsig);
+
+        case JSON_READER_BOOLEAN:
+                return json_variant_new_boolean(ret, r->value.boolean);
+
+        case JSON_READER_NULL:
+                return json_variant_new_null(ret);
+
+        case JSON_READER_OBJECT_BEGIN:
+        case JSON_READER_ARRAY_BEGIN:
+                break;
+
+        default:
+                return -EINVAL;
+        }
+
+        object = r->token == JSON_READER_OBJECT_BEGIN;
+
+        for (;;) {
+                _cleanup_(json_variant_unrefp) JsonVariant *e = NULL;
+
+                k = json_reader_next(r);
+                if (k < 0)
+                        goto finish;
+                if (k == (object ? JSON_READER_OBJECT_END : JSON_READER_ARRAY_END))
+                        break;
+
+                /* json_reader_next() validated the grammar, hence keys and values alternate in objects */
+                if (k == JSON_READER_KEY)
+                        k = json_variant_new_stringn_internal(arena, &e, strempty(r->string), SIZE_MAX);
+                else
+                        k = json_reader_build(r, arena, &e);
+                if (k < 0)
+                        goto finish;
+
+                if (!GREEDY_REALLOC(elements, n_elements + 1)) {
+                        k = -ENOMEM;
+                        goto finish;
+                }
+
+                elements[n_elements++] = TAKE_PTR(e);
+        }
+
+        if (object)
+                k = json_variant_new_object_internal(arena, ret, elements, n_elements);
+        else
+                k = json_variant_new_array_internal(arena, ret, elements, n_elements);
+
+finish:
+        json_variant_unref_many(elements, n_elements);
+        free(elements);
+
+        return k;
+}
+
+int json_reader_variant(JsonReader *r, JsonArena *arena, JsonVariant **ret) {
+        assert_return(r, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        /* Turns the value at the current token into a JsonVariant, allocated from the specified arena if
+         * one is specified, and from the heap otherwise. If the current token opens an object or array
+         * the whole container is read, up to and including the token closing it. This allows walking
+         * through large documents while only materializing the parts that are needed, one at a time. */
+
+        if (r->error < 0)
+                return r->error;
+
+        return json_reader_build(r, arena, ret);
+}
+
+int json_reader_skip(JsonReader *r) {
+        size_t n;
+        int k;
+
+        assert_return(r, -EINVAL);
+
+        /* If the current token opens an object or array, skips over it, up to and including the token
+         * closing it. Does nothing otherwise. */
+
+        if (!IN_SET(r->token, JSON_READER_OBJECT_BEGIN, JSON_READER_ARRAY_BEGIN))
+                return 0;
+
+        n = r->n_stack - 1;
+        do {
+                k = json_reader_next(r);
+                if (k < 0)
+                        return k;
+        } while (r->n_stack > n);
+
+        return 0;
+}
+
+struct JsonWriter {
+        FILE *f;
+        JsonFormatFlags flags;
+
+        /* The state for each nesting level, the first entry is for the toplevel */
+        JsonExpect *stack;
+        size_t n_stack;
+
+        /* The indentation for pretty output, one tab per open object or array */
+        char *prefix;
+};
+
+int json_writer_new(JsonWriter **ret, FILE *f, JsonFormatFlags flags) {
+        _cleanup_(json_writer_freep) JsonWriter *w = NULL;
+
+        assert_return(ret, -EINVAL);
+
+        /* Returns an object that writes JSON directly to the specified stream, piece by piece, without
+         * building JsonVariant objects first. The output is identical to what json_variant_dump() generates
+         * for the equivalent variant. Multiple toplevel values may be written one after the other, which is
+         * useful in combination with JSON_FORMAT_SEQ or JSON_FORMAT_NEWLINE. */
+
+        if (!f)
+                f = stdout;
+
+        if (((flags & (JSON_FORMAT_COLOR_AUTO|JSON_FORMAT_COLOR)) == JSON_FORMAT_COLOR_AUTO) && colors_enabled())
+                flags |= JSON_FORMAT_COLOR;
+
+        if (((flags & (JSON_FORMAT_PRETTY_AUTO|JSON_FORMAT_PRETTY)) == JSON_FORMAT_PRETTY_AUTO))
+                flags |= on_tty() ? JSON_FORMAT_PRETTY : JSON_FORMAT_NEWLINE;
+
+        w = new(JsonWriter, 1);
+        if (!w)
+                return -ENOMEM;
+
+        *w = (JsonWriter) {
+                .f = f,
+                .flags = flags,
+        };
+
+        w->stack = new(JsonExpect, 1);
+        if (!w->stack)
+                return -ENOMEM;
+
+        w->stack[w->n_stack++] = EXPECT_TOPLEVEL;
+
+        w->prefix = strdup("");
+        if (!w->prefix)
+                return -ENOMEM;
+
+        *ret = TAKE_PTR(w);
+        return 0;
+}
+
+JsonWriter *json_writer_free(JsonWriter *w) {
+        if (!w)
+                return NULL;
+
+        free(w->stack);
+        free(w->prefix);
+        return mfree(w);
+}
+
+static void json_writer_separator(JsonWriter *w, bool comma) {
+        assert(w);
+
+        if (comma)
+                fputc(',', w->f);
+
+        if (w->flags & JSON_FORMAT_PRETTY) {
+                fputc('\n', w->f);
+                fputs(w->prefix, w->f);
+        }
+}
+
+static int json_writer_value_begin(JsonWriter *w) {
+        JsonExpect *e;
+
+        assert(w);
+
+        e = w->stack + w->n_stack - 1;
+
+        switch (*e) {
+
+        case EXPECT_TOPLEVEL:
+                if (w->flags & JSON_FORMAT_SSE)
+                        fputs("data: ", w->f);
+                if (w->flags & JSON_FORMAT_SEQ)
+                        fputc('\x1e', w->f); /* ASCII Record Separator */
+                return 0;
+
+        case EXPECT_OBJECT_VALUE:
+                return 0;
+
+        case EXPECT_ARRAY_FIRST_ELEMENT:
+        case EXPECT_ARRAY_NEXT_ELEMENT:
+                json_writer_separator(w, *e == EXPECT_ARRAY_NEXT_ELEMENT);
+                return 0;
+
+        default:
+                return -EINVAL; /* An object key is expected */
+        }
+}
+
+static int json_writer_value_end(JsonWriter *w) {
+        JsonExpect *e;
+
+        assert(w);
+
+        e = w->stack + w->n_stack - 1;
+
+        switch (*e) {
+
+        case EXPECT_TOPLEVEL:
+                if (w->flags & (JSON_FORMAT_PRETTY|JSON_FORMAT_SEQ|JSON_FORMAT_SSE|JSON_FORMAT_NEWLINE))
+                        fputc('\n', w->f);
+                if (w->flags & JSON_FORMAT_SSE)
+                        fputc('\n', w->f); /* In case of SSE add a second newline */
+
+                if (w->flags & JSON_FORMAT_FLUSH)
+                        return fflush_and_check(w->f);
+                return 0;
+
+        case EXPECT_OBJECT_VALUE:
+                *e = EXPECT_OBJECT_NEXT_KEY;
+                return 0;
+
+        case EXPECT_ARRAY_FIRST_ELEMENT:
+        case EXPECT_ARRAY_NEXT_ELEMENT:
+                *e = EXPECT_ARRAY_NEXT_ELEMENT;
+                return 0;
+
+        default:
+                assert_not_reached();
+        }
+}
+
+static int json_writer_begin(JsonWriter *w, JsonExpect expect, char c) {
+        int r;
+
+        assert(w);
+
+        if (w->n_stack > DEPTH_MAX) /* Refuse too deep nesting */
+                return -ELNRNG;
+
+        if (!GREEDY_REALLOC(w->stack, w->n_stack + 1))
+                return -ENOMEM;
+        if (!GREEDY_REALLOC(w->prefix, w->n_stack + 1))
+                return -ENOMEM;
+
+        r = json_writer_value_begin(w);
+        if (r < 0)
+                return r;
+
+        fputc(c, w->f);
+
+        w->prefix[w->n_stack - 1] = '\t';
+        w->prefix[w->n_stack] = 0;
+        w->stack[w->n_stack++] = expect;
+
+        return 0;
+}
+
+static int json_writer_end(JsonWriter *w, bool object) {
+        JsonExpect e;
+
+        assert(w);
+
+        if (w->n_stack <= 1)
+                return -EINVAL;
+
+        e = w->stack[w->n_stack - 1];
+        if (object ? !IN_SET(e, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_NEXT_KEY) :
+                     !IN_SET(e, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT))
+                return -EINVAL;
+
+        w->n_stack--;
+        w->prefix[w->n_stack - 1] = 0;
+
+        /* Empty objects and arrays are written in a single line, even in pretty mode */
+        if (IN_SET(e, EXPECT_OBJECT_NEXT_KEY, EXPECT_ARRAY_NEXT_ELEMENT))
+                json_writer_separator(w, false);
+
+        fputc(object ? '}' : ']', w->f);
+
+        return json_writer_value_end(w);
+}
+
+int json_writer_begin_object(JsonWriter *w) {
+        assert_return(w, -EINVAL);
+        return json_writer_begin(w, EXPECT_OBJECT_FIRST_KEY, '{');
+}
+
+int json_writer_end_object(JsonWriter *w) {
+        assert_return(w, -EINVAL);
+        return json_writer_end(w, true);
+}
+
+int json_writer_begin_array(JsonWriter *w) {
+        assert_return(w, -EINVAL);
+        return json_writer_begin(w, EXPECT_ARRAY_FIRST_ELEMENT, '[');
+}
+
+int json_writer_end_array(JsonWriter *w) {
+        assert_return(w, -EINVAL);
+        return json_writer_end(w, false);
+}
+
+int json_writer_key(JsonWriter *w, const char *key) {
+        JsonExpect *e;
+
+        assert_return(w, -EINVAL);
+        assert_return(key, -EINVAL);
+
+        e = w->stack + w->n_stack - 1;
+        if (!IN_SET(*e, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_NEXT_KEY))
+                return -EINVAL;
+
+        if (!utf8_is_valid(key)) /* JSON strings must be valid UTF-8 */
+                return -EUCLEAN;
+
+        json_writer_separator(w, *e == EXPECT_OBJECT_NEXT_KEY);
+        json_format_string(w->f, key, w->flags);
+        fputs(w->flags & JSON_FORMAT_PRETTY ? " : " : ":", w->f);
+
+        *e = EXPECT_OBJECT_VALUE;
+        return 0;
+}
+
+int json_writer_variant(JsonWriter *w, JsonVariant *v) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        r = json_writer_value_begin(w);
+        if (r < 0)
+                return r;
+
+        r = json_format(w->f, v ?: JSON_VARIANT_MAGIC_NULL, w->flags, w->prefix);
+        if (r < 0)
+                return r;
+
+        return json_writer_value_end(w);
+}
+
+int json_writer_string(JsonWriter *w, const char *s) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        if (!s)
+                return json_writer_variant(w, JSON_VARIANT_MAGIC_NULL);
+
+        if (!utf8_is_valid(s)) /* JSON strings must be valid UTF-8 */
+                return -EUCLEAN;
+
+        r = json_writer_value_begin(w);
+        if (r < 0)
+                return r;
+
+        json_format_string(w->f, s, w->flags);
+
+        return json_writer_value_end(w);
+}
+
+/* For numbers we format a JsonVariant on the stack, so that we don't need to allocate anything, but
+ * generate the exact same output as for a heap allocated one. */
+
+int json_writer_integer(JsonWriter *w, int64_t i) {
+        JsonVariant v = {
+                .n_ref = 1,
+                .type = JSON_VARIANT_INTEGER,
+                .value.integer = i,
+        };
+
+        return json_writer_variant(w, &v);
+}
+
+int json_writer_unsigned(JsonWriter *w, uint64_t u) {
+        JsonVariant v = {
+                .n_ref = 1,
+                .type = JSON_VARIANT_UNSIGNED,
+                .value.unsig = u,
+        };
+
+        return json_writer_variant(w, &v);
+}
+
+int json_writer_real(JsonWriter *w, double d) {
+        JsonVariant v = {
+                .n_ref = 1,
+                .type = JSON_VARIANT_REAL,
+                .value.real = d,
+        };
+
+        /* JSON doesn't know NaN, +Infinity or -Infinity. Let's silently convert to 'null'. */
+        if (IN_SET(fpclassify(d), FP_NAN, FP_INFINITE))
+                return json_writer_variant(w, JSON_VARIANT_MAGIC_NULL);
+
+        return json_writer_variant(w, &v);
+}
+
+int json_writer_boolean(JsonWriter *w, bool b) {
+        return json_writer_variant(w, b ? JSON_VARIANT_MAGIC_TRUE : JSON_VARIANT_MAGIC_FALSE);
+}
+
+int json_writer_null(JsonWriter *w) {
+        return json_writer_variant(w, JSON_VARIANT_MAGIC_NULL);
 }
 
 int json_buildv(JsonVariant **ret, va_list ap) {
@@ -8,6 +8,7 @@
 #include <sys/prctl.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 
 /* include missing_syscall_def.h earlier to make __SNR_foo mapped to __NR_foo. */
 #include "missing_syscall_def.h"
@@ -17,13 +18,18 @@
 #include "alloc-util.h"
 #include "env-util.h"
 #include "errno-list.h"
+#include "errno-util.h"
+#include "fd-util.h"
+#include "fileio.h"
 #include "macro.h"
+#include "memfd-util.h"
 #include "namespace-util.h"
 #include "nsflags.h"
 #include "nulstr-util.h"
 #include "process-util.h"
 #include "seccomp-util.h"
 #include "set.h"
+#include "sort-util.h"
 #include "string-util.h"
 #include "strv.h"
 
@@ -1096,6 +1102,61 @@ int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilter
         return 0;
 }
 
+static int seccomp_build_syscall_filter_set_raw(
+                uint32_t arch,
+                uint32_t default_action,
+                Hashmap *filter,
+                uint32_t action,
+                bool log_missing,
+                scmp_filter_ctx *ret) {
+
+        _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
+        void *syscall_id, *val;
+        int r;
+
+        assert(ret);
+
+        log_trace("Operating on architecture: %s", seccomp_arch_to_string(arch));
+
+        r = seccomp_init_for_arch(&seccomp, arch, default_action);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(val, syscall_id, filter) {
+                uint32_t a = action;
+                int id = PTR_TO_INT(syscall_id) - 1;
+                int error = PTR_TO_INT(val);
+
+                if (error == SECCOMP_ERROR_NUMBER_KILL)
+                        a = scmp_act_kill_process();
+#ifdef SCMP_ACT_LOG
+                else if (action == SCMP_ACT_LOG)
+                        a = SCMP_ACT_LOG;
+#endif
+                else if (error >= 0)
+                        a = SCMP_ACT_ERRNO(error);
+
+                r = seccomp_rule_add_exact(seccomp, a, id, 0);
+                if (r < 0) {
+                        /* If the system call is not known on this architecture, then that's
+                         * fine, let's ignore it */
+                        _cleanup_free_ char *n = NULL;
+                        bool ignore;
+
+                        n = seccomp_syscall_resolve_num_arch(SCMP_ARCH_NATIVE, id);
+                        ignore = r == -EDOM;
+                        if (!ignore || log_missing)
+                                log_debug_errno(r, "Failed to add rule for system call %s() / %d%s: %m",
+                                                strna(n), id, ignore ? ", ignoring" : "");
+                        if (!ignore)
+                                return r;
+                }
+        }
+
+        *ret = TAKE_PTR(seccomp);
+        return 0;
+}
+
 int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* filter, uint32_t action, bool log_missing) {
         uint32_t arch;
         int r;
@@ -1108,56 +1169,294 @@ int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* filter
 
         SECCOMP_FOREACH_LOCAL_ARCH(arch) {
                 _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
-                void *syscall_id, *val;
 
-                log_trace("Operating on architecture: %s", seccomp_arch_to_string(arch));
+                r = seccomp_build_syscall_filter_set_raw(arch, default_action, filter, action, log_missing, &seccomp);
+                if (r < 0)
+                        return r;
 
-                r = seccomp_init_for_arch(&seccomp, arch, default_action);
+                r = seccomp_load(seccomp);
+                if (ERRNO_IS_SECCOMP_FATAL(r))
+                        return r;
+                if (r < 0)
+                        log_debug_errno(r, "Failed to install system call filter for architecture %s, skipping: %m",
+                                        seccomp_arch_to_string(arch));
+        }
+
+        return 0;
+}
+
+SeccompProgram* seccomp_program_free(SeccompProgram *p) {
+        if (!p)
+                return NULL;
+
+        for (size_t i = 0; i < p->n_filters; i++)
+                free(p->filters[i].prog.filter);
+        free(p->filters);
+
+        return mfree(p);
+}
+
+static int seccomp_export_program(scmp_filter_ctx seccomp, struct sock_fprog *ret) {
+        _cleanup_free_ struct sock_filter *code = NULL;
+        _cleanup_close_ int fd = -1;
+        struct stat st;
+        ssize_t n;
+        int r;
+
+        assert(seccomp);
+        assert(ret);
+
+        fd = memfd_new("seccomp-bpf");
+        if (fd < 0)
+                return fd;
+
+        r = seccomp_export_bpf(seccomp, fd);
+        if (r < 0)
+                return r;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if (st.st_size <= 0 ||
+            st.st_size % sizeof(struct sock_filter) != 0 ||
+            st.st_size / sizeof(struct sock_filter) > BPF_MAXINSNS)
+                return -EBADMSG;
+
+        code = malloc(st.st_size);
+        if (!code)
+                return -ENOMEM;
+
+        n = pread(fd, code, st.st_size, 0);
+        if (n < 0)
+                return -errno;
+        if (n != st.st_size)
+                return -EIO;
+
+        *ret = (struct sock_fprog) {
+                .len = st.st_size / sizeof(struct sock_filter),
+                .filter = TAKE_PTR(code),
+        };
+
+        return 0;
+}
+
+int seccomp_compile_syscall_filter_set_raw(
+                uint32_t default_action,
+                Hashmap *filter,
+                uint32_t action,
+                bool log_missing,
+                SeccompProgram **ret) {
+
+        _cleanup_(seccomp_program_freep) SeccompProgram *p = NULL;
+        uint32_t arch;
+        int r;
+
+        assert(ret);
+
+        /* Like seccomp_load_syscall_filter_set_raw(), but doesn't load the filters into the kernel and
+         * returns the BPF code instead, so that it can be loaded with seccomp_program_load() later on,
+         * possibly many times, and in another process. */
+
+        p = new0(SeccompProgram, 1);
+        if (!p)
+                return -ENOMEM;
+
+        if (hashmap_isempty(filter) && default_action == SCMP_ACT_ALLOW) {
+                *ret = TAKE_PTR(p);
+                return 0;
+        }
+
+        SECCOMP_FOREACH_LOCAL_ARCH(arch) {
+                _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
+                struct sock_fprog prog;
+
+                r = seccomp_build_syscall_filter_set_raw(arch, default_action, filter, action, log_missing, &seccomp);
                 if (r < 0)
                         return r;
 
-                HASHMAP_FOREACH_KEY(val, syscall_id, filter) {
-                        uint32_t a = action;
-                        int id = PTR_TO_INT(syscall_id) - 1;
-                        int error = PTR_TO_INT(val);
+                /* seccomp_load() would pass this on to the kernel as a flag */
+#if (SCMP_VER_MAJOR >= 3 || (SCMP_VER_MAJOR == 2 && SCMP_VER_MINOR >= 4)) && defined(SECCOMP_FILTER_FLAG_LOG)
+                uint32_t log = 0;
 
-                        if (error == SECCOMP_ERROR_NUMBER_KILL)
-                                a = scmp_act_kill_process();
-#ifdef SCMP_ACT_LOG
-                        else if (action == SCMP_ACT_LOG)
-                                a = SCMP_ACT_LOG;
+                r = seccomp_attr_get(seccomp, SCMP_FLTATR_CTL_LOG, &log);
+                if (r < 0)
+                        return r;
+                if (log)
+                        p->flags |= SECCOMP_FILTER_FLAG_LOG;
 #endif
-                        else if (error >= 0)
-                                a = SCMP_ACT_ERRNO(error);
 
-                        r = seccomp_rule_add_exact(seccomp, a, id, 0);
-                        if (r < 0) {
-                                /* If the system call is not known on this architecture, then that's
-                                 * fine, let's ignore it */
-                                _cleanup_free_ char *n = NULL;
-                                bool ignore;
-
-                                n = seccomp_syscall_resolve_num_arch(SCMP_ARCH_NATIVE, id);
-                                ignore = r == -EDOM;
-                                if (!ignore || log_missing)
-                                        log_debug_errno(r, "Failed to add rule for system call %s() / %d%s: %m",
-                                                        strna(n), id, ignore ? ", ignoring" : "");
-                                if (!ignore)
-                                        return r;
-                        }
+                r = seccomp_export_program(seccomp, &prog);
+                if (r < 0)
+                        return r;
+
+                if (!GREEDY_REALLOC(p->filters, p->n_filters + 1)) {
+                        free(prog.filter);
+                        return -ENOMEM;
                 }
 
-                r = seccomp_load(seccomp);
+                p->filters[p->n_filters++] = (SeccompProgramFilter) {
+                        .arch = arch,
+                        .prog = prog,
+                };
+        }
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+static bool seccomp_local_arch_enabled(uint32_t arch) {
+        uint32_t a;
+
+        SECCOMP_FOREACH_LOCAL_ARCH(a)
+                if (a == arch)
+                        return true;
+
+        return false;
+}
+
+static int seccomp_load_program_filter(uint32_t flags, const struct sock_fprog *prog) {
+        assert(prog);
+
+        if (syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, flags, prog) >= 0)
+                return 0;
+        if (errno != ENOSYS || flags != 0)
+                return -errno;
+
+        /* Kernels before 3.17 only have the prctl() interface */
+        return RET_NERRNO(prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, prog));
+}
+
+int seccomp_program_load(const SeccompProgram *p) {
+        int r;
+
+        assert(p);
+
+        /* Loads the filters in the same order and with the same error handling as
+         * seccomp_load_syscall_filter_set_raw() does. Filters for architectures that got blocked by
+         * seccomp_restrict_archs() since the program was compiled are skipped, as they would not have been
+         * compiled in the first place if that had happened earlier. */
+
+        for (size_t i = 0; i < p->n_filters; i++) {
+                if (!seccomp_local_arch_enabled(p->filters[i].arch))
+                        continue;
+
+                r = seccomp_load_program_filter(p->flags, &p->filters[i].prog);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
                         log_debug_errno(r, "Failed to install system call filter for architecture %s, skipping: %m",
-                                        seccomp_arch_to_string(arch));
+                                        seccomp_arch_to_string(p->filters[i].arch));
         }
 
         return 0;
 }
 
+/* Don't let the cache grow without bounds if policies keep changing */
+#define SECCOMP_PROGRAM_CACHE_MAX 256U
+
+DEFINE_PRIVATE_HASH_OPS_FULL(seccomp_program_hash_ops, char, string_hash_func, string_compare_func, free,
+                             SeccompProgram, seccomp_program_free);
+
+typedef struct SyscallFilterItem {
+        int id;
+        int error;
+} SyscallFilterItem;
+
+static int syscall_filter_item_compare(const SyscallFilterItem *a, const SyscallFilterItem *b) {
+        return CMP(a->id, b->id);
+}
+
+static int seccomp_syscall_filter_key(uint32_t default_action, Hashmap *filter, uint32_t action, char **ret) {
+        _cleanup_free_ SyscallFilterItem *items = NULL;
+        _cleanup_free_ char *key = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        void *syscall_id, *val;
+        size_t n = 0, sz = 0;
+        int r;
+
+        assert(ret);
+
+        /* Serializes everything the compiled filters depend on into a string, with the system calls in a
+         * well-defined order, so that identical policies map to the same key. */
+
+        items = new(SyscallFilterItem, hashmap_size(filter));
+        if (!items && !hashmap_isempty(filter))
+                return -ENOMEM;
+
+        HASHMAP_FOREACH_KEY(val, syscall_id, filter)
+                items[n++] = (SyscallFilterItem) {
+                        .id = PTR_TO_INT(syscall_id) - 1,
+                        .error = PTR_TO_INT(val),
+                };
+
+        typesafe_qsort(items, n, syscall_filter_item_compare);
+
+        f = open_memstream_unlocked(&key, &sz);
+        if (!f)
+                return -ENOMEM;
+
+        fprintf(f, "%" PRIx32 ":%" PRIx32 ":%i:", default_action, action, getenv_bool("SYSTEMD_LOG_SECCOMP") > 0);
+
+        for (size_t i = 0; seccomp_local_archs[i] != SECCOMP_LOCAL_ARCH_END; i++)
+                fprintf(f, "%" PRIx32 ",", seccomp_local_archs[i]);
+
+        for (size_t i = 0; i < n; i++)
+                fprintf(f, ":%i=%i", items[i].id, items[i].error);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        f = safe_fclose(f);
+
+        *ret = TAKE_PTR(key);
+        return 0;
+}
+
+int seccomp_syscall_filter_cache_get(
+                Hashmap **cache,
+                uint32_t default_action,
+                Hashmap *filter,
+                uint32_t action,
+                const SeccompProgram **ret) {
+
+        _cleanup_(seccomp_program_freep) SeccompProgram *p = NULL;
+        _cleanup_free_ char *key = NULL;
+        SeccompProgram *cached;
+        int r;
+
+        assert(cache);
+        assert(ret);
+
+        /* Returns the compiled filters for the specified policy, compiling them only if they are not in the
+         * cache yet. The returned object is owned by the cache, and valid until the next call. */
+
+        r = seccomp_syscall_filter_key(default_action, filter, action, &key);
+        if (r < 0)
+                return r;
+
+        cached = hashmap_get(*cache, key);
+        if (cached) {
+                *ret = cached;
+                return 0;
+        }
+
+        r = seccomp_compile_syscall_filter_set_raw(default_action, filter, action, /* log_missing= */ false, &p);
+        if (r < 0)
+                return r;
+
+        if (hashmap_size(*cache) >= SECCOMP_PROGRAM_CACHE_MAX)
+                hashmap_clear(*cache);
+
+        r = hashmap_ensure_put(cache, &seccomp_program_hash_ops, key, p);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(key);
+        *ret = TAKE_PTR(p);
+        return 1;
+}
+
 int seccomp_parse_syscall_filter(
                 const char *name,
                 int errno_num,
@@ -3,6 +3,7 @@
 
 #if HAVE_SECCOMP
 
+#include <linux/filter.h>
 #include <seccomp.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -76,6 +77,25 @@ int seccomp_add_syscall_filter_item(
 int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilterSet *set, uint32_t action, bool log_missing);
 int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, uint32_t action, bool log_missing);
 
+/* Compiled filters for all local architectures, ready to be loaded into the kernel */
+typedef struct SeccompProgramFilter {
+        uint32_t arch;
+        struct sock_fprog prog;
+} SeccompProgramFilter;
+
+typedef struct SeccompProgram {
+        uint32_t flags; /* SECCOMP_FILTER_FLAG_xyz */
+        size_t n_filters;
+        SeccompProgramFilter *filters;
+} SeccompProgram;
+
+int seccomp_compile_syscall_filter_set_raw(uint32_t default_action, Hashmap *set, uint32_t action, bool log_missing, SeccompProgram **ret);
+int seccomp_program_load(const SeccompProgram *p);
+SeccompProgram* seccomp_program_free(SeccompProgram *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(SeccompProgram*, seccomp_program_free);
+
+int seccomp_syscall_filter_cache_get(Hashmap **cache, uint32_t default_action, Hashmap *set, uint32_t action, const SeccompProgram **ret);
+
 typedef enum SeccompParseFlags {
         SECCOMP_PARSE_INVERT     = 1 << 0,
         SECCOMP_PARSE_ALLOW_LIST = 1 << 1,
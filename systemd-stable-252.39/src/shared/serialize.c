@@ -1,9 +1,12 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "alloc-util.h"
 #include "env-util.h"
+#include "errno-util.h"
 #include "escape.h"
 #include "fileio.h"
 #include "missing_mman.h"
@@ -13,6 +16,7 @@
 #include "serialize.h"
 #include "strv.h"
 #include "tmpfile-util.h"
+#include "unaligned.h"
 
 int serialize_item(FILE *f, const char *key, const char *value) {
         assert(f);
@@ -230,3 +234,392 @@ int open_serialization_fd(const char *ident) {
 
         return fd;
 }
+
+/* Layout of the binary serialization format. All integers are little endian and unaligned, all offsets are
+ * relative to the start of the header.
+ *
+ *   header: 8 byte signature, le32 version, le32 number of records, le64 offset of the index, le64 total size
+ *   record: a sequence of items, each consisting of a le32 key size, a le32 value size, the key, NUL, the
+ *           value, NUL. An item with an empty key terminates a nested block (e.g. a job), just like an
+ *           empty line does in the text format.
+ *   index:  for each record a le64 offset, a le64 size, a le32 name size, the name, NUL.
+ *
+ * The signature starts with a control character, which never starts a line of a text serialization (and
+ * unlike NUL is not swallowed by read_line() as part of the preceding newline), hence readers can tell the two
+ * formats apart by peeking at a single byte. */
+#define BINARY_SERIALIZATION_SIGNATURE "\001SDSRLZ\n"
+#define BINARY_SERIALIZATION_SIGNATURE_SIZE 8
+#define BINARY_SERIALIZATION_VERSION 1U
+#define BINARY_SERIALIZATION_HEADER_SIZE 32U
+#define BINARY_SERIALIZATION_ITEM_HEADER_SIZE 8U
+#define BINARY_SERIALIZATION_INDEX_HEADER_SIZE 20U
+
+assert_cc(sizeof(BINARY_SERIALIZATION_SIGNATURE) == BINARY_SERIALIZATION_SIGNATURE_SIZE + 1);
+
+static int binary_serializer_offset(BinarySerializer *s, uint64_t *ret) {
+        off_t p;
+
+        assert(s);
+        assert(ret);
+
+        p = ftello(s->f);
+        if (p < 0)
+                return -errno;
+
+        assert(p >= s->start);
+        *ret = (uint64_t) (p - s->start);
+        return 0;
+}
+
+int binary_serializer_begin(BinarySerializer *s, FILE *f) {
+        uint8_t header[BINARY_SERIALIZATION_HEADER_SIZE] = {};
+        off_t start;
+
+        assert(s);
+        assert(f);
+
+        start = ftello(f);
+        if (start < 0)
+                return -errno;
+
+        /* Only a placeholder, the real header is written by binary_serializer_finish() */
+        if (fwrite(header, sizeof(header), 1, f) != 1)
+                return errno_or_else(EIO);
+
+        *s = (BinarySerializer) {
+                .f = f,
+                .start = start,
+        };
+
+        return 0;
+}
+
+static void binary_serializer_write_item(FILE *f, const char *key, size_t key_size, const char *value, size_t value_size) {
+        uint8_t header[BINARY_SERIALIZATION_ITEM_HEADER_SIZE];
+
+        assert(f);
+        assert(key);
+        assert(value);
+
+        unaligned_write_le32(header, key_size);
+        unaligned_write_le32(header + 4, value_size);
+
+        /* Write errors are caught when the stream is flushed in binary_serializer_finish() */
+        fwrite(header, sizeof(header), 1, f);
+        fwrite(key, key_size + 1, 1, f);
+        fwrite(value, value_size + 1, 1, f);
+}
+
+int binary_serializer_begin_record(BinarySerializer *s) {
+        assert(s);
+        assert(s->f);
+
+        return binary_serializer_offset(s, &s->record_offset);
+}
+
+void binary_serializer_add_item(BinarySerializer *s, const char *key, const char *value) {
+        assert(s);
+        assert(s->f);
+        assert(key);
+        assert(value);
+
+        binary_serializer_write_item(s->f, key, strlen(key), value, strlen(value));
+}
+
+int binary_serializer_end_record(BinarySerializer *s, const char *name) {
+        size_t name_size;
+        uint64_t end;
+        uint8_t *i;
+        int r;
+
+        assert(s);
+        assert(s->f);
+        assert(name);
+
+        /* Adds the items written since binary_serializer_begin_record() to the index, under the specified
+         * name. */
+
+        r = binary_serializer_offset(s, &end);
+        if (r < 0)
+                return r;
+
+        name_size = strlen(name);
+
+        if (!GREEDY_REALLOC(s->index, s->index_size + BINARY_SERIALIZATION_INDEX_HEADER_SIZE + name_size + 1))
+                return -ENOMEM;
+
+        i = s->index + s->index_size;
+        unaligned_write_le64(i, s->record_offset);
+        unaligned_write_le64(i + 8, end - s->record_offset);
+        unaligned_write_le32(i + 16, name_size);
+        memcpy(i + BINARY_SERIALIZATION_INDEX_HEADER_SIZE, name, name_size + 1);
+
+        s->index_size += BINARY_SERIALIZATION_INDEX_HEADER_SIZE + name_size + 1;
+        s->n_records++;
+
+        return 0;
+}
+
+int binary_serializer_add_text(BinarySerializer *s, char *text, size_t size) {
+        const char *name = NULL;
+        int r;
+
+        assert(s);
+        assert(s->f);
+        assert(text || size == 0);
+
+        /* Transcodes one text record, i.e. a name line followed by key=value lines and an empty line, and
+         * adds it to the index. The buffer is modified in place and needs to be NUL terminated at 'size', as
+         * the ones returned by open_memstream() are. Returns 0 if the buffer is empty and nothing was added. */
+
+        if (size == 0)
+                return 0;
+
+        assert(text[size] == '\0');
+
+        r = binary_serializer_begin_record(s);
+        if (r < 0)
+                return r;
+
+        for (char *p = text, *e = text + size; p < e;) {
+                char *eol, *l, *v;
+                size_t k;
+
+                eol = memchr(p, '\n', e - p) ?: e;
+                *eol = '\0';
+
+                l = strstrip(p);
+                p = eol + 1;
+
+                if (!name) {
+                        if (isempty(l))
+                                return -EINVAL;
+
+                        name = l;
+                        continue;
+                }
+
+                /* The end marker of the record itself is implied by its size */
+                if (p >= e && isempty(l))
+                        break;
+
+                k = strcspn(l, "=");
+                if (l[k] == '=') {
+                        l[k] = '\0';
+                        v = l + k + 1;
+                } else
+                        v = l + k;
+
+                binary_serializer_write_item(s->f, l, k, v, strlen(v));
+        }
+
+        if (!name)
+                return -EINVAL;
+
+        r = binary_serializer_end_record(s, name);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+int binary_serializer_finish(BinarySerializer *s) {
+        uint8_t header[BINARY_SERIALIZATION_HEADER_SIZE] = {};
+        uint64_t index_offset, size;
+        int r;
+
+        assert(s);
+        assert(s->f);
+
+        r = binary_serializer_offset(s, &index_offset);
+        if (r < 0)
+                return r;
+
+        if (s->index_size > 0 && fwrite(s->index, s->index_size, 1, s->f) != 1)
+                return errno_or_else(EIO);
+
+        r = binary_serializer_offset(s, &size);
+        if (r < 0)
+                return r;
+
+        memcpy(header, BINARY_SERIALIZATION_SIGNATURE, BINARY_SERIALIZATION_SIGNATURE_SIZE);
+        unaligned_write_le32(header + 8, BINARY_SERIALIZATION_VERSION);
+        unaligned_write_le32(header + 12, s->n_records);
+        unaligned_write_le64(header + 16, index_offset);
+        unaligned_write_le64(header + 24, size);
+
+        if (fseeko(s->f, s->start, SEEK_SET) < 0)
+                return -errno;
+
+        if (fwrite(header, sizeof(header), 1, s->f) != 1)
+                return errno_or_else(EIO);
+
+        if (fseeko(s->f, s->start + (off_t) size, SEEK_SET) < 0)
+                return -errno;
+
+        return fflush_and_check(s->f);
+}
+
+void binary_serializer_done(BinarySerializer *s) {
+        assert(s);
+
+        s->index = mfree(s->index);
+        s->index_size = 0;
+        s->n_records = 0;
+}
+
+int binary_deserializer_open(BinaryDeserializer *d, FILE *f) {
+        uint64_t index_offset, size;
+        const uint8_t *h;
+        struct stat st;
+        off_t start;
+        void *map;
+        int c;
+
+        assert(d);
+        assert(f);
+
+        /* Returns 0 and leaves the stream untouched if the data at the current position is not in the binary
+         * format, 1 if it is. In the latter case the whole file is mapped and the stream is positioned
+         * after the binary data. */
+
+        c = fgetc(f);
+        if (c == EOF)
+                return ferror(f) ? -EIO : 0;
+        if (c != BINARY_SERIALIZATION_SIGNATURE[0]) {
+                if (ungetc(c, f) == EOF)
+                        return -EIO;
+
+                return 0;
+        }
+
+        start = ftello(f);
+        if (start < 0)
+                return -errno;
+        start--;
+
+        if (fstat(fileno(f), &st) < 0)
+                return -errno;
+        if (st.st_size < start || (uint64_t) (st.st_size - start) < BINARY_SERIALIZATION_HEADER_SIZE)
+                return -EBADMSG;
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (map == MAP_FAILED)
+                return -errno;
+
+        *d = (BinaryDeserializer) {
+                .map = map,
+                .map_size = st.st_size,
+        };
+
+        h = (const uint8_t*) map + start;
+        index_offset = unaligned_read_le64(h + 16);
+        size = unaligned_read_le64(h + 24);
+
+        if (memcmp(h, BINARY_SERIALIZATION_SIGNATURE, BINARY_SERIALIZATION_SIGNATURE_SIZE) != 0 ||
+            unaligned_read_le32(h + 8) != BINARY_SERIALIZATION_VERSION ||
+            size > (uint64_t) (st.st_size - start) ||
+            index_offset < BINARY_SERIALIZATION_HEADER_SIZE ||
+            index_offset > size) {
+                binary_deserializer_done(d);
+                return -EBADMSG;
+        }
+
+        d->base = h;
+        d->records_end = h + index_offset;
+        d->index = h + index_offset;
+        d->index_end = h + size;
+        d->n_records = unaligned_read_le32(h + 12);
+
+        if (fseeko(f, start + (off_t) size, SEEK_SET) < 0) {
+                binary_deserializer_done(d);
+                return -errno;
+        }
+
+        return 1;
+}
+
+int binary_deserializer_next(BinaryDeserializer *d, const char **ret_name, BinaryRecord *ret_record) {
+        uint64_t offset, size;
+        uint32_t name_size;
+        size_t left;
+
+        assert(d);
+        assert(ret_name);
+        assert(ret_record);
+
+        if (d->index >= d->index_end)
+                return 0;
+
+        left = d->index_end - d->index;
+        if (left < BINARY_SERIALIZATION_INDEX_HEADER_SIZE)
+                return -EBADMSG;
+        left -= BINARY_SERIALIZATION_INDEX_HEADER_SIZE;
+
+        offset = unaligned_read_le64(d->index);
+        size = unaligned_read_le64(d->index + 8);
+        name_size = unaligned_read_le32(d->index + 16);
+
+        if (name_size >= left ||
+            d->index[BINARY_SERIALIZATION_INDEX_HEADER_SIZE + name_size] != 0 ||
+            offset < BINARY_SERIALIZATION_HEADER_SIZE ||
+            offset > (uint64_t) (d->records_end - d->base) ||
+            size > (uint64_t) (d->records_end - d->base) - offset)
+                return -EBADMSG;
+
+        *ret_name = (const char*) d->index + BINARY_SERIALIZATION_INDEX_HEADER_SIZE;
+        *ret_record = (BinaryRecord) {
+                .p = d->base + offset,
+                .end = d->base + offset + size,
+        };
+
+        d->index += BINARY_SERIALIZATION_INDEX_HEADER_SIZE + name_size + 1;
+        return 1;
+}
+
+void binary_deserializer_done(BinaryDeserializer *d) {
+        assert(d);
+
+        if (d->map)
+                (void) munmap(d->map, d->map_size);
+
+        *d = (BinaryDeserializer) {};
+}
+
+int binary_record_next(BinaryRecord *r, const char **ret_key, const char **ret_value) {
+        uint32_t key_size, value_size;
+        const char *key, *value;
+        size_t left;
+
+        assert(r);
+        assert(ret_key);
+        assert(ret_value);
+
+        /* Returns 1 and the next item of the record, or 0 at its end. The strings point into the mapping. */
+
+        if (r->p >= r->end)
+                return 0;
+
+        left = r->end - r->p;
+        if (left < BINARY_SERIALIZATION_ITEM_HEADER_SIZE)
+                return -EBADMSG;
+        left -= BINARY_SERIALIZATION_ITEM_HEADER_SIZE;
+
+        key_size = unaligned_read_le32(r->p);
+        value_size = unaligned_read_le32(r->p + 4);
+
+        if (key_size >= left || value_size >= left - key_size - 1)
+                return -EBADMSG;
+
+        key = (const char*) r->p + BINARY_SERIALIZATION_ITEM_HEADER_SIZE;
+        value = key + key_size + 1;
+
+        if (key[key_size] != 0 || value[value_size] != 0)
+                return -EBADMSG;
+
+        r->p = (const uint8_t*) value + value_size + 1;
+
+        *ret_key = key;
+        *ret_value = value;
+        return 1;
+}
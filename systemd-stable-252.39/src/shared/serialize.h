@@ -25,3 +25,46 @@ int deserialize_dual_timestamp(const char *value, dual_timestamp *t);
 int deserialize_environment(const char *value, char ***environment);
 
 int open_serialization_fd(const char *ident);
+
+/* A binary framing for sequences of serialized records, each of which is transcoded from a text block in the
+ * usual "<name>\n<key>=<value>\n…\n\n" format. Items are length-prefixed and NUL-terminated, and an offset
+ * table at the end lists every record, so that the reader can map the data and hand out pointers into it,
+ * without copying or line splitting, and skip records it is not interested in. See serialize.c for the
+ * layout. */
+typedef struct BinarySerializer {
+        FILE *f;
+        off_t start;
+        uint64_t record_offset;
+        uint32_t n_records;
+        uint8_t *index;
+        size_t index_size;
+} BinarySerializer;
+
+int binary_serializer_begin(BinarySerializer *s, FILE *f);
+int binary_serializer_begin_record(BinarySerializer *s);
+void binary_serializer_add_item(BinarySerializer *s, const char *key, const char *value);
+int binary_serializer_end_record(BinarySerializer *s, const char *name);
+int binary_serializer_add_text(BinarySerializer *s, char *text, size_t size);
+int binary_serializer_finish(BinarySerializer *s);
+void binary_serializer_done(BinarySerializer *s);
+
+typedef struct BinaryRecord {
+        const uint8_t *p;
+        const uint8_t *end;
+} BinaryRecord;
+
+typedef struct BinaryDeserializer {
+        void *map;
+        size_t map_size;
+        const uint8_t *base;
+        const uint8_t *records_end;
+        const uint8_t *index;
+        const uint8_t *index_end;
+        uint32_t n_records;
+} BinaryDeserializer;
+
+int binary_deserializer_open(BinaryDeserializer *d, FILE *f);
+int binary_deserializer_next(BinaryDeserializer *d, const char **ret_name, BinaryRecord *ret_record);
+void binary_deserializer_done(BinaryDeserializer *d);
+
+int binary_record_next(BinaryRecord *r, const char **ret_key, const char **ret_value);
@@ -0,0 +1,772 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "hashmap.h"
+#include "missing_threads.h"
+#include "stat-util.h"
+#include "string-util.h"
+#include "time-util.h"
+#include "tzfile.h"
+#include "unaligned.h"
+
+/* Avoid huge allocations for corrupted files. The largest timezone files shipped by tzdata are a few KiB. */
+#define TZFILE_SIZE_MAX (1024U*1024U)
+
+#define TM_YEAR_BASE 1900
+#define EPOCH_YEAR 1970
+
+typedef struct TZFileType {
+        int32_t offset;
+        bool isdst;
+        size_t abbr;            /* Index into TZFile.abbrs */
+} TZFileType;
+
+typedef enum TZRuleType {
+        TZ_RULE_JULIAN_1,       /* Jn: day 1…365, February 29th is never counted */
+        TZ_RULE_JULIAN_0,       /* n: day 0…365, February 29th is counted in leap years */
+        TZ_RULE_MONTH,          /* Mm.n.d: day d of week n of month m */
+} TZRuleType;
+
+typedef struct TZRule {
+        char *name;
+        long offset;            /* Seconds east of UTC */
+        TZRuleType type;
+        unsigned short m, n, d;
+        int secs;               /* Local time of day the change happens at */
+} TZRule;
+
+struct TZFile {
+        int64_t *transitions;
+        uint8_t *transition_types;
+        size_t n_transitions;
+
+        TZFileType *types;
+        size_t n_types;
+
+        char *abbrs;
+        size_t n_abbrs;
+
+        /* The POSIX TZ string from the footer, used for all times after the last transition. rules[0] is
+         * standard time and the start of DST, rules[1] is DST and its end. */
+        bool has_footer;
+        bool has_dst;
+        TZRule rules[2];
+
+        /* Identifies the file for the cache */
+        dev_t dev;
+        ino_t ino;
+        struct timespec mtime;
+        off_t size;
+};
+
+static const unsigned short mon_yday[2][13] = {
+        /* Normal years */
+        { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 },
+        /* Leap years */
+        { 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366 },
+};
+
+static bool is_leap(int64_t year) {
+        return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+TZFile* tzfile_free(TZFile *tz) {
+        if (!tz)
+                return NULL;
+
+        free(tz->transitions);
+        free(tz->transition_types);
+        free(tz->types);
+        free(tz->abbrs);
+        free(tz->rules[0].name);
+        free(tz->rules[1].name);
+
+        return mfree(tz);
+}
+
+static int parse_name(const char **p, char **ret) {
+        const char *s = *p, *e;
+        char *n;
+
+        /* Either a quoted "<+0330>" or an unquoted "CET" */
+
+        if (*s == '<') {
+                s++;
+                for (e = s; ascii_isalpha(*e) || ascii_isdigit(*e) || IN_SET(*e, '+', '-'); e++)
+                        ;
+                if (*e != '>')
+                        return -EINVAL;
+        } else
+                for (e = s; ascii_isalpha(*e); e++)
+                        ;
+
+        if (e - s < 3)
+                return -EINVAL;
+
+        n = strndup(s, e - s);
+        if (!n)
+                return -ENOMEM;
+
+        *p = *e == '>' ? e + 1 : e;
+        *ret = n;
+        return 0;
+}
+
+static int parse_hms(const char **p, int *ret) {
+        const char *s = *p;
+        int v[3] = {}, sign = 1;
+        size_t n = 0;
+
+        /* Parses "[+-]hh[:mm[:ss]]" into seconds */
+
+        if (IN_SET(*s, '+', '-')) {
+                if (*s == '-')
+                        sign = -1;
+                s++;
+        }
+
+        for (;;) {
+                unsigned digits = 0;
+
+                for (; ascii_isdigit(*s); s++) {
+                        if (++digits > 3)
+                                return -EINVAL;
+                        v[n] = v[n] * 10 + *s - '0';
+                }
+                if (digits == 0)
+                        return -EINVAL;
+
+                if (++n >= ELEMENTSOF(v) || *s != ':')
+                        break;
+                s++;
+        }
+
+        if (v[1] > 59 || v[2] > 59)
+                return -EINVAL;
+
+        *p = s;
+        *ret = sign * (v[0] * 3600 + v[1] * 60 + v[2]);
+        return 0;
+}
+
+static int parse_rule(const char **p, TZRule *rule) {
+        const char *s = *p;
+        int r;
+
+        if (*s != ',')
+                return -EINVAL;
+        s++;
+
+        if (*s == 'J' || ascii_isdigit(*s)) {
+                unsigned d = 0;
+
+                rule->type = *s == 'J' ? TZ_RULE_JULIAN_1 : TZ_RULE_JULIAN_0;
+                if (*s == 'J')
+                        s++;
+                if (!ascii_isdigit(*s))
+                        return -EINVAL;
+                for (; ascii_isdigit(*s); s++) {
+                        d = d * 10 + *s - '0';
+                        if (d > 365)
+                                return -EINVAL;
+                }
+                if (rule->type == TZ_RULE_JULIAN_1 && d == 0)
+                        return -EINVAL;
+
+                rule->d = d;
+
+        } else if (*s == 'M') {
+                int n;
+
+                if (sscanf(s, "M%hu.%hu.%hu%n", &rule->m, &rule->n, &rule->d, &n) != 3)
+                        return -EINVAL;
+                if (rule->m < 1 || rule->m > 12 || rule->n < 1 || rule->n > 5 || rule->d > 6)
+                        return -EINVAL;
+
+                rule->type = TZ_RULE_MONTH;
+                s += n;
+        } else
+                return -EINVAL;
+
+        if (*s == '/') {
+                s++;
+                r = parse_hms(&s, &rule->secs);
+                if (r < 0)
+                        return r;
+        } else
+                rule->secs = 2 * 3600;
+
+        *p = s;
+        return 0;
+}
+
+static int parse_footer(TZFile *tz, const char *s) {
+        int offset, r;
+
+        /* Parses a POSIX TZ string such as "CET-1CEST,M3.5.0,M10.5.0/3". Note that the offsets are given
+         * in seconds *west* of UTC here. */
+
+        r = parse_name(&s, &tz->rules[0].name);
+        if (r < 0)
+                return r;
+
+        r = parse_hms(&s, &offset);
+        if (r < 0)
+                return r;
+        tz->rules[0].offset = -offset;
+
+        if (*s == 0) {
+                tz->rules[1].offset = tz->rules[0].offset;
+                return free_and_strdup(&tz->rules[1].name, tz->rules[0].name);
+        }
+
+        r = parse_name(&s, &tz->rules[1].name);
+        if (r < 0)
+                return r;
+
+        if (*s != ',') {
+                r = parse_hms(&s, &offset);
+                if (r < 0)
+                        return r;
+                tz->rules[1].offset = -offset;
+        } else
+                tz->rules[1].offset = tz->rules[0].offset + 3600;
+
+        /* glibc falls back to the rules from the "posixrules" timezone if none are specified. Files shipped
+         * by tzdata always come with rules, hence let's not bother. */
+        if (*s == 0)
+                return -EOPNOTSUPP;
+
+        r = parse_rule(&s, &tz->rules[0]);
+        if (r < 0)
+                return r;
+
+        r = parse_rule(&s, &tz->rules[1]);
+        if (r < 0)
+                return r;
+
+        if (*s != 0)
+                return -EINVAL;
+
+        tz->has_dst = true;
+        return 0;
+}
+
+int tzfile_parse(const void *data, size_t size, TZFile **ret) {
+        _cleanup_(tzfile_freep) TZFile *tz = NULL;
+        const uint8_t *p = data, *e = p + size;
+        uint32_t isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt;
+        size_t time_size = 4;
+        int r;
+
+        assert(data || size == 0);
+        assert(ret);
+
+        if (size < 44 || memcmp(p, "TZif", 4) != 0)
+                return -EBADMSG;
+
+        for (;;) {
+                size_t n;
+
+                isutcnt = unaligned_read_be32(p + 20);
+                isstdcnt = unaligned_read_be32(p + 24);
+                leapcnt = unaligned_read_be32(p + 28);
+                timecnt = unaligned_read_be32(p + 32);
+                typecnt = unaligned_read_be32(p + 36);
+                charcnt = unaligned_read_be32(p + 40);
+
+                n = (size_t) timecnt * (time_size + 1) +
+                    (size_t) typecnt * 6 +
+                    (size_t) charcnt +
+                    (size_t) leapcnt * (time_size + 4) +
+                    (size_t) isstdcnt +
+                    (size_t) isutcnt;
+                if (n > (size_t) (e - p) - 44)
+                        return -EBADMSG;
+
+                /* Version 2 and newer files come with the data twice, the second time with 64bit times */
+                if (time_size == 8 || p[4] < '2')
+                        break;
+
+                p += 44 + n;
+                if ((size_t) (e - p) < 44 || memcmp(p, "TZif", 4) != 0)
+                        return -EBADMSG;
+
+                time_size = 8;
+        }
+
+        /* We'd have to apply leap second corrections like glibc does, let's not bother with the "right/"
+         * timezones that need that. */
+        if (leapcnt > 0)
+                return -EOPNOTSUPP;
+
+        if (typecnt == 0 || typecnt > 256 || charcnt == 0)
+                return -EBADMSG;
+
+        tz = new0(TZFile, 1);
+        if (!tz)
+                return -ENOMEM;
+
+        p += 44;
+
+        tz->n_transitions = timecnt;
+        if (timecnt > 0) {
+                tz->transitions = new(int64_t, timecnt);
+                tz->transition_types = new(uint8_t, timecnt);
+                if (!tz->transitions || !tz->transition_types)
+                        return -ENOMEM;
+        }
+
+        for (size_t i = 0; i < timecnt; i++, p += time_size) {
+                tz->transitions[i] = time_size == 8 ? (int64_t) unaligned_read_be64(p) : (int32_t) unaligned_read_be32(p);
+
+                if (i > 0 && tz->transitions[i] <= tz->transitions[i - 1])
+                        return -EBADMSG;
+        }
+
+        for (size_t i = 0; i < timecnt; i++, p++) {
+                if (*p >= typecnt)
+                        return -EBADMSG;
+
+                tz->transition_types[i] = *p;
+        }
+
+        tz->n_types = typecnt;
+        tz->types = new(TZFileType, typecnt);
+        if (!tz->types)
+                return -ENOMEM;
+
+        for (size_t i = 0; i < typecnt; i++, p += 6) {
+                if (p[4] > 1 || p[5] >= charcnt)
+                        return -EBADMSG;
+
+                tz->types[i] = (TZFileType) {
+                        .offset = (int32_t) unaligned_read_be32(p),
+                        .isdst = p[4],
+                        .abbr = p[5],
+                };
+        }
+
+        /* Make sure all abbreviations are NUL terminated */
+        tz->n_abbrs = charcnt;
+        tz->abbrs = memdup_suffix0(p, charcnt);
+        if (!tz->abbrs)
+                return -ENOMEM;
+
+        p += charcnt + isstdcnt + isutcnt;
+
+        if (time_size == 8 && p < e) {
+                _cleanup_free_ char *footer = NULL;
+                const uint8_t *nl;
+
+                if (*p != '\n')
+                        return -EBADMSG;
+                p++;
+
+                nl = memchr(p, '\n', e - p);
+                if (!nl)
+                        return -EBADMSG;
+
+                if (nl > p) {
+                        footer = memdup_suffix0(p, nl - p);
+                        if (!footer)
+                                return -ENOMEM;
+
+                        r = parse_footer(tz, footer);
+                        if (r < 0)
+                                return r;
+
+                        tz->has_footer = true;
+                }
+        }
+
+        *ret = TAKE_PTR(tz);
+        return 0;
+}
+
+int tzfile_load(const char *timezone, TZFile **ret) {
+        _cleanup_(tzfile_freep) TZFile *tz = NULL;
+        _cleanup_free_ char *data = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        const char *path;
+        struct stat st;
+        size_t size;
+        int r;
+
+        assert(timezone);
+        assert(ret);
+
+        path = strjoina("/usr/share/zoneinfo/", timezone);
+
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        if (fstat(fileno(f), &st) < 0)
+                return -errno;
+
+        r = stat_verify_regular(&st);
+        if (r < 0)
+                return r;
+
+        if (st.st_size > TZFILE_SIZE_MAX)
+                return -EFBIG;
+
+        r = read_full_stream(f, &data, &size);
+        if (r < 0)
+                return r;
+
+        r = tzfile_parse(data, size, &tz);
+        if (r < 0)
+                return r;
+
+        tz->dev = st.st_dev;
+        tz->ino = st.st_ino;
+        tz->mtime = st.st_mtim;
+        tz->size = st.st_size;
+
+        *ret = TAKE_PTR(tz);
+        return 0;
+}
+
+DEFINE_PRIVATE_HASH_OPS_FULL(tzfile_hash_ops, char, string_hash_func, string_compare_func, free, TZFile, tzfile_free);
+
+int tzfile_get_cached(const char *timezone, TZFile **ret) {
+        static thread_local Hashmap *cache = NULL;
+        _cleanup_(tzfile_freep) TZFile *tz = NULL;
+        _cleanup_free_ char *k = NULL;
+        TZFile *cached, *old;
+        char *old_key;
+        struct stat st;
+        int r;
+
+        assert(timezone);
+        assert(ret);
+
+        if (stat(strjoina("/usr/share/zoneinfo/", timezone), &st) < 0)
+                return -errno;
+
+        /* Reuse the cached file, unless it was replaced or modified, e.g. by a tzdata update */
+        cached = hashmap_get(cache, timezone);
+        if (cached &&
+            cached->dev == st.st_dev &&
+            cached->ino == st.st_ino &&
+            cached->size == st.st_size &&
+            timespec_load_nsec(&cached->mtime) == timespec_load_nsec(&st.st_mtim)) {
+                *ret = cached;
+                return 0;
+        }
+
+        r = tzfile_load(timezone, &tz);
+        if (r < 0)
+                return r;
+
+        k = strdup(timezone);
+        if (!k)
+                return -ENOMEM;
+
+        /* Drop the outdated entry. Removing it doesn't invoke the destructors of the hash ops, hence free
+         * both the key and the value ourselves. */
+        old = hashmap_remove2(cache, timezone, (void**) &old_key);
+        free(old_key);
+        tzfile_free(old);
+
+        r = hashmap_ensure_put(&cache, &tzfile_hash_ops, k, tz);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(k);
+        *ret = TAKE_PTR(tz);
+        return 0;
+}
+
+static time_t rule_change(const TZRule *rule, int year) {
+        time_t t;
+
+        /* Returns when the change described by the rule happens in the specified year, calculated exactly
+         * like compute_change() in glibc's tzset.c does */
+
+        if (year > EPOCH_YEAR)
+                t = ((year - EPOCH_YEAR) * 365 +
+                     ((year - 1) / 4 - EPOCH_YEAR / 4) -
+                     ((year - 1) / 100 - EPOCH_YEAR / 100) +
+                     ((year - 1) / 400 - EPOCH_YEAR / 400)) * (time_t) (24 * 3600);
+        else
+                t = 0;
+
+        switch (rule->type) {
+
+        case TZ_RULE_JULIAN_1:
+                t += (rule->d - 1) * 24 * 3600;
+                if (rule->d >= 60 && is_leap(year))
+                        t += 24 * 3600;
+                break;
+
+        case TZ_RULE_JULIAN_0:
+                t += rule->d * 24 * 3600;
+                break;
+
+        case TZ_RULE_MONTH: {
+                const unsigned short *myday = &mon_yday[is_leap(year)][rule->m];
+                int m1, yy0, yy1, yy2, dow, d;
+
+                t += myday[-1] * 24 * 3600;
+
+                /* Zeller's congruence, to get the day of the week of the first day of the month */
+                m1 = (rule->m + 9) % 12 + 1;
+                yy0 = rule->m <= 2 ? year - 1 : year;
+                yy1 = yy0 / 100;
+                yy2 = yy0 % 100;
+                dow = ((26 * m1 - 2) / 10 + 1 + yy2 + yy2 / 4 + yy1 / 4 - 2 * yy1) % 7;
+                if (dow < 0)
+                        dow += 7;
+
+                d = rule->d - dow;
+                if (d < 0)
+                        d += 7;
+                for (unsigned i = 1; i < rule->n; i++) {
+                        if (d + 7 >= (int) myday[0] - myday[-1])
+                                break;
+                        d += 7;
+                }
+
+                t += d * 24 * 3600;
+                break;
+        }}
+
+        return t - rule->offset + rule->secs;
+}
+
+struct tm* tzfile_localtime(const TZFile *tz, time_t t, struct tm *ret) {
+        const TZFileType *type;
+        const char *abbr;
+        long offset;
+        int isdst;
+        time_t l;
+
+        assert(tz);
+        assert(ret);
+
+        if (tz->n_transitions == 0 || t < tz->transitions[0]) {
+                size_t i = 0;
+
+                /* Before the first transition glibc uses the first type that is not DST */
+                while (i < tz->n_types && tz->types[i].isdst)
+                        i++;
+                if (i >= tz->n_types)
+                        i = 0;
+
+                type = tz->types + i;
+
+        } else if (t >= tz->transitions[tz->n_transitions - 1]) {
+
+                if (tz->has_footer) {
+                        struct tm u;
+
+                        if (!gmtime_r(&t, &u))
+                                return NULL;
+
+                        isdst = false;
+                        if (tz->has_dst) {
+                                time_t start, end;
+
+                                start = rule_change(tz->rules + 0, u.tm_year + TM_YEAR_BASE);
+                                end = rule_change(tz->rules + 1, u.tm_year + TM_YEAR_BASE);
+
+                                /* On the southern hemisphere DST ends in the next year */
+                                if (start > end)
+                                        isdst = t < end || t >= start;
+                                else
+                                        isdst = t >= start && t < end;
+                        }
+
+                        offset = tz->rules[isdst].offset;
+                        abbr = tz->rules[isdst].name;
+                        goto finish;
+                }
+
+                type = tz->types + tz->transition_types[tz->n_transitions - 1];
+
+        } else {
+                size_t lo = 0, hi = tz->n_transitions - 1;
+
+                /* Find the last transition before t: transitions[lo] <= t < transitions[hi] */
+                while (hi - lo > 1) {
+                        size_t m = lo + (hi - lo) / 2;
+
+                        if (t < tz->transitions[m])
+                                hi = m;
+                        else
+                                lo = m;
+                }
+
+                type = tz->types + tz->transition_types[lo];
+        }
+
+        offset = type->offset;
+        isdst = type->isdst;
+        abbr = tz->abbrs + type->abbr;
+
+finish:
+        if (__builtin_add_overflow(t, offset, &l))
+                return NULL;
+
+        if (!gmtime_r(&l, ret))
+                return NULL;
+
+        ret->tm_isdst = isdst;
+        ret->tm_gmtoff = offset;
+        ret->tm_zone = abbr;
+
+        return ret;
+}
+
+static bool isdst_differ(int a, int b) {
+        return (!a != !b) && a >= 0 && b >= 0;
+}
+
+static int64_t ydhms_diff(
+                int64_t year1, int64_t yday1, int hour1, int min1, int sec1,
+                int year0, int yday0, int hour0, int min0, int sec0) {
+
+        /* Returns the difference in seconds between the two times, with years counted from 1900, assuming
+         * that the clocks weren't adjusted between them. Leap days are counted correctly even for negative
+         * years. */
+
+        int64_t a4 = (year1 >> 2) + (TM_YEAR_BASE >> 2) - !(year1 & 3);
+        int64_t b4 = (year0 >> 2) + (TM_YEAR_BASE >> 2) - !(year0 & 3);
+        int64_t a100 = (a4 + (a4 < 0)) / 25 - (a4 < 0);
+        int64_t b100 = (b4 + (b4 < 0)) / 25 - (b4 < 0);
+        int64_t a400 = a100 >> 2;
+        int64_t b400 = b100 >> 2;
+        int64_t leap_days = (a4 - b4) - (a100 - b100) + (a400 - b400);
+        int64_t days = 365 * (year1 - year0) + yday1 - yday0 + leap_days;
+
+        return ((24 * days + hour1 - hour0) * 60 + min1 - min0) * 60 + sec1 - sec0;
+}
+
+static bool convert(const TZFile *tz, int64_t t, struct tm *ret) {
+        if ((int64_t) (time_t) t != t)
+                return false;
+
+        return tzfile_localtime(tz, (time_t) t, ret);
+}
+
+time_t tzfile_mktime(const TZFile *tz, struct tm *tm, int *offset) {
+        /* The shortest period of DST, and of standard time surrounded by DST, that ever happened. We probe
+         * in steps of this size when looking for a time with the requested DST flag. */
+        const int stride = 601200;
+        /* The longest period in which the DST difference is not one hour. We search half of it in each
+         * direction. */
+        const int delta_bound = 457243200 / 2 + stride;
+
+        int sec, sec_requested, min, hour, isdst, mon_remainder, dst2 = 0, remaining_probes = 6;
+        int64_t year, yday, t0, t, t1, t2;
+        bool negative_mon_remainder;
+        struct tm r;
+
+        assert(tz);
+        assert(tm);
+        assert(offset);
+
+        /* This follows __mktime_internal() in glibc's mktime.c closely, since the calendar calculations
+         * depend on how exactly mktime() normalizes times that are ambiguous or don't exist, and on its
+         * choice of UTC offset if the requested tm_isdst doesn't match. */
+
+        sec = sec_requested = tm->tm_sec;
+        min = tm->tm_min;
+        hour = tm->tm_hour;
+        isdst = tm->tm_isdst;
+
+        mon_remainder = tm->tm_mon % 12;
+        negative_mon_remainder = mon_remainder < 0;
+        year = (int64_t) tm->tm_year + tm->tm_mon / 12 - negative_mon_remainder;
+        yday = mon_yday[is_leap(year + TM_YEAR_BASE)][mon_remainder + 12 * negative_mon_remainder] - 1 + (int64_t) tm->tm_mday;
+
+        /* ydhms_diff() assumes that every minute has 60 seconds */
+        sec = CLAMP(sec, 0, 59);
+
+        /* Start with the offset we found last time, and repeatedly use the error to improve the guess */
+        t0 = ydhms_diff(year, yday, hour, min, sec, EPOCH_YEAR - TM_YEAR_BASE, 0, 0, 0, -*offset);
+        t = t1 = t2 = t0;
+
+        for (;;) {
+                int64_t dt;
+
+                if (!convert(tz, t, &r))
+                        goto overflow;
+
+                dt = ydhms_diff(year, yday, hour, min, sec, r.tm_year, r.tm_yday, r.tm_hour, r.tm_min, r.tm_sec);
+                if (dt == 0)
+                        break;
+
+                /* If we are oscillating between two values, the requested time falls into a gap, e.g. when
+                 * DST starts. Like everybody else, return the time that is that far away from the requested
+                 * one, preferring a time whose tm_isdst differs from the requested one, or has DST if none
+                 * was requested. */
+                if (t == t1 && t != t2 &&
+                    (r.tm_isdst < 0 || (isdst < 0 ? dst2 <= (r.tm_isdst != 0) : (isdst != 0) != (r.tm_isdst != 0))))
+                        goto found;
+
+                if (--remaining_probes == 0)
+                        goto overflow;
+
+                t1 = t2;
+                t2 = t;
+                t += dt;
+                dst2 = r.tm_isdst != 0;
+        }
+
+        if (isdst_differ(isdst, r.tm_isdst)) {
+                /* The DST flag doesn't match. Look for the closest time with the requested flag in both
+                 * directions and use its UTC offset instead. */
+
+                for (int delta = stride; delta < delta_bound; delta += stride)
+                        for (int direction = -1; direction <= 1; direction += 2) {
+                                int64_t ot = t + (int64_t) delta * direction, gt;
+                                struct tm o;
+
+                                if (!convert(tz, ot, &o))
+                                        goto overflow;
+
+                                if (isdst_differ(isdst, o.tm_isdst))
+                                        continue;
+
+                                gt = ot + ydhms_diff(year, yday, hour, min, sec, o.tm_year, o.tm_yday, o.tm_hour, o.tm_min, o.tm_sec);
+                                if (convert(tz, gt, &r)) {
+                                        t = gt;
+                                        goto found;
+                                }
+                        }
+
+                /* There's no such time anywhere near, assume the usual DST offset of one hour */
+                t += isdst > 0 ? -3600 : 3600;
+                if (!convert(tz, t, &r))
+                        goto overflow;
+        }
+
+found:
+        /* Remember the offset for the next call */
+        *offset = (int) (t - t0 + *offset);
+
+        if (sec_requested != r.tm_sec) {
+                /* Put back the seconds we clamped above */
+                t += (sec == 0 && r.tm_sec == 60) - sec + sec_requested;
+                if (!convert(tz, t, &r))
+                        goto overflow;
+        }
+
+        *tm = r;
+        return (time_t) t;
+
+overflow:
+        errno = EOVERFLOW;
+        return (time_t) -1;
+}
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+#include "macro.h"
+
+/* A parser for compiled timezone files as described in tzfile(5), and conversion functions that behave
+ * exactly like glibc's localtime_r() and mktime() do when $TZ is set to the timezone. This allows us to do
+ * calculations in arbitrary timezones without changing the timezone of the whole process. */
+
+typedef struct TZFile TZFile;
+
+int tzfile_parse(const void *data, size_t size, TZFile **ret);
+int tzfile_load(const char *timezone, TZFile **ret);
+TZFile* tzfile_free(TZFile *tz);
+DEFINE_TRIVIAL_CLEANUP_FUNC(TZFile*, tzfile_free);
+
+/* Returns an object from a per-thread cache, which is owned by the cache and stays valid until the next
+ * call. The timezone file is reloaded if it changed on disk since it was cached. */
+int tzfile_get_cached(const char *timezone, TZFile **ret);
+
+struct tm* tzfile_localtime(const TZFile *tz, time_t t, struct tm *ret);
+
+/* Like mktime(). glibc remembers the UTC offset of the previous call and starts its search from there,
+ * which may make a difference for ambiguous times. 'offset' is that state, initialize it to zero. */
+time_t tzfile_mktime(const TZFile *tz, struct tm *tm, int *offset);
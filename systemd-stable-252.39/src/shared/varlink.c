@@ -30,6 +30,7 @@
 #define VARLINK_DEFAULT_TIMEOUT_USEC (45U*USEC_PER_SEC)
 #define VARLINK_BUFFER_MAX (16U*1024U*1024U)
 #define VARLINK_READ_SIZE (64U*1024U)
+#define VARLINK_CONCURRENT_CALLS_MAX 128U
 
 typedef enum VarlinkState {
         /* Client side states */
@@ -149,6 +150,16 @@ struct Varlink {
         sd_event_source *time_event_source;
         sd_event_source *quit_event_source;
         sd_event_source *defer_event_source;
+
+        /* If the server has VARLINK_SERVER_CONCURRENT set, method calls that are read while an earlier call
+         * on the same connection is still pending are dispatched on separate call objects, which are
+         * queued here in the order they were received. A call object has no fd of its own: it buffers its
+         * replies in its output buffer, and the connection forwards them once all earlier calls have been
+         * answered. This keeps replies in order, as the protocol requires. */
+        Varlink *parent;
+        LIST_HEAD(Varlink, calls);
+        LIST_FIELDS(Varlink, calls);
+        unsigned n_calls;
 };
 
 static const char* const varlink_state_table[_VARLINK_STATE_MAX] = {
@@ -325,9 +336,26 @@ static void varlink_detach_event_sources(Varlink *v) {
         v->defer_event_source = sd_event_source_disable_unref(v->defer_event_source);
 }
 
+static void varlink_clear_calls(Varlink *v) {
+        Varlink *c;
+
+        assert(v);
+
+        while ((c = v->calls)) {
+                LIST_REMOVE(calls, v->calls, c);
+                assert(v->n_calls > 0);
+                v->n_calls--;
+
+                varlink_close(c);
+                c->parent = NULL;
+                varlink_unref(c);
+        }
+}
+
 static void varlink_clear(Varlink *v) {
         assert(v);
 
+        varlink_clear_calls(v);
         varlink_detach_event_sources(v);
 
         v->fd = safe_close(v->fd);
@@ -380,8 +408,10 @@ static int varlink_test_disconnect(Varlink *v) {
         if (v->read_disconnected && v->write_disconnected)
                 goto disconnect;
 
-        /* If we are waiting for incoming data but the read side is shut down, disconnect. */
-        if (IN_SET(v->state, VARLINK_AWAITING_REPLY, VARLINK_AWAITING_REPLY_MORE, VARLINK_CALLING, VARLINK_IDLE_SERVER) && v->read_disconnected)
+        /* If we are waiting for incoming data but the read side is shut down, disconnect. Concurrently
+         * dispatched calls that still need answering keep an otherwise idle server connection around. */
+        if ((IN_SET(v->state, VARLINK_AWAITING_REPLY, VARLINK_AWAITING_REPLY_MORE, VARLINK_CALLING) ||
+             (v->state == VARLINK_IDLE_SERVER && !v->calls)) && v->read_disconnected)
                 goto disconnect;
 
         /* Similar, if are a client that hasn't written anything yet but the write side is dead, also
@@ -393,7 +423,8 @@ static int varlink_test_disconnect(Varlink *v) {
         /* We are on the server side and still want to send out more replies, but we saw POLLHUP already, and
          * either got no buffered bytes to write anymore or already saw a write error. In that case we should
          * shut down the varlink link. */
-        if (IN_SET(v->state, VARLINK_PENDING_METHOD, VARLINK_PENDING_METHOD_MORE) && (v->write_disconnected || v->output_buffer_size == 0) && v->got_pollhup)
+        if ((IN_SET(v->state, VARLINK_PENDING_METHOD, VARLINK_PENDING_METHOD_MORE) || v->calls) &&
+            (v->write_disconnected || v->output_buffer_size == 0) && v->got_pollhup)
                 goto disconnect;
 
         return 0;
@@ -457,21 +488,47 @@ static int varlink_write(Varlink *v) {
         return 1;
 }
 
+static bool varlink_may_dispatch_concurrently(Varlink *v) {
+        assert(v);
+
+        /* Returns true if we may dispatch the next method call on a separate call object, because an
+         * earlier call on this connection is still being worked on. Once the first call got dispatched
+         * that way, all subsequent ones have to follow until the queue drained, as otherwise a call
+         * dispatched on the connection itself might be answered before an earlier queued one. */
+
+        if (!v->server || !FLAGS_SET(v->server->flags, VARLINK_SERVER_CONCURRENT))
+                return false;
+        if (v->n_calls >= VARLINK_CONCURRENT_CALLS_MAX)
+                return false;
+
+        return IN_SET(v->state, VARLINK_PENDING_METHOD, VARLINK_PENDING_METHOD_MORE) ||
+                (v->state == VARLINK_IDLE_SERVER && v->calls);
+}
+
+static bool varlink_want_read(Varlink *v) {
+        assert(v);
+
+        if (v->read_disconnected)
+                return false;
+        if (v->input_buffer_unscanned > 0)
+                return false;
+
+        if (varlink_may_dispatch_concurrently(v))
+                return true;
+
+        return IN_SET(v->state, VARLINK_AWAITING_REPLY, VARLINK_AWAITING_REPLY_MORE, VARLINK_CALLING, VARLINK_IDLE_SERVER) &&
+                !v->current;
+}
+
 static int varlink_read(Varlink *v) {
         size_t rs;
         ssize_t n;
 
         assert(v);
 
-        if (!IN_SET(v->state, VARLINK_AWAITING_REPLY, VARLINK_AWAITING_REPLY_MORE, VARLINK_CALLING, VARLINK_IDLE_SERVER))
-                return 0;
         if (v->connecting) /* read() on a socket while we are in connect() will fail with EINVAL, hence exit early here */
                 return 0;
-        if (v->current)
-                return 0;
-        if (v->input_buffer_unscanned > 0)
-                return 0;
-        if (v->read_disconnected)
+        if (!varlink_want_read(v))
                 return 0;
 
         if (v->input_buffer_size >= VARLINK_BUFFER_MAX)
@@ -535,15 +592,14 @@ static int varlink_read(Varlink *v) {
         return 1;
 }
 
-static int varlink_parse_message(Varlink *v) {
+static int varlink_parse_next(Varlink *v, JsonVariant **ret) {
         const char *e, *begin;
         size_t sz;
         int r;
 
         assert(v);
+        assert(ret);
 
-        if (v->current)
-                return 0;
         if (v->input_buffer_unscanned <= 0)
                 return 0;
 
@@ -564,7 +620,7 @@ static int varlink_parse_message(Varlink *v) {
                                                             * This may produce a non-printable journal entry if the message
                                                             * is invalid. We may also expose privileged information. */
 
-        r = json_parse(begin, 0, &v->current, NULL, NULL);
+        r = json_parse(begin, 0, ret, NULL, NULL);
         if (r < 0) {
                 /* If we encounter a parse failure flush all data. We cannot possibly recover from this,
                  * hence drop all buffered data now. */
@@ -583,6 +639,17 @@ static int varlink_parse_message(Varlink *v) {
         return 1;
 }
 
+static int varlink_parse_message(Varlink *v) {
+        assert(v);
+
+        if (v->current)
+                return 0;
+        if (v->calls) /* Further calls have to be queued behind the concurrently dispatched ones */
+                return 0;
+
+        return varlink_parse_next(v, &v->current);
+}
+
 static int varlink_test_timeout(Varlink *v) {
         assert(v);
 
@@ -909,6 +976,162 @@ fail:
         return r;
 }
 
+static int varlink_acquire_ucred(Varlink *v) {
+        int r;
+
+        assert(v);
+
+        if (v->ucred_acquired)
+                return 0;
+
+        r = getpeercred(v->fd, &v->ucred);
+        if (r < 0)
+                return r;
+
+        v->ucred_acquired = true;
+        return 0;
+}
+
+static int varlink_enqueue_buffer(Varlink *v, char **buffer, size_t index, size_t size) {
+        assert(v);
+        assert(buffer);
+        assert(*buffer);
+
+        /* Appends 'size' bytes starting at 'index' of *buffer to the output buffer. If our output buffer is
+         * empty we take possession of *buffer instead of copying, and set it to NULL. */
+
+        if (v->output_buffer_size + size > VARLINK_BUFFER_MAX)
+                return -ENOBUFS;
+
+        if (v->output_buffer_size == 0) {
+
+                free_and_replace(v->output_buffer, *buffer);
+
+                v->output_buffer_size = size;
+                v->output_buffer_index = index;
+
+        } else if (v->output_buffer_index == 0) {
+
+                if (!GREEDY_REALLOC(v->output_buffer, v->output_buffer_size + size))
+                        return -ENOMEM;
+
+                memcpy(v->output_buffer + v->output_buffer_size, *buffer + index, size);
+                v->output_buffer_size += size;
+
+        } else {
+                char *n;
+                const size_t new_size = v->output_buffer_size + size;
+
+                n = new(char, new_size);
+                if (!n)
+                        return -ENOMEM;
+
+                memcpy(mempcpy(n, v->output_buffer + v->output_buffer_index, v->output_buffer_size), *buffer + index, size);
+
+                free_and_replace(v->output_buffer, n);
+                v->output_buffer_size = new_size;
+                v->output_buffer_index = 0;
+        }
+
+        return 0;
+}
+
+static int varlink_dispatch_calls(Varlink *v) {
+        Varlink *c;
+        int r, ret = 0;
+
+        assert(v);
+
+        /* Forwards the replies of concurrently dispatched calls in the order the calls were received, and
+         * releases the calls that have been answered completely. */
+
+        if (!v->calls)
+                return 0;
+
+        /* The call dispatched on the connection itself always precedes the queued ones */
+        if (IN_SET(v->state,
+                   VARLINK_PROCESSING_METHOD, VARLINK_PROCESSING_METHOD_MORE, VARLINK_PROCESSING_METHOD_ONEWAY,
+                   VARLINK_PROCESSED_METHOD, VARLINK_PENDING_METHOD, VARLINK_PENDING_METHOD_MORE))
+                return 0;
+
+        while ((c = v->calls)) {
+
+                if (c->output_buffer_size > 0) {
+                        r = varlink_enqueue_buffer(v, &c->output_buffer, c->output_buffer_index, c->output_buffer_size);
+                        if (r < 0)
+                                return r;
+
+                        c->output_buffer_index = c->output_buffer_size = 0;
+                        ret = 1;
+                }
+
+                /* A call that was closed without being answered takes the connection down with it, just
+                 * like closing the connection from within a method call would */
+                if (c->state == VARLINK_DISCONNECTED)
+                        return varlink_log_errno(v, SYNTHETIC_ERRNO(ECONNRESET), "Concurrently dispatched call was closed, disconnecting.");
+
+                if (c->state != VARLINK_IDLE_SERVER)
+                        break;
+
+                LIST_REMOVE(calls, v->calls, c);
+                assert(v->n_calls > 0);
+                v->n_calls--;
+
+                varlink_close(c);
+                c->parent = NULL;
+                varlink_unref(c);
+                ret = 1;
+        }
+
+        return ret;
+}
+
+static int varlink_dispatch_concurrently(Varlink *v) {
+        _cleanup_(json_variant_unrefp) JsonVariant *m = NULL;
+        _cleanup_(varlink_unrefp) Varlink *c = NULL;
+        int r;
+
+        assert(v);
+
+        if (!varlink_may_dispatch_concurrently(v))
+                return 0;
+
+        r = varlink_parse_next(v, &m);
+        if (r <= 0)
+                return r;
+
+        r = varlink_new(&c);
+        if (r < 0)
+                return r;
+
+        if (v->description) {
+                c->description = strjoin(v->description, "-call");
+                if (!c->description)
+                        return -ENOMEM;
+        }
+
+        (void) varlink_acquire_ucred(v);
+        c->ucred = v->ucred;
+        c->ucred_acquired = v->ucred_acquired;
+        c->userdata = v->userdata;
+        c->event = sd_event_ref(v->event);
+        c->server = varlink_server_ref(v->server);
+        c->current = TAKE_PTR(m);
+        c->parent = v;
+
+        varlink_set_state(c, VARLINK_IDLE_SERVER);
+
+        LIST_APPEND(calls, v->calls, varlink_ref(c));
+        v->n_calls++;
+
+        /* Failures take the whole connection down, just like they do for calls dispatched on it directly */
+        r = varlink_dispatch_method(c);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
 int varlink_process(Varlink *v) {
         int r;
 
@@ -937,6 +1160,18 @@ int varlink_process(Varlink *v) {
         if (r != 0)
                 goto finish;
 
+        r = varlink_dispatch_calls(v);
+        if (r < 0)
+                varlink_log_errno(v, r, "Forwarding replies of concurrent calls failed: %m");
+        if (r != 0)
+                goto finish;
+
+        r = varlink_dispatch_concurrently(v);
+        if (r < 0)
+                varlink_log_errno(v, r, "Concurrent method dispatch failed: %m");
+        if (r != 0)
+                goto finish;
+
         r = varlink_parse_message(v);
         if (r < 0)
                 varlink_log_errno(v, r, "Message parsing failed: %m");
@@ -1084,10 +1319,7 @@ int varlink_get_events(Varlink *v) {
                             * write() or read() from the fd. */
                 return EPOLLOUT;
 
-        if (!v->read_disconnected &&
-            IN_SET(v->state, VARLINK_AWAITING_REPLY, VARLINK_AWAITING_REPLY_MORE, VARLINK_CALLING, VARLINK_IDLE_SERVER) &&
-            !v->current &&
-            v->input_buffer_unscanned <= 0)
+        if (varlink_want_read(v))
                 ret |= EPOLLIN;
 
         if (!v->write_disconnected &&
@@ -1123,6 +1355,9 @@ int varlink_flush(Varlink *v) {
         if (v->state == VARLINK_DISCONNECTED)
                 return varlink_log_errno(v, SYNTHETIC_ERRNO(ENOTCONN), "Not connected.");
 
+        if (v->parent) /* Replies of concurrently dispatched calls are written out by the connection */
+                return 0;
+
         for (;;) {
                 if (v->output_buffer_size == 0)
                         break;
@@ -1156,6 +1391,13 @@ static void varlink_detach_server(Varlink *v) {
         if (!v->server)
                 return;
 
+        if (v->parent) {
+                /* Concurrently dispatched calls just keep a reference to the server, they are not
+                 * accounted as connections of their own */
+                v->server = varlink_server_unref(v->server);
+                return;
+        }
+
         if (v->server->by_uid &&
             v->ucred_acquired &&
             uid_is_valid(v->ucred.uid)) {
@@ -1232,40 +1474,15 @@ static int varlink_enqueue_json(Varlink *v, JsonVariant *m) {
                 return r;
         assert(text[r] == '\0');
 
-        if (v->output_buffer_size + r + 1 > VARLINK_BUFFER_MAX)
-                return -ENOBUFS;
-
         varlink_log(v, "Sending message: %s", text);
 
-        if (v->output_buffer_size == 0) {
-
-                free_and_replace(v->output_buffer, text);
-
-                v->output_buffer_size = r + 1;
-                v->output_buffer_index = 0;
-
-        } else if (v->output_buffer_index == 0) {
-
-                if (!GREEDY_REALLOC(v->output_buffer, v->output_buffer_size + r + 1))
-                        return -ENOMEM;
-
-                memcpy(v->output_buffer + v->output_buffer_size, text, r + 1);
-                v->output_buffer_size += r + 1;
-
-        } else {
-                char *n;
-                const size_t new_size = v->output_buffer_size + r + 1;
-
-                n = new(char, new_size);
-                if (!n)
-                        return -ENOMEM;
-
-                memcpy(mempcpy(n, v->output_buffer + v->output_buffer_index, v->output_buffer_size), text, r + 1);
+        r = varlink_enqueue_buffer(v, &text, 0, r + 1);
+        if (r < 0)
+                return r;
 
-                free_and_replace(v->output_buffer, n);
-                v->output_buffer_size = new_size;
-                v->output_buffer_index = 0;
-        }
+        /* If this is a concurrently dispatched call, make sure the connection picks up the reply */
+        if (v->parent && v->parent->defer_event_source)
+                (void) sd_event_source_set_enabled(v->parent->defer_event_source, SD_EVENT_ON);
 
         return 0;
 }
@@ -1280,8 +1497,8 @@ int varlink_send(Varlink *v, const char *method, JsonVariant *parameters) {
         if (v->state == VARLINK_DISCONNECTED)
                 return varlink_log_errno(v, SYNTHETIC_ERRNO(ENOTCONN), "Not connected.");
 
-        /* We allow enqueuing multiple method calls at once! */
-        if (!IN_SET(v->state, VARLINK_IDLE_CLIENT, VARLINK_AWAITING_REPLY))
+        /* We allow enqueuing multiple method calls at once, including from within the reply callback! */
+        if (!IN_SET(v->state, VARLINK_IDLE_CLIENT, VARLINK_AWAITING_REPLY, VARLINK_PROCESSING_REPLY))
                 return varlink_log_errno(v, SYNTHETIC_ERRNO(EBUSY), "Connection busy.");
 
         r = varlink_sanitize_parameters(&parameters);
@@ -1331,8 +1548,8 @@ int varlink_invoke(Varlink *v, const char *method, JsonVariant *parameters) {
         if (v->state == VARLINK_DISCONNECTED)
                 return varlink_log_errno(v, SYNTHETIC_ERRNO(ENOTCONN), "Not connected.");
 
-        /* We allow enqueuing multiple method calls at once! */
-        if (!IN_SET(v->state, VARLINK_IDLE_CLIENT, VARLINK_AWAITING_REPLY))
+        /* We allow enqueuing multiple method calls at once, including from within the reply callback! */
+        if (!IN_SET(v->state, VARLINK_IDLE_CLIENT, VARLINK_AWAITING_REPLY, VARLINK_PROCESSING_REPLY))
                 return varlink_log_errno(v, SYNTHETIC_ERRNO(EBUSY), "Connection busy.");
 
         r = varlink_sanitize_parameters(&parameters);
@@ -1349,7 +1566,10 @@ int varlink_invoke(Varlink *v, const char *method, JsonVariant *parameters) {
         if (r < 0)
                 return varlink_log_errno(v, r, "Failed to enqueue json message: %m");
 
-        varlink_set_state(v, VARLINK_AWAITING_REPLY);
+        /* If we are called from the reply callback, varlink_dispatch_reply() will figure out the new state
+         * once the callback returns */
+        if (v->state != VARLINK_PROCESSING_REPLY)
+                varlink_set_state(v, VARLINK_AWAITING_REPLY);
         v->n_pending++;
         v->timestamp = now(CLOCK_MONOTONIC);
 
@@ -1769,22 +1989,6 @@ void* varlink_get_userdata(Varlink *v) {
         return v->userdata;
 }
 
-static int varlink_acquire_ucred(Varlink *v) {
-        int r;
-
-        assert(v);
-
-        if (v->ucred_acquired)
-                return 0;
-
-        r = getpeercred(v->fd, &v->ucred);
-        if (r < 0)
-                return r;
-
-        v->ucred_acquired = true;
-        return 0;
-}
-
 int varlink_get_peer_uid(Varlink *v, uid_t *ret) {
         int r;
 
@@ -57,6 +57,44 @@ int daemon_reload(enum action action, bool graceful) {
         return 1;
 }
 
+static int daemon_reload_incremental(void) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        uint32_t n_units, n_reloaded;
+        uint64_t usec;
+        sd_bus *bus;
+        int r;
+
+        /* Returns > 0 if the incremental reload was done, 0 if a full reload is required instead. */
+
+        r = acquire_bus(BUS_MANAGER, &bus);
+        if (r < 0)
+                return r;
+
+        polkit_agent_open_maybe();
+
+        r = bus_call_method(bus, bus_systemd_mgr, "ReloadIncremental", &error, &reply, NULL);
+        if (r < 0) {
+                if (sd_bus_error_has_names(&error, SD_BUS_ERROR_NOT_SUPPORTED, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+                        log_notice("Incremental reload not possible, doing a full reload: %s",
+                                   bus_error_message(&error, r));
+                        return 0;
+                }
+
+                return log_error_errno(r, "Incremental reload failed: %s", bus_error_message(&error, r));
+        }
+
+        r = sd_bus_message_read(reply, "uut", &n_units, &n_reloaded, &usec);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        if (!arg_quiet)
+                printf("Reloaded %" PRIu32 " of %" PRIu32 " units in %s.\n",
+                       n_reloaded, n_units, FORMAT_TIMESPAN(usec, USEC_PER_MSEC));
+
+        return 1;
+}
+
 int verb_daemon_reload(int argc, char *argv[], void *userdata) {
         enum action a;
         int r;
@@ -70,6 +108,14 @@ int verb_daemon_reload(int argc, char *argv[], void *userdata) {
         else
                 assert_not_reached();
 
+        if (a == ACTION_RELOAD && arg_incremental) {
+                r = daemon_reload_incremental();
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        return 0;
+        }
+
         r = daemon_reload(a, /* graceful= */ false);
         if (r < 0)
                 return r;
@@ -114,6 +114,7 @@ TimestampStyle arg_timestamp_style = TIMESTAMP_PRETTY;
 bool arg_read_only = false;
 bool arg_mkdir = false;
 bool arg_marked = false;
+bool arg_incremental = false;
 
 STATIC_DESTRUCTOR_REGISTER(arg_types, strv_freep);
 STATIC_DESTRUCTOR_REGISTER(arg_states, strv_freep);
@@ -310,6 +311,7 @@ static int systemctl_help(void) {
                "     --read-only         Create read-only bind mount\n"
                "     --mkdir             Create directory before mounting, if missing\n"
                "     --marked            Restart/reload previously marked units\n"
+               "     --incremental       Only reload changed units on daemon-reload\n"
                "\nSee the %2$s for details.\n",
                program_invocation_short_name,
                link,
@@ -431,6 +433,7 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                 ARG_READ_ONLY,
                 ARG_MKDIR,
                 ARG_MARKED,
+                ARG_INCREMENTAL,
         };
 
         static const struct option options[] = {
@@ -492,6 +495,7 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                 { "read-only",           no_argument,       NULL, ARG_READ_ONLY           },
                 { "mkdir",               no_argument,       NULL, ARG_MKDIR               },
                 { "marked",              no_argument,       NULL, ARG_MARKED              },
+                { "incremental",         no_argument,       NULL, ARG_INCREMENTAL         },
                 {}
         };
 
@@ -924,6 +928,10 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                         arg_marked = true;
                         break;
 
+                case ARG_INCREMENTAL:
+                        arg_incremental = true;
+                        break;
+
                 case '.':
                         /* Output an error mimicking getopt, and print a hint afterwards */
                         log_error("%s: invalid option -- '.'", program_invocation_name);
@@ -973,6 +981,10 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                                                "List of units to restart/reload is required.");
         }
 
+        if (arg_incremental && !streq_ptr(argv[optind], "daemon-reload"))
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "--incremental may only be used with 'daemon-reload'.");
+
         if (arg_image && arg_root)
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "Please specify either --root= or --image=, the combination of both is not supported.");
 
@@ -96,6 +96,7 @@ extern TimestampStyle arg_timestamp_style;
 extern bool arg_read_only;
 extern bool arg_mkdir;
 extern bool arg_marked;
+extern bool arg_incremental;
 
 static inline const char* arg_job_mode(void) {
         return _arg_job_mode ?: "replace";
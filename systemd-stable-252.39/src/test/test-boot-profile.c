@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "boot-profile.h"
+#include "fileio.h"
+#include "manager.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "service.h"
+#include "stdio-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+TEST(boot_profile_save_load) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        _cleanup_(boot_profile_freep) BootProfile *p = NULL, *q = NULL;
+        const BootProfileUnit *u;
+        const char *path;
+
+        assert_se(mkdtemp_malloc("/tmp/test-boot-profile-XXXXXX", &dir) >= 0);
+        path = prefix_roota(dir, "var/lib/systemd/boot-profile");
+
+        assert_se(boot_profile_new(&p) >= 0);
+        p->userspace_time = 5 * USEC_PER_SEC;
+        p->scheduling = true;
+        assert_se(boot_profile_add_unit(p, "a.service", 100, 2 * USEC_PER_SEC, true) >= 0);
+        assert_se(boot_profile_add_unit(p, "b@foo.service", 200, 0, false) >= 0);
+        assert_se(boot_profile_add_unit(p, "a.service", 300, 0, false) == -EEXIST);
+
+        assert_se(boot_profile_save(p, path) >= 0);
+        assert_se(boot_profile_load(path, &q) >= 0);
+
+        assert_se(q->userspace_time == 5 * USEC_PER_SEC);
+        assert_se(q->scheduling);
+        assert_se(hashmap_size(q->units) == 2);
+
+        assert_se(u = boot_profile_get_unit(q, "a.service"));
+        assert_se(u->activating == 100);
+        assert_se(u->time == 2 * USEC_PER_SEC);
+        assert_se(u->critical);
+
+        assert_se(u = boot_profile_get_unit(q, "b@foo.service"));
+        assert_se(u->activating == 200);
+        assert_se(u->time == 0);
+        assert_se(!u->critical);
+
+        assert_se(!boot_profile_get_unit(q, "c.service"));
+        assert_se(!boot_profile_get_unit(NULL, "a.service"));
+
+        /* Broken files are refused */
+        q = boot_profile_free(q);
+        assert_se(write_string_file(path, "", WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(boot_profile_load(path, &q) == -EBADMSG);
+        assert_se(write_string_file(path, "a.service 1 2 no\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(boot_profile_load(path, &q) == -EBADMSG);
+        assert_se(write_string_file(path, "userspace 1 no\na.service 1 x no\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(boot_profile_load(path, &q) == -EBADMSG);
+        assert_se(write_string_file(path, "userspace 1 no\nfoo 1 2 no\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(boot_profile_load(path, &q) == -EBADMSG);
+        assert_se(write_string_file(path, "userspace 1 no\na.service 1 2 no\na.service 1 2 no\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(boot_profile_load(path, &q) == -EBADMSG);
+        assert_se(!q);
+
+        assert_se(boot_profile_load(prefix_roota(dir, "nonexistent"), &q) == -ENOENT);
+}
+
+TEST(critical_path_weight) {
+        _cleanup_(manager_freep) Manager *m = NULL;
+        Unit *a, *b, *c, *d, *e;
+        int r;
+
+        r = manager_new(LOOKUP_SCOPE_USER, MANAGER_TEST_RUN_MINIMAL, &m);
+        if (manager_errno_skip_test(r))
+                return (void) log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+
+        assert_se(unit_new_for_name(m, sizeof(Service), "a.service", &a) >= 0);
+        assert_se(unit_new_for_name(m, sizeof(Service), "b.service", &b) >= 0);
+        assert_se(unit_new_for_name(m, sizeof(Service), "c.service", &c) >= 0);
+        assert_se(unit_new_for_name(m, sizeof(Service), "d.service", &d) >= 0);
+        assert_se(unit_new_for_name(m, sizeof(Service), "e.service", &e) >= 0);
+
+        /* a → b → d, a → c, e (with a cycle between d and e) */
+        assert_se(unit_add_dependency(a, UNIT_BEFORE, b, true, UNIT_DEPENDENCY_FILE) >= 0);
+        assert_se(unit_add_dependency(a, UNIT_BEFORE, c, true, UNIT_DEPENDENCY_FILE) >= 0);
+        assert_se(unit_add_dependency(b, UNIT_BEFORE, d, true, UNIT_DEPENDENCY_FILE) >= 0);
+        assert_se(unit_add_dependency(d, UNIT_BEFORE, e, true, UNIT_DEPENDENCY_FILE) >= 0);
+        assert_se(unit_add_dependency(e, UNIT_BEFORE, d, true, UNIT_DEPENDENCY_FILE) >= 0);
+
+        /* Without a profile everything is equal */
+        assert_se(unit_critical_path_weight(a) == 0);
+        assert_se(!unit_on_critical_path(a));
+
+        assert_se(boot_profile_new(&m->boot_profile) >= 0);
+        assert_se(boot_profile_add_unit(m->boot_profile, "a.service", 0, 1, true) >= 0);
+        assert_se(boot_profile_add_unit(m->boot_profile, "b.service", 1, 10, true) >= 0);
+        assert_se(boot_profile_add_unit(m->boot_profile, "c.service", 1, 100, false) >= 0);
+        assert_se(boot_profile_add_unit(m->boot_profile, "d.service", 11, 1000, true) >= 0);
+        m->critical_path_generation++;
+        m->critical_path_scheduling = true;
+
+        assert_se(unit_critical_path_weight(c) == 100);
+        assert_se(IN_SET(unit_critical_path_weight(e), 0, 1000));
+        assert_se(unit_critical_path_weight(d) == 1000);
+        assert_se(unit_critical_path_weight(b) == 1010);
+        assert_se(unit_critical_path_weight(a) == 1011);
+
+        assert_se(unit_on_critical_path(a));
+        assert_se(unit_on_critical_path(b));
+        assert_se(!unit_on_critical_path(c));
+        assert_se(!unit_on_critical_path(e));
+
+        m->critical_path_scheduling = false;
+        assert_se(!unit_on_critical_path(a));
+}
+
+TEST(critical_path_weight_long_chain) {
+        _cleanup_(manager_freep) Manager *m = NULL;
+        unsigned n = slow_tests_enabled() ? 200000 : 20000;
+        Unit *first = NULL, *prev = NULL;
+        int r;
+
+        /* A chain of units ordered after each other, way longer than what could be walked recursively */
+
+        r = manager_new(LOOKUP_SCOPE_USER, MANAGER_TEST_RUN_MINIMAL, &m);
+        if (manager_errno_skip_test(r))
+                return (void) log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+
+        assert_se(boot_profile_new(&m->boot_profile) >= 0);
+        m->critical_path_generation++;
+
+        for (unsigned i = 0; i < n; i++) {
+                char name[STRLEN("chain-.service") + DECIMAL_STR_MAX(unsigned)];
+                Unit *u;
+
+                xsprintf(name, "chain-%u.service", i);
+                assert_se(unit_new_for_name(m, sizeof(Service), name, &u) >= 0);
+                assert_se(boot_profile_add_unit(m->boot_profile, name, i, 1, true) >= 0);
+
+                if (prev)
+                        assert_se(unit_add_dependency(prev, UNIT_BEFORE, u, true, UNIT_DEPENDENCY_FILE) >= 0);
+                else
+                        first = u;
+                prev = u;
+        }
+
+        assert_se(unit_critical_path_weight(first) == n);
+        assert_se(unit_critical_path_weight(prev) == 1);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
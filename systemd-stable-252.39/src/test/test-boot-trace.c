@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "boot-trace.h"
+#include "process-util.h"
+#include "string-util.h"
+#include "tests.h"
+
+TEST(boot_trace_disabled) {
+        _cleanup_free_ BootTraceEntry *entries = NULL;
+        size_t n;
+
+        assert_se(boot_trace_now(NULL) == 0);
+        boot_trace_record(NULL, "foo.service", "spawn", 0, 1, 2);
+
+        assert_se(boot_trace_get(NULL, &entries, &n) >= 0);
+        assert_se(!entries);
+        assert_se(n == 0);
+}
+
+TEST(boot_trace_record) {
+        _cleanup_(boot_trace_freep) BootTrace *t = NULL;
+        _cleanup_free_ BootTraceEntry *entries = NULL;
+        _cleanup_free_ char *longname = NULL;
+        size_t n;
+
+        assert_se(boot_trace_new(&t) >= 0);
+
+        assert_se(longname = strrep("x", 300));
+
+        boot_trace_record(t, "foo.service", "start-job-wait", 0, 100, 200);
+        boot_trace_record(t, "foo.service", "spawn", 0, 0, 300);           /* not recorded, no begin */
+        boot_trace_record(t, longname, "mount-namespace-and-more-than-that", 42, 300, 250);
+
+        assert_se(boot_trace_get(t, &entries, &n) >= 0);
+        assert_se(n == 2);
+
+        assert_se(streq(entries[0].unit, "foo.service"));
+        assert_se(streq(entries[0].phase, "start-job-wait"));
+        assert_se(entries[0].pid == 0);
+        assert_se(entries[0].begin == 100);
+        assert_se(entries[0].end == 200);
+
+        assert_se(strlen(entries[1].unit) == sizeof(entries[1].unit) - 1);
+        assert_se(startswith(entries[1].phase, "mount-namespace"));
+        assert_se(entries[1].pid == 42);
+        assert_se(entries[1].end == 300); /* clamped to begin */
+}
+
+TEST(boot_trace_wrap) {
+        _cleanup_(boot_trace_freep) BootTrace *t = NULL;
+        _cleanup_free_ BootTraceEntry *entries = NULL;
+        size_t n;
+
+        assert_se(boot_trace_new(&t) >= 0);
+
+        for (usec_t i = 1; i <= BOOT_TRACE_ENTRIES_MAX + 10; i++)
+                boot_trace_record(t, "foo.service", "spawn", 0, i, i + 1);
+
+        /* Only the most recent records are kept, oldest first */
+        assert_se(boot_trace_get(t, &entries, &n) >= 0);
+        assert_se(n == BOOT_TRACE_ENTRIES_MAX);
+        assert_se(entries[0].begin == 11);
+        assert_se(entries[n-1].begin == BOOT_TRACE_ENTRIES_MAX + 10);
+}
+
+TEST(boot_trace_child) {
+        _cleanup_(boot_trace_freep) BootTrace *t = NULL;
+        _cleanup_free_ BootTraceEntry *entries = NULL;
+        pid_t pid;
+        size_t n;
+
+        assert_se(boot_trace_new(&t) >= 0);
+
+        /* Children we fork off record into the same buffer */
+        pid = fork();
+        assert_se(pid >= 0);
+        if (pid == 0) {
+                boot_trace_record(t, "foo.service", "exec-setup", getpid_cached(), 1, 2);
+                _exit(EXIT_SUCCESS);
+        }
+        assert_se(wait_for_terminate_and_check("child", pid, WAIT_LOG) == EXIT_SUCCESS);
+
+        assert_se(boot_trace_get(t, &entries, &n) >= 0);
+        assert_se(n == 1);
+        assert_se(entries[0].pid == pid);
+        assert_se(streq(entries[0].phase, "exec-setup"));
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
@@ -6,6 +6,7 @@
 #include "errno-util.h"
 #include "string-util.h"
 #include "tests.h"
+#include "time-util.h"
 
 static void _test_one(int line, const char *input, const char *output) {
         CalendarSpec *c;
@@ -229,6 +230,94 @@ TEST(calendar_spec_next) {
         test_next("hourly", "IST-1GMT-0,M10.5.0/1,M3.5.0/1", 1743292800000000, 1743296400000000);
 }
 
+static void test_next_forked_one(const char *input, usec_t after, unsigned n) {
+        _cleanup_(calendar_spec_freep) CalendarSpec *c = NULL;
+        usec_t u = after;
+
+        /* Follows the next elapses of the spec and checks that we arrive at the same times as glibc */
+
+        log_info("/* %s \"%s\" */", __func__, input);
+
+        assert_se(calendar_spec_from_string(input, &c) >= 0);
+
+        for (unsigned i = 0; i < n; i++) {
+                usec_t a = USEC_INFINITY, b = USEC_INFINITY;
+                int r, q;
+
+                r = calendar_spec_next_usec(c, u, &a);
+                q = calendar_spec_next_usec_forked(c, u, &b);
+
+                log_debug("%s: %s / %s", FORMAT_TIMESTAMP_STYLE(u, TIMESTAMP_UTC),
+                          r < 0 ? STRERROR(r) : FORMAT_TIMESTAMP_STYLE(a, TIMESTAMP_UTC),
+                          q < 0 ? STRERROR(q) : FORMAT_TIMESTAMP_STYLE(b, TIMESTAMP_UTC));
+
+                assert_se(r == q);
+                if (r < 0)
+                        break;
+
+                assert_se(a == b);
+                u = a;
+        }
+}
+
+TEST(calendar_spec_next_forked) {
+        struct tm tm = { .tm_year = 70, .tm_mday = 1 };
+
+        if (!timezone_is_valid("Europe/Berlin", LOG_DEBUG)) {
+                log_tests_skipped("timezone data is not installed");
+                return;
+        }
+
+        /* glibc's mktime() starts from the UTC offset it found last time. Make sure that our children start
+         * out like we do: from a process that has only used UTC so far. */
+        assert_se(setenv("TZ", ":UTC", 1) >= 0);
+        tzset();
+        assert_se(mktime(&tm) == 0);
+
+        /* Across DST transitions, including times that don't exist or exist twice */
+        test_next_forked_one("*-*-* *:30:00 Europe/Berlin", 1490443200000000, 48);
+        test_next_forked_one("*-*-* *:30:00 Europe/Berlin", 1509192000000000, 48);
+        test_next_forked_one("*-*-* 02:30:00 Europe/Berlin", 1489968000000000, 10);
+        test_next_forked_one("*-*-* 02:30:00 Europe/Berlin", 1508889600000000, 10);
+        test_next_forked_one("*:0/20 Pacific/Auckland", 1506124800000000, 96);
+        test_next_forked_one("*:0/20 Pacific/Auckland", 1491004800000000, 96);
+        test_next_forked_one("2017-04-02 02:30:00 Pacific/Auckland", 12345, 2);
+        test_next_forked_one("Sun *-*-* 01:00:00 Europe/Dublin", 1616412478000000, 5);
+        test_next_forked_one("hourly Europe/Dublin", 1743292800000000, 24);
+        test_next_forked_one("*:15 Australia/Lord_Howe", 1491004800000000, 48);
+        test_next_forked_one("*:15 Australia/Lord_Howe", 1506729600000000, 48);
+        test_next_forked_one("*-*-* 01:30:00 America/New_York", 1489104000000000, 5);
+        test_next_forked_one("*-*-* 01:30:00 America/New_York", 1509667200000000, 5);
+        test_next_forked_one("*-*~01 03:00 America/Sao_Paulo", 1483228800000000, 24);
+        /* After the last transition in the timezone file its rules apply */
+        test_next_forked_one("*-*-* 02:30:00 Europe/Berlin", 4269456000000000, 10);
+        test_next_forked_one("*-03-* 01:00:00 America/Santiago", 4269456000000000, 10);
+
+        assert_se(unsetenv("TZ") >= 0);
+        tzset();
+}
+
+TEST(calendar_spec_next_benchmark) {
+        _cleanup_(calendar_spec_freep) CalendarSpec *c = NULL;
+        unsigned n = slow_tests_enabled() ? 1000000 : 100000;
+        usec_t u = 1483228800000000, ts;
+
+        if (!timezone_is_valid("Europe/Berlin", LOG_DEBUG)) {
+                log_tests_skipped("timezone data is not installed");
+                return;
+        }
+
+        assert_se(calendar_spec_from_string("*-*-* *:*:00 Europe/Berlin", &c) >= 0);
+
+        ts = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n; i++)
+                assert_se(calendar_spec_next_usec(c, u, &u) >= 0);
+
+        log_info("Calculated %u next elapses in %s, until %s.",
+                 n, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), ts), USEC_PER_MSEC),
+                 FORMAT_TIMESTAMP_STYLE(u, TIMESTAMP_UTC));
+}
+
 TEST(calendar_spec_from_string) {
         CalendarSpec *c;
 
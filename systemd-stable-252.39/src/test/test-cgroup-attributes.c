@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <fcntl.h>
+
+#include "cgroup.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "manager.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "slice.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+#include "unit.h"
+
+static void check_attribute(const char *dir, const char *attribute, const char *expected) {
+        _cleanup_free_ char *p = NULL, *v = NULL;
+
+        assert_se(p = path_join(dir, attribute));
+        assert_se(read_full_file(p, &v, NULL) >= 0);
+        log_debug("%s: '%s'", attribute, v);
+        assert_se(streq(v, expected));
+}
+
+static void reset_attribute(const char *dir, const char *attribute) {
+        _cleanup_free_ char *p = NULL;
+
+        assert_se(p = path_join(dir, attribute));
+        assert_se(write_string_file(p, "",
+                                    WRITE_STRING_FILE_CREATE|
+                                    WRITE_STRING_FILE_TRUNCATE|
+                                    WRITE_STRING_FILE_AVOID_NEWLINE) >= 0);
+}
+
+TEST(cgroup_attribute_cache) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL, *cgroup_dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        uint64_t writes, skipped;
+        Unit *u;
+
+        /* The attributes are written relative to the unit's cgroup directory, hence a plain directory will
+         * do, and we can see what got written. */
+        assert_se(mkdtemp_malloc("/tmp/test-cgroup-attributes-XXXXXX", &cgroup_dir) >= 0);
+        reset_attribute(cgroup_dir, "cpu.weight");
+        reset_attribute(cgroup_dir, "io.weight");
+
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+        assert_se(manager_new(LOOKUP_SCOPE_USER, MANAGER_TEST_RUN_MINIMAL, &m) >= 0);
+        assert_se(unit_new_for_name(m, sizeof(Slice), "test-cgroup-attributes.slice", &u) >= 0);
+        assert_se((u->cgroup_dir_fd = open(cgroup_dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC)) >= 0);
+
+        writes = m->n_cgroup_attribute_writes;
+        skipped = m->n_cgroup_attribute_writes_skipped;
+
+        assert_se(unit_set_cgroup_attribute(u, "cpu", "cpu.weight", makedev(0, 0), "100") >= 0);
+        assert_se(unit_set_cgroup_attribute(u, "io", "io.weight", makedev(0, 0), "default 100") >= 0);
+        check_attribute(cgroup_dir, "cpu.weight", "100\n");
+        check_attribute(cgroup_dir, "io.weight", "default 100\n");
+        assert_se(m->n_cgroup_attribute_writes == writes + 2);
+
+        /* Writing the same values again is skipped, even if they were changed behind our back */
+        reset_attribute(cgroup_dir, "cpu.weight");
+        reset_attribute(cgroup_dir, "io.weight");
+        assert_se(unit_set_cgroup_attribute(u, "cpu", "cpu.weight", makedev(0, 0), "100") >= 0);
+        assert_se(unit_set_cgroup_attribute(u, "io", "io.weight", makedev(0, 0), "default 100") >= 0);
+        check_attribute(cgroup_dir, "cpu.weight", "");
+        check_attribute(cgroup_dir, "io.weight", "");
+        assert_se(m->n_cgroup_attribute_writes == writes + 2);
+        assert_se(m->n_cgroup_attribute_writes_skipped == skipped + 2);
+
+        /* … but different values are written */
+        assert_se(unit_set_cgroup_attribute(u, "cpu", "cpu.weight", makedev(0, 0), "200") >= 0);
+        check_attribute(cgroup_dir, "cpu.weight", "200\n");
+        assert_se(m->n_cgroup_attribute_writes == writes + 3);
+
+        /* Invalidating a controller makes us write its attributes again, and only those */
+        reset_attribute(cgroup_dir, "cpu.weight");
+        unit_invalidate_cgroup(u, CGROUP_MASK_CPU);
+        assert_se(unit_set_cgroup_attribute(u, "cpu", "cpu.weight", makedev(0, 0), "200") >= 0);
+        assert_se(unit_set_cgroup_attribute(u, "io", "io.weight", makedev(0, 0), "default 100") >= 0);
+        check_attribute(cgroup_dir, "cpu.weight", "200\n");
+        check_attribute(cgroup_dir, "io.weight", "");
+        assert_se(m->n_cgroup_attribute_writes == writes + 4);
+        assert_se(m->n_cgroup_attribute_writes_skipped == skipped + 3);
+
+        /* Invalidating everything, as a reload does, restores all of them */
+        unit_invalidate_cgroup(u, _CGROUP_MASK_ALL);
+        assert_se(unit_set_cgroup_attribute(u, "cpu", "cpu.weight", makedev(0, 0), "200") >= 0);
+        assert_se(unit_set_cgroup_attribute(u, "io", "io.weight", makedev(0, 0), "default 100") >= 0);
+        check_attribute(cgroup_dir, "cpu.weight", "200\n");
+        check_attribute(cgroup_dir, "io.weight", "default 100\n");
+        assert_se(m->n_cgroup_attribute_writes == writes + 6);
+        assert_se(m->n_cgroup_attribute_writes_skipped == skipped + 3);
+
+        /* Failed writes are not remembered */
+        assert_se(unit_set_cgroup_attribute(u, "memory", "memory.max", makedev(0, 0), "max") == -ENOENT);
+        assert_se(unit_set_cgroup_attribute(u, "memory", "memory.max", makedev(0, 0), "max") == -ENOENT);
+        assert_se(m->n_cgroup_attribute_writes == writes + 8);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
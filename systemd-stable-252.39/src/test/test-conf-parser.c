@@ -313,9 +313,10 @@ static const char* const config_file[] = {
 
 static void test_config_parse_one(unsigned i, const char *s) {
         _cleanup_(unlink_tempfilep) char name[] = "/tmp/test-conf-parser.XXXXXX";
+        _cleanup_(config_file_freep) ConfigFile *c = NULL;
         _cleanup_fclose_ FILE *f = NULL;
-        _cleanup_free_ char *setting1 = NULL;
-        int r;
+        _cleanup_free_ char *setting1 = NULL, *parsed = NULL;
+        int r, q;
 
         const ConfigTableItem items[] = {
                 { "Section", "setting1",  config_parse_string,   0, &setting1},
@@ -384,6 +385,30 @@ static void test_config_parse_one(unsigned i, const char *s) {
                 assert_se(streq(setting1, "2"));
                 break;
         }
+
+        /* The same file read ahead of time and then applied must give the same results */
+        parsed = TAKE_PTR(setting1);
+
+        q = config_file_read(name, &c);
+        if (q < 0) {
+                assert_se(q == r);
+                assert_se(!parsed);
+                return;
+        }
+
+        /* Applying must be repeatable */
+        for (unsigned k = 0; k < 2; k++) {
+                setting1 = mfree(setting1);
+
+                assert_se(config_parse_file(NULL, c,
+                                            "Section\0"
+                                            "-NoWarnSection\0",
+                                            config_item_table_lookup, items,
+                                            CONFIG_PARSE_WARN,
+                                            NULL,
+                                            NULL) == r);
+                assert_se(streq_ptr(setting1, parsed));
+        }
 }
 
 TEST(config_parse) {
@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #include "bus-util.h"
+#include "format-util.h"
 #include "manager.h"
 #include "manager-dump.h"
 #include "rm-rf.h"
@@ -11,6 +12,7 @@
 #include "slice.h"
 #include "special.h"
 #include "strv.h"
+#include "target.h"
 #include "tests.h"
 #include "unit-serialize.h"
 
@@ -71,6 +73,129 @@ static void verify_dependency_atoms(void) {
         }
 }
 
+static Unit* benchmark_unit(Manager *m, const char *fmt, size_t i) {
+        _cleanup_free_ char *name = NULL;
+        Unit *u;
+
+        assert_se(asprintf(&name, fmt, i) >= 0);
+        assert_se(unit_new_for_name(m, sizeof(Target), name, &u) >= 0);
+        u->load_state = UNIT_LOADED;
+
+        return u;
+}
+
+static void benchmark_transaction(Manager *m) {
+        size_t n_units = slow_tests_enabled() ? 50000 : 5000, n_groups = n_units / 100, n_edges = 0, size = 0;
+        _cleanup_free_ Unit **units = NULL, **groups = NULL;
+        Unit *top, *shutdown, *u;
+        const char *k;
+        usec_t t;
+        Job *j;
+
+        /* Builds a synthetic dependency graph shaped like a real boot: one target pulling in all units,
+         * which are ordered after a few group targets, and all conflict with one shutdown target. Then
+         * measures how long building transactions over it takes, and how much memory the dependencies
+         * take up. */
+
+        top = benchmark_unit(m, "benchmark-top-%zu.target", 0);
+        shutdown = benchmark_unit(m, "benchmark-shutdown-%zu.target", 0);
+        assert_se(units = new(Unit*, n_units));
+        assert_se(groups = new(Unit*, n_groups));
+
+        t = now(CLOCK_MONOTONIC);
+
+        for (size_t i = 0; i < n_groups; i++) {
+                groups[i] = benchmark_unit(m, "benchmark-group-%zu.target", i);
+                assert_se(unit_add_two_dependencies(top, UNIT_AFTER, UNIT_REQUIRES, groups[i], true, UNIT_DEPENDENCY_FILE) >= 0);
+        }
+
+        for (size_t i = 0; i < n_units; i++) {
+                units[i] = benchmark_unit(m, "benchmark-%zu.target", i);
+
+                assert_se(unit_add_dependency(top, UNIT_WANTS, units[i], true, UNIT_DEPENDENCY_FILE) >= 0);
+                assert_se(unit_add_two_dependencies(units[i], UNIT_AFTER, UNIT_REQUIRES, groups[i % n_groups], true, UNIT_DEPENDENCY_FILE) >= 0);
+                assert_se(unit_add_two_dependencies(units[i], UNIT_BEFORE, UNIT_CONFLICTS, shutdown, true, UNIT_DEPENDENCY_DEFAULT) >= 0);
+
+                /* A long ordering chain, to make sure the cycle detection copes with deep graphs */
+                if (i > 0)
+                        assert_se(unit_add_dependency(units[i], UNIT_AFTER, units[i - 1], true, UNIT_DEPENDENCY_FILE) >= 0);
+        }
+
+        log_info("Added dependencies of %zu units in %s", n_units + n_groups + 2, FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - t, 1));
+
+        HASHMAP_FOREACH_KEY(u, k, m->units)
+                if (u->id == k) {
+                        n_edges += u->dependencies.n_edges;
+                        size += unit_get_dependency_memory(u);
+                }
+        log_info("%zu dependency edges in %s", n_edges, FORMAT_BYTES(size));
+
+        assert_se(shutdown->dependencies.index);
+        assert_se(shutdown->dependencies.n_edges == n_units * 3);
+        assert_se( unit_find_dependency(shutdown, UNIT_CONFLICTED_BY, units[n_units - 1]));
+        assert_se(!unit_find_dependency(shutdown, UNIT_CONFLICTED_BY, top));
+        assert_se( unit_has_dependency(shutdown, UNIT_ATOM_AFTER, units[n_units / 2]));
+        assert_se(!unit_has_dependency(shutdown, UNIT_ATOM_BEFORE, units[n_units / 2]));
+
+        for (unsigned i = 0; i < 3; i++) {
+                t = now(CLOCK_MONOTONIC);
+                assert_se(manager_add_job(m, JOB_START, top, JOB_REPLACE, NULL, NULL, &j) == 0);
+                log_info("Built start transaction with %u jobs in %s", hashmap_size(m->jobs), FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - t, 1));
+                manager_clear_jobs(m);
+        }
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(manager_add_job(m, JOB_START, shutdown, JOB_REPLACE, NULL, NULL, &j) == 0);
+        log_info("Built shutdown transaction with %u jobs in %s", hashmap_size(m->jobs), FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - t, 1));
+        manager_clear_jobs(m);
+
+        /* Dropping the default dependencies again removes all edges of the shutdown target, one by one */
+        t = now(CLOCK_MONOTONIC);
+        for (size_t i = 0; i < n_units; i++)
+                unit_remove_dependencies(units[i], UNIT_DEPENDENCY_DEFAULT);
+        log_info("Removed dependencies in %s", FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - t, 1));
+
+        assert_se(shutdown->dependencies.n_edges == 0);
+        assert_se(!unit_find_dependency(units[0], UNIT_CONFLICTS, shutdown));
+        assert_se( unit_has_dependency(units[0], UNIT_ATOM_AFTER, groups[0]));
+}
+
+static void benchmark_ordering_cycles(Manager *m) {
+        size_t n_cycles = slow_tests_enabled() ? 5000 : 500;
+        Unit *top;
+        usec_t t;
+        Job *j;
+
+        /* Builds many independent ordering cycles of three units each, all of them only wanted by one
+         * target. All of them are broken by dropping one job each, in one pass. */
+
+        top = benchmark_unit(m, "benchmark-cycles-%zu.target", 0);
+
+        for (size_t i = 0; i < n_cycles; i++) {
+                Unit *a, *b, *c;
+
+                a = benchmark_unit(m, "benchmark-cycle-%zu-a.target", i);
+                b = benchmark_unit(m, "benchmark-cycle-%zu-b.target", i);
+                c = benchmark_unit(m, "benchmark-cycle-%zu-c.target", i);
+
+                assert_se(unit_add_dependency(top, UNIT_WANTS, a, true, UNIT_DEPENDENCY_FILE) >= 0);
+                assert_se(unit_add_dependency(top, UNIT_WANTS, b, true, UNIT_DEPENDENCY_FILE) >= 0);
+                assert_se(unit_add_dependency(top, UNIT_WANTS, c, true, UNIT_DEPENDENCY_FILE) >= 0);
+                assert_se(unit_add_dependency(a, UNIT_AFTER, b, true, UNIT_DEPENDENCY_FILE) >= 0);
+                assert_se(unit_add_dependency(b, UNIT_AFTER, c, true, UNIT_DEPENDENCY_FILE) >= 0);
+                assert_se(unit_add_dependency(c, UNIT_AFTER, a, true, UNIT_DEPENDENCY_FILE) >= 0);
+        }
+
+        manager_clear_jobs(m);
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(manager_add_job(m, JOB_START, top, JOB_REPLACE, NULL, NULL, &j) == 0);
+        log_info("Broke %zu ordering cycles in %s", n_cycles, FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - t, 1));
+
+        assert_se(hashmap_size(m->jobs) == 1 + 2 * n_cycles);
+        manager_clear_jobs(m);
+}
+
 int main(int argc, char *argv[]) {
         _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error err = SD_BUS_ERROR_NULL;
@@ -184,32 +309,32 @@ int main(int argc, char *argv[]) {
         assert_se(manager_add_job(m, JOB_START, a_conj, JOB_REPLACE, NULL, NULL, &j) == -EDEADLK);
         manager_dump_jobs(m, stdout, /* patterns= */ NULL, "\t");
 
-        assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), b));
-        assert_se(!hashmap_get(unit_get_dependencies(b, UNIT_RELOAD_PROPAGATED_FROM), a));
-        assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
-        assert_se(!hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
+        assert_se(!unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_find_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(!unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(!unit_find_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b, true, UNIT_DEPENDENCY_UDEV) >= 0);
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c, true, UNIT_DEPENDENCY_PROC_SWAP) >= 0);
 
-        assert_se( hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), b));
-        assert_se( hashmap_get(unit_get_dependencies(b, UNIT_RELOAD_PROPAGATED_FROM), a));
-        assert_se( hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
-        assert_se( hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
+        assert_se( unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se( unit_find_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se( unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se( unit_find_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         unit_remove_dependencies(a, UNIT_DEPENDENCY_UDEV);
 
-        assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), b));
-        assert_se(!hashmap_get(unit_get_dependencies(b, UNIT_RELOAD_PROPAGATED_FROM), a));
-        assert_se( hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
-        assert_se( hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
+        assert_se(!unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_find_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se( unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se( unit_find_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         unit_remove_dependencies(a, UNIT_DEPENDENCY_PROC_SWAP);
 
-        assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), b));
-        assert_se(!hashmap_get(unit_get_dependencies(b, UNIT_RELOAD_PROPAGATED_FROM), a));
-        assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
-        assert_se(!hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
+        assert_se(!unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_find_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(!unit_find_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(!unit_find_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         assert_se(manager_load_unit(m, "unit-with-multiple-dashes.service", NULL, NULL, &unit_with_multiple_dashes) >= 0);
 
@@ -296,5 +421,8 @@ int main(int argc, char *argv[]) {
         assert_se(!unit_has_dependency(fruit, UNIT_ATOM_REFERENCED_BY, tomato));
         assert_se( unit_has_dependency(zupa, UNIT_ATOM_REFERENCED_BY, tomato));
 
+        benchmark_transaction(m);
+        benchmark_ordering_cycles(m);
+
         return 0;
 }
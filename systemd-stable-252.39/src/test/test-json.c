@@ -1,6 +1,9 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include <float.h>
+#if HAVE_MALLINFO2
+#include <malloc.h>
+#endif
 
 #include "alloc-util.h"
 #include "escape.h"
@@ -12,6 +15,7 @@
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
+#include "time-util.h"
 #include "util.h"
 
 static void test_tokenizer_one(const char *data, ...) {
@@ -664,4 +668,420 @@ TEST(json_append) {
         assert_se(json_variant_equal(v, w));
 }
 
+static const char *const stream_documents[] = {
+        "{\"k\": \"v\", \"foo\": [1, 2, 3], \"bar\": {\"zap\": null}}",
+        "{\"mutant\": [1, null, \"1\", {\"1\": [1, \"1\"]}], \"thisisaverylongproperty\": 1.27}",
+        "[ 0, -0, 0.0, -0.0, -17, 18446744073709551615, true, false, \"\", \"a \\\"quoted\\\" \\\\ string\\n\", {}, [], [[]], [{}] ]",
+        "\"just a string\"",
+        "4711",
+};
+
+TEST(arena) {
+        for (size_t i = 0; i < ELEMENTSOF(stream_documents); i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+                _cleanup_(json_arena_freep) JsonArena *arena = NULL;
+                _cleanup_free_ char *a = NULL, *b = NULL;
+                JsonVariant *w = NULL;
+
+                assert_se(arena = json_arena_new());
+                assert_se(json_parse(stream_documents[i], 0, &v, NULL, NULL) >= 0);
+                assert_se(json_parse_with_arena(stream_documents[i], 0, arena, &w, NULL, NULL) >= 0);
+
+                assert_se(json_variant_equal(v, w));
+                assert_se(json_variant_format(v, 0, &a) >= 0);
+                assert_se(json_variant_format(w, 0, &b) >= 0);
+                assert_se(streq(a, b));
+
+                /* Arena variants are not reference counted, but this must still be safe */
+                assert_se(json_variant_ref(w) == w);
+                assert_se(!json_variant_unref(w));
+
+                log_info("%s → %zu bytes in arena", a, json_arena_size(arena));
+        }
+
+        {
+                _cleanup_(json_arena_freep) JsonArena *arena = NULL;
+                JsonVariant *v = NULL;
+
+                assert_se(arena = json_arena_new());
+                assert_se(json_parse_with_arena("{\"foo\": [1, 2", 0, arena, &v, NULL, NULL) == -EINVAL);
+                assert_se(json_parse_with_arena("[\"secret\"]", JSON_PARSE_SENSITIVE, arena, &v, NULL, NULL) >= 0);
+                assert_se(json_variant_is_sensitive(v));
+                assert_se(streq(json_variant_string(json_variant_by_index(v, 0)), "secret"));
+        }
+}
+
+static void test_reader_one(const char *data, ...) {
+        _cleanup_(json_reader_freep) JsonReader *r = NULL;
+        va_list ap;
+        int t;
+
+        log_info("/* %s data=%s */", __func__, data);
+
+        assert_se(json_reader_new(&r, data) >= 0);
+
+        va_start(ap, data);
+
+        for (;;) {
+                t = json_reader_next(r);
+
+                assert_se(t == va_arg(ap, int));
+
+                if (t < 0 || t == JSON_READER_END)
+                        break;
+
+                if (IN_SET(t, JSON_READER_KEY, JSON_READER_STRING))
+                        assert_se(streq(json_reader_string(r), va_arg(ap, const char*)));
+                else if (t == JSON_READER_UNSIGNED) {
+                        uint64_t u;
+
+                        assert_se(json_reader_unsigned(r, &u) >= 0);
+                        assert_se(u == va_arg(ap, uint64_t));
+                } else if (t == JSON_READER_INTEGER) {
+                        int64_t i;
+
+                        assert_se(json_reader_integer(r, &i) >= 0);
+                        assert_se(i == va_arg(ap, int64_t));
+                } else if (t == JSON_READER_BOOLEAN) {
+                        bool b;
+
+                        assert_se(json_reader_boolean(r, &b) >= 0);
+                        assert_se(b == va_arg(ap, int));
+                }
+        }
+
+        va_end(ap);
+}
+
+TEST(reader) {
+        test_reader_one("", -EINVAL);
+        test_reader_one("   ", -EINVAL);
+        test_reader_one("0", JSON_READER_UNSIGNED, (uint64_t) 0, JSON_READER_END);
+        test_reader_one("\"foo\"", JSON_READER_STRING, "foo", JSON_READER_END);
+        test_reader_one("{}", JSON_READER_OBJECT_BEGIN, JSON_READER_OBJECT_END, JSON_READER_END);
+        test_reader_one("[1, -2, true, null]",
+                        JSON_READER_ARRAY_BEGIN,
+                        JSON_READER_UNSIGNED, (uint64_t) 1,
+                        JSON_READER_INTEGER, (int64_t) -2,
+                        JSON_READER_BOOLEAN, true,
+                        JSON_READER_NULL,
+                        JSON_READER_ARRAY_END,
+                        JSON_READER_END);
+        test_reader_one("{\"a\": {\"b\": [\"c\"]}, \"d\": \"e\"}",
+                        JSON_READER_OBJECT_BEGIN,
+                        JSON_READER_KEY, "a",
+                        JSON_READER_OBJECT_BEGIN,
+                        JSON_READER_KEY, "b",
+                        JSON_READER_ARRAY_BEGIN,
+                        JSON_READER_STRING, "c",
+                        JSON_READER_ARRAY_END,
+                        JSON_READER_OBJECT_END,
+                        JSON_READER_KEY, "d",
+                        JSON_READER_STRING, "e",
+                        JSON_READER_OBJECT_END,
+                        JSON_READER_END);
+
+        /* Grammar violations */
+        test_reader_one("1 2", JSON_READER_UNSIGNED, (uint64_t) 1, -EINVAL);
+        test_reader_one("[1,]", JSON_READER_ARRAY_BEGIN, JSON_READER_UNSIGNED, (uint64_t) 1, -EINVAL);
+        test_reader_one("[1}", JSON_READER_ARRAY_BEGIN, JSON_READER_UNSIGNED, (uint64_t) 1, -EINVAL);
+        test_reader_one("{1: 2}", JSON_READER_OBJECT_BEGIN, -EINVAL);
+        test_reader_one("{\"a\" 2}", JSON_READER_OBJECT_BEGIN, JSON_READER_KEY, "a", -EINVAL);
+        test_reader_one("{\"a\": 2", JSON_READER_OBJECT_BEGIN, JSON_READER_KEY, "a", JSON_READER_UNSIGNED, (uint64_t) 2, -EINVAL);
+}
+
+TEST(reader_variant) {
+        _cleanup_(json_reader_freep) JsonReader *r = NULL;
+        const char *data = "{\"skip\": [1, {\"x\": [2]}], \"records\": [{\"a\": 1}, {\"b\": [true, \"x\"]}, 7]}";
+        unsigned n = 0;
+        int t;
+
+        assert_se(json_reader_new(&r, data) >= 0);
+        assert_se(json_reader_next(r) == JSON_READER_OBJECT_BEGIN);
+        assert_se(json_reader_next(r) == JSON_READER_KEY);
+        assert_se(streq(json_reader_string(r), "skip"));
+        assert_se(json_reader_next(r) == JSON_READER_ARRAY_BEGIN);
+        assert_se(json_reader_skip(r) >= 0);
+        assert_se(json_reader_depth(r) == 1);
+        assert_se(json_reader_next(r) == JSON_READER_KEY);
+        assert_se(streq(json_reader_string(r), "records"));
+        assert_se(json_reader_next(r) == JSON_READER_ARRAY_BEGIN);
+
+        /* Materialize each record individually */
+        while ((t = json_reader_next(r)) != JSON_READER_ARRAY_END) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *w = NULL;
+
+                assert_se(t >= 0);
+                assert_se(json_reader_variant(r, NULL, &v) >= 0);
+                assert_se(json_reader_depth(r) == 2);
+
+                json_variant_dump(v, JSON_FORMAT_NEWLINE, stdout, NULL);
+
+                assert_se(json_parse(STRV_MAKE("{\"a\":1}", "{\"b\":[true,\"x\"]}", "7")[n], 0, &w, NULL, NULL) >= 0);
+                assert_se(json_variant_equal(v, w));
+                n++;
+        }
+
+        assert_se(n == 3);
+        assert_se(json_reader_next(r) == JSON_READER_OBJECT_END);
+        assert_se(json_reader_next(r) == JSON_READER_END);
+        assert_se(json_reader_depth(r) == 0);
+}
+
+static void test_writer_one(JsonFormatFlags flags) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_(json_writer_freep) JsonWriter *w = NULL;
+        _cleanup_free_ char *text = NULL, *expected = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t sz = 0;
+
+        log_info("/* %s flags=%x */", __func__, (unsigned) flags);
+
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR("string", JSON_BUILD_STRING("a \"quoted\"\tstring\n")),
+                                             JSON_BUILD_PAIR("numbers", JSON_BUILD_ARRAY(JSON_BUILD_INTEGER(-4711),
+                                                                                         JSON_BUILD_UNSIGNED(UINT64_MAX),
+                                                                                         JSON_BUILD_REAL(0.5))),
+                                             JSON_BUILD_PAIR("empty", JSON_BUILD_EMPTY_OBJECT),
+                                             JSON_BUILD_PAIR("nested", JSON_BUILD_ARRAY(JSON_BUILD_EMPTY_ARRAY,
+                                                                                        JSON_BUILD_OBJECT(JSON_BUILD_PAIR("b", JSON_BUILD_BOOLEAN(true))),
+                                                                                        JSON_BUILD_NULL)),
+                                             JSON_BUILD_PAIR("variant", JSON_BUILD_ARRAY(JSON_BUILD_STRING("x"), JSON_BUILD_UNSIGNED(1))))) >= 0);
+
+        assert_se(f = open_memstream_unlocked(&text, &sz));
+        assert_se(json_writer_new(&w, f, flags) >= 0);
+
+        /* Keys are only accepted in objects, values only where no key is expected */
+        assert_se(json_writer_key(w, "foo") == -EINVAL);
+        assert_se(json_writer_end_array(w) == -EINVAL);
+
+        assert_se(json_writer_begin_object(w) >= 0);
+        assert_se(json_writer_string(w, "foo") == -EINVAL);
+        assert_se(json_writer_key(w, "string") >= 0);
+        assert_se(json_writer_string(w, "a \"quoted\"\tstring\n") >= 0);
+        assert_se(json_writer_key(w, "numbers") >= 0);
+        assert_se(json_writer_begin_array(w) >= 0);
+        assert_se(json_writer_end_object(w) == -EINVAL);
+        assert_se(json_writer_integer(w, -4711) >= 0);
+        assert_se(json_writer_unsigned(w, UINT64_MAX) >= 0);
+        assert_se(json_writer_real(w, 0.5) >= 0);
+        assert_se(json_writer_end_array(w) >= 0);
+        assert_se(json_writer_key(w, "empty") >= 0);
+        assert_se(json_writer_begin_object(w) >= 0);
+        assert_se(json_writer_end_object(w) >= 0);
+        assert_se(json_writer_key(w, "nested") >= 0);
+        assert_se(json_writer_begin_array(w) >= 0);
+        assert_se(json_writer_begin_array(w) >= 0);
+        assert_se(json_writer_end_array(w) >= 0);
+        assert_se(json_writer_begin_object(w) >= 0);
+        assert_se(json_writer_key(w, "b") >= 0);
+        assert_se(json_writer_boolean(w, true) >= 0);
+        assert_se(json_writer_end_object(w) >= 0);
+        assert_se(json_writer_null(w) >= 0);
+        assert_se(json_writer_end_array(w) >= 0);
+        assert_se(json_writer_key(w, "variant") >= 0);
+        assert_se(json_writer_variant(w, json_variant_by_key(v, "variant")) >= 0);
+        assert_se(json_writer_end_object(w) >= 0);
+
+        /* A second toplevel value */
+        assert_se(json_writer_string(w, "second") >= 0);
+
+        assert_se(fflush_and_check(f) >= 0);
+
+        f = safe_fclose(f);
+        assert_se(f = open_memstream_unlocked(&expected, &sz));
+        assert_se(json_variant_dump(v, flags, f, NULL) >= 0);
+        assert_se(json_variant_dump(JSON_VARIANT_STRING_CONST("second"), flags, f, NULL) >= 0);
+        assert_se(fflush_and_check(f) >= 0);
+
+        fputs(text, stdout);
+        assert_se(streq(text, expected));
+}
+
+TEST(writer) {
+        test_writer_one(0);
+        test_writer_one(JSON_FORMAT_NEWLINE);
+        test_writer_one(JSON_FORMAT_PRETTY);
+        test_writer_one(JSON_FORMAT_PRETTY|JSON_FORMAT_COLOR);
+        test_writer_one(JSON_FORMAT_SEQ);
+        test_writer_one(JSON_FORMAT_SSE);
+}
+
+static JsonVariant *benchmark_document(unsigned n) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+        /* Builds an array of objects shaped like user records and journal entries, i.e. the kind of
+         * data typically passed around via varlink or generated by journalctl --output=json */
+
+        for (unsigned i = 0; i < n; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *e = NULL;
+                char name[STRLEN("user") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(name, "user%u", i);
+
+                if (i % 2 == 0)
+                        assert_se(json_build(&e, JSON_BUILD_OBJECT(
+                                                     JSON_BUILD_PAIR("userName", JSON_BUILD_STRING(name)),
+                                                     JSON_BUILD_PAIR("uid", JSON_BUILD_UNSIGNED(60000 + i)),
+                                                     JSON_BUILD_PAIR("gid", JSON_BUILD_UNSIGNED(60000 + i)),
+                                                     JSON_BUILD_PAIR("realName", JSON_BUILD_STRING("Some Very Ordinary User")),
+                                                     JSON_BUILD_PAIR("homeDirectory", JSON_BUILD_STRING("/home/someuser")),
+                                                     JSON_BUILD_PAIR("shell", JSON_BUILD_STRING("/bin/bash")),
+                                                     JSON_BUILD_PAIR("memberOf", JSON_BUILD_STRV(STRV_MAKE("wheel", "audio", "video", "systemd-journal"))),
+                                                     JSON_BUILD_PAIR("diskSize", JSON_BUILD_UNSIGNED(UINT64_C(256) * 1024 * 1024 * 1024)),
+                                                     JSON_BUILD_PAIR("locked", JSON_BUILD_BOOLEAN(false)),
+                                                     JSON_BUILD_PAIR("privileged", JSON_BUILD_OBJECT(
+                                                                                     JSON_BUILD_PAIR("hashedPassword", JSON_BUILD_STRV(STRV_MAKE("$6$abcdefghijklmnop$qrstuvwxyz0123456789")))))))
+                                  >= 0);
+                else
+                        assert_se(json_build(&e, JSON_BUILD_OBJECT(
+                                                     JSON_BUILD_PAIR("__CURSOR", JSON_BUILD_STRING("s=6f0e2e1b0f5a4e4c9b0a6d2f7c5e3b1a;i=1a2b3c;b=0123456789abcdef0123456789abcdef;m=4d2;t=5f1e2d3c4b5a6;x=abcdef0123456789")),
+                                                     JSON_BUILD_PAIR("__REALTIME_TIMESTAMP", JSON_BUILD_STRING("1666000000000000")),
+                                                     JSON_BUILD_PAIR("__MONOTONIC_TIMESTAMP", JSON_BUILD_STRING("1234567")),
+                                                     JSON_BUILD_PAIR("_BOOT_ID", JSON_BUILD_STRING("0123456789abcdef0123456789abcdef")),
+                                                     JSON_BUILD_PAIR("PRIORITY", JSON_BUILD_STRING("6")),
+                                                     JSON_BUILD_PAIR("_PID", JSON_BUILD_STRING("1")),
+                                                     JSON_BUILD_PAIR("_COMM", JSON_BUILD_STRING("systemd")),
+                                                     JSON_BUILD_PAIR("_SYSTEMD_UNIT", JSON_BUILD_STRING("init.scope")),
+                                                     JSON_BUILD_PAIR("MESSAGE", JSON_BUILD_STRING("Started Some Ordinary Service \"foo\"\twith a slightly longer description."))))
+                                  >= 0);
+
+                assert_se(json_variant_append_array(&v, e) >= 0);
+        }
+
+        return TAKE_PTR(v);
+}
+
+static void benchmark_write_variant(JsonWriter *w, JsonVariant *v) {
+        /* Writes out a variant piece by piece, like a program would that generates JSON from its own data
+         * structures without building an intermediary JsonVariant tree first */
+
+        switch (json_variant_type(v)) {
+
+        case JSON_VARIANT_OBJECT: {
+                JsonVariant *e;
+                const char *k;
+
+                assert_se(json_writer_begin_object(w) >= 0);
+                JSON_VARIANT_OBJECT_FOREACH(k, e, v) {
+                        assert_se(json_writer_key(w, k) >= 0);
+                        benchmark_write_variant(w, e);
+                }
+                assert_se(json_writer_end_object(w) >= 0);
+                break;
+        }
+
+        case JSON_VARIANT_ARRAY: {
+                JsonVariant *e;
+
+                assert_se(json_writer_begin_array(w) >= 0);
+                JSON_VARIANT_ARRAY_FOREACH(e, v)
+                        benchmark_write_variant(w, e);
+                assert_se(json_writer_end_array(w) >= 0);
+                break;
+        }
+
+        case JSON_VARIANT_STRING:
+                assert_se(json_writer_string(w, json_variant_string(v)) >= 0);
+                break;
+
+        case JSON_VARIANT_UNSIGNED:
+                assert_se(json_writer_unsigned(w, json_variant_unsigned(v)) >= 0);
+                break;
+
+        default:
+                assert_se(json_writer_variant(w, v) >= 0);
+        }
+}
+
+TEST(benchmark) {
+        _cleanup_(json_variant_unrefp) JsonVariant *document = NULL;
+        _cleanup_free_ char *text = NULL;
+        unsigned n_records, n_iterations;
+        usec_t t;
+        size_t n = 0;
+
+        n_records = slow_tests_enabled() ? 10000 : 500;
+        n_iterations = slow_tests_enabled() ? 20 : 3;
+
+        assert_se(document = benchmark_document(n_records));
+        assert_se(json_variant_format(document, 0, &text) >= 0);
+
+        log_info("Document with %u records, %zu bytes", n_records, strlen(text));
+
+#if HAVE_MALLINFO2
+        {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+                struct mallinfo2 before, after;
+
+                before = mallinfo2();
+                assert_se(json_parse(text, 0, &v, NULL, NULL) >= 0);
+                after = mallinfo2();
+
+                log_info("json_parse(): %zu bytes on heap", LESS_BY(after.uordblks, before.uordblks));
+        }
+#endif
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n_iterations; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                assert_se(json_parse(text, 0, &v, NULL, NULL) >= 0);
+                assert_se(json_variant_elements(v) == n_records);
+        }
+        log_info("json_parse(): %s per document", FORMAT_TIMESPAN((now(CLOCK_MONOTONIC) - t) / n_iterations, 1));
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n_iterations; i++) {
+                _cleanup_(json_arena_freep) JsonArena *arena = NULL;
+                JsonVariant *v = NULL;
+
+                assert_se(arena = json_arena_new());
+                assert_se(json_parse_with_arena(text, 0, arena, &v, NULL, NULL) >= 0);
+                assert_se(json_variant_elements(v) == n_records);
+
+                if (i == 0)
+                        log_info("json_parse_with_arena(): %zu bytes in arena", json_arena_size(arena));
+        }
+        log_info("json_parse_with_arena(): %s per document", FORMAT_TIMESPAN((now(CLOCK_MONOTONIC) - t) / n_iterations, 1));
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n_iterations; i++) {
+                _cleanup_(json_reader_freep) JsonReader *r = NULL;
+                int k;
+
+                assert_se(json_reader_new(&r, text) >= 0);
+                n = 0;
+                while ((k = json_reader_next(r)) != JSON_READER_END) {
+                        assert_se(k >= 0);
+                        n++;
+                }
+        }
+        log_info("json_reader_next(): %s per document (%zu tokens)", FORMAT_TIMESPAN((now(CLOCK_MONOTONIC) - t) / n_iterations, 1), n);
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n_iterations; i++) {
+                _cleanup_free_ char *s = NULL;
+
+                assert_se(json_variant_format(document, 0, &s) >= 0);
+                assert_se(streq(s, text));
+        }
+        log_info("json_variant_format(): %s per document", FORMAT_TIMESPAN((now(CLOCK_MONOTONIC) - t) / n_iterations, 1));
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n_iterations; i++) {
+                _cleanup_(json_writer_freep) JsonWriter *w = NULL;
+                _cleanup_free_ char *s = NULL;
+                _cleanup_fclose_ FILE *f = NULL;
+                size_t sz = 0;
+
+                assert_se(f = open_memstream_unlocked(&s, &sz));
+                assert_se(json_writer_new(&w, f, 0) >= 0);
+                benchmark_write_variant(w, document);
+                assert_se(fflush_and_check(f) >= 0);
+                assert_se(streq(s, text));
+        }
+        log_info("json_writer: %s per document", FORMAT_TIMESPAN((now(CLOCK_MONOTONIC) - t) / n_iterations, 1));
+}
+
 DEFINE_TEST_MAIN(LOG_DEBUG);
@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <unistd.h>
+
+#include "conf-parser.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "hashmap.h"
+#include "load-cache.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+#include "unit-file.h"
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(config_file_hash_ops,
+                                              char, path_hash_func, path_compare,
+                                              ConfigFile, config_file_free);
+
+static void assert_config_files_equal(const ConfigFile *a, const ConfigFile *b) {
+        assert_se(streq(a->filename, b->filename));
+        assert_se(a->n_lines == b->n_lines);
+        for (size_t i = 0; i < a->n_lines; i++) {
+                assert_se(a->lines[i].line == b->lines[i].line);
+                assert_se(streq(a->lines[i].text, b->lines[i].text));
+        }
+}
+
+static void add_file(Hashmap **files, const char *path) {
+        ConfigFile *c;
+
+        assert_se(config_file_read(path, &c) >= 0);
+        assert_se(hashmap_ensure_put(files, &config_file_hash_ops, c->filename, c) >= 0);
+}
+
+TEST(unit_cache) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        _cleanup_(unit_file_dir_cache_freep) UnitFileDirCache *dirs = NULL, *loaded_dirs = NULL;
+        _cleanup_(unit_cache_freep) UnitCache *c = NULL;
+        _cleanup_(config_file_freep) ConfigFile *cached = NULL, *fresh = NULL;
+        _cleanup_hashmap_free_ Hashmap *files = NULL;
+        _cleanup_(unit_file_dir_done) UnitFileDir d = {};
+        const char *a, *b, *cache;
+        unsigned hits, misses;
+
+        assert_se(mkdtemp_malloc("/tmp/test-load-cache-XXXXXX", &dir) >= 0);
+        a = prefix_roota(dir, "a.service");
+        b = prefix_roota(dir, "b.service");
+        cache = prefix_roota(dir, "cache/unit-cache");
+
+        assert_se(write_string_file(a,
+                                    "[Unit]\n"
+                                    "Description=a\n"
+                                    "# comment\n"
+                                    "\n"
+                                    "[Service]\n"
+                                    "ExecStart=/bin/true \\\n"
+                                    "  --foo=bar\n"
+                                    "Environment=\n",
+                                    WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(write_string_file(b, "[Unit]\nDescription=b\n", WRITE_STRING_FILE_CREATE) >= 0);
+
+        /* Files changed less than a second ago are not cached */
+        assert_se(unit_cache_write(cache, NULL, NULL) >= 0);
+        add_file(&files, a);
+        add_file(&files, b);
+        assert_se(unit_cache_write(cache, NULL, files) >= 0);
+        assert_se(unit_cache_load(cache, &c, &loaded_dirs) == 1);
+        assert_se(unit_cache_read_file(c, a, &cached) == 0);
+        assert_config_files_equal(cached, hashmap_get(files, a));
+        cached = config_file_free(cached);
+        c = unit_cache_free(c);
+        loaded_dirs = unit_file_dir_cache_free(loaded_dirs);
+
+        (void) usleep(1100 * USEC_PER_MSEC);
+
+        assert_se(dirs = new0(UnitFileDirCache, 1));
+        assert_se(dirs->root_dir = strdup("/some/root"));
+        assert_se(dirs->expanded_search_path = strv_new("/etc/systemd/system", "/usr/lib/systemd/system"));
+        assert_se(d.path = strdup("/etc/systemd/system"));
+        d.exists = true;
+        d.dev = 7;
+        d.ino = 4711;
+        d.mtime = 1234567890123456789ULL;
+        assert_se(unit_file_dir_add_entry(&d, UNIT_FILE_DIR_ENTRY_UNIT, "a.service", NULL, 0) >= 0);
+        assert_se(unit_file_dir_add_entry(&d, UNIT_FILE_DIR_ENTRY_SYMLINK, "b.service", "a.service", 0) >= 0);
+        assert_se(unit_file_dir_add_entry(&d, UNIT_FILE_DIR_ENTRY_SYMLINK, "c.service", NULL, -EXDEV) >= 0);
+        assert_se(unit_file_dir_add_entry(&d, UNIT_FILE_DIR_ENTRY_SYMLINK, "d.service", NULL, 0) >= 0);
+        assert_se(unit_file_dir_add_entry(&d, UNIT_FILE_DIR_ENTRY_DIRECTORY, "a.service.d", NULL, 0) >= 0);
+        assert_se(unit_file_dir_cache_take(dirs, &d) >= 0);
+        assert_se(d.path = strdup("/usr/lib/systemd/system"));
+        assert_se(unit_file_dir_cache_take(dirs, &d) >= 0);
+
+        assert_se(unit_cache_write(cache, dirs, files) >= 0);
+        assert_se(unit_cache_load(cache, &c, &loaded_dirs) == 1);
+
+        /* The directory snapshot survives the round trip */
+        assert_se(streq(loaded_dirs->root_dir, "/some/root"));
+        assert_se(strv_equal(loaded_dirs->expanded_search_path, dirs->expanded_search_path));
+        assert_se(loaded_dirs->n_dirs == 2);
+        assert_se(streq(loaded_dirs->dirs[0].path, "/etc/systemd/system"));
+        assert_se(loaded_dirs->dirs[0].exists);
+        assert_se(loaded_dirs->dirs[0].dev == 7);
+        assert_se(loaded_dirs->dirs[0].ino == 4711);
+        assert_se(loaded_dirs->dirs[0].mtime == 1234567890123456789ULL);
+        assert_se(loaded_dirs->dirs[0].n_entries == 5);
+        for (size_t i = 0; i < 5; i++) {
+                const UnitFileDirEntry *x = dirs->dirs[0].entries + i, *y = loaded_dirs->dirs[0].entries + i;
+
+                assert_se(x->type == y->type);
+                assert_se(streq(x->name, y->name));
+                assert_se(streq_ptr(x->destination, y->destination));
+                assert_se(x->resolve_error == y->resolve_error);
+        }
+        assert_se(streq(loaded_dirs->dirs[1].path, "/usr/lib/systemd/system"));
+        assert_se(!loaded_dirs->dirs[1].exists);
+        assert_se(loaded_dirs->dirs[1].n_entries == 0);
+
+        /* Unchanged files come from the cache and match the files */
+        assert_se(unit_cache_read_file(c, a, &cached) == 1);
+        assert_config_files_equal(cached, hashmap_get(files, a));
+        assert_se(cached->n_lines == 5);
+        assert_se(streq(cached->lines[3].text, "ExecStart=/bin/true    --foo=bar"));
+        assert_se(unit_cache_verify_file(&cached) == 0);
+
+        /* The verification catches mismatches */
+        cached->lines[1].text[0] = 'X';
+        assert_se(unit_cache_verify_file(&cached) == 1);
+        assert_config_files_equal(cached, hashmap_get(files, a));
+        cached = config_file_free(cached);
+
+        /* Changed files are read again */
+        assert_se(write_string_file(b, "[Unit]\nDescription=b2\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(unit_cache_read_file(c, b, &fresh) == 0);
+        assert_se(fresh->n_lines == 2);
+        assert_se(streq(fresh->lines[1].text, "Description=b2"));
+
+        assert_se(unit_cache_read_file(c, "/nonexistent/e.service", &cached) == -ENOENT);
+
+        unit_cache_get_stats(c, &hits, &misses);
+        assert_se(hits == 1);
+        assert_se(misses == 2);
+}
+
+TEST(unit_cache_corrupt) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-load-cache.XXXXXX";
+        _cleanup_(unit_file_dir_cache_freep) UnitFileDirCache *dirs = NULL;
+        _cleanup_(unit_cache_freep) UnitCache *c = NULL;
+        _cleanup_close_ int fd = -1;
+
+        assert_se(unit_cache_load("/nonexistent/unit-cache", &c, &dirs) == 0);
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+        assert_se(unit_cache_load(fn, &c, &dirs) < 0);
+
+        assert_se(write_string_file(fn, "[Unit]\nDescription=not a cache\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(unit_cache_load(fn, &c, &dirs) < 0);
+
+        /* A cache without files is fine */
+        assert_se(unit_cache_write(fn, NULL, NULL) >= 0);
+        assert_se(unit_cache_load(fn, &c, &dirs) == 1);
+        assert_se(dirs->n_dirs == 0);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
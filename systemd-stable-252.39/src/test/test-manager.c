@@ -26,4 +26,48 @@ TEST(manager_taint_string) {
         assert_se(strstr(b, "split-usr"));
 }
 
+TEST(notify_message_supersedes) {
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        struct ucred ucred = { .pid = 4711, .uid = 1000, .gid = 1000 };
+        NotifyMessage status = { .ucred = ucred, .status = true },
+                watchdog = { .ucred = ucred, .watchdog = true },
+                both = { .ucred = ucred, .status = true, .watchdog = true },
+                other = { .ucred = ucred, .other = true },
+                barrier = { .ucred = ucred, .other = true, .barrier = true },
+                other_pid = { .ucred = { .pid = 4712, .uid = 1000, .gid = 1000 }, .status = true, .watchdog = true },
+                other_uid = { .ucred = { .pid = 4711, .uid = 0, .gid = 1000 }, .status = true, .watchdog = true },
+                with_fds = { .ucred = ucred, .status = true };
+
+        /* A later message of the same process carrying the same information supersedes an earlier one */
+        assert_se(notify_message_supersedes(&status, &status));
+        assert_se(notify_message_supersedes(&watchdog, &watchdog));
+        assert_se(notify_message_supersedes(&both, &status));
+        assert_se(notify_message_supersedes(&both, &watchdog));
+        assert_se(notify_message_supersedes(&both, &both));
+
+        /* … but not if it lacks some of it */
+        assert_se(!notify_message_supersedes(&status, &watchdog));
+        assert_se(!notify_message_supersedes(&watchdog, &status));
+        assert_se(!notify_message_supersedes(&status, &both));
+        assert_se(!notify_message_supersedes(&watchdog, &both));
+
+        /* Anything else is never dropped */
+        assert_se(!notify_message_supersedes(&both, &other));
+        assert_se(!notify_message_supersedes(&both, &barrier));
+        assert_se(!notify_message_supersedes(&barrier, &status));
+        assert_se(!notify_message_supersedes(&barrier, &barrier));
+
+        /* Only messages of the same process are coalesced */
+        assert_se(!notify_message_supersedes(&other_pid, &status));
+        assert_se(!notify_message_supersedes(&other_uid, &status));
+        assert_se(!notify_message_supersedes(&status, &other_pid));
+
+        /* Messages with fds are never dropped */
+        assert_se(fds = fdset_new());
+        assert_se(fdset_put_dup(fds, STDIN_FILENO) >= 0);
+        with_fds.fds = fds;
+        assert_se(!notify_message_supersedes(&both, &with_fds));
+        assert_se(notify_message_supersedes(&with_fds, &status));
+}
+
 DEFINE_TEST_MAIN(LOG_DEBUG);
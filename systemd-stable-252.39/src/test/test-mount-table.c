@@ -0,0 +1,219 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "mount-table.h"
+#include "set.h"
+#include "string-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+static void update(
+                MountTable *t,
+                const char *mountinfo,
+                Set **ret_changed_where,
+                Set **ret_new_what,
+                Set **ret_gone_what) {
+
+        _cleanup_(mnt_free_tablep) struct libmnt_table *table = NULL;
+        _cleanup_(mnt_free_iterp) struct libmnt_iter *iter = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+
+        assert_se(f = fmemopen((char*) mountinfo, strlen(mountinfo), "r"));
+        assert_se(libmount_parse("mountinfo", f, &table, &iter) >= 0);
+        assert_se(mount_table_update(t, table, iter, ret_changed_where, ret_new_what, ret_gone_what) >= 0);
+}
+
+static void assert_set(Set *s, size_t n, ...) {
+        va_list ap;
+
+        assert_se(set_size(s) == n);
+
+        va_start(ap, n);
+        for (size_t i = 0; i < n; i++)
+                assert_se(set_contains(s, va_arg(ap, const char*)));
+        va_end(ap);
+}
+
+TEST(mount_table_update) {
+        _cleanup_(mount_table_freep) MountTable *t = NULL;
+        MountTableEntry *e;
+
+        assert_se(t = mount_table_new());
+
+        /* Initially everything is new */
+        {
+                _cleanup_set_free_ Set *changed = NULL, *new = NULL, *gone = NULL;
+
+                update(t,
+                       "20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n"
+                       "21 20 0:5 / /dev rw,nosuid - devtmpfs devtmpfs rw\n"
+                       "22 20 8:2 / /home rw,relatime - ext4 /dev/sda2 rw\n"
+                       "23 20 8:3 / /srv rw,relatime - ext4 /dev/sda3 rw\n",
+                       &changed, &new, &gone);
+                assert_set(changed, 4, "/", "/dev", "/home", "/srv");
+                assert_set(new, 4, "/dev/sda1", "devtmpfs", "/dev/sda2", "/dev/sda3");
+                assert_set(gone, 0);
+                assert_se(mount_table_size(t) == 4);
+        }
+
+        /* Nothing changed */
+        {
+                _cleanup_set_free_ Set *changed = NULL, *new = NULL, *gone = NULL;
+
+                update(t,
+                       "20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n"
+                       "21 20 0:5 / /dev rw,nosuid - devtmpfs devtmpfs rw\n"
+                       "22 20 8:2 / /home rw,relatime - ext4 /dev/sda2 rw\n"
+                       "23 20 8:3 / /srv rw,relatime - ext4 /dev/sda3 rw\n",
+                       &changed, &new, &gone);
+                assert_set(changed, 0);
+                assert_set(new, 0);
+                assert_set(gone, 0);
+        }
+
+        /* A remount, an unmount, a mount stacked on top of another one, and a second mount of an already
+         * mounted source */
+        {
+                _cleanup_set_free_ Set *changed = NULL, *new = NULL, *gone = NULL;
+
+                update(t,
+                       "20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n"
+                       "21 20 0:5 / /dev rw,nosuid - devtmpfs devtmpfs rw\n"
+                       "22 20 8:2 / /home ro,relatime - ext4 /dev/sda2 ro\n"
+                       "24 22 0:30 / /home rw - tmpfs tmpfs rw\n"
+                       "25 20 8:1 /var /var rw,relatime - ext4 /dev/sda1 rw\n",
+                       &changed, &new, &gone);
+                assert_set(changed, 3, "/home", "/srv", "/var");
+                assert_set(new, 3, "/dev/sda2", "tmpfs", "/dev/sda1");
+                assert_set(gone, 1, "/dev/sda3");
+                assert_se(mount_table_size(t) == 5);
+
+                /* Stacked mounts are kept in mount order, the top-most one last */
+                assert_se(e = mount_table_get_where(t, "/home"));
+                assert_se(streq(e->what, "/dev/sda2"));
+                assert_se(startswith(e->options, "ro,"));
+                assert_se(e->by_where_next);
+                assert_se(streq(e->by_where_next->what, "tmpfs"));
+                assert_se(!e->by_where_next->by_where_next);
+
+                assert_se(!mount_table_get_where(t, "/srv"));
+        }
+
+        /* The lower mount goes away below the upper one, and a mount ID is reused for something else. A
+         * source that is still mounted elsewhere is not gone. */
+        {
+                _cleanup_set_free_ Set *changed = NULL, *new = NULL, *gone = NULL;
+
+                update(t,
+                       "20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n"
+                       "21 20 0:5 / /dev rw,nosuid - devtmpfs devtmpfs rw\n"
+                       "24 20 0:30 / /home rw - tmpfs tmpfs rw\n"
+                       "25 20 8:4 / /var rw,relatime - ext4 /dev/sda4 rw\n",
+                       &changed, &new, &gone);
+                assert_set(changed, 2, "/home", "/var");
+                assert_set(new, 1, "/dev/sda4");
+                assert_set(gone, 1, "/dev/sda2");
+
+                assert_se(e = mount_table_get_where(t, "/home"));
+                assert_se(streq(e->what, "tmpfs"));
+                assert_se(!e->by_where_next);
+
+                assert_se(e = mount_table_get_where(t, "/var"));
+                assert_se(streq(e->what, "/dev/sda4"));
+        }
+
+        /* A mount point whose unit could not be set up is reported again, even if it did not change */
+        mount_table_retry_where(t, "/home");
+        {
+                _cleanup_set_free_ Set *changed = NULL, *new = NULL, *gone = NULL;
+
+                update(t,
+                       "20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n"
+                       "21 20 0:5 / /dev rw,nosuid - devtmpfs devtmpfs rw\n"
+                       "24 20 0:30 / /home rw - tmpfs tmpfs rw\n"
+                       "25 20 8:4 / /var rw,relatime - ext4 /dev/sda4 rw\n",
+                       &changed, &new, &gone);
+                assert_set(changed, 1, "/home");
+                assert_set(new, 0);
+                assert_set(gone, 0);
+        }
+
+        /* … but only once */
+        {
+                _cleanup_set_free_ Set *changed = NULL;
+
+                update(t,
+                       "20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n"
+                       "21 20 0:5 / /dev rw,nosuid - devtmpfs devtmpfs rw\n"
+                       "24 20 0:30 / /home rw - tmpfs tmpfs rw\n"
+                       "25 20 8:4 / /var rw,relatime - ext4 /dev/sda4 rw\n",
+                       &changed, NULL, NULL);
+                assert_set(changed, 0);
+        }
+
+        /* Everything but the root is unmounted */
+        {
+                _cleanup_set_free_ Set *changed = NULL, *new = NULL, *gone = NULL;
+
+                update(t, "20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n", &changed, &new, &gone);
+                assert_set(changed, 3, "/dev", "/home", "/var");
+                assert_set(new, 0);
+                assert_set(gone, 3, "devtmpfs", "tmpfs", "/dev/sda4");
+                assert_se(mount_table_size(t) == 1);
+        }
+}
+
+static char* make_mountinfo(unsigned n, unsigned changed_from, unsigned n_changed) {
+        _cleanup_free_ char *buf = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t sz = 0;
+
+        assert_se(f = open_memstream_unlocked(&buf, &sz));
+
+        fputs("20 1 8:1 / / rw,relatime - ext4 /dev/sda1 rw\n", f);
+        for (unsigned i = 0; i < n; i++)
+                fprintf(f, "%u 20 0:%u / /run/test/%u %s - tmpfs tmpfs%u rw\n",
+                        100 + i, 100 + i, i,
+                        i >= changed_from && i < changed_from + n_changed ? "ro" : "rw", i);
+
+        assert_se(fflush_and_check(f) >= 0);
+        f = safe_fclose(f);
+
+        return TAKE_PTR(buf);
+}
+
+TEST(mount_table_storm) {
+        _cleanup_(mount_table_freep) MountTable *t = NULL;
+        _cleanup_free_ char *a = NULL, *b = NULL;
+        unsigned n = slow_tests_enabled() ? 100000 : 10000;
+        usec_t ts;
+
+        /* Simulates a mount storm: a large table in which only a few entries change at a time */
+
+        assert_se(a = make_mountinfo(n, 0, 0));
+        assert_se(b = make_mountinfo(n, n / 2, 10));
+        assert_se(t = mount_table_new());
+
+        update(t, a, NULL, NULL, NULL);
+        assert_se(mount_table_size(t) == n + 1);
+
+        ts = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < 10; i++) {
+                _cleanup_set_free_ Set *changed = NULL, *new = NULL, *gone = NULL;
+
+                update(t, i % 2 == 0 ? b : a, &changed, &new, &gone);
+                assert_se(set_size(changed) == 10);
+                assert_se(set_size(new) == 10);
+                assert_se(set_size(gone) == 0);
+        }
+
+        log_info("Processed 10 updates of %u mounts with 10 changes each in %s.",
+                 n + 1, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), ts), USEC_PER_MSEC));
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
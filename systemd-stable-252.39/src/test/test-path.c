@@ -11,6 +11,7 @@
 #include "macro.h"
 #include "manager.h"
 #include "mkdir.h"
+#include "path-fanotify.h"
 #include "path-util.h"
 #include "rm-rf.h"
 #include "string-util.h"
@@ -21,9 +22,9 @@
 
 typedef void (*test_function_t)(Manager *m);
 
-static int setup_test(Manager **m) {
-        char **tests_path = STRV_MAKE("exists", "existsglobFOOBAR", "changed", "modified", "unit",
-                                      "directorynotempty", "makedirectory");
+static int setup_test(Manager **m, PathWatchBackend backend) {
+        char **tests_path = STRV_MAKE("exists", "existsglobFOOBAR", "changed", "modified", "modifiedsymlink",
+                                      "modifiedsymlink-target", "unit", "directorynotempty", "makedirectory");
         Manager *tmp = NULL;
         int r;
 
@@ -39,6 +40,9 @@ static int setup_test(Manager **m) {
         assert_se(r >= 0);
         assert_se(manager_startup(tmp, NULL, NULL, NULL) >= 0);
 
+        /* Without privileges this falls back to inotify, which is fine too */
+        tmp->path_watch_backend = backend;
+
         STRV_FOREACH(test_path, tests_path) {
                 _cleanup_free_ char *p = NULL;
 
@@ -275,6 +279,49 @@ static void test_path_modified(Manager *m) {
         assert_se(unit_stop(unit) >= 0);
 }
 
+static void test_path_modified_symlink(Manager *m) {
+        _cleanup_fclose_ FILE *f = NULL;
+        const char *test_path = "/tmp/test-path_modifiedsymlink",
+                *target_dir = "/tmp/test-path_modifiedsymlink-target",
+                *target = "/tmp/test-path_modifiedsymlink-target/file";
+        Unit *unit = NULL;
+        Path *path = NULL;
+        Service *service = NULL;
+
+        assert_se(m);
+
+        /* The target lives in a different directory, so that only watching the target itself catches
+         * modifications of it */
+        assert_se(mkdir_p(target_dir, 0755) >= 0);
+        assert_se(touch(target) >= 0);
+        assert_se(symlink(target, test_path) >= 0);
+
+        assert_se(manager_load_startable_unit_or_warn(m, "path-modifiedsymlink.path", NULL, &unit) >= 0);
+
+        path = PATH(unit);
+        service = service_for_path(m, path, NULL);
+
+        assert_se(unit_start(unit, NULL) >= 0);
+        if (check_states(m, path, service, PATH_WAITING, SERVICE_DEAD) < 0)
+                return;
+
+        f = fopen(target, "w");
+        assert_se(f);
+        fputs("test", f);
+        fflush(f);
+
+        if (check_states(m, path, service, PATH_RUNNING, SERVICE_RUNNING) < 0)
+                return;
+
+        assert_se(unit_stop(UNIT(service)) >= 0);
+        if (check_states(m, path, service, PATH_WAITING, SERVICE_DEAD) < 0)
+                return;
+
+        (void) rm_rf(test_path, REMOVE_ROOT|REMOVE_PHYSICAL);
+        (void) rm_rf(target_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+        assert_se(unit_stop(unit) >= 0);
+}
+
 static void test_path_unit(Manager *m) {
         const char *test_path = "/tmp/test-path_unit";
         Unit *unit = NULL;
@@ -377,6 +424,7 @@ int main(int argc, char *argv[]) {
                 test_path_existsglob,
                 test_path_changed,
                 test_path_modified,
+                test_path_modified_symlink,
                 test_path_unit,
                 test_path_directorynotempty,
                 test_path_makedirectory_directorymode,
@@ -394,18 +442,22 @@ int main(int argc, char *argv[]) {
         assert_se(set_unit_path(test_path) >= 0);
         assert_se(runtime_dir = setup_fake_runtime_dir());
 
-        for (const test_function_t *test = tests; *test; test++) {
-                Manager *m = NULL;
-                int r;
+        for (PathWatchBackend backend = 0; backend < _PATH_WATCH_BACKEND_MAX; backend++) {
+                log_info("Testing with PathWatchBackend=%s", path_watch_backend_to_string(backend));
 
-                /* We create a clean environment for each test */
-                r = setup_test(&m);
-                if (r != 0)
-                        return r;
+                for (const test_function_t *test = tests; *test; test++) {
+                        Manager *m = NULL;
+                        int r;
 
-                (*test)(m);
+                        /* We create a clean environment for each test */
+                        r = setup_test(&m, backend);
+                        if (r != 0)
+                                return r;
 
-                shutdown_test(m);
+                        (*test)(m);
+
+                        shutdown_test(m);
+                }
         }
 
         return 0;
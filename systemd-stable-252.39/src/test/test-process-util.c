@@ -19,6 +19,7 @@
 #include "errno-list.h"
 #include "errno-util.h"
 #include "fd-util.h"
+#include "format-util.h"
 #include "ioprio-util.h"
 #include "log.h"
 #include "macro.h"
@@ -706,6 +707,85 @@ TEST(safe_fork) {
         assert_se(status.si_status == 88);
 }
 
+static int vfork_child(void *userdata) {
+        pid_t *p = ASSERT_PTR(userdata);
+
+        /* We share the address space with the parent, so this is visible there */
+        *p = raw_getpid();
+        return 77;
+}
+
+TEST(safe_vfork) {
+        siginfo_t status;
+        pid_t pid, seen = 0;
+
+        BLOCK_SIGNALS(SIGCHLD);
+
+        assert_se(safe_vfork(vfork_child, &seen, &pid) >= 0);
+        assert_se(pid > 0);
+        assert_se(seen == pid);
+
+        assert_se(wait_for_terminate(pid, &status) >= 0);
+        assert_se(status.si_code == CLD_EXITED);
+        assert_se(status.si_status == 77);
+}
+
+static int vfork_exec_child(void *userdata) {
+        char **argv = ASSERT_PTR(userdata);
+
+        (void) reset_signal_mask();
+        execv(argv[0], argv);
+        return EXIT_FAILURE;
+}
+
+TEST(safe_vfork_measure) {
+        char *argv[] = { (char*) "/bin/true", NULL };
+        size_t size = (slow_tests_enabled() ? 1024U : 128U) * 1024U * 1024U;
+        unsigned iterations = slow_tests_enabled() ? 2000 : 200;
+        _cleanup_free_ uint8_t *ballast = NULL;
+        usec_t t, fork_usec, vfork_usec;
+        siginfo_t status;
+        pid_t pid;
+
+        if (access(argv[0], X_OK) < 0)
+                return (void) log_tests_skipped_errno(errno, "%s is not available", argv[0]);
+
+        /* Make our address space look like the one of a manager with many units loaded, i.e. dirty it, so
+         * that fork() has to copy a lot of page tables, and compare that with the vfork()-style spawn. */
+        ballast = malloc(size);
+        if (!ballast)
+                return (void) log_tests_skipped("Failed to allocate ballast");
+        memset(ballast, 0x55, size);
+
+        BLOCK_SIGNALS(SIGCHLD);
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < iterations; i++) {
+                pid = fork();
+                assert_se(pid >= 0);
+                if (pid == 0)
+                        _exit(vfork_exec_child(argv));
+
+                assert_se(wait_for_terminate(pid, &status) >= 0);
+                assert_se(status.si_code == CLD_EXITED && status.si_status == EXIT_SUCCESS);
+        }
+        fork_usec = now(CLOCK_MONOTONIC) - t;
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < iterations; i++) {
+                assert_se(safe_vfork(vfork_exec_child, argv, &pid) >= 0);
+
+                assert_se(wait_for_terminate(pid, &status) >= 0);
+                assert_se(status.si_code == CLD_EXITED && status.si_status == EXIT_SUCCESS);
+        }
+        vfork_usec = now(CLOCK_MONOTONIC) - t;
+
+        log_info("%s ballast, %u spawns of %s: fork() %.0f/s, safe_vfork() %.0f/s",
+                 FORMAT_BYTES(size), iterations, argv[0],
+                 iterations * (double) USEC_PER_SEC / MAX(fork_usec, 1U),
+                 iterations * (double) USEC_PER_SEC / MAX(vfork_usec, 1U));
+}
+
 TEST(pid_to_ptr) {
         assert_se(PTR_TO_PID(NULL) == 0);
         assert_se(PID_TO_PTR(0) == NULL);
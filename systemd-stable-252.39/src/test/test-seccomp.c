@@ -6,6 +6,7 @@
 #include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/personality.h>
+#include <sys/prctl.h>
 #include <sys/shm.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -32,6 +33,7 @@
 #include "set.h"
 #include "string-util.h"
 #include "tests.h"
+#include "time-util.h"
 #include "tmpfile-util.h"
 #include "virt.h"
 
@@ -876,6 +878,135 @@ TEST(load_syscall_filter_set_raw) {
         assert_se(wait_for_terminate_and_check("syscallrawseccomp", pid, WAIT_LOG) == EXIT_SUCCESS);
 }
 
+static Hashmap* make_access_filter(bool reverse) {
+        Hashmap *s;
+        int ids[] = {
+#if defined __NR_access && __NR_access >= 0
+                __NR_access,
+#endif
+#if defined __NR_faccessat && __NR_faccessat >= 0
+                __NR_faccessat,
+#endif
+#if defined __NR_faccessat2 && __NR_faccessat2 >= 0
+                __NR_faccessat2,
+#endif
+        };
+
+        assert_se(ELEMENTSOF(ids) > 0);
+        assert_se(s = hashmap_new(NULL));
+
+        for (size_t i = 0; i < ELEMENTSOF(ids); i++) {
+                int id = ids[reverse ? ELEMENTSOF(ids) - 1 - i : i];
+
+                assert_se(hashmap_put(s, INT_TO_PTR(id + 1), INT_TO_PTR(-1)) >= 0);
+        }
+
+        return s;
+}
+
+TEST(syscall_filter_cache) {
+        _cleanup_hashmap_free_ Hashmap *cache = NULL, *a = NULL, *b = NULL;
+        const SeccompProgram *p, *q;
+        pid_t pid;
+
+        if (!is_seccomp_available()) {
+                log_notice("Seccomp not available, skipping %s", __func__);
+                return;
+        }
+
+        /* Identical policies are compiled only once, regardless of the order they were built in */
+        assert_se(a = make_access_filter(false));
+        assert_se(b = make_access_filter(true));
+
+        assert_se(seccomp_syscall_filter_cache_get(&cache, SCMP_ACT_ALLOW, a, SCMP_ACT_ERRNO(EUCLEAN), &p) > 0);
+        assert_se(p->n_filters > 0);
+        assert_se(seccomp_syscall_filter_cache_get(&cache, SCMP_ACT_ALLOW, b, SCMP_ACT_ERRNO(EUCLEAN), &q) == 0);
+        assert_se(p == q);
+        assert_se(hashmap_size(cache) == 1);
+
+        assert_se(seccomp_syscall_filter_cache_get(&cache, SCMP_ACT_ALLOW, b, SCMP_ACT_ERRNO(EILSEQ), &q) > 0);
+        assert_se(p != q);
+        assert_se(hashmap_size(cache) == 2);
+
+        assert_se(seccomp_syscall_filter_cache_get(&cache, SCMP_ACT_ALLOW, NULL, SCMP_ACT_ERRNO(EILSEQ), &q) > 0);
+        assert_se(q->n_filters == 0);
+
+        /* The compiled filters behave like the ones loaded directly */
+        pid = fork();
+        assert_se(pid >= 0);
+
+        if (pid == 0) {
+                assert_se(seccomp_syscall_filter_cache_get(&cache, SCMP_ACT_ALLOW, a, SCMP_ACT_ERRNO(EUCLEAN), &p) == 0);
+
+                assert_se(prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) >= 0);
+
+                assert_se(access("/", F_OK) >= 0);
+                assert_se(seccomp_program_load(p) >= 0);
+                assert_se(access("/", F_OK) < 0);
+                assert_se(errno == EUCLEAN);
+                assert_se(poll(NULL, 0, 0) == 0);
+
+                _exit(EXIT_SUCCESS);
+        }
+
+        assert_se(wait_for_terminate_and_check("syscallfiltercache", pid, WAIT_LOG) == EXIT_SUCCESS);
+}
+
+static usec_t spawn_with_filter(Hashmap **cache, Hashmap *filter, unsigned n) {
+        usec_t ts = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < n; i++) {
+                const SeccompProgram *p = NULL;
+                pid_t pid;
+
+                /* Mimic what the service manager does: compile in the parent if there's a cache, in the
+                 * child otherwise */
+                if (cache)
+                        assert_se(seccomp_syscall_filter_cache_get(cache, SCMP_ACT_ERRNO(EPERM), filter, SCMP_ACT_ALLOW, &p) >= 0);
+
+                pid = fork();
+                assert_se(pid >= 0);
+
+                if (pid == 0) {
+                        assert_se(prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) >= 0);
+
+                        if (p)
+                                assert_se(seccomp_program_load(p) >= 0);
+                        else
+                                assert_se(seccomp_load_syscall_filter_set_raw(SCMP_ACT_ERRNO(EPERM), filter, SCMP_ACT_ALLOW, false) >= 0);
+
+                        _exit(EXIT_SUCCESS);
+                }
+
+                assert_se(wait_for_terminate_and_check("syscallfilterspawn", pid, 0) == EXIT_SUCCESS);
+        }
+
+        return usec_sub_unsigned(now(CLOCK_MONOTONIC), ts);
+}
+
+TEST(syscall_filter_spawn_benchmark) {
+        _cleanup_hashmap_free_ Hashmap *cache = NULL, *filter = NULL;
+        unsigned n = slow_tests_enabled() ? 1000 : 100;
+        usec_t uncached, cached;
+
+        if (!is_seccomp_available()) {
+                log_notice("Seccomp not available, skipping %s", __func__);
+                return;
+        }
+
+        assert_se(filter = hashmap_new(NULL));
+        assert_se(seccomp_filter_set_add(filter, true, syscall_filter_set_find("@system-service")) >= 0);
+
+        uncached = spawn_with_filter(NULL, filter, n);
+        cached = spawn_with_filter(&cache, filter, n);
+        assert_se(hashmap_size(cache) == 1);
+
+        log_info("Spawned %u processes with @system-service filter: %s compiling in the child, %s with cached filter.",
+                 n,
+                 FORMAT_TIMESPAN(uncached, USEC_PER_MSEC),
+                 FORMAT_TIMESPAN(cached, USEC_PER_MSEC));
+}
+
 TEST(native_syscalls_filtered) {
         pid_t pid;
 
@@ -8,6 +8,7 @@
 #include "serialize.h"
 #include "strv.h"
 #include "tests.h"
+#include "time-util.h"
 #include "tmpfile-util.h"
 
 static char long_string[LONG_LINE_MAX+1];
@@ -189,6 +190,227 @@ TEST(serialize_environment) {
         assert_se(strv_equal(env, env2));
 }
 
+static void add_text_record(BinarySerializer *s, const char *text) {
+        _cleanup_free_ char *copy = NULL;
+
+        assert_se(copy = strdup(text));
+        assert_se(binary_serializer_add_text(s, copy, strlen(copy)) == !isempty(text));
+}
+
+static void assert_item(BinaryRecord *r, const char *key, const char *value) {
+        const char *k, *v;
+
+        assert_se(binary_record_next(r, &k, &v) == 1);
+        assert_se(streq(k, key));
+        assert_se(streq(v, value));
+}
+
+TEST(binary_serializer) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_(binary_serializer_done) BinarySerializer s = {};
+        _cleanup_(binary_deserializer_done) BinaryDeserializer d = {};
+        _cleanup_free_ char *line = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        BinaryRecord r;
+        const char *name, *k, *v;
+
+        assert_se(fmkostemp_safe(fn, "w+", &f) == 0);
+        log_info("/* %s (%s) */", __func__, fn);
+
+        /* A text section, followed by the binary records */
+        assert_se(serialize_item(f, "a", "bbb") == 1);
+        fputc('\n', f);
+
+        assert_se(binary_serializer_begin(&s, f) == 0);
+        add_text_record(&s, "foo.service\nstate=running\n  spaces = around  \nflag\njob\njob-id=7\n\nx=y=z\n\n");
+        add_text_record(&s, "");
+        add_text_record(&s, "bar.socket\n\n");
+        assert_se(binary_serializer_begin_record(&s) == 0);
+        binary_serializer_add_item(&s, "Key", "");
+        binary_serializer_add_item(&s, "x=y", " z \n");
+        assert_se(binary_serializer_end_record(&s, "direct") == 0);
+        assert_se(binary_serializer_finish(&s) == 0);
+        assert_se(s.n_records == 3);
+
+        rewind(f);
+
+        assert_se(read_line(f, LONG_LINE_MAX, &line) > 0);
+        assert_se(streq(line, "a=bbb"));
+        line = mfree(line);
+        assert_se(read_line(f, LONG_LINE_MAX, &line) > 0);
+        assert_se(isempty(line));
+
+        assert_se(binary_deserializer_open(&d, f) == 1);
+        assert_se(d.n_records == 3);
+        assert_se(fgetc(f) == EOF);
+
+        assert_se(binary_deserializer_next(&d, &name, &r) == 1);
+        assert_se(streq(name, "foo.service"));
+        assert_item(&r, "state", "running");
+        assert_item(&r, "spaces ", " around");
+        assert_item(&r, "flag", "");
+        assert_item(&r, "job", "");
+        assert_item(&r, "job-id", "7");
+        assert_item(&r, "", "");
+        assert_item(&r, "x", "y=z");
+        assert_se(binary_record_next(&r, &k, &v) == 0);
+
+        assert_se(binary_deserializer_next(&d, &name, &r) == 1);
+        assert_se(streq(name, "bar.socket"));
+        assert_se(binary_record_next(&r, &k, &v) == 0);
+
+        /* Items added directly are stored verbatim */
+        assert_se(binary_deserializer_next(&d, &name, &r) == 1);
+        assert_se(streq(name, "direct"));
+        assert_item(&r, "Key", "");
+        assert_item(&r, "x=y", " z \n");
+        assert_se(binary_record_next(&r, &k, &v) == 0);
+
+        assert_se(binary_deserializer_next(&d, &name, &r) == 0);
+}
+
+TEST(binary_serializer_text_fallback) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_(binary_deserializer_done) BinaryDeserializer d = {};
+        _cleanup_free_ char *line = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+
+        assert_se(fmkostemp_safe(fn, "w+", &f) == 0);
+        log_info("/* %s (%s) */", __func__, fn);
+
+        /* Empty and text data must be left alone */
+        assert_se(binary_deserializer_open(&d, f) == 0);
+
+        fputs("foo.service\nstate=running\n\n", f);
+        assert_se(fflush_and_check(f) == 0);
+        rewind(f);
+
+        assert_se(binary_deserializer_open(&d, f) == 0);
+        assert_se(read_line(f, LONG_LINE_MAX, &line) > 0);
+        assert_se(streq(line, "foo.service"));
+}
+
+TEST(binary_serializer_corrupt) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_(binary_serializer_done) BinarySerializer s = {};
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t size;
+
+        assert_se(fmkostemp_safe(fn, "w+", &f) == 0);
+        log_info("/* %s (%s) */", __func__, fn);
+
+        assert_se(binary_serializer_begin(&s, f) == 0);
+        add_text_record(&s, "foo.service\nstate=running\n\n");
+        assert_se(binary_serializer_finish(&s) == 0);
+        size = ftello(f);
+
+        /* The header covers the whole data, hence truncating it anywhere must be refused right away */
+        for (size_t n = size; n-- > 0;) {
+                _cleanup_(binary_deserializer_done) BinaryDeserializer d = {};
+                _cleanup_fclose_ FILE *g = NULL;
+
+                assert_se(ftruncate(fileno(f), n) == 0);
+                assert_se(g = fopen(fn, "re"));
+                assert_se(binary_deserializer_open(&d, g) == (n == 0 ? 0 : -EBADMSG));
+        }
+
+        /* Restore the data, then make the first item claim more data than the record has */
+        rewind(f);
+        binary_serializer_done(&s);
+        assert_se(binary_serializer_begin(&s, f) == 0);
+        add_text_record(&s, "foo.service\nstate=running\n\n");
+        assert_se(binary_serializer_finish(&s) == 0);
+        assert_se(pwrite(fileno(f), (const uint8_t[]) { 0xff }, 1, 32 + 4) == 1);
+
+        _cleanup_(binary_deserializer_done) BinaryDeserializer d = {};
+        _cleanup_fclose_ FILE *g = NULL;
+        BinaryRecord r;
+        const char *name, *k, *v;
+
+        assert_se(g = fopen(fn, "re"));
+        assert_se(binary_deserializer_open(&d, g) == 1);
+        assert_se(binary_deserializer_next(&d, &name, &r) == 1);
+        assert_se(streq(name, "foo.service"));
+        assert_se(binary_record_next(&r, &k, &v) == -EBADMSG);
+}
+
+TEST(binary_serializer_measure) {
+        _cleanup_(unlink_tempfilep) char fn_text[] = "/tmp/test-serialize.XXXXXX", fn_binary[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_(binary_serializer_done) BinarySerializer s = {};
+        _cleanup_(binary_deserializer_done) BinaryDeserializer d = {};
+        _cleanup_fclose_ FILE *text = NULL, *binary = NULL;
+        size_t n_units = slow_tests_enabled() ? 50000 : 5000, n_text = 0, n_binary = 0;
+        usec_t t;
+
+        /* Compares the time it takes to split a synthetic set of unit serializations into key/value pairs,
+         * once from the text format and once from the binary one. */
+
+        assert_se(fmkostemp_safe(fn_text, "w+", &text) == 0);
+        assert_se(fmkostemp_safe(fn_binary, "w+", &binary) == 0);
+        assert_se(binary_serializer_begin(&s, binary) == 0);
+
+        for (size_t i = 0; i < n_units; i++) {
+                _cleanup_free_ char *buf = NULL;
+                _cleanup_fclose_ FILE *m = NULL;
+                size_t sz = 0;
+
+                assert_se(m = open_memstream_unlocked(&buf, &sz));
+
+                fprintf(m, "synthetic-%zu.service\n", i);
+                for (unsigned j = 0; j < 32; j++)
+                        fprintf(m, "synthetic-key-%u=" USEC_FMT " " USEC_FMT "\n", j, now(CLOCK_REALTIME), now(CLOCK_MONOTONIC));
+                fputc('\n', m);
+                assert_se(fflush_and_check(m) == 0);
+
+                fwrite(buf, sz, 1, text);
+                assert_se(binary_serializer_add_text(&s, buf, sz) == 1);
+        }
+
+        assert_se(fflush_and_check(text) == 0);
+        assert_se(binary_serializer_finish(&s) == 0);
+        rewind(text);
+        rewind(binary);
+
+        t = now(CLOCK_MONOTONIC);
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+                char *l;
+                int r;
+
+                r = read_line(text, LONG_LINE_MAX, &line);
+                assert_se(r >= 0);
+                if (r == 0)
+                        break;
+
+                l = strstrip(line);
+                l[strcspn(l, "=")] = 0;
+                n_text += !isempty(l);
+        }
+        log_info("text:   %zu lines in %s", n_text, FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - t, 1));
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(binary_deserializer_open(&d, binary) == 1);
+        for (;;) {
+                const char *name, *k, *v;
+                BinaryRecord r;
+                int q;
+
+                q = binary_deserializer_next(&d, &name, &r);
+                assert_se(q >= 0);
+                if (q == 0)
+                        break;
+
+                n_binary++;
+                while ((q = binary_record_next(&r, &k, &v)) > 0)
+                        n_binary++;
+                assert_se(q == 0);
+        }
+        log_info("binary: %zu items in %s", n_binary, FORMAT_TIMESPAN(now(CLOCK_MONOTONIC) - t, 1));
+
+        assert_se(n_text == n_binary);
+        assert_se(n_binary == n_units * 33);
+}
+
 static int intro(void) {
         memset(long_string, 'x', sizeof(long_string)-1);
         char_array_0(long_string);
@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdlib.h>
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "random-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tzfile.h"
+
+static void assert_tm_equal(const struct tm *a, const struct tm *b) {
+        assert_se(a->tm_year == b->tm_year);
+        assert_se(a->tm_mon == b->tm_mon);
+        assert_se(a->tm_mday == b->tm_mday);
+        assert_se(a->tm_hour == b->tm_hour);
+        assert_se(a->tm_min == b->tm_min);
+        assert_se(a->tm_sec == b->tm_sec);
+        assert_se(a->tm_wday == b->tm_wday);
+        assert_se(a->tm_yday == b->tm_yday);
+        assert_se(a->tm_isdst == b->tm_isdst);
+        assert_se(a->tm_gmtoff == b->tm_gmtoff);
+        assert_se(streq(a->tm_zone, b->tm_zone));
+}
+
+static void test_tzfile_one(const char *timezone) {
+        _cleanup_(tzfile_freep) TZFile *tz = NULL;
+        int offset = 0;
+        int r;
+
+        log_info("/* %s(%s) */", __func__, timezone);
+
+        r = tzfile_load(timezone, &tz);
+        if (r == -ENOENT) {
+                log_tests_skipped("timezone data is not installed");
+                return;
+        }
+        assert_se(r >= 0);
+
+        assert_se(setenv("TZ", strjoina(":", timezone), 1) >= 0);
+        tzset();
+
+        /* glibc's mktime() starts with the UTC offset of the previous call, let's start out the same */
+        {
+                struct tm a = { .tm_year = 70, .tm_mday = 1, .tm_isdst = -1 }, b = a;
+
+                assert_se(mktime(&a) == tzfile_mktime(tz, &b, &offset));
+        }
+
+        for (unsigned i = 0; i < 20000; i++) {
+                time_t t = (time_t) (random_u64_range(300ULL * 365 * 24 * 3600)) - 70LL * 365 * 24 * 3600;
+                struct tm a, b;
+
+                assert_se(localtime_r(&t, &a));
+                assert_se(tzfile_localtime(tz, t, &b));
+                assert_tm_equal(&a, &b);
+        }
+
+        /* Mostly around the usual times of DST transitions, with and without a DST flag, and fields that
+         * need to be normalized */
+        for (unsigned i = 0; i < 20000; i++) {
+                struct tm a = {
+                        .tm_year = 70 + (int) random_u64_range(230),
+                        .tm_mon = (int) random_u64_range(14) - 1,
+                        .tm_mday = (int) random_u64_range(33),
+                        .tm_hour = (int) random_u64_range(6) - 1,
+                        .tm_min = (int) random_u64_range(62) - 1,
+                        .tm_sec = (int) random_u64_range(62) - 1,
+                        .tm_isdst = (int) random_u64_range(3) - 1,
+                }, b = a;
+                time_t x, y;
+
+                x = mktime(&a);
+                y = tzfile_mktime(tz, &b, &offset);
+                assert_se(x == y);
+                if (x != (time_t) -1)
+                        assert_tm_equal(&a, &b);
+        }
+
+        assert_se(unsetenv("TZ") >= 0);
+        tzset();
+}
+
+TEST(tzfile_matches_glibc) {
+        test_tzfile_one("Europe/Berlin");
+        test_tzfile_one("Europe/Dublin");
+        test_tzfile_one("America/New_York");
+        test_tzfile_one("America/Santiago");
+        test_tzfile_one("Australia/Lord_Howe");
+        test_tzfile_one("Pacific/Auckland");
+        test_tzfile_one("Pacific/Apia");
+        test_tzfile_one("Asia/Kolkata");
+        test_tzfile_one("Etc/GMT+5");
+}
+
+TEST(tzfile_parse) {
+        _cleanup_free_ char *data = NULL;
+        TZFile *tz;
+        size_t size;
+
+        assert_se(tzfile_parse("", 0, &tz) == -EBADMSG);
+        assert_se(tzfile_parse("TZif", 4, &tz) == -EBADMSG);
+
+        if (read_full_file("/usr/share/zoneinfo/Europe/Berlin", &data, &size) < 0) {
+                log_tests_skipped("timezone data is not installed");
+                return;
+        }
+
+        assert_se(tzfile_parse(data, size, &tz) >= 0);
+        tzfile_free(tz);
+
+        /* Truncated files are refused */
+        for (size_t i = 0; i < size / 2; i++)
+                assert_se(tzfile_parse(data, i, &tz) < 0);
+
+        /* So are broken footers */
+        data[size - 2] = '!';
+        assert_se(tzfile_parse(data, size, &tz) == -EINVAL);
+        data[size - 1] = '!';
+        assert_se(tzfile_parse(data, size, &tz) == -EBADMSG);
+}
+
+DEFINE_TEST_MAIN(LOG_INFO);
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "cgroup.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "manager.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "service.h"
+#include "strv.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+#include "unit-compact.h"
+#include "unit.h"
+
+static void check_settings(Service *s) {
+        ExecCommand *c;
+
+        assert_se(strv_equal(s->exec_context.environment, STRV_MAKE("FOO=1", "BAR=2")));
+        assert_se(s->exec_context.nice_set);
+        assert_se(s->exec_context.nice == 5);
+        assert_se(s->cgroup_context.cpu_weight == 50);
+        assert_se(streq_ptr(s->pid_file, "/run/compact-test.pid"));
+
+        c = s->exec_command[SERVICE_EXEC_START];
+        assert_se(c);
+        assert_se(!c->command_next);
+        assert_se(streq(c->path, "/bin/true"));
+        assert_se(strv_equal(c->argv, STRV_MAKE("/bin/true", "foo")));
+
+        c = s->exec_command[SERVICE_EXEC_STOP_POST];
+        assert_se(c);
+        assert_se(streq(c->path, "/bin/false"));
+}
+
+TEST_RET(unit_compact) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL, *unit_dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        _cleanup_free_ char *p = NULL;
+        Service *s;
+        usec_t stamp;
+        Unit *u;
+        int r;
+
+        r = enter_cgroup_subroot(NULL);
+        if (r == -ENOMEDIUM)
+                return log_tests_skipped("cgroupfs not available");
+
+        assert_se(mkdtemp_malloc("/tmp/test-unit-compact-XXXXXX", &unit_dir) >= 0);
+
+        assert_se(p = path_join(unit_dir, "compact-test.service"));
+        assert_se(write_string_file(p,
+                                    "[Unit]\n"
+                                    "Description=Compaction test\n"
+                                    "[Service]\n"
+                                    "Type=oneshot\n"
+                                    "PIDFile=/run/compact-test.pid\n"
+                                    "ExecStart=/bin/true foo\n"
+                                    "ExecStopPost=/bin/false\n"
+                                    "Environment=FOO=1\n"
+                                    "CPUWeight=50\n",
+                                    WRITE_STRING_FILE_CREATE) >= 0);
+
+        p = mfree(p);
+        assert_se(p = path_join(unit_dir, "compact-test.service.d/override.conf"));
+        assert_se(write_string_file(p,
+                                    "[Service]\n"
+                                    "Environment=BAR=2\n"
+                                    "Nice=5\n",
+                                    WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_MKDIR_0755) >= 0);
+
+        assert_se(set_unit_path(unit_dir) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+
+        r = manager_new(LOOKUP_SCOPE_USER, MANAGER_TEST_RUN_BASIC, &m);
+        if (manager_errno_skip_test(r))
+                return log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL, NULL) >= 0);
+
+        assert_se(manager_load_startable_unit_or_warn(m, "compact-test.service", NULL, &u) >= 0);
+        s = SERVICE(u);
+        check_settings(s);
+
+        /* Names, dependencies and settings outside of the private section stay around */
+        assert_se(unit_compact(u) > 0);
+        assert_se(u->compacted);
+        assert_se(unit_compact(u) == 0);
+        assert_se(u->load_state == UNIT_LOADED);
+        assert_se(streq(unit_description(u), "Compaction test"));
+        assert_se(s->type == SERVICE_ONESHOT);
+
+        assert_se(!s->exec_context.environment);
+        assert_se(!s->exec_context.nice_set);
+        assert_se(s->cgroup_context.cpu_weight == CGROUP_WEIGHT_INVALID);
+        assert_se(!s->pid_file);
+        assert_se(!s->exec_command[SERVICE_EXEC_START]);
+
+        /* Reading the settings back in yields the same as loading the unit in the first place */
+        assert_se(unit_expand(u) > 0);
+        assert_se(!u->compacted);
+        assert_se(u->compacted_size == 0);
+        assert_se(unit_expand(u) == 0);
+        check_settings(s);
+
+        /* Units whose commands ran keep their exit statuses, and hence their commands */
+        dual_timestamp_get(&s->exec_command[SERVICE_EXEC_START]->exec_status.start_timestamp);
+        assert_se(unit_compact(u) == 0);
+        assert_se(!u->compacted);
+        check_settings(s);
+        s->exec_command[SERVICE_EXEC_START]->exec_status = (ExecStatus) {};
+
+        /* Settings are read back in from the unit files as they were loaded, even if they changed since */
+        assert_se(unit_compact(u) > 0);
+        assert_se(u->compacted_files);
+        assert_se(write_string_file(p,
+                                    "[Service]\n"
+                                    "Environment=BAR=3\n"
+                                    "Nice=7\n",
+                                    WRITE_STRING_FILE_TRUNCATE) >= 0);
+        stamp = now(CLOCK_REALTIME) + USEC_PER_SEC;
+        assert_se(touch_file(p, false, stamp, UID_INVALID, GID_INVALID, MODE_INVALID) >= 0);
+        assert_se(unit_expand(u) > 0);
+        assert_se(!u->compacted_files);
+        check_settings(s);
+
+        /* … but units whose unit files changed are not compacted anymore */
+        assert_se(unit_need_daemon_reload(u));
+        assert_se(unit_compact(u) == 0);
+        assert_se(!u->compacted);
+        u->dropin_mtime = stamp;
+
+        /* Units with a job queued stay as they are */
+        assert_se(manager_add_job(m, JOB_START, u, JOB_REPLACE, NULL, NULL, NULL) >= 0);
+        assert_se(unit_compact(u) == 0);
+        assert_se(!u->compacted);
+        check_settings(s);
+
+        return 0;
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
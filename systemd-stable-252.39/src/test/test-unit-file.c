@@ -1,10 +1,16 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include "fileio.h"
+#include "fs-util.h"
+#include "mkdir.h"
 #include "path-lookup.h"
+#include "path-util.h"
+#include "rm-rf.h"
 #include "set.h"
 #include "special.h"
 #include "strv.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 #include "unit-file.h"
 
 TEST(unit_validate_alias_symlink_and_warn) {
@@ -85,6 +91,99 @@ TEST(unit_file_build_name_map) {
         }
 }
 
+static void set_mtime_in_past(const char *path, usec_t ago) {
+        struct timespec ts[2];
+
+        timespec_store(&ts[0], now(CLOCK_REALTIME) - ago);
+        ts[1] = ts[0];
+        assert_se(utimensat(AT_FDCWD, path, ts, AT_SYMLINK_NOFOLLOW) >= 0);
+}
+
+static void assert_name_maps_equal(Hashmap *ids_a, Hashmap *names_a, Set *paths_a,
+                                   Hashmap *ids_b, Hashmap *names_b, Set *paths_b) {
+        const char *k, *v, *p;
+        char **l;
+
+        assert_se(hashmap_size(ids_a) == hashmap_size(ids_b));
+        HASHMAP_FOREACH_KEY(v, k, ids_a)
+                assert_se(streq_ptr(hashmap_get(ids_b, k), v));
+
+        assert_se(hashmap_size(names_a) == hashmap_size(names_b));
+        HASHMAP_FOREACH_KEY(l, k, names_a) {
+                _cleanup_strv_free_ char **x = NULL, **y = NULL;
+
+                assert_se(x = strv_copy(l));
+                assert_se(y = strv_copy(hashmap_get(names_b, k)));
+                assert_se(strv_equal(strv_sort(x), strv_sort(y)));
+        }
+
+        assert_se(set_size(paths_a) == set_size(paths_b));
+        SET_FOREACH(p, paths_a)
+                assert_se(set_contains(paths_b, p));
+}
+
+TEST(unit_file_build_name_map_dir_cache) {
+        _cleanup_(rm_rf_physical_and_freep) char *root = NULL;
+        _cleanup_(lookup_paths_free) LookupPaths lp = {};
+        _cleanup_(unit_file_dir_cache_freep) UnitFileDirCache *cache = NULL;
+        _cleanup_hashmap_free_ Hashmap *ids = NULL, *names = NULL, *cached_ids = NULL, *cached_names = NULL;
+        _cleanup_set_free_free_ Set *paths = NULL, *cached_paths = NULL;
+        const char *etc, *p;
+
+        assert_se(mkdtemp_malloc("/tmp/test-unit-file-XXXXXX", &root) >= 0);
+
+        etc = prefix_roota(root, "/etc/systemd/system");
+        assert_se(mkdir_p(etc, 0755) >= 0);
+
+        p = strjoina(etc, "/a.service");
+        assert_se(write_string_file(p, "[Service]\nExecStart=/bin/true", WRITE_STRING_FILE_CREATE) >= 0);
+        p = strjoina(etc, "/b.service");
+        assert_se(symlink("a.service", p) >= 0);
+        p = strjoina(etc, "/a.service.d");
+        assert_se(mkdir(p, 0755) >= 0);
+        p = strjoina(etc, "/multi-user.target.wants");
+        assert_se(mkdir(p, 0755) >= 0);
+        set_mtime_in_past(etc, 10 * USEC_PER_SEC);
+
+        assert_se(lookup_paths_init(&lp, LOOKUP_SCOPE_SYSTEM, 0, root) >= 0);
+
+        assert_se(unit_file_build_name_map(&lp, NULL, &ids, &names, &paths) == 1);
+        assert_se(streq_ptr(hashmap_get(ids, "b.service"), "a.service"));
+
+        /* The first build with an empty cache reads everything */
+        assert_se(unit_file_build_name_map_full(&lp, NULL, &cached_ids, &cached_names, &cached_paths, &cache) == 1);
+        assert_se(cache);
+        assert_se(cache->n_reused == 0);
+        assert_se(cache->n_dirs == strv_length(lp.search_path));
+        assert_name_maps_equal(ids, names, paths, cached_ids, cached_names, cached_paths);
+
+        /* The second one takes everything from the cache */
+        assert_se(unit_file_build_name_map_full(&lp, NULL, &cached_ids, &cached_names, &cached_paths, &cache) == 1);
+        assert_se(cache->n_reused == strv_length(lp.search_path));
+        assert_name_maps_equal(ids, names, paths, cached_ids, cached_names, cached_paths);
+
+        /* A new file changes the mtime of the directory, hence it is read again */
+        p = strjoina(etc, "/c.service");
+        assert_se(symlink("a.service", p) >= 0);
+        set_mtime_in_past(etc, 5 * USEC_PER_SEC);
+
+        assert_se(unit_file_build_name_map(&lp, NULL, &ids, &names, &paths) == 1);
+        assert_se(streq_ptr(hashmap_get(ids, "c.service"), "a.service"));
+
+        assert_se(unit_file_build_name_map_full(&lp, NULL, &cached_ids, &cached_names, &cached_paths, &cache) == 1);
+        assert_se(cache->n_reused == strv_length(lp.search_path) - 1);
+        assert_name_maps_equal(ids, names, paths, cached_ids, cached_names, cached_paths);
+
+        /* Recently modified directories are not kept in the cache, since they might change again within the
+         * granularity of the timestamps */
+        set_mtime_in_past(etc, 0);
+        assert_se(unit_file_build_name_map_full(&lp, NULL, &cached_ids, &cached_names, &cached_paths, &cache) == 1);
+        assert_se(cache->n_dirs == strv_length(lp.search_path) - 1);
+        assert_se(unit_file_build_name_map_full(&lp, NULL, &cached_ids, &cached_names, &cached_paths, &cache) == 1);
+        assert_se(cache->n_reused == strv_length(lp.search_path) - 1);
+        assert_name_maps_equal(ids, names, paths, cached_ids, cached_names, cached_paths);
+}
+
 TEST(runlevel_to_target) {
         in_initrd_force(false);
         assert_se(streq_ptr(runlevel_to_target(NULL), NULL));
@@ -10,6 +10,7 @@
 #include "json.h"
 #include "rm-rf.h"
 #include "strv.h"
+#include "tests.h"
 #include "tmpfile-util.h"
 #include "user-util.h"
 #include "varlink.h"
@@ -167,6 +168,146 @@ static void *thread(void *arg) {
         return NULL;
 }
 
+typedef struct PipelineTest {
+        const char *method;
+        unsigned n_calls;
+        unsigned n_sent;
+        unsigned n_replies;
+        bool pipelined;
+} PipelineTest;
+
+typedef struct DelayedReply {
+        Varlink *link;
+        unsigned index;
+} DelayedReply;
+
+static int method_echo(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        return varlink_replyb(link, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("index", JSON_BUILD_VARIANT(json_variant_by_key(parameters, "index")))));
+}
+
+static int delayed_reply(sd_event_source *s, uint64_t usec, void *userdata) {
+        DelayedReply *d = userdata;
+
+        assert_se(varlink_replyb(d->link, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("index", JSON_BUILD_UNSIGNED(d->index)))) >= 0);
+
+        varlink_unref(d->link);
+        free(d);
+        return 0;
+}
+
+static int method_delayed(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        DelayedReply *d;
+        uint64_t delay;
+
+        /* Replies after the requested delay, so that the method call stays pending in the meantime */
+
+        delay = json_variant_unsigned(json_variant_by_key(parameters, "delayUSec"));
+        if (delay == 0)
+                return method_echo(link, parameters, flags, userdata);
+
+        assert_se(d = new(DelayedReply, 1));
+        *d = (DelayedReply) {
+                .link = varlink_ref(link),
+                .index = json_variant_unsigned(json_variant_by_key(parameters, "index")),
+        };
+
+        assert_se(sd_event_add_time_relative(varlink_get_event(link), NULL, CLOCK_MONOTONIC, delay, 1, delayed_reply, d) >= 0);
+        return 0;
+}
+
+static int pipeline_invoke(Varlink *link, PipelineTest *t) {
+        uint64_t delay;
+
+        /* Later calls complete earlier, and every third one is replied to right away, so that the server
+         * has to reorder the replies if it dispatches the calls concurrently. */
+        delay = t->n_sent % 3 == 0 ? 0 : (t->n_calls - t->n_sent) * 10 + USEC_PER_MSEC;
+
+        return varlink_invokeb(link, t->method,
+                               JSON_BUILD_OBJECT(JSON_BUILD_PAIR("index", JSON_BUILD_UNSIGNED(t->n_sent++)),
+                                                 JSON_BUILD_PAIR("delayUSec", JSON_BUILD_UNSIGNED(delay))));
+}
+
+static int pipeline_reply(Varlink *link, JsonVariant *parameters, const char *error_id, VarlinkReplyFlags flags, void *userdata) {
+        PipelineTest *t = ASSERT_PTR(userdata);
+
+        assert_se(!error_id);
+
+        /* Replies have to arrive in the order the calls were issued in */
+        assert_se(json_variant_unsigned(json_variant_by_key(parameters, "index")) == t->n_replies);
+
+        if (++t->n_replies == t->n_calls)
+                return sd_event_exit(varlink_get_event(link), EXIT_SUCCESS);
+
+        if (!t->pipelined)
+                assert_se(pipeline_invoke(link, t) >= 0);
+
+        return 0;
+}
+
+static void test_pipeline_one(const char *method, unsigned n_calls, bool pipelined, VarlinkServerFlags flags) {
+        _cleanup_(varlink_server_unrefp) VarlinkServer *s = NULL;
+        _cleanup_(varlink_flush_close_unrefp) Varlink *c = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        int fds[2];
+        usec_t ts;
+        PipelineTest t = {
+                .method = method,
+                .n_calls = n_calls,
+                .pipelined = pipelined,
+        };
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(varlink_server_new(&s, flags) >= 0);
+        assert_se(varlink_server_bind_method(s, "io.test.Echo", method_echo) >= 0);
+        assert_se(varlink_server_bind_method(s, "io.test.Delayed", method_delayed) >= 0);
+        assert_se(varlink_server_attach_event(s, e, 0) >= 0);
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, fds) >= 0);
+        assert_se(varlink_server_add_connection(s, fds[0], NULL) >= 0);
+        assert_se(varlink_connect_fd(&c, fds[1]) >= 0);
+        assert_se(varlink_bind_reply(c, pipeline_reply) >= 0);
+        varlink_set_userdata(c, &t);
+        assert_se(varlink_attach_event(c, e, 0) >= 0);
+
+        ts = now(CLOCK_MONOTONIC);
+
+        do
+                assert_se(pipeline_invoke(c, &t) >= 0);
+        while (pipelined && t.n_sent < n_calls);
+
+        assert_se(sd_event_loop(e) == EXIT_SUCCESS);
+        assert_se(t.n_replies == n_calls);
+
+        ts = usec_sub_unsigned(now(CLOCK_MONOTONIC), ts);
+        log_info("%s, %s%s: %u calls in %s, %.0f calls/s",
+                 method,
+                 pipelined ? "pipelined" : "one by one",
+                 FLAGS_SET(flags, VARLINK_SERVER_CONCURRENT) ? ", concurrent dispatch" : "",
+                 n_calls, FORMAT_TIMESPAN(ts, USEC_PER_MSEC),
+                 (double) n_calls * USEC_PER_SEC / MAX(ts, (usec_t) 1));
+}
+
+static void test_pipeline(void) {
+        unsigned n = slow_tests_enabled() ? 100000 : 1000;
+        int saved_max_level;
+
+        /* Debug logging of each message would dominate the measurements */
+        saved_max_level = log_get_max_level();
+        log_set_max_level(LOG_INFO);
+
+        test_pipeline_one("io.test.Echo", n, false, 0);
+        test_pipeline_one("io.test.Echo", n, true, 0);
+        test_pipeline_one("io.test.Echo", n, true, VARLINK_SERVER_CONCURRENT);
+
+        n = slow_tests_enabled() ? 1000 : 100;
+        test_pipeline_one("io.test.Delayed", n, false, 0);
+        test_pipeline_one("io.test.Delayed", n, true, 0);
+        test_pipeline_one("io.test.Delayed", n, true, VARLINK_SERVER_CONCURRENT);
+
+        log_set_max_level(saved_max_level);
+}
+
 static int block_fd_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         char c;
 
@@ -198,6 +339,8 @@ int main(int argc, char *argv[]) {
         log_set_max_level(LOG_DEBUG);
         log_open();
 
+        test_pipeline();
+
         assert_se(mkdtemp_malloc("/tmp/varlink-test-XXXXXX", &tmpdir) >= 0);
         sp = strjoina(tmpdir, "/socket");
 
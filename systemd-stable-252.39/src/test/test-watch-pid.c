@@ -1,10 +1,15 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "log.h"
 #include "manager.h"
+#include "process-util.h"
 #include "rm-rf.h"
 #include "service.h"
 #include "tests.h"
+#include "time-util.h"
 
 int main(int argc, char *argv[]) {
         _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
@@ -86,5 +91,46 @@ int main(int argc, char *argv[]) {
         unit_unwatch_pid(c, 4711);
         assert_se(manager_get_unit_by_pid(m, 4711) == NULL);
 
+        /* Now spawn lots of short-lived children, and make sure they are all picked up and reaped via their
+         * pidfds. Note that in test mode the manager doesn't handle SIGCHLD, so nothing else would reap
+         * them. */
+        assert_se(hashmap_isempty(m->watch_pids));
+        if (m->pidfd_unsupported)
+                return 0;
+
+        unsigned n_children = slow_tests_enabled() ? 100000 : 1000, n_spawned = 0;
+        usec_t start = now(CLOCK_MONOTONIC);
+
+        while (n_spawned < n_children || !hashmap_isempty(m->watch_pids)) {
+                /* Keep a limited number of children around at the same time, so that we don't run out of
+                 * PIDs */
+                while (n_spawned < n_children && hashmap_size(m->watch_pids) < 500) {
+                        pid_t pid;
+
+                        pid = fork();
+                        assert_se(pid >= 0);
+                        if (pid == 0)
+                                _exit(EXIT_SUCCESS);
+
+                        assert_se(unit_watch_pid(a, pid, true) >= 0);
+                        assert_se(hashmap_contains(m->watch_pidfds, PID_TO_PTR(pid)) || m->pidfd_unsupported);
+                        n_spawned++;
+                }
+
+                if (m->pidfd_unsupported)
+                        break;
+
+                assert_se(sd_event_run(m->event, 5 * USEC_PER_SEC) > 0);
+        }
+
+        if (!m->pidfd_unsupported) {
+                log_info("Spawned and reaped %u children in %s.",
+                         n_children, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), start), USEC_PER_MSEC));
+
+                assert_se(set_isempty(a->pids));
+                assert_se(hashmap_isempty(m->watch_pidfds));
+                assert_se(waitid(P_ALL, 0, &(siginfo_t) {}, WEXITED|WNOHANG) < 0 && errno == ECHILD);
+        }
+
         return 0;
 }
@@ -46,4 +46,90 @@ systemctl is-active test12.socket
 echo D | nc -w1 -U /run/test12.socket
 [[ "$(stat --format='%G' /run/test12.socket)" == adm ]]
 
+systemctl stop test12.socket
+
+# AcceptPool=: compare connection latency of an echo service with and without pre-spawned instances
+if command -v python3 >/dev/null; then
+    cat >/run/test12-echo.py <<EOF
+import socket, sys
+s = socket.socket(fileno=0)
+if s.type == socket.SOCK_SEQPACKET:
+    # An idle pooled instance: wait for the connection socket, exit on EOF
+    _, fds, _, _ = socket.recv_fds(s, 1, 1)
+    if not fds:
+        sys.exit(0)
+    s = socket.socket(fileno=fds[0])
+# Record which instance served the connection
+with open("/run/test12-echo.log", "a") as f:
+    f.write(sys.argv[1] + "\n")
+while True:
+    d = s.recv(4096)
+    if not d:
+        break
+    s.sendall(d)
+EOF
+
+    cat >/run/test12-echo-client.py <<EOF
+import socket, sys, time
+start = time.monotonic()
+for i in range(int(sys.argv[1])):
+    s = socket.socket(socket.AF_UNIX)
+    s.connect("/run/test12-echo.socket")
+    s.sendall(str(i).encode())
+    assert s.recv(64) == str(i).encode()
+    s.close()
+print(f"{(time.monotonic() - start) * 1000:.0f}ms")
+EOF
+
+    cat >/run/systemd/system/test12-echo@.service <<EOF
+[Service]
+StandardInput=socket
+StandardOutput=journal
+ExecStart=python3 /run/test12-echo.py %i
+EOF
+
+    for pool in 0 4; do
+        cat >/run/systemd/system/test12-echo.socket <<EOF
+[Socket]
+Accept=yes
+ListenStream=/run/test12-echo.socket
+AcceptPool=$pool
+EOF
+        systemctl daemon-reload
+        systemctl start test12-echo.socket
+        [[ "$(systemctl show -P AcceptPool test12-echo.socket)" == "$pool" ]]
+        # Give the pooled instances a moment to start up
+        sleep 2
+
+        rm -f /run/test12-echo.log
+        accepted="$(systemctl show -P NAccepted test12-echo.socket)"
+        echo "AcceptPool=$pool: 100 connections took $(python3 /run/test12-echo-client.py 100)"
+        [[ "$(systemctl show -P NRefused test12-echo.socket)" == 0 ]]
+        [[ "$(systemctl show -P NAccepted test12-echo.socket)" == "$((accepted + 100))" ]]
+        [[ "$(wc -l </run/test12-echo.log)" == 100 ]]
+
+        if [[ "$pool" == 0 ]]; then
+            (! grep -q '^pool-' /run/test12-echo.log)
+        else
+            # At least the instances spawned ahead of time served connections
+            (( $(grep -c '^pool-' /run/test12-echo.log) >= pool ))
+
+            # The pool is refilled after a reload, the old idle instances see EOF and exit
+            systemctl daemon-reload
+            sleep 2
+            rm -f /run/test12-echo.log
+            python3 /run/test12-echo-client.py 10
+            (( $(grep -c '^pool-' /run/test12-echo.log) > 0 ))
+        fi
+
+        systemctl stop test12-echo.socket
+        # Stopping the socket unit also stops the idle instances
+        timeout 30 bash -c 'while systemctl list-units --no-legend "test12-echo@*" | grep -q .; do sleep .5; done'
+    done
+
+    rm -f /run/systemd/system/test12-echo.socket /run/systemd/system/test12-echo@.service
+    rm -f /run/test12-echo.py /run/test12-echo-client.py /run/test12-echo.log
+    systemctl daemon-reload
+fi
+
 touch /testok
@@ -13,6 +13,44 @@ test_scope_unpriv_delegation() {
             -w /sys/fs/cgroup/workload.slice/test-workload0.scope/cgroup.subtree_control
 }
 
+accounting_snapshot() {
+    busctl call --json=short \
+           org.freedesktop.systemd1 \
+           /org/freedesktop/systemd1 \
+           org.freedesktop.systemd1.Manager \
+           GetAccountingSnapshot st "$@"
+}
+
+test_accounting_snapshot() {
+    local generation
+
+    trap "systemctl stop test-accounting.slice" RETURN
+
+    # Leaves an empty slice behind, that has nothing to report until something runs in it again
+    systemd-run --wait --unit=test-accounting-0.service --slice=test-accounting.slice -p TasksAccounting=yes true
+
+    accounting_snapshot test-accounting.slice 0 >/tmp/snapshot
+    jq -e '.data[1] | length == 1' /tmp/snapshot
+    jq -e '.data[1][0][0] == "test-accounting.slice"' /tmp/snapshot
+    generation="$(jq '.data[0]' /tmp/snapshot)"
+
+    accounting_snapshot test-accounting.slice "$generation" >/tmp/snapshot
+    jq -e '.data[1] | length == 0' /tmp/snapshot
+    jq -e ".data[0] > $generation" /tmp/snapshot
+
+    # The CPU time used below the slice shows up again
+    systemd-run --wait --unit=test-accounting-1.service --slice=test-accounting.slice \
+                sh -c 'for i in $(seq 1000); do :; done'
+
+    accounting_snapshot "" "$generation" >/tmp/snapshot
+    jq -e '.data[1] | map(.[0]) | index("test-accounting.slice") != null' /tmp/snapshot
+
+    # Unknown units are refused
+    (! accounting_snapshot test-accounting-nonexistent.slice 0)
+
+    rm -f /tmp/snapshot
+}
+
 if grep -q cgroup2 /proc/filesystems ; then
     systemd-run --wait --unit=test-0.service -p "DynamicUser=1" -p "Delegate=" \
                 test -w /sys/fs/cgroup/system.slice/test-0.service/ -a \
@@ -45,6 +83,9 @@ if grep -q cgroup2 /proc/filesystems ; then
     # Check that unprivileged delegation works for scopes
     test_scope_unpriv_delegation
 
+    # Check that accounting snapshots only report what changed
+    test_accounting_snapshot
+
 else
     echo "Skipping TEST-19-DELEGATE, as the kernel doesn't actually support cgroup v2" >&2
 fi
@@ -58,6 +58,44 @@ busctl call \
         /usr/bin/sleep 2 /usr/bin/sleep 1 true \
     0)
 
+# Sandboxed services with identical settings reuse the mount namespace of the first one as template. As a
+# baseline, run services first that differ in one path each, so that none of them can reuse a template.
+mkdir -p /tmp/mntns-template
+start=$(date +%s%N)
+for i in {1..20}; do
+    mkdir -p "/tmp/mntns-baseline/$i"
+    systemd-run --wait --pipe --unit="mntns-baseline-$i.service" \
+        -p ProtectSystem=strict -p ProtectHome=yes -p ReadWritePaths="/tmp/mntns-template /tmp/mntns-baseline/$i" \
+        bash -xec "test ! -w /usr; touch /tmp/mntns-baseline/$i/ok"
+done
+echo "20 sandboxed services without templates took $(( ($(date +%s%N) - start) / 1000000 ))ms"
+test "$(ls /tmp/mntns-baseline/*/ok | wc -l)" -eq 20
+
+# Make sure the copies behave like freshly built namespaces and are isolated from each other
+start=$(date +%s%N)
+for i in {1..20}; do
+    systemd-run --wait --pipe --unit="mntns-template-$i.service" \
+        -p ProtectSystem=strict -p ProtectHome=yes -p ReadWritePaths=/tmp/mntns-template \
+        bash -xec "test ! -w /usr; touch /tmp/mntns-template/$i; mount -t tmpfs tmpfs /tmp/mntns-template; touch /tmp/mntns-template/leak"
+done
+echo "20 sandboxed services with templates took $(( ($(date +%s%N) - start) / 1000000 ))ms"
+test "$(ls /tmp/mntns-template | wc -l)" -eq 20
+test ! -e /tmp/mntns-template/leak
+
+# Only the services with identical settings reused a template, starting with the second one
+journalctl --sync
+test "$(journalctl -b -q -u 'mntns-baseline-*.service' --grep 'Reusing cached mount namespace' | wc -l)" -eq 0
+test "$(journalctl -b -q -u mntns-template-1.service --grep 'Reusing cached mount namespace' | wc -l)" -eq 0
+test "$(journalctl -b -q -u mntns-template-2.service --grep 'Reusing cached mount namespace' | wc -l)" -eq 1
+# New mounts on the host must show up in services started afterwards
+mkdir -p /tmp/mntns-template-new
+mount -t tmpfs tmpfs /tmp/mntns-template-new
+touch /tmp/mntns-template-new/marker
+systemd-run --wait --pipe -p ProtectSystem=strict -p ProtectHome=yes -p ReadWritePaths=/tmp/mntns-template \
+    test -e /tmp/mntns-template-new/marker
+umount /tmp/mntns-template-new
+rm -rf /tmp/mntns-template /tmp/mntns-template-new /tmp/mntns-baseline
+
 systemd-analyze log-level info
 
 echo OK >/testok
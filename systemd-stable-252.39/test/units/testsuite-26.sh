@@ -418,5 +418,32 @@ systemctl daemon-reload
 systemctl enable --now test-WantedBy.service || :
 systemctl daemon-reload
 
+# Incremental daemon-reload only reloads changed units and keeps their runtime state
+cat >/run/systemd/system/test-incremental.service <<EOF
+[Service]
+ExecStart=sleep infinity
+EOF
+systemctl daemon-reload
+systemctl start test-incremental.service
+main_pid="$(systemctl show --property=MainPID --value test-incremental.service)"
+mkdir -p /run/systemd/system/test-incremental.service.d
+cat >/run/systemd/system/test-incremental.service.d/description.conf <<EOF
+[Unit]
+Description=Incrementally reloaded
+EOF
+assert_eq "$(systemctl show --property=NeedDaemonReload --value test-incremental.service)" "yes"
+output="$(systemctl daemon-reload --incremental)"
+assert_in "Reloaded 1 of" "$output"
+assert_eq "$(systemctl show --property=NeedDaemonReload --value test-incremental.service)" "no"
+assert_eq "$(systemctl show --property=Description --value test-incremental.service)" "Incrementally reloaded"
+assert_eq "$(systemctl show --property=MainPID --value test-incremental.service)" "$main_pid"
+systemctl is-active test-incremental.service
+output="$(systemctl daemon-reload --incremental)"
+assert_in "Reloaded 0 of" "$output"
+(! systemctl --incremental daemon-reexec)
+systemctl stop test-incremental.service
+rm -rf /run/systemd/system/test-incremental.service /run/systemd/system/test-incremental.service.d
+systemctl daemon-reload
+
 touch /testok
 rm /failed
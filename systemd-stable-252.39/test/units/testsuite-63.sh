@@ -82,4 +82,49 @@ assert_in "test63-issue-24577-dep.service" "$output"
 
 systemctl log-level info
 
+# Stress test for PathWatchBackend=fanotify: lots of path units watching paths in the same directory, which
+# would need an inotify instance each otherwise.
+N_STRESS=10000
+STRESS_DIR=/var/tmp/test63-stress
+
+mkdir -p /run/systemd/system.conf.d
+cat >/run/systemd/system.conf.d/50-test63.conf <<EOF
+[Manager]
+PathWatchBackend=fanotify
+EOF
+systemctl daemon-reexec
+
+rm -rf "$STRESS_DIR"
+mkdir -p "$STRESS_DIR"
+for ((i = 1; i <= N_STRESS; i++)); do
+    printf "[Path]\nPathExists=%s/%d\n" "$STRESS_DIR" "$i" >"/run/systemd/system/test63-stress-$i.path"
+    printf "[Service]\nType=oneshot\nRemainAfterExit=yes\nExecStart=true\n" >"/run/systemd/system/test63-stress-$i.service"
+done
+systemctl daemon-reload
+
+seq 1 "$N_STRESS" | sed "s/.*/test63-stress-&.path/" | xargs systemctl start
+test "$(systemctl list-units --no-legend --state=active "test63-stress-*.path" | wc -l)" -eq "$N_STRESS"
+
+# The kernel or the file system might not support fanotify file system marks, in which case we fall back
+# to inotify
+if ls -l /proc/1/fd | grep -q "anon_inode:\[fanotify\]"; then
+    test "$(ls -l /proc/1/fd | grep -c "anon_inode:inotify")" -lt 100
+else
+    echo "PathWatchBackend=fanotify not supported, skipping check for inotify instances"
+fi
+
+for i in 1 4242 "$N_STRESS"; do
+    touch "$STRESS_DIR/$i"
+done
+for i in 1 4242 "$N_STRESS"; do
+    timeout 60 bash -c "until systemctl -q is-active test63-stress-$i.service; do sleep .2; done"
+    test "$(systemctl show "test63-stress-$i.path" -P ActiveState)" = active
+done
+test "$(systemctl list-units --no-legend --state=active "test63-stress-*.service" | wc -l)" -eq 3
+
+systemctl stop "test63-stress-*.path" "test63-stress-*.service"
+rm -f /run/systemd/system/test63-stress-*.{path,service} /run/systemd/system.conf.d/50-test63.conf
+rm -rf "$STRESS_DIR"
+systemctl daemon-reexec
+
 echo OK >/testok